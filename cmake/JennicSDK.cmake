@@ -67,6 +67,19 @@ else()
     endif()
 endif()
 
+# Compressed and delta OTA images are prepared with a python script only
+if(Python3_Interpreter_FOUND)
+    set(OTA_COMPRESS "${Python3_EXECUTABLE}" "${CMAKE_SOURCE_DIR}/scripts/OTACompress/ota_compress.py")
+endif()
+set(OTA_BASE_IMAGE "" CACHE FILEPATH "Firmware .bin deployed on the devices, the compressed OTA image is encoded as a delta against it")
+
+# Static stack usage analysis is a python script as well
+if(Python3_Interpreter_FOUND)
+    set(STACK_USAGE "${Python3_EXECUTABLE}" "${CMAKE_SOURCE_DIR}/scripts/StackUsage/stack_usage.py")
+endif()
+set(STACK_USAGE_ANALYSIS OFF CACHE BOOL "Build with -fstack-usage and add the <target>.stack target")
+set(STACK_MIN_MARGIN 512 CACHE STRING "Minimum number of stack bytes left in the worst case, the stack usage target fails otherwise")
+
 # Dump toolchain variables
 function(dump_compiler_settings)
     message(STATUS "")
@@ -106,6 +119,9 @@ function(dump_compiler_settings)
     message(STATUS "  PDUM_CONFIG = ${PDUM_COMFIG}")
     message(STATUS "  ZPS_CONFIG = ${ZPS_CONFIG}")
     message(STATUS "  JET = ${JET}")
+    message(STATUS "  OTA_COMPRESS = ${OTA_COMPRESS}")
+    message(STATUS "  STACK_USAGE = ${STACK_USAGE}")
+    message(STATUS "  STACK_USAGE_ANALYSIS = ${STACK_USAGE_ANALYSIS}")
     message(STATUS "======================")
     message(STATUS "")
 endfunction()
@@ -175,6 +191,20 @@ function(add_ota_bin_target TARGET)
         DEPENDS ${TARGET}.bin
         COMMAND ${JET} -m otamerge --ota -v JN516x -n ${BUILD_NUMBER} -t ${FIRMWARE_FILE_TYPE} -u ${MANUFACTURER_ID} -p 1 -c ${FILENAME}.bin -o ${FILENAME}.ota
     )
+
+    # Same image, compressed (or encoded as a delta against OTA_BASE_IMAGE) and decoded on the device
+    if(OTA_COMPRESS)
+        if(OTA_BASE_IMAGE)
+            set(BASE_IMAGE_ARGS -b ${OTA_BASE_IMAGE})
+        endif()
+
+        add_custom_target(${TARGET}.compressed.ota
+            DEPENDS ${TARGET}.bin
+            COMMAND ${OTA_COMPRESS} -i ${FILENAME}.bin ${BASE_IMAGE_ARGS} -o ${FILENAME}.hzc
+            COMMAND ${JET} -m otamerge --ota -v JN516x -n ${BUILD_NUMBER} -t ${FIRMWARE_FILE_TYPE} -u ${MANUFACTURER_ID} -p 1 -c ${FILENAME}.hzc -o ${FILENAME}.compressed.ota
+            COMMAND ${CMAKE_COMMAND} -E remove -f ${FILENAME}.hzc
+        )
+    endif()
 endfunction()
 
 function(add_dump_target TARGET)
@@ -183,6 +213,38 @@ function(add_dump_target TARGET)
     add_custom_target(${TARGET}.dump DEPENDS ${TARGET} COMMAND ${CMAKE_OBJDUMP} -x -D -S -s ${FILENAME} | ${CMAKE_CPPFILT} > ${FILENAME}.dump)
 endfunction()
 
+# Worst case stack depth of the main loop and the interrupt handlers, compared with the stack size
+#   add_stack_usage_target(<target> ENTRY <main loop function> ISRS <handlers...> LIBRARIES <libraries built from sources...>
+#                          CALLS <indirect call map file>)
+function(add_stack_usage_target TARGET)
+    if(NOT STACK_USAGE_ANALYSIS OR NOT STACK_USAGE)
+        return()
+    endif()
+
+    cmake_parse_arguments(STACK "" "ENTRY;CALLS" "ISRS;LIBRARIES" ${ARGN})
+    set_target_filename(${TARGET})
+
+    # Frame sizes of the functions built from sources are reported by the compiler next to the object files. The
+    # .su files are a by-product only, the code is the same as in a regular build.
+    target_compile_options(${TARGET} PRIVATE -fstack-usage)
+    foreach(LIBRARY ${STACK_LIBRARIES})
+        target_compile_options(${LIBRARY} PRIVATE -fstack-usage)
+    endforeach()
+
+    set(ARGS --entry ${STACK_ENTRY})
+    foreach(ISR ${STACK_ISRS})
+        list(APPEND ARGS --isr ${ISR})
+    endforeach()
+    if(STACK_CALLS)
+        list(APPEND ARGS --calls ${STACK_CALLS})
+    endif()
+
+    add_custom_target(${TARGET}.stack
+        DEPENDS ${TARGET}
+        COMMAND ${STACK_USAGE} ${FILENAME} --objdump ${CMAKE_OBJDUMP} --su-dir ${CMAKE_BINARY_DIR} ${ARGS} --stack-size ${STACK_SIZE} --min-margin ${STACK_MIN_MARGIN}
+    )
+endfunction()
+
 function(print_size_of_targets TARGET)
     set_target_filename(${TARGET})
     
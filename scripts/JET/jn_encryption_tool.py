@@ -10,10 +10,22 @@ import struct
 import sys
 from typing import List, Tuple
 
-from Crypto.Cipher import AES  # type: ignore
+try:
+    from Crypto.Cipher import AES  # type: ignore
+except ImportError:
+    # Only encryption needs pycryptodome. The OTA header helpers below are
+    # also used by scripts/OTAServerSim, which shall run without it.
+    AES = None
 
 __VERSION__ = '1.1.11'
 
+# Zigbee OTA upgrade file: header, optional header fields, then elements
+# (tag, length, data). The upgrade image is the element with tag 0.
+OTA_FILE_IDENTIFIER = 0x0beef11e
+OTA_HEADER_S = struct.Struct('<I5HIH32sI')
+OTA_ELEMENT_HEADER_S = struct.Struct('<HI')
+OTA_TAG_UPGRADE_IMAGE = 0
+
 
 crctab = [
     0, 79764919, 159529838, 222504665,
@@ -95,6 +107,33 @@ def ImageCRC(data: bytes, length: int):
     return ~crc & 0xffffffff
 
 
+def otaParseFile(data: bytes):
+    """Returns the OTA header fields and the list of (tag, offset, length)
+    elements of an OTA upgrade file. Offsets are relative to the file start."""
+    if len(data) < OTA_HEADER_S.size:
+        raise UserWarning('OTA file is too short', None)
+    header = OTA_HEADER_S.unpack_from(data)
+    if header[0] != OTA_FILE_IDENTIFIER:
+        raise UserWarning('Not an OTA upgrade file', None)
+    header_size = header[2]
+    total_image_size = header[9]
+    if total_image_size > len(data):
+        raise UserWarning('OTA file is truncated', None)
+    elements = []
+    offset = header_size
+    while offset + OTA_ELEMENT_HEADER_S.size <= total_image_size:
+        tag, length = OTA_ELEMENT_HEADER_S.unpack_from(data, offset)
+        offset += OTA_ELEMENT_HEADER_S.size
+        elements.append((tag, offset, length))
+        offset += length
+    return header, elements
+
+
+def checkAES():
+    if AES is None:
+        raise UserWarning('pycryptodome is required for encryption', None)
+
+
 def encryptFlashData(nonce: List[int], key: bytes, data: bytes, imageLen) \
         -> bytes:
     encyptedBlock = b''
@@ -102,6 +141,7 @@ def encryptFlashData(nonce: List[int], key: bytes, data: bytes, imageLen) \
     if imageLen % 16 != 0:
         data = data + b'\xff' * (16 - imageLen % 16)
 
+    checkAES()
     r = AES.new(key, AES.MODE_ECB)
     for x in range(imageLen // 16):
         encryptNonce = ''
@@ -129,6 +169,7 @@ def encryptFlashData(nonce: List[int], key: bytes, data: bytes, imageLen) \
 def decryptFlashData(nonce: List[int], key: bytes, data: bytes, imageLen: int) \
         -> bytes:
     decyptedBlock = b''
+    checkAES()
     r = AES.new(key, AES.MODE_ECB)
     for x in range(imageLen // 16):
         encryptNonce: bytes = b''
@@ -490,7 +531,7 @@ def otamerge(server_image: str, client_image: str, output_image: str,
     image_tag = 0
     WriteMac = False
     imagedata = b''
-    element_hdr_s = struct.Struct('<HI')
+    element_hdr_s = OTA_ELEMENT_HEADER_S
     flash_header_s = struct.Struct('>3IBBH2I4I2H2H2I')
     print('sector size %d ' % sector_size)
     sNonceString = sNonce.strip()
@@ -1772,7 +1813,7 @@ def CLIMain():
                         sPassKey = options.sPassKey[2:]
                 else:
                     sPassKey = ''
-                ota_hdr_s = struct.Struct('<I5HIH32sI')
+                ota_hdr_s = OTA_HEADER_S
                 ota_hdr_ext_s = struct.Struct('<BQHH')
                 ota_hdr_ext_security = struct.Struct('<B')
                 ota_hdr_ext_mac = struct.Struct('<Q')
@@ -1873,7 +1914,7 @@ def CLIMain():
                     print('Image Type: ' + hex(image_type))
                 print('OTA Header String Fetched From Bin ' + OTA_Header_String)
                 ota_hdr = ota_hdr_s.pack(
-                    0xbeef11e,
+                    OTA_FILE_IDENTIFIER,
                     options.Header_Version,
                     header_size,
                     ota_ext_hdr_value if ota_ext_hdr else 0,
@@ -1886,7 +1927,7 @@ def CLIMain():
                 )
             else:
                 ota_hdr = ota_hdr_s.pack(
-                    0xbeef11e,
+                    OTA_FILE_IDENTIFIER,
                     options.Header_Version,
                     header_size,
                     ota_ext_hdr_value if ota_ext_hdr else 0,
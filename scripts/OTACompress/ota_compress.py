@@ -0,0 +1,268 @@
+#!/usr/bin/env python3
+"""Compressed and delta OTA payloads for the HelloZigbee firmware.
+
+Encodes a firmware .bin into the format understood by the on-device OTAImageDecoder (src/OTAImageDecoder.h).
+Without a base image the result is LZ compressed. With --base (the .bin of the firmware currently deployed on the
+devices) the unchanged parts are copied from the running firmware instead of being sent over the air.
+
+The output is passed to JET (otamerge --ota) the same way as a regular .bin, see add_ota_bin_target() in
+cmake/JennicSDK.cmake. Every encoded payload is decoded back and compared with the input before it is written.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b'HZC1'
+VERSION = 1
+FLAG_DELTA = 0x01
+HEADER = struct.Struct('<4sBBHIIII')
+
+OP_LITERAL = 0
+OP_COPY = 1
+OP_BASE = 2
+
+DEFAULT_WINDOW = 960        # OTAImageDecoder::MAX_WINDOW_SIZE
+MIN_MATCH = 4
+MAX_CANDIDATES = 32
+
+# JET drops the chip family word from the start of the .bin, the rest is what the OTA client writes to the flash
+CHIP_HEADERS = (0x02060038, 0x07030008, 0x0f03000b, 0x0a00030f, 0x0a000307, 0x0a000304)
+
+# Image Block Response carries 64 bytes of data, with 17 bytes of ZCL header and fixed fields
+BLOCK_SIZE = 64
+BLOCK_OVERHEAD = 17
+
+
+def flash_image(data):
+    if len(data) >= 4 and struct.unpack_from('>I', data)[0] in CHIP_HEADERS:
+        return data[4:]
+    return data
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        b = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def match_length(a, a_pos, b, b_pos, limit):
+    length = 0
+    while length < limit and a[a_pos + length] == b[b_pos + length]:
+        length += 1
+    return length
+
+
+class Encoder:
+    def __init__(self, image, base, window):
+        self.image = image
+        self.base = base
+        self.window = window
+        self.out = bytearray()
+        self.literals = bytearray()
+        self.base_cursor = 0
+        self.base_index = {}
+        self.window_index = {}
+
+        for pos in range(len(base) - MIN_MATCH + 1):
+            positions = self.base_index.setdefault(base[pos:pos + MIN_MATCH], [])
+            if len(positions) < MAX_CANDIDATES:
+                positions.append(pos)
+
+    def flush_literals(self):
+        if self.literals:
+            self.out += bytes([OP_LITERAL]) + varint(len(self.literals)) + self.literals
+            self.literals = bytearray()
+
+    def base_cost(self, offset, length):
+        return 1 + len(varint(zigzag(offset - self.base_cursor))) + len(varint(length))
+
+    def find_base_match(self, pos, limit):
+        key = self.image[pos:pos + MIN_MATCH]
+        # Continuing the previous copy is the cheapest, and catches code shifted by an insertion
+        candidates = [self.base_cursor] + self.base_index.get(key, [])
+        best = (0, 0, 0)
+        for offset in candidates:
+            if offset + MIN_MATCH > len(self.base):
+                continue
+            length = match_length(self.image, pos, self.base, offset, min(limit, len(self.base) - offset))
+            gain = length - self.base_cost(offset, length)
+            if gain > best[0]:
+                best = (gain, offset, length)
+        return best
+
+    def find_window_match(self, pos, limit):
+        key = self.image[pos:pos + MIN_MATCH]
+        best = (0, 0, 0)
+        for candidate in reversed(self.window_index.get(key, [])):
+            distance = pos - candidate
+            if distance > self.window:
+                break
+            length = match_length(self.image, pos, self.image, candidate, limit)
+            gain = length - (1 + len(varint(distance)) + len(varint(length)))
+            if gain > best[0]:
+                best = (gain, distance, length)
+        return best
+
+    def index_window(self, pos, end):
+        for p in range(pos, min(end, len(self.image) - MIN_MATCH + 1)):
+            positions = self.window_index.setdefault(self.image[p:p + MIN_MATCH], [])
+            positions.append(p)
+            while positions and p - positions[0] > self.window:
+                positions.pop(0)
+            if len(positions) > MAX_CANDIDATES:
+                positions.pop(0)
+
+    def encode(self):
+        image = self.image
+        pos = 0
+        while pos < len(image):
+            limit = len(image) - pos
+            base_match = self.find_base_match(pos, limit) if self.base and limit >= MIN_MATCH else (0, 0, 0)
+            window_match = self.find_window_match(pos, limit) if limit >= MIN_MATCH else (0, 0, 0)
+
+            # A match is taken only if it is cheaper than sending the bytes as literals
+            if base_match[0] > 0 and base_match[0] >= window_match[0]:
+                _, offset, length = base_match
+                self.flush_literals()
+                self.out += bytes([OP_BASE]) + varint(zigzag(offset - self.base_cursor)) + varint(length)
+                self.base_cursor = offset + length
+            elif window_match[0] > 0:
+                _, distance, length = window_match
+                self.flush_literals()
+                self.out += bytes([OP_COPY]) + varint(distance) + varint(length)
+            else:
+                length = 1
+                self.literals.append(image[pos])
+
+            self.index_window(pos, pos + length)
+            pos += length
+
+        self.flush_literals()
+        return bytes(self.out)
+
+
+def encode(image, base=None, window=DEFAULT_WINDOW):
+    flags = FLAG_DELTA if base else 0
+    base = base or b''
+    header = HEADER.pack(MAGIC, VERSION, flags, window, len(image), zlib.crc32(image),
+                         len(base), zlib.crc32(base) if base else 0)
+    return header + Encoder(image, base, window).encode()
+
+
+def decode(payload, base=None):
+    magic, version, flags, window, size, crc, base_size, base_crc = HEADER.unpack_from(payload)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('Not a compressed OTA payload')
+    if flags & FLAG_DELTA:
+        if base is None or len(base) != base_size or zlib.crc32(base) != base_crc:
+            raise ValueError('Payload is encoded against a different base image')
+
+    def read_varint():
+        nonlocal pos
+        value = 0
+        shift = 0
+        while True:
+            b = payload[pos]
+            pos += 1
+            value |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                return value
+
+    out = bytearray()
+    base_cursor = 0
+    pos = HEADER.size
+    while len(out) < size:
+        op = payload[pos]
+        pos += 1
+        if op == OP_LITERAL:
+            length = read_varint()
+            out += payload[pos:pos + length]
+            pos += length
+        elif op == OP_COPY:
+            distance = read_varint()
+            length = read_varint()
+            if distance > window:
+                raise ValueError('Copy distance exceeds the window')
+            for _ in range(length):
+                out.append(out[-distance])
+        elif op == OP_BASE:
+            offset = base_cursor + unzigzag(read_varint())
+            length = read_varint()
+            out += base[offset:offset + length]
+            base_cursor = offset + length
+        else:
+            raise ValueError('Unknown opcode %d' % op)
+
+    if len(out) != size or zlib.crc32(bytes(out)) != crc:
+        raise ValueError('Decoded image does not match the checksum')
+    return bytes(out)
+
+
+def blocks(size):
+    return (size + BLOCK_SIZE - 1) // BLOCK_SIZE
+
+
+def on_air(size):
+    return size + blocks(size) * BLOCK_OVERHEAD
+
+
+def report(image, payload, base):
+    print('Image:        %7d bytes, CRC 0x%08x' % (len(image), zlib.crc32(image)))
+    if base:
+        print('Base image:   %7d bytes, CRC 0x%08x' % (len(base), zlib.crc32(base)))
+    print('Payload:      %7d bytes (%.1f%% of the image), %s' %
+          (len(payload), 100.0 * len(payload) / max(len(image), 1), 'delta' if base else 'compressed'))
+    print('Blocks:       %7d -> %d (%d byte blocks)' % (blocks(len(image)), blocks(len(payload)), BLOCK_SIZE))
+    print('Bytes on air: %7d -> %d (ZCL level, %d%% less)' %
+          (on_air(len(image)), on_air(len(payload)),
+           100 - 100 * on_air(len(payload)) // max(on_air(len(image)), 1)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compressed and delta OTA payloads for the HelloZigbee firmware')
+    parser.add_argument('-i', '--image', required=True, help='new firmware .bin')
+    parser.add_argument('-b', '--base', help='firmware .bin currently deployed on the devices, for a delta payload')
+    parser.add_argument('-o', '--output', required=True, help='payload to pass to JET')
+    parser.add_argument('-w', '--window', type=int, default=DEFAULT_WINDOW,
+                        help='copy window, must not exceed the device window (default %d)' % DEFAULT_WINDOW)
+    options = parser.parse_args()
+
+    if options.window < 1 or options.window > DEFAULT_WINDOW:
+        sys.exit('Window size shall be 1..%d' % DEFAULT_WINDOW)
+
+    with open(options.image, 'rb') as f:
+        image = flash_image(f.read())
+    base = None
+    if options.base:
+        with open(options.base, 'rb') as f:
+            base = flash_image(f.read())
+
+    payload = encode(image, base, options.window)
+    if decode(payload, base) != image:
+        sys.exit('Self check failed, the payload does not decode to the image')
+
+    with open(options.output, 'wb') as f:
+        f.write(payload)
+
+    report(image, payload, base)
+
+
+if __name__ == '__main__':
+    main()
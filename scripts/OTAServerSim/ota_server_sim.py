@@ -0,0 +1,431 @@
+#!/usr/bin/env python3
+"""Local OTA server stand-in and end-to-end upgrade benchmark for the HelloZigbee firmware.
+
+Serves an OTA upgrade file (as produced by JET, see add_ota_bin_target() in cmake/JennicSDK.cmake) to the host
+built device simulation (test/host/ota_client_sim.cpp) over a simulated network with configurable loss and latency.
+The device simulation runs the firmware's OTA transfer policy, context saving, image decoder and flash storage
+logic, so the upgrade can be measured without a coordinator, zigbee2mqtt or radio hardware.
+
+The simulation runs in virtual time and is deterministic for a given --seed. At the end it reports the transfer
+time, block retries and PDM writes, and checks that the image written to the simulated flash is the one served.
+The exit code is non-zero if the upgrade did not complete or the image does not match.
+
+Without --image a synthetic firmware image is generated (--synthetic, optionally --compress or --delta), which
+is what the host test suite uses.
+"""
+
+import argparse
+import heapq
+import os
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+SCRIPTS_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, os.path.join(SCRIPTS_DIR, 'JET'))
+sys.path.insert(0, os.path.join(SCRIPTS_DIR, 'OTACompress'))
+
+import jn_encryption_tool as jet  # noqa: E402
+import ota_compress  # noqa: E402
+
+# OTA cluster commands, the frames carry the command id followed by the ZCL payload
+CMD_QUERY_NEXT_IMAGE_REQUEST = 0x01
+CMD_QUERY_NEXT_IMAGE_RESPONSE = 0x02
+CMD_IMAGE_BLOCK_REQUEST = 0x03
+CMD_IMAGE_PAGE_REQUEST = 0x04
+CMD_IMAGE_BLOCK_RESPONSE = 0x05
+CMD_UPGRADE_END_REQUEST = 0x06
+CMD_UPGRADE_END_RESPONSE = 0x07
+
+STATUS_SUCCESS = 0x00
+STATUS_WAIT_FOR_DATA = 0x97
+STATUS_NO_IMAGE_AVAILABLE = 0x98
+
+IMAGE_NOTIFY_HEADER = struct.Struct('<BHHI')            # field control / status, manufacturer, image type, version
+BLOCK_REQUEST = struct.Struct('<BHHIIB')                # ..., file offset, max data size
+PAGE_REQUEST = struct.Struct('<BHHIIBHH')               # ..., page size, response spacing
+BLOCK_RESPONSE = struct.Struct('<BHHIIB')               # status, ..., file offset, data size
+WAIT_FOR_DATA = struct.Struct('<BIIH')                  # status, current time, request time, minimum block period
+UPGRADE_END_RESPONSE = struct.Struct('<HHIII')          # ..., current time, upgrade time
+
+# Identity of the synthetic image, MANUFACTURER_ID and FIRMWARE_FILE_TYPE defaults of the build
+MANUFACTURER_CODE = 0x115f
+IMAGE_TYPE = 0x0101
+FILE_VERSION = 0x00000002
+
+# ZCL header is frame control, sequence number and command id. The frames here carry the command id only.
+ZCL_HEADER_EXTRA = 2
+MAX_TIME = 24 * 3600 * 1000
+
+
+def synthetic_firmware(size, seed):
+    """Something resembling code: instructions drawn from a small vocabulary, with repeated sequences"""
+    rnd = random.Random(seed)
+    vocabulary = [rnd.getrandbits(32) for _ in range(512)]
+    out = bytearray()
+    while len(out) < size:
+        if out and rnd.random() < 0.3:
+            start = rnd.randrange(max(len(out) - 2048, 0), len(out))
+            out += out[start:start + rnd.randrange(8, 64)]
+        else:
+            out += struct.pack('<I', rnd.choice(vocabulary))
+    return bytes(out[:size])
+
+
+def modified_firmware(base, seed):
+    """A new version of the base firmware: a few functions changed, code after them shifted"""
+    rnd = random.Random(seed)
+    out = bytearray(base)
+    for _ in range(8):
+        pos = rnd.randrange(len(out))
+        out[pos:pos + rnd.randrange(16, 256)] = bytes(rnd.getrandbits(8) for _ in range(rnd.randrange(16, 256)))
+    return bytes(out)
+
+
+def ota_file(payload, manufacturer=MANUFACTURER_CODE, image_type=IMAGE_TYPE, version=FILE_VERSION):
+    """OTA upgrade file with a single upgrade image element, the same layout JET otamerge produces"""
+    header_size = jet.OTA_HEADER_S.size
+    total_size = header_size + jet.OTA_ELEMENT_HEADER_S.size + len(payload)
+    header = jet.OTA_HEADER_S.pack(jet.OTA_FILE_IDENTIFIER, 0x0100, header_size, 0, manufacturer, image_type,
+                                   version, 2, b'HelloZigbee OTA simulation', total_size)
+    return header + jet.OTA_ELEMENT_HEADER_S.pack(jet.OTA_TAG_UPGRADE_IMAGE, len(payload)) + payload
+
+
+def load_ota_file(data):
+    """Returns the OTA file served by the server, its header and the upgrade image element"""
+    # Files JET prepares for the flash programmer start with the chip family word
+    if len(data) >= 4 and struct.unpack_from('<I', data)[0] != jet.OTA_FILE_IDENTIFIER:
+        data = data[4:]
+    header, elements = jet.otaParseFile(data)
+    images = [e for e in elements if e[0] == jet.OTA_TAG_UPGRADE_IMAGE]
+    if not images:
+        raise ValueError('OTA file has no upgrade image element')
+    _, offset, length = images[0]
+    return data[:header[9]], header, data[offset:offset + length]
+
+
+def expected_image(payload):
+    """Image the device shall end up with in the flash, and its format"""
+    if payload[:4] == ota_compress.MAGIC:
+        _, _, flags, _, size, crc, _, _ = ota_compress.HEADER.unpack_from(payload)
+        return size, crc, 'delta' if flags & ota_compress.FLAG_DELTA else 'compressed'
+    return len(payload), zlib.crc32(payload), 'plain'
+
+
+class Network:
+    """Frames are delayed by the latency with jitter, and lost with the given probability"""
+
+    def __init__(self, options, rnd):
+        self.latency = options.latency
+        self.jitter = options.jitter
+        self.loss = options.loss
+        self.rnd = rnd
+        self.frames = 0
+        self.lost = 0
+        self.bytes = 0
+
+    def transmit(self, size):
+        """Returns the delivery delay, or None if the frame is lost"""
+        self.frames += 1
+        self.bytes += size
+        if self.rnd.random() < self.loss:
+            self.lost += 1
+            return None
+        return self.latency + (self.rnd.randint(0, self.jitter) if self.jitter else 0)
+
+
+class OTAServer:
+    """OTA cluster server: Query Next Image, Image Block and Image Page Requests, Upgrade End.
+
+    handle() returns the events to schedule: ('send', frame) to send a response, ('page', generation) to send the
+    next block of the current page. A new page request replaces the page being sent.
+    """
+
+    def __init__(self, options, ota, header):
+        self.options = options
+        self.ota = ota
+        self.manufacturer = header[4]
+        self.image_type = header[5]
+        self.version = header[6]
+        self.last_block_time = None
+        self.page = None
+        self.page_generation = 0
+        self.sent_offsets = set()
+        self.requests = 0
+        self.blocks_sent = 0
+        self.block_retries = 0
+        self.wait_for_data = 0
+        self.upgrade_end_status = None
+
+    def identity(self):
+        return self.manufacturer, self.image_type, self.version
+
+    def handle(self, now, frame):
+        command, payload = frame[0], frame[1:]
+        self.requests += 1
+        respond_at = now + self.options.server_latency
+
+        if command == CMD_QUERY_NEXT_IMAGE_REQUEST:
+            _, manufacturer, image_type, _ = IMAGE_NOTIFY_HEADER.unpack_from(payload)
+            if manufacturer != self.manufacturer or image_type != self.image_type:
+                return [(respond_at, 'send', bytes([CMD_QUERY_NEXT_IMAGE_RESPONSE, STATUS_NO_IMAGE_AVAILABLE]))]
+            return [(respond_at, 'send', bytes([CMD_QUERY_NEXT_IMAGE_RESPONSE]) +
+                     IMAGE_NOTIFY_HEADER.pack(STATUS_SUCCESS, *self.identity()) + struct.pack('<I', len(self.ota)))]
+
+        if command == CMD_IMAGE_BLOCK_REQUEST:
+            _, _, _, _, offset, max_size = BLOCK_REQUEST.unpack_from(payload)
+            # The server enforces its MinimumBlockPeriod on block requests
+            period = self.options.min_block_period
+            if period and self.last_block_time is not None and respond_at < self.last_block_time + period:
+                self.wait_for_data += 1
+                return [(respond_at, 'send', bytes([CMD_IMAGE_BLOCK_RESPONSE]) +
+                         WAIT_FOR_DATA.pack(STATUS_WAIT_FOR_DATA, now // 1000, (now + period + 999) // 1000, period))]
+            self.last_block_time = respond_at
+            return [(respond_at, 'send', self.block(offset, max_size, len(self.ota)))]
+
+        if command == CMD_IMAGE_PAGE_REQUEST:
+            _, _, _, _, offset, max_size, page_size, spacing = PAGE_REQUEST.unpack_from(payload)
+            self.page_generation += 1
+            self.page = {
+                'offset': offset,
+                'end': min(offset + page_size, len(self.ota)),
+                'max_size': max_size,
+                'spacing': max(spacing, self.options.min_block_period),
+            }
+            return [(respond_at, 'page', self.page_generation)]
+
+        if command == CMD_UPGRADE_END_REQUEST:
+            self.upgrade_end_status = payload[0]
+            return [(respond_at, 'send', bytes([CMD_UPGRADE_END_RESPONSE]) +
+                     UPGRADE_END_RESPONSE.pack(*self.identity(), now // 1000, now // 1000))]
+
+        return []
+
+    def next_page_block(self, now, generation):
+        if generation != self.page_generation or self.page['offset'] >= self.page['end']:
+            return []
+        page = self.page
+        frame = self.block(page['offset'], page['max_size'], page['end'])
+        page['offset'] += frame[BLOCK_RESPONSE.size]
+        events = [(now, 'send', frame)]
+        if page['offset'] < page['end']:
+            events.append((now + page['spacing'], 'page', generation))
+        return events
+
+    def block(self, offset, max_size, end):
+        size = max(min(max_size, self.options.server_block_size, end - offset), 0)
+        self.blocks_sent += 1
+        if offset in self.sent_offsets:
+            self.block_retries += 1
+        self.sent_offsets.add(offset)
+        return (bytes([CMD_IMAGE_BLOCK_RESPONSE]) + BLOCK_RESPONSE.pack(STATUS_SUCCESS, *self.identity(), offset, size) +
+                self.ota[offset:offset + size])
+
+
+class Simulation:
+    """Discrete event simulation in virtual ms. The client is a separate process, one event per line."""
+
+    def __init__(self, client, server, network, max_time):
+        self.client = client
+        self.server = server
+        self.network = network
+        self.max_time = max_time
+        self.events = []
+        self.sequence = 0
+        self.wake = None
+        self.report = None
+
+    def schedule(self, time, kind, data=None):
+        heapq.heappush(self.events, (time, self.sequence, kind, data))
+        self.sequence += 1
+
+    def send_to_client(self, time, frame):
+        delay = self.network.transmit(len(frame))
+        if delay is not None:
+            self.schedule(time + delay, 'to_client', frame)
+
+    def client_event(self, time, event):
+        self.client.stdin.write('%d %s\n' % (time, event))
+        self.client.stdin.flush()
+        while True:
+            line = self.client.stdout.readline()
+            if not line:
+                raise RuntimeError('OTA client simulation exited unexpectedly')
+            fields = line.split()
+            if fields[0] == 'WAKE':
+                self.wake = int(fields[1]) if int(fields[1]) >= 0 else None
+                if self.wake is not None:
+                    self.schedule(self.wake, 'tick')
+                return
+            if fields[0] == 'REPORT':
+                self.report = dict(field.split('=', 1) for field in fields[1:])
+            elif len(fields) == 3 and fields[1] == 'TX':
+                frame = bytes.fromhex(fields[2])
+                delay = self.network.transmit(len(frame))
+                if delay is not None:
+                    self.schedule(int(fields[0]) + delay, 'to_server', frame)
+
+    def run(self):
+        # The client starts with the Query Next Image Request
+        self.wake = 0
+        self.schedule(0, 'tick')
+        while self.events and self.report is None:
+            time, _, kind, data = heapq.heappop(self.events)
+            if time > self.max_time:
+                break
+
+            if kind == 'tick':
+                # Only the latest wake up request counts
+                if time == self.wake:
+                    self.client_event(time, 'TICK')
+            elif kind == 'to_client':
+                self.client_event(time, 'RX ' + data.hex())
+            else:
+                events = self.server.handle(time, data) if kind == 'to_server' else \
+                    self.server.next_page_block(time, data)
+                for event_time, event_kind, event_data in events:
+                    if event_kind == 'send':
+                        self.send_to_client(event_time, event_data)
+                    else:
+                        self.schedule(event_time, event_kind, event_data)
+        return self.report
+
+
+def prepare_image(options):
+    """Returns the OTA file to serve and the running firmware image for the client, if needed"""
+    base = None
+    if options.image:
+        with open(options.image, 'rb') as f:
+            data = f.read()
+        if options.base:
+            with open(options.base, 'rb') as f:
+                base = ota_compress.flash_image(f.read())
+        return data, base
+
+    image = synthetic_firmware(options.synthetic, options.seed)
+    if options.delta:
+        base = image
+        image = modified_firmware(base, options.seed)
+        payload = ota_compress.encode(image, base)
+    elif options.compress:
+        payload = ota_compress.encode(image)
+    else:
+        payload = image
+    return ota_file(payload), base
+
+
+def print_report(options, ota, payload, expected, server, network, report, errors):
+    size, crc, fmt = expected
+    print('OTA file:       %7d bytes, upgrade image %d bytes (%s), flash image %d bytes, CRC 0x%08x' %
+          (len(ota), len(payload), fmt, size, crc))
+    print('Network:        %.1f%% loss, %d ms latency (+0..%d ms jitter)' %
+          (options.loss * 100, options.latency, options.jitter))
+    print('Server:         %d ms processing, %d ms minimum block period, %d byte blocks max' %
+          (options.server_latency, options.min_block_period, options.server_block_size))
+    print('Client:         %s requests%s' % ('block' if options.block_requests else 'page', ', sleepy' if options.sleepy else ''))
+    if report is None:
+        print('Result:         FAILED, the upgrade did not finish in %d s of simulated time' % (options.max_time // 1000))
+        return
+
+    download_time = int(report['download_time'])
+    print('Transfer time:  %d.%d s (query response to upgrade end response)' %
+          (download_time // 1000, download_time % 1000 // 100))
+    print('Requests:       %s sent, %d received by the server, %d WAIT_FOR_DATA' %
+          (report['requests'], server.requests, server.wait_for_data))
+    print('Blocks:         %d sent, %d retries, %s accepted, %s out of order, block size %s' %
+          (server.blocks_sent, server.block_retries, report['blocks'], report['out_of_order'], report['block_size']))
+    print('Losses:         %d of %d frames lost, %s timeouts, max request delay %s ms' %
+          (network.lost, network.frames, report['timeouts'], report['max_request_delay']))
+    print('Bytes on air:   %d (ZCL level)' % (network.bytes + network.frames * ZCL_HEADER_EXTRA))
+    print('PDM writes:     %s for %s context save requests' % (report['pdm_writes'], report['contexts']))
+    print('Flash erases:   %s on demand, %s in the background, %s ms stall (%s ms removed)' %
+          (report['erases_on_demand'], report['erases_background'], report['stall_ms'], report['stall_removed_ms']))
+    if int(report['resets']):
+        print('Power loss:     at offset %d, resumed at %d (%s sector restarts)' %
+              (options.reset_at, int(report['resume_offset']), report['sector_restarts']))
+    print('Result:         %s' % ('OK' if not errors else 'FAILED, ' + ', '.join(errors)))
+
+
+def check_report(options, expected, server, report):
+    if report is None:
+        return ['upgrade did not finish']
+    size, crc, fmt = expected
+    errors = []
+    if report['status'] != 'ok' or server.upgrade_end_status != STATUS_SUCCESS:
+        errors.append('upgrade status %s' % report['status'])
+    if report['format'] != fmt:
+        errors.append('image taken as %s' % report['format'])
+    if int(report['image_size']) != size or int(report['image_crc'], 16) != crc:
+        errors.append('flash image does not match')
+    if int(report['bad_writes']):
+        errors.append('%s bytes written to the flash without erase' % report['bad_writes'])
+    if options.reset_at and not int(report['resets']):
+        errors.append('download finished before the reset')
+    return errors
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Local OTA server stand-in and end-to-end upgrade benchmark')
+    parser.add_argument('-c', '--client', required=True, help='device simulation, test/host ota_client_sim binary')
+    parser.add_argument('-i', '--image', help='OTA file to serve (default: synthetic image)')
+    parser.add_argument('-b', '--base', help='firmware .bin running on the device, for delta images')
+    parser.add_argument('--synthetic', type=int, default=160 * 1024, help='synthetic image size (default %(default)s)')
+    parser.add_argument('--compress', action='store_true', help='serve the synthetic image compressed')
+    parser.add_argument('--delta', action='store_true', help='serve the synthetic image as a delta against a base')
+    parser.add_argument('--block-requests', action='store_true', help='client uses Image Block Requests only')
+    parser.add_argument('--loss', type=float, default=0.02, help='frame loss probability (default %(default)s)')
+    parser.add_argument('--latency', type=int, default=20, help='one way latency, ms (default %(default)s)')
+    parser.add_argument('--jitter', type=int, default=10, help='max additional latency, ms (default %(default)s)')
+    parser.add_argument('--server-latency', type=int, default=10, help='request processing, ms (default %(default)s)')
+    parser.add_argument('--min-block-period', type=int, default=0,
+                        help='server MinimumBlockPeriod, ms (default %(default)s)')
+    parser.add_argument('--server-block-size', type=int, default=64,
+                        help='largest block the server sends (default %(default)s)')
+    parser.add_argument('--reset-at', type=int, default=0,
+                        help='client loses the power once the download reaches this file offset, then resumes')
+    parser.add_argument('--sleepy', action='store_true', help='client flushes its download context when it sleeps')
+    parser.add_argument('--seed', type=int, default=1, help='random seed (default %(default)s)')
+    parser.add_argument('--max-time', type=int, default=MAX_TIME // 1000,
+                        help='simulated time limit, s (default %(default)s)')
+    options = parser.parse_args()
+    options.max_time *= 1000
+
+    with tempfile.TemporaryDirectory() as tmpdir:
+        data, base = prepare_image(options)
+        ota, header, payload = load_ota_file(data)
+        expected = expected_image(payload)
+
+        # The device identity matches the image, the file version in the image is the new one
+        command = [options.client, '--manufacturer', str(header[4]), '--image-type', str(header[5])]
+        if options.block_requests:
+            command.append('--block-requests')
+        if options.reset_at:
+            command += ['--reset-at', str(options.reset_at)]
+        if options.sleepy:
+            command.append('--sleepy')
+        if base is not None:
+            base_path = os.path.join(tmpdir, 'base.bin')
+            with open(base_path, 'wb') as f:
+                f.write(base)
+            command += ['--base', base_path]
+
+        rnd = random.Random(options.seed)
+        network = Network(options, rnd)
+        server = OTAServer(options, ota, header)
+        client = subprocess.Popen(command, stdin=subprocess.PIPE, stdout=subprocess.PIPE, universal_newlines=True)
+        try:
+            report = Simulation(client, server, network, options.max_time).run()
+        finally:
+            client.stdin.close()
+            client.wait()
+
+    errors = check_report(options, expected, server, report)
+    print_report(options, ota, payload, expected, server, network, report, errors)
+    sys.exit(1 if errors else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,371 @@
+#!/usr/bin/env python3
+"""Static worst-case stack usage of the HelloZigbee firmware.
+
+Combines the per-function frame sizes produced by the compiler with -fstack-usage (the .su files next to the object
+files) with the call graph extracted from the disassembly of the linked firmware (objdump -d). For every entry point
+(the main loop and each interrupt handler) the deepest call chain is reported, and the total is compared with the
+stack size set by the linker flags.
+
+Interrupts of different priorities may nest, so the budget is the main loop depth plus the depths of all interrupt
+handlers, plus the context saved by the interrupt entry code for each of them.
+
+The analysis is only as good as its inputs, and every gap is listed in the report:
+- Functions built without -fstack-usage (SDK binary libraries, assembly) have no .su entry. Their frame is estimated
+  from the prologue in the disassembly, or may be set with --assume.
+- Function pointer and virtual calls do not show up in the disassembly. The callers of such calls may be mapped to
+  their possible targets with a --calls file (see src/HelloZigbee.calls), the unresolved ones are listed.
+- Recursion makes the depth unbounded, the recursive calls are listed and counted once.
+- Functions with dynamic stack allocation (alloca, variable length arrays) are listed.
+
+Exits with a non-zero code if the stack margin is less than --min-margin.
+"""
+
+import argparse
+import fnmatch
+import os
+import re
+import subprocess
+import sys
+
+# Function header in objdump -d output, e.g. "000804a0 <EndpointManager::handleZclEvent(tsZCL_CallBackEvent*)>:"
+FUNCTION_RE = re.compile(r'^([0-9a-fA-F]+) <(.+)>:\s*$')
+
+# Instruction line with a symbolic target, e.g. "   804a8:  ...  b.jal 80520 <vAppMain>". Branches inside a function
+# refer to it with an offset (<func+0x10>), so a reference to the start of another function is a call (or a tail call).
+TARGET_RE = re.compile(r'<([^<>]+(?:<[^<>]*>[^<>]*)*)>\s*$')
+INSTRUCTION_RE = re.compile(r'^\s*[0-9a-fA-F]+:\s')
+
+# Calls through a register. BA2 mnemonics are assumed (b.jalr/bw.jalr), the others keep the script usable on host
+# builds (x86 and ARM).
+INDIRECT_CALL_RE = re.compile(r'\s(?:b\.jalr|bw\.jalr|l\.jalr|jalr|blx\s+r\d+|call[q]?\s+\*)')
+
+# Prologue patterns used to estimate the frame of functions without .su entries. BA2 stack adjustment and
+# entry instructions are assumed, x86 ones are for host builds.
+PROLOGUE_LEN = 8
+PROLOGUE_PATTERNS = (
+    (re.compile(r'\sb\.entri\s+(0x[0-9a-fA-F]+|\d+)\s*,\s*(0x[0-9a-fA-F]+|\d+)'), lambda m: 4 * (int(m.group(1), 0) + int(m.group(2), 0))),
+    (re.compile(r'\s(?:b|bw|bn|l)\.addi\s+r1\s*,\s*r1\s*,\s*-(0x[0-9a-fA-F]+|\d+)'), lambda m: int(m.group(1), 0)),
+    (re.compile(r'\ssub\s+\$(0x[0-9a-fA-F]+),%[re]sp'), lambda m: int(m.group(1), 0)),
+    (re.compile(r'\spush[q]?\s+%'), lambda m: 8),
+)
+
+CLONE_SUFFIX_RE = re.compile(r'(\s*\[clone [^\]]*\])+$|(\.(constprop|isra|part|cold|lto_priv)\.\d+)+$')
+
+
+def split_top_level(text, sep):
+    """Split on a separator outside of <> and () brackets."""
+    parts = []
+    depth = 0
+    start = 0
+    for i, c in enumerate(text):
+        if c in '<(':
+            depth += 1
+        elif c in '>)':
+            depth -= 1
+        elif c == sep and depth == 0:
+            parts.append(text[start:i])
+            start = i + 1
+    parts.append(text[start:])
+    return [p for p in parts if p]
+
+
+def function_key(name):
+    """Reduce a function name to the form used for matching: qualified name without return type and arguments.
+
+    Both "virtual int Deep::handle(int)" (.su) and "Deep::handle(int) [clone .isra.0]" (objdump) become
+    "Deep::handle". Overloads end up with the same key, which only makes the estimate more conservative.
+    """
+    name = CLONE_SUFFIX_RE.sub('', name.strip())
+    name = re.sub(r'\s+(const|volatile)$', '', name)
+
+    # Drop the argument list, matching the parentheses from the end (arguments may hold function pointer types)
+    if name.endswith(')'):
+        depth = 0
+        for i in range(len(name) - 1, -1, -1):
+            if name[i] == ')':
+                depth += 1
+            elif name[i] == '(':
+                depth -= 1
+                if depth == 0:
+                    name = name[:i]
+                    break
+
+    # Drop the return type and the specifiers in front of the name
+    words = split_top_level(name, ' ')
+    name = words[-1] if words else name
+    return CLONE_SUFFIX_RE.sub('', name)
+
+
+class Function:
+    def __init__(self, name):
+        self.name = name
+        self.frame = None           # bytes, None if unknown
+        self.frame_source = None    # 'su', 'prologue', 'assumed'
+        self.dynamic = False
+        self.calls = set()
+        self.indirect_calls = 0
+        self.resolved = False       # indirect calls mapped by a calls file
+        self.prologue = []
+
+
+def parse_su_files(su_dir, frames):
+    """Frame sizes from the .su files: "file:line:col:name<TAB>bytes<TAB>static|dynamic[,bounded]"."""
+    for root, dirs, files in os.walk(su_dir):
+        for filename in files:
+            if not filename.endswith('.su'):
+                continue
+            with open(os.path.join(root, filename), encoding='utf-8', errors='replace') as f:
+                for line in f:
+                    fields = line.rstrip('\n').split('\t')
+                    if len(fields) < 3:
+                        continue
+                    location, size, qualifier = fields[0], int(fields[1]), fields[2]
+                    # The name follows file:line:col, and may contain colons itself
+                    name = location.split(':', 3)[-1]
+                    key = function_key(name)
+                    dynamic = qualifier.startswith('dynamic') and 'bounded' not in qualifier
+                    size = max(size, frames[key][0]) if key in frames else size
+                    dynamic = dynamic or (key in frames and frames[key][1])
+                    frames[key] = (size, dynamic)
+
+
+def parse_disassembly(lines):
+    """Call graph from the objdump -d -C output."""
+    functions = {}
+    current = None
+    pending = []    # (caller, target name) resolved once all function names are known
+
+    for line in lines:
+        m = FUNCTION_RE.match(line)
+        if m:
+            key = function_key(m.group(2))
+            current = functions.setdefault(key, Function(key))
+            continue
+
+        if current is None or not INSTRUCTION_RE.match(line):
+            continue
+
+        if len(current.prologue) < PROLOGUE_LEN:
+            current.prologue.append(line)
+
+        if INDIRECT_CALL_RE.search(line):
+            current.indirect_calls += 1
+            continue
+
+        m = TARGET_RE.search(line)
+        if m and '+0x' not in m.group(1) and '-0x' not in m.group(1):
+            pending.append((current, function_key(m.group(1))))
+
+    # A reference to the own name (without offset) is a recursive call
+    for caller, target in pending:
+        if target in functions:
+            caller.calls.add(target)
+
+    return functions
+
+
+def estimate_frame(function):
+    total = 0
+    for line in function.prologue:
+        for pattern, size in PROLOGUE_PATTERNS:
+            m = pattern.search(line)
+            if m:
+                total += size(m)
+    return total if total else None
+
+
+def parse_calls_file(filename):
+    """Indirect call map: "<caller pattern> [...]: <callee pattern> [...]", one rule per line, # for comments."""
+    rules = []
+    with open(filename, encoding='utf-8') as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            if ':' not in line.replace('::', ''):
+                raise ValueError(f'{filename}:{lineno}: expected "<callers>: <callees>"')
+            # Split on the first single colon, qualified names use double ones
+            m = re.match(r'^((?:[^:]|::)*?)\s*:(?!:)\s*(.*)$', line)
+            callers, callees = m.group(1).split(), m.group(2).split()
+            rules.append((callers, callees, f'{filename}:{lineno}'))
+    return rules
+
+
+def apply_calls_file(functions, rules):
+    """Adds the indirect call edges, returns the rules that matched nothing (likely stale names)."""
+    unused = []
+    names = sorted(functions)
+    for callers, callees, where in rules:
+        matched_callers = [n for n in names if any(fnmatch.fnmatchcase(n, p) for p in callers)]
+        matched_callees = [n for n in names if any(fnmatch.fnmatchcase(n, p) for p in callees)]
+        if not matched_callers or not matched_callees:
+            unused.append(where)
+        for caller in matched_callers:
+            function = functions[caller]
+            if function.indirect_calls == 0:
+                continue
+            function.resolved = True
+            function.calls.update(n for n in matched_callees if n != caller)
+    return unused
+
+
+class Analysis:
+    def __init__(self, functions):
+        self.functions = functions
+        self.depth = {}             # worst depth from a function down, bytes
+        self.next = {}              # callee on the worst path
+        self.recursion = set()      # (caller, callee) edges closing a cycle
+
+    def worst(self, name, stack=None):
+        if name in self.depth:
+            return self.depth[name]
+
+        stack = stack if stack is not None else []
+        stack.append(name)
+        function = self.functions[name]
+        best, best_callee = 0, None
+        for callee in sorted(function.calls):
+            if callee in stack:
+                self.recursion.add((name, callee))
+                continue
+            depth = self.worst(callee, stack)
+            if depth > best:
+                best, best_callee = depth, callee
+        stack.pop()
+
+        self.depth[name] = (function.frame or 0) + best
+        self.next[name] = best_callee
+        return self.depth[name]
+
+    def path(self, name):
+        result = []
+        while name is not None:
+            result.append(self.functions[name])
+            name = self.next[name]
+        return result
+
+
+def print_path(title, path):
+    print(f'{title}: {sum(f.frame or 0 for f in path)} bytes')
+    for function in path:
+        notes = []
+        if function.frame is None:
+            notes.append('frame unknown')
+        elif function.frame_source != 'su':
+            notes.append(f'frame from {function.frame_source}')
+        if function.dynamic:
+            notes.append('dynamic stack')
+        if function.indirect_calls and not function.resolved:
+            notes.append('unresolved indirect call')
+        size = '?' if function.frame is None else function.frame
+        print(f'  {size:>6}  {function.name}' + (f'    ({", ".join(notes)})' if notes else ''))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Static worst-case stack usage from .su files and the objdump call graph')
+    parser.add_argument('elf', help='Linked firmware')
+    parser.add_argument('--objdump', default='objdump', help='objdump executable of the toolchain')
+    parser.add_argument('--su-dir', action='append', default=[], help='Directory searched (recursively) for .su files')
+    parser.add_argument('--entry', default='vAppMain', help='Main loop entry point')
+    parser.add_argument('--isr', action='append', default=[], help='Interrupt handler, may be given several times')
+    parser.add_argument('--isr-overhead', type=int, default=64, help='Bytes saved by the interrupt entry code per handler')
+    parser.add_argument('--calls', action='append', default=[], help='Indirect call map file')
+    parser.add_argument('--assume', action='append', default=[], metavar='FUNC=BYTES', help='Frame of a function with no .su entry')
+    parser.add_argument('--stack-size', type=int, required=True, help='Stack size set by the linker flags')
+    parser.add_argument('--min-margin', type=int, default=0, help='Fail if fewer bytes than this are left')
+    args = parser.parse_args()
+
+    sys.setrecursionlimit(10000)
+
+    try:
+        disassembly = subprocess.run([args.objdump, '-d', '-C', args.elf], check=True, capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as e:
+        print(f'Cannot disassemble {args.elf}: {e}')
+        return 2
+    functions = parse_disassembly(disassembly.splitlines())
+
+    frames = {}
+    for su_dir in args.su_dir:
+        parse_su_files(su_dir, frames)
+    if not frames:
+        print('No .su files found, was the firmware built with -fstack-usage?')
+        return 2
+
+    assumed = {}
+    for item in args.assume:
+        name, _, size = item.partition('=')
+        assumed[function_key(name)] = int(size, 0)
+
+    for function in functions.values():
+        if function.name in assumed:
+            function.frame, function.frame_source = assumed[function.name], 'assumed'
+        elif function.name in frames:
+            function.frame, function.dynamic = frames[function.name]
+            function.frame_source = 'su'
+        else:
+            function.frame = estimate_frame(function)
+            function.frame_source = 'prologue' if function.frame is not None else None
+
+    unused_rules = []
+    for filename in args.calls:
+        unused_rules += apply_calls_file(functions, parse_calls_file(filename))
+
+    analysis = Analysis(functions)
+    entries = [(args.entry, 'Main loop')] + [(isr, 'Interrupt') for isr in args.isr]
+    missing = [name for name, _ in entries if function_key(name) not in functions]
+    if missing:
+        print(f'Entry points not found in {args.elf}: {", ".join(missing)}')
+        return 2
+
+    paths = {}
+    for name, kind in entries:
+        key = function_key(name)
+        analysis.worst(key)
+        paths[name] = analysis.path(key)
+        print_path(f'{kind} {name}', paths[name])
+
+    # Everything on the worst paths that makes the numbers less certain
+    on_paths = {f.name: f for path in paths.values() for f in path}
+    reached = set()
+    todo = [function_key(name) for name, _ in entries]
+    while todo:
+        name = todo.pop()
+        if name not in reached:
+            reached.add(name)
+            todo.extend(functions[name].calls)
+
+    def report_list(title, items):
+        if items:
+            print(f'{title}:')
+            for item in items:
+                print(f'  {item}')
+            print()
+
+    # A function with an unknown frame is never on a worst path by itself, so all reachable ones are listed
+    report_list('Frame unknown (use --assume)', sorted(n for n in reached if functions[n].frame is None))
+    report_list('Unresolved indirect calls on the worst paths (add them to the calls file)',
+                sorted(n for n, f in on_paths.items() if f.indirect_calls and not f.resolved))
+    report_list('Recursion (counted once)', sorted(f'{a} -> {b}' for a, b in analysis.recursion if a in reached))
+    report_list('Dynamic stack allocation', sorted(n for n in reached if functions[n].dynamic))
+    report_list('Calls file rules matching no function', unused_rules)
+
+    main_depth = analysis.depth[function_key(args.entry)]
+    isr_depth = sum(analysis.depth[function_key(isr)] + args.isr_overhead for isr in args.isr)
+    total = main_depth + isr_depth
+    margin = args.stack_size - total
+
+    print(f'Stack size:     {args.stack_size:>6}')
+    print(f'Main loop:      {main_depth:>6}')
+    print(f'Interrupts:     {isr_depth:>6}  ({len(args.isr)} nested, {args.isr_overhead} bytes entry overhead each)')
+    print(f'Worst case:     {total:>6}')
+    print(f'Margin:         {margin:>6}  (minimum {args.min_margin})')
+
+    if margin < args.min_margin:
+        print('FAILED: stack margin is below the minimum')
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,172 @@
+#include "AddressLookupQueue.h"
+
+AddressLookupQueue::AddressLookupQueue()
+{
+    for(uint8 i = 0; i < MAX_LOOKUPS; i++)
+    {
+        lookups[i].ieeeAddr = 0;
+        lookups[i].unicastAddr = 0;
+        lookups[i].state = LOOKUP_FREE;
+        lookups[i].sentTime = 0;
+    }
+
+    configure(DEFAULT_MIN_REQUEST_INTERVAL, DEFAULT_RESPONSE_TIMEOUT);
+    requestSent = false;
+    lastRequestTime = 0;
+
+    stats.requests = 0;
+    stats.cacheHits = 0;
+    stats.deduplicated = 0;
+    stats.dropped = 0;
+    stats.unicastLookups = 0;
+    stats.broadcastLookups = 0;
+    stats.resolved = 0;
+    stats.failed = 0;
+    stats.broadcastsAvoided = 0;
+}
+
+void AddressLookupQueue::configure(uint32 newMinRequestInterval, uint32 newResponseTimeout)
+{
+    minRequestInterval = newMinRequestInterval;
+    responseTimeout = newResponseTimeout;
+}
+
+void AddressLookupQueue::handleCacheHit()
+{
+    stats.requests++;
+    stats.cacheHits++;
+    stats.broadcastsAvoided++;
+}
+
+bool AddressLookupQueue::enqueue(uint64 ieeeAddr, uint16 unicastAddr)
+{
+    stats.requests++;
+
+    // Do not ask for the same address twice
+    if(findLookup(ieeeAddr) >= 0)
+    {
+        stats.deduplicated++;
+        stats.broadcastsAvoided++;
+        return true;
+    }
+
+    for(uint8 i = 0; i < MAX_LOOKUPS; i++)
+    {
+        if(lookups[i].state == LOOKUP_FREE)
+        {
+            lookups[i].ieeeAddr = ieeeAddr;
+            lookups[i].unicastAddr = unicastAddr;
+            lookups[i].state = unicastAddr != NO_UNICAST_ADDR ? LOOKUP_PENDING : LOOKUP_BROADCAST_PENDING;
+            return true;
+        }
+    }
+
+    stats.dropped++;
+    return false;
+}
+
+AddressLookupAction AddressLookupQueue::getNextAction(uint32 now, uint64 * ieeeAddr, uint16 * unicastAddr)
+{
+    // Handle timed out requests
+    for(uint8 i = 0; i < MAX_LOOKUPS; i++)
+    {
+        Lookup & lookup = lookups[i];
+        bool timedOut = (now - lookup.sentTime) >= responseTimeout;
+
+        if(lookup.state == LOOKUP_UNICAST_SENT && timedOut)
+            lookup.state = LOOKUP_BROADCAST_PENDING;
+
+        if(lookup.state == LOOKUP_BROADCAST_SENT && timedOut)
+        {
+            stats.failed++;
+            lookup.state = LOOKUP_FREE;
+        }
+    }
+
+    // Rate limit requests
+    if(requestSent && (now - lastRequestTime) < minRequestInterval)
+        return ADDRESS_LOOKUP_ACTION_NONE;
+
+    // Cheap unicast requests go first
+    for(uint8 i = 0; i < MAX_LOOKUPS; i++)
+    {
+        if(lookups[i].state == LOOKUP_PENDING)
+        {
+            lookups[i].state = LOOKUP_UNICAST_SENT;
+            lookups[i].sentTime = now;
+            requestSent = true;
+            lastRequestTime = now;
+            stats.unicastLookups++;
+
+            *ieeeAddr = lookups[i].ieeeAddr;
+            *unicastAddr = lookups[i].unicastAddr;
+            return ADDRESS_LOOKUP_ACTION_UNICAST;
+        }
+    }
+
+    for(uint8 i = 0; i < MAX_LOOKUPS; i++)
+    {
+        if(lookups[i].state == LOOKUP_BROADCAST_PENDING)
+        {
+            lookups[i].state = LOOKUP_BROADCAST_SENT;
+            lookups[i].sentTime = now;
+            requestSent = true;
+            lastRequestTime = now;
+            stats.broadcastLookups++;
+
+            *ieeeAddr = lookups[i].ieeeAddr;
+            return ADDRESS_LOOKUP_ACTION_BROADCAST;
+        }
+    }
+
+    return ADDRESS_LOOKUP_ACTION_NONE;
+}
+
+void AddressLookupQueue::handleResolved(uint64 ieeeAddr)
+{
+    int idx = findLookup(ieeeAddr);
+    if(idx < 0)
+        return;
+
+    stats.resolved++;
+    if(lookups[idx].state != LOOKUP_BROADCAST_SENT)
+        stats.broadcastsAvoided++;
+
+    lookups[idx].state = LOOKUP_FREE;
+}
+
+bool AddressLookupQueue::hasLookups() const
+{
+    for(uint8 i = 0; i < MAX_LOOKUPS; i++)
+        if(lookups[i].state != LOOKUP_FREE)
+            return true;
+
+    return false;
+}
+
+bool AddressLookupQueue::isPending(uint64 ieeeAddr) const
+{
+    return findLookup(ieeeAddr) >= 0;
+}
+
+uint64 AddressLookupQueue::getLookupAddress(uint8 idx) const
+{
+    if(idx >= MAX_LOOKUPS || lookups[idx].state == LOOKUP_FREE)
+        return 0;
+
+    return lookups[idx].ieeeAddr;
+}
+
+const AddressLookupStatistics & AddressLookupQueue::getStatistics() const
+{
+    return stats;
+}
+
+int AddressLookupQueue::findLookup(uint64 ieeeAddr) const
+{
+    for(uint8 i = 0; i < MAX_LOOKUPS; i++)
+        if(lookups[i].state != LOOKUP_FREE && lookups[i].ieeeAddr == ieeeAddr)
+            return i;
+
+    return -1;
+}
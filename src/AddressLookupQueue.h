@@ -0,0 +1,94 @@
+#ifndef ADDRESSLOOKUPQUEUE_H
+#define ADDRESSLOOKUPQUEUE_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// What shall be sent next to resolve an IEEE address into a network address
+enum AddressLookupAction
+{
+    ADDRESS_LOOKUP_ACTION_NONE,
+    ADDRESS_LOOKUP_ACTION_UNICAST,      // Ask a single device (the last known address of the device)
+    ADDRESS_LOOKUP_ACTION_BROADCAST     // Ask the whole network (last resort)
+};
+
+struct AddressLookupStatistics
+{
+    uint32 requests;            // Address resolutions requested
+    uint32 cacheHits;           // Resolved from the stack's address map, no lookup needed
+    uint32 deduplicated;        // Lookup for this address is already in progress
+    uint32 dropped;             // No free lookup slots
+    uint32 unicastLookups;      // Unicast NWK_addr_req sent
+    uint32 broadcastLookups;    // Broadcast NWK_addr_req sent
+    uint32 resolved;            // Lookups that got a response
+    uint32 failed;              // Lookups that got no response at all
+    uint32 broadcastsAvoided;   // Requests that would have been a broadcast with the old approach, but were not
+};
+
+// Keeps track of outstanding IEEE -> NWK address lookups.
+//
+// - Lookups for the same address are de-duplicated
+// - Each lookup first goes as a unicast request, and only if it is not answered - as a broadcast. The unicast
+//   destination is provided by the caller (e.g. last known address of the device being refreshed). Without one
+//   (NO_UNICAST_ADDR) the lookup is broadcast right away.
+// - Requests are sent not more often than the configured interval, so that provisioning of many bindings
+//   at once does not flood the network
+//
+// AddressResolver sends the NWK_addr_req requests the queue asks for, and reports the responses back.
+class AddressLookupQueue
+{
+    enum LookupState
+    {
+        LOOKUP_FREE,
+        LOOKUP_PENDING,
+        LOOKUP_UNICAST_SENT,
+        LOOKUP_BROADCAST_PENDING,
+        LOOKUP_BROADCAST_SENT
+    };
+
+    struct Lookup
+    {
+        uint64 ieeeAddr;
+        uint16 unicastAddr;
+        LookupState state;
+        uint32 sentTime;
+    };
+
+public:
+    static const uint8 MAX_LOOKUPS = 4;
+    static const uint32 DEFAULT_MIN_REQUEST_INTERVAL = 1000;
+    static const uint32 DEFAULT_RESPONSE_TIMEOUT = 5000;
+    static const uint16 NO_UNICAST_ADDR = 0xFFFF;
+
+private:
+    Lookup lookups[MAX_LOOKUPS];
+    uint32 minRequestInterval;
+    uint32 responseTimeout;
+    bool requestSent;
+    uint32 lastRequestTime;
+
+    AddressLookupStatistics stats;
+
+public:
+    AddressLookupQueue();
+
+    void configure(uint32 minRequestInterval, uint32 responseTimeout);
+
+    void handleCacheHit();
+    bool enqueue(uint64 ieeeAddr, uint16 unicastAddr);
+    AddressLookupAction getNextAction(uint32 now, uint64 * ieeeAddr, uint16 * unicastAddr);
+    void handleResolved(uint64 ieeeAddr);
+
+    bool hasLookups() const;
+    bool isPending(uint64 ieeeAddr) const;
+    uint64 getLookupAddress(uint8 idx) const;
+
+    const AddressLookupStatistics & getStatistics() const;
+
+private:
+    int findLookup(uint64 ieeeAddr) const;
+};
+
+#endif // ADDRESSLOOKUPQUEUE_H
@@ -0,0 +1,168 @@
+extern "C"
+{
+    #include "jendefs.h"
+    #include "pdum_gen.h"
+    #include "zps_apl_af.h"
+    #include "zps_apl_aib.h"
+    #include "zps_apl_zdo.h"
+    #include "zps_apl_zdp.h"
+    #include "dbg.h"
+}
+
+#include "AddressResolver.h"
+#include "DiagnosticsCollector.h"
+#include "SystemClock.h"
+#include "ZigbeeDevice.h"
+
+// How often pending lookups are checked for the next action
+static const uint32 PROCESSING_PERIOD = 100;
+
+// Addresses above this value are reserved (broadcasts and 'unknown address' markers)
+static const uint16 MAX_VALID_NWK_ADDR = 0xFFF7;
+
+// All devices with the receiver on. Sleeping end devices are answered by their parents.
+static const uint16 RX_ON_WHEN_IDLE_BROADCAST_ADDR = 0xFFFD;
+
+static const uint16 COORDINATOR_NWK_ADDR = 0x0000;
+
+AddressResolver::AddressResolver()
+{
+    // The timer is restarted manually while there are lookups in progress
+    PeriodicTask::init(0);
+}
+
+void AddressResolver::resolve(uint64 ieeeAddr)
+{
+    // Coordinator address never changes
+    if(ieeeAddr == ZPS_eAplAibGetApsTrustCenterAddress())
+    {
+        queue.handleCacheHit();
+        return;
+    }
+
+    // The stack may already know the address
+    uint16 nwkAddr = ZPS_u16AplZdoLookupAddr(ieeeAddr);
+    if(nwkAddr <= MAX_VALID_NWK_ADDR)
+    {
+        DBG_vPrintf(TRUE, "AddressResolver: %016llx is known as %04x\n", ieeeAddr, nwkAddr);
+        queue.handleCacheHit();
+        return;
+    }
+
+    // Only the device itself or its parent answer, and neither is known. Ask the whole network right away.
+    if(!queue.enqueue(ieeeAddr, AddressLookupQueue::NO_UNICAST_ADDR))
+        DBG_vPrintf(TRUE, "AddressResolver: No free slots to look up %016llx\n", ieeeAddr);
+
+    scheduleProcessing();
+}
+
+void AddressResolver::refresh(uint16 nwkAddr)
+{
+    // Coordinator address never changes, and nothing to refresh if the address is not in the address map
+    if(nwkAddr == COORDINATOR_NWK_ADDR || nwkAddr > MAX_VALID_NWK_ADDR)
+        return;
+
+    uint64 ieeeAddr = ZPS_u64AplZdoLookupIeeeAddr(nwkAddr);
+    if(ieeeAddr == 0)
+        return;
+
+    // The device may have changed its address, or just be temporarily unreachable. Ask the device itself first.
+    DBG_vPrintf(TRUE, "AddressResolver: Delivery to %04x failed, refreshing address of %016llx\n", nwkAddr, ieeeAddr);
+    queue.enqueue(ieeeAddr, nwkAddr);
+    scheduleProcessing();
+}
+
+void AddressResolver::handleNwkAddrResponse()
+{
+    // The stack updates its address map with the response, so just check which lookups are now complete
+    for(uint8 i = 0; i < AddressLookupQueue::MAX_LOOKUPS; i++)
+    {
+        uint64 ieeeAddr = queue.getLookupAddress(i);
+        if(ieeeAddr == 0)
+            continue;
+
+        uint16 nwkAddr = ZPS_u16AplZdoLookupAddr(ieeeAddr);
+        if(nwkAddr > MAX_VALID_NWK_ADDR)
+            continue;
+
+        DBG_vPrintf(TRUE, "AddressResolver: %016llx resolved to %04x\n", ieeeAddr, nwkAddr);
+        queue.handleResolved(ieeeAddr);
+    }
+}
+
+bool AddressResolver::hasLookups() const
+{
+    return queue.hasLookups();
+}
+
+const AddressLookupStatistics & AddressResolver::getStatistics() const
+{
+    return queue.getStatistics();
+}
+
+void AddressResolver::dumpStatistics() const
+{
+    const AddressLookupStatistics & stats = queue.getStatistics();
+    DBG_vPrintf(TRUE, "\n+++++++ Address resolution statistics:\n");
+    DBG_vPrintf(TRUE, "    Requests: %d (cache hits %d, deduplicated %d, dropped %d)\n",
+                stats.requests, stats.cacheHits, stats.deduplicated, stats.dropped);
+    DBG_vPrintf(TRUE, "    Lookups sent: unicast %d, broadcast %d\n", stats.unicastLookups, stats.broadcastLookups);
+    DBG_vPrintf(TRUE, "    Lookups resolved: %d, failed: %d\n", stats.resolved, stats.failed);
+    DBG_vPrintf(TRUE, "    Broadcasts avoided: %d\n", stats.broadcastsAvoided);
+}
+
+void AddressResolver::sendNwkAddrRequest(uint64 ieeeAddr, uint16 dstAddr)
+{
+    PDUM_thAPduInstance hAPduInst = PDUM_hAPduAllocateAPduInstance(apduZDP);
+    if(hAPduInst == PDUM_INVALID_HANDLE)
+    {
+        DBG_vPrintf(TRUE, "AddressResolver: Cannot allocate APDU for the address request\n");
+        DiagnosticsCollector::getInstance()->handleBufferAllocFailure();
+        return;
+    }
+
+    // Address of interest, single device response
+    ZPS_tsAplZdpNwkAddrReq req = {ieeeAddr, 0, 0};
+
+    ZPS_tuAddress uDstAddr;
+    uDstAddr.u16Addr = dstAddr;
+
+    uint8 u8SeqNumber;
+    ZPS_teStatus status = ZPS_eAplZdpNwkAddrRequest(hAPduInst,
+                                                    uDstAddr,
+                                                    FALSE,
+                                                    &u8SeqNumber,
+                                                    &req);
+    DBG_vPrintf(TRUE, "AddressResolver: looking for network addr for %016llx via %04x. Status=%02x\n", ieeeAddr, dstAddr, status);
+
+    // Make sure the response is received quickly
+    ZigbeeDevice::getInstance()->triggerFastPoll();
+}
+
+void AddressResolver::scheduleProcessing()
+{
+    if(queue.hasLookups() && !isTimerActive())
+        startTimer(1);
+}
+
+void AddressResolver::timerCallback()
+{
+    uint64 ieeeAddr;
+    uint16 unicastAddr;
+    switch(queue.getNextAction(SystemClock::getInstance()->getTimeMs(), &ieeeAddr, &unicastAddr))
+    {
+        case ADDRESS_LOOKUP_ACTION_UNICAST:
+            sendNwkAddrRequest(ieeeAddr, unicastAddr);
+            break;
+
+        case ADDRESS_LOOKUP_ACTION_BROADCAST:
+            sendNwkAddrRequest(ieeeAddr, RX_ON_WHEN_IDLE_BROADCAST_ADDR);
+            break;
+
+        default:
+            break;
+    }
+
+    if(queue.hasLookups())
+        startTimer(PROCESSING_PERIOD);
+}
@@ -0,0 +1,33 @@
+#ifndef ADDRESSRESOLVER_H
+#define ADDRESSRESOLVER_H
+
+#include "PeriodicTask.h"
+#include "AddressLookupQueue.h"
+
+// Makes sure the stack knows network addresses of the bound devices.
+//
+// The address is taken from the stack's address map whenever possible. Unknown addresses are resolved with
+// a broadcast NWK_addr_req, as a unicast one is answered only for the receiver itself and its children. Addresses
+// that stopped working are refreshed with a unicast request to the device first, and only then with a broadcast.
+class AddressResolver : public PeriodicTask
+{
+    AddressLookupQueue queue;
+
+public:
+    AddressResolver();
+
+    void resolve(uint64 ieeeAddr);
+    void refresh(uint16 nwkAddr);
+    void handleNwkAddrResponse();
+
+    bool hasLookups() const;
+    const AddressLookupStatistics & getStatistics() const;
+    void dumpStatistics() const;
+
+protected:
+    void sendNwkAddrRequest(uint64 ieeeAddr, uint16 dstAddr);
+    void scheduleProcessing();
+    virtual void timerCallback();
+};
+
+#endif // ADDRESSRESOLVER_H
@@ -10,6 +10,14 @@ extern "C"
 #include "EndpointManager.h"
 #include "LEDTask.h"
 #include "DumpFunctions.h"
+#include "SleepManager.h"
+#include "ZigbeeDevice.h"
+#include "ReportAggregator.h"
+#include "GroupFanout.h"
+#include "DeliveryTracker.h"
+#include "TemperatureSampler.h"
+#include "DiagnosticsCollector.h"
+#include "MemoryMonitor.h"
 
 BasicClusterEndpoint::BasicClusterEndpoint()
 {
@@ -71,6 +79,60 @@ void BasicClusterEndpoint::registerDeviceTemperatureCluster()
         DBG_vPrintf(TRUE, "BasicClusterEndpoint::registerDeviceTemperatureCluster(): Failed to create Device Temperature Configuration Cluster instance. Status=%d\n", status);
 }
 
+void BasicClusterEndpoint::registerDeviceStatsCluster()
+{
+    // Create an instance of a device statistics cluster as a server
+    teZCL_Status status = eCLD_DeviceStatsCreateDeviceStats(&clusterInstances.sDeviceStatsServer,
+                                                            TRUE,
+                                                            &sCLD_DeviceStats,
+                                                            &sDeviceStatsServerCluster,
+                                                            &au8DeviceStatsAttributeControlBits[0]);
+
+    if(status != E_ZCL_SUCCESS)
+        DBG_vPrintf(TRUE, "BasicClusterEndpoint::registerDeviceStatsCluster(): Failed to create Device Statistics Cluster instance. Status=%d\n", status);
+}
+
+void BasicClusterEndpoint::registerPollControlCluster()
+{
+    // Create an instance of a poll control cluster as a server
+    teZCL_Status status = eCLD_PollControlCreatePollControl(&clusterInstances.sPollControlServer,
+                                                            TRUE,
+                                                            &sCLD_PollControl,
+                                                            &sPollControlServerCluster,
+                                                            &au8PollControlAttributeControlBits[0],
+                                                            &sPollControlClusterData);
+
+    if(status != E_ZCL_SUCCESS)
+        DBG_vPrintf(TRUE, "BasicClusterEndpoint::registerPollControlCluster(): Failed to create Poll Control Cluster instance. Status=%d\n", status);
+}
+
+void BasicClusterEndpoint::registerDiagnosticsCluster()
+{
+    // Create an instance of a diagnostics cluster as a server
+    teZCL_Status status = eCLD_DiagnosticsCreateDiagnostics(&clusterInstances.sDiagnosticsServer,
+                                                            TRUE,
+                                                            &sCLD_Diagnostics,
+                                                            &sDiagnosticsServerCluster,
+                                                            &au8DiagnosticsAttributeControlBits[0]);
+
+    if(status != E_ZCL_SUCCESS)
+        DBG_vPrintf(TRUE, "BasicClusterEndpoint::registerDiagnosticsCluster(): Failed to create Diagnostics Cluster instance. Status=%d\n", status);
+}
+
+void BasicClusterEndpoint::registerLatencyProbeCluster()
+{
+    // Create an instance of a latency probe cluster as a server
+    teZCL_Status status = eCLD_LatencyProbeCreateLatencyProbe(&clusterInstances.sLatencyProbeServer,
+                                                              TRUE,
+                                                              &sCLD_LatencyProbe,
+                                                              &sLatencyProbeServerCluster,
+                                                              &au8LatencyProbeAttributeControlBits[0],
+                                                              &sLatencyProbeClusterData);
+
+    if(status != E_ZCL_SUCCESS)
+        DBG_vPrintf(TRUE, "BasicClusterEndpoint::registerLatencyProbeCluster(): Failed to create Latency Probe Cluster instance. Status=%d\n", status);
+}
+
 void BasicClusterEndpoint::registerEndpoint()
 {
     // Fill in end point details
@@ -94,6 +156,10 @@ void BasicClusterEndpoint::init()
     registerIdentifyCluster();
     registerOtaCluster();
     registerDeviceTemperatureCluster();
+    registerDeviceStatsCluster();
+    registerPollControlCluster();
+    registerDiagnosticsCluster();
+    registerLatencyProbeCluster();
     registerEndpoint();
 
     // Fill Basic cluster attributes
@@ -104,7 +170,38 @@ void BasicClusterEndpoint::init()
     sBasicServerCluster.eGenericDeviceType = E_CLD_BAS_GENERIC_DEVICE_TYPE_WALL_SWITCH;
 
     // Initialize OTA
-    otaHandlers.initOTA(getEndpointId());
+    otaHandlers.initOTA(getEndpointId(), &sOTAClientCluster);
+
+    // Restore poll control settings
+    pollControlHandlers.init(getEndpointId(), &sPollControlServerCluster);
+
+    // Start measuring the device temperature in the background
+    TemperatureSampler::getInstance()->init(getEndpointId(), &sDeviceTemperatureServerCluster);
+
+    // Start collecting network performance counters
+    DiagnosticsCollector::getInstance()->init(getEndpointId(), &sDiagnosticsServerCluster);
+
+    latencyProbeHandlers.init(getEndpointId(), &sLatencyProbeServerCluster);
+}
+
+void BasicClusterEndpoint::handleDeviceJoin()
+{
+    pollControlHandlers.handleDeviceJoin();
+}
+
+void BasicClusterEndpoint::handleParentPoll()
+{
+    pollControlHandlers.handleParentPoll();
+}
+
+void BasicClusterEndpoint::handleSleep()
+{
+    otaHandlers.handleSleep();
+}
+
+void BasicClusterEndpoint::handleIdle()
+{
+    otaHandlers.handleIdle();
 }
 
 void BasicClusterEndpoint::handleClusterUpdate(tsZCL_CallBackEvent *psEvent)
@@ -121,6 +218,10 @@ void BasicClusterEndpoint::handleClusterUpdate(tsZCL_CallBackEvent *psEvent)
             handleOTAClusterUpdate(psEvent);
             break;
 
+        case GENERAL_CLUSTER_ID_POLL_CONTROL:
+            // Attribute changes are processed in handleWriteAttributeCompleted()
+            break;
+
         default:
             DBG_vPrintf(TRUE, "BasicClusterEndpoint EP=%d: Warning: Unexpected cluster update message ClusterID=%04x\n", clusterId);
             break;
@@ -141,6 +242,14 @@ void BasicClusterEndpoint::handleCustomClusterEvent(tsZCL_CallBackEvent *psEvent
             handleOTAClusterEvent(psEvent);
             break;
 
+        case GENERAL_CLUSTER_ID_POLL_CONTROL:
+            handlePollControlClusterEvent(psEvent);
+            break;
+
+        case GENERAL_CLUSTER_ID_LATENCY_PROBE:
+            handleLatencyProbeClusterEvent(psEvent);
+            break;
+
         default:
             DBG_vPrintf(TRUE, "BasicClusterEndpoint EP=%d: Warning: Unexpected custom cluster event ClusterID=%04x\n", 
                         getEndpointId(), clusterId);
@@ -196,6 +305,18 @@ void BasicClusterEndpoint::handleOTAClusterUpdate(tsZCL_CallBackEvent *psEvent)
     otaHandlers.handleOTAMessage(psCallBackMessage);
 }
 
+void BasicClusterEndpoint::handlePollControlClusterEvent(tsZCL_CallBackEvent *psEvent)
+{
+    tsCLD_PollControlCallBackMessage * msg = (tsCLD_PollControlCallBackMessage *)psEvent->uMessage.sClusterCustomMessage.pvCustomData;
+    pollControlHandlers.handlePollControlMessage(msg);
+}
+
+void BasicClusterEndpoint::handleLatencyProbeClusterEvent(tsZCL_CallBackEvent *psEvent)
+{
+    // Answered right away, any delay here would be counted as the network latency
+    latencyProbeHandlers.handleLatencyProbeMessage(psEvent);
+}
+
 teZCL_CommandStatus BasicClusterEndpoint::handleReadAttribute(tsZCL_CallBackEvent *psEvent)
 {
     uint16 clusterId = psEvent->pZPSevent->uEvent.sApsDataIndEvent.u16ClusterId;
@@ -203,31 +324,104 @@ teZCL_CommandStatus BasicClusterEndpoint::handleReadAttribute(tsZCL_CallBackEven
     switch(clusterId)
     {
         case GENERAL_CLUSTER_ID_DEVICE_TEMPERATURE_CONFIGURATION:
-            readDeviceTemperature();
+            // Attributes are kept up to date by the background sampler
+            TemperatureSampler::getInstance()->handleCachedRead();
+            break;
+
+        case GENERAL_CLUSTER_ID_DEVICE_STATS:
+            readDeviceStats();
+            break;
+
+        case GENERAL_CLUSTER_ID_DIAGNOSTICS:
+            // Some counters are kept by other modules, and do not trigger an update by themselves
+            DiagnosticsCollector::getInstance()->refresh();
             break;
     }
 
     return E_ZCL_CMDS_SUCCESS;
 }
 
-void BasicClusterEndpoint::readDeviceTemperature()
+void BasicClusterEndpoint::handleWriteAttributeCompleted(tsZCL_CallBackEvent *psEvent)
+{
+    uint16 clusterId = psEvent->psClusterInstance->psClusterDefinition->u16ClusterEnum;
+    uint16 attrId = psEvent->uMessage.sIndividualAttributeResponse.u16AttributeEnum;
+
+    if(clusterId == GENERAL_CLUSTER_ID_POLL_CONTROL)
+        pollControlHandlers.handleAttributeWrite(attrId);
+
+    if(clusterId == GENERAL_CLUSTER_ID_DEVICE_TEMPERATURE_CONFIGURATION)
+        TemperatureSampler::getInstance()->handleConfigurationChange();
+}
+
+teZCL_CommandStatus BasicClusterEndpoint::handleCheckAttributeRange(tsZCL_CallBackEvent *psEvent)
 {
-    // Enable the ADC and configure it to measure the temperature
-    vAHI_ApConfigure(E_AHI_AP_REGULATOR_ENABLE, E_AHI_AP_INT_DISABLE, E_AHI_AP_SAMPLE_2, E_AHI_AP_CLOCKDIV_500KHZ, E_AHI_AP_INTREF);
-    vAHI_AdcEnable(E_AHI_ADC_SINGLE_SHOT, E_AHI_AP_INPUT_RANGE_1, E_AHI_ADC_SRC_TEMP);
+    uint16 clusterId = psEvent->psClusterInstance->psClusterDefinition->u16ClusterEnum;
+    uint16 attrId = psEvent->uMessage.sIndividualAttributeResponse.u16AttributeEnum;
 
-    // Perform single shot measurement
-    vAHI_AdcStartSample();
-    while((bAHI_AdcPoll()))
-        ;
+    // Poll intervals depend on each other, and shall be validated together
+    if(clusterId == GENERAL_CLUSTER_ID_POLL_CONTROL)
+        return pollControlHandlers.checkAttributeRange(attrId, psEvent->uMessage.sIndividualAttributeResponse.pvAttributeData);
 
-    // Convert the raw value to temperature in Celsius
-    uint16 rawValue = u16AHI_AdcRead();
-    float mV = (float)rawValue * 1.2  / 1024 * 1000;
-    sDeviceTemperatureServerCluster.i16CurrentTemperature = (int)((mV - 720.) / (-1.66) + 25);
+    return E_ZCL_CMDS_SUCCESS;
+}
 
-    DBG_vPrintf(TRUE, "BasicClusterEndpoint: Temperature: %d (raw value: %d)\n", sDeviceTemperatureServerCluster.i16CurrentTemperature, rawValue);
+void BasicClusterEndpoint::readDeviceStats()
+{
+    // Refresh sleep veto statistics
+    SleepManager * sleepManager = SleepManager::getInstance();
+    sDeviceStatsServerCluster.u8SleepVetoMask = sleepManager->getVetoMask();
+    for(uint8 i = 0; i < CLD_DEVICE_STATS_MAX_SLEEP_PARTICIPANTS; i++)
+    {
+        const SleepParticipantRecord * record = sleepManager->getParticipantRecord(i);
+        sDeviceStatsServerCluster.au32SleepVetoTime[i] = record ? record->vetoTime : 0;
+    }
 
-    // Disable the ADC
-    vAHI_AdcDisable();
+    // Refresh parent poll statistics
+    const PollStatistics & pollStats = ZigbeeDevice::getInstance()->getPollStatistics();
+    sDeviceStatsServerCluster.u32PollsSent = pollStats.pollsSent;
+    sDeviceStatsServerCluster.u32PollDataReceived = pollStats.dataReceived;
+    sDeviceStatsServerCluster.u32EmptyPolls = pollStats.emptyPolls;
+
+    // Refresh network recovery statistics
+    const RejoinStatistics & rejoinStats = ZigbeeDevice::getInstance()->getRejoinStatistics();
+    sDeviceStatsServerCluster.u32Rejoins = rejoinStats.rejoins;
+    sDeviceStatsServerCluster.u32LastTimeToRejoin = rejoinStats.lastTimeToRejoin;
+    sDeviceStatsServerCluster.u32MaxTimeToRejoin = rejoinStats.maxTimeToRejoin;
+    sDeviceStatsServerCluster.u32TargetedRejoins = rejoinStats.attempts[REJOIN_STAGE_TARGETED];
+    sDeviceStatsServerCluster.u32ScanRejoins = rejoinStats.attempts[REJOIN_STAGE_CHANNEL_SCAN];
+    sDeviceStatsServerCluster.u32TcRejoins = rejoinStats.attempts[REJOIN_STAGE_TRUST_CENTER];
+
+    const AddressLookupStatistics & addrStats = ZigbeeDevice::getInstance()->getAddressStatistics();
+    sDeviceStatsServerCluster.u32BroadcastsAvoided = addrStats.broadcastsAvoided;
+    sDeviceStatsServerCluster.u32BroadcastLookups = addrStats.broadcastLookups;
+
+    const ReportStatistics & reportStats = ReportAggregator::getInstance()->getStatistics();
+    sDeviceStatsServerCluster.u32ReportFramesSent = reportStats.framesSent;
+    sDeviceStatsServerCluster.u32ReportFramesSaved = reportStats.framesSaved;
+
+    sDeviceStatsServerCluster.u32LoopbackCommands = EndpointManager::getInstance()->getLoopbackStatistics().commands;
+
+    const FanoutStatistics & fanoutStats = GroupFanout::getInstance()->getStatistics();
+    sDeviceStatsServerCluster.u32UnicastFanouts = fanoutStats.unicastFanouts;
+    sDeviceStatsServerCluster.u32FanoutGroupcasts = fanoutStats.groupcasts;
+
+    const OutboundStatistics & outboundStats = DeliveryTracker::getInstance()->getStatistics();
+    sDeviceStatsServerCluster.u32MessagesDelivered = outboundStats.delivered;
+    sDeviceStatsServerCluster.u32MessagesRetried = outboundStats.retried;
+    sDeviceStatsServerCluster.u32MessagesDropped = outboundStats.dropped;
+
+    const TemperatureStatistics & temperatureStats = TemperatureSampler::getInstance()->getStatistics();
+    sDeviceStatsServerCluster.u32TemperatureSamples = temperatureStats.samples;
+    sDeviceStatsServerCluster.u32CachedTempReads = temperatureStats.cachedReads;
+
+    // Values of the last periodic check, the APDU pools are not probed while a request is being processed
+    const MemoryStatistics & memoryStats = MemoryMonitor::getInstance()->getStatistics();
+    sDeviceStatsServerCluster.u32StackSize = memoryStats.stackSize;
+    sDeviceStatsServerCluster.u32StackMaxUsed = memoryStats.stackMaxUsed;
+    sDeviceStatsServerCluster.u32HeapSize = memoryStats.heapSize;
+    sDeviceStatsServerCluster.u32HeapMaxUsed = memoryStats.heapMaxUsed;
+    sDeviceStatsServerCluster.u8FreeZclApdus = memoryStats.freeZclApdus;
+    sDeviceStatsServerCluster.u8MinFreeZclApdus = memoryStats.minFreeZclApdus;
+    sDeviceStatsServerCluster.u8FreeZdpApdus = memoryStats.freeZdpApdus;
+    sDeviceStatsServerCluster.u8MinFreeZdpApdus = memoryStats.minFreeZdpApdus;
 }
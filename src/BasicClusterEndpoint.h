@@ -3,6 +3,8 @@
 
 #include "Endpoint.h"
 #include "OTAHandlers.h"
+#include "PollControlHandlers.h"
+#include "LatencyProbeHandlers.h"
 
 extern "C"
 {
@@ -10,6 +12,10 @@ extern "C"
     #include "Basic.h"
     #include "Identify.h"
     #include "DeviceTemperatureConfiguration.h"
+    #include "DeviceStats.h"
+    #include "DiagnosticsCluster.h"
+    #include "LatencyProbe.h"
+    #include "PollControl.h"
 }
 
 // List of cluster instances (descriptor objects) that are included into an Endpoint
@@ -26,6 +32,18 @@ struct BasicClusterInstances
 
     // The device will report its temperature over the Device Temperature Configuration cluster
     tsZCL_ClusterInstance sDeviceTemperatureServer;
+
+    // Manufacturer specific device statistics (sleep veto times, etc)
+    tsZCL_ClusterInstance sDeviceStatsServer;
+
+    // Sleepy device poll settings and check-ins
+    tsZCL_ClusterInstance sPollControlServer;
+
+    // Network performance counters (MAC/APS retries and failures, LQI, etc)
+    tsZCL_ClusterInstance sDiagnosticsServer;
+
+    // Echo requests for the round trip time measurements
+    tsZCL_ClusterInstance sLatencyProbeServer;
 } __attribute__ ((aligned(4)));
 
 class BasicClusterEndpoint : public Endpoint
@@ -40,33 +58,54 @@ class BasicClusterEndpoint : public Endpoint
     tsCLD_Identify sIdentifyServerCluster;
     tsCLD_IdentifyCustomDataStructure sIdentifyClusterData;
     tsCLD_DeviceTemperatureConfiguration sDeviceTemperatureServerCluster;
+    tsCLD_DeviceStats sDeviceStatsServerCluster;
+    tsCLD_PollControl sPollControlServerCluster;
+    tsCLD_PollControlCustomDataStructure sPollControlClusterData;
+    tsCLD_Diagnostics sDiagnosticsServerCluster;
+    tsCLD_LatencyProbe sLatencyProbeServerCluster;
+    tsCLD_LatencyProbeCustomDataStructure sLatencyProbeClusterData;
     tsCLD_AS_Ota sOTAClientCluster;
     tsOTA_Common sOTACustomDataStruct;
 
     OTAHandlers otaHandlers;
+    PollControlHandlers pollControlHandlers;
+    LatencyProbeHandlers latencyProbeHandlers;
 
 public:
     BasicClusterEndpoint();
 
     virtual void init();
 
+    virtual void handleDeviceJoin();
+    virtual void handleParentPoll();
+    void handleSleep();
+    void handleIdle();
+
 protected:
     virtual void registerBasicCluster();
     virtual void registerIdentifyCluster();
     virtual void registerOtaCluster();
     virtual void registerDeviceTemperatureCluster();
+    virtual void registerDeviceStatsCluster();
+    virtual void registerPollControlCluster();
+    virtual void registerDiagnosticsCluster();
+    virtual void registerLatencyProbeCluster();
     virtual void registerEndpoint();
 
     virtual void handleClusterUpdate(tsZCL_CallBackEvent *psEvent);
     virtual void handleCustomClusterEvent(tsZCL_CallBackEvent *psEvent);
     virtual teZCL_CommandStatus handleReadAttribute(tsZCL_CallBackEvent *psEvent);
+    virtual void handleWriteAttributeCompleted(tsZCL_CallBackEvent *psEvent);
+    virtual teZCL_CommandStatus handleCheckAttributeRange(tsZCL_CallBackEvent *psEvent);
 
     void handleIdentifyClusterEvent(tsZCL_CallBackEvent *psEvent);
     void handleOTAClusterEvent(tsZCL_CallBackEvent *psEvent);
+    void handlePollControlClusterEvent(tsZCL_CallBackEvent *psEvent);
+    void handleLatencyProbeClusterEvent(tsZCL_CallBackEvent *psEvent);
     void handleIdentifyClusterUpdate(tsZCL_CallBackEvent *psEvent);
     void handleOTAClusterUpdate(tsZCL_CallBackEvent *psEvent);
 
-    void readDeviceTemperature();
+    void readDeviceStats();
 };
 
 #endif // BASICCLUSTERENDPOINT_H
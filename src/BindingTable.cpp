@@ -0,0 +1,60 @@
+extern "C"
+{
+    #include "jendefs.h"
+    #include "bdb_api.h"
+
+    #ifndef _appZpsBeaconHandler_h_fixed_
+    #define _appZpsBeaconHandler_h_fixed_
+    }// missed '}' in appZpsBeaconHandler.h
+    #endif //_appZpsBeaconHandler_h_fixed_
+}
+
+#include "BindingTable.h"
+
+uint8 BindingTable::getTargets(uint8 srcEndpoint, uint16 clusterId, BindingTarget * targets, uint8 maxTargets)
+{
+    ZPS_tsAplAib * aib = ZPS_psAplAibGetAib();
+    ZPS_tsAplApsmeBindingTable * table = aib->psAplApsmeAibBindingTable->psAplApsmeBindingTable;
+    if(!table)
+        return 0;
+
+    uint64 ownIeeeAddr = ZPS_u64AplZdoGetIeeeAddr();
+    uint8 numTargets = 0;
+    for(uint32 i = 0; i < table->u32SizeOfBindingTable && numTargets < maxTargets; i++)
+    {
+        ZPS_tsAplApsmeBindingTableStoreEntry * entry = table->pvAplApsmeBindingTableEntryForSpSrcAddr + i;
+        if(entry->u8SourceEndpoint != srcEndpoint || entry->u16ClusterId != clusterId)
+            continue;
+
+        BindingTarget & target = targets[numTargets];
+        target.addrMode = entry->u8DstAddrMode;
+        target.dstEndpoint = entry->u8DestinationEndPoint;
+        target.ieeeAddr = 0;
+        target.groupAddr = 0;
+        target.local = false;
+
+        if(entry->u8DstAddrMode == ZPS_E_ADDR_MODE_IEEE)
+        {
+            // IEEE address is stored as an index in the MAC address table
+            target.ieeeAddr = ZPS_u64NwkNibGetMappedIeeeAddr(ZPS_pvAplZdoGetNwkHandle(), entry->u16AddrOrLkUp);
+            target.local = (target.ieeeAddr == ownIeeeAddr);
+        }
+        else if(entry->u8DstAddrMode == ZPS_E_ADDR_MODE_GROUP)
+            target.groupAddr = entry->u16AddrOrLkUp;
+        else
+            continue;   // Unused entry
+
+        numTargets++;
+    }
+
+    return numTargets;
+}
+
+bool BindingTable::hasLocalTargets(const BindingTarget * targets, uint8 numTargets)
+{
+    for(uint8 i = 0; i < numTargets; i++)
+        if(targets[i].local)
+            return true;
+
+    return false;
+}
@@ -0,0 +1,29 @@
+#ifndef BINDINGTABLE_H
+#define BINDINGTABLE_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// A single destination of the bound sends
+struct BindingTarget
+{
+    uint8 addrMode;         // ZPS_E_ADDR_MODE_IEEE or ZPS_E_ADDR_MODE_GROUP
+    uint64 ieeeAddr;        // For IEEE address mode
+    uint16 groupAddr;       // For group address mode
+    uint8 dstEndpoint;
+    bool local;             // The target is an endpoint of this very device
+};
+
+// Read-only view over the stack's binding table
+class BindingTable
+{
+public:
+    static const uint8 MAX_TARGETS = 16;
+
+    static uint8 getTargets(uint8 srcEndpoint, uint16 clusterId, BindingTarget * targets, uint8 maxTargets);
+    static bool hasLocalTargets(const BindingTarget * targets, uint8 numTargets);
+};
+
+#endif // BINDINGTABLE_H
@@ -1,6 +1,7 @@
 #include "ZigbeeDevice.h"
 #include "ButtonsTask.h"
 #include "IButtonHandler.h"
+#include "SystemClock.h"
 
 
 // Note: Object constructors are not executed by CRT if creating a global var of this object :(
@@ -51,6 +52,16 @@ bool ButtonsTask::canSleep() const
     return idleCounter > 5000 / ButtonPollCycle; // 500 cycles * 10 ms = 5 sec
 }
 
+SleepVetoReason ButtonsTask::getSleepVeto(uint32 * earliestSleepTime)
+{
+    if(canSleep())
+        return SLEEP_VETO_NONE;
+
+    uint32 remainingCycles = 5000 / ButtonPollCycle + 1 - idleCounter;
+    *earliestSleepTime = SystemClock::getInstance()->getTimeMs() + remainingCycles * ButtonPollCycle;
+    return SLEEP_VETO_BUTTON_ACTIVITY;
+}
+
 void ButtonsTask::registerHandler(uint32 pinMask, IButtonHandler * handler)
 {
     DBG_vPrintf(TRUE, "ButtonsTask::registerHandler(): Registering a handler for mask=%08x\n", pinMask);
@@ -8,6 +8,7 @@ extern "C"
 }
 
 #include "PeriodicTask.h"
+#include "ISleepParticipant.h"
 #include "Queue.h"
 
 class IButtonHandler;
@@ -18,7 +19,7 @@ struct HandlerRecord
     IButtonHandler * handler;
 };
 
-class ButtonsTask : public PeriodicTask
+class ButtonsTask : public PeriodicTask, public ISleepParticipant
 {
     uint32 idleCounter;
     uint32 longPressCounter;
@@ -38,6 +39,7 @@ public:
     
     bool handleDioInterrupt(uint32 dioStatus);
     bool canSleep() const;
+    virtual SleepVetoReason getSleepVeto(uint32 * earliestSleepTime);
 
     void registerHandler(uint32 pinMask, IButtonHandler * handler);
 
@@ -1,5 +1,16 @@
 #include "DebugInput.h"
 #include "ButtonsTask.h"
+#include "SleepManager.h"
+#include "ZigbeeDevice.h"
+#include "ReportAggregator.h"
+#include "EndpointManager.h"
+#include "GroupFanout.h"
+#include "DeliveryTracker.h"
+#include "ReportManager.h"
+#include "ZCLTimer.h"
+#include "TemperatureSampler.h"
+#include "DiagnosticsCollector.h"
+#include "MemoryMonitor.h"
 
 extern "C"
 {
@@ -96,5 +107,83 @@ void DebugInput::handleInput()
         DBG_vPrintf(TRUE, "Matched BTNx_RELEASE\n");
     }
 
+    if(matchCommand("SLEEP_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched SLEEP_STATS\n");
+        SleepManager::getInstance()->dumpStatistics();
+    }
+
+    if(matchCommand("POLL_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched POLL_STATS\n");
+        ZigbeeDevice::getInstance()->dumpPollStatistics();
+    }
+
+    if(matchCommand("REJOIN_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched REJOIN_STATS\n");
+        ZigbeeDevice::getInstance()->dumpRejoinStatistics();
+    }
+
+    if(matchCommand("ADDR_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched ADDR_STATS\n");
+        ZigbeeDevice::getInstance()->dumpAddressStatistics();
+    }
+
+    if(matchCommand("REPORT_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched REPORT_STATS\n");
+        ReportAggregator::getInstance()->dumpStatistics();
+    }
+
+    if(matchCommand("LOOPBACK_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched LOOPBACK_STATS\n");
+        EndpointManager::getInstance()->dumpLoopbackStatistics();
+    }
+
+    if(matchCommand("FANOUT_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched FANOUT_STATS\n");
+        GroupFanout::getInstance()->dumpStatistics();
+    }
+
+    if(matchCommand("OUTBOUND_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched OUTBOUND_STATS\n");
+        DeliveryTracker::getInstance()->dumpStatistics();
+    }
+
+    if(matchCommand("REPORT_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched REPORT_STATS\n");
+        ReportManager::getInstance()->dumpStatistics();
+    }
+
+    if(matchCommand("ZCL_TIMER_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched ZCL_TIMER_STATS\n");
+        ZCLTimer::getInstance()->dumpStatistics();
+    }
+
+    if(matchCommand("TEMPERATURE_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched TEMPERATURE_STATS\n");
+        TemperatureSampler::getInstance()->dumpStatistics();
+    }
+
+    if(matchCommand("DIAGNOSTICS_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched DIAGNOSTICS_STATS\n");
+        DiagnosticsCollector::getInstance()->dumpStatistics();
+    }
+
+    if(matchCommand("MEMORY_STATS"))
+    {
+        DBG_vPrintf(TRUE, "Matched MEMORY_STATS\n");
+        MemoryMonitor::getInstance()->dumpStatistics();
+    }
+
     reset();
 }
@@ -0,0 +1,138 @@
+extern "C"
+{
+    #include "jendefs.h"
+    #include "dbg.h"
+    #include "zcl.h"
+}
+
+#include "DeliveryTracker.h"
+#include "ReportAggregator.h"
+#include "EndpointManager.h"
+#include "ZigbeeDevice.h"
+#include "SystemClock.h"
+
+// Reports are always sent to the coordinator
+static const uint16 COORDINATOR_ADDR = 0x0000;
+
+DeliveryTracker::DeliveryTracker()
+{
+}
+
+DeliveryTracker * DeliveryTracker::getInstance()
+{
+    static DeliveryTracker instance;
+    return &instance;
+}
+
+void DeliveryTracker::trackReport(const ReportRecord * frame, uint8 numRecords, uint8 apsSeq)
+{
+    uint32 now = SystemClock::getInstance()->getTimeMs();
+    for(uint8 i = 0; i < numRecords; i++)
+    {
+        if(!queue.handleReportSent(frame[i].endpoint, frame[i].clusterId, frame[i].attributeId, apsSeq, now))
+            DBG_vPrintf(TRUE, "DeliveryTracker: No room to track attribute %04x of cluster %04x on EP=%d\n",
+                        frame[i].attributeId, frame[i].clusterId, frame[i].endpoint);
+    }
+}
+
+void DeliveryTracker::handleReportDropped()
+{
+    queue.handleDropped();
+}
+
+void DeliveryTracker::holdCommand(uint8 endpoint, uint8 commandId)
+{
+    DBG_vPrintf(TRUE, "DeliveryTracker: Holding On/Off command %02x for EP=%d\n", commandId, endpoint);
+    if(!queue.queueCommand(endpoint, GENERAL_CLUSTER_ID_ONOFF, commandId, SystemClock::getInstance()->getTimeMs()))
+        DBG_vPrintf(TRUE, "DeliveryTracker: No room to hold the command. Dropped\n");
+}
+
+void DeliveryTracker::handleCommandFailed(uint8 endpoint, uint8 commandId)
+{
+    OutboundCommand command;
+    command.endpoint = endpoint;
+    command.clusterId = GENERAL_CLUSTER_ID_ONOFF;
+    command.commandId = commandId;
+    command.attempts = 0;
+    command.queuedTime = SystemClock::getInstance()->getTimeMs();
+    command.nextAttemptTime = command.queuedTime;
+
+    if(!queue.retryCommand(command, command.queuedTime))
+        DBG_vPrintf(TRUE, "DeliveryTracker: On/Off command %02x for EP=%d dropped\n", commandId, endpoint);
+}
+
+void DeliveryTracker::handleDataConfirm(ZPS_tsAfEvent * pEvent)
+{
+    uint32 now = SystemClock::getInstance()->getTimeMs();
+
+    // The confirm tells only that the frame has left the device (or has not). Delivery is confirmed by the APS ack.
+    if(pEvent->eType == ZPS_EVENT_APS_DATA_CONFIRM)
+    {
+        ZPS_tsAfDataConfEvent * pConfirm = &pEvent->uEvent.sApsDataConfirmEvent;
+        if(pConfirm->u8Status != ZPS_E_SUCCESS &&
+           pConfirm->u8DstAddrMode == ZPS_E_ADDR_MODE_SHORT &&
+           pConfirm->uDstAddr.u16Addr == COORDINATOR_ADDR)
+        {
+            queue.handleDelivery(pConfirm->u8SequenceNum, false, now);
+        }
+    }
+    else if(pEvent->eType == ZPS_EVENT_APS_DATA_ACK)
+    {
+        ZPS_tsAfDataAckEvent * pAck = &pEvent->uEvent.sApsDataAckEvent;
+        if(pAck->u16DstAddr == COORDINATOR_ADDR)
+            queue.handleDelivery(pAck->u8SequenceNum, pAck->u8Status == ZPS_E_SUCCESS, now);
+    }
+}
+
+void DeliveryTracker::handleDeviceJoin()
+{
+    // Do not wait for back-off delays, send everything collected while the device was off the network
+    queue.expedite(SystemClock::getInstance()->getTimeMs());
+    flush();
+    ReportAggregator::getInstance()->flush();
+}
+
+void DeliveryTracker::flush()
+{
+    if(!ZigbeeDevice::getInstance()->isJoined())
+        return;
+
+    uint32 now = SystemClock::getInstance()->getTimeMs();
+
+    // Reports to retry go along with other attribute changes of this iteration, with the current attribute value
+    ReportRecord records[OutboundQueue::MAX_REPORTS];
+    uint8 numRecords = queue.takeDueReports(now, records, OutboundQueue::MAX_REPORTS);
+    for(uint8 i = 0; i < numRecords; i++)
+    {
+        DBG_vPrintf(TRUE, "DeliveryTracker: Reporting attribute %04x of cluster %04x on EP=%d again\n",
+                    records[i].attributeId, records[i].clusterId, records[i].endpoint);
+        if(ReportAggregator::getInstance()->markDirty(records[i].endpoint, records[i].clusterId, records[i].attributeId) != E_ZCL_SUCCESS)
+            queue.handleDropped();
+    }
+
+    OutboundCommand command;
+    while(queue.takeDueCommand(now, &command))
+    {
+        DBG_vPrintf(TRUE, "DeliveryTracker: Sending held On/Off command %02x for EP=%d\n", command.commandId, command.endpoint);
+        if(EndpointManager::getInstance()->replayBoundCommand(command.endpoint, command.clusterId, command.commandId))
+            queue.handleCommandSent();
+        else if(!queue.retryCommand(command, now))
+            DBG_vPrintf(TRUE, "DeliveryTracker: On/Off command %02x for EP=%d dropped\n", command.commandId, command.endpoint);
+    }
+}
+
+const OutboundStatistics & DeliveryTracker::getStatistics() const
+{
+    return queue.getStatistics();
+}
+
+void DeliveryTracker::dumpStatistics() const
+{
+    const OutboundStatistics & stats = queue.getStatistics();
+    DBG_vPrintf(TRUE, "\n+++++++ Outbound delivery statistics:\n");
+    DBG_vPrintf(TRUE, "    Messages queued: %d\n", stats.queued);
+    DBG_vPrintf(TRUE, "    Delivered: %d\n", stats.delivered);
+    DBG_vPrintf(TRUE, "    Retried: %d\n", stats.retried);
+    DBG_vPrintf(TRUE, "    Dropped: %d\n", stats.dropped);
+    DBG_vPrintf(TRUE, "    Commands held: %d\n", queue.getNumCommands());
+}
@@ -0,0 +1,41 @@
+#ifndef DELIVERYTRACKER_H
+#define DELIVERYTRACKER_H
+
+extern "C"
+{
+    #include "jendefs.h"
+    #include "zps_apl_af.h"
+}
+
+#include "OutboundQueue.h"
+
+// Makes sure attribute reports and bound On/Off commands reach their destination.
+//
+// Reports sent to the coordinator are tracked by the APS sequence number. If the APS ack does not come, the
+// attributes are reported again with a back-off delay. On/Off commands issued while the device is off the network
+// (or that failed to be sent) are held and replayed once the network is available again. Everything pending is
+// flushed right after the device joins or rejoins the network.
+class DeliveryTracker
+{
+    OutboundQueue queue;
+
+private:
+    DeliveryTracker();
+
+public:
+    static DeliveryTracker * getInstance();
+
+    void trackReport(const ReportRecord * frame, uint8 numRecords, uint8 apsSeq);
+    void handleReportDropped();
+    void holdCommand(uint8 endpoint, uint8 commandId);
+    void handleCommandFailed(uint8 endpoint, uint8 commandId);
+    void handleDataConfirm(ZPS_tsAfEvent * pEvent);
+
+    void handleDeviceJoin();
+    void flush();
+
+    const OutboundStatistics & getStatistics() const;
+    void dumpStatistics() const;
+};
+
+#endif // DELIVERYTRACKER_H
@@ -0,0 +1,104 @@
+#include <jendefs.h>
+#include <string.h>
+#include "zcl.h"
+#include "zcl_options.h"
+#include "DeviceStats.h"
+
+#ifdef CLD_DEVICE_STATS
+
+#define SLEEP_VETO_TIME_ATTR(idx) \
+    {E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_TIME_0 + idx, (E_ZCL_AF_RD|E_ZCL_AF_MS), E_ZCL_UINT32, (uint32)(&((tsCLD_DeviceStats*)(0))->au32SleepVetoTime[idx]), 0}
+
+const tsZCL_AttributeDefinition asCLD_DeviceStatsClusterAttributeDefinitions[] = {
+#ifdef DEVICE_STATS_SERVER
+    {E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_MASK,    (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_BMAP8,    (uint32)(&((tsCLD_DeviceStats*)(0))->u8SleepVetoMask), 0},
+    SLEEP_VETO_TIME_ATTR(0),
+    SLEEP_VETO_TIME_ATTR(1),
+    SLEEP_VETO_TIME_ATTR(2),
+    SLEEP_VETO_TIME_ATTR(3),
+    SLEEP_VETO_TIME_ATTR(4),
+    SLEEP_VETO_TIME_ATTR(5),
+    SLEEP_VETO_TIME_ATTR(6),
+    SLEEP_VETO_TIME_ATTR(7),
+
+    {E_CLD_DEVICE_STATS_ATTR_ID_POLLS_SENT,         (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32PollsSent), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_POLL_DATA_RECEIVED, (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32PollDataReceived), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_EMPTY_POLLS,        (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32EmptyPolls), 0},
+
+    {E_CLD_DEVICE_STATS_ATTR_ID_REJOINS,            (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32Rejoins), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_LAST_TIME_TO_REJOIN,(E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32LastTimeToRejoin), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_MAX_TIME_TO_REJOIN, (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32MaxTimeToRejoin), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_TARGETED_REJOINS,   (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32TargetedRejoins), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_SCAN_REJOINS,       (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32ScanRejoins), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_TC_REJOINS,         (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32TcRejoins), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_BROADCASTS_AVOIDED, (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32BroadcastsAvoided), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_BROADCAST_LOOKUPS,  (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32BroadcastLookups), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_REPORT_FRAMES_SENT, (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32ReportFramesSent), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_REPORT_FRAMES_SAVED,(E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32ReportFramesSaved), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_LOOPBACK_COMMANDS,  (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32LoopbackCommands), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_UNICAST_FANOUTS,    (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32UnicastFanouts), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_FANOUT_GROUPCASTS,  (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32FanoutGroupcasts), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_MESSAGES_DELIVERED, (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32MessagesDelivered), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_MESSAGES_RETRIED,   (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32MessagesRetried), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_MESSAGES_DROPPED,   (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32MessagesDropped), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_TEMPERATURE_SAMPLES,(E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32TemperatureSamples), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_CACHED_TEMP_READS,  (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32CachedTempReads), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_STACK_SIZE,         (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32StackSize), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_STACK_MAX_USED,     (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32StackMaxUsed), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_HEAP_SIZE,          (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32HeapSize), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_HEAP_MAX_USED,      (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT32,   (uint32)(&((tsCLD_DeviceStats*)(0))->u32HeapMaxUsed), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_FREE_ZCL_APDUS,     (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT8,    (uint32)(&((tsCLD_DeviceStats*)(0))->u8FreeZclApdus), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_MIN_FREE_ZCL_APDUS, (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT8,    (uint32)(&((tsCLD_DeviceStats*)(0))->u8MinFreeZclApdus), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_FREE_ZDP_APDUS,     (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT8,    (uint32)(&((tsCLD_DeviceStats*)(0))->u8FreeZdpApdus), 0},
+    {E_CLD_DEVICE_STATS_ATTR_ID_MIN_FREE_ZDP_APDUS, (E_ZCL_AF_RD|E_ZCL_AF_MS),              E_ZCL_UINT8,    (uint32)(&((tsCLD_DeviceStats*)(0))->u8MinFreeZdpApdus), 0},
+#endif
+    {E_CLD_GLOBAL_ATTR_ID_CLUSTER_REVISION,         (E_ZCL_AF_RD|E_ZCL_AF_GA),              E_ZCL_UINT16,   (uint32)(&((tsCLD_DeviceStats*)(0))->u16ClusterRevision), 0},   // Mandatory
+};
+
+tsZCL_ClusterDefinition sCLD_DeviceStats = {
+        GENERAL_CLUSTER_ID_DEVICE_STATS,
+        TRUE,
+        E_ZCL_SECURITY_NETWORK,
+        (sizeof(asCLD_DeviceStatsClusterAttributeDefinitions) / sizeof(tsZCL_AttributeDefinition)),
+        (tsZCL_AttributeDefinition*)asCLD_DeviceStatsClusterAttributeDefinitions,
+        NULL
+};
+
+uint8 au8DeviceStatsAttributeControlBits[(sizeof(asCLD_DeviceStatsClusterAttributeDefinitions) / sizeof(tsZCL_AttributeDefinition))];
+
+PUBLIC teZCL_Status eCLD_DeviceStatsCreateDeviceStats(
+                tsZCL_ClusterInstance              *psClusterInstance,
+                bool_t                              bIsServer,
+                tsZCL_ClusterDefinition            *psClusterDefinition,
+                void                               *pvEndPointSharedStructPtr,
+                uint8                              *pu8AttributeControlBits)
+{
+    #ifdef STRICT_PARAM_CHECK
+        /* Parameter check */
+        if(psClusterInstance==NULL)
+        {
+            return E_ZCL_ERR_PARAMETER_NULL;
+        }
+    #endif
+
+    // cluster data
+    vZCL_InitializeClusterInstance(
+                                   psClusterInstance,
+                                   bIsServer,
+                                   psClusterDefinition,
+                                   pvEndPointSharedStructPtr,
+                                   pu8AttributeControlBits,
+                                   NULL,
+                                   NULL);
+
+    if(pvEndPointSharedStructPtr != NULL)
+    {
+        tsCLD_DeviceStats * psStats = (tsCLD_DeviceStats*)psClusterInstance->pvEndPointSharedStructPtr;
+        memset(psStats, 0, sizeof(tsCLD_DeviceStats));
+        psStats->u16ClusterRevision = CLD_DEVICE_STATS_CLUSTER_REVISION;
+    }
+
+    return E_ZCL_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,135 @@
+// Manufacturer specific cluster that exposes various device statistics and diagnostics values,
+// which are not covered by standard clusters.
+
+#ifndef DEVICE_STATS_H
+#define DEVICE_STATS_H
+
+#include <jendefs.h>
+#include "zcl.h"
+#include "zcl_options.h"
+
+// Cluster ID's
+#define GENERAL_CLUSTER_ID_DEVICE_STATS                 0xFC00
+
+#ifndef CLD_DEVICE_STATS_CLUSTER_REVISION
+    #define CLD_DEVICE_STATS_CLUSTER_REVISION           1
+#endif
+
+// Number of sleep participants exposed via the cluster. SleepManager accepts no more than that.
+#define CLD_DEVICE_STATS_MAX_SLEEP_PARTICIPANTS         8
+
+// Device statistics attribute ID's
+typedef enum
+{
+    E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_MASK      = 0x0000,   // Bitmask of participants that currently veto sleeping
+    E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_TIME_0    = 0x0001,   // Cumulative veto time (ms) of each sleep participant
+    E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_TIME_1,
+    E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_TIME_2,
+    E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_TIME_3,
+    E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_TIME_4,
+    E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_TIME_5,
+    E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_TIME_6,
+    E_CLD_DEVICE_STATS_ATTR_ID_SLEEP_VETO_TIME_7,
+
+    E_CLD_DEVICE_STATS_ATTR_ID_POLLS_SENT           = 0x0010,   // Number of data polls sent to the parent
+    E_CLD_DEVICE_STATS_ATTR_ID_POLL_DATA_RECEIVED   = 0x0011,   // Number of polls that brought some data
+    E_CLD_DEVICE_STATS_ATTR_ID_EMPTY_POLLS          = 0x0012,   // Number of polls with no data
+
+    E_CLD_DEVICE_STATS_ATTR_ID_REJOINS              = 0x0020,   // Number of successful network recoveries
+    E_CLD_DEVICE_STATS_ATTR_ID_LAST_TIME_TO_REJOIN  = 0x0021,   // Time (ms) it took to recover the last time
+    E_CLD_DEVICE_STATS_ATTR_ID_MAX_TIME_TO_REJOIN   = 0x0022,   // Longest recovery time (ms)
+    E_CLD_DEVICE_STATS_ATTR_ID_TARGETED_REJOINS     = 0x0023,   // Rejoin attempts on the last known channel
+    E_CLD_DEVICE_STATS_ATTR_ID_SCAN_REJOINS         = 0x0024,   // Rejoin attempts with scanning all channels
+    E_CLD_DEVICE_STATS_ATTR_ID_TC_REJOINS           = 0x0025,   // Trust center rejoin attempts
+
+    E_CLD_DEVICE_STATS_ATTR_ID_BROADCASTS_AVOIDED   = 0x0030,   // Address lookups served without a broadcast
+    E_CLD_DEVICE_STATS_ATTR_ID_BROADCAST_LOOKUPS    = 0x0031,   // Broadcast NWK_addr_req sent
+
+    E_CLD_DEVICE_STATS_ATTR_ID_REPORT_FRAMES_SENT   = 0x0040,   // Report Attributes frames sent
+    E_CLD_DEVICE_STATS_ATTR_ID_REPORT_FRAMES_SAVED  = 0x0041,   // Reports merged into other frames
+
+    E_CLD_DEVICE_STATS_ATTR_ID_LOOPBACK_COMMANDS    = 0x0050,   // Bound commands delivered to own endpoints without the radio
+
+    E_CLD_DEVICE_STATS_ATTR_ID_UNICAST_FANOUTS      = 0x0060,   // Bound commands sent as a unicast to each of 3+ devices
+    E_CLD_DEVICE_STATS_ATTR_ID_FANOUT_GROUPCASTS    = 0x0061,   // Bound commands collapsed into a single groupcast
+
+    E_CLD_DEVICE_STATS_ATTR_ID_MESSAGES_DELIVERED   = 0x0070,   // Acknowledged reports and sent held commands
+    E_CLD_DEVICE_STATS_ATTR_ID_MESSAGES_RETRIED     = 0x0071,   // Reports and commands sent again after a failure
+    E_CLD_DEVICE_STATS_ATTR_ID_MESSAGES_DROPPED     = 0x0072,   // Reports and commands given up
+
+    E_CLD_DEVICE_STATS_ATTR_ID_TEMPERATURE_SAMPLES  = 0x0080,   // Background temperature ADC conversions
+    E_CLD_DEVICE_STATS_ATTR_ID_CACHED_TEMP_READS    = 0x0081,   // Temperature reads served without an ADC conversion
+
+    E_CLD_DEVICE_STATS_ATTR_ID_STACK_SIZE           = 0x0090,   // Stack size (bytes)
+    E_CLD_DEVICE_STATS_ATTR_ID_STACK_MAX_USED       = 0x0091,   // Deepest stack use since startup (bytes)
+    E_CLD_DEVICE_STATS_ATTR_ID_HEAP_SIZE            = 0x0092,   // Heap size (bytes)
+    E_CLD_DEVICE_STATS_ATTR_ID_HEAP_MAX_USED        = 0x0093,   // Heap high-water mark since startup (bytes)
+    E_CLD_DEVICE_STATS_ATTR_ID_FREE_ZCL_APDUS       = 0x0094,   // ZCL APDU buffers free at the last check
+    E_CLD_DEVICE_STATS_ATTR_ID_MIN_FREE_ZCL_APDUS   = 0x0095,   // Fewest free ZCL APDU buffers seen
+    E_CLD_DEVICE_STATS_ATTR_ID_FREE_ZDP_APDUS       = 0x0096,   // ZDP APDU buffers free at the last check
+    E_CLD_DEVICE_STATS_ATTR_ID_MIN_FREE_ZDP_APDUS   = 0x0097,   // Fewest free ZDP APDU buffers seen
+} teCLD_DeviceStats_AttributeID;
+
+
+// Device Statistics Cluster
+typedef struct
+{
+#ifdef DEVICE_STATS_SERVER
+    zbmap8                  u8SleepVetoMask;
+    zuint32                 au32SleepVetoTime[CLD_DEVICE_STATS_MAX_SLEEP_PARTICIPANTS];
+
+    zuint32                 u32PollsSent;
+    zuint32                 u32PollDataReceived;
+    zuint32                 u32EmptyPolls;
+
+    zuint32                 u32Rejoins;
+    zuint32                 u32LastTimeToRejoin;
+    zuint32                 u32MaxTimeToRejoin;
+    zuint32                 u32TargetedRejoins;
+    zuint32                 u32ScanRejoins;
+    zuint32                 u32TcRejoins;
+
+    zuint32                 u32BroadcastsAvoided;
+    zuint32                 u32BroadcastLookups;
+
+    zuint32                 u32ReportFramesSent;
+    zuint32                 u32ReportFramesSaved;
+
+    zuint32                 u32LoopbackCommands;
+
+    zuint32                 u32UnicastFanouts;
+    zuint32                 u32FanoutGroupcasts;
+
+    zuint32                 u32MessagesDelivered;
+    zuint32                 u32MessagesRetried;
+    zuint32                 u32MessagesDropped;
+
+    zuint32                 u32TemperatureSamples;
+    zuint32                 u32CachedTempReads;
+
+    zuint32                 u32StackSize;
+    zuint32                 u32StackMaxUsed;
+    zuint32                 u32HeapSize;
+    zuint32                 u32HeapMaxUsed;
+    zuint8                  u8FreeZclApdus;
+    zuint8                  u8MinFreeZclApdus;
+    zuint8                  u8FreeZdpApdus;
+    zuint8                  u8MinFreeZdpApdus;
+#endif
+    zuint16                 u16ClusterRevision;
+} tsCLD_DeviceStats;
+
+
+PUBLIC teZCL_Status eCLD_DeviceStatsCreateDeviceStats(
+                tsZCL_ClusterInstance              *psClusterInstance,
+                bool_t                              bIsServer,
+                tsZCL_ClusterDefinition            *psClusterDefinition,
+                void                               *pvEndPointSharedStructPtr,
+                uint8                              *pu8AttributeControlBits);
+
+
+extern tsZCL_ClusterDefinition sCLD_DeviceStats;
+extern uint8 au8DeviceStatsAttributeControlBits[];
+extern const tsZCL_AttributeDefinition asCLD_DeviceStatsClusterAttributeDefinitions[];
+
+#endif /* DEVICE_STATS_H */
@@ -0,0 +1,75 @@
+#include <jendefs.h>
+#include <string.h>
+#include "zcl.h"
+#include "zcl_options.h"
+#include "DiagnosticsCluster.h"
+
+#ifdef CLD_DIAGNOSTICS
+
+const tsZCL_AttributeDefinition asCLD_DiagnosticsClusterAttributeDefinitions[] = {
+#ifdef DIAGNOSTICS_SERVER
+    {E_CLD_DIAGNOSTICS_ATTR_ID_PERSISTENT_MEMORY_WRITES,            (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16PersistentMemoryWrites), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_MAC_TX_UCAST,                        (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT32,   (uint32)(&((tsCLD_Diagnostics*)(0))->u32MacTxUcast), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_MAC_TX_UCAST_RETRY,                  (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16MacTxUcastRetry), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_MAC_TX_UCAST_FAIL,                   (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16MacTxUcastFail), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_APS_TX_UCAST_SUCCESS,                (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16APSTxUcastSuccess), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_APS_TX_UCAST_FAIL,                   (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16APSTxUcastFail), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_NEIGHBOR_ADDED,                      (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16NeighborAdded), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_NEIGHBOR_REMOVED,                    (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16NeighborRemoved), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_PACKET_BUFFER_ALLOCATE_FAILURES,     (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16PacketBufferAllocateFailures), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_AVERAGE_MAC_RETRY_PER_APS_MESSAGE,   (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16AverageMACRetryPerAPSMessageSent), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_LAST_MESSAGE_LQI,                    (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_UINT8,    (uint32)(&((tsCLD_Diagnostics*)(0))->u8LastMessageLQI), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_LAST_MESSAGE_RSSI,                   (E_ZCL_AF_RD|E_ZCL_AF_RP),              E_ZCL_INT8,     (uint32)(&((tsCLD_Diagnostics*)(0))->i8LastMessageRSSI), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_REJOINS,                             (E_ZCL_AF_RD|E_ZCL_AF_RP|E_ZCL_AF_MS),  E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16Rejoins), 0},
+    {E_CLD_DIAGNOSTICS_ATTR_ID_REPORT_RETRIES,                      (E_ZCL_AF_RD|E_ZCL_AF_RP|E_ZCL_AF_MS),  E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16ReportRetries), 0},
+#endif
+    {E_CLD_GLOBAL_ATTR_ID_CLUSTER_REVISION,                         (E_ZCL_AF_RD|E_ZCL_AF_GA),              E_ZCL_UINT16,   (uint32)(&((tsCLD_Diagnostics*)(0))->u16ClusterRevision), 0},   // Mandatory
+};
+
+tsZCL_ClusterDefinition sCLD_Diagnostics = {
+        GENERAL_CLUSTER_ID_DIAGNOSTICS,
+        FALSE,
+        E_ZCL_SECURITY_NETWORK,
+        (sizeof(asCLD_DiagnosticsClusterAttributeDefinitions) / sizeof(tsZCL_AttributeDefinition)),
+        (tsZCL_AttributeDefinition*)asCLD_DiagnosticsClusterAttributeDefinitions,
+        NULL
+};
+
+uint8 au8DiagnosticsAttributeControlBits[(sizeof(asCLD_DiagnosticsClusterAttributeDefinitions) / sizeof(tsZCL_AttributeDefinition))];
+
+PUBLIC teZCL_Status eCLD_DiagnosticsCreateDiagnostics(
+                tsZCL_ClusterInstance              *psClusterInstance,
+                bool_t                              bIsServer,
+                tsZCL_ClusterDefinition            *psClusterDefinition,
+                void                               *pvEndPointSharedStructPtr,
+                uint8                              *pu8AttributeControlBits)
+{
+    #ifdef STRICT_PARAM_CHECK
+        /* Parameter check */
+        if(psClusterInstance==NULL)
+        {
+            return E_ZCL_ERR_PARAMETER_NULL;
+        }
+    #endif
+
+    // cluster data
+    vZCL_InitializeClusterInstance(
+                                   psClusterInstance,
+                                   bIsServer,
+                                   psClusterDefinition,
+                                   pvEndPointSharedStructPtr,
+                                   pu8AttributeControlBits,
+                                   NULL,
+                                   NULL);
+
+    if(pvEndPointSharedStructPtr != NULL)
+    {
+        tsCLD_Diagnostics * psDiagnostics = (tsCLD_Diagnostics*)psClusterInstance->pvEndPointSharedStructPtr;
+        memset(psDiagnostics, 0, sizeof(tsCLD_Diagnostics));
+        psDiagnostics->u16ClusterRevision = CLD_DIAGNOSTICS_CLUSTER_REVISION;
+    }
+
+    return E_ZCL_SUCCESS;
+}
+
+#endif
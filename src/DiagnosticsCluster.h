@@ -0,0 +1,76 @@
+// ZCL Diagnostics cluster (server side). It is defined in the application, similar to the Device Statistics cluster,
+// so that only the attributes the application can actually fill in are included.
+
+#ifndef DIAGNOSTICS_CLUSTER_H
+#define DIAGNOSTICS_CLUSTER_H
+
+#include <jendefs.h>
+#include "zcl.h"
+#include "zcl_options.h"
+
+// Cluster ID's
+#define GENERAL_CLUSTER_ID_DIAGNOSTICS                  0x0B05
+
+#ifndef CLD_DIAGNOSTICS_CLUSTER_REVISION
+    #define CLD_DIAGNOSTICS_CLUSTER_REVISION            1
+#endif
+
+// Diagnostics attribute ID's
+typedef enum
+{
+    E_CLD_DIAGNOSTICS_ATTR_ID_PERSISTENT_MEMORY_WRITES          = 0x0001,
+    E_CLD_DIAGNOSTICS_ATTR_ID_MAC_TX_UCAST                      = 0x0103,
+    E_CLD_DIAGNOSTICS_ATTR_ID_MAC_TX_UCAST_RETRY                = 0x0104,
+    E_CLD_DIAGNOSTICS_ATTR_ID_MAC_TX_UCAST_FAIL                 = 0x0105,
+    E_CLD_DIAGNOSTICS_ATTR_ID_APS_TX_UCAST_SUCCESS              = 0x0109,
+    E_CLD_DIAGNOSTICS_ATTR_ID_APS_TX_UCAST_FAIL                 = 0x010B,
+    E_CLD_DIAGNOSTICS_ATTR_ID_NEIGHBOR_ADDED                    = 0x010D,
+    E_CLD_DIAGNOSTICS_ATTR_ID_NEIGHBOR_REMOVED                  = 0x010E,
+    E_CLD_DIAGNOSTICS_ATTR_ID_PACKET_BUFFER_ALLOCATE_FAILURES   = 0x0117,
+    E_CLD_DIAGNOSTICS_ATTR_ID_AVERAGE_MAC_RETRY_PER_APS_MESSAGE = 0x011B,
+    E_CLD_DIAGNOSTICS_ATTR_ID_LAST_MESSAGE_LQI                  = 0x011C,
+    E_CLD_DIAGNOSTICS_ATTR_ID_LAST_MESSAGE_RSSI                 = 0x011D,
+
+    // Manufacturer specific
+    E_CLD_DIAGNOSTICS_ATTR_ID_REJOINS                           = 0xFF00,   // Successful network recoveries
+    E_CLD_DIAGNOSTICS_ATTR_ID_REPORT_RETRIES                    = 0xFF01,   // Reports sent again by the application
+} teCLD_Diagnostics_AttributeID;
+
+
+// Diagnostics Cluster
+typedef struct
+{
+#ifdef DIAGNOSTICS_SERVER
+    zuint16                 u16PersistentMemoryWrites;
+    zuint32                 u32MacTxUcast;
+    zuint16                 u16MacTxUcastRetry;
+    zuint16                 u16MacTxUcastFail;
+    zuint16                 u16APSTxUcastSuccess;
+    zuint16                 u16APSTxUcastFail;
+    zuint16                 u16NeighborAdded;
+    zuint16                 u16NeighborRemoved;
+    zuint16                 u16PacketBufferAllocateFailures;
+    zuint16                 u16AverageMACRetryPerAPSMessageSent;
+    zuint8                  u8LastMessageLQI;
+    zint8                   i8LastMessageRSSI;
+
+    zuint16                 u16Rejoins;
+    zuint16                 u16ReportRetries;
+#endif
+    zuint16                 u16ClusterRevision;
+} tsCLD_Diagnostics;
+
+
+PUBLIC teZCL_Status eCLD_DiagnosticsCreateDiagnostics(
+                tsZCL_ClusterInstance              *psClusterInstance,
+                bool_t                              bIsServer,
+                tsZCL_ClusterDefinition            *psClusterDefinition,
+                void                               *pvEndPointSharedStructPtr,
+                uint8                              *pu8AttributeControlBits);
+
+
+extern tsZCL_ClusterDefinition sCLD_Diagnostics;
+extern uint8 au8DiagnosticsAttributeControlBits[];
+extern const tsZCL_AttributeDefinition asCLD_DiagnosticsClusterAttributeDefinitions[];
+
+#endif /* DIAGNOSTICS_CLUSTER_H */
@@ -0,0 +1,164 @@
+extern "C"
+{
+    #include "PDM.h"
+    #include "dbg.h"
+}
+
+#include "DiagnosticsCollector.h"
+#include "DeliveryTracker.h"
+#include "ReportManager.h"
+#include "ZigbeeDevice.h"
+
+DiagnosticsCollector::DiagnosticsCollector()
+{
+    endpoint = 0;
+    cluster = NULL;
+}
+
+DiagnosticsCollector * DiagnosticsCollector::getInstance()
+{
+    static DiagnosticsCollector instance;
+    return &instance;
+}
+
+void DiagnosticsCollector::init(uint8 ep, tsCLD_Diagnostics * clusterData)
+{
+    endpoint = ep;
+    cluster = clusterData;
+
+    // PDM notifies about each flash segment written, whoever has requested the write (application or the stack)
+    PDM_vRegisterSystemCallback(pdmEventCallback);
+}
+
+void DiagnosticsCollector::pdmEventCallback(uint32 eventNumber, uint32 eventData)
+{
+    if(eventNumber == E_PDM_SYSTEM_EVENT_SEGMENT_SAVE_OK)
+        getInstance()->counters.handlePdmWrite();
+}
+
+void DiagnosticsCollector::handleDataConfirm(ZPS_tsAfEvent * pEvent)
+{
+    if(pEvent->eType == ZPS_EVENT_APS_DATA_CONFIRM)
+    {
+        // Broadcasts and groupcasts are not acknowledged, so they say nothing about the link quality
+        ZPS_tsAfDataConfEvent * pConfirm = &pEvent->uEvent.sApsDataConfirmEvent;
+        if(pConfirm->u8DstAddrMode == ZPS_E_ADDR_MODE_SHORT || pConfirm->u8DstAddrMode == ZPS_E_ADDR_MODE_IEEE)
+            counters.handleUnicastConfirm(pConfirm->u8Status);
+    }
+    else if(pEvent->eType == ZPS_EVENT_APS_DATA_ACK)
+        counters.handleApsAck(pEvent->uEvent.sApsDataAckEvent.u8Status);
+}
+
+void DiagnosticsCollector::handleDataIndication(ZPS_tsAfEvent * pEvent)
+{
+    counters.handleMessageReceived(pEvent->uEvent.sApsDataIndEvent.u8LinkQuality);
+}
+
+void DiagnosticsCollector::handleNeighborAdded()
+{
+    counters.handleNeighborAdded();
+}
+
+void DiagnosticsCollector::handleNeighborRemoved()
+{
+    counters.handleNeighborRemoved();
+}
+
+void DiagnosticsCollector::handleBufferAllocFailure()
+{
+    counters.handleBufferAllocFailure();
+}
+
+void DiagnosticsCollector::handleSendStatus(teZCL_Status status)
+{
+    // eCLD_*Send() functions allocate the APDU internally, a failed allocation is seen only in the returned status
+    if(status == E_ZCL_ERR_ZBUFFER_FAIL)
+        counters.handleBufferAllocFailure();
+}
+
+void DiagnosticsCollector::handleDeviceJoin()
+{
+    // Rejoin counter is kept by the rejoin strategy, pick it up
+    refresh();
+}
+
+void DiagnosticsCollector::flush()
+{
+    // Nothing changed during this main loop iteration
+    if(!counters.takeChanged())
+        return;
+
+    refresh();
+}
+
+void DiagnosticsCollector::refresh()
+{
+    if(!cluster)
+        return;
+
+    const DiagnosticsCountersData & data = counters.getCounters();
+    updateAttribute(cluster->u16PersistentMemoryWrites, data.pdmWrites, E_CLD_DIAGNOSTICS_ATTR_ID_PERSISTENT_MEMORY_WRITES);
+    updateAttribute(cluster->u32MacTxUcast, data.macTxUnicast, E_CLD_DIAGNOSTICS_ATTR_ID_MAC_TX_UCAST);
+    updateAttribute(cluster->u16MacTxUcastRetry, data.macTxRetries, E_CLD_DIAGNOSTICS_ATTR_ID_MAC_TX_UCAST_RETRY);
+    updateAttribute(cluster->u16MacTxUcastFail, data.macTxFailures, E_CLD_DIAGNOSTICS_ATTR_ID_MAC_TX_UCAST_FAIL);
+    updateAttribute(cluster->u16APSTxUcastSuccess, data.apsTxSuccess, E_CLD_DIAGNOSTICS_ATTR_ID_APS_TX_UCAST_SUCCESS);
+    updateAttribute(cluster->u16APSTxUcastFail, data.apsTxFailures, E_CLD_DIAGNOSTICS_ATTR_ID_APS_TX_UCAST_FAIL);
+    updateAttribute(cluster->u16NeighborAdded, data.neighborsAdded, E_CLD_DIAGNOSTICS_ATTR_ID_NEIGHBOR_ADDED);
+    updateAttribute(cluster->u16NeighborRemoved, data.neighborsRemoved, E_CLD_DIAGNOSTICS_ATTR_ID_NEIGHBOR_REMOVED);
+    updateAttribute(cluster->u16PacketBufferAllocateFailures, data.bufferAllocFailures, E_CLD_DIAGNOSTICS_ATTR_ID_PACKET_BUFFER_ALLOCATE_FAILURES);
+    updateAttribute(cluster->u16AverageMACRetryPerAPSMessageSent, counters.getAverageMacRetries(), E_CLD_DIAGNOSTICS_ATTR_ID_AVERAGE_MAC_RETRY_PER_APS_MESSAGE);
+    updateAttribute(cluster->u16Rejoins, ZigbeeDevice::getInstance()->getRejoinStatistics().rejoins, E_CLD_DIAGNOSTICS_ATTR_ID_REJOINS);
+
+    // The stack does not tell about its own APS retries, so the standard APSTxUcastRetry attribute is not provided.
+    // Reports resent by the application are a different thing, and have their own attribute.
+    updateAttribute(cluster->u16ReportRetries, DeliveryTracker::getInstance()->getStatistics().retried, E_CLD_DIAGNOSTICS_ATTR_ID_REPORT_RETRIES);
+
+    if(cluster->u8LastMessageLQI != data.lastMessageLqi)
+    {
+        cluster->u8LastMessageLQI = data.lastMessageLqi;
+        cluster->i8LastMessageRSSI = data.lastMessageRssi;
+        reportChange(E_CLD_DIAGNOSTICS_ATTR_ID_LAST_MESSAGE_LQI, data.lastMessageLqi);
+        reportChange(E_CLD_DIAGNOSTICS_ATTR_ID_LAST_MESSAGE_RSSI, data.lastMessageRssi);
+    }
+}
+
+void DiagnosticsCollector::updateAttribute(zuint16 & attr, uint32 value, uint16 attrId)
+{
+    uint16 newValue = DiagnosticsCounters::saturate16(value);
+    if(attr == newValue)
+        return;
+
+    attr = newValue;
+    reportChange(attrId, newValue);
+}
+
+void DiagnosticsCollector::updateAttribute(zuint32 & attr, uint32 value, uint16 attrId)
+{
+    if(attr == value)
+        return;
+
+    attr = value;
+    reportChange(attrId, value);
+}
+
+void DiagnosticsCollector::reportChange(uint16 attrId, int32 value)
+{
+    // Unlike user facing attributes, counters are reported only if somebody asked for that. Otherwise each report
+    // would change the counters again, causing yet another report.
+    ReportManager * reportManager = ReportManager::getInstance();
+    if(reportManager->isReportConfigured(endpoint, GENERAL_CLUSTER_ID_DIAGNOSTICS, attrId))
+        reportManager->reportValueChange(endpoint, GENERAL_CLUSTER_ID_DIAGNOSTICS, attrId, value);
+}
+
+void DiagnosticsCollector::dumpStatistics() const
+{
+    const DiagnosticsCountersData & data = counters.getCounters();
+    DBG_vPrintf(TRUE, "\n+++++++ Diagnostics:\n");
+    DBG_vPrintf(TRUE, "    MAC unicasts: %d (retries %d, failures %d)\n", data.macTxUnicast, data.macTxRetries, data.macTxFailures);
+    DBG_vPrintf(TRUE, "    APS unicasts: %d delivered, %d failed\n", data.apsTxSuccess, data.apsTxFailures);
+    DBG_vPrintf(TRUE, "    Average MAC retries per APS message: %d\n", counters.getAverageMacRetries());
+    DBG_vPrintf(TRUE, "    Buffer allocation failures: %d\n", data.bufferAllocFailures);
+    DBG_vPrintf(TRUE, "    Neighbors added/removed: %d/%d\n", data.neighborsAdded, data.neighborsRemoved);
+    DBG_vPrintf(TRUE, "    PDM writes: %d\n", data.pdmWrites);
+    DBG_vPrintf(TRUE, "    Last message LQI %d, RSSI %d dBm\n", data.lastMessageLqi, data.lastMessageRssi);
+}
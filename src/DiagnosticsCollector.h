@@ -0,0 +1,51 @@
+#ifndef DIAGNOSTICSCOLLECTOR_H
+#define DIAGNOSTICSCOLLECTOR_H
+
+extern "C"
+{
+    #include "zps_apl_af.h"
+    #include "DiagnosticsCluster.h"
+}
+
+#include "DiagnosticsCounters.h"
+
+// Feeds the Diagnostics cluster attributes with the stack and application counters.
+//
+// Counters are updated by the stack event handlers, and copied to the cluster attributes once per main loop
+// iteration. Attributes that have a reporting configuration are reported on change (subject to the configured min
+// interval), others are just available for reading.
+class DiagnosticsCollector
+{
+    DiagnosticsCounters counters;
+    uint8 endpoint;
+    tsCLD_Diagnostics * cluster;
+
+private:
+    DiagnosticsCollector();
+
+public:
+    static DiagnosticsCollector * getInstance();
+
+    void init(uint8 endpoint, tsCLD_Diagnostics * cluster);
+
+    void handleDataConfirm(ZPS_tsAfEvent * pEvent);
+    void handleDataIndication(ZPS_tsAfEvent * pEvent);
+    void handleNeighborAdded();
+    void handleNeighborRemoved();
+    void handleBufferAllocFailure();
+    void handleSendStatus(teZCL_Status status);
+    void handleDeviceJoin();
+
+    void flush();
+    void refresh();
+    void dumpStatistics() const;
+
+protected:
+    void updateAttribute(zuint16 & attr, uint32 value, uint16 attrId);
+    void updateAttribute(zuint32 & attr, uint32 value, uint16 attrId);
+    void reportChange(uint16 attrId, int32 value);
+
+    static void pdmEventCallback(uint32 eventNumber, uint32 eventData);
+};
+
+#endif // DIAGNOSTICSCOLLECTOR_H
@@ -0,0 +1,121 @@
+#include "DiagnosticsCounters.h"
+
+DiagnosticsCounters::DiagnosticsCounters()
+{
+    counters.macTxUnicast = 0;
+    counters.macTxRetries = 0;
+    counters.macTxFailures = 0;
+    counters.apsTxSuccess = 0;
+    counters.apsTxFailures = 0;
+    counters.bufferAllocFailures = 0;
+    counters.neighborsAdded = 0;
+    counters.neighborsRemoved = 0;
+    counters.pdmWrites = 0;
+    counters.lastMessageLqi = 0;
+    counters.lastMessageRssi = 0;
+    changed = false;
+}
+
+void DiagnosticsCounters::handleUnicastConfirm(uint8 status)
+{
+    counters.macTxUnicast++;
+    changed = true;
+
+    if(status == 0)
+    {
+        counters.apsTxSuccess++;
+        return;
+    }
+
+    counters.apsTxFailures++;
+    if(!isMacStatus(status))
+        return;
+
+    // No ack means the MAC has used up all its retries
+    counters.macTxFailures++;
+    if(status == MAC_STATUS_NO_ACK)
+        counters.macTxRetries += MAC_MAX_FRAME_RETRIES;
+}
+
+void DiagnosticsCounters::handleApsAck(uint8 status)
+{
+    if(status == 0)
+        return;
+
+    // The frame has reached the next hop (and was counted as a success), but not the destination
+    if(counters.apsTxSuccess > 0)
+        counters.apsTxSuccess--;
+
+    counters.apsTxFailures++;
+    changed = true;
+}
+
+void DiagnosticsCounters::handleBufferAllocFailure()
+{
+    counters.bufferAllocFailures++;
+    changed = true;
+}
+
+void DiagnosticsCounters::handleNeighborAdded()
+{
+    counters.neighborsAdded++;
+    changed = true;
+}
+
+void DiagnosticsCounters::handleNeighborRemoved()
+{
+    counters.neighborsRemoved++;
+    changed = true;
+}
+
+void DiagnosticsCounters::handleMessageReceived(uint8 lqi)
+{
+    counters.lastMessageLqi = lqi;
+    counters.lastMessageRssi = convertLqiToRssi(lqi);
+    changed = true;
+}
+
+void DiagnosticsCounters::handlePdmWrite()
+{
+    counters.pdmWrites++;
+    changed = true;
+}
+
+const DiagnosticsCountersData & DiagnosticsCounters::getCounters() const
+{
+    return counters;
+}
+
+uint16 DiagnosticsCounters::getAverageMacRetries() const
+{
+    // Rounded to the nearest integer, as the attribute is an integer
+    uint32 messages = counters.apsTxSuccess + counters.apsTxFailures;
+    if(messages == 0)
+        return 0;
+
+    return saturate16((counters.macTxRetries + messages / 2) / messages);
+}
+
+bool DiagnosticsCounters::takeChanged()
+{
+    bool wasChanged = changed;
+    changed = false;
+    return wasChanged;
+}
+
+bool DiagnosticsCounters::isMacStatus(uint8 status)
+{
+    return status >= MAC_STATUS_FIRST && status <= MAC_STATUS_LAST;
+}
+
+int8 DiagnosticsCounters::convertLqiToRssi(uint8 lqi)
+{
+    // JN516x radio: RSSI (dBm) = (7 * LQI - 1970) / 20
+    return (int8)((7 * (int32)lqi - 1970) / 20);
+}
+
+uint16 DiagnosticsCounters::saturate16(uint32 value)
+{
+    // 16-bit ZCL counters stop at the maximum rather than wrap around to small values
+    return value > 0xFFFF ? 0xFFFF : (uint16)value;
+}
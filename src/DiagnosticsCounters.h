@@ -0,0 +1,66 @@
+#ifndef DIAGNOSTICSCOUNTERS_H
+#define DIAGNOSTICSCOUNTERS_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+struct DiagnosticsCountersData
+{
+    uint32 macTxUnicast;            // Unicast frames the MAC has finished with (delivered or not)
+    uint32 macTxRetries;            // Lower bound, see handleUnicastConfirm()
+    uint32 macTxFailures;           // Unicasts failed at the MAC level (no ack, channel access failure, etc)
+    uint32 apsTxSuccess;            // Unicasts delivered to the destination (or the next hop, if no APS ack requested)
+    uint32 apsTxFailures;           // Unicasts not delivered, including missing APS acks
+    uint32 bufferAllocFailures;     // APDU/NPDU allocation failures
+    uint32 neighborsAdded;          // Devices joined through this device
+    uint32 neighborsRemoved;        // Neighbor devices left the network
+    uint32 pdmWrites;               // Persistent memory segments written
+    uint8 lastMessageLqi;
+    int8 lastMessageRssi;           // dBm
+};
+
+// Collects network and application performance counters for the ZCL Diagnostics cluster.
+//
+// The counters are fed from the events visible to the application: APS data confirms and acks, data indications,
+// network join/leave indications, and stack/PDM callbacks. MAC retries are not reported by the stack for each frame,
+// so frames that failed with no ack are counted as macMaxFrameRetries retries, and frames that succeeded after a
+// retry are not counted at all.
+//
+// The class does not depend on the Zigbee stack.
+class DiagnosticsCounters
+{
+public:
+    // IEEE 802.15.4 MAC status codes, as they come in the APS data confirm
+    static const uint8 MAC_STATUS_FIRST = 0xDB;
+    static const uint8 MAC_STATUS_LAST = 0xF4;
+    static const uint8 MAC_STATUS_NO_ACK = 0xE9;
+    static const uint8 MAC_MAX_FRAME_RETRIES = 3;
+
+private:
+    DiagnosticsCountersData counters;
+    bool changed;
+
+public:
+    DiagnosticsCounters();
+
+    void handleUnicastConfirm(uint8 status);
+    void handleApsAck(uint8 status);
+    void handleBufferAllocFailure();
+    void handleNeighborAdded();
+    void handleNeighborRemoved();
+    void handleMessageReceived(uint8 lqi);
+    void handlePdmWrite();
+
+    const DiagnosticsCountersData & getCounters() const;
+    uint16 getAverageMacRetries() const;
+
+    bool takeChanged();
+
+    static bool isMacStatus(uint8 status);
+    static int8 convertLqiToRssi(uint8 lqi);
+    static uint16 saturate16(uint32 value);
+};
+
+#endif // DIAGNOSTICSCOUNTERS_H
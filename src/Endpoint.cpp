@@ -1,5 +1,6 @@
 #include "Endpoint.h"
 #include "DumpFunctions.h"
+#include "ReportManager.h"
 
 extern "C"
 {
@@ -48,11 +49,6 @@ teZCL_CommandStatus Endpoint::handleCheckAttributeRange(tsZCL_CallBackEvent *psE
     return E_ZCL_CMDS_SUCCESS;
 }
 
-void Endpoint::handleReportingConfigureRequest(tsZCL_CallBackEvent *psEvent)
-{
-    DBG_vPrintf(TRUE, "Endpoint: Warning: using default reporting configure handler\n");
-}
-
 void Endpoint::handleZclEvent(tsZCL_CallBackEvent *psEvent)
 {
     switch (psEvent->eEventType)
@@ -65,6 +61,9 @@ void Endpoint::handleZclEvent(tsZCL_CallBackEvent *psEvent)
         case E_ZCL_CBET_WRITE_INDIVIDUAL_ATTRIBUTE:
             vDumpZclWriteAttributeRequest(psEvent);
             handleWriteAttributeCompleted(psEvent);
+            ReportManager::getInstance()->handleAttributeWrite(psEvent->u8EndPoint,
+                                                               psEvent->psClusterInstance->psClusterDefinition->u16ClusterEnum,
+                                                               psEvent->uMessage.sIndividualAttributeResponse.u16AttributeEnum);
             break;
 
         case E_ZCL_CBET_WRITE_ATTRIBUTES:
@@ -107,9 +106,8 @@ void Endpoint::handleZclEvent(tsZCL_CallBackEvent *psEvent)
             break;
 
         case E_ZCL_CBET_REPORT_INDIVIDUAL_ATTRIBUTES_CONFIGURE:
+            // Configure Reporting commands are handled by ReportManager before they get to ZCL
             vDumpAttributeReportingConfigureRequest(psEvent);
-            if(psEvent->eZCL_Status == E_ZCL_SUCCESS)
-                handleReportingConfigureRequest(psEvent);
             break;
 
         case E_ZCL_CBET_REPORT_ATTRIBUTES_CONFIGURE:
@@ -131,3 +129,31 @@ void Endpoint::handleDeviceLeave()
 {
     // Nothing to do
 }
+
+void Endpoint::handleParentPoll()
+{
+    // Nothing to do
+}
+
+void Endpoint::handleZclEventProcessed()
+{
+    // Nothing to do
+}
+
+bool Endpoint::handleLoopbackOnOffCommand(uint8 commandId)
+{
+    // Endpoint does not accept On/Off commands
+    return false;
+}
+
+bool Endpoint::handleOnWithTimedOff(uint8 onOffControl, uint16 onTime, uint16 offWaitTime)
+{
+    // Endpoint does not have an On/Off server
+    return false;
+}
+
+bool Endpoint::replayBoundCommand(uint16 clusterId, uint8 commandId)
+{
+    // Endpoint does not send commands to bound devices
+    return false;
+}
@@ -22,6 +22,11 @@ public:
 
     virtual void handleDeviceJoin();
     virtual void handleDeviceLeave();
+    virtual void handleParentPoll();
+    virtual void handleZclEventProcessed();
+    virtual bool handleLoopbackOnOffCommand(uint8 commandId);
+    virtual bool handleOnWithTimedOff(uint8 onOffControl, uint16 onTime, uint16 offWaitTime);
+    virtual bool replayBoundCommand(uint16 clusterId, uint8 commandId);
 
 protected:
     virtual void handleCustomClusterEvent(tsZCL_CallBackEvent *psEvent);
@@ -29,7 +34,6 @@ protected:
     virtual teZCL_CommandStatus handleReadAttribute(tsZCL_CallBackEvent *psEvent);
     virtual void handleWriteAttributeCompleted(tsZCL_CallBackEvent *psEvent);
     virtual teZCL_CommandStatus handleCheckAttributeRange(tsZCL_CallBackEvent *psEvent);
-    virtual void handleReportingConfigureRequest(tsZCL_CallBackEvent *psEvent);
 };
 
 #endif // ENDPOINT_H
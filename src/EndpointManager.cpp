@@ -1,11 +1,14 @@
 #include "EndpointManager.h"
 #include "Endpoint.h"
+#include "SystemClock.h"
+#include "DiagnosticsCollector.h"
 #include <string.h>
 
 extern "C"
 {
     #include "dbg.h"
     #include "zcl.h"
+    #include "OnOff.h"
 
     // Local configuration and generated files
     #include "pdum_gen.h"
@@ -57,6 +60,8 @@ EndpointManager::EndpointManager()
 {
     // Make sure all endpoint pointers are uninitialized
     memset(registry, 0, sizeof(Endpoint*) * (ZCL_NUMBER_OF_ENDPOINTS+1));
+    loopbackStats.commands = 0;
+    loopbackStats.maxLatency = 0;
 
     // Initialize ZCL
     DBG_vPrintf(TRUE, "EndpointManager::EndpointManager(): init Zigbee Class Library (ZCL)...  ");
@@ -102,4 +107,139 @@ void EndpointManager::handleDeviceLeave()
 {
     for(uint8 ep = 1; ep <= ZCL_NUMBER_OF_ENDPOINTS; ep++)
         registry[ep]->handleDeviceJoin();
-}
\ No newline at end of file
+}
+
+void EndpointManager::handleParentPoll()
+{
+    for(uint8 ep = 1; ep <= ZCL_NUMBER_OF_ENDPOINTS; ep++)
+        registry[ep]->handleParentPoll();
+}
+
+void EndpointManager::handleZclEventProcessed()
+{
+    for(uint8 ep = 1; ep <= ZCL_NUMBER_OF_ENDPOINTS; ep++)
+        registry[ep]->handleZclEventProcessed();
+}
+
+bool EndpointManager::dispatchLoopbackOnOffCommand(uint8 srcEndpoint, uint8 dstEndpoint, uint8 commandId)
+{
+    if(dstEndpoint == 0 || dstEndpoint > ZCL_NUMBER_OF_ENDPOINTS || !registry[dstEndpoint])
+    {
+        DBG_vPrintf(TRUE, "EndpointManager: Invalid loopback destination endpoint %d\n", dstEndpoint);
+        return false;
+    }
+
+    uint32 startTime = SystemClock::getInstance()->getTimeMs();
+    if(!registry[dstEndpoint]->handleLoopbackOnOffCommand(commandId))
+        return false;
+
+    uint32 latency = SystemClock::getInstance()->getTimeMs() - startTime;
+    DBG_vPrintf(TRUE, "EndpointManager: Loopback On/Off command %02x EP=%d -> EP=%d delivered in %d ms\n",
+                commandId, srcEndpoint, dstEndpoint, latency);
+
+    loopbackStats.commands++;
+    if(latency > loopbackStats.maxLatency)
+        loopbackStats.maxLatency = latency;
+
+    return true;
+}
+
+bool EndpointManager::handleDataIndication(ZPS_tsAfEvent * pEvent)
+{
+    // Returns true if the frame is an On With Timed Off command that has been handled here, and shall not be passed
+    // to ZCL. The SDK On/Off cluster would otherwise apply the command as well, next to the endpoint's countdown.
+    ZPS_tsAfDataIndEvent * pInd = &pEvent->uEvent.sApsDataIndEvent;
+    if(pInd->eStatus != ZPS_E_SUCCESS || pInd->u16ClusterId != GENERAL_CLUSTER_ID_ONOFF)
+        return false;
+
+    tsZCL_HeaderParams header;
+    uint16 pos = u16ZCL_ReadCommandHeader(pInd->hAPduInst, &header);
+    if(header.eFrameType != eFRAME_TYPE_COMMAND_IS_SPECIFIC_TO_A_CLUSTER || header.bDirection || header.bManufacturerSpecific)
+        return false;
+
+    if(header.u8CommandIdentifier != E_CLD_ONOFF_CMD_ON_TIMED_OFF)
+        return false;
+
+    // Malformed commands, and endpoints without the On/Off server, are left to ZCL. It knows how to reject them.
+    uint8 ep = pInd->u8DstEndpoint;
+    if(ep == 0 || ep > ZCL_NUMBER_OF_ENDPOINTS || !registry[ep])
+        return false;
+
+    if(pos + sizeof(uint8) + 2 * sizeof(uint16) > PDUM_u16APduInstanceGetPayloadSize(pInd->hAPduInst))
+        return false;
+
+    uint8 onOffControl;
+    uint16 onTime;
+    uint16 offWaitTime;
+    pos += u16ZCL_APduInstanceReadNBO(pInd->hAPduInst, pos, E_ZCL_UINT8, &onOffControl);
+    pos += u16ZCL_APduInstanceReadNBO(pInd->hAPduInst, pos, E_ZCL_UINT16, &onTime);
+    pos += u16ZCL_APduInstanceReadNBO(pInd->hAPduInst, pos, E_ZCL_UINT16, &offWaitTime);
+
+    if(!registry[ep]->handleOnWithTimedOff(onOffControl, onTime, offWaitTime))
+        return false;
+
+    if(!header.bDisableDefaultResponse)
+        sendDefaultResponse(pInd, &header, E_ZCL_CMDS_SUCCESS);
+
+    return true;
+}
+
+void EndpointManager::sendDefaultResponse(ZPS_tsAfDataIndEvent * pInd, const tsZCL_HeaderParams * header, uint8 status)
+{
+    // Group addressed commands are applied, but not answered
+    if(pInd->u8DstAddrMode != ZPS_E_ADDR_MODE_SHORT)
+        return;
+
+    PDUM_thAPduInstance hResponse = hZCL_AllocateAPduInstance();
+    if(hResponse == PDUM_INVALID_HANDLE)
+    {
+        DBG_vPrintf(TRUE, "EndpointManager: Cannot allocate APDU for the default response\n");
+        DiagnosticsCollector::getInstance()->handleBufferAllocFailure();
+        return;
+    }
+
+    uint16 pos = u16ZCL_WriteCommandHeader(hResponse,
+                                           eFRAME_TYPE_COMMAND_ACTS_ACCROSS_ENTIRE_PROFILE,
+                                           FALSE,
+                                           0,
+                                           TRUE,
+                                           TRUE,
+                                           header->u8TransactionSequenceNumber,
+                                           E_ZCL_DEFAULT_RESPONSE);
+    uint8 commandId = header->u8CommandIdentifier;
+    pos += u16ZCL_APduInstanceWriteNBO(hResponse, pos, E_ZCL_UINT8, &commandId);
+    pos += u16ZCL_APduInstanceWriteNBO(hResponse, pos, E_ZCL_UINT8, &status);
+
+    tsZCL_Address addr;
+    addr.eAddressMode = E_ZCL_AM_SHORT;
+    addr.uAddress.u16DestinationAddress = pInd->uSrcAddress.u16Addr;
+
+    // The APDU is released by the stack once transmitted
+    teZCL_Status sendStatus = eZCL_TransmitDataRequest(hResponse, pos, pInd->u8DstEndpoint, pInd->u8SrcEndpoint,
+                                                       pInd->u16ClusterId, &addr);
+    if(sendStatus != E_ZCL_SUCCESS)
+        DBG_vPrintf(TRUE, "EndpointManager: Failed to send the default response. Status=%d\n", sendStatus);
+}
+
+bool EndpointManager::replayBoundCommand(uint8 endpoint, uint16 clusterId, uint8 commandId)
+{
+    if(endpoint == 0 || endpoint > ZCL_NUMBER_OF_ENDPOINTS || !registry[endpoint])
+    {
+        DBG_vPrintf(TRUE, "EndpointManager: Invalid endpoint %d to replay the command\n", endpoint);
+        return false;
+    }
+
+    return registry[endpoint]->replayBoundCommand(clusterId, commandId);
+}
+
+const LoopbackStatistics & EndpointManager::getLoopbackStatistics() const
+{
+    return loopbackStats;
+}
+
+void EndpointManager::dumpLoopbackStatistics() const
+{
+    DBG_vPrintf(TRUE, "\n+++++++ Loopback statistics:\n");
+    DBG_vPrintf(TRUE, "    Commands delivered locally (radio frames avoided): %d\n", loopbackStats.commands);
+    DBG_vPrintf(TRUE, "    Max local delivery time: %d ms\n", loopbackStats.maxLatency);
+}
@@ -3,18 +3,26 @@
 
 extern "C"
 {
+    #include "zps_apl_af.h"
     #include "zcl.h"
     #include "zcl_options.h"
 }
 
 class Endpoint;
 
+struct LoopbackStatistics
+{
+    uint32 commands;        // Commands delivered to own endpoints without the radio
+    uint32 maxLatency;      // Longest local delivery (ms)
+};
+
 class EndpointManager
 {
 private:
     EndpointManager();
 
     Endpoint * registry[ZCL_NUMBER_OF_ENDPOINTS+1];
+    LoopbackStatistics loopbackStats;
 
 public:
     static EndpointManager * getInstance();
@@ -24,9 +32,18 @@ public:
     static void handleZclEvent(tsZCL_CallBackEvent *psEvent);
     void handleDeviceJoin();
     void handleDeviceLeave();
+    void handleParentPoll();
+    void handleZclEventProcessed();
+    bool handleDataIndication(ZPS_tsAfEvent * pEvent);
+
+    bool dispatchLoopbackOnOffCommand(uint8 srcEndpoint, uint8 dstEndpoint, uint8 commandId);
+    bool replayBoundCommand(uint8 endpoint, uint16 clusterId, uint8 commandId);
+    const LoopbackStatistics & getLoopbackStatistics() const;
+    void dumpLoopbackStatistics() const;
 
 protected:
     void handleZclEventInt(tsZCL_CallBackEvent *psEvent);
+    void sendDefaultResponse(ZPS_tsAfDataIndEvent * pInd, const tsZCL_HeaderParams * header, uint8 status);
 };
 
 
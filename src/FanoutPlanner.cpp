@@ -0,0 +1,175 @@
+#include "FanoutPlanner.h"
+
+FanoutPlanner::FanoutPlanner()
+{
+    numMemberships = 0;
+
+    stats.unicastFanouts = 0;
+    stats.groupcasts = 0;
+    stats.framesAvoided = 0;
+}
+
+bool FanoutPlanner::isFanout(uint8 numTargets)
+{
+    return numTargets >= MIN_FANOUT;
+}
+
+void FanoutPlanner::setMembership(const FanoutTarget & target, const uint16 * groups, uint8 numGroups, uint32 now)
+{
+    Membership * membership = allocMembership(target);
+
+    if(numGroups > MAX_GROUPS_PER_TARGET)
+        numGroups = MAX_GROUPS_PER_TARGET;
+
+    for(uint8 i = 0; i < numGroups; i++)
+        membership->groups[i] = groups[i];
+
+    membership->numGroups = numGroups;
+    membership->known = true;
+    membership->updateTime = now;
+}
+
+void FanoutPlanner::addMembership(const FanoutTarget & target, uint16 group, uint32 now)
+{
+    int idx = findMembership(target);
+
+    // Do not pretend we know other groups of the target
+    if(idx < 0 || !memberships[idx].known)
+    {
+        setMembership(target, &group, 1, now);
+        return;
+    }
+
+    Membership & membership = memberships[idx];
+    for(uint8 i = 0; i < membership.numGroups; i++)
+        if(membership.groups[i] == group)
+            return;
+
+    if(membership.numGroups < MAX_GROUPS_PER_TARGET)
+        membership.groups[membership.numGroups++] = group;
+}
+
+void FanoutPlanner::invalidate()
+{
+    numMemberships = 0;
+}
+
+bool FanoutPlanner::findCommonGroup(const FanoutTarget * targets, uint8 numTargets, uint32 now, uint16 * group) const
+{
+    if(numTargets == 0)
+        return false;
+
+    // All the targets must have up to date membership information
+    for(uint8 i = 0; i < numTargets; i++)
+    {
+        int idx = findMembership(targets[i]);
+        if(idx < 0 || !isFresh(memberships[idx], now))
+            return false;
+    }
+
+    // Candidates are groups of the first target
+    const Membership & first = memberships[findMembership(targets[0])];
+    for(uint8 g = 0; g < first.numGroups; g++)
+    {
+        uint16 candidate = first.groups[g];
+        bool common = true;
+
+        for(uint8 i = 1; i < numTargets && common; i++)
+        {
+            const Membership & other = memberships[findMembership(targets[i])];
+            common = false;
+            for(uint8 j = 0; j < other.numGroups; j++)
+                if(other.groups[j] == candidate)
+                    common = true;
+        }
+
+        if(common)
+        {
+            *group = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool FanoutPlanner::needsQuery(const FanoutTarget & target, uint32 now)
+{
+    int idx = findMembership(target);
+    if(idx >= 0)
+    {
+        Membership & membership = memberships[idx];
+        if(isFresh(membership, now))
+            return false;
+
+        // Do not flood the target with queries if it does not respond
+        if(membership.queryTime != 0 && now - membership.queryTime < QUERY_INTERVAL)
+            return false;
+
+        membership.queryTime = now;
+        return true;
+    }
+
+    Membership * membership = allocMembership(target);
+    membership->queryTime = now;
+    return true;
+}
+
+void FanoutPlanner::handleUnicastFanout()
+{
+    stats.unicastFanouts++;
+}
+
+void FanoutPlanner::handleGroupcast(uint8 numTargets)
+{
+    stats.groupcasts++;
+    if(numTargets > 1)
+        stats.framesAvoided += numTargets - 1;
+}
+
+const FanoutStatistics & FanoutPlanner::getStatistics() const
+{
+    return stats;
+}
+
+int FanoutPlanner::findMembership(const FanoutTarget & target) const
+{
+    for(uint8 i = 0; i < numMemberships; i++)
+        if(memberships[i].target.ieeeAddr == target.ieeeAddr && memberships[i].target.endpoint == target.endpoint)
+            return i;
+
+    return -1;
+}
+
+FanoutPlanner::Membership * FanoutPlanner::allocMembership(const FanoutTarget & target)
+{
+    int idx = findMembership(target);
+    if(idx >= 0)
+        return &memberships[idx];
+
+    // Reuse the oldest record if there are no free ones
+    if(numMemberships >= MAX_MEMBERSHIPS)
+    {
+        uint8 oldest = 0;
+        for(uint8 i = 1; i < numMemberships; i++)
+            if((int32)(memberships[i].updateTime - memberships[oldest].updateTime) < 0)
+                oldest = i;
+
+        idx = oldest;
+    }
+    else
+        idx = numMemberships++;
+
+    Membership & membership = memberships[idx];
+    membership.target = target;
+    membership.numGroups = 0;
+    membership.known = false;
+    membership.updateTime = 0;
+    membership.queryTime = 0;
+    return &membership;
+}
+
+bool FanoutPlanner::isFresh(const Membership & membership, uint32 now) const
+{
+    return membership.known && (now - membership.updateTime) < MEMBERSHIP_TTL;
+}
@@ -0,0 +1,77 @@
+#ifndef FANOUTPLANNER_H
+#define FANOUTPLANNER_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// A bound device endpoint. Group membership is per endpoint, so the endpoint is a part of the key.
+struct FanoutTarget
+{
+    uint64 ieeeAddr;
+    uint8 endpoint;
+};
+
+struct FanoutStatistics
+{
+    uint32 unicastFanouts;      // Commands sent as a separate unicast to each bound target
+    uint32 groupcasts;          // Commands collapsed into a single groupcast
+    uint32 framesAvoided;       // Unicast frames replaced by groupcasts
+};
+
+// Decides whether a command for several bound targets may be sent as a single groupcast, and counts how often
+// it is, compared to the commands that still go as a unicast to each target.
+//
+// Group membership of the targets is learned from Get Group Membership responses (or successful Add Group
+// requests) and is considered valid for MEMBERSHIP_TTL.
+//
+// Up to MAX_MEMBERSHIPS targets are remembered. When the cache is full, the least recently updated one is replaced.
+class FanoutPlanner
+{
+public:
+    static const uint8 MIN_FANOUT = 3;
+    static const uint8 MAX_MEMBERSHIPS = 16;
+    static const uint8 MAX_GROUPS_PER_TARGET = 8;
+    static const uint32 MEMBERSHIP_TTL = 3600000;      // 1 hour
+    static const uint32 QUERY_INTERVAL = 60000;        // 1 minute
+
+private:
+    struct Membership
+    {
+        FanoutTarget target;
+        uint16 groups[MAX_GROUPS_PER_TARGET];
+        uint8 numGroups;
+        bool known;
+        uint32 updateTime;
+        uint32 queryTime;
+    };
+
+    Membership memberships[MAX_MEMBERSHIPS];
+    uint8 numMemberships;
+
+    FanoutStatistics stats;
+
+public:
+    FanoutPlanner();
+
+    static bool isFanout(uint8 numTargets);
+
+    void setMembership(const FanoutTarget & target, const uint16 * groups, uint8 numGroups, uint32 now);
+    void addMembership(const FanoutTarget & target, uint16 group, uint32 now);
+    void invalidate();
+    bool findCommonGroup(const FanoutTarget * targets, uint8 numTargets, uint32 now, uint16 * group) const;
+    bool needsQuery(const FanoutTarget & target, uint32 now);
+
+    void handleUnicastFanout();
+    void handleGroupcast(uint8 numTargets);
+
+    const FanoutStatistics & getStatistics() const;
+
+private:
+    int findMembership(const FanoutTarget & target) const;
+    Membership * allocMembership(const FanoutTarget & target);
+    bool isFresh(const Membership & membership, uint32 now) const;
+};
+
+#endif // FANOUTPLANNER_H
@@ -0,0 +1,312 @@
+extern "C"
+{
+    #include "jendefs.h"
+    #include "zps_apl_af.h"
+    #include "zps_apl_zdo.h"
+    #include "dbg.h"
+    #include "OOSC.h"
+}
+
+#include "GroupFanout.h"
+#include "SystemClock.h"
+#include "DiagnosticsCollector.h"
+
+// Group commands are processed by all endpoints of the device that are members of the group
+static const uint8 ALL_ENDPOINTS = 0xFF;
+
+GroupFanout::GroupFanout()
+{
+    collapse.active = false;
+    offeredEndpoints = 0;
+}
+
+GroupFanout * GroupFanout::getInstance()
+{
+    static GroupFanout instance;
+    return &instance;
+}
+
+bool GroupFanout::sendCommand(uint8 endpoint, teCLD_OnOff_Command cmd, const BindingTarget * targets, uint8 numTargets)
+{
+    FanoutTarget fanoutTargets[BindingTable::MAX_TARGETS];
+    uint8 numFanoutTargets = getFanoutTargets(targets, numTargets, fanoutTargets);
+    if(!FanoutPlanner::isFanout(numFanoutTargets))
+        return false;
+
+    uint32 now = SystemClock::getInstance()->getTimeMs();
+    uint16 groupId;
+    if(planner.findCommonGroup(fanoutTargets, numFanoutTargets, now, &groupId))
+    {
+        tsZCL_Address addr;
+        addr.uAddress.u16GroupAddress = groupId;
+        addr.eAddressMode = E_ZCL_AM_GROUP;
+
+        uint8 sequenceNo;
+        teZCL_Status status = eCLD_OnOffCommandSend(endpoint,
+                                       ALL_ENDPOINTS,
+                                       &addr,
+                                       &sequenceNo,
+                                       cmd);
+        DiagnosticsCollector::getInstance()->handleSendStatus(status);
+        DBG_vPrintf(TRUE, "GroupFanout: Sending On/Off command to %d targets as a groupcast to %04x status: %02x\n",
+                    numFanoutTargets, groupId, status);
+
+        // Fall back to the regular bound send if the groupcast cannot be sent
+        if(status != E_ZCL_SUCCESS)
+            return false;
+
+        planner.handleGroupcast(numFanoutTargets);
+        return true;
+    }
+
+    // Learn the targets' groups for the next time
+    for(uint8 i = 0; i < numFanoutTargets; i++)
+        if(planner.needsQuery(fanoutTargets[i], now))
+            queryMembership(endpoint, fanoutTargets[i]);
+
+    offerCollapse(endpoint, numFanoutTargets);
+
+    // The command goes as the regular bound send, a unicast to each target
+    planner.handleUnicastFanout();
+    return false;
+}
+
+void GroupFanout::handleTransmission()
+{
+    // There is no dedicated timer for the collapse, transmission events are frequent enough to check it
+    checkCollapseTimeout();
+}
+
+void GroupFanout::handleGroupsResponse(uint8 endpoint, uint64 srcAddr, uint8 srcEndpoint, tsCLD_GroupsCallBackMessage * msg)
+{
+    switch(msg->u8CommandId)
+    {
+        case E_CLD_GROUPS_CMD_ADD_GROUP:
+            handleAddGroupResponse(srcAddr, srcEndpoint, msg->uMessage.psAddGroupResponsePayload);
+            break;
+
+        case E_CLD_GROUPS_CMD_GET_GROUP_MEMBERSHIP:
+        {
+            tsCLD_Groups_GetGroupMembershipResponsePayload * payload = msg->uMessage.psGetGroupMembershipResponsePayload;
+            DBG_vPrintf(TRUE, "GroupFanout: EP=%d: Device %016llx EP=%d is a member of %d group(s)\n",
+                        endpoint, srcAddr, srcEndpoint, payload->u8GroupCount);
+
+            uint16 groups[FanoutPlanner::MAX_GROUPS_PER_TARGET];
+            uint8 numGroups = 0;
+            for(uint8 i = 0; i < payload->u8GroupCount && numGroups < FanoutPlanner::MAX_GROUPS_PER_TARGET; i++)
+                groups[numGroups++] = payload->pi16GroupList[i];
+
+            FanoutTarget target = {srcAddr, srcEndpoint};
+            planner.setMembership(target, groups, numGroups, SystemClock::getInstance()->getTimeMs());
+            break;
+        }
+
+        default:
+            DBG_vPrintf(TRUE, "GroupFanout: EP=%d: Unexpected Groups response Cmd=%d\n", endpoint, msg->u8CommandId);
+            break;
+    }
+}
+
+void GroupFanout::handleBindingsChanged()
+{
+    // New set of bindings deserves a new offer. Membership information is still valid as it belongs to targets.
+    offeredEndpoints = 0;
+}
+
+bool GroupFanout::collapseToGroup(uint8 endpoint, uint16 groupId)
+{
+    checkCollapseTimeout();
+    if(collapse.active)
+    {
+        DBG_vPrintf(TRUE, "GroupFanout: EP=%d: Another collapse is in progress\n", endpoint);
+        return false;
+    }
+
+    BindingTarget targets[BindingTable::MAX_TARGETS];
+    uint8 numTargets = BindingTable::getTargets(endpoint, GENERAL_CLUSTER_ID_ONOFF, targets, BindingTable::MAX_TARGETS);
+    FanoutTarget fanoutTargets[BindingTable::MAX_TARGETS];
+    uint8 numFanoutTargets = getFanoutTargets(targets, numTargets, fanoutTargets);
+    if(numFanoutTargets == 0)
+    {
+        DBG_vPrintf(TRUE, "GroupFanout: EP=%d: No bindings that can be collapsed\n", endpoint);
+        return false;
+    }
+
+    DBG_vPrintf(TRUE, "GroupFanout: EP=%d: Collapsing %d bindings to group %04x\n", endpoint, numFanoutTargets, groupId);
+
+    collapse.active = true;
+    collapse.endpoint = endpoint;
+    collapse.groupId = groupId;
+    collapse.startTime = SystemClock::getInstance()->getTimeMs();
+    collapse.numTargets = numFanoutTargets;
+
+    // Ask each target to join the group. Bindings are changed only when all of them confirm.
+    char groupName[] = "";
+    tsCLD_Groups_AddGroupRequestPayload payload;
+    payload.u16GroupId = groupId;
+    payload.sGroupName.u8MaxLength = 0;
+    payload.sGroupName.u8Length = 0;
+    payload.sGroupName.pu8Data = (uint8*)groupName;
+
+    for(uint8 i = 0; i < numFanoutTargets; i++)
+    {
+        collapse.targets[i].target = fanoutTargets[i];
+        collapse.targets[i].confirmed = false;
+
+        tsZCL_Address addr;
+        addr.uAddress.u64DestinationAddress = fanoutTargets[i].ieeeAddr;
+        addr.eAddressMode = E_ZCL_AM_IEEE;
+
+        uint8 sequenceNo;
+        teZCL_Status status = eCLD_GroupsCommandAddGroupRequestSend(endpoint,
+                                                                    fanoutTargets[i].endpoint,
+                                                                    &addr,
+                                                                    &sequenceNo,
+                                                                    &payload);
+        DiagnosticsCollector::getInstance()->handleSendStatus(status);
+        DBG_vPrintf(TRUE, "GroupFanout: Sending Add Group to %016llx EP=%d status: %02x\n",
+                    fanoutTargets[i].ieeeAddr, fanoutTargets[i].endpoint, status);
+    }
+
+    return true;
+}
+
+const FanoutStatistics & GroupFanout::getStatistics() const
+{
+    return planner.getStatistics();
+}
+
+void GroupFanout::dumpStatistics() const
+{
+    const FanoutStatistics & stats = planner.getStatistics();
+    DBG_vPrintf(TRUE, "\n+++++++ Fan-out statistics:\n");
+    DBG_vPrintf(TRUE, "    Commands sent as unicasts to each target: %d\n", stats.unicastFanouts);
+    DBG_vPrintf(TRUE, "    Commands sent as a groupcast: %d\n", stats.groupcasts);
+    DBG_vPrintf(TRUE, "    Unicast frames avoided: %d\n", stats.framesAvoided);
+}
+
+uint8 GroupFanout::getFanoutTargets(const BindingTarget * targets, uint8 numTargets, FanoutTarget * fanoutTargets)
+{
+    // Only plain device bindings are considered. Mixed binding sets (with groups or own endpoints) are sent as is.
+    uint8 numFanoutTargets = 0;
+    for(uint8 i = 0; i < numTargets; i++)
+    {
+        if(targets[i].addrMode != ZPS_E_ADDR_MODE_IEEE || targets[i].local)
+            return 0;
+
+        fanoutTargets[numFanoutTargets].ieeeAddr = targets[i].ieeeAddr;
+        fanoutTargets[numFanoutTargets].endpoint = targets[i].dstEndpoint;
+        numFanoutTargets++;
+    }
+
+    return numFanoutTargets;
+}
+
+void GroupFanout::queryMembership(uint8 endpoint, const FanoutTarget & target)
+{
+    tsZCL_Address addr;
+    addr.uAddress.u64DestinationAddress = target.ieeeAddr;
+    addr.eAddressMode = E_ZCL_AM_IEEE;
+
+    // Empty group list requests all the groups of the target endpoint
+    tsCLD_Groups_GetGroupMembershipRequestPayload payload;
+    payload.u8GroupCount = 0;
+    payload.pi16GroupList = NULL;
+
+    uint8 sequenceNo;
+    teZCL_Status status = eCLD_GroupsCommandGetGroupMembershipRequestSend(endpoint,
+                                                                          target.endpoint,
+                                                                          &addr,
+                                                                          &sequenceNo,
+                                                                          &payload);
+    DiagnosticsCollector::getInstance()->handleSendStatus(status);
+    DBG_vPrintf(TRUE, "GroupFanout: Sending Get Group Membership to %016llx EP=%d status: %02x\n",
+                target.ieeeAddr, target.endpoint, status);
+}
+
+void GroupFanout::offerCollapse(uint8 endpoint, uint8 numTargets)
+{
+    uint32 mask = 1UL << endpoint;
+    if(offeredEndpoints & mask)
+        return;
+
+    tsZCL_Address addr;
+    addr.uAddress.u16DestinationAddress = 0x0000;
+    addr.eAddressMode = E_ZCL_AM_SHORT;
+
+    uint8 sequenceNo;
+    teZCL_Status status = eCLD_OOSCGroupCollapseOfferSend(endpoint, 1, &addr, &sequenceNo, numTargets);
+    DiagnosticsCollector::getInstance()->handleSendStatus(status);
+    DBG_vPrintf(TRUE, "GroupFanout: EP=%d: On/Off is bound to %d devices, offering to collapse to a group. Status: %02x\n",
+                endpoint, numTargets, status);
+
+    if(status == E_ZCL_SUCCESS)
+        offeredEndpoints |= mask;
+}
+
+void GroupFanout::handleAddGroupResponse(uint64 srcAddr, uint8 srcEndpoint, tsCLD_Groups_AddGroupResponsePayload * payload)
+{
+    if(!collapse.active || payload->u16GroupId != collapse.groupId)
+        return;
+
+    for(uint8 i = 0; i < collapse.numTargets; i++)
+    {
+        CollapseTarget & t = collapse.targets[i];
+        if(t.target.ieeeAddr != srcAddr || t.target.endpoint != srcEndpoint)
+            continue;
+
+        // The target may already be a member of the group
+        if(payload->eStatus != E_ZCL_CMDS_SUCCESS && payload->eStatus != E_ZCL_CMDS_DUPLICATE_EXISTS)
+        {
+            DBG_vPrintf(TRUE, "GroupFanout: %016llx EP=%d failed to join group %04x (status %02x). Bindings are left as is\n",
+                        srcAddr, srcEndpoint, collapse.groupId, payload->eStatus);
+            collapse.active = false;
+            return;
+        }
+
+        t.confirmed = true;
+        planner.addMembership(t.target, collapse.groupId, SystemClock::getInstance()->getTimeMs());
+    }
+
+    for(uint8 i = 0; i < collapse.numTargets; i++)
+        if(!collapse.targets[i].confirmed)
+            return;
+
+    completeCollapse();
+}
+
+void GroupFanout::checkCollapseTimeout()
+{
+    if(!collapse.active)
+        return;
+
+    if(SystemClock::getInstance()->getTimeMs() - collapse.startTime < COLLAPSE_TIMEOUT)
+        return;
+
+    DBG_vPrintf(TRUE, "GroupFanout: EP=%d: Not all targets joined group %04x in time. Bindings are left as is\n",
+                collapse.endpoint, collapse.groupId);
+    collapse.active = false;
+}
+
+void GroupFanout::completeCollapse()
+{
+    collapse.active = false;
+
+    // Add the group binding first, so that the endpoint never stays without any binding
+    ZPS_teStatus status = ZPS_eAplZdoBindGroup(GENERAL_CLUSTER_ID_ONOFF, collapse.endpoint, collapse.groupId);
+    DBG_vPrintf(TRUE, "GroupFanout: EP=%d: Bind to group %04x status: %02x\n", collapse.endpoint, collapse.groupId, status);
+    if(status != ZPS_E_SUCCESS)
+        return;
+
+    for(uint8 i = 0; i < collapse.numTargets; i++)
+    {
+        const FanoutTarget & target = collapse.targets[i].target;
+        status = ZPS_eAplZdoUnbind(GENERAL_CLUSTER_ID_ONOFF,
+                                   collapse.endpoint,
+                                   ZPS_u16AplZdoLookupAddr(target.ieeeAddr),
+                                   target.ieeeAddr,
+                                   target.endpoint);
+        DBG_vPrintf(TRUE, "GroupFanout: EP=%d: Unbind %016llx EP=%d status: %02x\n",
+                    collapse.endpoint, target.ieeeAddr, target.endpoint, status);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef GROUPFANOUT_H
+#define GROUPFANOUT_H
+
+extern "C"
+{
+    #include "jendefs.h"
+    #include "zcl.h"
+    #include "OnOff.h"
+    #include "Groups.h"
+}
+
+#include "FanoutPlanner.h"
+#include "BindingTable.h"
+
+// Reduces the cost of On/Off commands that are bound to many devices.
+//
+// A command bound to N devices is sent as N unicasts one after another, so the last device switches noticeably
+// later than the first one. When all the targets are known to be members of the same group the command is sent
+// as a single groupcast instead. Otherwise the group membership of the targets is queried in the background, and
+// the coordinator is offered to collapse the bindings into a group (see OOSC Collapse To Group command).
+class GroupFanout
+{
+    static const uint32 COLLAPSE_TIMEOUT = 10000;
+
+    struct CollapseTarget
+    {
+        FanoutTarget target;
+        bool confirmed;
+    };
+
+    // Collapse of the endpoint's bindings into a group in progress
+    struct CollapseRequest
+    {
+        bool active;
+        uint8 endpoint;
+        uint16 groupId;
+        uint32 startTime;
+        uint8 numTargets;
+        CollapseTarget targets[BindingTable::MAX_TARGETS];
+    };
+
+    FanoutPlanner planner;
+    CollapseRequest collapse;
+    uint32 offeredEndpoints;    // Bit mask of endpoints the collapse has been offered for
+
+private:
+    GroupFanout();
+
+public:
+    static GroupFanout * getInstance();
+
+    bool sendCommand(uint8 endpoint, teCLD_OnOff_Command cmd, const BindingTarget * targets, uint8 numTargets);
+    void handleTransmission();
+    void handleGroupsResponse(uint8 endpoint, uint64 srcAddr, uint8 srcEndpoint, tsCLD_GroupsCallBackMessage * msg);
+    void handleBindingsChanged();
+    bool collapseToGroup(uint8 endpoint, uint16 groupId);
+
+    const FanoutStatistics & getStatistics() const;
+    void dumpStatistics() const;
+
+protected:
+    uint8 getFanoutTargets(const BindingTarget * targets, uint8 numTargets, FanoutTarget * fanoutTargets);
+    void queryMembership(uint8 endpoint, const FanoutTarget & target);
+    void offerCollapse(uint8 endpoint, uint8 numTargets);
+    void handleAddGroupResponse(uint64 srcAddr, uint8 srcEndpoint, tsCLD_Groups_AddGroupResponsePayload * payload);
+    void checkCollapseTimeout();
+    void completeCollapse();
+};
+
+#endif // GROUPFANOUT_H
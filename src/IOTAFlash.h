@@ -0,0 +1,20 @@
+#ifndef IOTAFLASH_H
+#define IOTAFLASH_H
+
+#include <jendefs.h>
+
+// Flash access for the OTA image writer. Offsets are relative to the OTA area start, sectors are absolute.
+class IOTAFlash
+{
+public:
+    // Erases the sector and returns the time the CPU was blocked by the erase, in us
+    virtual uint32 eraseFlashSector(uint8 sector) = 0;
+
+    virtual void writeFlash(uint32 offset, const uint8 * data, uint16 len) = 0;
+    virtual void readFlash(uint32 offset, uint8 * data, uint16 len) = 0;
+
+    // Reads the currently running image, which delta images are encoded against
+    virtual void readBaseImage(uint32 offset, uint8 * data, uint16 len) = 0;
+};
+
+#endif //IOTAFLASH_H
@@ -0,0 +1,17 @@
+#ifndef IOTAIMAGESTORAGE_H
+#define IOTAIMAGESTORAGE_H
+
+#include <jendefs.h>
+
+// Flash access for the OTA image decoder
+class IOTAImageStorage
+{
+public:
+    // Writes the reconstructed image data. Offsets are relative to the image start, and go strictly in order.
+    virtual void writeImage(uint32 offset, const uint8 * data, uint16 len) = 0;
+
+    // Reads the currently running image, which delta images are encoded against
+    virtual void readBaseImage(uint32 offset, uint8 * data, uint16 len) = 0;
+};
+
+#endif //IOTAIMAGESTORAGE_H
@@ -0,0 +1,30 @@
+#ifndef ISLEEPPARTICIPANT_H
+#define ISLEEPPARTICIPANT_H
+
+#include <jendefs.h>
+
+// Reasons why a participant does not allow the device to go to sleep
+enum SleepVetoReason
+{
+    SLEEP_VETO_NONE = 0,            // Participant is fine with sleeping
+    SLEEP_VETO_NOT_SLEEPY_DEVICE,   // Device type does not sleep at all (e.g. router)
+    SLEEP_VETO_BUTTON_ACTIVITY,     // User interacted with buttons recently
+    SLEEP_VETO_NETWORK_POLL,        // Waiting for the parent poll response
+    SLEEP_VETO_NETWORK_ACTIVITY,    // Some other network activity is in progress
+    SLEEP_VETO_LED_EFFECT,          // LED effect or fixed level is running
+    SLEEP_VETO_RELAY_PULSE,         // Relay coil pulse is in progress
+    SLEEP_VETO_TIMER_PENDING,       // Some application timer is about to fire
+    SLEEP_VETO_ADC_CONVERSION,      // Temperature sensor conversion is in progress
+};
+
+class ISleepParticipant
+{
+public:
+    // Executed by SleepManager every main loop iteration.
+    // Returns SLEEP_VETO_NONE if the participant allows sleeping, or the reason of the veto otherwise. In the latter
+    // case the participant may also fill the earliest time (SystemClock ms) when sleeping may become acceptable.
+    // The deadline is left as 0 if the participant cannot predict it.
+    virtual SleepVetoReason getSleepVeto(uint32 * earliestSleepTime) = 0;
+};
+
+#endif //ISLEEPPARTICIPANT_H
@@ -127,4 +127,9 @@ void LEDTask::deactivate()
 bool LEDTask::canSleep()
 {
     return !isTimerActive();
+}
+
+SleepVetoReason LEDTask::getSleepVeto(uint32 * earliestSleepTime)
+{
+    return canSleep() ? SLEEP_VETO_NONE : SLEEP_VETO_LED_EFFECT;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define LEDTASK_H
 
 #include "PeriodicTask.h"
+#include "ISleepParticipant.h"
 #include "LEDHandler.h"
 #include "LEDPair.h"
 
@@ -17,7 +18,7 @@ enum LEDTaskSpecialEffect
     // Other effects TBD
 };
 
-class LEDTask : public PeriodicTask
+class LEDTask : public PeriodicTask, public ISleepParticipant
 {
     LEDPair ch1;
 
@@ -37,6 +38,7 @@ public:
     void triggerSpecialEffect(LEDTaskSpecialEffect effect);
 
     bool canSleep();
+    virtual SleepVetoReason getSleepVeto(uint32 * earliestSleepTime);
 
 protected:
     void activate();
@@ -0,0 +1,169 @@
+#include <jendefs.h>
+#include <string.h>
+#include "zcl.h"
+#include "zcl_customcommand.h"
+#include "zcl_options.h"
+#include "LatencyProbe.h"
+
+#ifdef CLD_LATENCY_PROBE
+
+const tsZCL_AttributeDefinition asCLD_LatencyProbeClusterAttributeDefinitions[] = {
+#ifdef LATENCY_PROBE_SERVER
+    {E_CLD_LATENCY_PROBE_ATTR_ID_ECHO_REQUESTS,         (E_ZCL_AF_RD|E_ZCL_AF_MS),  E_ZCL_UINT32,   (uint32)(&((tsCLD_LatencyProbe*)(0))->u32EchoRequests), 0},
+    {E_CLD_LATENCY_PROBE_ATTR_ID_MAX_PROCESSING_TIME,   (E_ZCL_AF_RD|E_ZCL_AF_MS),  E_ZCL_UINT32,   (uint32)(&((tsCLD_LatencyProbe*)(0))->u32MaxProcessingTime), 0},
+#endif
+    {E_CLD_GLOBAL_ATTR_ID_CLUSTER_REVISION,             (E_ZCL_AF_RD|E_ZCL_AF_GA),  E_ZCL_UINT16,   (uint32)(&((tsCLD_LatencyProbe*)(0))->u16ClusterRevision), 0},   // Mandatory
+};
+
+tsZCL_ClusterDefinition sCLD_LatencyProbe = {
+        GENERAL_CLUSTER_ID_LATENCY_PROBE,
+        TRUE,
+        E_ZCL_SECURITY_NETWORK,
+        (sizeof(asCLD_LatencyProbeClusterAttributeDefinitions) / sizeof(tsZCL_AttributeDefinition)),
+        (tsZCL_AttributeDefinition*)asCLD_LatencyProbeClusterAttributeDefinitions,
+        NULL
+};
+
+uint8 au8LatencyProbeAttributeControlBits[(sizeof(asCLD_LatencyProbeClusterAttributeDefinitions) / sizeof(tsZCL_AttributeDefinition))];
+
+PUBLIC teZCL_Status eCLD_LatencyProbeCreateLatencyProbe(
+                tsZCL_ClusterInstance              *psClusterInstance,
+                bool_t                              bIsServer,
+                tsZCL_ClusterDefinition            *psClusterDefinition,
+                void                               *pvEndPointSharedStructPtr,
+                uint8                              *pu8AttributeControlBits,
+                tsCLD_LatencyProbeCustomDataStructure *psCustomDataStructure)
+{
+    #ifdef STRICT_PARAM_CHECK
+        /* Parameter check */
+        if(psClusterInstance==NULL)
+        {
+            return E_ZCL_ERR_PARAMETER_NULL;
+        }
+    #endif
+
+    // cluster data
+    vZCL_InitializeClusterInstance(
+                                   psClusterInstance,
+                                   bIsServer,
+                                   psClusterDefinition,
+                                   pvEndPointSharedStructPtr,
+                                   pu8AttributeControlBits,
+                                   psCustomDataStructure,
+                                   eCLD_LatencyProbeCommandHandler);
+
+    if(psCustomDataStructure != NULL)
+    {
+        psCustomDataStructure->sCustomCallBackEvent.eEventType = E_ZCL_CBET_CLUSTER_CUSTOM;
+        psCustomDataStructure->sCustomCallBackEvent.uMessage.sClusterCustomMessage.u16ClusterId = psClusterDefinition->u16ClusterEnum;
+        psCustomDataStructure->sCustomCallBackEvent.uMessage.sClusterCustomMessage.pvCustomData = (void *)&psCustomDataStructure->sCallBackMessage;
+        psCustomDataStructure->sCustomCallBackEvent.psClusterInstance = psClusterInstance;
+    }
+
+    if(pvEndPointSharedStructPtr != NULL)
+    {
+        tsCLD_LatencyProbe * psProbe = (tsCLD_LatencyProbe*)psClusterInstance->pvEndPointSharedStructPtr;
+        memset(psProbe, 0, sizeof(tsCLD_LatencyProbe));
+        psProbe->u16ClusterRevision = CLD_LATENCY_PROBE_CLUSTER_REVISION;
+    }
+
+    return E_ZCL_SUCCESS;
+}
+
+PUBLIC teZCL_Status eCLD_LatencyProbeCommandHandler(
+                ZPS_tsAfEvent                      *pZPSevent,
+                tsZCL_EndPointDefinition           *psEndPointDefinition,
+                tsZCL_ClusterInstance              *psClusterInstance)
+{
+    tsZCL_HeaderParams sZCL_HeaderParams;
+    tsCLD_LatencyProbeCustomDataStructure *psCommon = (tsCLD_LatencyProbeCustomDataStructure*)psClusterInstance->pvEndPointCustomStructPtr;
+    PDUM_thAPduInstance hAPduInst = pZPSevent->uEvent.sApsDataIndEvent.hAPduInst;
+    uint16 u16Offset = u16ZCL_ReadCommandHeader(hAPduInst, &sZCL_HeaderParams);
+    uint16 u16PayloadSize = PDUM_u16APduInstanceGetPayloadSize(hAPduInst);
+
+    // Only the server receives commands
+    if(psCommon == NULL || !psClusterInstance->bIsServer)
+        return E_ZCL_ERR_CUSTOM_COMMAND_HANDLER_NULL_OR_RETURNED_ERROR;
+
+    eZCL_SetCustomCallBackEvent(&psCommon->sCustomCallBackEvent, pZPSevent, sZCL_HeaderParams.u8TransactionSequenceNumber, psEndPointDefinition->u8EndPointNumber);
+    psCommon->sCustomCallBackEvent.eEventType = E_ZCL_CBET_CLUSTER_CUSTOM;
+    psCommon->sCustomCallBackEvent.uMessage.sClusterCustomMessage.u16ClusterId = psClusterInstance->psClusterDefinition->u16ClusterEnum;
+    psCommon->sCustomCallBackEvent.uMessage.sClusterCustomMessage.pvCustomData = (void *)&psCommon->sCallBackMessage;
+    psCommon->sCustomCallBackEvent.psClusterInstance = psClusterInstance;
+    psCommon->sCallBackMessage.u8CommandId = sZCL_HeaderParams.u8CommandIdentifier;
+
+    switch(sZCL_HeaderParams.u8CommandIdentifier)
+    {
+        case E_CLD_LATENCY_PROBE_CMD_ECHO_REQUEST:
+        {
+            tsCLD_LatencyProbe_EchoRequestPayload * psPayload = &psCommon->sEchoRequestPayload;
+            if(u16PayloadSize < u16Offset + sizeof(uint32) + sizeof(uint8))
+                return E_ZCL_ERR_INSUFFICIENT_SPACE;
+
+            u16Offset += u16ZCL_APduInstanceReadNBO(hAPduInst, u16Offset, E_ZCL_UINT32, &psPayload->u32Sequence);
+            u16Offset += u16ZCL_APduInstanceReadNBO(hAPduInst, u16Offset, E_ZCL_UINT8, &psPayload->u8PayloadLength);
+
+            // Opaque payload is an octet string. Longer payloads are rejected rather than truncated, as the sender
+            // may compare what it gets back.
+            if(psPayload->u8PayloadLength > CLD_LATENCY_PROBE_MAX_PAYLOAD_SIZE ||
+               u16PayloadSize < u16Offset + psPayload->u8PayloadLength)
+                return E_ZCL_ERR_INSUFFICIENT_SPACE;
+
+            uint8 i;
+            for(i = 0; i < psPayload->u8PayloadLength; i++)
+                u16Offset += u16ZCL_APduInstanceReadNBO(hAPduInst, u16Offset, E_ZCL_UINT8, &psPayload->au8Payload[i]);
+
+            psCommon->sCallBackMessage.uMessage.psEchoRequestPayload = psPayload;
+            break;
+        }
+
+        default:
+            return E_ZCL_ERR_CUSTOM_COMMAND_HANDLER_NULL_OR_RETURNED_ERROR;
+    }
+
+    // Let the application handle the command
+    psEndPointDefinition->pCallBackFunctions(&psCommon->sCustomCallBackEvent);
+
+    return E_ZCL_SUCCESS;
+}
+
+PUBLIC teZCL_Status eCLD_LatencyProbeEchoResponseSend(
+                uint8                               u8SourceEndPointId,
+                uint8                               u8DestinationEndPointId,
+                tsZCL_Address                      *psDestinationAddress,
+                uint8                               u8TransactionSequenceNumber,
+                tsCLD_LatencyProbe_EchoResponsePayload *psPayload)
+{
+    PDUM_thAPduInstance hAPduInst = hZCL_AllocateAPduInstance();
+    if(hAPduInst == PDUM_INVALID_HANDLE)
+        return E_ZCL_ERR_ZBUFFER_FAIL;
+
+    // Manufacturer specific cluster command, server to client. The response carries the request's sequence number.
+    uint16 u16Pos = u16ZCL_WriteCommandHeader(hAPduInst,
+                                              eFRAME_TYPE_COMMAND_IS_SPECIFIC_TO_A_CLUSTER,
+                                              TRUE,
+                                              ZCL_MANUFACTURER_CODE,
+                                              TRUE,
+                                              TRUE,
+                                              u8TransactionSequenceNumber,
+                                              E_CLD_LATENCY_PROBE_CMD_ECHO_RESPONSE);
+    u16Pos += u16ZCL_APduInstanceWriteNBO(hAPduInst, u16Pos, E_ZCL_UINT32, &psPayload->u32Sequence);
+    u16Pos += u16ZCL_APduInstanceWriteNBO(hAPduInst, u16Pos, E_ZCL_UINT32, &psPayload->u32ReceiveTime);
+    u16Pos += u16ZCL_APduInstanceWriteNBO(hAPduInst, u16Pos, E_ZCL_UINT16, &psPayload->u16ProcessingTime);
+    u16Pos += u16ZCL_APduInstanceWriteNBO(hAPduInst, u16Pos, E_ZCL_UINT8, &psPayload->u8Backlog);
+    u16Pos += u16ZCL_APduInstanceWriteNBO(hAPduInst, u16Pos, E_ZCL_UINT8, &psPayload->u8PayloadLength);
+
+    uint8 i;
+    for(i = 0; i < psPayload->u8PayloadLength; i++)
+        u16Pos += u16ZCL_APduInstanceWriteNBO(hAPduInst, u16Pos, E_ZCL_UINT8, &psPayload->pu8Payload[i]);
+
+    // The APDU is released by the stack once transmitted
+    return eZCL_TransmitDataRequest(hAPduInst,
+                                    u16Pos,
+                                    u8SourceEndPointId,
+                                    u8DestinationEndPointId,
+                                    GENERAL_CLUSTER_ID_LATENCY_PROBE,
+                                    psDestinationAddress);
+}
+
+#endif
@@ -0,0 +1,118 @@
+// Manufacturer specific cluster that answers timestamped echo requests, so that the network round trip time can be
+// measured separately from the time spent in the device.
+
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <jendefs.h>
+#include "zcl.h"
+#include "zcl_options.h"
+
+// Cluster ID's
+#define GENERAL_CLUSTER_ID_LATENCY_PROBE                0xFC01
+
+#ifndef CLD_LATENCY_PROBE_CLUSTER_REVISION
+    #define CLD_LATENCY_PROBE_CLUSTER_REVISION          1
+#endif
+
+// Maximum size of the opaque payload echoed back to the sender
+#ifndef CLD_LATENCY_PROBE_MAX_PAYLOAD_SIZE
+    #define CLD_LATENCY_PROBE_MAX_PAYLOAD_SIZE          32
+#endif
+
+// Latency Probe attribute ID's
+typedef enum
+{
+    E_CLD_LATENCY_PROBE_ATTR_ID_ECHO_REQUESTS       = 0x0000,   // Echo requests answered
+    E_CLD_LATENCY_PROBE_ATTR_ID_MAX_PROCESSING_TIME = 0x0001,   // Longest receive-to-send time (us)
+} teCLD_LatencyProbe_AttributeID;
+
+// Commands received by the server
+typedef enum
+{
+    E_CLD_LATENCY_PROBE_CMD_ECHO_REQUEST            = 0x00,
+} teCLD_LatencyProbe_ServerReceivedCommandID;
+
+// Commands generated by the server
+typedef enum
+{
+    E_CLD_LATENCY_PROBE_CMD_ECHO_RESPONSE           = 0x00,
+} teCLD_LatencyProbe_ServerGeneratedCommandID;
+
+
+// Latency Probe Cluster
+typedef struct
+{
+#ifdef LATENCY_PROBE_SERVER
+    zuint32                 u32EchoRequests;
+    zuint32                 u32MaxProcessingTime;
+#endif
+    zuint16                 u16ClusterRevision;
+} tsCLD_LatencyProbe;
+
+
+// Echo Request command payload
+typedef struct
+{
+    zuint32                 u32Sequence;                // Chosen by the sender, echoed back as is
+    zuint8                  u8PayloadLength;
+    zuint8                  au8Payload[CLD_LATENCY_PROBE_MAX_PAYLOAD_SIZE];
+} tsCLD_LatencyProbe_EchoRequestPayload;
+
+// Echo Response command payload
+typedef struct
+{
+    zuint32                 u32Sequence;
+    zuint32                 u32ReceiveTime;             // Device clock (ms) when the request was taken from the stack
+    zuint16                 u16ProcessingTime;          // Receive-to-send time in the device (us)
+    zuint8                  u8Backlog;                  // Stack events waiting in the queues behind the request
+    zuint8                  u8PayloadLength;
+    zuint8                  *pu8Payload;
+} tsCLD_LatencyProbe_EchoResponsePayload;
+
+// Definition of Latency Probe Call back Event Structure
+typedef struct
+{
+    uint8                   u8CommandId;
+    union
+    {
+        tsCLD_LatencyProbe_EchoRequestPayload   *psEchoRequestPayload;
+    } uMessage;
+} tsCLD_LatencyProbeCallBackMessage;
+
+// Custom data structure
+typedef struct
+{
+    tsZCL_ReceiveEventAddress               sReceiveEventAddress;
+    tsZCL_CallBackEvent                     sCustomCallBackEvent;
+    tsCLD_LatencyProbeCallBackMessage       sCallBackMessage;
+    tsCLD_LatencyProbe_EchoRequestPayload   sEchoRequestPayload;
+} tsCLD_LatencyProbeCustomDataStructure;
+
+
+PUBLIC teZCL_Status eCLD_LatencyProbeCreateLatencyProbe(
+                tsZCL_ClusterInstance              *psClusterInstance,
+                bool_t                              bIsServer,
+                tsZCL_ClusterDefinition            *psClusterDefinition,
+                void                               *pvEndPointSharedStructPtr,
+                uint8                              *pu8AttributeControlBits,
+                tsCLD_LatencyProbeCustomDataStructure *psCustomDataStructure);
+
+PUBLIC teZCL_Status eCLD_LatencyProbeCommandHandler(
+                ZPS_tsAfEvent                      *pZPSevent,
+                tsZCL_EndPointDefinition           *psEndPointDefinition,
+                tsZCL_ClusterInstance              *psClusterInstance);
+
+PUBLIC teZCL_Status eCLD_LatencyProbeEchoResponseSend(
+                uint8                               u8SourceEndPointId,
+                uint8                               u8DestinationEndPointId,
+                tsZCL_Address                      *psDestinationAddress,
+                uint8                               u8TransactionSequenceNumber,
+                tsCLD_LatencyProbe_EchoResponsePayload *psPayload);
+
+
+extern tsZCL_ClusterDefinition sCLD_LatencyProbe;
+extern uint8 au8LatencyProbeAttributeControlBits[];
+extern const tsZCL_AttributeDefinition asCLD_LatencyProbeClusterAttributeDefinitions[];
+
+#endif /* LATENCY_PROBE_H */
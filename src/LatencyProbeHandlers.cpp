@@ -0,0 +1,76 @@
+extern "C"
+{
+    #include "jendefs.h"
+    #include "dbg.h"
+}
+
+#include "LatencyProbeHandlers.h"
+#include "SystemClock.h"
+#include "ZigbeeDevice.h"
+#include "DiagnosticsCollector.h"
+
+LatencyProbeHandlers::LatencyProbeHandlers()
+{
+    ep = 0;
+    latencyProbeCluster = NULL;
+}
+
+void LatencyProbeHandlers::init(uint8 endpoint, tsCLD_LatencyProbe * cluster)
+{
+    ep = endpoint;
+    latencyProbeCluster = cluster;
+}
+
+void LatencyProbeHandlers::handleLatencyProbeMessage(tsZCL_CallBackEvent * psEvent)
+{
+    tsCLD_LatencyProbeCallBackMessage * msg = (tsCLD_LatencyProbeCallBackMessage *)psEvent->uMessage.sClusterCustomMessage.pvCustomData;
+
+    switch(msg->u8CommandId)
+    {
+        case E_CLD_LATENCY_PROBE_CMD_ECHO_REQUEST:
+            handleEchoRequest(psEvent, msg->uMessage.psEchoRequestPayload);
+            break;
+
+        default:
+            DBG_vPrintf(TRUE, "LatencyProbeHandlers: Unexpected command %d\n", msg->u8CommandId);
+            break;
+    }
+}
+
+void LatencyProbeHandlers::handleEchoRequest(tsZCL_CallBackEvent * psEvent, tsCLD_LatencyProbe_EchoRequestPayload * request)
+{
+    ZigbeeDevice * device = ZigbeeDevice::getInstance();
+    ZPS_tsAfDataIndEvent * pIndication = &psEvent->pZPSevent->uEvent.sApsDataIndEvent;
+
+    // Everything that may take time is done before the processing time is measured
+    tsZCL_Address addr;
+    addr.eAddressMode = E_ZCL_AM_SHORT_NO_ACK;      // The response itself confirms the delivery
+    addr.uAddress.u16DestinationAddress = pIndication->uSrcAddress.u16Addr;
+
+    tsCLD_LatencyProbe_EchoResponsePayload response;
+    response.u32Sequence = request->u32Sequence;
+    response.u8Backlog = device->getEventBacklog();
+    response.u8PayloadLength = request->u8PayloadLength;
+    response.pu8Payload = request->au8Payload;
+
+    SystemClock * clock = SystemClock::getInstance();
+    uint32 processingTime = clock->getTimeUs() - device->getIndicationTime();
+    response.u32ReceiveTime = clock->getTimeMs() - processingTime / 1000;
+    response.u16ProcessingTime = processingTime > 0xffff ? 0xffff : (uint16)processingTime;
+
+    teZCL_Status status = eCLD_LatencyProbeEchoResponseSend(ep,
+                                                            pIndication->u8SrcEndpoint,
+                                                            &addr,
+                                                            psEvent->u8TransactionSequenceNumber,
+                                                            &response);
+    DiagnosticsCollector::getInstance()->handleSendStatus(status);
+    if(status != E_ZCL_SUCCESS)
+        DBG_vPrintf(TRUE, "LatencyProbeHandlers: Failed to send echo response. Status=%d\n", status);
+
+    if(latencyProbeCluster)
+    {
+        latencyProbeCluster->u32EchoRequests++;
+        if(processingTime > latencyProbeCluster->u32MaxProcessingTime)
+            latencyProbeCluster->u32MaxProcessingTime = processingTime;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef LATENCYPROBEHANDLERS_H
+#define LATENCYPROBEHANDLERS_H
+
+extern "C"
+{
+    #include "jendefs.h"
+    #include "zcl.h"
+    #include "LatencyProbe.h"
+}
+
+// Latency Probe cluster server logic.
+//
+// Echo requests are answered right from the ZCL callback, without going through any application queues. The
+// response carries the time the request spent in the device (from the moment the stack handed it to the application
+// till the response is handed back to the stack), and the number of stack events waiting behind it. The sender
+// subtracts the former from its round trip time to get the pure network latency, while the latter shows whether the
+// device was busy.
+class LatencyProbeHandlers
+{
+    uint8 ep;
+    tsCLD_LatencyProbe * latencyProbeCluster;
+
+public:
+    LatencyProbeHandlers();
+
+    void init(uint8 ep, tsCLD_LatencyProbe * cluster);
+    void handleLatencyProbeMessage(tsZCL_CallBackEvent * psEvent);
+
+private:
+    void handleEchoRequest(tsZCL_CallBackEvent * psEvent, tsCLD_LatencyProbe_EchoRequestPayload * request);
+};
+
+#endif // LATENCYPROBEHANDLERS_H
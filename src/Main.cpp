@@ -22,8 +22,17 @@ extern "C"
 #include "LEDTask.h"
 #include "BlinkTask.h"
 #include "RelayTask.h"
+#include "SleepManager.h"
+#include "SystemClock.h"
 #include "DumpFunctions.h"
 #include "DebugInput.h"
+#include "ReportAggregator.h"
+#include "ReportManager.h"
+#include "DeliveryTracker.h"
+#include "TimedOffTask.h"
+#include "TemperatureSampler.h"
+#include "DiagnosticsCollector.h"
+#include "MemoryMonitor.h"
 
 
 // Hidden funcctions (exported from the library, but not mentioned in header files)
@@ -35,15 +44,20 @@ extern "C"
 }
 
 
-// 7 timers are:
+// 11 timers are:
 // - 1 in ButtonTask
 // - 1 in LEDTask
 // - 1 in RelayTask
 // - 1 in Heartbeat BlinkTask
 // - 1 in PollTask
+// - 1 in RejoinTask
+// - 1 in AddressResolver
 // - 1 is ZCL timer
+// - 1 in TimedOffTask
+// - 1 in TemperatureSampler
+// - 1 in MemoryMonitor
 // Note: if not enough space in this timers array, some of the functions (e.g. network joining) may not work properly
-ZTIMER_tsTimer timers[7 + BDB_ZTIMER_STORAGE];
+ZTIMER_tsTimer timers[11 + BDB_ZTIMER_STORAGE];
 
 extern "C" void __cxa_pure_virtual(void) __attribute__((__noreturn__));
 extern "C" void __cxa_deleted_virtual(void) __attribute__((__noreturn__));
@@ -79,6 +93,9 @@ extern "C" PUBLIC void vISR_SystemController(void)
 void vfExtendedStatusCallBack (ZPS_teExtendedStatus eExtendedStatus)
 {
     DBG_vPrintf(TRUE,"ERROR: Extended status %x\n", eExtendedStatus);
+
+    if(eExtendedStatus == ZPS_XS_E_NO_FREE_NPDU || eExtendedStatus == ZPS_XS_E_NO_FREE_APDU)
+        DiagnosticsCollector::getInstance()->handleBufferAllocFailure();
 }
 
 PUBLIC void wakeCallBack(void)
@@ -86,15 +103,27 @@ PUBLIC void wakeCallBack(void)
     DBG_vPrintf(TRUE, "=-=-=- wakeCallBack()\n");
 }
 
-PRIVATE void scheduleSleep()
+PRIVATE void scheduleSleep(BasicClusterEndpoint * basicEndpoint)
 {
-    if(ButtonsTask::getInstance()->canSleep() &&
-       ZigbeeDevice::getInstance()->canSleep() &&
-       LEDTask::getInstance()->canSleep() &&
-       RelayTask::getInstance()->canSleep())
+    if(SleepManager::getInstance()->canSleep())
     {
+        // Let the OTA download survive if the device does not wake up
+        basicEndpoint->handleSleep();
+
         static pwrm_tsWakeTimerEvent wakeStruct;
-        PWRM_teStatus status = PWRM_eScheduleActivity(&wakeStruct, 15 * 32000, wakeCallBack);
+        uint32 sleepDuration = ZigbeeDevice::getInstance()->getSleepDuration();   // ms
+
+        // Wake up in time to switch the relay off when the OnTime is over
+        uint32 timedOffDelay = TimedOffTask::getInstance()->getTimeTillNextChange();
+        if(timedOffDelay != 0 && timedOffDelay < sleepDuration)
+            sleepDuration = timedOffDelay > 10 ? timedOffDelay : 10;
+
+        // Wake up exactly when the next attribute report is due, rather than every second to check for that
+        uint32 reportDelay = ReportManager::getInstance()->getTimeTillNextReport();
+        if(reportDelay != 0 && reportDelay < sleepDuration)
+            sleepDuration = reportDelay > 10 ? reportDelay : 10;
+
+        PWRM_teStatus status = PWRM_eScheduleActivity(&wakeStruct, sleepDuration * 32, wakeCallBack);
         if(status != PWRM_E_TIMER_RUNNING)
             DBG_vPrintf(TRUE, "=-=-=- Scheduling enter sleep mode... status=%d\n", status);
     }
@@ -102,6 +131,9 @@ PRIVATE void scheduleSleep()
 
 extern "C" PUBLIC void vAppMain(void)
 {
+    // Paint the stack and the heap before anything uses them, for the high-water mark checks
+    MemoryMonitor::getInstance()->paint();
+
     // Initialize the hardware
     TARGET_INITIALISE();
     SET_IPL(0);
@@ -127,6 +159,10 @@ extern "C" PUBLIC void vAppMain(void)
     DBG_vPrintf(TRUE, "vAppMain(): init PWRM...\n");
     PWRM_vInit(E_AHI_SLEEP_OSCON_RAMON);
 
+    // Start the free running clock (used for time measurements)
+    DBG_vPrintf(TRUE, "vAppMain(): init system clock...\n");
+    SystemClock::getInstance()->init();
+
     // PDU Manager initialization
     DBG_vPrintf(TRUE, "vAppMain(): init PDUM...\n");
     PDUM_vInit();
@@ -141,6 +177,8 @@ extern "C" PUBLIC void vAppMain(void)
     ButtonsTask::getInstance()->start();
     LEDTask::getInstance();
     RelayTask::getInstance();
+    TimedOffTask::getInstance();
+    MemoryMonitor::getInstance()->start();
 
     // Initialize the heartbeat LED (if there is one)
 #ifdef HEARTBEAT_LED_MASK
@@ -174,9 +212,19 @@ extern "C" PUBLIC void vAppMain(void)
     EndpointManager::getInstance()->registerEndpoint(SWITCHB_ENDPOINT, &switchBoth);
 #endif
 
+    // Restore attribute reporting configuration, after the endpoints have migrated their legacy records
+    ReportManager::getInstance()->restore();
+
     // Init the ZigbeeDevice, AF, BDB, and other network stuff
     ZigbeeDevice::getInstance();
 
+    // Register all components that may prevent the device from sleeping
+    SleepManager::getInstance()->registerParticipant("Buttons", ButtonsTask::getInstance());
+    SleepManager::getInstance()->registerParticipant("Network", ZigbeeDevice::getInstance());
+    SleepManager::getInstance()->registerParticipant("LEDs", LEDTask::getInstance());
+    SleepManager::getInstance()->registerParticipant("Relays", RelayTask::getInstance());
+    SleepManager::getInstance()->registerParticipant("Temperature", TemperatureSampler::getInstance());
+
     // Print Initialization finished message
     DBG_vPrintf(TRUE, "\n---------------------------------------------------\n");
     DBG_vPrintf(TRUE, "Initialization of the Hello Zigbee Platform Finished\n");
@@ -198,8 +246,22 @@ extern "C" PUBLIC void vAppMain(void)
         // Process all incoming debug input
         DebugInput::getInstance().handleInput();
 
+        // Process the temperature sample taken in the background
+        TemperatureSampler::getInstance()->handleSample();
+
+        // Update diagnostics counters changed during this iteration
+        DiagnosticsCollector::getInstance()->flush();
+
+        // Send attribute reports collected during this iteration, along with retries of undelivered ones
+        ReportManager::getInstance()->flush();
+        DeliveryTracker::getInstance()->flush();
+        ReportAggregator::getInstance()->flush();
+
+        // Prepare OTA flash sectors ahead of the download, while nothing else is going on
+        basicEndpoint.handleIdle();
+
         // Schedule sleep, if no activities are running. Reset the watchdog timer.
-        scheduleSleep();
+        scheduleSleep(&basicEndpoint);
         vAHI_WatchdogRestart();
         PWRM_vManagePower();
     }
@@ -249,6 +311,7 @@ PWRM_CALLBACK(Wakeup)
 
     // Wake the timers
     ZTIMER_vWake();
+    ZCLTimer::getInstance()->handleWakeUp();
 
     // Poll the parent router for zigbee messages
     ZigbeeDevice::getInstance()->handleWakeUp();
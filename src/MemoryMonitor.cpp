@@ -0,0 +1,117 @@
+extern "C"
+{
+    #include "dbg.h"
+
+    // Local configuration and generated files
+    #include "pdum_gen.h"
+
+    // Region bounds defined in HelloZigbee.ld
+    extern uint32 _heap_region_start;
+    extern uint32 _heap_region_end;
+    extern uint32 _stack_region_start;
+    extern uint32 _stack_region_end;
+}
+
+#include "MemoryMonitor.h"
+
+MemoryMonitor::MemoryMonitor()
+{
+    // The timer is set up in start(), the regions are painted before software timers are initialized
+    stack.init(&_stack_region_start, &_stack_region_end, MemoryWatermark::GROWS_DOWN);
+    heap.init(&_heap_region_start, &_heap_region_end, MemoryWatermark::GROWS_UP);
+
+    stats.checks = 0;
+    stats.stackSize = stack.getSize();
+    stats.stackMaxUsed = 0;
+    stats.heapSize = heap.getSize();
+    stats.heapMaxUsed = 0;
+    stats.freeZclApdus = 0;
+    stats.minFreeZclApdus = 0xff;
+    stats.freeZdpApdus = 0;
+    stats.minFreeZdpApdus = 0xff;
+}
+
+MemoryMonitor * MemoryMonitor::getInstance()
+{
+    static MemoryMonitor instance;
+    return &instance;
+}
+
+void MemoryMonitor::paint()
+{
+    // Paint the stack below the current frame, leaving room for the painting code itself
+    uint32 marker;
+    stack.paint((uint32*)((uint32)&marker - STACK_PAINT_MARGIN));
+
+    // Nothing is allocated on the heap yet
+    heap.paint(&_heap_region_start);
+}
+
+void MemoryMonitor::start()
+{
+    PeriodicTask::init(CHECK_PERIOD);
+    startTimer(CHECK_PERIOD);
+
+    // Have the values ready for the first read
+    check();
+}
+
+void MemoryMonitor::timerCallback()
+{
+    check();
+}
+
+void MemoryMonitor::check()
+{
+    stats.checks++;
+    stats.stackMaxUsed = stack.update();
+    stats.heapMaxUsed = heap.update();
+
+    stats.freeZclApdus = countFreeApdus(apduZCL);
+    if(stats.freeZclApdus < stats.minFreeZclApdus)
+        stats.minFreeZclApdus = stats.freeZclApdus;
+
+    stats.freeZdpApdus = countFreeApdus(apduZDP);
+    if(stats.freeZdpApdus < stats.minFreeZdpApdus)
+        stats.minFreeZdpApdus = stats.freeZdpApdus;
+
+    if(stack.isExhausted())
+        DBG_vPrintf(TRUE, "MemoryMonitor: Warning: the whole stack has been used, it may have overflowed\n");
+}
+
+uint8 MemoryMonitor::countFreeApdus(PDUM_thAPdu apdu)
+{
+    // PDUM does not tell the number of free instances, so take all of them, and give them back right away.
+    // Only the main loop allocates APDUs, so nobody else notices.
+    PDUM_thAPduInstance instances[MAX_APDU_INSTANCES];
+    uint8 count = 0;
+    while(count < MAX_APDU_INSTANCES)
+    {
+        PDUM_thAPduInstance hAPduInst = PDUM_hAPduAllocateAPduInstance(apdu);
+        if(hAPduInst == PDUM_INVALID_HANDLE)
+            break;
+
+        instances[count++] = hAPduInst;
+    }
+
+    for(uint8 i = 0; i < count; i++)
+        PDUM_eAPduFreeAPduInstance(instances[i]);
+
+    return count;
+}
+
+const MemoryStatistics & MemoryMonitor::getStatistics() const
+{
+    return stats;
+}
+
+void MemoryMonitor::dumpStatistics() const
+{
+    DBG_vPrintf(TRUE, "\n+++++++ Memory statistics:\n");
+    DBG_vPrintf(TRUE, "    Stack: %d of %d bytes used%s\n", stats.stackMaxUsed, stats.stackSize,
+                stack.isExhausted() ? " (may have overflowed)" : "");
+    DBG_vPrintf(TRUE, "    Heap: %d of %d bytes used\n", stats.heapMaxUsed, stats.heapSize);
+    DBG_vPrintf(TRUE, "    Free ZCL APDUs: %d (min %d)\n", stats.freeZclApdus, stats.minFreeZclApdus);
+    DBG_vPrintf(TRUE, "    Free ZDP APDUs: %d (min %d)\n", stats.freeZdpApdus, stats.minFreeZdpApdus);
+    DBG_vPrintf(TRUE, "    Checks: %d\n", stats.checks);
+}
@@ -0,0 +1,61 @@
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+extern "C"
+{
+    #include "pdum_apl.h"
+}
+
+#include "PeriodicTask.h"
+#include "MemoryWatermark.h"
+
+struct MemoryStatistics
+{
+    uint32 checks;              // Periodic checks done since startup
+    uint32 stackSize;           // bytes
+    uint32 stackMaxUsed;        // Deepest stack use since startup, bytes
+    uint32 heapSize;
+    uint32 heapMaxUsed;
+    uint8 freeZclApdus;         // APDU instances free at the last check
+    uint8 minFreeZclApdus;      // Fewest free APDU instances seen by the checks
+    uint8 freeZdpApdus;
+    uint8 minFreeZdpApdus;
+};
+
+// Measures the RAM headroom in the field: stack and heap high-water marks, and free APDU buffers.
+//
+// The stack and heap regions defined by HelloZigbee.ld are painted at the very start of vAppMain(). Every
+// CHECK_PERIOD the task scans them for the deepest use so far (see MemoryWatermark), and counts the free instances
+// of each APDU pool. Counts are sampled, so a short burst that uses up the pool between checks may be missed.
+//
+// The values are printed with the MEMORY_STATS debug command, and exposed through the Device Statistics cluster.
+// Checks run from the main loop, and do not prevent the device from sleeping.
+class MemoryMonitor : public PeriodicTask
+{
+    static const uint32 CHECK_PERIOD = 10000;       // ms
+    static const uint32 STACK_PAINT_MARGIN = 256;   // bytes below the current stack pointer left unpainted
+    static const uint8 MAX_APDU_INSTANCES = 32;     // probe limit, more than any pool in the zpscfg
+
+    MemoryWatermark stack;
+    MemoryWatermark heap;
+    MemoryStatistics stats;
+
+private:
+    MemoryMonitor();
+
+public:
+    static MemoryMonitor * getInstance();
+
+    void paint();
+    void start();
+    void check();
+
+    const MemoryStatistics & getStatistics() const;
+    void dumpStatistics() const;
+
+protected:
+    virtual void timerCallback();
+    uint8 countFreeApdus(PDUM_thAPdu apdu);
+};
+
+#endif // MEMORYMONITOR_H
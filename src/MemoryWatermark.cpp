@@ -0,0 +1,72 @@
+#include "MemoryWatermark.h"
+
+MemoryWatermark::MemoryWatermark()
+{
+    start = NULL;
+    end = NULL;
+    direction = GROWS_DOWN;
+    maxUsed = 0;
+}
+
+void MemoryWatermark::init(uint32 * regionStart, uint32 * regionEnd, Direction dir)
+{
+    start = regionStart;
+    end = regionEnd > regionStart ? regionEnd : regionStart;
+    direction = dir;
+    maxUsed = 0;
+}
+
+void MemoryWatermark::paint(uint32 * usedBoundary)
+{
+    // The part that is already in use is not touched, and counts as used
+    if(usedBoundary < start)
+        usedBoundary = start;
+    if(usedBoundary > end)
+        usedBoundary = end;
+
+    uint32 * from = direction == GROWS_DOWN ? start : usedBoundary;
+    uint32 * to = direction == GROWS_DOWN ? usedBoundary : end;
+    for(uint32 * ptr = from; ptr < to; ptr++)
+        *ptr = PATTERN;
+
+    maxUsed = (uint32)((direction == GROWS_DOWN ? end - usedBoundary : usedBoundary - start) * sizeof(uint32));
+}
+
+uint32 MemoryWatermark::update()
+{
+    uint32 freeWords = 0;
+    uint32 words = (uint32)(end - start);
+
+    // Count the words still holding the pattern, starting from the end that is used last
+    if(direction == GROWS_DOWN)
+    {
+        while(freeWords < words && start[freeWords] == PATTERN)
+            freeWords++;
+    }
+    else
+    {
+        while(freeWords < words && *(end - 1 - freeWords) == PATTERN)
+            freeWords++;
+    }
+
+    uint32 used = (words - freeWords) * sizeof(uint32);
+    if(used > maxUsed)
+        maxUsed = used;
+
+    return maxUsed;
+}
+
+uint32 MemoryWatermark::getSize() const
+{
+    return (uint32)((end - start) * sizeof(uint32));
+}
+
+uint32 MemoryWatermark::getMaxUsed() const
+{
+    return maxUsed;
+}
+
+bool MemoryWatermark::isExhausted() const
+{
+    return end != start && maxUsed == getSize();
+}
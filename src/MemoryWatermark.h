@@ -0,0 +1,46 @@
+#ifndef MEMORYWATERMARK_H
+#define MEMORYWATERMARK_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// Finds how deep a RAM region (the stack or the heap) has ever been used.
+//
+// The unused part of the region is painted with a known pattern at startup. A check scans the region from its far
+// end towards the used part, the first word that does not hold the pattern anymore marks the deepest use so far.
+// The stack grows down from the end of its region, the heap grows up from its start.
+//
+// A word that was written with the pattern value is taken as unused, so the result may be a few bytes short. A
+// region used up to its far end may as well have overflowed into the neighbor memory.
+class MemoryWatermark
+{
+public:
+    static const uint32 PATTERN = 0xA55AC33C;
+
+    enum Direction
+    {
+        GROWS_UP,
+        GROWS_DOWN
+    };
+
+private:
+    uint32 * start;
+    uint32 * end;
+    Direction direction;
+    uint32 maxUsed;             // bytes
+
+public:
+    MemoryWatermark();
+
+    void init(uint32 * start, uint32 * end, Direction direction);
+    void paint(uint32 * usedBoundary);
+    uint32 update();
+
+    uint32 getSize() const;
+    uint32 getMaxUsed() const;
+    bool isExhausted() const;
+};
+
+#endif // MEMORYWATERMARK_H
@@ -3,6 +3,7 @@
 
 #include <jendefs.h>
 #include "zcl.h"
+#include "zcl_customcommand.h"
 #include "OOSC.h"
 #include "zcl_options.h"
 #include "OOSC.h"
@@ -22,6 +23,7 @@ const tsZCL_AttributeDefinition asCLD_OOSCClusterAttributeDefinitions[] = {
     {E_CLD_OOSC_ATTR_ID_SWITCH_LONG_PRESS_MODE, (E_ZCL_AF_RD|E_ZCL_AF_WR|E_ZCL_AF_MS),  E_ZCL_ENUM8,    (uint32)(&((tsCLD_OOSC*)(0))->eLongPressMode), 0},
     {E_CLD_OOSC_ATTR_ID_SWITCH_OPERATION_MODE,  (E_ZCL_AF_RD|E_ZCL_AF_WR|E_ZCL_AF_MS),  E_ZCL_ENUM8,    (uint32)(&((tsCLD_OOSC*)(0))->eOperationMode), 0},
     {E_CLD_OOSC_ATTR_ID_SWITCH_INTERLOCK_MODE,  (E_ZCL_AF_RD|E_ZCL_AF_WR|E_ZCL_AF_MS),  E_ZCL_ENUM8,    (uint32)(&((tsCLD_OOSC*)(0))->eInterlockMode), 0},
+    {E_CLD_OOSC_ATTR_ID_AUTOMATION_RULES,       (E_ZCL_AF_RD|E_ZCL_AF_WR|E_ZCL_AF_MS),  E_ZCL_OSTRING,  (uint32)(&((tsCLD_OOSC*)(0))->sAutomationRules), 0},
 
 #endif        
     {E_CLD_GLOBAL_ATTR_ID_CLUSTER_REVISION,     (E_ZCL_AF_RD|E_ZCL_AF_GA),              E_ZCL_UINT16,   (uint32)(&((tsCLD_OOSC*)(0))->u16ClusterRevision), 0},   // Mandatory
@@ -44,7 +46,8 @@ PUBLIC  teZCL_Status eCLD_OOSCCreateOnOffSwitchConfig(
                 bool_t                              bIsServer,
                 tsZCL_ClusterDefinition            *psClusterDefinition,
                 void                               *pvEndPointSharedStructPtr,
-                uint8                              *pu8AttributeControlBits)
+                uint8                              *pu8AttributeControlBits,
+                tsCLD_OOSCCustomDataStructure      *psCustomDataStructure)
 {
 
     #ifdef STRICT_PARAM_CHECK 
@@ -62,8 +65,16 @@ PUBLIC  teZCL_Status eCLD_OOSCCreateOnOffSwitchConfig(
                                    psClusterDefinition,
                                    pvEndPointSharedStructPtr,
                                    pu8AttributeControlBits,
-                                   NULL,
-                                   NULL);    
+                                   psCustomDataStructure,
+                                   eCLD_OOSCCommandHandler);
+
+        if(psCustomDataStructure != NULL)
+        {
+            psCustomDataStructure->sCustomCallBackEvent.eEventType = E_ZCL_CBET_CLUSTER_CUSTOM;
+            psCustomDataStructure->sCustomCallBackEvent.uMessage.sClusterCustomMessage.u16ClusterId = psClusterDefinition->u16ClusterEnum;
+            psCustomDataStructure->sCustomCallBackEvent.uMessage.sClusterCustomMessage.pvCustomData = (void *)&psCustomDataStructure->sCallBackMessage;
+            psCustomDataStructure->sCustomCallBackEvent.psClusterInstance = psClusterInstance;
+        }
 
         if(pvEndPointSharedStructPtr != NULL)
         {
@@ -77,6 +88,10 @@ PUBLIC  teZCL_Status eCLD_OOSCCreateOnOffSwitchConfig(
             ((tsCLD_OOSC*)psClusterInstance->pvEndPointSharedStructPtr)->eLongPressMode = E_CLD_OOSC_LONG_PRESS_MODE_NONE;
             ((tsCLD_OOSC*)psClusterInstance->pvEndPointSharedStructPtr)->eOperationMode = E_CLD_OOSC_OPERATION_MODE_SERVER;
             ((tsCLD_OOSC*)psClusterInstance->pvEndPointSharedStructPtr)->eOperationMode = E_CLD_OOSC_INTERLOCK_MODE_NONE;
+            // Rules storage is provided by the endpoint
+            ((tsCLD_OOSC*)psClusterInstance->pvEndPointSharedStructPtr)->sAutomationRules.u8MaxLength = 0;
+            ((tsCLD_OOSC*)psClusterInstance->pvEndPointSharedStructPtr)->sAutomationRules.u8Length = 0;
+            ((tsCLD_OOSC*)psClusterInstance->pvEndPointSharedStructPtr)->sAutomationRules.pu8Data = NULL;
 #endif
             ((tsCLD_OOSC*)psClusterInstance->pvEndPointSharedStructPtr)->u16ClusterRevision = CLD_OOSC_CLUSTER_REVISION;
         }
@@ -85,4 +100,86 @@ PUBLIC  teZCL_Status eCLD_OOSCCreateOnOffSwitchConfig(
 
 }
 
+PUBLIC teZCL_Status eCLD_OOSCCommandHandler(
+                ZPS_tsAfEvent                      *pZPSevent,
+                tsZCL_EndPointDefinition           *psEndPointDefinition,
+                tsZCL_ClusterInstance              *psClusterInstance)
+{
+    tsZCL_HeaderParams sZCL_HeaderParams;
+    tsCLD_OOSCCustomDataStructure *psCommon = (tsCLD_OOSCCustomDataStructure*)psClusterInstance->pvEndPointCustomStructPtr;
+    PDUM_thAPduInstance hAPduInst = pZPSevent->uEvent.sApsDataIndEvent.hAPduInst;
+    uint16 u16Offset = u16ZCL_ReadCommandHeader(hAPduInst, &sZCL_HeaderParams);
+
+    // Only the server receives commands, and all of them are manufacturer specific
+    if(psCommon == NULL ||
+       !psClusterInstance->bIsServer ||
+       !sZCL_HeaderParams.bManufacturerSpecific ||
+       sZCL_HeaderParams.u16ManufacturerCode != ZCL_MANUFACTURER_CODE)
+    {
+        return E_ZCL_ERR_CUSTOM_COMMAND_HANDLER_NULL_OR_RETURNED_ERROR;
+    }
+
+    eZCL_SetCustomCallBackEvent(&psCommon->sCustomCallBackEvent, pZPSevent, sZCL_HeaderParams.u8TransactionSequenceNumber, psEndPointDefinition->u8EndPointNumber);
+    psCommon->sCustomCallBackEvent.eEventType = E_ZCL_CBET_CLUSTER_CUSTOM;
+    psCommon->sCustomCallBackEvent.uMessage.sClusterCustomMessage.u16ClusterId = psClusterInstance->psClusterDefinition->u16ClusterEnum;
+    psCommon->sCustomCallBackEvent.uMessage.sClusterCustomMessage.pvCustomData = (void *)&psCommon->sCallBackMessage;
+    psCommon->sCustomCallBackEvent.psClusterInstance = psClusterInstance;
+    psCommon->sCallBackMessage.u8CommandId = sZCL_HeaderParams.u8CommandIdentifier;
+
+    switch(sZCL_HeaderParams.u8CommandIdentifier)
+    {
+        case E_CLD_OOSC_CMD_COLLAPSE_TO_GROUP:
+            if(PDUM_u16APduInstanceGetPayloadSize(hAPduInst) < u16Offset + sizeof(uint16))
+                return E_ZCL_ERR_INSUFFICIENT_SPACE;
+
+            u16ZCL_APduInstanceReadNBO(hAPduInst, u16Offset, E_ZCL_UINT16, &psCommon->sCollapseToGroupPayload.u16GroupId);
+            psCommon->sCallBackMessage.uMessage.psCollapseToGroupPayload = &psCommon->sCollapseToGroupPayload;
+            break;
+
+        default:
+            return E_ZCL_ERR_CUSTOM_COMMAND_HANDLER_NULL_OR_RETURNED_ERROR;
+    }
+
+    // Let the application handle the command
+    psEndPointDefinition->pCallBackFunctions(&psCommon->sCustomCallBackEvent);
+
+    return E_ZCL_SUCCESS;
+}
+
+PUBLIC teZCL_Status eCLD_OOSCGroupCollapseOfferSend(
+                uint8                               u8SourceEndPointId,
+                uint8                               u8DestinationEndPointId,
+                tsZCL_Address                      *psDestinationAddress,
+                uint8                              *pu8TransactionSequenceNumber,
+                uint8                               u8NumTargets)
+{
+    tsZCL_ClusterInstance *psClusterInstance;
+    if(eZCL_SearchForClusterEntry(u8SourceEndPointId, GENERAL_CLUSTER_ID_ONOFF_SWITCH_CONFIGURATION, TRUE, &psClusterInstance) != E_ZCL_SUCCESS)
+        return E_ZCL_ERR_CLUSTER_NOT_FOUND;
+
+    PDUM_thAPduInstance hAPduInst = hZCL_AllocateAPduInstance();
+    if(hAPduInst == PDUM_INVALID_HANDLE)
+        return E_ZCL_ERR_ZBUFFER_FAIL;
+
+    // Manufacturer specific cluster command, server to client
+    *pu8TransactionSequenceNumber = u8GetTransactionSequenceNumber();
+    uint16 u16Pos = u16ZCL_WriteCommandHeader(hAPduInst,
+                                              eFRAME_TYPE_COMMAND_IS_SPECIFIC_TO_A_CLUSTER,
+                                              TRUE,
+                                              ZCL_MANUFACTURER_CODE,
+                                              TRUE,
+                                              TRUE,
+                                              *pu8TransactionSequenceNumber,
+                                              E_CLD_OOSC_CMD_GROUP_COLLAPSE_OFFER);
+    u16Pos += u16ZCL_APduInstanceWriteNBO(hAPduInst, u16Pos, E_ZCL_UINT8, &u8NumTargets);
+
+    // The APDU is released by the stack once transmitted
+    return eZCL_TransmitDataRequest(hAPduInst,
+                                    u16Pos,
+                                    u8SourceEndPointId,
+                                    u8DestinationEndPointId,
+                                    GENERAL_CLUSTER_ID_ONOFF_SWITCH_CONFIGURATION,
+                                    psDestinationAddress);
+}
+
 #endif
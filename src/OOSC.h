@@ -31,9 +31,23 @@ typedef enum
     E_CLD_OOSC_ATTR_ID_SWITCH_LONG_PRESS_MODE   = 0xff04,
     E_CLD_OOSC_ATTR_ID_SWITCH_OPERATION_MODE    = 0xff05,
     E_CLD_OOSC_ATTR_ID_SWITCH_INTERLOCK_MODE    = 0xff06,
+    E_CLD_OOSC_ATTR_ID_AUTOMATION_RULES         = 0xff10,   // Packed button triggered rules, see RuleTable
 } teCLD_OOSC_ClusterID;
 
 
+// Manufacturer specific commands received by the server
+typedef enum
+{
+    E_CLD_OOSC_CMD_COLLAPSE_TO_GROUP            = 0x00,     // Rebind On/Off bindings of the endpoint to a group
+} teCLD_OOSC_ServerReceivedCommandID;
+
+// Manufacturer specific commands generated by the server
+typedef enum
+{
+    E_CLD_OOSC_CMD_GROUP_COLLAPSE_OFFER         = 0x00,     // The endpoint has bindings that may be collapsed to a group
+} teCLD_OOSC_ServerGeneratedCommandID;
+
+
 // On/Off switch types (modes)
 typedef enum 
 {
@@ -88,18 +102,58 @@ typedef struct
     zenum8                  eLongPressMode;
     zenum8                  eOperationMode;
     zenum8                  eInterlockMode;
+    tsZCL_OctetString       sAutomationRules;
 
 #endif    
     zuint16                 u16ClusterRevision;
 } tsCLD_OOSC;
 
 
+// Collapse To Group command payload
+typedef struct
+{
+    zuint16                 u16GroupId;
+} tsCLD_OOSC_CollapseToGroupPayload;
+
+// Definition of OOSC Call back Event Structure
+typedef struct
+{
+    uint8                   u8CommandId;
+    union
+    {
+        tsCLD_OOSC_CollapseToGroupPayload   *psCollapseToGroupPayload;
+    } uMessage;
+} tsCLD_OOSCCallBackMessage;
+
+// Custom data structure
+typedef struct
+{
+    tsZCL_ReceiveEventAddress           sReceiveEventAddress;
+    tsZCL_CallBackEvent                 sCustomCallBackEvent;
+    tsCLD_OOSCCallBackMessage           sCallBackMessage;
+    tsCLD_OOSC_CollapseToGroupPayload   sCollapseToGroupPayload;
+} tsCLD_OOSCCustomDataStructure;
+
+
 PUBLIC teZCL_Status eCLD_OOSCCreateOnOffSwitchConfig(
                 tsZCL_ClusterInstance              *psClusterInstance,
                 bool_t                              bIsServer,
                 tsZCL_ClusterDefinition            *psClusterDefinition,
                 void                               *pvEndPointSharedStructPtr,
-                uint8              *pu8AttributeControlBits);
+                uint8              *pu8AttributeControlBits,
+                tsCLD_OOSCCustomDataStructure      *psCustomDataStructure);
+
+PUBLIC teZCL_Status eCLD_OOSCCommandHandler(
+                ZPS_tsAfEvent                      *pZPSevent,
+                tsZCL_EndPointDefinition           *psEndPointDefinition,
+                tsZCL_ClusterInstance              *psClusterInstance);
+
+PUBLIC teZCL_Status eCLD_OOSCGroupCollapseOfferSend(
+                uint8                               u8SourceEndPointId,
+                uint8                               u8DestinationEndPointId,
+                tsZCL_Address                      *psDestinationAddress,
+                uint8                              *pu8TransactionSequenceNumber,
+                uint8                               u8NumTargets);
 
 
 extern tsZCL_ClusterDefinition sCLD_OOSC;
@@ -0,0 +1,170 @@
+#include "OTAContextSaver.h"
+
+OTAContextSaver::OTAContextSaver(uint32 size)
+{
+    sectorSize = size ? size : DEFAULT_SECTOR_SIZE;
+
+    stats.contexts = 0;
+    stats.coalesced = 0;
+    stats.pdmWrites = 0;
+    for(uint8 i = 0; i < OTA_CONTEXT_FLUSH_REASON_COUNT; i++)
+        stats.flushes[i] = 0;
+    stats.upgrades = 0;
+    stats.upgradeContexts = 0;
+    stats.upgradePdmWrites = 0;
+    stats.resumes = 0;
+    stats.rewinds = 0;
+
+    elementStart = 0;
+    writeEnd = 0;
+    init(0, 0);
+}
+
+void OTAContextSaver::init(uint32 newPersistedOffset, uint8 newPersistedStatus)
+{
+    // The context in RAM is what has just been restored from the PDM
+    pending = false;
+    offset = newPersistedOffset;
+    status = newPersistedStatus;
+    persistedOffset = newPersistedOffset;
+    persistedStatus = newPersistedStatus;
+    persistTime = 0;
+}
+
+void OTAContextSaver::handleUpgradeStarted()
+{
+    stats.upgrades++;
+    stats.upgradeContexts = 0;
+    stats.upgradePdmWrites = 0;
+
+    // A new image may have a different header
+    elementStart = 0;
+    writeEnd = 0;
+}
+
+bool OTAContextSaver::handleContext(uint32 newOffset, uint8 newStatus, uint32 now)
+{
+    stats.contexts++;
+    stats.upgradeContexts++;
+
+    offset = newOffset;
+    status = newStatus;
+    pending = true;
+
+    // The OTA cluster saves the context after each block, right after the block is written to the flash. Without
+    // the element start persisted the download cannot be resumed at all.
+    bool elementStartLearned = elementStart == 0 && writeEnd != 0 && newOffset > writeEnd;
+    if(elementStartLearned)
+        elementStart = newOffset - writeEnd;
+
+    // State changes are rare and important. Progress is worth saving only when a sector is complete, as a
+    // partially written sector is downloaded again anyway.
+    bool save = newStatus != persistedStatus
+             || elementStartLearned
+             || getSectorStart(newOffset) != getSectorStart(persistedOffset);
+    if(!save)
+    {
+        stats.coalesced++;
+        return false;
+    }
+
+    persistedOffset = newOffset;
+    persistedStatus = newStatus;
+    persistTime = now;
+    pending = false;
+    return true;
+}
+
+bool OTAContextSaver::flush(OTAContextFlushReason reason, uint32 now)
+{
+    if(!pending)
+        return false;
+
+    // RAM survives the sleep, only a power loss would need the context. Do not turn every sleep between two blocks
+    // into a PDM write.
+    if(reason == OTA_CONTEXT_FLUSH_SLEEP && now - persistTime < MIN_SLEEP_FLUSH_INTERVAL)
+        return false;
+
+    stats.flushes[reason]++;
+    persistedOffset = offset;
+    persistedStatus = status;
+    persistTime = now;
+    pending = false;
+    return true;
+}
+
+void OTAContextSaver::handlePdmWrites(uint8 writes)
+{
+    stats.pdmWrites += writes;
+    stats.upgradePdmWrites += writes;
+}
+
+void OTAContextSaver::handleFlashWrite(uint32 flashOffset, uint16 len)
+{
+    writeEnd = flashOffset + len;
+}
+
+void OTAContextSaver::setElementStart(uint32 fileOffset)
+{
+    elementStart = fileOffset;
+}
+
+uint32 OTAContextSaver::getElementStart() const
+{
+    return elementStart;
+}
+
+uint32 OTAContextSaver::getFlashOffset(uint32 fileOffset) const
+{
+    return fileOffset > elementStart ? fileOffset - elementStart : 0;
+}
+
+uint32 OTAContextSaver::getSectorStart(uint32 fileOffset) const
+{
+    // File offset of the flash sector start. The first sector is downloaded from the file start, along with the
+    // OTA header.
+    uint32 flashOffset = getFlashOffset(fileOffset);
+    uint32 sectorStart = flashOffset - flashOffset % sectorSize;
+    return sectorStart ? elementStart + sectorStart : 0;
+}
+
+bool OTAContextSaver::isSectorBoundary(uint32 fileOffset) const
+{
+    return getSectorStart(fileOffset) == fileOffset;
+}
+
+uint32 OTAContextSaver::getResumeOffset(uint32 fileOffset, bool partialSectorValid)
+{
+    stats.resumes++;
+
+    // Data after the sector start cannot be trusted without the CRC check
+    if(isSectorBoundary(fileOffset) || partialSectorValid)
+        return fileOffset;
+
+    stats.rewinds++;
+    return getSectorStart(fileOffset);
+}
+
+bool OTAContextSaver::isPending() const
+{
+    return pending;
+}
+
+const OTAContextStatistics & OTAContextSaver::getStatistics() const
+{
+    return stats;
+}
+
+uint32 OTAContextSaver::updateCrc(uint32 crc, const uint8 * data, uint32 len)
+{
+    // Bitwise CRC-32 (IEEE 802.3). Slow, but no table in RAM, and it is used only on sleep, abort and resume.
+    // Start with CRC_INIT. The final inversion of the standard CRC-32 is up to the caller.
+    for(uint32 i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for(uint8 bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+
+    return crc;
+}
@@ -0,0 +1,93 @@
+#ifndef OTACONTEXTSAVER_H
+#define OTACONTEXTSAVER_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// Why the OTA context shall be persisted regardless of the download progress
+enum OTAContextFlushReason
+{
+    OTA_CONTEXT_FLUSH_SLEEP,        // Device goes to sleep, RAM may be lost
+    OTA_CONTEXT_FLUSH_ABORT,        // Download aborted cleanly
+    OTA_CONTEXT_FLUSH_REASON_COUNT
+};
+
+struct OTAContextStatistics
+{
+    uint32 contexts;            // Save requests from the OTA cluster
+    uint32 coalesced;           // Save requests kept in RAM only
+    uint32 pdmWrites;           // Total PDM writes
+    uint32 flushes[OTA_CONTEXT_FLUSH_REASON_COUNT];
+    uint32 upgrades;            // Downloads started
+    uint32 upgradeContexts;     // Save requests during the current (or the last) download
+    uint32 upgradePdmWrites;    // PDM writes during the current (or the last) download
+    uint32 resumes;             // Downloads resumed after reset
+    uint32 rewinds;             // Resumes that had to start the partially written sector over
+};
+
+// Decides when the OTA download context shall be written to the PDM.
+//
+// The OTA cluster asks to save the context after every block. Writing it each time wears the EEPROM and stalls
+// the download, so the context is kept in RAM and persisted only when:
+// - the download crosses a flash sector boundary
+// - the upgrade status changes (download started, finished, etc)
+// - the download is aborted, or the device goes to sleep (see flush()). The RAM is retained during sleep, so
+//   sleepy devices, which sleep between every two blocks, flush not more often than once a minute
+//
+// After a reset the download resumes from the persisted offset. If the offset is in the middle of a sector, the
+// data written there is verified with a CRC saved along with the context, otherwise the sector is started over.
+//
+// The context holds OTA file offsets, while the flash receives the image element only, without the OTA header in
+// front of it. Sector math is done on flash offsets (see getFlashOffset()), the element start is learned from the
+// first context saved after a flash write, and shall be persisted along with the context.
+//
+// The class does not depend on the Zigbee stack or flash access, the caller does the actual writes. All times are
+// in ms and provided by the caller.
+class OTAContextSaver
+{
+public:
+    static const uint32 DEFAULT_SECTOR_SIZE = 32 * 1024;
+    static const uint32 MIN_SLEEP_FLUSH_INTERVAL = 60000;     // ms
+    static const uint32 CRC_INIT = 0xffffffff;
+
+private:
+    uint32 sectorSize;
+
+    bool pending;               // Context in RAM is newer than the persisted one
+    uint32 offset;              // Offset of the latest context
+    uint8 status;               // Upgrade status of the latest context
+    uint32 persistedOffset;
+    uint8 persistedStatus;
+    uint32 persistTime;         // ms
+    uint32 elementStart;        // File offset of the data written to the flash start, 0 till known
+    uint32 writeEnd;            // Flash offset after the latest write
+
+    OTAContextStatistics stats;
+
+public:
+    OTAContextSaver(uint32 sectorSize = DEFAULT_SECTOR_SIZE);
+
+    void init(uint32 persistedOffset, uint8 persistedStatus);
+    void handleUpgradeStarted();
+
+    bool handleContext(uint32 offset, uint8 status, uint32 now);
+    bool flush(OTAContextFlushReason reason, uint32 now);
+    void handlePdmWrites(uint8 writes);
+    void handleFlashWrite(uint32 flashOffset, uint16 len);
+
+    void setElementStart(uint32 fileOffset);
+    uint32 getElementStart() const;
+    uint32 getFlashOffset(uint32 fileOffset) const;
+    uint32 getSectorStart(uint32 offset) const;
+    bool isSectorBoundary(uint32 offset) const;
+    uint32 getResumeOffset(uint32 persistedOffset, bool partialSectorValid);
+
+    bool isPending() const;
+    const OTAContextStatistics & getStatistics() const;
+
+    static uint32 updateCrc(uint32 crc, const uint8 * data, uint32 len);
+};
+
+#endif // OTACONTEXTSAVER_H
@@ -1,8 +1,13 @@
 #include "OTAHandlers.h"
 #include "DumpFunctions.h"
+#include "SystemClock.h"
+#include "ButtonsTask.h"
+#include "RelayTask.h"
 
 extern "C"
 {
+    #include "zcl_options.h"
+    #include "AppHardwareApi.h"
     #include "dbg.h"
     #include "string.h"
 }
@@ -17,17 +22,63 @@ void resetPersistedOTAData(tsOTA_PersistedData * persistedData)
     memset(persistedData, 0, sizeof(tsOTA_PersistedData));
 }
 
+void resetOTAPartialSector(OTAPartialSector * partialSector)
+{
+    partialSector->fileOffset = 0;
+    partialSector->crc = OTAContextSaver::CRC_INIT;
+    partialSector->elementStart = 0;
+}
+
+// The OTA cluster writes the downloaded image through these functions, which lets compressed images be decoded on
+// the way to the flash
+static OTAHandlers * flashHandlers = NULL;
+
+PRIVATE void vOTAFlashInit(uint8 u8Type, void * pvFlashTable)
+{
+    bAHI_FlashInit(E_FL_CHIP_INTERNAL, NULL);
+}
+
+PRIVATE void vOTAFlashErase(uint8 u8Sector)
+{
+    if(flashHandlers)
+        flashHandlers->handleFlashErase(u8Sector);
+}
+
+PRIVATE void vOTAFlashWrite(uint32 u32FlashByteLocation, uint16 u16Len, uint8 * pu8Data)
+{
+    if(flashHandlers)
+        flashHandlers->handleFlashWrite(u32FlashByteLocation, u16Len, pu8Data);
+}
+
+PRIVATE void vOTAFlashRead(uint32 u32FlashByteLocation, uint16 u16Len, uint8 * pu8Data)
+{
+    bAHI_FullFlashRead(u32FlashByteLocation, u16Len, pu8Data);
+}
+
 OTAHandlers::OTAHandlers()
+    : imageWriter(this, FLASH_SECTOR_SIZE, FLASH_START_SECTOR, FLASH_MAX_SECTORS)
 {
     otaEp = 0;
+    otaClient = NULL;
+    downloadInProgress = false;
+    imageSize = 0;
 }
 
-void OTAHandlers::initOTA(uint8 ep)
+void OTAHandlers::initOTA(uint8 ep, tsCLD_AS_Ota * otaClientAttributes)
 {
     otaEp = ep;
+    otaClient = otaClientAttributes;
+
+    // The SDK requests blocks of OTA_MAX_BLOCK_SIZE, and pages with the configured response spacing as a minimum.
+    // The policy raises the delay between requests above that for a slow server only.
+    transferPolicy.configure(OTA_MAX_BLOCK_SIZE,
+                             OTA_PAGE_REQ_PAGE_SIZE,
+                             OTA_PAGE_REQ_RESPONSE_SPACING,
+                             OTATransferPolicy::DEFAULT_RESPONSE_TIMEOUT);
 
     restoreOTAAttributes();
     initFlash();
+    applyRequestDelay();
 
     // Just dump current image OTA header and MAC address
     #if TRACE_OTA_DEBUG
@@ -45,6 +96,11 @@ void OTAHandlers::restoreOTAAttributes()
 
     // Restore previous values or reset to zeroes
     sPersistedData.init(resetPersistedOTAData, "OTA Data");
+    sPartialSector.init(resetOTAPartialSector, "OTA Partial Sector");
+    sImageFormat.init(OTA_IMAGE_FORMAT_PLAIN, "OTA Image Format");
+
+    // The context is persisted only now and then, so the download may need to start the last sector over
+    verifyResumeOffset();
 
     // Correct retry timer to force retry in 10 seconds
     if((&sPersistedData)->u32RequestBlockRequestTime != 0)
@@ -69,32 +125,172 @@ void OTAHandlers::initFlash()
         vREG_SysWrite(REG_SYS_FLASH_REMAP2, 0x76543210);
     }
 
-    // Initialize flash memory for storing downloaded firmwares
+    // Initialize flash memory for storing downloaded firmwares. The internal flash is accessed via custom functions,
+    // so that compressed images can be decoded before they are written.
+    flashHandlers = this;
     tsNvmDefs sNvmDefs;
-    sNvmDefs.u32SectorSize = 32*1024; // Sector Size = 32K
-    sNvmDefs.u8FlashDeviceType = E_FL_CHIP_INTERNAL;
+    sNvmDefs.u32SectorSize = FLASH_SECTOR_SIZE;
+    sNvmDefs.u8FlashDeviceType = E_FL_CHIP_CUSTOM;
+    sNvmDefs.sOtaFnTable.prInitHwCb = vOTAFlashInit;
+    sNvmDefs.sOtaFnTable.prEraseCb = vOTAFlashErase;
+    sNvmDefs.sOtaFnTable.prWriteCb = vOTAFlashWrite;
+    sNvmDefs.sOtaFnTable.prReadCb = vOTAFlashRead;
     vOTA_FlashInit(NULL, &sNvmDefs);
 
     // Fill some OTA related records for the endpoint
     uint8 au8CAPublicKey[22] = {0};
-    uint8 u8StartSector[1] = {8};
+    uint8 u8StartSector[1] = {FLASH_START_SECTOR};
     teZCL_Status status = eOTA_AllocateEndpointOTASpace(
                             otaEp,
                             u8StartSector,
                             OTA_MAX_IMAGES_PER_ENDPOINT,
-                            8,                                 // max sectors per image
+                            FLASH_MAX_SECTORS,                 // max sectors per image
                             FALSE,
                             au8CAPublicKey);
     if(status != E_ZCL_SUCCESS)
         DBG_vPrintf(TRUE, "OTAHandlers::initFlash(): Failed to allocate endpoint OTA space (can be ignored for non-OTA builds). status=%d\n", status);
 }
 
+void OTAHandlers::verifyResumeOffset()
+{
+    tsOTA_PersistedData * data = &sPersistedData;
+    uint32 fileOffset = data->sAttributes.u32FileOffset;
+    imageWriter.init(fileOffset, data->sAttributes.u8ImageUpgradeStatus, sImageFormat);
+
+    if(data->sAttributes.u8ImageUpgradeStatus != E_CLD_OTA_STATUS_DL_IN_PROGRESS)
+        return;
+
+    // Compressed downloads, and the ones without the image start persisted, are started over with the next query
+    uint32 resumeOffset = fileOffset;
+    if(!imageWriter.resume(&resumeOffset, data->sAttributes.u8ImageUpgradeStatus, sPartialSector))
+    {
+        DBG_vPrintf(TRUE, "OTAHandlers::verifyResumeOffset(): %s download interrupted at offset %d, starting over\n",
+                    sImageFormat == OTA_IMAGE_FORMAT_COMPRESSED ? "Compressed" : "Plain", fileOffset);
+        data->sAttributes.u32FileOffset = 0;
+        data->sAttributes.u8ImageUpgradeStatus = E_CLD_OTA_STATUS_NORMAL;
+        imageWriter.init(0, E_CLD_OTA_STATUS_NORMAL, sImageFormat);
+        return;
+    }
+
+    DBG_vPrintf(TRUE, "OTAHandlers::verifyResumeOffset(): Resuming download at offset %d (persisted %d)\n", resumeOffset, fileOffset);
+    data->sAttributes.u32FileOffset = resumeOffset;
+}
+
 void OTAHandlers::saveOTAContext(tsOTA_PersistedData * pData)
 {
-    DBG_vPrintf(TRUE, "Saving OTA Context... ");
+    // Keep the latest context in RAM, and write it to the PDM only when the sector is complete or the state changes
+    *(&sPersistedData) = *pData;
+    if(imageWriter.getContextSaver().handleContext(pData->sAttributes.u32FileOffset,
+                                                   pData->sAttributes.u8ImageUpgradeStatus,
+                                                   SystemClock::getInstance()->getTimeMs()))
+        persistOTAContext(false);
+}
 
-    // Store the data
-    sPersistedData = *pData;
+void OTAHandlers::flushOTAContext(OTAContextFlushReason reason)
+{
+    if(imageWriter.getContextSaver().flush(reason, SystemClock::getInstance()->getTimeMs()))
+        persistOTAContext(true);
+}
+
+void OTAHandlers::persistOTAContext(bool withPartialSector)
+{
+    tsOTA_PersistedData * data = &sPersistedData;
+    uint32 fileOffset = data->sAttributes.u32FileOffset;
+    DBG_vPrintf(TRUE, "Saving OTA Context at offset %d... ", fileOffset);
+
+    sPersistedData.save();
+    uint8 writes = 1;
+
+    OTAPartialSector partialSector = sPartialSector;
+    if(imageWriter.updatePartialSector(fileOffset, withPartialSector, &partialSector))
+    {
+        sPartialSector = partialSector;
+        writes++;
+    }
+
+    imageWriter.getContextSaver().handlePdmWrites(writes);
+}
+
+void OTAHandlers::handleSleep()
+{
+    flushOTAContext(OTA_CONTEXT_FLUSH_SLEEP);
+}
+
+void OTAHandlers::handleFlashErase(uint8 sector)
+{
+    imageWriter.handleFlashErase(sector);
+}
+
+void OTAHandlers::handleFlashWrite(uint32 addr, uint16 len, const uint8 * data)
+{
+    handleWriteResult(imageWriter.handleFlashWrite(addr - FLASH_START_SECTOR * FLASH_SECTOR_SIZE, len, data));
+}
+
+void OTAHandlers::handleWriteResult(OTAImageWriteResult result)
+{
+    const OTAImageDecoder & imageDecoder = imageWriter.getImageDecoder();
+    uint8 format = imageWriter.getImageFormat();
+
+    switch(result)
+    {
+    case OTA_IMAGE_WRITE_STARTED:
+        DBG_vPrintf(TRUE, "OTAHandlers::handleWriteResult(): %s image\n", format == OTA_IMAGE_FORMAT_COMPRESSED ? "Compressed" : "Plain");
+
+        // Remember the format, so that an interrupted compressed download is not resumed in the middle
+        if(sImageFormat != format)
+        {
+            sImageFormat = format;
+            imageWriter.getContextSaver().handlePdmWrites(1);
+        }
+        break;
+
+    case OTA_IMAGE_WRITE_PAYLOAD_GAP:
+        DBG_vPrintf(TRUE, "OTAHandlers::handleWriteResult(): Gap in the compressed payload at %d\n", imageWriter.getPayloadSize());
+        break;
+
+    case OTA_IMAGE_WRITE_DECODE_FAILED:
+        DBG_vPrintf(TRUE, "OTAHandlers::handleWriteResult(): Failed to decode the image. error=%d\n", imageDecoder.getError());
+        break;
+
+    case OTA_IMAGE_WRITE_DECODED:
+    case OTA_IMAGE_WRITE_CRC_MISMATCH:
+        DBG_vPrintf(TRUE, "OTAHandlers::handleWriteResult(): %s image of %d bytes decoded from %d bytes: %s\n",
+                    imageDecoder.isDelta() ? "Delta" : "Compressed", imageDecoder.getImageSize(), imageWriter.getPayloadSize(),
+                    result == OTA_IMAGE_WRITE_DECODED ? "valid" : "CRC mismatch");
+        break;
+
+    default:
+        break;
+    }
+}
+
+uint32 OTAHandlers::eraseFlashSector(uint8 sector)
+{
+    uint32 start = SystemClock::getInstance()->getTimeUs();
+    bAHI_FlashEraseSector(sector);
+    return SystemClock::getInstance()->getTimeUs() - start;
+}
+
+void OTAHandlers::writeFlash(uint32 offset, const uint8 * data, uint16 len)
+{
+    bAHI_FullFlashProgram(FLASH_START_SECTOR * FLASH_SECTOR_SIZE + offset, len, (uint8 *)data);
+}
+
+void OTAHandlers::readFlash(uint32 offset, uint8 * data, uint16 len)
+{
+    bAHI_FullFlashRead(FLASH_START_SECTOR * FLASH_SECTOR_SIZE + offset, len, data);
+}
+
+void OTAHandlers::readBaseImage(uint32 offset, uint8 * data, uint16 len)
+{
+    memcpy(data, (const uint8 *)(RUNNING_IMAGE_ADDRESS + offset), len);
+}
+
+void OTAHandlers::handleIdle()
+{
+    // The erase blocks the CPU, do not delay button and relay handling with it. One sector per main loop iteration,
+    // so that the stack gets its share of the CPU in between.
+    imageWriter.handleIdle(ButtonsTask::getInstance()->canSleep() && RelayTask::getInstance()->canSleep());
 }
 
 void OTAHandlers::handleOTAMessage(tsOTA_CallBackMessage * pMsg)
@@ -103,6 +299,20 @@ void OTAHandlers::handleOTAMessage(tsOTA_CallBackMessage * pMsg)
 
     switch(pMsg->eEventId)
     {
+    case E_CLD_OTA_COMMAND_QUERY_NEXT_IMAGE_RESPONSE:
+        handleQueryImageResponse(&pMsg->uMessage.sQueryImageResponsePayload);
+        break;
+    case E_CLD_OTA_COMMAND_BLOCK_RESPONSE:
+        handleBlockResponse(&pMsg->uMessage.sImageBlockResponsePayload);
+        break;
+    case E_CLD_OTA_COMMAND_UPGRADE_END_RESPONSE:
+        handleDownloadFinished();
+        break;
+    case E_CLD_OTA_INTERNAL_COMMAND_OTA_DL_ABORTED:
+        flushOTAContext(OTA_CONTEXT_FLUSH_ABORT);
+        imageWriter.abort();
+        handleDownloadFinished();
+        break;
     case E_CLD_OTA_INTERNAL_COMMAND_SAVE_CONTEXT:
         saveOTAContext(&pMsg->sPersistedData);
         break;
@@ -111,3 +321,122 @@ void OTAHandlers::handleOTAMessage(tsOTA_CallBackMessage * pMsg)
     }
 }
 
+void OTAHandlers::handleQueryImageResponse(tsOTA_QueryImageResponse * pMsg)
+{
+    if(pMsg->u8Status != OTA_STATUS_SUCCESS)
+        return;
+
+    // The download starts with the next block response
+    imageSize = pMsg->u32ImageSize;
+    downloadInProgress = false;
+    imageWriter.startUpgrade(imageSize);
+}
+
+void OTAHandlers::handleBlockResponse(tsOTA_ImageBlockResponsePayload * pMsg)
+{
+    uint32 now = SystemClock::getInstance()->getTimeMs();
+
+    switch(pMsg->u8Status)
+    {
+        case OTA_STATUS_SUCCESS:
+        {
+            uint32 offset = pMsg->uMessage.sBlockPayloadSuccess.u32FileOffset;
+
+            // The download may also be resumed after reboot, where the image size is not known
+            if(!downloadInProgress)
+            {
+                transferPolicy.start(imageSize, offset, now);
+                downloadInProgress = true;
+            }
+
+            transferPolicy.handleBlock(offset, pMsg->uMessage.sBlockPayloadSuccess.u8DataSize, now);
+            break;
+        }
+
+        case OTA_STATUS_WAIT_FOR_DATA:
+        {
+            // The server asks to wait, and may also set its MinimumBlockPeriod
+            tsOTA_WaitForData * wait = &pMsg->uMessage.sWaitForDataParams;
+            transferPolicy.handleMinBlockPeriod(wait->u16BlockRequestDelayMs);
+            transferPolicy.handleWaitForData((wait->u32RequestTime - wait->u32CurrentTime) * 1000);
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    applyRequestDelay();
+}
+
+void OTAHandlers::handleDownloadFinished()
+{
+    imageWriter.stop();
+    if(!downloadInProgress)
+        return;
+
+    downloadInProgress = false;
+    imageSize = 0;
+    dumpStatistics();
+}
+
+void OTAHandlers::applyRequestDelay()
+{
+    // The SDK waits MinBlockRequestDelay between block requests, and asks the server for the same spacing
+    // between the blocks of a page
+    if(otaClient)
+        otaClient->u16MinBlockRequestDelay = transferPolicy.getRequestDelay();
+}
+
+const OTATransferStatistics & OTAHandlers::getTransferStatistics() const
+{
+    return transferPolicy.getStatistics();
+}
+
+const OTAContextStatistics & OTAHandlers::getContextStatistics() const
+{
+    return imageWriter.getContextSaver().getStatistics();
+}
+
+const OTAImageDecoderStatistics & OTAHandlers::getDecoderStatistics() const
+{
+    return imageWriter.getImageDecoder().getStatistics();
+}
+
+const OTAStorageStatistics & OTAHandlers::getStorageStatistics() const
+{
+    return imageWriter.getStorageManager().getStatistics();
+}
+
+void OTAHandlers::dumpStatistics() const
+{
+    const OTATransferStatistics & stats = transferPolicy.getStatistics();
+    DBG_vPrintf(TRUE, "\n+++++++ OTA transfer statistics:\n");
+    DBG_vPrintf(TRUE, "    Transfers: %d\n", stats.transfers);
+    DBG_vPrintf(TRUE, "    Blocks received: %d (%d bytes), out of order: %d\n", stats.blocksReceived, stats.bytesReceived, stats.blocksOutOfOrder);
+    DBG_vPrintf(TRUE, "    Timeouts: %d, wait for data: %d\n", stats.timeouts, stats.waitForData);
+    DBG_vPrintf(TRUE, "    Request delay: %d ms (max %d ms)\n", transferPolicy.getRequestDelay(), stats.maxRequestDelay);
+
+    const OTAContextStatistics & contextStats = imageWriter.getContextSaver().getStatistics();
+    DBG_vPrintf(TRUE, "    Context saves: %d requested, %d coalesced\n", contextStats.contexts, contextStats.coalesced);
+    DBG_vPrintf(TRUE, "    PDM writes: %d this upgrade (%d save requests), %d total\n",
+                contextStats.upgradePdmWrites, contextStats.upgradeContexts, contextStats.pdmWrites);
+    DBG_vPrintf(TRUE, "    Flushes: sleep %d, abort %d\n",
+                contextStats.flushes[OTA_CONTEXT_FLUSH_SLEEP], contextStats.flushes[OTA_CONTEXT_FLUSH_ABORT]);
+    DBG_vPrintf(TRUE, "    Resumes: %d (sector restarted %d)\n", contextStats.resumes, contextStats.rewinds);
+
+    const OTAImageDecoderStatistics & decoderStats = imageWriter.getImageDecoder().getStatistics();
+    DBG_vPrintf(TRUE, "    Compressed images: %d (delta %d), completed %d, failed %d\n",
+                decoderStats.images, decoderStats.deltaImages, decoderStats.completed, decoderStats.failures);
+    DBG_vPrintf(TRUE, "    Compressed payload: %d bytes on air, %d bytes written\n", decoderStats.payloadBytes, decoderStats.imageBytes);
+    DBG_vPrintf(TRUE, "    Decoded from: literals %d, window %d, running image %d bytes\n",
+                decoderStats.literalBytes, decoderStats.windowBytes, decoderStats.baseBytes);
+
+    const OTAStorageStatistics & storageStats = imageWriter.getStorageManager().getStatistics();
+    DBG_vPrintf(TRUE, "    Sector erases: %d in background, %d on demand, %d requests skipped, %d deferred\n",
+                storageStats.backgroundErases, storageStats.onDemandErases, storageStats.erasesSkipped, storageStats.deferred);
+    DBG_vPrintf(TRUE, "    Erase stall: %d ms this upgrade (%d ms removed), %d ms total (%d ms removed)\n",
+                storageStats.upgradeStallTime / 1000, storageStats.upgradeStallTimeRemoved / 1000,
+                storageStats.stallTime / 1000, storageStats.stallTimeRemoved / 1000);
+}
+
@@ -3,6 +3,9 @@
 
 #include "PersistedValue.h"
 #include "PdmIds.h"
+#include "OTATransferPolicy.h"
+#include "OTAImageWriter.h"
+#include "IOTAFlash.h"
 
 extern "C"
 {
@@ -16,21 +19,60 @@ extern "C"
     #endif //OTA_H_FIXED
 }
 
-class OTAHandlers
+class OTAHandlers : public IOTAFlash
 {
+    static const uint32 FLASH_SECTOR_SIZE = 32 * 1024;
+    static const uint8 FLASH_START_SECTOR = 8;
+    static const uint8 FLASH_MAX_SECTORS = 8;
+    static const uint32 RUNNING_IMAGE_ADDRESS = 0x00080000;    // Flash is memory mapped, the running image first
+
     uint8 otaEp;
+    tsCLD_AS_Ota * otaClient;
     PersistedValue<tsOTA_PersistedData, PDM_ID_OTA_DATA> sPersistedData;
+    PersistedValue<OTAPartialSector, PDM_ID_OTA_PARTIAL_SECTOR> sPartialSector;
+    PersistedValue<uint8, PDM_ID_OTA_IMAGE_FORMAT> sImageFormat;
+    OTAImageWriter imageWriter;
+
+    OTATransferPolicy transferPolicy;
+    bool downloadInProgress;
+    uint32 imageSize;
 
 public:
     OTAHandlers();
 
-    void initOTA(uint8 ep);
+    void initOTA(uint8 ep, tsCLD_AS_Ota * otaClientAttributes);
     void handleOTAMessage(tsOTA_CallBackMessage * psCallBackMessage);
+    void handleSleep();
+    void handleIdle();
+
+    void handleFlashErase(uint8 sector);
+    void handleFlashWrite(uint32 addr, uint16 len, const uint8 * data);
+
+    const OTATransferStatistics & getTransferStatistics() const;
+    const OTAContextStatistics & getContextStatistics() const;
+    const OTAImageDecoderStatistics & getDecoderStatistics() const;
+    const OTAStorageStatistics & getStorageStatistics() const;
+    void dumpStatistics() const;
+
+protected:
+    virtual uint32 eraseFlashSector(uint8 sector);
+    virtual void writeFlash(uint32 offset, const uint8 * data, uint16 len);
+    virtual void readFlash(uint32 offset, uint8 * data, uint16 len);
+    virtual void readBaseImage(uint32 offset, uint8 * data, uint16 len);
 
 private:
     void restoreOTAAttributes();
     void initFlash();
     void saveOTAContext(tsOTA_PersistedData * pData);
+    void flushOTAContext(OTAContextFlushReason reason);
+    void persistOTAContext(bool withPartialSector);
+    void verifyResumeOffset();
+    void handleWriteResult(OTAImageWriteResult result);
+
+    void handleQueryImageResponse(tsOTA_QueryImageResponse * pMsg);
+    void handleBlockResponse(tsOTA_ImageBlockResponsePayload * pMsg);
+    void handleDownloadFinished();
+    void applyRequestDelay();
 };
 
 #endif // OTAHANDLERS_H
@@ -0,0 +1,348 @@
+#include "OTAImageDecoder.h"
+#include "OTAContextSaver.h"
+
+static const uint8 MAGIC[OTAImageDecoder::MAGIC_SIZE] = {'H', 'Z', 'C', '1'};
+
+static uint16 getLE16(const uint8 * data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static uint32 getLE32(const uint8 * data)
+{
+    return data[0] | (data[1] << 8) | ((uint32)data[2] << 16) | ((uint32)data[3] << 24);
+}
+
+OTAImageDecoder::OTAImageDecoder()
+{
+    storage = NULL;
+
+    stats.images = 0;
+    stats.deltaImages = 0;
+    stats.completed = 0;
+    stats.failures = 0;
+    stats.payloadBytes = 0;
+    stats.imageBytes = 0;
+    stats.literalBytes = 0;
+    stats.windowBytes = 0;
+    stats.baseBytes = 0;
+
+    reset();
+}
+
+bool OTAImageDecoder::isCompressedImage(const uint8 * data, uint16 len)
+{
+    if(len < sizeof(MAGIC))
+        return false;
+
+    for(uint8 i = 0; i < sizeof(MAGIC); i++)
+        if(data[i] != MAGIC[i])
+            return false;
+
+    return true;
+}
+
+void OTAImageDecoder::reset()
+{
+    state = STATE_IDLE;
+    error = OTA_DECODER_OK;
+    headerLen = 0;
+    flags = 0;
+    windowSize = 0;
+    imageSize = 0;
+    imageCrc = 0;
+    baseSize = 0;
+    baseCrc = 0;
+    opcode = 0;
+    arg1 = 0;
+    arg2 = 0;
+    varint = 0;
+    varintShift = 0;
+    baseCursor = 0;
+    decoded = 0;
+    written = 0;
+    crc = OTAContextSaver::CRC_INIT;
+}
+
+void OTAImageDecoder::start(IOTAImageStorage * imageStorage)
+{
+    reset();
+    storage = imageStorage;
+    state = STATE_HEADER;
+    stats.images++;
+}
+
+bool OTAImageDecoder::handleData(const uint8 * data, uint16 len)
+{
+    stats.payloadBytes += len;
+
+    for(uint16 i = 0; i < len; i++)
+    {
+        uint8 b = data[i];
+
+        switch(state)
+        {
+            case STATE_HEADER:
+                header[headerLen++] = b;
+                if(headerLen == HEADER_SIZE)
+                    handleHeader();
+                break;
+
+            case STATE_OPCODE:
+                opcode = b;
+                if(opcode > OP_BASE)
+                {
+                    fail(OTA_DECODER_BAD_COMMAND);
+                    break;
+                }
+                state = STATE_ARG1;
+                break;
+
+            case STATE_ARG1:
+                if(!readVarint(b))
+                    break;
+
+                arg1 = varint;
+                varint = 0;
+                if(opcode == OP_LITERAL)
+                {
+                    if(arg1 == 0 || arg1 > imageSize - decoded)
+                        fail(arg1 == 0 ? OTA_DECODER_BAD_COMMAND : OTA_DECODER_OVERFLOW);
+                    else
+                        state = STATE_LITERAL;
+                }
+                else
+                    state = STATE_ARG2;
+                break;
+
+            case STATE_ARG2:
+                if(!readVarint(b))
+                    break;
+
+                arg2 = varint;
+                executeCommand();
+                break;
+
+            case STATE_LITERAL:
+                putByte(b);
+                stats.literalBytes++;
+                arg1--;
+                if(arg1 == 0)
+                    state = STATE_OPCODE;
+                break;
+
+            default:
+                // Trailing padding after the image is ignored
+                break;
+        }
+
+        // The image is complete as soon as the last byte is decoded
+        if((state == STATE_OPCODE || state == STATE_LITERAL) && decoded == imageSize)
+        {
+            flushOutput(true);
+            if(~crc != imageCrc)
+                fail(OTA_DECODER_CRC_MISMATCH);
+            else
+            {
+                state = STATE_DONE;
+                stats.completed++;
+            }
+        }
+
+        if(state == STATE_ERROR)
+            return false;
+    }
+
+    return state != STATE_ERROR;
+}
+
+void OTAImageDecoder::handleHeader()
+{
+    if(!isCompressedImage(header, HEADER_SIZE) || header[4] != VERSION)
+    {
+        fail(OTA_DECODER_BAD_HEADER);
+        return;
+    }
+
+    flags = header[5];
+    windowSize = getLE16(header + 6);
+    imageSize = getLE32(header + 8);
+    imageCrc = getLE32(header + 12);
+    baseSize = getLE32(header + 16);
+    baseCrc = getLE32(header + 20);
+
+    if(windowSize > MAX_WINDOW_SIZE)
+    {
+        fail(OTA_DECODER_BAD_WINDOW);
+        return;
+    }
+
+    if(flags & FLAG_DELTA)
+    {
+        stats.deltaImages++;
+
+        // Check the running firmware right away, rather than downloading the whole image to find out it is useless
+        uint8 buf[WRITE_CHUNK_SIZE];
+        uint32 baseImageCrc = OTAContextSaver::CRC_INIT;
+        for(uint32 offset = 0; offset < baseSize; offset += sizeof(buf))
+        {
+            uint16 len = baseSize - offset < sizeof(buf) ? baseSize - offset : sizeof(buf);
+            storage->readBaseImage(offset, buf, len);
+            baseImageCrc = OTAContextSaver::updateCrc(baseImageCrc, buf, len);
+        }
+
+        if(~baseImageCrc != baseCrc)
+        {
+            fail(OTA_DECODER_BASE_MISMATCH);
+            return;
+        }
+    }
+    else
+        baseSize = 0;
+
+    state = STATE_OPCODE;
+}
+
+bool OTAImageDecoder::readVarint(uint8 b)
+{
+    if(varintShift > 28)
+    {
+        fail(OTA_DECODER_BAD_COMMAND);
+        return false;
+    }
+
+    varint |= (uint32)(b & 0x7f) << varintShift;
+    varintShift += 7;
+    if(b & 0x80)
+        return false;
+
+    // Value is complete, get ready for the next one
+    varintShift = 0;
+    return true;
+}
+
+void OTAImageDecoder::executeCommand()
+{
+    // Both arguments have been read, next byte is an opcode
+    uint32 len = arg2;
+    varint = 0;
+    state = STATE_OPCODE;
+
+    if(len == 0)
+    {
+        fail(OTA_DECODER_BAD_COMMAND);
+        return;
+    }
+
+    if(len > imageSize - decoded)
+    {
+        fail(OTA_DECODER_OVERFLOW);
+        return;
+    }
+
+    if(opcode == OP_COPY)
+    {
+        uint32 distance = arg1;
+        if(distance == 0 || distance > windowSize || distance > decoded)
+        {
+            fail(OTA_DECODER_BAD_REFERENCE);
+            return;
+        }
+
+        // Byte by byte, as the source may overlap with the data being produced
+        for(uint32 i = 0; i < len; i++)
+            putByte(ring[(decoded - distance) % RING_SIZE]);
+        stats.windowBytes += len;
+    }
+    else
+    {
+        int32 delta = (int32)(arg1 >> 1) ^ -(int32)(arg1 & 1);
+        uint32 offset = baseCursor + delta;
+        if(offset > baseSize || len > baseSize - offset)
+        {
+            fail(OTA_DECODER_BAD_REFERENCE);
+            return;
+        }
+
+        uint8 buf[16];
+        for(uint32 pos = 0; pos < len; pos += sizeof(buf))
+        {
+            uint16 chunk = len - pos < sizeof(buf) ? len - pos : sizeof(buf);
+            storage->readBaseImage(offset + pos, buf, chunk);
+            for(uint16 i = 0; i < chunk; i++)
+                putByte(buf[i]);
+        }
+
+        baseCursor = offset + len;
+        stats.baseBytes += len;
+    }
+}
+
+void OTAImageDecoder::putByte(uint8 b)
+{
+    ring[decoded % RING_SIZE] = b;
+    crc = OTAContextSaver::updateCrc(crc, &b, 1);
+    decoded++;
+
+    if(decoded - written >= WRITE_CHUNK_SIZE)
+        flushOutput(false);
+}
+
+void OTAImageDecoder::flushOutput(bool all)
+{
+    // RING_SIZE is a multiple of the chunk size, so a chunk never wraps around the ring end
+    while(decoded - written >= WRITE_CHUNK_SIZE || (all && decoded > written))
+    {
+        uint16 len = decoded - written < WRITE_CHUNK_SIZE ? decoded - written : WRITE_CHUNK_SIZE;
+        storage->writeImage(written, ring + written % RING_SIZE, len);
+        written += len;
+        stats.imageBytes += len;
+    }
+}
+
+void OTAImageDecoder::fail(OTAImageDecoderError err)
+{
+    error = err;
+    state = STATE_ERROR;
+    stats.failures++;
+}
+
+bool OTAImageDecoder::isActive() const
+{
+    return state != STATE_IDLE && state != STATE_DONE && state != STATE_ERROR;
+}
+
+bool OTAImageDecoder::isComplete() const
+{
+    return state == STATE_DONE;
+}
+
+bool OTAImageDecoder::isDelta() const
+{
+    return (flags & FLAG_DELTA) != 0;
+}
+
+OTAImageDecoderError OTAImageDecoder::getError() const
+{
+    return error;
+}
+
+uint32 OTAImageDecoder::getImageSize() const
+{
+    return imageSize;
+}
+
+uint32 OTAImageDecoder::getImageCrc() const
+{
+    return imageCrc;
+}
+
+uint32 OTAImageDecoder::getDecodedSize() const
+{
+    return decoded;
+}
+
+const OTAImageDecoderStatistics & OTAImageDecoder::getStatistics() const
+{
+    return stats;
+}
@@ -0,0 +1,135 @@
+#ifndef OTAIMAGEDECODER_H
+#define OTAIMAGEDECODER_H
+
+#include "IOTAImageStorage.h"
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+enum OTAImageDecoderError
+{
+    OTA_DECODER_OK = 0,
+    OTA_DECODER_BAD_HEADER,         // Unknown magic or version
+    OTA_DECODER_BAD_WINDOW,         // Encoded with a larger window than the decoder has
+    OTA_DECODER_BASE_MISMATCH,      // Delta image encoded against a different firmware than the running one
+    OTA_DECODER_BAD_COMMAND,
+    OTA_DECODER_BAD_REFERENCE,      // Copy from outside of the window, or outside of the base image
+    OTA_DECODER_OVERFLOW,           // More data than the image size in the header
+    OTA_DECODER_CRC_MISMATCH,       // Reconstructed image does not match the checksum in the header
+};
+
+struct OTAImageDecoderStatistics
+{
+    uint32 images;              // Compressed images started
+    uint32 deltaImages;         // Of them encoded against the running firmware
+    uint32 completed;           // Decoded and verified
+    uint32 failures;
+    uint32 payloadBytes;        // Received over the air
+    uint32 imageBytes;          // Written to the flash
+    uint32 literalBytes;
+    uint32 windowBytes;         // Copied from the recently decoded data
+    uint32 baseBytes;           // Copied from the running firmware
+};
+
+// Streaming decoder of compressed and delta OTA images (see scripts/OTACompress/ota_compress.py)
+//
+// The payload starts with a header:
+//   magic "HZC1", version (1 byte), flags (1 byte), window size (2 bytes), image size, image CRC, base image size,
+//   base image CRC (4 bytes each). Numbers are little endian, CRC is the standard CRC-32.
+// followed by commands, each an opcode byte with LEB128 encoded arguments:
+//   LITERAL len, <len bytes>            - copy bytes from the payload
+//   COPY distance len                   - copy from the data decoded <distance> bytes ago
+//   BASE offset len                     - copy from the running firmware. The offset is relative to the end of the
+//                                         previous BASE command, zigzag encoded
+//
+// Data can be fed in chunks of any size. The recent output is kept in a ring buffer, which is both the COPY window
+// and the write buffer, so the RAM usage does not depend on the image size. The image is written in chunks of
+// WRITE_CHUNK_SIZE bytes, aligned to the image start.
+class OTAImageDecoder
+{
+public:
+    static const uint8 HEADER_SIZE = 24;
+    static const uint8 MAGIC_SIZE = 4;
+    static const uint8 VERSION = 1;
+    static const uint8 FLAG_DELTA = 0x01;
+    static const uint16 RING_SIZE = 1024;
+    static const uint8 WRITE_CHUNK_SIZE = 64;
+    static const uint16 MAX_WINDOW_SIZE = RING_SIZE - WRITE_CHUNK_SIZE;
+
+    enum Opcode
+    {
+        OP_LITERAL = 0,
+        OP_COPY = 1,
+        OP_BASE = 2
+    };
+
+private:
+    enum State
+    {
+        STATE_IDLE,
+        STATE_HEADER,
+        STATE_OPCODE,
+        STATE_ARG1,
+        STATE_ARG2,
+        STATE_LITERAL,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    IOTAImageStorage * storage;
+    State state;
+    OTAImageDecoderError error;
+
+    uint8 header[HEADER_SIZE];
+    uint8 headerLen;
+    uint8 flags;
+    uint16 windowSize;
+    uint32 imageSize;
+    uint32 imageCrc;
+    uint32 baseSize;
+    uint32 baseCrc;
+
+    uint8 opcode;
+    uint32 arg1;
+    uint32 arg2;
+    uint32 varint;
+    uint8 varintShift;
+    uint32 baseCursor;              // End of the previous BASE copy
+
+    uint8 ring[RING_SIZE];
+    uint32 decoded;                 // Bytes decoded so far
+    uint32 written;                 // Bytes passed to the storage so far
+    uint32 crc;
+
+    OTAImageDecoderStatistics stats;
+
+public:
+    OTAImageDecoder();
+
+    static bool isCompressedImage(const uint8 * data, uint16 len);
+
+    void start(IOTAImageStorage * storage);
+    bool handleData(const uint8 * data, uint16 len);
+    void reset();
+
+    bool isActive() const;
+    bool isComplete() const;
+    bool isDelta() const;
+    OTAImageDecoderError getError() const;
+    uint32 getImageSize() const;
+    uint32 getImageCrc() const;
+    uint32 getDecodedSize() const;
+    const OTAImageDecoderStatistics & getStatistics() const;
+
+private:
+    void handleHeader();
+    bool readVarint(uint8 b);
+    void executeCommand();
+    void putByte(uint8 b);
+    void flushOutput(bool all);
+    void fail(OTAImageDecoderError err);
+};
+
+#endif // OTAIMAGEDECODER_H
@@ -0,0 +1,306 @@
+#include "OTAImageWriter.h"
+
+extern "C"
+{
+    #include "string.h"
+}
+
+OTAImageWriter::OTAImageWriter(IOTAFlash * flashAccess, uint32 size, uint8 start, uint8 sectors)
+    : contextSaver(size)
+    , storageManager(size, start, sectors)
+{
+    flash = flashAccess;
+    sectorSize = size;
+    startSector = start;
+    maxSectors = sectors;
+
+    imageFormat = OTA_IMAGE_FORMAT_PLAIN;
+    imageSize = 0;
+    payloadOffset = 0;
+    imageStartLen = OTAImageDecoder::MAGIC_SIZE;    // A resumed download keeps the persisted format
+}
+
+void OTAImageWriter::init(uint32 persistedOffset, uint8 persistedStatus, uint8 persistedFormat)
+{
+    contextSaver.init(persistedOffset, persistedStatus);
+    imageFormat = persistedFormat;
+}
+
+bool OTAImageWriter::resume(uint32 * fileOffset, uint8 status, const OTAPartialSector & partialSector)
+{
+    // The decoder state is in RAM only, so a compressed download cannot be resumed
+    if(imageFormat == OTA_IMAGE_FORMAT_COMPRESSED)
+        return false;
+
+    // Offsets of the flash are shifted by the OTA header. Without knowing its size nothing can be verified.
+    if(partialSector.elementStart == 0 || partialSector.elementStart > *fileOffset)
+        return false;
+    contextSaver.setElementStart(partialSector.elementStart);
+
+    // Data written after the sector start is trusted only if it matches the CRC saved with the context
+    bool partialSectorValid = !contextSaver.isSectorBoundary(*fileOffset)
+                           && partialSector.fileOffset == *fileOffset
+                           && partialSector.crc == calcPartialSectorCrc(*fileOffset);
+
+    uint32 resumeOffset = contextSaver.getResumeOffset(*fileOffset, partialSectorValid);
+    if(resumeOffset == *fileOffset && partialSectorValid)
+        return true;
+
+    // The sector may contain blocks downloaded after the context was persisted. It is downloaded again from its
+    // start, so it has to be erased first. Blocks may have reached the next sectors as well, those are erased
+    // before the download gets there (see OTAStorageManager).
+    *fileOffset = resumeOffset;
+    contextSaver.init(resumeOffset, status);
+    flash->eraseFlashSector(startSector + contextSaver.getFlashOffset(resumeOffset) / sectorSize);
+    return true;
+}
+
+bool OTAImageWriter::updatePartialSector(uint32 fileOffset, bool withCrc, OTAPartialSector * partialSector)
+{
+    // The element start is needed to map the persisted offset to the flash after the reset
+    bool changed = partialSector->elementStart != contextSaver.getElementStart();
+    partialSector->elementStart = contextSaver.getElementStart();
+
+    // Let the partially written sector survive the reset as well
+    if(withCrc && !contextSaver.isSectorBoundary(fileOffset))
+    {
+        partialSector->fileOffset = fileOffset;
+        partialSector->crc = calcPartialSectorCrc(fileOffset);
+        changed = true;
+    }
+
+    return changed;
+}
+
+void OTAImageWriter::startUpgrade(uint32 size)
+{
+    imageSize = size;
+    contextSaver.handleUpgradeStarted();
+    imageDecoder.reset();
+}
+
+void OTAImageWriter::abort()
+{
+    imageDecoder.reset();
+}
+
+void OTAImageWriter::stop()
+{
+    storageManager.stop();
+    imageSize = 0;
+}
+
+void OTAImageWriter::handleFlashErase(uint8 sector)
+{
+    // The compressed payload is shorter than the image, the decoder erases sectors as its output reaches them
+    if(imageFormat == OTA_IMAGE_FORMAT_COMPRESSED && (imageDecoder.isActive() || imageDecoder.isComplete()))
+        return;
+
+    eraseSector(sector);
+}
+
+OTAImageWriteResult OTAImageWriter::handleFlashWrite(uint32 offset, uint16 len, const uint8 * data)
+{
+    OTAImageWriteResult result = OTA_IMAGE_WRITE_OK;
+    contextSaver.handleFlashWrite(offset, len);
+
+    // Every download writes the image start first
+    if(offset == 0)
+        imageStartLen = 0;
+
+    // The format is known once the magic is complete. The OTA file header may leave only a couple of bytes of the
+    // image in the first block, those are written as is in the meantime.
+    if(imageStartLen < OTAImageDecoder::MAGIC_SIZE && offset == imageStartLen)
+    {
+        uint16 chunk = OTAImageDecoder::MAGIC_SIZE - imageStartLen;
+        if(chunk > len)
+            chunk = len;
+        memcpy(imageStart + imageStartLen, data, chunk);
+        imageStartLen += chunk;
+
+        if(imageStartLen < OTAImageDecoder::MAGIC_SIZE)
+        {
+            flash->writeFlash(offset, data, len);
+            return OTA_IMAGE_WRITE_OK;
+        }
+
+        startImage(imageStart, imageStartLen);
+        result = OTA_IMAGE_WRITE_STARTED;
+        if(imageFormat == OTA_IMAGE_FORMAT_COMPRESSED)
+        {
+            OTAImageWriteResult magicResult = handleCompressedData(0, imageStartLen, imageStart);
+            if(magicResult != OTA_IMAGE_WRITE_OK)
+                return magicResult;
+        }
+    }
+
+    if(imageFormat == OTA_IMAGE_FORMAT_COMPRESSED)
+    {
+        OTAImageWriteResult decodeResult = handleCompressedData(offset, len, data);
+        return decodeResult != OTA_IMAGE_WRITE_OK ? decodeResult : result;
+    }
+
+    // Download resumed after reset
+    if(!storageManager.isActive())
+        storageManager.start(offset, imageSize);
+
+    flash->writeFlash(offset, data, len);
+    storageManager.handleWrite(offset, len);
+    return result;
+}
+
+bool OTAImageWriter::handleIdle(bool canErase)
+{
+    uint8 sector = storageManager.getSectorToErase();
+    if(sector == OTAStorageManager::NO_SECTOR)
+        return false;
+
+    if(!canErase)
+    {
+        storageManager.handleDeferred();
+        return false;
+    }
+
+    storageManager.handleBackgroundErase(sector, flash->eraseFlashSector(sector));
+    return true;
+}
+
+void OTAImageWriter::startImage(const uint8 * data, uint16 len)
+{
+    imageFormat = OTAImageDecoder::isCompressedImage(data, len) ? OTA_IMAGE_FORMAT_COMPRESSED : OTA_IMAGE_FORMAT_PLAIN;
+
+    payloadOffset = 0;
+    if(imageFormat == OTA_IMAGE_FORMAT_COMPRESSED)
+        imageDecoder.start(this);
+    else
+        imageDecoder.reset();
+
+    // Size of a compressed image is known after its header is decoded
+    storageManager.start(0, imageFormat == OTA_IMAGE_FORMAT_PLAIN ? imageSize : 0);
+}
+
+OTAImageWriteResult OTAImageWriter::handleCompressedData(uint32 offset, uint16 len, const uint8 * data)
+{
+    // Nothing to do after the image is complete or broken. Data the decoder has already seen is skipped.
+    if(!imageDecoder.isActive() || offset + len <= payloadOffset)
+        return OTA_IMAGE_WRITE_OK;
+
+    if(offset > payloadOffset)
+    {
+        imageDecoder.reset();
+        invalidateImage();
+        return OTA_IMAGE_WRITE_PAYLOAD_GAP;
+    }
+
+    uint16 skip = payloadOffset - offset;
+    payloadOffset = offset + len;
+    if(!imageDecoder.handleData(data + skip, len - skip))
+    {
+        invalidateImage();
+        return OTA_IMAGE_WRITE_DECODE_FAILED;
+    }
+
+    storageManager.setImageSize(imageDecoder.getImageSize());
+    if(imageDecoder.isComplete())
+        return verifyDecodedImage();
+
+    return OTA_IMAGE_WRITE_OK;
+}
+
+OTAImageWriteResult OTAImageWriter::verifyDecodedImage()
+{
+    // The decoder checked the data it produced, now check what actually got to the flash
+    uint32 size = imageDecoder.getImageSize();
+    bool valid = size <= maxSectors * sectorSize
+              && ~calcFlashCrc(0, size) == imageDecoder.getImageCrc();
+    if(valid)
+        return OTA_IMAGE_WRITE_DECODED;
+
+    invalidateImage();
+    return OTA_IMAGE_WRITE_CRC_MISMATCH;
+}
+
+void OTAImageWriter::invalidateImage()
+{
+    // Without a valid image header in the first sector the new image is never switched to
+    flash->eraseFlashSector(startSector);
+}
+
+void OTAImageWriter::writeImage(uint32 offset, const uint8 * data, uint16 len)
+{
+    if(offset + len > maxSectors * sectorSize)
+        return;
+
+    // Writes go in order, each sector is erased when the image reaches it
+    if(offset % sectorSize == 0)
+        eraseSector(startSector + offset / sectorSize);
+
+    flash->writeFlash(offset, data, len);
+    storageManager.handleWrite(offset, len);
+}
+
+void OTAImageWriter::readBaseImage(uint32 offset, uint8 * data, uint16 len)
+{
+    flash->readBaseImage(offset, data, len);
+}
+
+void OTAImageWriter::eraseSector(uint8 sector)
+{
+    // Sectors erased in the background are ready for writing already
+    if(!storageManager.needsErase(sector))
+        return;
+
+    storageManager.handleOnDemandErase(sector, flash->eraseFlashSector(sector));
+}
+
+uint32 OTAImageWriter::calcFlashCrc(uint32 startOffset, uint32 endOffset)
+{
+    uint32 crc = OTAContextSaver::CRC_INIT;
+    uint8 buf[64];
+
+    for(uint32 offset = startOffset; offset < endOffset; )
+    {
+        uint16 len = endOffset - offset < sizeof(buf) ? endOffset - offset : sizeof(buf);
+        flash->readFlash(offset, buf, len);
+        crc = OTAContextSaver::updateCrc(crc, buf, len);
+        offset += len;
+    }
+
+    return crc;
+}
+
+uint32 OTAImageWriter::calcPartialSectorCrc(uint32 fileOffset)
+{
+    uint32 flashOffset = contextSaver.getFlashOffset(fileOffset);
+    return calcFlashCrc(flashOffset - flashOffset % sectorSize, flashOffset);
+}
+
+uint8 OTAImageWriter::getImageFormat() const
+{
+    return imageFormat;
+}
+
+uint32 OTAImageWriter::getPayloadSize() const
+{
+    return payloadOffset;
+}
+
+OTAContextSaver & OTAImageWriter::getContextSaver()
+{
+    return contextSaver;
+}
+
+const OTAContextSaver & OTAImageWriter::getContextSaver() const
+{
+    return contextSaver;
+}
+
+const OTAImageDecoder & OTAImageWriter::getImageDecoder() const
+{
+    return imageDecoder;
+}
+
+const OTAStorageManager & OTAImageWriter::getStorageManager() const
+{
+    return storageManager;
+}
@@ -0,0 +1,104 @@
+#ifndef OTAIMAGEWRITER_H
+#define OTAIMAGEWRITER_H
+
+#include "OTAContextSaver.h"
+#include "OTAImageDecoder.h"
+#include "OTAStorageManager.h"
+#include "IOTAImageStorage.h"
+#include "IOTAFlash.h"
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// CRC of the partially written sector, saved along with the OTA context when it is persisted mid-sector
+struct OTAPartialSector
+{
+    uint32 fileOffset;          // Offset of the context this CRC belongs to
+    uint32 crc;                 // Flash data from the sector start till the file offset
+    uint32 elementStart;        // File offset of the data written to the flash start, 0 if not known
+};
+
+// Format of the image being downloaded
+enum OTAImageFormat
+{
+    OTA_IMAGE_FORMAT_PLAIN = 0,         // Written to the flash as is
+    OTA_IMAGE_FORMAT_COMPRESSED = 1,    // Compressed or delta image, written through the OTAImageDecoder
+};
+
+// What happened to the image with a flash write
+enum OTAImageWriteResult
+{
+    OTA_IMAGE_WRITE_OK,
+    OTA_IMAGE_WRITE_STARTED,            // Format of a new image is detected, see getImageFormat()
+    OTA_IMAGE_WRITE_PAYLOAD_GAP,        // Compressed payload is not contiguous, the image is invalidated
+    OTA_IMAGE_WRITE_DECODE_FAILED,      // Compressed payload is broken, the image is invalidated
+    OTA_IMAGE_WRITE_DECODED,            // Decoded image is complete and its flash copy matches the CRC
+    OTA_IMAGE_WRITE_CRC_MISMATCH,       // Decoded image is complete, but its flash copy is broken and invalidated
+};
+
+// Writes the downloaded OTA image to the flash.
+//
+// The OTA cluster passes the upgrade image through the flash callbacks. Plain images are written as is, compressed
+// and delta images are decoded on the way (see OTAImageDecoder), sectors are erased ahead of the download while idle
+// (see OTAStorageManager). The download context is saved by OTAContextSaver, and after a reset the partially
+// written sector is verified against the CRC saved with it.
+//
+// The class does not depend on the Zigbee stack, the PDM or the flash driver: the caller persists the context, the
+// image format and the partial sector record, and provides the flash access. The same code runs in the host OTA
+// simulation (test/host/ota_client_sim.cpp).
+class OTAImageWriter : public IOTAImageStorage
+{
+    IOTAFlash * flash;
+    uint32 sectorSize;
+    uint8 startSector;
+    uint8 maxSectors;
+
+    OTAContextSaver contextSaver;
+    OTAImageDecoder imageDecoder;
+    OTAStorageManager storageManager;
+
+    uint8 imageFormat;
+    uint32 imageSize;                   // Size of the plain image, 0 if not known
+    uint32 payloadOffset;               // Next expected offset of the compressed payload
+    uint8 imageStart[OTAImageDecoder::MAGIC_SIZE];     // First bytes of the image, till its format is known
+    uint8 imageStartLen;
+
+public:
+    OTAImageWriter(IOTAFlash * flash, uint32 sectorSize, uint8 startSector, uint8 maxSectors);
+
+    void init(uint32 persistedOffset, uint8 persistedStatus, uint8 persistedFormat);
+    bool resume(uint32 * fileOffset, uint8 status, const OTAPartialSector & partialSector);
+    bool updatePartialSector(uint32 fileOffset, bool withCrc, OTAPartialSector * partialSector);
+
+    void startUpgrade(uint32 imageSize);
+    void abort();
+    void stop();
+
+    void handleFlashErase(uint8 sector);
+    OTAImageWriteResult handleFlashWrite(uint32 offset, uint16 len, const uint8 * data);
+    bool handleIdle(bool canErase);
+
+    uint8 getImageFormat() const;
+    uint32 getPayloadSize() const;
+    uint32 calcFlashCrc(uint32 startOffset, uint32 endOffset);
+
+    OTAContextSaver & getContextSaver();
+    const OTAContextSaver & getContextSaver() const;
+    const OTAImageDecoder & getImageDecoder() const;
+    const OTAStorageManager & getStorageManager() const;
+
+    virtual void writeImage(uint32 offset, const uint8 * data, uint16 len);
+    virtual void readBaseImage(uint32 offset, uint8 * data, uint16 len);
+
+private:
+    void startImage(const uint8 * data, uint16 len);
+    OTAImageWriteResult handleCompressedData(uint32 offset, uint16 len, const uint8 * data);
+    OTAImageWriteResult verifyDecodedImage();
+    void invalidateImage();
+    void eraseSector(uint8 sector);
+    uint32 calcPartialSectorCrc(uint32 fileOffset);
+};
+
+#endif // OTAIMAGEWRITER_H
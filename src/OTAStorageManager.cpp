@@ -0,0 +1,143 @@
+#include "OTAStorageManager.h"
+
+OTAStorageManager::OTAStorageManager(uint32 size, uint8 start, uint8 count, uint8 ahead)
+{
+    sectorSize = size;
+    startSector = start;
+    numSectors = count < MAX_SECTORS ? count : MAX_SECTORS;
+    eraseAhead = ahead;
+
+    active = false;
+    imageSize = 0;
+    writeCursor = 0;
+    erasedMask = 0;
+    for(uint8 i = 0; i < MAX_SECTORS; i++)
+        eraseDuration[i] = 0;
+
+    stats.upgrades = 0;
+    stats.backgroundErases = 0;
+    stats.onDemandErases = 0;
+    stats.erasesSkipped = 0;
+    stats.deferred = 0;
+    stats.stallTime = 0;
+    stats.stallTimeRemoved = 0;
+    stats.upgradeStallTime = 0;
+    stats.upgradeStallTimeRemoved = 0;
+}
+
+void OTAStorageManager::start(uint32 offset, uint32 size)
+{
+    // Flash state is unknown, sectors are erased again even if they were prepared for an earlier download
+    active = true;
+    imageSize = size;
+    writeCursor = offset;
+    erasedMask = 0;
+
+    stats.upgrades++;
+    stats.upgradeStallTime = 0;
+    stats.upgradeStallTimeRemoved = 0;
+}
+
+void OTAStorageManager::setImageSize(uint32 size)
+{
+    imageSize = size;
+}
+
+void OTAStorageManager::stop()
+{
+    active = false;
+}
+
+bool OTAStorageManager::isActive() const
+{
+    return active;
+}
+
+uint8 OTAStorageManager::getSectorToErase() const
+{
+    if(!active)
+        return NO_SECTOR;
+
+    // The sector with the write cursor holds the downloaded data, unless the cursor is exactly at its start
+    uint8 cursorIdx = writeCursor / sectorSize;
+    uint8 first = writeCursor % sectorSize == 0 ? cursorIdx : cursorIdx + 1;
+
+    uint8 last = numSectors - 1;
+    if(imageSize != 0 && (imageSize - 1) / sectorSize < last)
+        last = (imageSize - 1) / sectorSize;
+    if(cursorIdx + eraseAhead < last)
+        last = cursorIdx + eraseAhead;
+
+    for(uint8 idx = first; idx <= last && idx < numSectors; idx++)
+        if(!isErased(idx))
+            return startSector + idx;
+
+    return NO_SECTOR;
+}
+
+void OTAStorageManager::handleBackgroundErase(uint8 sector, uint32 duration)
+{
+    uint8 idx = sector - startSector;
+    if(idx >= numSectors)
+        return;
+
+    erasedMask |= 1 << idx;
+    eraseDuration[idx] = duration;
+    stats.backgroundErases++;
+}
+
+void OTAStorageManager::handleDeferred()
+{
+    stats.deferred++;
+}
+
+bool OTAStorageManager::needsErase(uint8 sector)
+{
+    uint8 idx = sector - startSector;
+    if(idx >= numSectors || !isErased(idx))
+        return true;
+
+    // The download would have waited for this erase. Counted once, even if the erase is requested again.
+    stats.erasesSkipped++;
+    stats.stallTimeRemoved += eraseDuration[idx];
+    stats.upgradeStallTimeRemoved += eraseDuration[idx];
+    eraseDuration[idx] = 0;
+    return false;
+}
+
+void OTAStorageManager::handleOnDemandErase(uint8 sector, uint32 duration)
+{
+    stats.onDemandErases++;
+    stats.stallTime += duration;
+    stats.upgradeStallTime += duration;
+
+    uint8 idx = sector - startSector;
+    if(idx < numSectors)
+    {
+        erasedMask |= 1 << idx;
+        eraseDuration[idx] = 0;
+    }
+}
+
+void OTAStorageManager::handleWrite(uint32 offset, uint32 len)
+{
+    if(len == 0)
+        return;
+
+    // Written sectors are no longer erased
+    for(uint32 idx = offset / sectorSize; idx <= (offset + len - 1) / sectorSize && idx < numSectors; idx++)
+        erasedMask &= ~(1 << idx);
+
+    if(offset + len > writeCursor)
+        writeCursor = offset + len;
+}
+
+const OTAStorageStatistics & OTAStorageManager::getStatistics() const
+{
+    return stats;
+}
+
+bool OTAStorageManager::isErased(uint8 idx) const
+{
+    return (erasedMask & (1 << idx)) != 0;
+}
@@ -0,0 +1,76 @@
+#ifndef OTASTORAGEMANAGER_H
+#define OTASTORAGEMANAGER_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+struct OTAStorageStatistics
+{
+    uint32 upgrades;                // Downloads the storage was prepared for
+    uint32 backgroundErases;        // Sectors erased ahead of the write cursor while idle
+    uint32 onDemandErases;          // Sectors erased when the download reached them
+    uint32 erasesSkipped;           // Erase requests served by a background erase
+    uint32 deferred;                // Idle slots not used because of button or relay activity
+    uint32 stallTime;               // us spent in on-demand erases
+    uint32 stallTimeRemoved;        // us of background erases that would have stalled the download otherwise
+    uint32 upgradeStallTime;        // Same, for the current (or the last) download
+    uint32 upgradeStallTimeRemoved;
+};
+
+// Keeps the OTA flash area erased ahead of the download.
+//
+// Erasing a flash sector blocks the CPU, and erasing it when the first block of the sector arrives delays the
+// processing of that block, while the server and the radio wait. Instead the sectors ahead of the write cursor
+// are erased while the main loop is idle, so that by the time the download reaches a sector it is ready for writing.
+//
+// Only sectors after the one with the write cursor are erased in the background, as the data before the cursor is
+// still needed. A sector is considered erased till something is written to it. Nothing is known about the flash
+// state after a reset, so the tracking starts from scratch with every download.
+//
+// The class does not access the flash, the caller does the actual erases. Times are in us and provided by the caller.
+class OTAStorageManager
+{
+public:
+    static const uint8 MAX_SECTORS = 16;
+    static const uint8 DEFAULT_ERASE_AHEAD = 2;
+    static const uint8 NO_SECTOR = 0xff;
+
+private:
+    uint32 sectorSize;
+    uint8 startSector;
+    uint8 numSectors;
+    uint8 eraseAhead;
+
+    bool active;
+    uint32 imageSize;               // Limits the erases, the whole area if 0
+    uint32 writeCursor;             // End of the written data, relative to the area start
+    uint16 erasedMask;              // Erased sectors (relative to the start sector) not written since
+    uint32 eraseDuration[MAX_SECTORS];  // Background erase time, credited when the download reaches the sector
+
+    OTAStorageStatistics stats;
+
+public:
+    OTAStorageManager(uint32 sectorSize, uint8 startSector, uint8 numSectors, uint8 eraseAhead = DEFAULT_ERASE_AHEAD);
+
+    void start(uint32 offset, uint32 imageSize);
+    void setImageSize(uint32 imageSize);
+    void stop();
+    bool isActive() const;
+
+    uint8 getSectorToErase() const;
+    void handleBackgroundErase(uint8 sector, uint32 duration);
+    void handleDeferred();
+
+    bool needsErase(uint8 sector);
+    void handleOnDemandErase(uint8 sector, uint32 duration);
+    void handleWrite(uint32 offset, uint32 len);
+
+    const OTAStorageStatistics & getStatistics() const;
+
+private:
+    bool isErased(uint8 idx) const;
+};
+
+#endif // OTASTORAGEMANAGER_H
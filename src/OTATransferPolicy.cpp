@@ -0,0 +1,150 @@
+#include "OTATransferPolicy.h"
+
+OTATransferPolicy::OTATransferPolicy()
+{
+    stats.transfers = 0;
+    stats.blocksReceived = 0;
+    stats.bytesReceived = 0;
+    stats.blocksOutOfOrder = 0;
+    stats.timeouts = 0;
+    stats.waitForData = 0;
+    stats.maxRequestDelay = 0;
+
+    serverMinBlockPeriod = 0;
+    configure(DEFAULT_BLOCK_SIZE, DEFAULT_PAGE_SIZE, DEFAULT_MIN_REQUEST_DELAY, DEFAULT_RESPONSE_TIMEOUT);
+    start(0, 0, 0);
+}
+
+void OTATransferPolicy::configure(uint8 newBlockSize, uint16 newPageSize, uint16 newMinRequestDelay, uint32 newResponseTimeout)
+{
+    // Smaller blocks would not fit the flash write granularity
+    blockSize = newBlockSize < BLOCK_SIZE_ALIGNMENT ? BLOCK_SIZE_ALIGNMENT : newBlockSize;
+    pageSize = newPageSize < blockSize ? blockSize : newPageSize;
+    minRequestDelay = newMinRequestDelay;
+    responseTimeout = newResponseTimeout;
+    setRequestDelay(minRequestDelay);
+}
+
+uint8 OTATransferPolicy::getMaxBlockSize(uint8 maxApsPayload)
+{
+    // The largest block that fits a single (not fragmented) APS frame
+    if(maxApsPayload < BLOCK_RESPONSE_OVERHEAD + BLOCK_SIZE_ALIGNMENT)
+        return BLOCK_SIZE_ALIGNMENT;
+
+    uint8 size = maxApsPayload - BLOCK_RESPONSE_OVERHEAD;
+    return size - size % BLOCK_SIZE_ALIGNMENT;
+}
+
+void OTATransferPolicy::start(uint32 newImageSize, uint32 offset, uint32 now)
+{
+    // The server's MinimumBlockPeriod and the remaining WAIT_FOR_DATA delay carry over to the next image
+    imageSize = newImageSize;
+    nextOffset = offset;
+    pageBytes = 0;
+    lastBlockTime = now;
+
+    if(newImageSize)
+        stats.transfers++;
+}
+
+void OTATransferPolicy::handleMinBlockPeriod(uint16 period)
+{
+    serverMinBlockPeriod = period;
+    setRequestDelay(requestDelay);
+}
+
+void OTATransferPolicy::handleWaitForData(uint32 delay)
+{
+    // The server is busy, nothing was lost. Let it breathe, and get back to the normal pace gradually.
+    stats.waitForData++;
+    if(delay > requestDelay)
+        setRequestDelay(delay);
+}
+
+bool OTATransferPolicy::handleBlock(uint32 offset, uint8 size, uint32 now)
+{
+    // Nothing was heard for longer than a page takes, a request or a response was lost
+    uint32 pageTime = (uint32)getPageSize() / blockSize * requestDelay;
+    if((int32)(now - lastBlockTime) >= (int32)(responseTimeout + pageTime))
+        stats.timeouts++;
+    lastBlockTime = now;
+
+    // A gap means a loss, and repeated data is a retry of something that was considered lost. The gap is requested
+    // again at the same pace.
+    if(offset != nextOffset || size == 0)
+    {
+        stats.blocksOutOfOrder++;
+        return false;
+    }
+
+    // Server may grant smaller blocks than requested, the next request simply starts where this block ends
+    nextOffset += size;
+    stats.blocksReceived++;
+    stats.bytesReceived += size;
+
+    // Get back to the minimal delay after WAIT_FOR_DATA gradually, a step after each page
+    pageBytes += size;
+    if(pageBytes >= pageSize)
+    {
+        uint16 excess = requestDelay - getMinRequestDelay();
+        pageBytes = 0;
+        excess -= excess / 2;
+        setRequestDelay(getMinRequestDelay() + (excess > REQUEST_DELAY_STEP ? excess - REQUEST_DELAY_STEP : 0));
+    }
+
+    return true;
+}
+
+void OTATransferPolicy::handleTimeout(uint32 now)
+{
+    stats.timeouts++;
+    lastBlockTime = now;
+}
+
+uint8 OTATransferPolicy::getBlockSize() const
+{
+    return blockSize;
+}
+
+uint16 OTATransferPolicy::getPageSize() const
+{
+    // Whole blocks only
+    return pageSize - pageSize % blockSize;
+}
+
+uint16 OTATransferPolicy::getRequestDelay() const
+{
+    return requestDelay;
+}
+
+uint32 OTATransferPolicy::getNextOffset() const
+{
+    return nextOffset;
+}
+
+bool OTATransferPolicy::isComplete() const
+{
+    return imageSize != 0 && nextOffset >= imageSize;
+}
+
+const OTATransferStatistics & OTATransferPolicy::getStatistics() const
+{
+    return stats;
+}
+
+uint16 OTATransferPolicy::getMinRequestDelay() const
+{
+    return serverMinBlockPeriod > minRequestDelay ? serverMinBlockPeriod : minRequestDelay;
+}
+
+void OTATransferPolicy::setRequestDelay(uint32 delay)
+{
+    if(delay < getMinRequestDelay())
+        delay = getMinRequestDelay();
+    if(delay > MAX_REQUEST_DELAY)
+        delay = MAX_REQUEST_DELAY;
+
+    requestDelay = delay;
+    if(requestDelay > stats.maxRequestDelay)
+        stats.maxRequestDelay = requestDelay;
+}
@@ -0,0 +1,89 @@
+#ifndef OTATRANSFERPOLICY_H
+#define OTATRANSFERPOLICY_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+struct OTATransferStatistics
+{
+    uint32 transfers;           // Image downloads started
+    uint32 blocksReceived;      // Blocks accepted in order
+    uint32 bytesReceived;
+    uint32 blocksOutOfOrder;    // Blocks after a gap, or repeated ones. The gap has to be requested again.
+    uint32 timeouts;            // No response for longer than the response timeout
+    uint32 waitForData;         // WAIT_FOR_DATA responses from the server
+    uint16 maxRequestDelay;     // ms
+};
+
+// Decides how fast the image blocks shall be requested from the OTA server.
+//
+// - The block size is fixed. The SDK always asks for the compile time OTA_MAX_BLOCK_SIZE, and a server granting
+//   smaller blocks is just followed block by block.
+// - The delay between block requests (and the response spacing for Image Page Requests) is the configured minimum,
+//   or the server's MinimumBlockPeriod if that is longer. Losses are counted, but do not slow the transfer down. A
+//   loss driven back-off was slower than the fixed spacing in every scenario of the host benchmark
+//   (test/host/ota_transfer_bench.cpp), congested channels included.
+// - WAIT_FOR_DATA responses are honoured as a temporary increase of the delay, which shrinks back with every page
+//   received
+//
+// Data is accepted strictly in order, the same way it is written to the flash. Blocks after a gap are dropped and
+// requested again starting from the gap.
+//
+// OTAHandlers feeds the received blocks and the server responses in, and applies the returned delays to the
+// SDK's OTA client.
+class OTATransferPolicy
+{
+public:
+    static const uint8 BLOCK_SIZE_ALIGNMENT = 16;           // Flash is written in 16 byte chunks
+    static const uint8 BLOCK_RESPONSE_OVERHEAD = 17;        // ZCL header + Image Block Response fixed fields
+    static const uint8 DEFAULT_BLOCK_SIZE = 64;
+    static const uint16 DEFAULT_PAGE_SIZE = 512;
+    static const uint16 DEFAULT_MIN_REQUEST_DELAY = 20;
+    static const uint16 MAX_REQUEST_DELAY = 5000;
+    static const uint16 REQUEST_DELAY_STEP = 10;
+    static const uint32 DEFAULT_RESPONSE_TIMEOUT = 3000;
+
+private:
+    uint8 blockSize;
+    uint16 pageSize;
+    uint16 minRequestDelay;
+    uint32 responseTimeout;
+
+    uint16 serverMinBlockPeriod;
+    uint16 requestDelay;
+
+    uint32 imageSize;
+    uint32 nextOffset;
+    uint32 pageBytes;               // Received since the last delay change
+    uint32 lastBlockTime;
+
+    OTATransferStatistics stats;
+
+public:
+    OTATransferPolicy();
+
+    void configure(uint8 blockSize, uint16 pageSize, uint16 minRequestDelay, uint32 responseTimeout);
+    static uint8 getMaxBlockSize(uint8 maxApsPayload);
+
+    void start(uint32 imageSize, uint32 offset, uint32 now);
+    void handleMinBlockPeriod(uint16 period);
+    void handleWaitForData(uint32 delay);
+    bool handleBlock(uint32 offset, uint8 size, uint32 now);
+    void handleTimeout(uint32 now);
+
+    uint8 getBlockSize() const;
+    uint16 getPageSize() const;
+    uint16 getRequestDelay() const;
+    uint32 getNextOffset() const;
+    bool isComplete() const;
+
+    const OTATransferStatistics & getStatistics() const;
+
+private:
+    uint16 getMinRequestDelay() const;
+    void setRequestDelay(uint32 delay);
+};
+
+#endif // OTATRANSFERPOLICY_H
@@ -0,0 +1,313 @@
+#include "OutboundQueue.h"
+
+// On/Off cluster commands
+static const uint8 ONOFF_CMD_OFF = 0x00;
+static const uint8 ONOFF_CMD_ON = 0x01;
+static const uint8 ONOFF_CMD_TOGGLE = 0x02;
+
+OutboundQueue::OutboundQueue()
+{
+    for(uint8 i = 0; i < MAX_REPORTS; i++)
+        reports[i].state = REPORT_FREE;
+    numCommands = 0;
+
+    stats.queued = 0;
+    stats.delivered = 0;
+    stats.retried = 0;
+    stats.dropped = 0;
+}
+
+bool OutboundQueue::handleReportSent(uint8 endpoint, uint16 clusterId, uint16 attributeId, uint8 apsSeq, uint32 now)
+{
+    // A newer frame with the same attribute supersedes the previous one (or is the retry of a failed one)
+    int idx = findReport(endpoint, clusterId, attributeId);
+    if(idx < 0)
+    {
+        for(uint8 i = 0; i < MAX_REPORTS; i++)
+        {
+            if(reports[i].state == REPORT_FREE)
+            {
+                idx = i;
+                break;
+            }
+        }
+
+        // Nothing to do but send the report untracked
+        if(idx < 0)
+            return false;
+
+        reports[idx].endpoint = endpoint;
+        reports[idx].clusterId = clusterId;
+        reports[idx].attributeId = attributeId;
+        reports[idx].state = REPORT_FREE;
+        stats.queued++;
+    }
+
+    // Only the retry handed back by takeDueReports() continues counting attempts, a new value starts over
+    ReportEntry & entry = reports[idx];
+    if(entry.state != REPORT_RETRY_QUEUED)
+        entry.attempts = 0;
+
+    entry.state = REPORT_IN_FLIGHT;
+    entry.apsSeq = apsSeq;
+    entry.time = now;
+    entry.attempts++;
+    return true;
+}
+
+void OutboundQueue::handleDelivery(uint8 apsSeq, bool success, uint32 now)
+{
+    for(uint8 i = 0; i < MAX_REPORTS; i++)
+    {
+        ReportEntry & entry = reports[i];
+        if(entry.state != REPORT_IN_FLIGHT || entry.apsSeq != apsSeq)
+            continue;
+
+        if(success)
+        {
+            entry.state = REPORT_FREE;
+            stats.delivered++;
+        }
+        else
+            handleReportFailed(entry, now);
+    }
+}
+
+uint8 OutboundQueue::takeDueReports(uint32 now, ReportRecord * records, uint8 maxRecords)
+{
+    uint8 taken = 0;
+    for(uint8 i = 0; i < MAX_REPORTS; i++)
+    {
+        ReportEntry & entry = reports[i];
+
+        // No ack at all (e.g. the confirm was lost while the device was off the network) is a failure as well.
+        // Same for the retry that was handed back, but has never been sent.
+        if((entry.state == REPORT_IN_FLIGHT || entry.state == REPORT_RETRY_QUEUED) && now - entry.time >= ACK_TIMEOUT)
+            handleReportFailed(entry, now);
+
+        if(entry.state != REPORT_RETRY_WAIT || (int32)(now - entry.time) < 0 || taken >= maxRecords)
+            continue;
+
+        entry.state = REPORT_RETRY_QUEUED;
+        entry.time = now;
+        records[taken].endpoint = entry.endpoint;
+        records[taken].clusterId = entry.clusterId;
+        records[taken].attributeId = entry.attributeId;
+        records[taken].requests = 1;
+        taken++;
+    }
+
+    return taken;
+}
+
+bool OutboundQueue::isReportPending(uint8 endpoint, uint16 clusterId, uint16 attributeId) const
+{
+    return findReport(endpoint, clusterId, attributeId) >= 0;
+}
+
+bool OutboundQueue::queueCommand(uint8 endpoint, uint16 clusterId, uint8 commandId, uint32 now)
+{
+    OutboundCommand command;
+    command.endpoint = endpoint;
+    command.clusterId = clusterId;
+    command.commandId = commandId;
+    command.attempts = 0;
+    command.queuedTime = now;
+    command.nextAttemptTime = now;
+
+    stats.queued++;
+    return addCommand(command);
+}
+
+bool OutboundQueue::retryCommand(const OutboundCommand & command, uint32 now)
+{
+    if(command.attempts + 1 >= MAX_ATTEMPTS)
+    {
+        stats.dropped++;
+        return false;
+    }
+
+    stats.retried++;
+
+    // A command held meanwhile is newer than the failed one
+    int idx = findCommand(command.endpoint, command.clusterId);
+    if(idx >= 0)
+    {
+        uint8 merged;
+        if(!mergeOnOffCommands(command.commandId, commands[idx].commandId, &merged))
+            removeCommand(idx);
+        else
+            commands[idx].commandId = merged;
+        return true;
+    }
+
+    OutboundCommand retry = command;
+    retry.attempts++;
+    retry.nextAttemptTime = now + getRetryDelay(retry.attempts);
+    return addCommand(retry);
+}
+
+bool OutboundQueue::takeDueCommand(uint32 now, OutboundCommand * command)
+{
+    uint8 i = 0;
+    while(i < numCommands)
+    {
+        // The user does not expect the light to react a long time after the button was pressed
+        if(now - commands[i].queuedTime > COMMAND_MAX_AGE)
+        {
+            removeCommand(i);
+            stats.dropped++;
+            continue;
+        }
+
+        if((int32)(now - commands[i].nextAttemptTime) >= 0)
+        {
+            *command = commands[i];
+            removeCommand(i);
+            return true;
+        }
+
+        i++;
+    }
+
+    return false;
+}
+
+void OutboundQueue::handleCommandSent()
+{
+    stats.delivered++;
+}
+
+uint8 OutboundQueue::getNumCommands() const
+{
+    return numCommands;
+}
+
+void OutboundQueue::expedite(uint32 now)
+{
+    // The network is back - there is no point to wait for the back-off delays, or acks of frames sent before
+    for(uint8 i = 0; i < MAX_REPORTS; i++)
+    {
+        ReportEntry & entry = reports[i];
+        if(entry.state == REPORT_IN_FLIGHT)
+            stats.retried++;
+
+        if(entry.state == REPORT_IN_FLIGHT || entry.state == REPORT_RETRY_WAIT)
+        {
+            entry.state = REPORT_RETRY_WAIT;
+            entry.time = now;
+        }
+    }
+
+    for(uint8 i = 0; i < numCommands; i++)
+        commands[i].nextAttemptTime = now;
+}
+
+void OutboundQueue::handleDropped()
+{
+    stats.dropped++;
+}
+
+const OutboundStatistics & OutboundQueue::getStatistics() const
+{
+    return stats;
+}
+
+bool OutboundQueue::mergeOnOffCommands(uint8 pending, uint8 next, uint8 * merged)
+{
+    // On and Off set the absolute state, so the newer one wins
+    if(next != ONOFF_CMD_TOGGLE)
+    {
+        *merged = next;
+        return true;
+    }
+
+    // Toggle inverts what was pending, and two toggles cancel each other
+    switch(pending)
+    {
+        case ONOFF_CMD_ON:      *merged = ONOFF_CMD_OFF; return true;
+        case ONOFF_CMD_OFF:     *merged = ONOFF_CMD_ON; return true;
+        default:                return false;
+    }
+}
+
+uint32 OutboundQueue::getRetryDelay(uint8 attempts)
+{
+    // Exponential back-off: 1s, 2s, 4s, ... capped at the max delay
+    uint32 delay = INITIAL_RETRY_DELAY;
+    for(uint8 i = 1; i < attempts && delay < MAX_RETRY_DELAY; i++)
+        delay *= 2;
+
+    return delay < MAX_RETRY_DELAY ? delay : MAX_RETRY_DELAY;
+}
+
+int OutboundQueue::findReport(uint8 endpoint, uint16 clusterId, uint16 attributeId) const
+{
+    for(uint8 i = 0; i < MAX_REPORTS; i++)
+    {
+        const ReportEntry & entry = reports[i];
+        if(entry.state != REPORT_FREE && entry.endpoint == endpoint && entry.clusterId == clusterId && entry.attributeId == attributeId)
+            return i;
+    }
+
+    return -1;
+}
+
+int OutboundQueue::findCommand(uint8 endpoint, uint16 clusterId) const
+{
+    for(uint8 i = 0; i < numCommands; i++)
+        if(commands[i].endpoint == endpoint && commands[i].clusterId == clusterId)
+            return i;
+
+    return -1;
+}
+
+void OutboundQueue::handleReportFailed(ReportEntry & entry, uint32 now)
+{
+    if(entry.attempts >= MAX_ATTEMPTS)
+    {
+        entry.state = REPORT_FREE;
+        stats.dropped++;
+        return;
+    }
+
+    entry.state = REPORT_RETRY_WAIT;
+    entry.time = now + getRetryDelay(entry.attempts);
+    stats.retried++;
+}
+
+bool OutboundQueue::addCommand(const OutboundCommand & command)
+{
+    // Only the combined effect of the commands of an endpoint matters
+    int idx = findCommand(command.endpoint, command.clusterId);
+    if(idx >= 0)
+    {
+        uint8 merged;
+        if(!mergeOnOffCommands(commands[idx].commandId, command.commandId, &merged))
+        {
+            removeCommand(idx);
+            return true;
+        }
+
+        commands[idx].commandId = merged;
+        commands[idx].queuedTime = command.queuedTime;
+        commands[idx].attempts = command.attempts;
+        commands[idx].nextAttemptTime = command.nextAttemptTime;
+        return true;
+    }
+
+    if(numCommands >= MAX_COMMANDS)
+    {
+        stats.dropped++;
+        return false;
+    }
+
+    commands[numCommands++] = command;
+    return true;
+}
+
+void OutboundQueue::removeCommand(uint8 idx)
+{
+    // The order of commands of different endpoints does not matter
+    commands[idx] = commands[--numCommands];
+}
@@ -0,0 +1,106 @@
+#ifndef OUTBOUNDQUEUE_H
+#define OUTBOUNDQUEUE_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+#include "ReportBatch.h"
+
+// On/Off command waiting to be sent to the bound devices
+struct OutboundCommand
+{
+    uint8 endpoint;
+    uint16 clusterId;
+    uint8 commandId;
+    uint8 attempts;             // Failed attempts so far
+    uint32 queuedTime;
+    uint32 nextAttemptTime;
+};
+
+struct OutboundStatistics
+{
+    uint32 queued;              // Reports sent with delivery tracking, and commands held for later
+    uint32 delivered;           // Reports acknowledged by the coordinator, held commands finally sent
+    uint32 retried;             // Retransmissions scheduled after a failure
+    uint32 dropped;             // Given up: no more attempts, too old, or no room
+};
+
+// Bounded queue of outgoing messages that must not get lost while the network is unavailable or flaky.
+//
+// - Attribute reports are tracked by the APS sequence number of the frame. Failed or unacknowledged reports are
+//   scheduled for retransmission with exponential back-off. Only the latest value of an attribute matters, so
+//   the queue keeps attribute ids rather than values (value is read from the cluster at the time of sending).
+// - On/Off commands that cannot be sent right now are held, one per endpoint, and merged with the newer ones
+//   (On + Toggle = Off, Toggle + Toggle = nothing, etc). Commands that waited too long are dropped, so that a
+//   light does not switch unexpectedly long after the button was pressed.
+//
+// Nothing is sent from here. DeliveryTracker makes the transmissions and reports how they went.
+class OutboundQueue
+{
+    enum ReportState
+    {
+        REPORT_FREE,
+        REPORT_IN_FLIGHT,           // Sent, waiting for the APS ack
+        REPORT_RETRY_WAIT,          // Failed, waiting for the back-off delay
+        REPORT_RETRY_QUEUED         // Handed back for sending
+    };
+
+    struct ReportEntry
+    {
+        uint8 state;
+        uint8 endpoint;
+        uint16 clusterId;
+        uint16 attributeId;
+        uint8 apsSeq;
+        uint8 attempts;
+        uint32 time;                // Time the frame was sent, or time of the next attempt
+    };
+
+public:
+    static const uint8 MAX_REPORTS = 16;
+    static const uint8 MAX_COMMANDS = 4;
+    static const uint8 MAX_ATTEMPTS = 4;
+    static const uint32 INITIAL_RETRY_DELAY = 1000;
+    static const uint32 MAX_RETRY_DELAY = 8000;
+    static const uint32 ACK_TIMEOUT = 10000;
+    static const uint32 COMMAND_MAX_AGE = 15000;
+
+private:
+    ReportEntry reports[MAX_REPORTS];
+    OutboundCommand commands[MAX_COMMANDS];
+    uint8 numCommands;
+
+    OutboundStatistics stats;
+
+public:
+    OutboundQueue();
+
+    bool handleReportSent(uint8 endpoint, uint16 clusterId, uint16 attributeId, uint8 apsSeq, uint32 now);
+    void handleDelivery(uint8 apsSeq, bool success, uint32 now);
+    uint8 takeDueReports(uint32 now, ReportRecord * records, uint8 maxRecords);
+    bool isReportPending(uint8 endpoint, uint16 clusterId, uint16 attributeId) const;
+
+    bool queueCommand(uint8 endpoint, uint16 clusterId, uint8 commandId, uint32 now);
+    bool retryCommand(const OutboundCommand & command, uint32 now);
+    bool takeDueCommand(uint32 now, OutboundCommand * command);
+    void handleCommandSent();
+    uint8 getNumCommands() const;
+
+    void expedite(uint32 now);
+    void handleDropped();
+    const OutboundStatistics & getStatistics() const;
+
+    static bool mergeOnOffCommands(uint8 pending, uint8 next, uint8 * merged);
+    static uint32 getRetryDelay(uint8 attempts);
+
+private:
+    int findReport(uint8 endpoint, uint16 clusterId, uint16 attributeId) const;
+    int findCommand(uint8 endpoint, uint16 clusterId) const;
+    void handleReportFailed(ReportEntry & entry, uint32 now);
+    bool addCommand(const OutboundCommand & command);
+    void removeCommand(uint8 idx);
+};
+
+#endif // OUTBOUNDQUEUE_H
@@ -6,6 +6,10 @@
 
 const uint8 PDM_ID_NODE_STATE 	= 1;
 const uint8 PDM_ID_OTA_DATA 	= 2;
+const uint8 PDM_ID_POLL_CONTROL	= 3;
+const uint8 PDM_ID_OTA_PARTIAL_SECTOR	= 4;
+const uint8 PDM_ID_OTA_IMAGE_FORMAT	= 5;
+const uint8 PDM_ID_REPORTING_CONFIG	= 6;
 
 const uint8 PDM_ID_EP_DATA_BASE = 0x10;
 
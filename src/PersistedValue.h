@@ -74,11 +74,16 @@ public:
     void setValue(const T & newValue)
     {
         value = newValue;
+        save();
+    }
+
+    void save() // Write the value modified via the pointer
+    {
         PDM_teStatus status = PDM_eSaveRecordData(id, &value, sizeof(T));
         if(sizeof(T) <= 4)
-            DBG_vPrintf(TRUE, "PersistedValue::setValue(): %s: Status %d, value %d\n", name, status, value);
+            DBG_vPrintf(TRUE, "PersistedValue::save(): %s: Status %d, value %d\n", name, status, value);
         else
-            DBG_vPrintf(TRUE, "PersistedValue::setValue(): %s: Status %d\n", name, status);
+            DBG_vPrintf(TRUE, "PersistedValue::save(): %s: Status %d\n", name, status);
     }
 };
 
@@ -0,0 +1,238 @@
+extern "C"
+{
+    #include "jendefs.h"
+    #include "dbg.h"
+}
+
+#include "PollControlHandlers.h"
+#include "SystemClock.h"
+#include "ZigbeeDevice.h"
+#include "DiagnosticsCollector.h"
+
+// Poll Control cluster operates with quarter-second intervals
+static const uint32 QUARTER_SECOND_MS = 250;
+
+// Default values, see ZCL spec for the Poll Control cluster
+static const uint32 DEFAULT_CHECK_IN_INTERVAL = 3600 * 4;                                   // 1 hour
+static const uint32 DEFAULT_LONG_POLL_INTERVAL = PollPolicy::DEFAULT_LONG_POLL_PERIOD / QUARTER_SECOND_MS;
+static const uint16 DEFAULT_SHORT_POLL_INTERVAL = PollPolicy::DEFAULT_FAST_POLL_PERIOD / QUARTER_SECOND_MS;
+static const uint16 DEFAULT_FAST_POLL_TIMEOUT = 10 * 4;                                     // 10 seconds
+
+// Limits defined by ZCL spec
+static const uint32 MAX_CHECK_IN_INTERVAL = 0x6E0000;
+static const uint32 MIN_LONG_POLL_INTERVAL = 0x04;
+static const uint32 MAX_LONG_POLL_INTERVAL = 0x6E0000;
+
+PollControlHandlers::PollControlHandlers()
+{
+    ep = 0;
+    pollControlCluster = NULL;
+    nextCheckInTime = 0;
+}
+
+void PollControlHandlers::initDefaults(PollControlSettings * defaults)
+{
+    defaults->checkInInterval = DEFAULT_CHECK_IN_INTERVAL;
+    defaults->longPollInterval = DEFAULT_LONG_POLL_INTERVAL;
+    defaults->shortPollInterval = DEFAULT_SHORT_POLL_INTERVAL;
+    defaults->fastPollTimeout = DEFAULT_FAST_POLL_TIMEOUT;
+}
+
+void PollControlHandlers::init(uint8 endpoint, tsCLD_PollControl * cluster)
+{
+    ep = endpoint;
+    pollControlCluster = cluster;
+
+    // Restore settings from PDM
+    settings.init(initDefaults, "Poll Control settings");
+    if(!isValid(settings.getValue()))
+    {
+        DBG_vPrintf(TRUE, "PollControlHandlers: Stored settings are invalid. Resetting to defaults\n");
+        PollControlSettings defaults;
+        initDefaults(&defaults);
+        settings = defaults;
+    }
+
+    PollControlSettings s = settings.getValue();
+    pollControlCluster->u32CheckinInterval = s.checkInInterval;
+    pollControlCluster->u32LongPollInterval = s.longPollInterval;
+    pollControlCluster->u16ShortPollInterval = s.shortPollInterval;
+    pollControlCluster->u16FastPollTimeout = s.fastPollTimeout;
+
+    // Poll periods are applied when the device joins the network (ZigbeeDevice is not yet created at this point)
+    scheduleNextCheckIn();
+}
+
+bool PollControlHandlers::isValid(const PollControlSettings & s) const
+{
+    if(s.shortPollInterval == 0 || s.fastPollTimeout == 0)
+        return false;
+
+    if(s.longPollInterval < MIN_LONG_POLL_INTERVAL || s.longPollInterval > MAX_LONG_POLL_INTERVAL)
+        return false;
+
+    if(s.longPollInterval < s.shortPollInterval)
+        return false;
+
+    // Zero check-in interval disables check-ins
+    if(s.checkInInterval != 0 && (s.checkInInterval < s.longPollInterval || s.checkInInterval > MAX_CHECK_IN_INTERVAL))
+        return false;
+
+    return true;
+}
+
+teZCL_CommandStatus PollControlHandlers::checkAttributeRange(uint16 attrId, void * value)
+{
+    // Validate the new value against other settings
+    PollControlSettings s = settings.getValue();
+    switch(attrId)
+    {
+        case E_CLD_POLL_CONTROL_ATTR_ID_CHECKIN_INTERVAL:
+            s.checkInInterval = *(uint32*)value;
+            break;
+
+        case E_CLD_POLL_CONTROL_ATTR_ID_LONG_POLL_INTERVAL:
+            s.longPollInterval = *(uint32*)value;
+            break;
+
+        case E_CLD_POLL_CONTROL_ATTR_ID_SHORT_POLL_INTERVAL:
+            s.shortPollInterval = *(uint16*)value;
+            break;
+
+        case E_CLD_POLL_CONTROL_ATTR_ID_FAST_POLL_TIMEOUT:
+            s.fastPollTimeout = *(uint16*)value;
+            break;
+
+        default:
+            return E_ZCL_CMDS_SUCCESS;
+    }
+
+    return isValid(s) ? E_ZCL_CMDS_SUCCESS : E_ZCL_CMDS_INVALID_VALUE;
+}
+
+void PollControlHandlers::handleAttributeWrite(uint16 attrId)
+{
+    DBG_vPrintf(TRUE, "PollControlHandlers: Attribute %04x written\n", attrId);
+
+    saveSettings();
+    applySettings();
+
+    if(attrId == E_CLD_POLL_CONTROL_ATTR_ID_CHECKIN_INTERVAL)
+        scheduleNextCheckIn();
+}
+
+void PollControlHandlers::handlePollControlMessage(tsCLD_PollControlCallBackMessage * msg)
+{
+    switch(msg->u8CommandId)
+    {
+        case E_CLD_POLL_CONTROL_CMD_CHECK_IN:
+        {
+            // Check-in response from the client
+            tsCLD_PollControl_CheckinResponsePayload * payload = msg->uMessage.psCheckinResponsePayload;
+            DBG_vPrintf(TRUE, "PollControlHandlers: Check-in response. StartFastPolling=%d Timeout=%d\n",
+                        payload->bStartFastPolling, payload->u16FastPollTimeout);
+
+            if(payload->bStartFastPolling)
+            {
+                // Zero timeout means the client wants the default one
+                uint16 timeout = payload->u16FastPollTimeout ? payload->u16FastPollTimeout : pollControlCluster->u16FastPollTimeout;
+                ZigbeeDevice::getInstance()->startFastPoll(timeout * QUARTER_SECOND_MS);
+            }
+            break;
+        }
+
+        case E_CLD_POLL_CONTROL_CMD_FAST_POLL_STOP:
+            DBG_vPrintf(TRUE, "PollControlHandlers: Fast Poll Stop\n");
+            ZigbeeDevice::getInstance()->stopFastPoll();
+            break;
+
+        case E_CLD_POLL_CONTROL_CMD_SET_LONG_POLL_INTERVAL:
+        {
+            uint32 interval = msg->uMessage.psSetLongPollIntervalPayload->u32NewLongPollInterval;
+            DBG_vPrintf(TRUE, "PollControlHandlers: Set Long Poll Interval %d\n", interval);
+
+            if(checkAttributeRange(E_CLD_POLL_CONTROL_ATTR_ID_LONG_POLL_INTERVAL, &interval) == E_ZCL_CMDS_SUCCESS)
+            {
+                pollControlCluster->u32LongPollInterval = interval;
+                handleAttributeWrite(E_CLD_POLL_CONTROL_ATTR_ID_LONG_POLL_INTERVAL);
+            }
+            break;
+        }
+
+        case E_CLD_POLL_CONTROL_CMD_SET_SHORT_POLL_INTERVAL:
+        {
+            uint16 interval = msg->uMessage.psSetShortPollIntervalPayload->u16NewShortPollInterval;
+            DBG_vPrintf(TRUE, "PollControlHandlers: Set Short Poll Interval %d\n", interval);
+
+            if(checkAttributeRange(E_CLD_POLL_CONTROL_ATTR_ID_SHORT_POLL_INTERVAL, &interval) == E_ZCL_CMDS_SUCCESS)
+            {
+                pollControlCluster->u16ShortPollInterval = interval;
+                handleAttributeWrite(E_CLD_POLL_CONTROL_ATTR_ID_SHORT_POLL_INTERVAL);
+            }
+            break;
+        }
+
+        default:
+            DBG_vPrintf(TRUE, "PollControlHandlers: Unexpected command %d\n", msg->u8CommandId);
+            break;
+    }
+}
+
+void PollControlHandlers::handleDeviceJoin()
+{
+    // Apply settings to the freshly started parent poll task
+    applySettings();
+    scheduleNextCheckIn();
+}
+
+void PollControlHandlers::handleParentPoll()
+{
+    if(pollControlCluster->u32CheckinInterval == 0)
+        return;
+
+    if((int32)(SystemClock::getInstance()->getTimeMs() - nextCheckInTime) < 0)
+        return;
+
+    sendCheckIn();
+    scheduleNextCheckIn();
+}
+
+void PollControlHandlers::saveSettings()
+{
+    PollControlSettings s;
+    s.checkInInterval = pollControlCluster->u32CheckinInterval;
+    s.longPollInterval = pollControlCluster->u32LongPollInterval;
+    s.shortPollInterval = pollControlCluster->u16ShortPollInterval;
+    s.fastPollTimeout = pollControlCluster->u16FastPollTimeout;
+    settings = s;
+}
+
+void PollControlHandlers::applySettings()
+{
+    ZigbeeDevice::getInstance()->setPollPeriods(pollControlCluster->u16ShortPollInterval * QUARTER_SECOND_MS,
+                                                pollControlCluster->u32LongPollInterval * QUARTER_SECOND_MS);
+}
+
+void PollControlHandlers::scheduleNextCheckIn()
+{
+    nextCheckInTime = SystemClock::getInstance()->getTimeMs() + pollControlCluster->u32CheckinInterval * QUARTER_SECOND_MS;
+}
+
+void PollControlHandlers::sendCheckIn()
+{
+    // Destination address does not matter - the check-in is sent to all bound clients
+    tsZCL_Address addr;
+    addr.uAddress.u16DestinationAddress = 0x0000;
+    addr.eAddressMode = E_ZCL_AM_BOUND_NON_BLOCKING;
+
+    uint8 sequenceNo;
+    teZCL_Status status = eCLD_PollControlCheckinCommandSend(ep,
+                                                             1,
+                                                             &addr,
+                                                             &sequenceNo);
+    DiagnosticsCollector::getInstance()->handleSendStatus(status);
+    DBG_vPrintf(TRUE, "PollControlHandlers: Sending Check-in command status: %02x\n", status);
+
+    // Pick up the check-in response quickly
+    ZigbeeDevice::getInstance()->triggerFastPoll();
+}
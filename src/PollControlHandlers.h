@@ -0,0 +1,53 @@
+#ifndef POLLCONTROLHANDLERS_H
+#define POLLCONTROLHANDLERS_H
+
+#include "PersistedValue.h"
+#include "PdmIds.h"
+
+extern "C"
+{
+    #include "jendefs.h"
+    #include "zcl.h"
+    #include "PollControl.h"
+}
+
+// Poll Control cluster settings that survive reboot. All intervals are in quarter-seconds, as per ZCL spec.
+struct PollControlSettings
+{
+    uint32 checkInInterval;
+    uint32 longPollInterval;
+    uint16 shortPollInterval;
+    uint16 fastPollTimeout;
+};
+
+// Poll Control cluster server logic:
+// - keeps cluster attributes in sync with PDM, and applies them to the parent poll scheduler
+// - periodically sends Check-in command to bound clients
+// - starts/stops fast polling as requested by the client
+class PollControlHandlers
+{
+    uint8 ep;
+    tsCLD_PollControl * pollControlCluster;
+    PersistedValue<PollControlSettings, PDM_ID_POLL_CONTROL> settings;
+    uint32 nextCheckInTime;
+
+public:
+    PollControlHandlers();
+
+    void init(uint8 ep, tsCLD_PollControl * cluster);
+    void handlePollControlMessage(tsCLD_PollControlCallBackMessage * msg);
+    teZCL_CommandStatus checkAttributeRange(uint16 attrId, void * value);
+    void handleAttributeWrite(uint16 attrId);
+    void handleDeviceJoin();
+    void handleParentPoll();
+
+private:
+    static void initDefaults(PollControlSettings * defaults);
+    bool isValid(const PollControlSettings & s) const;
+    void saveSettings();
+    void applySettings();
+    void scheduleNextCheckIn();
+    void sendCheckIn();
+};
+
+#endif // POLLCONTROLHANDLERS_H
@@ -0,0 +1,144 @@
+#include "PollPolicy.h"
+
+PollPolicy::PollPolicy()
+{
+    configure(DEFAULT_FAST_POLL_PERIOD, DEFAULT_LONG_POLL_PERIOD, DEFAULT_FAST_POLL_WINDOW, DEFAULT_MAX_DRAIN_POLLS);
+
+    stats.pollsSent = 0;
+    stats.dataReceived = 0;
+    stats.emptyPolls = 0;
+    stats.failedPolls = 0;
+    stats.drainLimitHits = 0;
+
+    reset(0);
+}
+
+void PollPolicy::configure(uint32 fastPeriod, uint32 longPeriod, uint32 fastWindow, uint8 maxDrain)
+{
+    fastPollPeriod = fastPeriod;
+    longPollPeriod = longPeriod > fastPeriod ? longPeriod : fastPeriod;
+    fastPollWindow = fastWindow;
+    maxDrainPolls = maxDrain;
+}
+
+void PollPolicy::setPollPeriods(uint32 fastPeriod, uint32 longPeriod)
+{
+    // Change poll periods on the fly, keeping fast poll window and drain settings
+    configure(fastPeriod, longPeriod, fastPollWindow, maxDrainPolls);
+
+    // Make sure the back-off stays within the new limits
+    if(currentPeriod < fastPollPeriod)
+        currentPeriod = fastPollPeriod;
+    if(currentPeriod > longPollPeriod)
+        currentPeriod = longPollPeriod;
+}
+
+void PollPolicy::reset(uint32 now)
+{
+    drainPolls = 0;
+    currentPeriod = fastPollPeriod;
+    fastPolling = false;
+    fastPollUntil = now;
+}
+
+void PollPolicy::triggerFastPoll(uint32 now)
+{
+    triggerFastPoll(now, fastPollWindow);
+}
+
+void PollPolicy::triggerFastPoll(uint32 now, uint32 window)
+{
+    // Extend the fast poll window, but never shorten it
+    uint32 until = now + window;
+    if(!fastPolling || (int32)(until - fastPollUntil) > 0)
+        fastPollUntil = until;
+
+    fastPolling = true;
+    currentPeriod = fastPollPeriod;
+}
+
+void PollPolicy::stopFastPoll()
+{
+    // Expire the window immediately, and continue with the long poll
+    fastPolling = false;
+    currentPeriod = longPollPeriod;
+}
+
+bool PollPolicy::isFastPolling(uint32 now) const
+{
+    return fastPolling && (int32)(fastPollUntil - now) > 0;
+}
+
+uint32 PollPolicy::getFastPollUntil() const
+{
+    return fastPollUntil;
+}
+
+uint32 PollPolicy::getNextPollDelay(uint32 now)
+{
+    if(isFastPolling(now))
+        return fastPollPeriod;
+
+    // Exponential back-off from fast poll period to the long poll period
+    uint32 delay = currentPeriod;
+    currentPeriod = currentPeriod * 2 < longPollPeriod ? currentPeriod * 2 : longPollPeriod;
+    return delay;
+}
+
+void PollPolicy::handlePollSent()
+{
+    stats.pollsSent++;
+}
+
+bool PollPolicy::handlePollResult(PollResult result, uint32 now)
+{
+    switch(result)
+    {
+        case POLL_RESULT_DATA:
+            // The parent may have more messages queued for us. Also a received message is likely to be followed
+            // by other messages (e.g. a next OTA block), so keep polling fast for a while
+            stats.dataReceived++;
+            triggerFastPoll(now);
+            break;
+
+        case POLL_RESULT_NO_ACK:
+            // Parent did not hear us, try again right away (the drain limit prevents endless retries)
+            stats.failedPolls++;
+            break;
+
+        case POLL_RESULT_NO_DATA:
+            stats.emptyPolls++;
+            drainPolls = 0;
+            return false;
+
+        default:
+            stats.failedPolls++;
+            drainPolls = 0;
+            return false;
+    }
+
+    // Limit the number of consecutive immediate polls
+    if(++drainPolls > maxDrainPolls)
+    {
+        stats.drainLimitHits++;
+        drainPolls = 0;
+        return false;
+    }
+
+    return true;
+}
+
+uint32 PollPolicy::getFastPollPeriod() const
+{
+    return fastPollPeriod;
+}
+
+uint32 PollPolicy::getLongPollPeriod() const
+{
+    return longPollPeriod;
+}
+
+const PollStatistics & PollPolicy::getStatistics() const
+{
+    return stats;
+}
@@ -0,0 +1,78 @@
+#ifndef POLLPOLICY_H
+#define POLLPOLICY_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// Result of a single data poll, as reported by the MAC layer
+enum PollResult
+{
+    POLL_RESULT_DATA,       // Parent had data for us (MAC_ENUM_SUCCESS)
+    POLL_RESULT_NO_DATA,    // Parent had nothing for us (MAC_ENUM_NO_DATA)
+    POLL_RESULT_NO_ACK,     // Parent did not respond (MAC_ENUM_NO_ACK)
+    POLL_RESULT_ERROR       // Any other failure
+};
+
+struct PollStatistics
+{
+    uint32 pollsSent;
+    uint32 dataReceived;
+    uint32 emptyPolls;
+    uint32 failedPolls;
+    uint32 drainLimitHits;
+};
+
+// Decides how often an end device shall poll its parent.
+//
+// - Right after a local activity (button press, outgoing request) the device polls fast for a short window, so
+//   that responses (or consecutive OTA blocks) are picked up quickly.
+// - When idle the poll period grows exponentially until it reaches the long poll period.
+// - When the parent has data for us, the device polls again immediately to drain the parent's queue. The number
+//   of consecutive drain polls is limited, so that a chatty parent cannot keep the device awake forever.
+//
+// PollTask reports the activity and the poll results, and starts the poll timer with the period returned here.
+class PollPolicy
+{
+    uint32 fastPollPeriod;
+    uint32 longPollPeriod;
+    uint32 fastPollWindow;
+    uint8 maxDrainPolls;
+
+    uint32 currentPeriod;
+    bool fastPolling;
+    uint32 fastPollUntil;
+    uint8 drainPolls;
+
+    PollStatistics stats;
+
+public:
+    static const uint32 DEFAULT_FAST_POLL_PERIOD = 250;
+    static const uint32 DEFAULT_LONG_POLL_PERIOD = 7500;      // Below default parent indirect transaction timeout (7.68s)
+    static const uint32 DEFAULT_FAST_POLL_WINDOW = 3000;
+    static const uint8 DEFAULT_MAX_DRAIN_POLLS = 8;
+
+public:
+    PollPolicy();
+
+    void configure(uint32 fastPeriod, uint32 longPeriod, uint32 fastWindow, uint8 maxDrain);
+    void setPollPeriods(uint32 fastPeriod, uint32 longPeriod);
+    void reset(uint32 now);
+
+    void triggerFastPoll(uint32 now);
+    void triggerFastPoll(uint32 now, uint32 window);
+    void stopFastPoll();
+    bool isFastPolling(uint32 now) const;
+    uint32 getFastPollUntil() const;
+
+    uint32 getNextPollDelay(uint32 now);
+    void handlePollSent();
+    bool handlePollResult(PollResult result, uint32 now);
+
+    uint32 getFastPollPeriod() const;
+    uint32 getLongPollPeriod() const;
+    const PollStatistics & getStatistics() const;
+};
+
+#endif // POLLPOLICY_H
@@ -7,16 +7,26 @@ extern "C"
 }
 
 #include "PollTask.h"
+#include "SystemClock.h"
+#include "ZigbeeDevice.h"
 
 PollTask::PollTask()
 {
+    // The timer is restarted manually with the delay suggested by the poll policy
     PeriodicTask::init(0);
+    nextPollTime = 0;
+    pollPeriod = 0;
+    repolling = false;
 }
 
-void PollTask::startPoll(int period)
+void PollTask::startPoll()
 {
-    setPeriod(period);
-    startTimer(period);
+    policy.reset(SystemClock::getInstance()->getTimeMs());
+    repolling = false;
+
+    // Just joined - the device is likely to be configured by the coordinator right away
+    triggerFastPoll();
+    scheduleNextPoll();
 }
 
 void PollTask::stopPoll()
@@ -24,7 +34,118 @@ void PollTask::stopPoll()
     stopTimer();
 }
 
-void PollTask::timerCallback()
+void PollTask::poll()
 {
+    policy.handlePollSent();
     ZPS_eAplZdoPoll();
+
+    // Any poll restarts the poll period. Only a regular (or wake up) poll takes the next back-off step though. Quick
+    // re-polls (draining the parent's queue, or retrying a poll the parent did not ack) keep the fast period, which
+    // just covers a lost poll confirm.
+    if(repolling)
+        startPollTimer(policy.getFastPollPeriod());
+    else
+        scheduleNextPoll();
+}
+
+void PollTask::triggerFastPoll()
+{
+    bool wasFastPolling = isFastPolling();
+    policy.triggerFastPoll(SystemClock::getInstance()->getTimeMs());
+
+    // Switch to the fast poll immediately, rather than waiting for the end of a long poll period
+    if(!wasFastPolling && isTimerActive())
+        scheduleNextPoll();
+}
+
+void PollTask::setPollPeriods(uint32 fastPeriod, uint32 longPeriod)
+{
+    policy.setPollPeriods(fastPeriod, longPeriod);
+
+    // Apply new periods right away, otherwise the device may sleep for the old (possibly very long) period
+    if(isTimerActive())
+        scheduleNextPoll();
+}
+
+void PollTask::startFastPoll(uint32 duration)
+{
+    // Fast poll for the requested time (e.g. as requested by the Poll Control cluster client)
+    policy.triggerFastPoll(SystemClock::getInstance()->getTimeMs(), duration);
+
+    if(isTimerActive())
+        scheduleNextPoll();
+}
+
+void PollTask::stopFastPoll()
+{
+    policy.stopFastPoll();
+
+    if(isTimerActive())
+        scheduleNextPoll();
+}
+
+bool PollTask::isFastPolling() const
+{
+    return policy.isFastPolling(SystemClock::getInstance()->getTimeMs());
+}
+
+uint32 PollTask::getFastPollUntil() const
+{
+    return policy.getFastPollUntil();
+}
+
+bool PollTask::handlePollResult(PollResult result)
+{
+    uint32 now = SystemClock::getInstance()->getTimeMs();
+    bool pollAgain = policy.handlePollResult(result, now);
+
+    // Quick re-polls are over, continue with the period of the last regular poll, or with the fast poll if some data
+    // was received meanwhile
+    if(!pollAgain && repolling)
+        startPollTimer(policy.isFastPolling(now) ? policy.getFastPollPeriod() : pollPeriod);
+
+    repolling = pollAgain;
+    return pollAgain;
+}
+
+uint32 PollTask::getTimeTillNextPoll() const
+{
+    int32 delay = (int32)(nextPollTime - SystemClock::getInstance()->getTimeMs());
+    return delay > 0 ? delay : 0;
+}
+
+const PollStatistics & PollTask::getStatistics() const
+{
+    return policy.getStatistics();
+}
+
+void PollTask::dumpStatistics() const
+{
+    const PollStatistics & stats = policy.getStatistics();
+    DBG_vPrintf(TRUE, "\n+++++++ Poll statistics:\n");
+    DBG_vPrintf(TRUE, "    Polls sent: %d\n", stats.pollsSent);
+    DBG_vPrintf(TRUE, "    Data received: %d\n", stats.dataReceived);
+    DBG_vPrintf(TRUE, "    Empty polls: %d\n", stats.emptyPolls);
+    DBG_vPrintf(TRUE, "    Failed polls: %d\n", stats.failedPolls);
+    DBG_vPrintf(TRUE, "    Drain limit hits: %d\n", stats.drainLimitHits);
+    DBG_vPrintf(TRUE, "    Fast polling: %d, next poll in %d ms\n", isFastPolling(), getTimeTillNextPoll());
+}
+
+void PollTask::scheduleNextPoll()
+{
+    pollPeriod = policy.getNextPollDelay(SystemClock::getInstance()->getTimeMs());
+    startPollTimer(pollPeriod);
+}
+
+void PollTask::startPollTimer(uint32 delay)
+{
+    nextPollTime = SystemClock::getInstance()->getTimeMs() + delay;
+
+    stopTimer();
+    startTimer(delay);
+}
+
+void PollTask::timerCallback()
+{
+    ZigbeeDevice::getInstance()->pollParent();
 }
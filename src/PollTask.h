@@ -2,16 +2,37 @@
 #define POLLTASK_H
 
 #include "PeriodicTask.h"
+#include "PollPolicy.h"
 
 class PollTask : public PeriodicTask
 {
+    PollPolicy policy;
+    uint32 nextPollTime;
+    uint32 pollPeriod;          // Delay after the last regular poll, as suggested by the policy
+    bool repolling;             // Parent is polled again right away (see ZigbeeDevice::handlePollResponse())
+
 public:    
     PollTask();
 
-    void startPoll(int period);
+    void startPoll();
     void stopPoll();
+    void poll();
+
+    void setPollPeriods(uint32 fastPeriod, uint32 longPeriod);
+    void triggerFastPoll();
+    void startFastPoll(uint32 duration);
+    void stopFastPoll();
+    bool isFastPolling() const;
+    uint32 getFastPollUntil() const;
+    bool handlePollResult(PollResult result);
+    uint32 getTimeTillNextPoll() const;
+
+    const PollStatistics & getStatistics() const;
+    void dumpStatistics() const;
 
 protected:
+    void scheduleNextPoll();
+    void startPollTimer(uint32 delay);
     virtual void timerCallback();
 };
 
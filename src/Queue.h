@@ -51,6 +51,11 @@ public:
     {
         ZQ_bQueueSend(H::getHandle(), (uint8*)&val);
     }
+
+    uint32 count()
+    {
+        return ZQ_u32QueueGetQueueMessageWaiting(H::getHandle());
+    }
 };
 
 extern const tszQueue dummyQueue;
@@ -0,0 +1,211 @@
+#include "RejoinStrategy.h"
+
+RejoinStrategy::RejoinStrategy()
+{
+    for(uint8 i = 0; i < REJOIN_STAGE_COUNT; i++)
+        configureStage((RejoinStage)i, 0, 0);
+
+    configureStage(REJOIN_STAGE_TARGETED, DEFAULT_TARGETED_ATTEMPTS, DEFAULT_TARGETED_DELAY);
+    configureStage(REJOIN_STAGE_CHANNEL_SCAN, DEFAULT_CHANNEL_SCAN_ATTEMPTS, DEFAULT_CHANNEL_SCAN_DELAY);
+    configureStage(REJOIN_STAGE_TRUST_CENTER, DEFAULT_TRUST_CENTER_ATTEMPTS, DEFAULT_TRUST_CENTER_DELAY);
+    configureLimits(DEFAULT_MAX_DELAY, DEFAULT_JITTER_PERCENT);
+    setSeed(1);
+
+    stats.rejoins = 0;
+    stats.giveUps = 0;
+    stats.lastTimeToRejoin = 0;
+    stats.maxTimeToRejoin = 0;
+    for(uint8 i = 0; i < REJOIN_STAGE_COUNT; i++)
+    {
+        stats.attempts[i] = 0;
+        stats.successes[i] = 0;
+    }
+
+    lostTime = 0;
+    nextAttemptTime = 0;
+    reset();
+}
+
+void RejoinStrategy::configureStage(RejoinStage stageToConfigure, uint8 attempts, uint32 initialDelay)
+{
+    stages[stageToConfigure].attempts = attempts;
+    stages[stageToConfigure].initialDelay = initialDelay;
+}
+
+void RejoinStrategy::configureLimits(uint32 newMaxDelay, uint8 newJitterPercent)
+{
+    maxDelay = newMaxDelay;
+    jitterPercent = newJitterPercent > 100 ? 100 : newJitterPercent;
+}
+
+void RejoinStrategy::setSeed(uint32 seed)
+{
+    // Zero state would produce a poor sequence
+    randomState = seed ? seed : 1;
+}
+
+void RejoinStrategy::handleConnectionLost(uint32 now)
+{
+    // Connection loss reported while an attempt is running means this attempt has failed
+    if(attemptInProgress)
+    {
+        handleAttemptFailed(now);
+        return;
+    }
+
+    // Already waiting for the next attempt
+    if(isActive())
+        return;
+
+    stage = REJOIN_STAGE_IDLE;
+    advanceStage();
+    lostTime = now;
+
+    if(stage == REJOIN_STAGE_GAVE_UP)
+    {
+        stats.giveUps++;
+        return;
+    }
+
+    nextAttemptTime = now + getDelay();
+}
+
+bool RejoinStrategy::isAttemptDue(uint32 now) const
+{
+    return isActive() && !attemptInProgress && (int32)(now - nextAttemptTime) >= 0;
+}
+
+RejoinStage RejoinStrategy::startAttempt()
+{
+    if(!isActive())
+        return stage;
+
+    attemptInProgress = true;
+    attemptInStage++;
+    stats.attempts[stage]++;
+    return stage;
+}
+
+void RejoinStrategy::handleAttemptFailed(uint32 now)
+{
+    if(!isActive())
+        return;
+
+    attemptInProgress = false;
+
+    // Move to a more expensive stage when the current one is exhausted
+    if(attemptInStage >= stages[stage].attempts)
+        advanceStage();
+
+    if(stage == REJOIN_STAGE_GAVE_UP)
+    {
+        stats.giveUps++;
+        return;
+    }
+
+    nextAttemptTime = now + getDelay();
+}
+
+void RejoinStrategy::handleAttemptSucceeded(uint32 now)
+{
+    // Count only recoveries after the connection loss, rather than regular joins
+    if(isActive())
+    {
+        uint32 timeToRejoin = now - lostTime;
+        stats.successes[stage]++;
+        stats.rejoins++;
+        stats.lastTimeToRejoin = timeToRejoin;
+        if(timeToRejoin > stats.maxTimeToRejoin)
+            stats.maxTimeToRejoin = timeToRejoin;
+    }
+
+    reset();
+}
+
+void RejoinStrategy::reset()
+{
+    stage = REJOIN_STAGE_IDLE;
+    attemptInStage = 0;
+    attemptInProgress = false;
+}
+
+RejoinStage RejoinStrategy::getStage() const
+{
+    return stage;
+}
+
+bool RejoinStrategy::isActive() const
+{
+    return stage != REJOIN_STAGE_IDLE && stage != REJOIN_STAGE_GAVE_UP;
+}
+
+bool RejoinStrategy::isAttemptInProgress() const
+{
+    return attemptInProgress;
+}
+
+uint32 RejoinStrategy::getNextAttemptTime() const
+{
+    return nextAttemptTime;
+}
+
+uint32 RejoinStrategy::getTimeTillNextAttempt(uint32 now) const
+{
+    if(!isActive() || attemptInProgress)
+        return 0;
+
+    int32 delay = (int32)(nextAttemptTime - now);
+    return delay > 0 ? delay : 0;
+}
+
+const RejoinStatistics & RejoinStrategy::getStatistics() const
+{
+    return stats;
+}
+
+const char * RejoinStrategy::getStageName(RejoinStage stage)
+{
+    switch(stage)
+    {
+        case REJOIN_STAGE_IDLE:             return "Idle";
+        case REJOIN_STAGE_TARGETED:         return "Targeted";
+        case REJOIN_STAGE_CHANNEL_SCAN:     return "Channel scan";
+        case REJOIN_STAGE_TRUST_CENTER:     return "Trust center";
+        case REJOIN_STAGE_GAVE_UP:          return "Gave up";
+        default:                            return "Unknown";
+    }
+}
+
+uint32 RejoinStrategy::random()
+{
+    // Simple LCG is good enough to spread devices in time
+    randomState = randomState * 1103515245 + 12345;
+    return randomState >> 8;
+}
+
+uint32 RejoinStrategy::getDelay()
+{
+    // Exponential back-off within the stage: initialDelay, 2 * initialDelay, 4 * initialDelay, ...
+    uint32 delay = stages[stage].initialDelay;
+    for(uint8 i = 0; i < attemptInStage && delay < maxDelay; i++)
+        delay *= 2;
+
+    if(delay > maxDelay)
+        delay = maxDelay;
+
+    // Randomize the delay by +/- jitterPercent
+    uint32 span = delay / 100 * jitterPercent + (delay % 100) * jitterPercent / 100;
+    return delay - span + random() % (2 * span + 1);
+}
+
+void RejoinStrategy::advanceStage()
+{
+    // Skip stages that are configured with no attempts
+    do
+    {
+        stage = (RejoinStage)(stage + 1);
+    }
+    while(stage != REJOIN_STAGE_GAVE_UP && stages[stage].attempts == 0);
+
+    attemptInStage = 0;
+}
@@ -0,0 +1,98 @@
+#ifndef REJOINSTRATEGY_H
+#define REJOINSTRATEGY_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// Rejoin stages, from the cheapest to the most expensive one
+enum RejoinStage
+{
+    REJOIN_STAGE_IDLE,              // The device is on the network, no rejoin is needed
+    REJOIN_STAGE_TARGETED,          // Rejoin on the last known channel and PAN via the stored parent
+    REJOIN_STAGE_CHANNEL_SCAN,      // Rejoin with scanning all channels in the channel mask
+    REJOIN_STAGE_TRUST_CENTER,      // Full rejoin through the trust center
+    REJOIN_STAGE_GAVE_UP,           // All stages failed, the device shall leave the network
+
+    REJOIN_STAGE_COUNT
+};
+
+struct RejoinStatistics
+{
+    uint32 rejoins;                             // Number of successful network recoveries
+    uint32 giveUps;                             // Number of times all the stages were exhausted
+    uint32 lastTimeToRejoin;                    // ms, from the connection loss to the successful rejoin
+    uint32 maxTimeToRejoin;                     // ms
+    uint32 attempts[REJOIN_STAGE_COUNT];        // Rejoin attempts made on each stage
+    uint32 successes[REJOIN_STAGE_COUNT];       // Successful attempts on each stage
+};
+
+// Decides when and how the device shall try to get back to the network after losing connection.
+//
+// Each stage makes a few attempts with an exponentially growing delay between them. Each delay is randomized
+// with a per-device jitter, so that a lot of devices that lost the network at the same time (e.g. after the
+// coordinator restart) do not come back all at once.
+//
+// RejoinTask issues the rejoin request of the stage returned here, and reports back whether it succeeded.
+class RejoinStrategy
+{
+    struct StageConfig
+    {
+        uint8 attempts;
+        uint32 initialDelay;
+    };
+
+    StageConfig stages[REJOIN_STAGE_COUNT];
+    uint32 maxDelay;
+    uint8 jitterPercent;
+    uint32 randomState;
+
+    RejoinStage stage;
+    uint8 attemptInStage;
+    bool attemptInProgress;
+    uint32 lostTime;
+    uint32 nextAttemptTime;
+
+    RejoinStatistics stats;
+
+public:
+    static const uint8 DEFAULT_TARGETED_ATTEMPTS = 3;
+    static const uint32 DEFAULT_TARGETED_DELAY = 1000;
+    static const uint8 DEFAULT_CHANNEL_SCAN_ATTEMPTS = 3;
+    static const uint32 DEFAULT_CHANNEL_SCAN_DELAY = 10000;
+    static const uint8 DEFAULT_TRUST_CENTER_ATTEMPTS = 3;
+    static const uint32 DEFAULT_TRUST_CENTER_DELAY = 30000;
+    static const uint32 DEFAULT_MAX_DELAY = 300000;
+    static const uint8 DEFAULT_JITTER_PERCENT = 25;
+
+public:
+    RejoinStrategy();
+
+    void configureStage(RejoinStage stage, uint8 attempts, uint32 initialDelay);
+    void configureLimits(uint32 maxDelay, uint8 jitterPercent);
+    void setSeed(uint32 seed);
+
+    void handleConnectionLost(uint32 now);
+    bool isAttemptDue(uint32 now) const;
+    RejoinStage startAttempt();
+    void handleAttemptFailed(uint32 now);
+    void handleAttemptSucceeded(uint32 now);
+    void reset();
+
+    RejoinStage getStage() const;
+    bool isActive() const;
+    bool isAttemptInProgress() const;
+    uint32 getNextAttemptTime() const;
+    uint32 getTimeTillNextAttempt(uint32 now) const;
+    const RejoinStatistics & getStatistics() const;
+
+    static const char * getStageName(RejoinStage stage);
+
+private:
+    uint32 random();
+    uint32 getDelay();
+    void advanceStage();
+};
+
+#endif // REJOINSTRATEGY_H
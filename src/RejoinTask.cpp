@@ -0,0 +1,107 @@
+extern "C"
+{
+    #include "dbg.h"
+}
+
+#include "RejoinTask.h"
+#include "SystemClock.h"
+#include "ZigbeeDevice.h"
+
+RejoinTask::RejoinTask()
+{
+    // The timer is restarted manually with the delay suggested by the rejoin strategy
+    PeriodicTask::init(0);
+}
+
+void RejoinTask::setSeed(uint32 seed)
+{
+    strategy.setSeed(seed);
+}
+
+void RejoinTask::handleConnectionLost()
+{
+    // Either starts the rejoin procedure, or reports the current attempt failure
+    strategy.handleConnectionLost(SystemClock::getInstance()->getTimeMs());
+    scheduleNextAttempt();
+}
+
+void RejoinTask::handleAttemptSucceeded()
+{
+    strategy.handleAttemptSucceeded(SystemClock::getInstance()->getTimeMs());
+    stopTimer();
+}
+
+void RejoinTask::reset()
+{
+    strategy.reset();
+    stopTimer();
+}
+
+bool RejoinTask::isAttemptDue() const
+{
+    return strategy.isAttemptDue(SystemClock::getInstance()->getTimeMs());
+}
+
+RejoinStage RejoinTask::startAttempt()
+{
+    stopTimer();
+    return strategy.startAttempt();
+}
+
+RejoinStage RejoinTask::getStage() const
+{
+    return strategy.getStage();
+}
+
+bool RejoinTask::isActive() const
+{
+    return strategy.isActive();
+}
+
+bool RejoinTask::isAttemptInProgress() const
+{
+    return strategy.isAttemptInProgress();
+}
+
+uint32 RejoinTask::getTimeTillNextAttempt() const
+{
+    return strategy.getTimeTillNextAttempt(SystemClock::getInstance()->getTimeMs());
+}
+
+const RejoinStatistics & RejoinTask::getStatistics() const
+{
+    return strategy.getStatistics();
+}
+
+void RejoinTask::dumpStatistics() const
+{
+    const RejoinStatistics & stats = strategy.getStatistics();
+    DBG_vPrintf(TRUE, "\n+++++++ Rejoin statistics:\n");
+    DBG_vPrintf(TRUE, "    Successful rejoins: %d\n", stats.rejoins);
+    DBG_vPrintf(TRUE, "    Gave up: %d\n", stats.giveUps);
+    DBG_vPrintf(TRUE, "    Time to rejoin: last %d ms, max %d ms\n", stats.lastTimeToRejoin, stats.maxTimeToRejoin);
+    for(uint8 stage = REJOIN_STAGE_TARGETED; stage <= REJOIN_STAGE_TRUST_CENTER; stage++)
+        DBG_vPrintf(TRUE, "    %s: attempts %d, successes %d\n",
+                    RejoinStrategy::getStageName((RejoinStage)stage),
+                    stats.attempts[stage],
+                    stats.successes[stage]);
+    DBG_vPrintf(TRUE, "    Current stage: %s, next attempt in %d ms\n",
+                RejoinStrategy::getStageName(strategy.getStage()),
+                getTimeTillNextAttempt());
+}
+
+void RejoinTask::scheduleNextAttempt()
+{
+    stopTimer();
+
+    if(!strategy.isActive() || strategy.isAttemptInProgress())
+        return;
+
+    uint32 delay = getTimeTillNextAttempt();
+    startTimer(delay > 0 ? delay : 1);
+}
+
+void RejoinTask::timerCallback()
+{
+    ZigbeeDevice::getInstance()->rejoinIfDue();
+}
@@ -0,0 +1,36 @@
+#ifndef REJOINTASK_H
+#define REJOINTASK_H
+
+#include "PeriodicTask.h"
+#include "RejoinStrategy.h"
+
+class RejoinTask : public PeriodicTask
+{
+    RejoinStrategy strategy;
+
+public:
+    RejoinTask();
+
+    void setSeed(uint32 seed);
+
+    void handleConnectionLost();
+    void handleAttemptSucceeded();
+    void reset();
+
+    bool isAttemptDue() const;
+    RejoinStage startAttempt();
+
+    RejoinStage getStage() const;
+    bool isActive() const;
+    bool isAttemptInProgress() const;
+    uint32 getTimeTillNextAttempt() const;
+
+    const RejoinStatistics & getStatistics() const;
+    void dumpStatistics() const;
+
+protected:
+    void scheduleNextAttempt();
+    virtual void timerCallback();
+};
+
+#endif // REJOINTASK_H
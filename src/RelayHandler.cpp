@@ -1,9 +1,9 @@
 #include "RelayHandler.h"
 
-const uint8 PULSE_DURATION = 300 / 50; // 300 ms pulse duration / 50 ms per tick
-
 RelayHandler::RelayHandler()
 {
+    pendingState = false;
+    delayTicks = 0;
     remainingTicks = 0;
 }
 
@@ -13,19 +13,47 @@ void RelayHandler::init(uint32 onPinMask, uint32 offPinMask)
     onPin.off();
     offPin.init(offPinMask);
     offPin.off();
+    delayTicks = 0;
     remainingTicks = 0;
 }
 
-void RelayHandler::setState(bool state)
+void RelayHandler::setState(bool state, uint8 delay)
 {
-    onPin.setState(state);
-    offPin.setState(!state);
+    pendingState = state;
+    delayTicks = delay;
+
+    // Do not let the previous pulse run while waiting
+    if(delayTicks > 0)
+    {
+        onPin.off();
+        offPin.off();
+        remainingTicks = 0;
+    }
 
-    remainingTicks = PULSE_DURATION;
+    // Pulse is started by the update() call after the delay
+    if(delayTicks == 0)
+        startPulse();
+}
+
+void RelayHandler::startPulse()
+{
+    onPin.setState(pendingState);
+    offPin.setState(!pendingState);
+
+    remainingTicks = PULSE_DURATION_TICKS;
 }
 
 bool RelayHandler::update()
 {
+    if(delayTicks > 0)
+    {
+        delayTicks--;
+        if(delayTicks == 0)
+            startPulse();
+
+        return true;
+    }
+
     if(remainingTicks > 0)
     {
         remainingTicks--;
@@ -38,4 +66,3 @@ bool RelayHandler::update()
 
     return remainingTicks > 0;    
 }
-
@@ -12,14 +12,22 @@ class RelayHandler
 {
     GPIOOutput onPin;
     GPIOOutput offPin;
+    bool pendingState;
+    uint8 delayTicks;
     uint8 remainingTicks;
 
+public:
+    static const uint8 PULSE_DURATION_TICKS = 300 / 50; // 300 ms pulse duration / 50 ms per tick
+
 public:
     RelayHandler();
     void init(uint32 onPinMask, uint32 offPinMask);
-    void setState(bool state);
+    void setState(bool state, uint8 delay = 0);
 
     bool update();
+
+protected:
+    void startPulse();
 };
 
 #endif // RELAY_HANDLER_H
@@ -1,10 +1,19 @@
 #include "zcl_options.h"
 #include "zps_gen.h"
 #include "RelayTask.h"
+#include "SystemClock.h"
+
+extern "C"
+{
+    #include "dbg.h"
+}
+
+static const uint32 TICK_PERIOD = 50;
 
 RelayTask::RelayTask()
 {
-    PeriodicTask::init(50);
+    PeriodicTask::init(TICK_PERIOD);
+    switchStartTime = 0;
 
 #ifdef RELAY1_ON_MASK
     ch1.init(RELAY1_ON_MASK, RELAY1_OFF_MASK);
@@ -21,19 +30,31 @@ RelayTask * RelayTask::getInstance()
     return &instance;
 }
 
-void RelayTask::setState(uint8 ep, bool on)
+void RelayTask::setState(uint8 ep, bool on, uint32 delay)
 {
+    // Measure the time from the first request till all the relays are settled
+    if(!isTimerActive())
+        switchStartTime = SystemClock::getInstance()->getTimeMs();
+
+    // Delayed pulse starts on a timer tick
+    uint8 delayTicks = (delay + TICK_PERIOD - 1) / TICK_PERIOD;
+
 #ifdef RELAY1_ON_MASK
     if(ep == SWITCH1_ENDPOINT)
-        ch1.setState(on);
+        ch1.setState(on, delayTicks);
 #endif
 
 #ifdef RELAY2_ON_MASK
     if(ep == SWITCH2_ENDPOINT)
-        ch2.setState(on);
+        ch2.setState(on, delayTicks);
 #endif
 
-    startTimer(50);
+    startTimer(TICK_PERIOD);
+}
+
+uint32 RelayTask::getPulseDuration() const
+{
+    return RelayHandler::PULSE_DURATION_TICKS * TICK_PERIOD;
 }
 
 void RelayTask::timerCallback()
@@ -48,10 +69,18 @@ void RelayTask::timerCallback()
 #endif
 
     if(!pulseInProgress)
+    {
+        DBG_vPrintf(TRUE, "RelayTask: relays settled in %d ms\n", SystemClock::getInstance()->getTimeMs() - switchStartTime);
         stopTimer();
+    }
 }
 
 bool RelayTask::canSleep()
 {
     return !isTimerActive();
+}
+
+SleepVetoReason RelayTask::getSleepVeto(uint32 * earliestSleepTime)
+{
+    return canSleep() ? SLEEP_VETO_NONE : SLEEP_VETO_RELAY_PULSE;
 }
\ No newline at end of file
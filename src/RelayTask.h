@@ -2,12 +2,14 @@
 #define RELAY_TASK_H
 
 #include "PeriodicTask.h"
+#include "ISleepParticipant.h"
 #include "RelayHandler.h"
 
-class RelayTask : public PeriodicTask
+class RelayTask : public PeriodicTask, public ISleepParticipant
 {
     RelayHandler ch1;
     RelayHandler ch2;
+    uint32 switchStartTime;
 
 private:
     RelayTask();
@@ -15,8 +17,10 @@ private:
 public:
     static RelayTask * getInstance();
 
-    void setState(uint8 ep, bool on);
+    void setState(uint8 ep, bool on, uint32 delay = 0);
+    uint32 getPulseDuration() const;
     bool canSleep();
+    virtual SleepVetoReason getSleepVeto(uint32 * earliestSleepTime);
 
 protected:
     virtual void timerCallback();    
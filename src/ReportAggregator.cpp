@@ -0,0 +1,162 @@
+extern "C"
+{
+    #include "jendefs.h"
+    #include "dbg.h"
+    #include "zcl_customcommand.h"
+    #include "zps_apl_af.h"
+}
+
+#include "ReportAggregator.h"
+#include "DeliveryTracker.h"
+#include "DiagnosticsCollector.h"
+#include "ZigbeeDevice.h"
+
+ReportAggregator::ReportAggregator()
+{
+}
+
+ReportAggregator * ReportAggregator::getInstance()
+{
+    static ReportAggregator instance;
+    return &instance;
+}
+
+teZCL_Status ReportAggregator::markDirty(uint8 endpoint, uint16 clusterId, uint16 attributeId)
+{
+    // Make room for the new record by sending what has been collected so far
+    if(batch.isFull() && !batch.contains(endpoint, clusterId, attributeId))
+        flush();
+
+    if(batch.add(endpoint, clusterId, attributeId))
+        return E_ZCL_SUCCESS;
+
+    // Can happen only while the device is off the network, and there are too many changed attributes
+    DeliveryTracker::getInstance()->handleReportDropped();
+    return E_ZCL_ERR_INSUFFICIENT_SPACE;
+}
+
+void ReportAggregator::flushAttribute(uint8 endpoint, uint16 clusterId, uint16 attributeId)
+{
+    // Send the pending value right away (e.g. before it is overwritten with a new one)
+    if(!batch.contains(endpoint, clusterId, attributeId) || !ZigbeeDevice::getInstance()->isJoined())
+        return;
+
+    ReportRecord frame[MAX_RECORDS_PER_FRAME];
+    uint8 numRecords;
+    while((numRecords = batch.takeFrame(endpoint, clusterId, frame, MAX_RECORDS_PER_FRAME)) != 0)
+        sendFrame(frame, numRecords);
+}
+
+void ReportAggregator::flush()
+{
+    // Changed attributes are kept in the batch till the device gets back to the network
+    if(!ZigbeeDevice::getInstance()->isJoined())
+        return;
+
+    ReportRecord frame[MAX_RECORDS_PER_FRAME];
+    uint8 numRecords;
+    while((numRecords = batch.takeNextFrame(frame, MAX_RECORDS_PER_FRAME)) != 0)
+        sendFrame(frame, numRecords);
+}
+
+const ReportStatistics & ReportAggregator::getStatistics() const
+{
+    return batch.getStatistics();
+}
+
+void ReportAggregator::dumpStatistics() const
+{
+    const ReportStatistics & stats = batch.getStatistics();
+    DBG_vPrintf(TRUE, "\n+++++++ Attribute reporting statistics:\n");
+    DBG_vPrintf(TRUE, "    Reports requested: %d\n", stats.requests);
+    DBG_vPrintf(TRUE, "    Frames sent: %d\n", stats.framesSent);
+    DBG_vPrintf(TRUE, "    Frames saved: %d\n", stats.framesSaved);
+}
+
+void ReportAggregator::sendFrame(const ReportRecord * frame, uint8 numRecords)
+{
+    uint8 endpoint = frame[0].endpoint;
+    uint16 clusterId = frame[0].clusterId;
+
+    tsZCL_ClusterInstance * psClusterInstance;
+    if(eZCL_SearchForClusterEntry(endpoint, clusterId, TRUE, &psClusterInstance) != E_ZCL_SUCCESS)
+    {
+        DBG_vPrintf(TRUE, "ReportAggregator: No server cluster %04x on EP=%d\n", clusterId, endpoint);
+        return;
+    }
+
+    PDUM_thAPduInstance hAPduInst = hZCL_AllocateAPduInstance();
+    if(hAPduInst == PDUM_INVALID_HANDLE)
+    {
+        DBG_vPrintf(TRUE, "ReportAggregator: Cannot allocate APDU for the report\n");
+        DiagnosticsCollector::getInstance()->handleBufferAllocFailure();
+        return;
+    }
+
+    // Report Attributes frame header, server to client
+    tsZCL_ClusterDefinition * psClusterDefinition = psClusterInstance->psClusterDefinition;
+    uint16 pos = u16ZCL_WriteCommandHeader(hAPduInst,
+                                           eFRAME_TYPE_COMMAND_ACTS_ACCROSS_ENTIRE_PROFILE,
+                                           psClusterDefinition->bIsManufacturerSpecificCluster,
+                                           ZCL_MANUFACTURER_CODE,
+                                           TRUE,
+                                           TRUE,
+                                           u8GetTransactionSequenceNumber(),
+                                           E_ZCL_REPORT_ATTRIBUTES);
+
+    // Attribute records: id, type, value
+    uint8 numWritten = 0;
+    for(uint8 i = 0; i < numRecords; i++)
+    {
+        tsZCL_AttributeDefinition * psAttributeDefinition = NULL;
+        for(uint16 j = 0; j < psClusterDefinition->u16NumberOfAttributes; j++)
+        {
+            if(psClusterDefinition->psAttributeDefinition[j].u16AttributeEnum == frame[i].attributeId)
+            {
+                psAttributeDefinition = &psClusterDefinition->psAttributeDefinition[j];
+                break;
+            }
+        }
+
+        if(!psAttributeDefinition)
+        {
+            DBG_vPrintf(TRUE, "ReportAggregator: No attribute %04x in cluster %04x\n", frame[i].attributeId, clusterId);
+            continue;
+        }
+
+        uint16 attributeId = psAttributeDefinition->u16AttributeEnum;
+        uint8 attributeType = psAttributeDefinition->eAttributeDataType;
+        void * pvValue = (uint8*)psClusterInstance->pvEndPointSharedStructPtr + psAttributeDefinition->u16OffsetFromStructBase;
+
+        pos += u16ZCL_APduInstanceWriteNBO(hAPduInst, pos, E_ZCL_ATTRIBUTE_ID, &attributeId);
+        pos += u16ZCL_APduInstanceWriteNBO(hAPduInst, pos, E_ZCL_UINT8, &attributeType);
+        pos += u16ZCL_APduInstanceWriteNBO(hAPduInst, pos, psAttributeDefinition->eAttributeDataType, pvValue);
+        numWritten++;
+    }
+
+    if(numWritten == 0)
+    {
+        PDUM_eAPduFreeAPduInstance(hAPduInst);
+        return;
+    }
+
+    // Send to the coordinator (0x0000) with the APS ack requested. Unlike eZCL_TransmitDataRequest() this gives
+    // the APS sequence number, so that the delivery can be tracked. The APDU is released by the stack, unless the
+    // request fails.
+    uint8 apsSeq;
+    PDUM_eAPduInstanceSetPayloadSize(hAPduInst, pos);
+    ZPS_teStatus status = ZPS_eAplAfUnicastAckDataReq(hAPduInst, clusterId, endpoint, 1, 0x0000,
+                                                      ZPS_E_APL_AF_SECURE_NWK, 0, &apsSeq);
+    DBG_vPrintf(TRUE, "ReportAggregator: Sent %d attribute(s) of cluster %04x for EP=%d. Status=%02x\n",
+                numWritten, clusterId, endpoint, status);
+
+    if(status != ZPS_E_SUCCESS)
+    {
+        PDUM_eAPduFreeAPduInstance(hAPduInst);
+        DeliveryTracker::getInstance()->handleReportDropped();
+        return;
+    }
+
+    batch.handleFrameSent(frame, numRecords);
+    DeliveryTracker::getInstance()->trackReport(frame, numRecords, apsSeq);
+}
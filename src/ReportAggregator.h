@@ -0,0 +1,42 @@
+#ifndef REPORTAGGREGATOR_H
+#define REPORTAGGREGATOR_H
+
+extern "C"
+{
+    #include "jendefs.h"
+    #include "zcl.h"
+}
+
+#include "ReportBatch.h"
+
+// Sends attribute reports to the coordinator.
+//
+// Instead of sending a separate frame for each changed attribute, endpoints just mark attributes as dirty. At the
+// end of the main loop iteration all dirty attributes are reported with one Report Attributes frame per endpoint
+// and cluster. A Report Attributes frame cannot carry several clusters (the cluster id is in the APS header), so
+// the savings come from clusters that change several attributes at once (e.g. Diagnostics counters), and from
+// repeated changes of the same attribute.
+class ReportAggregator
+{
+    static const uint8 MAX_RECORDS_PER_FRAME = 8;
+
+    ReportBatch batch;
+
+private:
+    ReportAggregator();
+
+public:
+    static ReportAggregator * getInstance();
+
+    teZCL_Status markDirty(uint8 endpoint, uint16 clusterId, uint16 attributeId);
+    void flushAttribute(uint8 endpoint, uint16 clusterId, uint16 attributeId);
+    void flush();
+
+    const ReportStatistics & getStatistics() const;
+    void dumpStatistics() const;
+
+protected:
+    void sendFrame(const ReportRecord * frame, uint8 numRecords);
+};
+
+#endif // REPORTAGGREGATOR_H
@@ -0,0 +1,100 @@
+#include "ReportBatch.h"
+
+ReportBatch::ReportBatch()
+{
+    numRecords = 0;
+
+    stats.requests = 0;
+    stats.framesSent = 0;
+    stats.framesSaved = 0;
+}
+
+bool ReportBatch::add(uint8 endpoint, uint16 clusterId, uint16 attributeId)
+{
+    int idx = findRecord(endpoint, clusterId, attributeId);
+    if(idx >= 0)
+    {
+        stats.requests++;
+        if(records[idx].requests < 0xff)
+            records[idx].requests++;
+        return true;
+    }
+
+    if(isFull())
+        return false;
+
+    stats.requests++;
+    records[numRecords].endpoint = endpoint;
+    records[numRecords].clusterId = clusterId;
+    records[numRecords].attributeId = attributeId;
+    records[numRecords].requests = 1;
+    numRecords++;
+    return true;
+}
+
+bool ReportBatch::contains(uint8 endpoint, uint16 clusterId, uint16 attributeId) const
+{
+    return findRecord(endpoint, clusterId, attributeId) >= 0;
+}
+
+bool ReportBatch::isEmpty() const
+{
+    return numRecords == 0;
+}
+
+bool ReportBatch::isFull() const
+{
+    return numRecords >= MAX_RECORDS;
+}
+
+uint8 ReportBatch::takeFrame(uint8 endpoint, uint16 clusterId, ReportRecord * frame, uint8 maxRecords)
+{
+    // Move records of the requested endpoint and cluster to the frame, keeping the order of the others
+    uint8 taken = 0;
+    uint8 kept = 0;
+    for(uint8 i = 0; i < numRecords; i++)
+    {
+        if(taken < maxRecords && records[i].endpoint == endpoint && records[i].clusterId == clusterId)
+            frame[taken++] = records[i];
+        else
+            records[kept++] = records[i];
+    }
+
+    numRecords = kept;
+    return taken;
+}
+
+uint8 ReportBatch::takeNextFrame(ReportRecord * frame, uint8 maxRecords)
+{
+    if(isEmpty())
+        return 0;
+
+    return takeFrame(records[0].endpoint, records[0].clusterId, frame, maxRecords);
+}
+
+void ReportBatch::handleFrameSent(const ReportRecord * frame, uint8 numFrameRecords)
+{
+    if(numFrameRecords == 0)
+        return;
+
+    uint32 requests = 0;
+    for(uint8 i = 0; i < numFrameRecords; i++)
+        requests += frame[i].requests;
+
+    stats.framesSent++;
+    stats.framesSaved += requests - 1;
+}
+
+const ReportStatistics & ReportBatch::getStatistics() const
+{
+    return stats;
+}
+
+int ReportBatch::findRecord(uint8 endpoint, uint16 clusterId, uint16 attributeId) const
+{
+    for(uint8 i = 0; i < numRecords; i++)
+        if(records[i].endpoint == endpoint && records[i].clusterId == clusterId && records[i].attributeId == attributeId)
+            return i;
+
+    return -1;
+}
@@ -0,0 +1,60 @@
+#ifndef REPORTBATCH_H
+#define REPORTBATCH_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// Attribute that changed and has to be reported
+struct ReportRecord
+{
+    uint8 endpoint;
+    uint16 clusterId;
+    uint16 attributeId;
+    uint8 requests;         // Number of report requests coalesced into this record
+};
+
+struct ReportStatistics
+{
+    uint32 requests;        // Attribute reports requested by the application
+    uint32 framesSent;      // Report Attributes frames actually sent
+    uint32 framesSaved;     // Frames that would have been sent with one report per request
+};
+
+// Collects attributes that need reporting, so that all changes of a cluster made during a single main loop
+// iteration are reported in one Report Attributes frame with multiple records.
+//
+// Repeated requests for the same attribute are merged (the latest attribute value is reported).
+//
+// The class does not depend on the Zigbee stack.
+class ReportBatch
+{
+public:
+    static const uint8 MAX_RECORDS = 16;
+
+private:
+    ReportRecord records[MAX_RECORDS];
+    uint8 numRecords;
+
+    ReportStatistics stats;
+
+public:
+    ReportBatch();
+
+    bool add(uint8 endpoint, uint16 clusterId, uint16 attributeId);
+    bool contains(uint8 endpoint, uint16 clusterId, uint16 attributeId) const;
+    bool isEmpty() const;
+    bool isFull() const;
+
+    uint8 takeFrame(uint8 endpoint, uint16 clusterId, ReportRecord * frame, uint8 maxRecords);
+    uint8 takeNextFrame(ReportRecord * frame, uint8 maxRecords);
+    void handleFrameSent(const ReportRecord * frame, uint8 numFrameRecords);
+
+    const ReportStatistics & getStatistics() const;
+
+private:
+    int findRecord(uint8 endpoint, uint16 clusterId, uint16 attributeId) const;
+};
+
+#endif // REPORTBATCH_H
@@ -0,0 +1,458 @@
+#include <string.h>
+
+extern "C"
+{
+    #include "jendefs.h"
+    #include "dbg.h"
+    #include "PDM.h"
+}
+
+#include "ReportManager.h"
+#include "ReportAggregator.h"
+#include "SystemClock.h"
+#include "PdmIds.h"
+#include "DiagnosticsCollector.h"
+
+// Configuration direction field of the Configure Reporting and Read Reporting Configuration records
+static const uint8 DIRECTION_REPORTED = 0x00;   // Reports sent by this device
+static const uint8 DIRECTION_RECEIVED = 0x01;   // Reports received by this device
+
+ReportManager::ReportManager()
+{
+    configChanged = false;
+    reportsSent = 0;
+}
+
+ReportManager * ReportManager::getInstance()
+{
+    static ReportManager instance;
+    return &instance;
+}
+
+bool ReportManager::configureReport(uint8 endpoint, uint16 clusterId, uint16 attributeId,
+                                    uint16 minInterval, uint16 maxInterval, uint32 reportableChange)
+{
+    DBG_vPrintf(TRUE, "ReportManager: Configure EP=%d Cluster=%04x Attr=%04x: min=%d max=%d change=%d\n",
+                endpoint, clusterId, attributeId, minInterval, maxInterval, reportableChange);
+
+    if(!scheduler.configure(endpoint, clusterId, attributeId, minInterval, maxInterval, reportableChange,
+                            SystemClock::getInstance()->getTimeMs()))
+    {
+        DBG_vPrintf(TRUE, "ReportManager: Warning: No space for new reporting configuration\n");
+        return false;
+    }
+
+    configChanged = true;
+    return true;
+}
+
+void ReportManager::restore()
+{
+    uint16 readBytes = 0;
+    PDM_teStatus status = PDM_eReadDataFromRecord(PDM_ID_REPORTING_CONFIG, pdmBuffer, sizeof(pdmBuffer), &readBytes);
+    if(status != PDM_E_STATUS_OK)
+    {
+        DBG_vPrintf(TRUE, "ReportManager: No reporting configuration in PDM. status=%d\n", status);
+        return;
+    }
+
+    // Restoring is not a change, but a legacy configuration merged in before is
+    bool changed = configChanged;
+    uint8 count = readBytes / sizeof(ReportConfig);
+    for(uint8 i = 0; i < count; i++)
+    {
+        const ReportConfig & config = pdmBuffer[i];
+        configureReport(config.endpoint, config.clusterId, config.attributeId,
+                        config.minInterval, config.maxInterval, config.reportableChange);
+    }
+    configChanged = changed;
+
+    DBG_vPrintf(TRUE, "ReportManager: Restored %d reporting configuration(s)\n", count);
+}
+
+void ReportManager::save()
+{
+    uint8 count = scheduler.getConfigurations(pdmBuffer, MAX_REPORTS);
+    DBG_vPrintf(TRUE, "ReportManager: Save %d reporting configuration(s)\n", count);
+
+    if(count == 0)
+        PDM_vDeleteDataRecord(PDM_ID_REPORTING_CONFIG);
+    else
+        PDM_eSaveRecordData(PDM_ID_REPORTING_CONFIG, pdmBuffer, count * sizeof(ReportConfig));
+
+    configChanged = false;
+}
+
+bool ReportManager::handleDataIndication(ZPS_tsAfEvent * pEvent)
+{
+    // Returns true if the frame is a reporting configuration command that has been handled here, and shall not be
+    // passed to ZCL
+    ZPS_tsAfDataIndEvent * pInd = &pEvent->uEvent.sApsDataIndEvent;
+    if(pInd->eStatus != ZPS_E_SUCCESS)
+        return false;
+
+    tsZCL_HeaderParams header;
+    uint16 pos = u16ZCL_ReadCommandHeader(pInd->hAPduInst, &header);
+    if(header.eFrameType != eFRAME_TYPE_COMMAND_ACTS_ACCROSS_ENTIRE_PROFILE || header.bDirection)
+        return false;
+
+    if(header.u8CommandIdentifier != E_ZCL_CONFIGURE_REPORTING &&
+       header.u8CommandIdentifier != E_ZCL_READ_REPORTING_CONFIGURATION)
+        return false;
+
+    // Clusters this device does not serve are left to ZCL, it knows how to reject them
+    tsZCL_ClusterInstance * psClusterInstance;
+    if(eZCL_SearchForClusterEntry(pInd->u8DstEndpoint, pInd->u16ClusterId, TRUE, &psClusterInstance) != E_ZCL_SUCCESS)
+        return false;
+
+    if(header.u8CommandIdentifier == E_ZCL_CONFIGURE_REPORTING)
+        handleConfigureReporting(pInd, &header, pos, psClusterInstance);
+    else
+        handleReadReportingConfiguration(pInd, &header, pos, psClusterInstance);
+
+    return true;
+}
+
+void ReportManager::handleConfigureReporting(ZPS_tsAfDataIndEvent * pInd, const tsZCL_HeaderParams * header, uint16 pos,
+                                             tsZCL_ClusterInstance * psClusterInstance)
+{
+    PDUM_thAPduInstance hRequest = pInd->hAPduInst;
+    uint16 size = PDUM_u16APduInstanceGetPayloadSize(hRequest);
+
+    PDUM_thAPduInstance hResponse = hZCL_AllocateAPduInstance();
+    if(hResponse == PDUM_INVALID_HANDLE)
+    {
+        DBG_vPrintf(TRUE, "ReportManager: Cannot allocate APDU for the response\n");
+        DiagnosticsCollector::getInstance()->handleBufferAllocFailure();
+    }
+
+    // Response lists the failed records only, or a single success status if there are none
+    uint16 responsePos = 0;
+    uint16 headerSize = 0;
+    if(hResponse != PDUM_INVALID_HANDLE)
+    {
+        headerSize = u16ZCL_WriteCommandHeader(hResponse,
+                                               eFRAME_TYPE_COMMAND_ACTS_ACCROSS_ENTIRE_PROFILE,
+                                               header->bManufacturerSpecific,
+                                               header->u16ManufacturerCode,
+                                               TRUE,
+                                               TRUE,
+                                               header->u8TransactionSequenceNumber,
+                                               E_ZCL_CONFIGURE_REPORTING_RESPONSE);
+        responsePos = headerSize;
+    }
+
+    while(pos + sizeof(uint8) + sizeof(uint16) <= size)
+    {
+        uint8 direction;
+        uint16 attributeId;
+        pos += u16ZCL_APduInstanceReadNBO(hRequest, pos, E_ZCL_UINT8, &direction);
+        pos += u16ZCL_APduInstanceReadNBO(hRequest, pos, E_ZCL_ATTRIBUTE_ID, &attributeId);
+
+        uint8 status = E_ZCL_CMDS_SUCCESS;
+        if(direction == DIRECTION_REPORTED)
+        {
+            tsZCL_AttributeReportingConfigurationRecord record;
+            if(pos + sizeof(uint8) + 2 * sizeof(uint16) > size)
+                break;
+
+            uint8 dataType;
+            pos += u16ZCL_APduInstanceReadNBO(hRequest, pos, E_ZCL_UINT8, &dataType);
+            pos += u16ZCL_APduInstanceReadNBO(hRequest, pos, E_ZCL_UINT16, &record.u16MinimumReportingInterval);
+            pos += u16ZCL_APduInstanceReadNBO(hRequest, pos, E_ZCL_UINT16, &record.u16MaximumReportingInterval);
+
+            // Reportable change is present for analog data types only
+            uint8 changeSize = getAnalogSize(dataType);
+            if(pos + changeSize > size)
+                break;
+
+            memset(&record.uAttributeReportableChange, 0, sizeof(record.uAttributeReportableChange));
+            if(changeSize != 0)
+                pos += u16ZCL_APduInstanceReadNBO(hRequest, pos, (teZCL_ZCLAttributeType)dataType, &record.uAttributeReportableChange);
+            record.eAttributeDataType = (teZCL_ZCLAttributeType)dataType;
+            record.u16AttributeEnum = attributeId;
+
+            tsZCL_AttributeDefinition * psAttributeDefinition = findAttribute(psClusterInstance, attributeId, header->bManufacturerSpecific);
+            if(!psAttributeDefinition)
+                status = E_ZCL_CMDS_UNSUPPORTED_ATTRIBUTE;
+            else if((psAttributeDefinition->u8AttributeFlags & E_ZCL_AF_RP) == 0)
+                status = E_ZCL_CMDS_UNREPORTABLE_ATTRIBUTE;
+            else if(psAttributeDefinition->eAttributeDataType != dataType)
+                status = E_ZCL_CMDS_INVALID_DATA_TYPE;
+            else if(record.u16MaximumReportingInterval != REPORT_INTERVAL_NO_PERIODIC &&
+                    record.u16MaximumReportingInterval != REPORT_INTERVAL_TURNED_OFF &&
+                    record.u16MinimumReportingInterval > record.u16MaximumReportingInterval)
+                status = E_ZCL_CMDS_INVALID_VALUE;
+            else if(!configureReport(pInd->u8DstEndpoint, pInd->u16ClusterId, attributeId,
+                                     record.u16MinimumReportingInterval, record.u16MaximumReportingInterval,
+                                     getReportableChange(&record)))
+                status = E_ZCL_CMDS_INSUFFICIENT_SPACE;
+        }
+        else
+        {
+            // This device does not receive reports, the timeout period is skipped
+            if(pos + sizeof(uint16) > size)
+                break;
+
+            pos += sizeof(uint16);
+            status = E_ZCL_CMDS_UNSUPPORTED_ATTRIBUTE;
+        }
+
+        if(status != E_ZCL_CMDS_SUCCESS && hResponse != PDUM_INVALID_HANDLE)
+        {
+            responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, E_ZCL_UINT8, &status);
+            responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, E_ZCL_UINT8, &direction);
+            responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, E_ZCL_ATTRIBUTE_ID, &attributeId);
+        }
+    }
+
+    if(hResponse == PDUM_INVALID_HANDLE)
+        return;
+
+    if(responsePos == headerSize)
+    {
+        uint8 status = E_ZCL_CMDS_SUCCESS;
+        responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, E_ZCL_UINT8, &status);
+    }
+
+    sendResponse(pInd, hResponse, responsePos);
+}
+
+void ReportManager::handleReadReportingConfiguration(ZPS_tsAfDataIndEvent * pInd, const tsZCL_HeaderParams * header, uint16 pos,
+                                                     tsZCL_ClusterInstance * psClusterInstance)
+{
+    PDUM_thAPduInstance hRequest = pInd->hAPduInst;
+    uint16 size = PDUM_u16APduInstanceGetPayloadSize(hRequest);
+
+    PDUM_thAPduInstance hResponse = hZCL_AllocateAPduInstance();
+    if(hResponse == PDUM_INVALID_HANDLE)
+    {
+        DBG_vPrintf(TRUE, "ReportManager: Cannot allocate APDU for the response\n");
+        DiagnosticsCollector::getInstance()->handleBufferAllocFailure();
+        return;
+    }
+
+    uint16 responsePos = u16ZCL_WriteCommandHeader(hResponse,
+                                                   eFRAME_TYPE_COMMAND_ACTS_ACCROSS_ENTIRE_PROFILE,
+                                                   header->bManufacturerSpecific,
+                                                   header->u16ManufacturerCode,
+                                                   TRUE,
+                                                   TRUE,
+                                                   header->u8TransactionSequenceNumber,
+                                                   E_ZCL_READ_REPORTING_CONFIGURATION_RESPONSE);
+
+    // The configuration is answered from the scheduler, ZCL knows nothing about it
+    while(pos + sizeof(uint8) + sizeof(uint16) <= size)
+    {
+        uint8 direction;
+        uint16 attributeId;
+        pos += u16ZCL_APduInstanceReadNBO(hRequest, pos, E_ZCL_UINT8, &direction);
+        pos += u16ZCL_APduInstanceReadNBO(hRequest, pos, E_ZCL_ATTRIBUTE_ID, &attributeId);
+
+        const ScheduledReport * report = NULL;
+        tsZCL_AttributeDefinition * psAttributeDefinition = findAttribute(psClusterInstance, attributeId, header->bManufacturerSpecific);
+        uint8 status = E_ZCL_CMDS_SUCCESS;
+        if(!psAttributeDefinition)
+            status = E_ZCL_CMDS_UNSUPPORTED_ATTRIBUTE;
+        else if((psAttributeDefinition->u8AttributeFlags & E_ZCL_AF_RP) == 0)
+            status = E_ZCL_CMDS_UNREPORTABLE_ATTRIBUTE;
+        else if(direction != DIRECTION_REPORTED)
+            status = E_ZCL_CMDS_NOT_FOUND;
+        else
+        {
+            report = scheduler.getReport(pInd->u8DstEndpoint, pInd->u16ClusterId, attributeId);
+            if(!report)
+                status = E_ZCL_CMDS_NOT_FOUND;
+        }
+
+        responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, E_ZCL_UINT8, &status);
+        responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, E_ZCL_UINT8, &direction);
+        responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, E_ZCL_ATTRIBUTE_ID, &attributeId);
+        if(!report)
+            continue;
+
+        uint8 dataType = psAttributeDefinition->eAttributeDataType;
+        uint16 minInterval = report->minInterval;
+        uint16 maxInterval = report->maxInterval;
+        responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, E_ZCL_UINT8, &dataType);
+        responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, E_ZCL_UINT16, &minInterval);
+        responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, E_ZCL_UINT16, &maxInterval);
+
+        if(getAnalogSize(dataType) != 0)
+        {
+            tuZCL_AttributeReportable change;
+            setReportableChange(&change, dataType, report->reportableChange);
+            responsePos += u16ZCL_APduInstanceWriteNBO(hResponse, responsePos, (teZCL_ZCLAttributeType)dataType, &change);
+        }
+    }
+
+    sendResponse(pInd, hResponse, responsePos);
+}
+
+void ReportManager::sendResponse(ZPS_tsAfDataIndEvent * pInd, PDUM_thAPduInstance hAPduInst, uint16 size)
+{
+    // Group addressed commands are applied, but not answered
+    if(pInd->u8DstAddrMode != ZPS_E_ADDR_MODE_SHORT)
+    {
+        PDUM_eAPduFreeAPduInstance(hAPduInst);
+        return;
+    }
+
+    tsZCL_Address addr;
+    addr.eAddressMode = E_ZCL_AM_SHORT;
+    addr.uAddress.u16DestinationAddress = pInd->uSrcAddress.u16Addr;
+
+    // The APDU is released by the stack once transmitted
+    teZCL_Status status = eZCL_TransmitDataRequest(hAPduInst, size, pInd->u8DstEndpoint, pInd->u8SrcEndpoint,
+                                                   pInd->u16ClusterId, &addr);
+    if(status != E_ZCL_SUCCESS)
+        DBG_vPrintf(TRUE, "ReportManager: Failed to send the response. Status=%d\n", status);
+}
+
+teZCL_Status ReportManager::reportChange(uint8 endpoint, uint16 clusterId, uint16 attributeId)
+{
+    // Attributes without the reporting configuration are reported right away, others obey the min interval
+    if(!scheduler.handleChange(endpoint, clusterId, attributeId, SystemClock::getInstance()->getTimeMs()))
+        return E_ZCL_SUCCESS;
+
+    reportsSent++;
+    return ReportAggregator::getInstance()->markDirty(endpoint, clusterId, attributeId);
+}
+
+teZCL_Status ReportManager::reportValueChange(uint8 endpoint, uint16 clusterId, uint16 attributeId, int32 value)
+{
+    // Changes smaller than the reportable change are not reported
+    if(!scheduler.handleValueChange(endpoint, clusterId, attributeId, value, SystemClock::getInstance()->getTimeMs()))
+        return E_ZCL_SUCCESS;
+
+    reportsSent++;
+    return ReportAggregator::getInstance()->markDirty(endpoint, clusterId, attributeId);
+}
+
+void ReportManager::handleAttributeWrite(uint8 endpoint, uint16 clusterId, uint16 attributeId)
+{
+    // Written attributes are reported only if somebody asked for that
+    if(scheduler.isConfigured(endpoint, clusterId, attributeId))
+        reportChange(endpoint, clusterId, attributeId);
+}
+
+bool ReportManager::isReportConfigured(uint8 endpoint, uint16 clusterId, uint16 attributeId) const
+{
+    return scheduler.isConfigured(endpoint, clusterId, attributeId);
+}
+
+void ReportManager::flush()
+{
+    // Configuration commands may carry several records, they are saved at once
+    if(configChanged)
+        save();
+
+    // Nothing is due most of the time, and this is just a single comparison
+    uint32 now = SystemClock::getInstance()->getTimeMs();
+    if(scheduler.getTimeTillNextReport(now) != 1)
+        return;
+
+    ReportRecord records[MAX_REPORTS];
+    uint8 numRecords = scheduler.takeDueReports(now, records, MAX_REPORTS);
+    for(uint8 i = 0; i < numRecords; i++)
+        ReportAggregator::getInstance()->markDirty(records[i].endpoint, records[i].clusterId, records[i].attributeId);
+
+    reportsSent += numRecords;
+}
+
+uint32 ReportManager::getTimeTillNextReport() const
+{
+    // Zero means there is nothing scheduled
+    return scheduler.getTimeTillNextReport(SystemClock::getInstance()->getTimeMs());
+}
+
+ReportManagerStatistics ReportManager::getStatistics() const
+{
+    ReportManagerStatistics stats;
+    stats.configured = scheduler.getNumReports();
+    stats.reportsSent = reportsSent;
+    return stats;
+}
+
+void ReportManager::dumpStatistics() const
+{
+    const ReportSchedulerStatistics & stats = scheduler.getStatistics();
+    DBG_vPrintf(TRUE, "\n+++++++ Report scheduler statistics:\n");
+    DBG_vPrintf(TRUE, "    Reports configured: %d of %d\n", scheduler.getNumReports(), MAX_REPORTS);
+    DBG_vPrintf(TRUE, "    Reports sent: %d\n", reportsSent);
+    DBG_vPrintf(TRUE, "    Change reports: %d\n", stats.changeReports);
+    DBG_vPrintf(TRUE, "    Periodic reports: %d\n", stats.periodicReports);
+    DBG_vPrintf(TRUE, "    Changes waiting for min interval: %d\n", stats.deferredChanges);
+    DBG_vPrintf(TRUE, "    Changes below reportable change: %d\n", stats.ignoredChanges);
+    DBG_vPrintf(TRUE, "    Heap steps: %d\n", stats.heapSteps);
+    DBG_vPrintf(TRUE, "    Next report in: %d ms\n", getTimeTillNextReport());
+}
+
+uint32 ReportManager::getReportableChange(const tsZCL_AttributeReportingConfigurationRecord * record)
+{
+    // Reportable change makes sense for analog data types only. Discrete ones are reported on any change.
+    const tuZCL_AttributeReportable & change = record->uAttributeReportableChange;
+    switch(record->eAttributeDataType)
+    {
+        case E_ZCL_UINT8:   return change.zuint8ReportableChange;
+        case E_ZCL_UINT16:  return change.zuint16ReportableChange;
+        case E_ZCL_UINT32:  return change.zuint32ReportableChange;
+        case E_ZCL_INT8:    return change.zint8ReportableChange < 0 ? -change.zint8ReportableChange : change.zint8ReportableChange;
+        case E_ZCL_INT16:   return change.zint16ReportableChange < 0 ? -change.zint16ReportableChange : change.zint16ReportableChange;
+        case E_ZCL_INT32:   return change.zint32ReportableChange < 0 ? -change.zint32ReportableChange : change.zint32ReportableChange;
+        default:            return 0;
+    }
+}
+
+tsZCL_AttributeDefinition * ReportManager::findAttribute(tsZCL_ClusterInstance * psClusterInstance, uint16 attributeId,
+                                                         bool manufacturerSpecific)
+{
+    tsZCL_ClusterDefinition * psClusterDefinition = psClusterInstance->psClusterDefinition;
+    for(uint16 i = 0; i < psClusterDefinition->u16NumberOfAttributes; i++)
+    {
+        tsZCL_AttributeDefinition * psAttributeDefinition = &psClusterDefinition->psAttributeDefinition[i];
+        bool isManufacturerSpecific = (psAttributeDefinition->u8AttributeFlags & E_ZCL_AF_MS) != 0 ||
+                                      psClusterDefinition->bIsManufacturerSpecificCluster;
+        if(psAttributeDefinition->u16AttributeEnum == attributeId && isManufacturerSpecific == manufacturerSpecific)
+            return psAttributeDefinition;
+    }
+
+    return NULL;
+}
+
+uint8 ReportManager::getAnalogSize(uint8 dataType)
+{
+    // Size of the reportable change field, which is present for analog data types only (ZCL spec 2.6.1.4)
+    switch(dataType)
+    {
+        case E_ZCL_UINT8:   case E_ZCL_INT8:    return 1;
+        case E_ZCL_UINT16:  case E_ZCL_INT16:   return 2;
+        case E_ZCL_UINT24:  case E_ZCL_INT24:   return 3;
+        case E_ZCL_UINT32:  case E_ZCL_INT32:   return 4;
+        case E_ZCL_UINT40:  case E_ZCL_INT40:   return 5;
+        case E_ZCL_UINT48:  case E_ZCL_INT48:   return 6;
+        case E_ZCL_UINT56:  case E_ZCL_INT56:   return 7;
+        case E_ZCL_UINT64:  case E_ZCL_INT64:   return 8;
+        case E_ZCL_FLOAT_SEMI:                  return 2;
+        case E_ZCL_FLOAT_SINGLE:                return 4;
+        case E_ZCL_FLOAT_DOUBLE:                return 8;
+        case E_ZCL_TOD:     case E_ZCL_DATE:    case E_ZCL_UTCT:    return 4;
+        default:            return 0;
+    }
+}
+
+void ReportManager::setReportableChange(tuZCL_AttributeReportable * change, uint8 dataType, uint32 value)
+{
+    // Inverse of getReportableChange(). Types the scheduler treats as discrete are reported with zero change.
+    memset(change, 0, sizeof(*change));
+    switch(dataType)
+    {
+        case E_ZCL_UINT8:   change->zuint8ReportableChange = value;     break;
+        case E_ZCL_UINT16:  change->zuint16ReportableChange = value;    break;
+        case E_ZCL_UINT32:  change->zuint32ReportableChange = value;    break;
+        case E_ZCL_INT8:    change->zint8ReportableChange = value;      break;
+        case E_ZCL_INT16:   change->zint16ReportableChange = value;     break;
+        case E_ZCL_INT32:   change->zint32ReportableChange = value;     break;
+        default:            break;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef REPORTMANAGER_H
+#define REPORTMANAGER_H
+
+extern "C"
+{
+    #include "jendefs.h"
+    #include "zcl.h"
+    #include "zps_apl_af.h"
+    #include "pdum_apl.h"
+}
+
+#include "ReportScheduler.h"
+
+struct ReportManagerStatistics
+{
+    uint32 configured;          // Reporting configurations currently active
+    uint32 reportsSent;         // Reports handed over to ReportAggregator
+};
+
+// Sends attribute reports according to the reporting configuration (min/max intervals, reportable change).
+//
+// This replaces the ZCL report manager, which is limited to ZCL_NUMBER_OF_REPORTS configurations and checks each of
+// them every second. Configure Reporting and Read Reporting Configuration commands are answered here before they get
+// to ZCL, so the ZCL reporting table is not used at all. The configuration is kept by the ReportScheduler and
+// persisted in PDM. The scheduler is checked at each main loop iteration (which costs a single comparison), and
+// sleeping devices wake up right when the next report is due.
+class ReportManager
+{
+    static const uint8 MAX_REPORTS = 48;
+
+    ReportSchedulerStorage<MAX_REPORTS> scheduler;
+    ReportConfig pdmBuffer[MAX_REPORTS];    // Too big for the stack
+    bool configChanged;
+    uint32 reportsSent;
+
+private:
+    ReportManager();
+
+public:
+    static ReportManager * getInstance();
+
+    void restore();
+    bool configureReport(uint8 endpoint, uint16 clusterId, uint16 attributeId,
+                         uint16 minInterval, uint16 maxInterval, uint32 reportableChange);
+    bool handleDataIndication(ZPS_tsAfEvent * pEvent);
+
+    teZCL_Status reportChange(uint8 endpoint, uint16 clusterId, uint16 attributeId);
+    teZCL_Status reportValueChange(uint8 endpoint, uint16 clusterId, uint16 attributeId, int32 value);
+    void handleAttributeWrite(uint8 endpoint, uint16 clusterId, uint16 attributeId);
+    bool isReportConfigured(uint8 endpoint, uint16 clusterId, uint16 attributeId) const;
+
+    void flush();
+    uint32 getTimeTillNextReport() const;
+
+    ReportManagerStatistics getStatistics() const;
+    void dumpStatistics() const;
+
+    static uint32 getReportableChange(const tsZCL_AttributeReportingConfigurationRecord * record);
+
+protected:
+    void save();
+    void handleConfigureReporting(ZPS_tsAfDataIndEvent * pInd, const tsZCL_HeaderParams * header, uint16 pos,
+                                  tsZCL_ClusterInstance * psClusterInstance);
+    void handleReadReportingConfiguration(ZPS_tsAfDataIndEvent * pInd, const tsZCL_HeaderParams * header, uint16 pos,
+                                          tsZCL_ClusterInstance * psClusterInstance);
+    void sendResponse(ZPS_tsAfDataIndEvent * pInd, PDUM_thAPduInstance hAPduInst, uint16 size);
+
+    static tsZCL_AttributeDefinition * findAttribute(tsZCL_ClusterInstance * psClusterInstance, uint16 attributeId,
+                                                     bool manufacturerSpecific);
+    static uint8 getAnalogSize(uint8 dataType);
+    static void setReportableChange(tuZCL_AttributeReportable * change, uint8 dataType, uint32 value);
+};
+
+#endif // REPORTMANAGER_H
@@ -0,0 +1,346 @@
+#include "ReportScheduler.h"
+
+static const uint32 MS_IN_SECOND = 1000;
+
+ReportScheduler::ReportScheduler(ScheduledReport * reportStorage, uint8 * heapStorage, uint8 maxReports)
+{
+    reports = reportStorage;
+    heap = heapStorage;
+    capacity = maxReports;
+    numReports = 0;
+    heapSize = 0;
+
+    stats.changeReports = 0;
+    stats.periodicReports = 0;
+    stats.deferredChanges = 0;
+    stats.ignoredChanges = 0;
+    stats.heapSteps = 0;
+}
+
+bool ReportScheduler::configure(uint8 endpoint, uint16 clusterId, uint16 attributeId,
+                                uint16 minInterval, uint16 maxInterval, uint32 reportableChange, uint32 now)
+{
+    if(maxInterval == REPORT_INTERVAL_TURNED_OFF)
+    {
+        remove(endpoint, clusterId, attributeId);
+        return true;
+    }
+
+    int idx = find(endpoint, clusterId, attributeId);
+    if(idx < 0)
+    {
+        if(numReports >= capacity)
+            return false;
+
+        // Keep the list sorted. Moved reports must be followed by their heap items.
+        idx = 0;
+        while(idx < numReports && compare(reports[idx], endpoint, clusterId, attributeId) < 0)
+            idx++;
+
+        for(int i = numReports; i > idx; i--)
+        {
+            reports[i] = reports[i - 1];
+            if(reports[i].heapPos != NOT_SCHEDULED)
+                heap[reports[i].heapPos] = i;
+        }
+        numReports++;
+
+        // Newly configured attribute is reported right away, so that the receiver gets the current value
+        ScheduledReport & report = reports[idx];
+        report.endpoint = endpoint;
+        report.clusterId = clusterId;
+        report.attributeId = attributeId;
+        report.heapPos = NOT_SCHEDULED;
+        report.changed = true;
+        report.value = 0;
+        report.reportedValue = 0;
+        report.lastReportTime = now - minInterval * MS_IN_SECOND;
+    }
+
+    ScheduledReport & report = reports[idx];
+    report.minInterval = minInterval;
+    report.maxInterval = maxInterval;
+    report.reportableChange = reportableChange;
+    schedule(idx);
+    return true;
+}
+
+void ReportScheduler::remove(uint8 endpoint, uint16 clusterId, uint16 attributeId)
+{
+    int idx = find(endpoint, clusterId, attributeId);
+    if(idx < 0)
+        return;
+
+    unschedule(idx);
+
+    numReports--;
+    for(int i = idx; i < numReports; i++)
+    {
+        reports[i] = reports[i + 1];
+        if(reports[i].heapPos != NOT_SCHEDULED)
+            heap[reports[i].heapPos] = i;
+    }
+}
+
+bool ReportScheduler::isConfigured(uint8 endpoint, uint16 clusterId, uint16 attributeId) const
+{
+    return find(endpoint, clusterId, attributeId) >= 0;
+}
+
+const ScheduledReport * ReportScheduler::getReport(uint8 endpoint, uint16 clusterId, uint16 attributeId) const
+{
+    int idx = find(endpoint, clusterId, attributeId);
+    return idx >= 0 ? &reports[idx] : NULL;
+}
+
+bool ReportScheduler::handleChange(uint8 endpoint, uint16 clusterId, uint16 attributeId, uint32 now)
+{
+    // Attributes without the reporting configuration are reported on every change
+    int idx = find(endpoint, clusterId, attributeId);
+    if(idx < 0)
+        return true;
+
+    return reportNow(reports[idx], now);
+}
+
+bool ReportScheduler::handleValueChange(uint8 endpoint, uint16 clusterId, uint16 attributeId, int32 value, uint32 now)
+{
+    int idx = find(endpoint, clusterId, attributeId);
+    if(idx < 0)
+        return true;
+
+    ScheduledReport & report = reports[idx];
+    report.value = value;
+
+    // Small fluctuations of analog values are not worth a report
+    uint32 delta = value > report.reportedValue ? (uint32)(value - report.reportedValue) : (uint32)(report.reportedValue - value);
+    if(delta == 0 || delta < report.reportableChange)
+    {
+        stats.ignoredChanges++;
+        return false;
+    }
+
+    return reportNow(report, now);
+}
+
+uint8 ReportScheduler::takeDueReports(uint32 now, ReportRecord * records, uint8 maxRecords)
+{
+    uint8 taken = 0;
+    while(heapSize > 0 && taken < maxRecords)
+    {
+        ScheduledReport & report = reports[heap[0]];
+        if((int32)(now - report.deadline) < 0)
+            break;
+
+        if(report.changed)
+            stats.changeReports++;
+        else
+            stats.periodicReports++;
+
+        records[taken].endpoint = report.endpoint;
+        records[taken].clusterId = report.clusterId;
+        records[taken].attributeId = report.attributeId;
+        records[taken].requests = 1;
+        taken++;
+
+        markReported(report, now);
+    }
+
+    return taken;
+}
+
+uint32 ReportScheduler::getTimeTillNextReport(uint32 now) const
+{
+    if(heapSize == 0)
+        return 0;
+
+    // Overdue report is still a report to wait for
+    int32 delay = (int32)(reports[heap[0]].deadline - now);
+    return delay > 0 ? delay : 1;
+}
+
+uint8 ReportScheduler::getConfigurations(ReportConfig * configs, uint8 maxConfigs) const
+{
+    // Only the configuration is returned, the scheduling state is rebuilt by configure()
+    uint8 count = numReports < maxConfigs ? numReports : maxConfigs;
+    for(uint8 i = 0; i < count; i++)
+    {
+        configs[i].endpoint = reports[i].endpoint;
+        configs[i].clusterId = reports[i].clusterId;
+        configs[i].attributeId = reports[i].attributeId;
+        configs[i].minInterval = reports[i].minInterval;
+        configs[i].maxInterval = reports[i].maxInterval;
+        configs[i].reportableChange = reports[i].reportableChange;
+    }
+
+    return count;
+}
+
+uint8 ReportScheduler::getNumReports() const
+{
+    return numReports;
+}
+
+const ReportSchedulerStatistics & ReportScheduler::getStatistics() const
+{
+    return stats;
+}
+
+int ReportScheduler::find(uint8 endpoint, uint16 clusterId, uint16 attributeId) const
+{
+    // Binary search over the list sorted by endpoint/cluster/attribute
+    int lo = 0;
+    int hi = numReports - 1;
+    while(lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        int cmp = compare(reports[mid], endpoint, clusterId, attributeId);
+        if(cmp == 0)
+            return mid;
+
+        if(cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    return -1;
+}
+
+int ReportScheduler::compare(const ScheduledReport & report, uint8 endpoint, uint16 clusterId, uint16 attributeId)
+{
+    if(report.endpoint != endpoint)
+        return report.endpoint < endpoint ? -1 : 1;
+
+    if(report.clusterId != clusterId)
+        return report.clusterId < clusterId ? -1 : 1;
+
+    if(report.attributeId != attributeId)
+        return report.attributeId < attributeId ? -1 : 1;
+
+    return 0;
+}
+
+bool ReportScheduler::reportNow(ScheduledReport & report, uint32 now)
+{
+    // The change may be reported right away if the min interval has passed since the previous report
+    if((int32)(now - (report.lastReportTime + report.minInterval * MS_IN_SECOND)) >= 0)
+    {
+        stats.changeReports++;
+        markReported(report, now);
+        return true;
+    }
+
+    // Otherwise it is reported as soon as the min interval is over
+    if(!report.changed)
+    {
+        report.changed = true;
+        stats.deferredChanges++;
+        schedule(&report - reports);
+    }
+
+    return false;
+}
+
+void ReportScheduler::markReported(ScheduledReport & report, uint32 now)
+{
+    report.lastReportTime = now;
+    report.reportedValue = report.value;
+    report.changed = false;
+    schedule(&report - reports);
+}
+
+void ReportScheduler::schedule(uint8 idx)
+{
+    ScheduledReport & report = reports[idx];
+    if(report.changed)
+        report.deadline = report.lastReportTime + report.minInterval * MS_IN_SECOND;
+    else if(report.maxInterval != REPORT_INTERVAL_NO_PERIODIC)
+        report.deadline = report.lastReportTime + report.maxInterval * MS_IN_SECOND;
+    else
+    {
+        // Nothing to report till the next change
+        unschedule(idx);
+        return;
+    }
+
+    if(report.heapPos == NOT_SCHEDULED)
+    {
+        setHeapItem(heapSize++, idx);
+        siftUp(report.heapPos);
+    }
+    else
+    {
+        // The deadline may move either way
+        siftUp(report.heapPos);
+        siftDown(report.heapPos);
+    }
+}
+
+void ReportScheduler::unschedule(uint8 idx)
+{
+    uint8 pos = reports[idx].heapPos;
+    if(pos == NOT_SCHEDULED)
+        return;
+
+    reports[idx].heapPos = NOT_SCHEDULED;
+
+    // Fill the gap with the last heap item
+    heapSize--;
+    if(pos == heapSize)
+        return;
+
+    uint8 moved = heap[heapSize];
+    setHeapItem(pos, moved);
+    siftUp(pos);
+    siftDown(reports[moved].heapPos);
+}
+
+void ReportScheduler::setHeapItem(uint8 pos, uint8 idx)
+{
+    heap[pos] = idx;
+    reports[idx].heapPos = pos;
+}
+
+void ReportScheduler::siftUp(uint8 pos)
+{
+    while(pos > 0)
+    {
+        uint8 parent = (pos - 1) / 2;
+        if(!isEarlier(pos, parent))
+            break;
+
+        uint8 idx = heap[pos];
+        setHeapItem(pos, heap[parent]);
+        setHeapItem(parent, idx);
+        pos = parent;
+        stats.heapSteps++;
+    }
+}
+
+void ReportScheduler::siftDown(uint8 pos)
+{
+    while(true)
+    {
+        uint16 child = 2 * pos + 1;
+        if(child >= heapSize)
+            break;
+
+        if(child + 1 < heapSize && isEarlier(child + 1, child))
+            child++;
+
+        if(!isEarlier(child, pos))
+            break;
+
+        uint8 idx = heap[pos];
+        setHeapItem(pos, heap[child]);
+        setHeapItem(child, idx);
+        pos = child;
+        stats.heapSteps++;
+    }
+}
+
+bool ReportScheduler::isEarlier(uint8 posA, uint8 posB) const
+{
+    return (int32)(reports[heap[posA]].deadline - reports[heap[posB]].deadline) < 0;
+}
@@ -0,0 +1,120 @@
+#ifndef REPORTSCHEDULER_H
+#define REPORTSCHEDULER_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+#include "ReportBatch.h"
+
+// ZCL reporting intervals are in seconds
+static const uint16 REPORT_INTERVAL_NO_PERIODIC = 0x0000;      // Max interval: report on change only
+static const uint16 REPORT_INTERVAL_TURNED_OFF = 0xFFFF;       // Max interval: do not report at all
+
+// Reporting configuration of a single attribute along with its scheduling state
+struct ScheduledReport
+{
+    uint8 endpoint;
+    uint8 heapPos;              // Position in the deadline heap, or NOT_SCHEDULED
+    uint16 clusterId;
+    uint16 attributeId;
+    uint16 minInterval;         // s
+    uint16 maxInterval;         // s
+    bool changed;               // Changed since the last report, waiting for the min interval
+    uint32 reportableChange;    // Analog attributes: minimal change worth reporting
+    int32 value;                // Analog attributes: the latest known value
+    int32 reportedValue;        // Analog attributes: the value sent with the last report
+    uint32 lastReportTime;      // ms
+    uint32 deadline;            // ms, time of the next report
+};
+
+// Reporting configuration of a single attribute, as stored in PDM
+struct ReportConfig
+{
+    uint8 endpoint;
+    uint16 clusterId;
+    uint16 attributeId;
+    uint16 minInterval;         // s
+    uint16 maxInterval;         // s
+    uint32 reportableChange;
+};
+
+struct ReportSchedulerStatistics
+{
+    uint32 changeReports;       // Reports caused by an attribute change
+    uint32 periodicReports;     // Reports caused by the max interval
+    uint32 deferredChanges;     // Changes that had to wait for the min interval
+    uint32 ignoredChanges;      // Analog changes below the reportable change
+    uint32 heapSteps;           // Heap levels walked while (re)scheduling, the cost of the scheduler
+};
+
+// Decides when attribute reports shall be sent, according to the ZCL min/max reporting intervals.
+//
+// Reports are kept in a binary min-heap ordered by the next deadline, so finding the next due report is O(1) and
+// rescheduling is O(log N), instead of scanning every configured report each second. Attributes are found by a
+// binary search over the list sorted by endpoint/cluster/attribute. Configuration changes are rare, and they are
+// O(N).
+//
+// ReportManager feeds the attribute changes in and sends the reports that fall due. The storage is provided by the
+// derived class (see ReportSchedulerStorage below).
+class ReportScheduler
+{
+public:
+    static const uint8 NOT_SCHEDULED = 0xff;
+
+private:
+    ScheduledReport * reports;      // Sorted by endpoint/cluster/attribute
+    uint8 * heap;                   // Indexes in the reports array
+    uint8 capacity;
+    uint8 numReports;
+    uint8 heapSize;
+
+    ReportSchedulerStatistics stats;
+
+protected:
+    ReportScheduler(ScheduledReport * reports, uint8 * heap, uint8 capacity);
+
+public:
+    bool configure(uint8 endpoint, uint16 clusterId, uint16 attributeId,
+                   uint16 minInterval, uint16 maxInterval, uint32 reportableChange, uint32 now);
+    void remove(uint8 endpoint, uint16 clusterId, uint16 attributeId);
+    bool isConfigured(uint8 endpoint, uint16 clusterId, uint16 attributeId) const;
+    const ScheduledReport * getReport(uint8 endpoint, uint16 clusterId, uint16 attributeId) const;
+
+    bool handleChange(uint8 endpoint, uint16 clusterId, uint16 attributeId, uint32 now);
+    bool handleValueChange(uint8 endpoint, uint16 clusterId, uint16 attributeId, int32 value, uint32 now);
+    uint8 takeDueReports(uint32 now, ReportRecord * records, uint8 maxRecords);
+    uint32 getTimeTillNextReport(uint32 now) const;
+
+    uint8 getConfigurations(ReportConfig * configs, uint8 maxConfigs) const;
+    uint8 getNumReports() const;
+    const ReportSchedulerStatistics & getStatistics() const;
+
+private:
+    int find(uint8 endpoint, uint16 clusterId, uint16 attributeId) const;
+    static int compare(const ScheduledReport & report, uint8 endpoint, uint16 clusterId, uint16 attributeId);
+    bool reportNow(ScheduledReport & report, uint32 now);
+    void markReported(ScheduledReport & report, uint32 now);
+    void schedule(uint8 idx);
+    void unschedule(uint8 idx);
+    void setHeapItem(uint8 pos, uint8 idx);
+    void siftUp(uint8 pos);
+    void siftDown(uint8 pos);
+    bool isEarlier(uint8 posA, uint8 posB) const;
+};
+
+template<uint8 size>
+class ReportSchedulerStorage : public ReportScheduler
+{
+    ScheduledReport reportStorage[size];
+    uint8 heapStorage[size];
+
+public:
+    ReportSchedulerStorage()
+        : ReportScheduler(reportStorage, heapStorage, size)
+    {
+    }
+};
+
+#endif // REPORTSCHEDULER_H
@@ -0,0 +1,114 @@
+#include "RuleTable.h"
+#include "ButtonHandler.h"
+
+// On/Off cluster commands Off (0x00), On (0x01) and Toggle (0x02) are supported
+static const uint8 ONOFF_CMD_TOGGLE = 0x02;
+
+RuleTable::RuleTable()
+{
+    numRules = 0;
+}
+
+bool RuleTable::load(const uint8 * data, uint8 len)
+{
+    if(len % RULE_SIZE != 0 || len > MAX_SIZE)
+        return false;
+
+    // Parse into a temporary table, so that the current rules survive a malformed update
+    AutomationRule newRules[MAX_RULES];
+    uint8 newNumRules = len / RULE_SIZE;
+    for(uint8 i = 0; i < newNumRules; i++)
+    {
+        const uint8 * ptr = data + i * RULE_SIZE;
+        AutomationRule & rule = newRules[i];
+        rule.trigger = ptr[0];
+        rule.action = ptr[1];
+        rule.command = ptr[2];
+        rule.targetEndpoint = ptr[3];
+        rule.param = ptr[4] | (ptr[5] << 8);
+
+        if(!isValid(rule))
+            return false;
+    }
+
+    for(uint8 i = 0; i < newNumRules; i++)
+        rules[i] = newRules[i];
+    numRules = newNumRules;
+    return true;
+}
+
+uint8 RuleTable::store(uint8 * data, uint8 maxLen) const
+{
+    uint8 len = 0;
+    for(uint8 i = 0; i < numRules && len + RULE_SIZE <= maxLen; i++)
+    {
+        const AutomationRule & rule = rules[i];
+        data[len++] = rule.trigger;
+        data[len++] = rule.action;
+        data[len++] = rule.command;
+        data[len++] = rule.targetEndpoint;
+        data[len++] = rule.param & 0xff;
+        data[len++] = rule.param >> 8;
+    }
+
+    return len;
+}
+
+void RuleTable::clear()
+{
+    numRules = 0;
+}
+
+uint8 RuleTable::getNumRules() const
+{
+    return numRules;
+}
+
+const AutomationRule & RuleTable::getRule(uint8 idx) const
+{
+    return rules[idx];
+}
+
+uint8 RuleTable::findRules(uint8 trigger, uint8 * indexes, uint8 maxIndexes) const
+{
+    // Rules are executed in the order they are defined
+    uint8 numFound = 0;
+    for(uint8 i = 0; i < numRules && numFound < maxIndexes; i++)
+        if(rules[i].trigger == trigger)
+            indexes[numFound++] = i;
+
+    return numFound;
+}
+
+bool RuleTable::isValid(const AutomationRule & rule)
+{
+    switch(rule.trigger)
+    {
+        case BUTTON_RELEASED:
+        case BUTTON_ACTION_SINGLE:
+        case BUTTON_ACTION_DOUBLE:
+        case BUTTON_ACTION_TRIPPLE:
+        case BUTTON_PRESSED:
+            break;
+
+        default:
+            return false;
+    }
+
+    switch(rule.action)
+    {
+        case AUTOMATION_ACTION_LOCAL_ONOFF:
+        case AUTOMATION_ACTION_BOUND_ONOFF:
+            return rule.command <= ONOFF_CMD_TOGGLE;
+
+        case AUTOMATION_ACTION_GROUP_ONOFF:
+            // Group addresses 0xfff8-0xffff are reserved
+            return rule.command <= ONOFF_CMD_TOGGLE && rule.param < 0xfff8;
+
+        case AUTOMATION_ACTION_LED_EFFECT:
+            return rule.param <= 0xff;
+
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef RULETABLE_H
+#define RULETABLE_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// What a rule does when triggered
+enum AutomationActionType
+{
+    AUTOMATION_ACTION_LOCAL_ONOFF = 1,      // On/Off/Toggle a relay of this device (target endpoint, 0 - own endpoint)
+    AUTOMATION_ACTION_BOUND_ONOFF = 2,      // On/Off/Toggle command to the devices bound to the endpoint
+    AUTOMATION_ACTION_GROUP_ONOFF = 3,      // On/Off/Toggle command to a group (param - group address)
+    AUTOMATION_ACTION_LED_EFFECT  = 4       // LED effect on the target endpoint (param - Identify effect id)
+};
+
+// A single automation rule. Serialized as 6 bytes: trigger, action, command, target endpoint, param (LE)
+struct AutomationRule
+{
+    uint8 trigger;              // ButtonActionType value
+    uint8 action;               // AutomationActionType
+    uint8 command;              // On/Off cluster command id (Off, On, Toggle)
+    uint8 targetEndpoint;
+    uint16 param;
+};
+
+// A compact table of button triggered rules of a single endpoint.
+//
+// Rules are evaluated on the device itself, so that they work without the coordinator and without an extra
+// network round trip. The table is loaded and stored in the serialized form used both for the PDM record and for
+// the configuration attribute.
+class RuleTable
+{
+public:
+    static const uint8 MAX_RULES = 8;
+    static const uint8 RULE_SIZE = 6;
+    static const uint8 MAX_SIZE = MAX_RULES * RULE_SIZE;
+
+private:
+    AutomationRule rules[MAX_RULES];
+    uint8 numRules;
+
+public:
+    RuleTable();
+
+    bool load(const uint8 * data, uint8 len);
+    uint8 store(uint8 * data, uint8 maxLen) const;
+    void clear();
+
+    uint8 getNumRules() const;
+    const AutomationRule & getRule(uint8 idx) const;
+    uint8 findRules(uint8 trigger, uint8 * indexes, uint8 maxIndexes) const;
+
+    static bool isValid(const AutomationRule & rule);
+};
+
+#endif // RULETABLE_H
@@ -0,0 +1,161 @@
+#include "SceneTable.h"
+
+// Extension field set of the On/Off cluster: cluster id (LE), length, OnOff attribute value
+static const uint16 ONOFF_CLUSTER_ID = 0x0006;
+static const uint8 EXTENSION_HEADER_SIZE = 3;
+
+SceneTable::SceneTable()
+{
+    numScenes = 0;
+}
+
+bool SceneTable::load(const uint8 * data, uint8 len)
+{
+    if(len % ENTRY_SIZE != 0 || len > MAX_SIZE)
+        return false;
+
+    // Duplicates would make the scene table ambiguous, so validate everything before replacing the current table
+    SceneEntry newScenes[MAX_SCENES];
+    uint8 newNumScenes = len / ENTRY_SIZE;
+    for(uint8 i = 0; i < newNumScenes; i++)
+    {
+        const uint8 * ptr = data + i * ENTRY_SIZE;
+        SceneEntry & entry = newScenes[i];
+        entry.groupId = ptr[0] | (ptr[1] << 8);
+        entry.sceneId = ptr[2];
+        entry.onOff = ptr[3];
+
+        if(entry.onOff > 1)
+            return false;
+
+        for(uint8 j = 0; j < i; j++)
+            if(newScenes[j].groupId == entry.groupId && newScenes[j].sceneId == entry.sceneId)
+                return false;
+    }
+
+    for(uint8 i = 0; i < newNumScenes; i++)
+        scenes[i] = newScenes[i];
+    numScenes = newNumScenes;
+    return true;
+}
+
+uint8 SceneTable::store(uint8 * data, uint8 maxLen) const
+{
+    uint8 len = 0;
+    for(uint8 i = 0; i < numScenes && len + ENTRY_SIZE <= maxLen; i++)
+    {
+        const SceneEntry & entry = scenes[i];
+        data[len++] = entry.groupId & 0xff;
+        data[len++] = entry.groupId >> 8;
+        data[len++] = entry.sceneId;
+        data[len++] = entry.onOff;
+    }
+
+    return len;
+}
+
+void SceneTable::clear()
+{
+    numScenes = 0;
+}
+
+bool SceneTable::storeScene(uint16 groupId, uint8 sceneId, bool onOff)
+{
+    // Storing an existing scene overwrites it
+    int idx = findIndex(groupId, sceneId);
+    if(idx < 0)
+    {
+        if(numScenes >= MAX_SCENES)
+            return false;
+
+        idx = numScenes++;
+        scenes[idx].groupId = groupId;
+        scenes[idx].sceneId = sceneId;
+    }
+
+    scenes[idx].onOff = onOff ? 1 : 0;
+    return true;
+}
+
+bool SceneTable::removeScene(uint16 groupId, uint8 sceneId)
+{
+    int idx = findIndex(groupId, sceneId);
+    if(idx < 0)
+        return false;
+
+    // Keep the table dense, the order of scenes does not matter
+    scenes[idx] = scenes[--numScenes];
+    return true;
+}
+
+uint8 SceneTable::removeGroup(uint16 groupId)
+{
+    uint8 removed = 0;
+    uint8 i = 0;
+    while(i < numScenes)
+    {
+        if(scenes[i].groupId == groupId)
+        {
+            scenes[i] = scenes[--numScenes];
+            removed++;
+        }
+        else
+            i++;
+    }
+
+    return removed;
+}
+
+bool SceneTable::findScene(uint16 groupId, uint8 sceneId, bool * onOff) const
+{
+    int idx = findIndex(groupId, sceneId);
+    if(idx < 0)
+        return false;
+
+    *onOff = scenes[idx].onOff != 0;
+    return true;
+}
+
+uint8 SceneTable::getNumScenes() const
+{
+    return numScenes;
+}
+
+const SceneEntry & SceneTable::getScene(uint8 idx) const
+{
+    return scenes[idx];
+}
+
+bool SceneTable::parseOnOffExtension(const uint8 * data, uint16 len, bool * onOff)
+{
+    // Walk through the extension field sets of the Add Scene command, skipping other clusters
+    uint16 pos = 0;
+    while(pos + EXTENSION_HEADER_SIZE <= len)
+    {
+        uint16 clusterId = data[pos] | (data[pos + 1] << 8);
+        uint8 fieldLen = data[pos + 2];
+        pos += EXTENSION_HEADER_SIZE;
+
+        if(pos + fieldLen > len)
+            return false;
+
+        if(clusterId == ONOFF_CLUSTER_ID && fieldLen >= 1)
+        {
+            *onOff = data[pos] != 0;
+            return true;
+        }
+
+        pos += fieldLen;
+    }
+
+    return false;
+}
+
+int SceneTable::findIndex(uint16 groupId, uint8 sceneId) const
+{
+    for(uint8 i = 0; i < numScenes; i++)
+        if(scenes[i].groupId == groupId && scenes[i].sceneId == sceneId)
+            return i;
+
+    return -1;
+}
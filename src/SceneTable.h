@@ -0,0 +1,55 @@
+#ifndef SCENETABLE_H
+#define SCENETABLE_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// A scene of a single relay endpoint. Serialized as 4 bytes: group id (LE), scene id, on/off state
+struct SceneEntry
+{
+    uint16 groupId;
+    uint8 sceneId;
+    uint8 onOff;
+};
+
+// Compact copy of the Scenes cluster table of a single endpoint.
+//
+// The only extension field set a relay endpoint has is the On/Off one, so a scene is stored as its address and a
+// single state byte, rather than as a generic extension field blob. The table is persisted in PDM and is used to
+// rebuild the Scenes cluster table after reboot, as well as to apply recalled scenes to the relay.
+class SceneTable
+{
+public:
+    // Checked against CLD_SCENES_MAX_NUMBER_OF_SCENES at build time, see SwitchEndpoint.cpp
+    static const uint8 MAX_SCENES = 16;
+    static const uint8 ENTRY_SIZE = 4;
+    static const uint8 MAX_SIZE = MAX_SCENES * ENTRY_SIZE;
+
+private:
+    SceneEntry scenes[MAX_SCENES];
+    uint8 numScenes;
+
+public:
+    SceneTable();
+
+    bool load(const uint8 * data, uint8 len);
+    uint8 store(uint8 * data, uint8 maxLen) const;
+    void clear();
+
+    bool storeScene(uint16 groupId, uint8 sceneId, bool onOff);
+    bool removeScene(uint16 groupId, uint8 sceneId);
+    uint8 removeGroup(uint16 groupId);
+    bool findScene(uint16 groupId, uint8 sceneId, bool * onOff) const;
+
+    uint8 getNumScenes() const;
+    const SceneEntry & getScene(uint8 idx) const;
+
+    static bool parseOnOffExtension(const uint8 * data, uint16 len, bool * onOff);
+
+private:
+    int findIndex(uint16 groupId, uint8 sceneId) const;
+};
+
+#endif // SCENETABLE_H
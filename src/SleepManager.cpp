@@ -0,0 +1,109 @@
+extern "C"
+{
+    #include "jendefs.h"
+    #include "dbg.h"
+}
+
+#include "SleepManager.h"
+#include "SystemClock.h"
+
+SleepManager::SleepManager()
+{
+    numParticipants = 0;
+    lastCheckTime = 0;
+    vetoMask = 0;
+}
+
+SleepManager * SleepManager::getInstance()
+{
+    static SleepManager instance;
+    return &instance;
+}
+
+void SleepManager::registerParticipant(const char * name, ISleepParticipant * participant)
+{
+    if(numParticipants >= CLD_DEVICE_STATS_MAX_SLEEP_PARTICIPANTS)
+    {
+        DBG_vPrintf(TRUE, "SleepManager::registerParticipant(): Too many participants. Cannot register %s\n", name);
+        return;
+    }
+
+    DBG_vPrintf(TRUE, "SleepManager::registerParticipant(): Registering sleep participant %s\n", name);
+
+    SleepParticipantRecord & record = participants[numParticipants];
+    record.name = name;
+    record.participant = participant;
+    record.lastVeto = SLEEP_VETO_NONE;
+    record.earliestSleepTime = 0;
+    record.vetoTime = 0;
+    record.vetoCount = 0;
+
+    numParticipants++;
+}
+
+bool SleepManager::canSleep()
+{
+    uint32 now = SystemClock::getInstance()->getTimeMs();
+    uint32 elapsed = now - lastCheckTime;
+    lastCheckTime = now;
+
+    vetoMask = 0;
+    for(uint8 i = 0; i < numParticipants; i++)
+    {
+        SleepParticipantRecord & record = participants[i];
+
+        // The time since previous check is accounted to the participant that was vetoing the sleep at that moment
+        if(record.lastVeto != SLEEP_VETO_NONE)
+            record.vetoTime += elapsed;
+
+        uint32 earliestSleepTime = 0;
+        SleepVetoReason veto = record.participant->getSleepVeto(&earliestSleepTime);
+
+        if(veto != SLEEP_VETO_NONE)
+        {
+            if(record.lastVeto == SLEEP_VETO_NONE)
+                record.vetoCount++;
+
+            vetoMask |= 1 << i;
+        }
+
+        record.lastVeto = veto;
+        record.earliestSleepTime = earliestSleepTime;
+    }
+
+    return vetoMask == 0;
+}
+
+uint8 SleepManager::getNumParticipants() const
+{
+    return numParticipants;
+}
+
+uint8 SleepManager::getVetoMask() const
+{
+    return vetoMask;
+}
+
+const SleepParticipantRecord * SleepManager::getParticipantRecord(uint8 idx) const
+{
+    if(idx >= numParticipants)
+        return NULL;
+
+    return &participants[idx];
+}
+
+void SleepManager::dumpStatistics() const
+{
+    DBG_vPrintf(TRUE, "\n+++++++ Sleep veto statistics (uptime %d ms):\n", SystemClock::getInstance()->getTimeMs());
+    for(uint8 i = 0; i < numParticipants; i++)
+    {
+        const SleepParticipantRecord & record = participants[i];
+        DBG_vPrintf(TRUE, "    %d: %s: Veto=%d Deadline=%d VetoTime=%d ms VetoCount=%d\n",
+                    i,
+                    record.name,
+                    record.lastVeto,
+                    record.earliestSleepTime,
+                    record.vetoTime,
+                    record.vetoCount);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef SLEEPMANAGER_H
+#define SLEEPMANAGER_H
+
+#include "ISleepParticipant.h"
+
+extern "C"
+{
+    // Each participant gets its veto time attribute in the Device Statistics cluster, and a bit in the veto mask
+    #include "DeviceStats.h"
+}
+
+struct SleepParticipantRecord
+{
+    const char * name;
+    ISleepParticipant * participant;
+
+    SleepVetoReason lastVeto;
+    uint32 earliestSleepTime;
+
+    uint32 vetoTime;        // Cumulative time (ms) the participant was vetoing the sleep
+    uint32 vetoCount;       // Number of times the participant started vetoing
+};
+
+// The registry of all components that may prevent the device from sleeping.
+//
+// Every main loop iteration the sleep manager asks all participants whether the device may go to sleep. The time
+// each participant spends vetoing the sleep is accumulated, so that it is possible to figure out which component
+// keeps the device awake (and therefore consumes battery).
+class SleepManager
+{
+    SleepParticipantRecord participants[CLD_DEVICE_STATS_MAX_SLEEP_PARTICIPANTS];
+    uint8 numParticipants;
+
+    uint32 lastCheckTime;
+    uint8 vetoMask;
+
+private:
+    SleepManager();
+
+public:
+    static SleepManager * getInstance();
+
+    void registerParticipant(const char * name, ISleepParticipant * participant);
+
+    bool canSleep();
+
+    uint8 getNumParticipants() const;
+    uint8 getVetoMask() const;
+    const SleepParticipantRecord * getParticipantRecord(uint8 idx) const;
+
+    void dumpStatistics() const;
+};
+
+#endif // SLEEPMANAGER_H
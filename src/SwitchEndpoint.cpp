@@ -6,7 +6,13 @@
 #include "ButtonsTask.h"
 #include "PdmIds.h"
 #include "LEDTask.h"
-#include "RelayTask.h"
+#include "ReportAggregator.h"
+#include "ReportManager.h"
+#include "DeliveryTracker.h"
+#include "GroupFanout.h"
+#include "SystemClock.h"
+#include "TimedOffTask.h"
+#include "DiagnosticsCollector.h"
 
 extern "C"
 {
@@ -17,11 +23,35 @@ extern "C"
 }
 
 static const uint8 PARAM_ID_BUTTON_CONFIG = 0;
-static const uint8 PARAM_ID_REPORTING_CONFIG = 1;
+static const uint8 PARAM_ID_REPORTING_CONFIG = 1;    // Legacy, see migrateReportingConfigurations()
+static const uint8 PARAM_ID_AUTOMATION_RULES = 2;
+static const uint8 PARAM_ID_SCENES = 3;
+
+// Legacy reporting configuration record, as stored in PDM by the earlier firmware versions
+struct ReportConfiguration
+{
+    uint8 clusterID;
+    tsZCL_AttributeReportingConfigurationRecord record;
+};
+
+// Group commands are processed by all endpoints of the device that are members of the group
+static const uint8 ALL_ENDPOINTS = 0xFF;
+
+// The compact copy mirrors the Scenes cluster table, so a scene the cluster accepts always fits the copy.
+// The toolchain is C++98 and has no static_assert, an array of negative size fails the build instead.
+typedef char SceneTableMatchesScenesCluster[SceneTable::MAX_SCENES == CLD_SCENES_MAX_NUMBER_OF_SCENES ? 1 : -1];
+
+// Scenes of group 0 do not require group membership
+static const uint16 GLOBAL_SCENE_GROUP_ID = 0x0000;
+
+// On With Timed Off command control bits
+static const uint8 ONOFF_CONTROL_ACCEPT_ONLY_WHEN_ON = 0x01;
 
 
 SwitchEndpoint::SwitchEndpoint()
 {
+    appliedState = false;
+    pendingScene.active = false;
 }
 
 void SwitchEndpoint::setConfiguration(uint32 pinMask, bool disableServer)
@@ -69,7 +99,8 @@ void SwitchEndpoint::registerOnOffConfigServerCluster()
                                                            TRUE,                              // Server
                                                            &sCLD_OOSC,
                                                            &sOnOffConfigServerCluster,
-                                                           &au8OOSCAttributeControlBits[0]);
+                                                           &au8OOSCAttributeControlBits[0],
+                                                           &sOnOffConfigServerCustomDataStructure);
     if(status != E_ZCL_SUCCESS)
         DBG_vPrintf(TRUE, "SwitchEndpoint::init(): Failed to create OnOff config server cluster instance. status=%d\n", status);
 }
@@ -128,6 +159,34 @@ void SwitchEndpoint::registerGroupsCluster()
         DBG_vPrintf(TRUE, "SwitchEndpoint::init(): Failed to create Groups Cluster instance. status=%d\n", status);
 }
 
+void SwitchEndpoint::registerGroupsClientCluster()
+{
+    // Groups client is used to put bound devices into a group
+    teZCL_Status status = eCLD_GroupsCreateGroups(&sClusterInstance.client.sGroupsClient,
+                                                  FALSE,
+                                                  &sCLD_Groups,
+                                                  &sGroupsClientCluster,
+                                                  &au8GroupsAttributeControlBits[0],
+                                                  &sGroupsClientCustomDataStructure,
+                                                  &sEndPoint);
+    if( status != E_ZCL_SUCCESS)
+        DBG_vPrintf(TRUE, "SwitchEndpoint::init(): Failed to create Groups client Cluster instance. status=%d\n", status);
+}
+
+void SwitchEndpoint::registerScenesCluster()
+{
+    // Create an instance of a scenes cluster as a server
+    teZCL_Status status = eCLD_ScenesCreateScenes(&sClusterInstance.server.sScenesServer,
+                                                  TRUE,
+                                                  &sCLD_Scenes,
+                                                  &sScenesServerCluster,
+                                                  &au8ScenesAttributeControlBits[0],
+                                                  &sScenesServerCustomDataStructure,
+                                                  &sEndPoint);
+    if( status != E_ZCL_SUCCESS)
+        DBG_vPrintf(TRUE, "SwitchEndpoint::init(): Failed to create Scenes Cluster instance. status=%d\n", status);
+}
+
 void SwitchEndpoint::initEndpointStructure()
 {
     // Calculate number of clusters, depending on client/server mode
@@ -189,6 +248,122 @@ void SwitchEndpoint::saveButtonsConfiguration()
                         sizeof(sOnOffConfigServerCluster));
 }
 
+void SwitchEndpoint::restoreAutomationRules()
+{
+    uint16 readBytes = 0;
+    PDM_teStatus status = PDM_eReadDataFromRecord(getPdmIdForEndpoint(getEndpointId(), PARAM_ID_AUTOMATION_RULES),
+                                                  automationRulesData,
+                                                  sizeof(automationRulesData),
+                                                  &readBytes);
+    if(status != PDM_E_STATUS_OK || !automationRules.load(automationRulesData, readBytes))
+        automationRules.clear();
+
+    DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Restored %d automation rule(s)\n", getEndpointId(), automationRules.getNumRules());
+
+    // The attribute storage pointer restored along with the buttons configuration is not valid anymore
+    updateAutomationRulesAttribute();
+}
+
+void SwitchEndpoint::saveAutomationRules()
+{
+    DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Save %d automation rule(s)\n", getEndpointId(), automationRules.getNumRules());
+    uint8 len = automationRules.store(automationRulesData, sizeof(automationRulesData));
+    if(len == 0)
+    {
+        PDM_vDeleteDataRecord(getPdmIdForEndpoint(getEndpointId(), PARAM_ID_AUTOMATION_RULES));
+        return;
+    }
+
+    PDM_eSaveRecordData(getPdmIdForEndpoint(getEndpointId(), PARAM_ID_AUTOMATION_RULES),
+                        automationRulesData,
+                        len);
+}
+
+void SwitchEndpoint::updateAutomationRulesAttribute()
+{
+    tsZCL_OctetString & attr = sOnOffConfigServerCluster.sAutomationRules;
+    attr.pu8Data = automationRulesData;
+    attr.u8MaxLength = sizeof(automationRulesData);
+    attr.u8Length = automationRules.store(automationRulesData, sizeof(automationRulesData));
+}
+
+void SwitchEndpoint::restoreScenes()
+{
+    uint8 data[SceneTable::MAX_SIZE];
+    uint16 readBytes = 0;
+    PDM_teStatus status = PDM_eReadDataFromRecord(getPdmIdForEndpoint(getEndpointId(), PARAM_ID_SCENES),
+                                                  data,
+                                                  sizeof(data),
+                                                  &readBytes);
+    if(status != PDM_E_STATUS_OK || !scenes.load(data, readBytes))
+        scenes.clear();
+
+    DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Restored %d scene(s)\n", getEndpointId(), scenes.getNumScenes());
+}
+
+void SwitchEndpoint::saveScenes()
+{
+    DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Save %d scene(s)\n", getEndpointId(), scenes.getNumScenes());
+
+    uint8 data[SceneTable::MAX_SIZE];
+    uint8 len = scenes.store(data, sizeof(data));
+    if(len == 0)
+    {
+        PDM_vDeleteDataRecord(getPdmIdForEndpoint(getEndpointId(), PARAM_ID_SCENES));
+        return;
+    }
+
+    PDM_eSaveRecordData(getPdmIdForEndpoint(getEndpointId(), PARAM_ID_SCENES), data, len);
+}
+
+void SwitchEndpoint::restoreScenesClusterTable()
+{
+    // The Scenes cluster keeps its table in RAM only. Rebuild it from the compact copy by storing each scene
+    // with the relay state temporarily set to the scene's one. Scenes refer to groups, so this is possible only
+    // when the stack (and its group table) is up.
+    bool_t currentState = sOnOffServerCluster.bOnOff;
+    for(uint8 i = 0; i < scenes.getNumScenes(); i++)
+    {
+        const SceneEntry & entry = scenes.getScene(i);
+        sOnOffServerCluster.bOnOff = entry.onOff ? TRUE : FALSE;
+        teZCL_Status status = eCLD_ScenesStore(getEndpointId(), entry.groupId, entry.sceneId);
+        if(status != E_ZCL_SUCCESS)
+            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Failed to restore scene %d of group %04x. status=%d\n",
+                        getEndpointId(), entry.sceneId, entry.groupId, status);
+    }
+    sOnOffServerCluster.bOnOff = currentState;
+}
+
+bool SwitchEndpoint::isGroupMember(uint16 groupId) const
+{
+    if(groupId == GLOBAL_SCENE_GROUP_ID)
+        return true;
+
+    // Group membership is kept in the APS group table, endpoint bits are counted from endpoint 1.
+    // Nodes configured without a group table have no members at all.
+    ZPS_tsAplAib * aib = ZPS_psAplAibGetAib();
+    ZPS_tsAplApsmeAIBGroupTable * groupTable = aib->psAplApsmeGroupTable;
+    if(groupTable == NULL || groupTable->psAplApsmeGroupTableId == NULL)
+        return false;
+
+    ZPS_tsAplApsmeGroupTableEntry * groupEntries = groupTable->psAplApsmeGroupTableId;
+    uint8 bit = getEndpointId() - 1;
+
+    for(uint32 i = 0; i < groupTable->u32SizeOfGroupTable; i++)
+        if(groupEntries[i].u16Groupid == groupId && (groupEntries[i].au8Endpoint[bit / 8] & (1 << (bit % 8))))
+            return true;
+
+    return false;
+}
+
+bool SwitchEndpoint::isCurrentScene(uint16 groupId, uint8 sceneId) const
+{
+    // The Scenes cluster marks a successfully stored or recalled scene as the current one
+    return sScenesServerCluster.bSceneValid
+        && sScenesServerCluster.u16CurrentGroup == groupId
+        && sScenesServerCluster.u8CurrentScene == sceneId;
+}
+
 void SwitchEndpoint::init()
 {
     // Register all clusters and endpoint itself
@@ -198,10 +373,12 @@ void SwitchEndpoint::init()
     registerMultistateInputServerCluster();
     registerLevelControlClientCluster();
     registerIdentifyCluster();
+    registerGroupsClientCluster();
     if(!clientOnly)
     {
         registerServerCluster();
         registerGroupsCluster();
+        registerScenesCluster();
     }
     registerEndpoint();
 
@@ -210,8 +387,18 @@ void SwitchEndpoint::init()
 
     // Restore previous configuration from PDM
     restoreButtonsConfiguration();
-    restoreReportingConfigurations();
+    restoreAutomationRules();
+    migrateReportingConfigurations();
+    if(!clientOnly)
+        restoreScenes();
     // TODO: restore previous brightness from PDM
+
+    // OnTime/OffWaitTime countdowns are driven by a shared low rate timer
+    if(!clientOnly)
+    {
+        TimedOffTask::getInstance()->registerEndpoint(this);
+        updateTimedOnOffAttributes();
+    }
 }
 
 bool SwitchEndpoint::getState() const
@@ -222,6 +409,12 @@ bool SwitchEndpoint::getState() const
     return false;
 }
 
+bool SwitchEndpoint::getAppliedState() const
+{
+    // State the relay was last switched to, which the SDK does not touch when it handles On/Off commands itself
+    return appliedState;
+}
+
 void SwitchEndpoint::switchOn()
 {
     // Handle toggle mode separately
@@ -270,64 +463,176 @@ void SwitchEndpoint::toggle()
         sendCommandToBoundDevices(E_CLD_ONOFF_CMD_TOGGLE);
 }
 
-void SwitchEndpoint::doStateChange(bool state, bool sourcedFromInterlockBuddy)
+void SwitchEndpoint::doStateChange(bool state)
 {
     // Disabled in Client mode
     if(!runsInServerMode())
         return;
 
+    // Change own state and the buddy's one (if interlocked) together
+    SwitchTransaction transaction;
+    transaction.setState(this, state);
+
+    if(interlockBuddy)
+        interlockBuddy->addInterlockState(&transaction, state);
+
+    transaction.commit();
+}
+
+void SwitchEndpoint::applyStateChange(bool state)
+{
+    // Called by the transaction for server mode endpoints only. Relay is switched by the transaction as well.
     DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: do state change %d\n", getEndpointId(), state);
+    bool previousState = appliedState;
     sOnOffServerCluster.bOnOff = state ? TRUE : FALSE;
+    appliedState = state;
+
+    // Any state change (button, On/Off commands, interlock, timeout) affects the OnTime/OffWaitTime countdown
+    timedOnOff.handleStateChange(previousState, state, SystemClock::getInstance()->getTimeMs());
+    updateTimedOnOffAttributes();
+    TimedOffTask::getInstance()->schedule();
 
     LEDTask::getInstance()->setFixedLevel(getEndpointId(), state ? 255 : 0);
-    RelayTask::getInstance()->setState(getEndpointId(), state);
     reportState();
+}
+
+bool SwitchEndpoint::handleOnWithTimedOff(uint8 onOffControl, uint16 onTime, uint16 offWaitTime)
+{
+    // Client only endpoints do not have the On/Off server
+    if(clientOnly)
+        return false;
+
+    DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: On With Timed Off: Control=%02x OnTime=%d OffWaitTime=%d\n",
+                getEndpointId(), onOffControl, onTime, offWaitTime);
 
-    // Let the buddy know about our state change
-    if(!sourcedFromInterlockBuddy && interlockBuddy)
-        interlockBuddy->setInterlockState(state);
+    // The command does not reach the SDK cluster (see EndpointManager::handleDataIndication()), so this is the only
+    // OnTime/OffWaitTime countdown
+    TimedOnOffAction action = timedOnOff.handleOnWithTimedOff(appliedState,
+                                                              (onOffControl & ONOFF_CONTROL_ACCEPT_ONLY_WHEN_ON) != 0,
+                                                              onTime,
+                                                              offWaitTime,
+                                                              SystemClock::getInstance()->getTimeMs());
+    updateTimedOnOffAttributes();
+
+    if(action != TIMED_ONOFF_NONE)
+        doStateChange(action == TIMED_ONOFF_SWITCH_ON);
+
+    TimedOffTask::getInstance()->schedule();
+    return true;
 }
 
-void SwitchEndpoint::reportState()
+void SwitchEndpoint::updateTimedOnOff()
 {
-    // Disabled in Client mode
     if(!runsInServerMode())
         return;
 
-    // Can send reports only when connected
-    if(!ZigbeeDevice::getInstance()->isJoined())
+    TimedOnOffAction action = timedOnOff.update(getState(), SystemClock::getInstance()->getTimeMs());
+    updateTimedOnOffAttributes();
+
+    if(action == TIMED_ONOFF_SWITCH_OFF)
     {
-        DBG_vPrintf(TRUE, "Device has not yet joined the network. Ignore reporting the change.\n");
-        return;
+        DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: On time is over\n", getEndpointId());
+        doStateChange(false);
     }
+}
 
-    // Destination address - 0x0000 (coordinator)
-    tsZCL_Address addr;
-    addr.uAddress.u16DestinationAddress = 0x0000;
-    addr.eAddressMode = E_ZCL_AM_SHORT;
+uint32 SwitchEndpoint::getTimeTillTimedChange() const
+{
+    if(!runsInServerMode())
+        return 0;
+
+    return timedOnOff.getTimeTillNextChange(getState(), SystemClock::getInstance()->getTimeMs());
+}
+
+void SwitchEndpoint::updateTimedOnOffAttributes()
+{
+    sOnOffServerCluster.u16OnTime = timedOnOff.getOnTime();
+    sOnOffServerCluster.u16OffWaitTime = timedOnOff.getOffWaitTime();
+}
 
-    // Send the report
+void SwitchEndpoint::reportState()
+{
+    // Schedule the report to the coordinator, it will be sent along with other changes made during this iteration.
+    // If the device is not on the network, the latest state is reported once it gets back.
     DBG_vPrintf(TRUE, "Reporting state change for EP=%d: State=%d... ", getEndpointId(), sOnOffServerCluster.bOnOff);
-    PDUM_thAPduInstance myPDUM_thAPduInstance = hZCL_AllocateAPduInstance();
-    teZCL_Status status = eZCL_ReportAttribute(&addr,
-                                               GENERAL_CLUSTER_ID_ONOFF,
-                                               E_CLD_ONOFF_ATTR_ID_ONOFF,
-                                               getEndpointId(),
-                                               1,
-                                               myPDUM_thAPduInstance);
-    PDUM_eAPduFreeAPduInstance(myPDUM_thAPduInstance);
+    teZCL_Status status = ReportManager::getInstance()->reportChange(getEndpointId(),
+                                                                     GENERAL_CLUSTER_ID_ONOFF,
+                                                                     E_CLD_ONOFF_ATTR_ID_ONOFF);
     DBG_vPrintf(TRUE, "status: %02x\n", status);
 }
 
 void SwitchEndpoint::sendCommandToBoundDevices(teCLD_OnOff_Command cmd)
 {
-    // Can send commands only when connected
+    // Nothing is bound, nothing to send
+    BindingTarget targets[BindingTable::MAX_TARGETS];
+    uint8 numTargets = BindingTable::getTargets(getEndpointId(), GENERAL_CLUSTER_ID_ONOFF, targets, BindingTable::MAX_TARGETS);
+    if(numTargets == 0)
+        return;
+
+    // Bindings to own endpoints (e.g. 'both buttons' endpoint bound to the relay endpoints) are served locally
+    // and right away, even off the network. Only the remote part of the command is ever held or retried.
+    if(BindingTable::hasLocalTargets(targets, numTargets))
+    {
+        bool remoteTargets = false;
+        for(uint8 i = 0; i < numTargets; i++)
+        {
+            if(targets[i].local)
+                EndpointManager::getInstance()->dispatchLoopbackOnOffCommand(getEndpointId(), targets[i].dstEndpoint, cmd);
+            else
+                remoteTargets = true;
+        }
+
+        if(!remoteTargets)
+            return;
+    }
+
+    // Commands issued while the network is not available are sent once the device gets back to the network
     if(!ZigbeeDevice::getInstance()->isJoined())
     {
-        DBG_vPrintf(TRUE, "Device has not yet joined the network. Ignore sending commands\n");
+        DBG_vPrintf(TRUE, "Device has not yet joined the network. Holding the command till the network is back\n");
+        DeliveryTracker::getInstance()->holdCommand(getEndpointId(), cmd);
         return;
     }
 
+    if(!transmitCommandToBoundDevices(cmd, targets, numTargets))
+        DeliveryTracker::getInstance()->handleCommandFailed(getEndpointId(), cmd);
+}
+
+bool SwitchEndpoint::replayBoundCommand(uint16 clusterId, uint8 commandId)
+{
+    if(clusterId != GENERAL_CLUSTER_ID_ONOFF)
+        return false;
+
+    BindingTarget targets[BindingTable::MAX_TARGETS];
+    uint8 numTargets = BindingTable::getTargets(getEndpointId(), GENERAL_CLUSTER_ID_ONOFF, targets, BindingTable::MAX_TARGETS);
+    return transmitCommandToBoundDevices((teCLD_OnOff_Command)commandId, targets, numTargets);
+}
+
+bool SwitchEndpoint::transmitCommandToBoundDevices(teCLD_OnOff_Command cmd, const BindingTarget * targets, uint8 numTargets)
+{
+    // Sends the command to the remote targets only, own endpoints have already got it
+    if(numTargets == 0)
+        return true;
+
+    if(BindingTable::hasLocalTargets(targets, numTargets))
+    {
+        // A bound send would also deliver the command to own endpoints, so address remote targets one by one
+        bool success = true;
+        for(uint8 i = 0; i < numTargets; i++)
+            if(!targets[i].local && sendCommandToTarget(cmd, targets[i]) != E_ZCL_SUCCESS)
+                success = false;
+
+        ZigbeeDevice::getInstance()->triggerFastPoll();
+        return success;
+    }
+
+    // Commands bound to many devices may go as a single groupcast
+    if(GroupFanout::getInstance()->sendCommand(getEndpointId(), cmd, targets, numTargets))
+    {
+        ZigbeeDevice::getInstance()->triggerFastPoll();
+        return true;
+    }
+
     // Destination address does not matter - we will send to all bound devices
     tsZCL_Address addr;
     addr.uAddress.u16DestinationAddress = 0x0000;
@@ -340,7 +645,38 @@ void SwitchEndpoint::sendCommandToBoundDevices(teCLD_OnOff_Command cmd)
                                    &addr,
                                    &sequenceNo,
                                    cmd);
+    DiagnosticsCollector::getInstance()->handleSendStatus(status);
     DBG_vPrintf(TRUE, "Sending On/Off command status: %02x\n", status);
+
+    // Sleepy devices shall pick up possible responses quickly
+    ZigbeeDevice::getInstance()->triggerFastPoll();
+    return status == E_ZCL_SUCCESS;
+}
+
+teZCL_Status SwitchEndpoint::sendCommandToTarget(teCLD_OnOff_Command cmd, const BindingTarget & target)
+{
+    // Bound send would also deliver the command to own endpoints, so address the remote target explicitly
+    tsZCL_Address addr;
+    if(target.addrMode == ZPS_E_ADDR_MODE_GROUP)
+    {
+        addr.uAddress.u16GroupAddress = target.groupAddr;
+        addr.eAddressMode = E_ZCL_AM_GROUP;
+    }
+    else
+    {
+        addr.uAddress.u64DestinationAddress = target.ieeeAddr;
+        addr.eAddressMode = E_ZCL_AM_IEEE;
+    }
+
+    uint8 sequenceNo;
+    teZCL_Status status = eCLD_OnOffCommandSend(getEndpointId(),
+                                   target.dstEndpoint,
+                                   &addr,
+                                   &sequenceNo,
+                                   cmd);
+    DiagnosticsCollector::getInstance()->handleSendStatus(status);
+    DBG_vPrintf(TRUE, "Sending On/Off command status: %02x\n", status);
+    return status;
 }
 
 void SwitchEndpoint::reportLongPress(bool pressed)
@@ -396,6 +732,7 @@ void SwitchEndpoint::sendLevelControlMoveCommand(bool up)
                                                                   &sequenceNo,
                                                                   up ? TRUE : FALSE,    // Up will turn on the light, down will not turn off
                                                                   &payload);
+    DiagnosticsCollector::getInstance()->handleSendStatus(status);
     DBG_vPrintf(TRUE, "Sending Level Control Move command status: %02x\n", status);
 }
 
@@ -418,37 +755,97 @@ void SwitchEndpoint::sendLevelControlStopCommand()
                                                                   &sequenceNo,
                                                                   FALSE,
                                                                   &payload);
+    DiagnosticsCollector::getInstance()->handleSendStatus(status);
     DBG_vPrintf(TRUE, "Sending Level Control Stop command status: %02x\n", status);
 }
 
+void SwitchEndpoint::executeAutomationRules(ButtonActionType action)
+{
+    uint8 indexes[RuleTable::MAX_RULES];
+    uint8 numRules = automationRules.findRules(action, indexes, RuleTable::MAX_RULES);
+    if(numRules == 0)
+        return;
+
+    uint32 startTime = SystemClock::getInstance()->getTimeMs();
+    for(uint8 i = 0; i < numRules; i++)
+        executeAutomationRule(automationRules.getRule(indexes[i]));
+
+    DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Executed %d automation rule(s) for action %d in %d ms\n",
+                getEndpointId(), numRules, action, SystemClock::getInstance()->getTimeMs() - startTime);
+}
+
+void SwitchEndpoint::executeAutomationRule(const AutomationRule & rule)
+{
+    uint8 targetEndpoint = rule.targetEndpoint ? rule.targetEndpoint : getEndpointId();
+
+    switch(rule.action)
+    {
+        case AUTOMATION_ACTION_LOCAL_ONOFF:
+            EndpointManager::getInstance()->dispatchLoopbackOnOffCommand(getEndpointId(), targetEndpoint, rule.command);
+            break;
+
+        case AUTOMATION_ACTION_BOUND_ONOFF:
+            sendCommandToBoundDevices((teCLD_OnOff_Command)rule.command);
+            break;
+
+        case AUTOMATION_ACTION_GROUP_ONOFF:
+        {
+            if(!ZigbeeDevice::getInstance()->isJoined())
+            {
+                DBG_vPrintf(TRUE, "Device has not yet joined the network. Ignore sending commands\n");
+                break;
+            }
+
+            BindingTarget target;
+            target.addrMode = ZPS_E_ADDR_MODE_GROUP;
+            target.groupAddr = rule.param;
+            target.dstEndpoint = ALL_ENDPOINTS;
+            target.ieeeAddr = 0;
+            target.local = false;
+            sendCommandToTarget((teCLD_OnOff_Command)rule.command, target);
+            ZigbeeDevice::getInstance()->triggerFastPoll();
+            break;
+        }
+
+        case AUTOMATION_ACTION_LED_EFFECT:
+            LEDTask::getInstance()->triggerEffect(targetEndpoint, (uint8)rule.param);
+            break;
+
+        default:
+            break;
+    }
+}
+
 void SwitchEndpoint::reportAction(ButtonActionType action)
 {
+    // Rules are executed right here, and work even when the network is not available
+    executeAutomationRules(action);
+
+    // Actions are events rather than a state. Make sure the previous action is sent before it is overwritten.
+    ReportAggregator::getInstance()->flushAttribute(getEndpointId(),
+                                                    GENERAL_CLUSTER_ID_MULTISTATE_INPUT_BASIC,
+                                                    E_CLD_MULTISTATE_INPUT_BASIC_ATTR_ID_PRESENT_VALUE);
+
     // Store new value in the cluster
     sMultistateInputServerCluster.u16PresentValue = (zuint16)action;
 
-    // Prevent bothering Zigbee API if not connected
+    // Unlike the state, an action is an event. Reporting it long after it has happened makes little sense.
     if(!ZigbeeDevice::getInstance()->isJoined())
     {
         DBG_vPrintf(TRUE, "Device has not yet joined the network. Ignore reporting the change.\n");
+        DeliveryTracker::getInstance()->handleReportDropped();
         return;
     }
 
-    // Destination address - 0x0000 (coordinator)
-    tsZCL_Address addr;
-    addr.uAddress.u16DestinationAddress = 0x0000;
-    addr.eAddressMode = E_ZCL_AM_SHORT;
-
-    // Send the report
+    // Schedule the report to the coordinator
     DBG_vPrintf(TRUE, "Reporting multistate action EP=%d value=%d... ", getEndpointId(), sMultistateInputServerCluster.u16PresentValue);
-    PDUM_thAPduInstance myPDUM_thAPduInstance = hZCL_AllocateAPduInstance();
-    teZCL_Status status = eZCL_ReportAttribute(&addr,
-                                               GENERAL_CLUSTER_ID_MULTISTATE_INPUT_BASIC,
-                                               E_CLD_MULTISTATE_INPUT_BASIC_ATTR_ID_PRESENT_VALUE,
-                                               getEndpointId(),
-                                               1,
-                                               myPDUM_thAPduInstance);
-    PDUM_eAPduFreeAPduInstance(myPDUM_thAPduInstance);
+    teZCL_Status status = ReportAggregator::getInstance()->markDirty(getEndpointId(),
+                                                                     GENERAL_CLUSTER_ID_MULTISTATE_INPUT_BASIC,
+                                                                     E_CLD_MULTISTATE_INPUT_BASIC_ATTR_ID_PRESENT_VALUE);
     DBG_vPrintf(TRUE, "status: %02x\n", status);
+
+    // User interacts with the device, so it is likely that some commands will follow
+    ZigbeeDevice::getInstance()->triggerFastPoll();
 }
 
 void SwitchEndpoint::handleCustomClusterEvent(tsZCL_CallBackEvent *psEvent)
@@ -469,6 +866,14 @@ void SwitchEndpoint::handleCustomClusterEvent(tsZCL_CallBackEvent *psEvent)
             handleGroupsClusterCommand(psEvent);
             break;
 
+        case GENERAL_CLUSTER_ID_ONOFF_SWITCH_CONFIGURATION:
+            handleOOSCClusterCommand(psEvent);
+            break;
+
+        case GENERAL_CLUSTER_ID_SCENES:
+            handleScenesClusterCommand(psEvent);
+            break;
+
         default:
             DBG_vPrintf(TRUE, "SwitchEndpoint: EP=%d: Warning: Unexpected custom cluster event ClusterID=%04x\n", 
                         getEndpointId(), clusterId);
@@ -488,6 +893,8 @@ void SwitchEndpoint::handleOnOffClusterCommand(tsZCL_CallBackEvent *psEvent)
         return;
     }
 
+    // On/Off/Toggle are applied by the cluster itself and come as a cluster update event. On With Timed Off is
+    // handled before it gets to ZCL.
     DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: On/Off Cluster command received Cmd=%02x. Ignored.\n",
                 psEvent->u8EndPoint,
                 commandId);
@@ -522,12 +929,208 @@ void SwitchEndpoint::handleGroupsClusterCommand(tsZCL_CallBackEvent *psEvent)
     uint8 commandId = msg->u8CommandId;
     uint8 ep = psEvent->u8EndPoint;
 
+    // Responses from the bound devices to our Groups client
+    if(!psEvent->psClusterInstance->bIsServer)
+    {
+        ZPS_tsAfDataIndEvent * pInd = &psEvent->pZPSevent->uEvent.sApsDataIndEvent;
+        uint64 srcAddr = (pInd->u8SrcAddrMode == ZPS_E_ADDR_MODE_IEEE) ?
+                            pInd->uSrcAddress.u64Addr :
+                            ZPS_u64AplZdoLookupIeeeAddr(pInd->uSrcAddress.u16Addr);
+        GroupFanout::getInstance()->handleGroupsResponse(ep, srcAddr, pInd->u8SrcEndpoint, msg);
+        return;
+    }
+
     if(clientOnly) {
         DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Warning: Groups cluster command Cmd=%d received on CLIENT ONLY endpoint\n", ep, commandId);
         return;
     }
 
     DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Groups cluster command Cmd=%d\n", ep, commandId);
+
+    // Scenes of a group leave together with the group
+    switch(commandId)
+    {
+        case E_CLD_GROUPS_CMD_REMOVE_GROUP:
+            if(scenes.removeGroup(msg->uMessage.psRemoveGroupRequestPayload->u16GroupId) != 0)
+                saveScenes();
+            break;
+
+        case E_CLD_GROUPS_CMD_REMOVE_ALL_GROUPS:
+            if(scenes.getNumScenes() != 0)
+            {
+                scenes.clear();
+                saveScenes();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void SwitchEndpoint::handleOOSCClusterCommand(tsZCL_CallBackEvent *psEvent)
+{
+    tsCLD_OOSCCallBackMessage * msg = (tsCLD_OOSCCallBackMessage*)psEvent->uMessage.sClusterCustomMessage.pvCustomData;
+    uint8 ep = psEvent->u8EndPoint;
+
+    switch(msg->u8CommandId)
+    {
+        case E_CLD_OOSC_CMD_COLLAPSE_TO_GROUP:
+        {
+            uint16 groupId = msg->uMessage.psCollapseToGroupPayload->u16GroupId;
+            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Collapse bindings to group %04x requested\n", ep, groupId);
+            GroupFanout::getInstance()->collapseToGroup(ep, groupId);
+            break;
+        }
+
+        default:
+            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Unexpected OOSC command Cmd=%d\n", ep, msg->u8CommandId);
+            break;
+    }
+}
+
+void SwitchEndpoint::handleScenesClusterCommand(tsZCL_CallBackEvent *psEvent)
+{
+    tsCLD_ScenesCallBackMessage * msg = (tsCLD_ScenesCallBackMessage*)psEvent->uMessage.sClusterCustomMessage.pvCustomData;
+    uint8 commandId = msg->u8CommandId;
+    uint8 ep = psEvent->u8EndPoint;
+
+    if(clientOnly)
+    {
+        DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Warning: Scenes cluster command Cmd=%d received on CLIENT ONLY endpoint\n", ep, commandId);
+        return;
+    }
+
+    // The Scenes cluster maintains its own table and sends responses. The compact copy is kept in sync here,
+    // so that it can be persisted, and recalled scenes are applied to the relay through the regular path.
+    // Add, Store and Recall may still be rejected by the cluster, so those are completed only after the cluster has
+    // processed the command (see handleZclEventProcessed()).
+    pendingScene.active = false;
+    switch(commandId)
+    {
+        case E_CLD_SCENES_CMD_ADD:
+        {
+            tsCLD_ScenesAddSceneRequestPayload * payload = msg->uMessage.psAddSceneRequestPayload;
+            if(!isGroupMember(payload->u16GroupId))
+            {
+                DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Not a member of group %04x. Scene %d not added\n", ep, payload->u16GroupId, payload->u8SceneId);
+                break;
+            }
+
+            bool onOff;
+            if(!SceneTable::parseOnOffExtension(payload->sExtensionField.pu8Data, payload->sExtensionField.u16Length, &onOff))
+            {
+                DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Scene %d of group %04x has no On/Off field. Not persisted\n",
+                            ep, payload->u8SceneId, payload->u16GroupId);
+                break;
+            }
+
+            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Add scene %d of group %04x State=%d\n", ep, payload->u8SceneId, payload->u16GroupId, onOff);
+            setPendingScene(commandId, payload->u16GroupId, payload->u8SceneId, onOff);
+            break;
+        }
+
+        case E_CLD_SCENES_CMD_STORE:
+        {
+            tsCLD_ScenesStoreSceneRequestPayload * payload = msg->uMessage.psStoreSceneRequestPayload;
+            if(!isGroupMember(payload->u16GroupId))
+            {
+                DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Not a member of group %04x. Scene %d not stored\n", ep, payload->u16GroupId, payload->u8SceneId);
+                break;
+            }
+
+            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Store scene %d of group %04x State=%d\n", ep, payload->u8SceneId, payload->u16GroupId, getState());
+            setPendingScene(commandId, payload->u16GroupId, payload->u8SceneId, getState());
+            break;
+        }
+
+        case E_CLD_SCENES_CMD_REMOVE:
+        {
+            tsCLD_ScenesRemoveSceneRequestPayload * payload = msg->uMessage.psRemoveSceneRequestPayload;
+            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Remove scene %d of group %04x\n", ep, payload->u8SceneId, payload->u16GroupId);
+            if(scenes.removeScene(payload->u16GroupId, payload->u8SceneId))
+                saveScenes();
+            break;
+        }
+
+        case E_CLD_SCENES_CMD_REMOVE_ALL:
+        {
+            uint16 groupId = msg->uMessage.psRemoveAllScenesRequestPayload->u16GroupId;
+            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Remove all scenes of group %04x\n", ep, groupId);
+            if(scenes.removeGroup(groupId) != 0)
+                saveScenes();
+            break;
+        }
+
+        case E_CLD_SCENES_CMD_RECALL:
+        {
+            tsCLD_ScenesRecallSceneRequestPayload * payload = msg->uMessage.psRecallSceneRequestPayload;
+            if(!isGroupMember(payload->u16GroupId))
+            {
+                DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Not a member of group %04x. Scene %d not recalled\n", ep, payload->u16GroupId, payload->u8SceneId);
+                break;
+            }
+
+            bool onOff;
+            if(!scenes.findScene(payload->u16GroupId, payload->u8SceneId, &onOff))
+            {
+                DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Unknown scene %d of group %04x\n", ep, payload->u8SceneId, payload->u16GroupId);
+                break;
+            }
+
+            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Recall scene %d of group %04x State=%d\n", ep, payload->u8SceneId, payload->u16GroupId, onOff);
+            setPendingScene(commandId, payload->u16GroupId, payload->u8SceneId, onOff);
+            break;
+        }
+
+        default:
+            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Scenes cluster command Cmd=%d\n", ep, commandId);
+            break;
+    }
+}
+
+void SwitchEndpoint::setPendingScene(uint8 commandId, uint16 groupId, uint8 sceneId, bool onOff)
+{
+    pendingScene.active = true;
+    pendingScene.commandId = commandId;
+    pendingScene.groupId = groupId;
+    pendingScene.sceneId = sceneId;
+    pendingScene.onOff = onOff;
+    pendingScene.sceneCount = sScenesServerCluster.u8SceneCount;
+}
+
+void SwitchEndpoint::handleZclEventProcessed()
+{
+    if(!pendingScene.active)
+        return;
+    pendingScene.active = false;
+
+    // The cluster reports the command status in its response only, its attributes tell whether the command succeeded.
+    // Adding a scene grows the scene count, unless an existing scene is replaced.
+    bool success = isCurrentScene(pendingScene.groupId, pendingScene.sceneId);
+    if(pendingScene.commandId == E_CLD_SCENES_CMD_ADD)
+    {
+        bool onOff;
+        bool replaced = scenes.findScene(pendingScene.groupId, pendingScene.sceneId, &onOff);
+        success = sScenesServerCluster.u8SceneCount > pendingScene.sceneCount
+               || (replaced && sScenesServerCluster.u8SceneCount == pendingScene.sceneCount);
+    }
+
+    if(!success)
+    {
+        DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Scenes command Cmd=%d for scene %d of group %04x rejected by the cluster\n",
+                    getEndpointId(), pendingScene.commandId, pendingScene.sceneId, pendingScene.groupId);
+        return;
+    }
+
+    if(pendingScene.commandId == E_CLD_SCENES_CMD_RECALL)
+    {
+        doStateChange(pendingScene.onOff);
+        return;
+    }
+
+    if(scenes.storeScene(pendingScene.groupId, pendingScene.sceneId, pendingScene.onOff))
+        saveScenes();
 }
 
 void SwitchEndpoint::handleClusterUpdate(tsZCL_CallBackEvent *psEvent)
@@ -577,6 +1180,28 @@ void SwitchEndpoint::handleWriteAttributeCompleted(tsZCL_CallBackEvent *psEvent)
     uint16 clusterId = psEvent->psClusterInstance->psClusterDefinition->u16ClusterEnum;
     uint16 attrId = psEvent->uMessage.sIndividualAttributeResponse.u16AttributeEnum;
 
+    // Restart the countdown with the written value
+    if(clusterId == GENERAL_CLUSTER_ID_ONOFF)
+    {
+        uint32 now = SystemClock::getInstance()->getTimeMs();
+        switch(attrId)
+        {
+            case E_CLD_ONOFF_ATTR_ID_ON_TIME:
+                timedOnOff.setOnTime(sOnOffServerCluster.u16OnTime, now);
+                break;
+
+            case E_CLD_ONOFF_ATTR_ID_OFF_WAIT_TIME:
+                timedOnOff.setOffWaitTime(sOnOffServerCluster.u16OffWaitTime, now);
+                break;
+
+            default:
+                break;
+        }
+
+        TimedOffTask::getInstance()->schedule();
+        return;
+    }
+
     // Update buttons state machine with received value
     if(clusterId == GENERAL_CLUSTER_ID_ONOFF_SWITCH_CONFIGURATION)
     {
@@ -598,6 +1223,19 @@ void SwitchEndpoint::handleWriteAttributeCompleted(tsZCL_CallBackEvent *psEvent)
                 buttonHandler.setMinLongPress(sOnOffConfigServerCluster.iMinLongPress);
                 break;
 
+            case E_CLD_OOSC_ATTR_ID_AUTOMATION_RULES:
+            {
+                // The new value is already in the attribute storage. Accept it only if all the rules are valid.
+                tsZCL_OctetString & attr = sOnOffConfigServerCluster.sAutomationRules;
+                if(automationRules.load(attr.pu8Data, attr.u8Length))
+                    saveAutomationRules();
+                else
+                    DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Invalid automation rules. Keeping the previous ones\n", getEndpointId());
+
+                updateAutomationRulesAttribute();
+                break;
+            }
+
             case E_CLD_OOSC_ATTR_ID_SWITCH_INTERLOCK_MODE:
                 if (interlockBuddy)
                 {
@@ -635,13 +1273,6 @@ teZCL_CommandStatus SwitchEndpoint::handleCheckAttributeRange(tsZCL_CallBackEven
     return E_ZCL_CMDS_SUCCESS;
 }
 
-void SwitchEndpoint::handleReportingConfigureRequest(tsZCL_CallBackEvent *psEvent)
-{
-    uint16 clusterID = psEvent->psClusterInstance->psClusterDefinition->u16ClusterEnum;
-    tsZCL_AttributeReportingConfigurationRecord * record = &psEvent->uMessage.sAttributeReportingConfigurationRecord;
-    addReportConfiguration(clusterID, record);
-}
-
 void SwitchEndpoint::setInterlockMode(teCLD_OOSC_InterlockMode mode)
 {
     sOnOffConfigServerCluster.eInterlockMode = mode;
@@ -649,14 +1280,25 @@ void SwitchEndpoint::setInterlockMode(teCLD_OOSC_InterlockMode mode)
 
 void SwitchEndpoint::setInterlockState(bool buddyState)
 {
+    SwitchTransaction transaction;
+    addInterlockState(&transaction, buddyState);
+    transaction.commit();
+}
+
+void SwitchEndpoint::addInterlockState(SwitchTransaction * transaction, bool buddyState)
+{
+    // Disabled in Client mode
+    if(!runsInServerMode())
+        return;
+
     // In mutual exclusion mode prevent both endpoints to be ON
     if(sOnOffConfigServerCluster.eInterlockMode == E_CLD_OOSC_INTERLOCK_MODE_MUTEX)
-        // Always call doStateChange() to prevent tests go out of sync
-        doStateChange(getState() && !buddyState, true);
+        // Always change the state to prevent tests go out of sync
+        transaction->setState(this, sOnOffServerCluster.bOnOff && !buddyState);
 
     // In opposite mode endpoints always have different states
     if(sOnOffConfigServerCluster.eInterlockMode == E_CLD_OOSC_INTERLOCK_MODE_OPPOSITE)
-        doStateChange(!buddyState, true);
+        transaction->setState(this, !buddyState);
 }
 
 bool SwitchEndpoint::runsInServerMode() const
@@ -673,6 +1315,10 @@ void SwitchEndpoint::handleDeviceJoin()
 {
     // Force resetting the LED
     doStateChange(getState());
+
+    // Group table is available now
+    if(!clientOnly)
+        restoreScenesClusterTable();
 }
 
 void SwitchEndpoint::handleDeviceLeave()
@@ -681,93 +1327,66 @@ void SwitchEndpoint::handleDeviceLeave()
     doStateChange(getState());
 }
 
-void SwitchEndpoint::initReportingConfigurations()
+bool SwitchEndpoint::handleLoopbackOnOffCommand(uint8 commandId)
 {
-    memset(reportConfigurations, 0, sizeof(reportConfigurations));
-    saveReportingConfigurations();
-}
+    if(!runsInServerMode())
+        return false;
 
-void SwitchEndpoint::saveReportingConfigurations()
-{
-    DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Save reporting configuration\n", getEndpointId());
-    PDM_eSaveRecordData(getPdmIdForEndpoint(getEndpointId(), PARAM_ID_REPORTING_CONFIG),
-                        reportConfigurations,
-                        sizeof(reportConfigurations));
+    DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Loopback On/Off command Cmd=%02x\n", getEndpointId(), commandId);
+
+    switch(commandId)
+    {
+        case E_CLD_ONOFF_CMD_OFF:
+            doStateChange(false);
+            break;
+
+        case E_CLD_ONOFF_CMD_ON:
+            doStateChange(true);
+            break;
+
+        case E_CLD_ONOFF_CMD_TOGGLE:
+            doStateChange(!sOnOffServerCluster.bOnOff);
+            break;
+
+        default:
+            return false;
+    }
+
+    return true;
 }
 
-void SwitchEndpoint::restoreReportingConfigurations()
+void SwitchEndpoint::migrateReportingConfigurations()
 {
-    // Read values from PDM
+    // Reporting configuration used to be stored per endpoint, limited by the ZCL reports table. It is kept by
+    // ReportManager now, the old record is moved there once.
+    ReportConfiguration reportConfigurations[ZCL_NUMBER_OF_REPORTS];
     uint16 readBytes;
     PDM_teStatus status = PDM_eReadDataFromRecord(getPdmIdForEndpoint(getEndpointId(), PARAM_ID_REPORTING_CONFIG),
                                                   reportConfigurations,
                                                   sizeof(reportConfigurations),
                                                   &readBytes);
-
-    // During the first run it may happen that there is no record in PDM, and we need to initialize it
     if(status != PDM_E_STATUS_OK)
-    {
-        DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: No PDM record for reporting configuration. Create a new one. status=%d\n", getEndpointId(), status);
-        initReportingConfigurations();
         return;
-    }
 
-    // Iterate over the loaded array and re-register all reporting configurations
     for(int i = 0; i < ZCL_NUMBER_OF_REPORTS; i++)
     {
         if(reportConfigurations[i].clusterID != 0)
         {
-            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Restore reporting configuration: ClusterID=%04x, AttrID=%04x, Min=%d, Max=%d, Timeout=%d\n",
+            DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Migrate reporting configuration: ClusterID=%04x, AttrID=%04x, Min=%d, Max=%d\n",
                         getEndpointId(),
                         reportConfigurations[i].clusterID,
                         reportConfigurations[i].record.u16AttributeEnum,
                         reportConfigurations[i].record.u16MinimumReportingInterval,
-                        reportConfigurations[i].record.u16MaximumReportingInterval,
-                        reportConfigurations[i].record.u16TimeoutPeriodField);
-
-            eZCL_SetReportableFlag( getEndpointId(), 
-                                    reportConfigurations[i].clusterID, 
-                                    TRUE, 
-                                    FALSE, 
-                                    reportConfigurations[i].record.u16AttributeEnum);
-            eZCL_CreateLocalReport( getEndpointId(), 
-                                    reportConfigurations[i].clusterID, 
-                                    0, 
-                                    TRUE, 
-                                    &reportConfigurations[i].record);
+                        reportConfigurations[i].record.u16MaximumReportingInterval);
+
+            ReportManager::getInstance()->configureReport(getEndpointId(),
+                                                          reportConfigurations[i].clusterID,
+                                                          reportConfigurations[i].record.u16AttributeEnum,
+                                                          reportConfigurations[i].record.u16MinimumReportingInterval,
+                                                          reportConfigurations[i].record.u16MaximumReportingInterval,
+                                                          ReportManager::getReportableChange(&reportConfigurations[i].record));
         }
     }
-}
-
-uint8 SwitchEndpoint::findReportingConfiguration(uint16 clusterID, uint16 attributeID)
-{
-    for(int i = 0; i < ZCL_NUMBER_OF_REPORTS; i++)
-    {
-        // Check if we found an empty slot
-        if(reportConfigurations[i].clusterID == 0)
-            return i;
-
-        // Search for a record that match passed parameters
-        if(reportConfigurations[i].clusterID == clusterID && reportConfigurations[i].record.u16AttributeEnum == attributeID)
-            return i;
-    }
-
-    // We have not found a record, and there is no empty slot to store a new one
-    return ZCL_NUMBER_OF_REPORTS;
-}
-
-void SwitchEndpoint::addReportConfiguration(uint16 clusterID, tsZCL_AttributeReportingConfigurationRecord * record)
-{
-    uint8 index = findReportingConfiguration(clusterID, record->u16AttributeEnum);
-    if(index == ZCL_NUMBER_OF_REPORTS)
-    {
-        DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Warning: No space for new reporting configuration\n", getEndpointId());
-        return;
-    }
 
-    // Store the new configuration
-    reportConfigurations[index].clusterID = clusterID;
-    reportConfigurations[index].record = *record;
-    DBG_vPrintf(TRUE, "SwitchEndpoint EP=%d: Store reporting configuration record at index %d\n", getEndpointId(), index);
-    saveReportingConfigurations();
+    PDM_vDeleteDataRecord(getPdmIdForEndpoint(getEndpointId(), PARAM_ID_REPORTING_CONFIG));
 }
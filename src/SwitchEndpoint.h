@@ -12,17 +12,16 @@ extern "C"
     #include "LevelControl.h"
     #include "Identify.h"
     #include "Groups.h"
+    #include "Scenes.h"
 }
 
 #include "Endpoint.h"
 #include "ButtonHandler.h"
-
-// A reporting configuration record to save in PDM
-struct ReportConfiguration
-{
-    uint8 clusterID;
-    tsZCL_AttributeReportingConfigurationRecord record;
-};
+#include "SwitchTransaction.h"
+#include "BindingTable.h"
+#include "RuleTable.h"
+#include "TimedOnOff.h"
+#include "SceneTable.h"
 
 // List of cluster instances (descriptor objects) that are included into the endpoint
 // The clusters defined in this list work for both client and server modes. 
@@ -38,14 +37,17 @@ struct OnOffClientClusterInstances
     tsZCL_ClusterInstance sMultistateInputServer;
     tsZCL_ClusterInstance sLevelControlClient;
     tsZCL_ClusterInstance sIdentifyServer;
+    tsZCL_ClusterInstance sGroupsClient;
 } __attribute__ ((aligned(4)));
 
 // List of additional clusters for server mode
-// Note: In server mode the switch has its internal state, can report state attributes, and can be assigned to a group
+// Note: In server mode the switch has its internal state, can report state attributes, can be assigned to a group,
+//       and can be a member of scenes
 struct OnOffServerClusterInstances
 {
     tsZCL_ClusterInstance sOnOffServer;
     tsZCL_ClusterInstance sGroupsServer;
+    tsZCL_ClusterInstance sScenesServer;
 } __attribute__ ((aligned(4)));
 
 // This structure is used just to ensure client and server clusters are layed out consecutively in memory
@@ -55,6 +57,17 @@ struct OnOffClusterInstances
     OnOffServerClusterInstances server;
 } __attribute__ ((aligned(4)));
 
+// Scenes command waiting for the Scenes cluster to complete it. See SwitchEndpoint::handleZclEventProcessed()
+struct PendingSceneCommand
+{
+    bool active;
+    uint8 commandId;
+    uint16 groupId;
+    uint8 sceneId;
+    bool onOff;
+    uint8 sceneCount;           // SceneCount attribute before the command
+};
+
 class SwitchEndpoint: public Endpoint
 {    
 protected:
@@ -63,6 +76,7 @@ protected:
     tsCLD_OnOff sOnOffClientCluster;
     tsCLD_OnOff sOnOffServerCluster;
     tsCLD_OOSC sOnOffConfigServerCluster;
+    tsCLD_OOSCCustomDataStructure sOnOffConfigServerCustomDataStructure;
     tsCLD_OnOffCustomDataStructure sOnOffServerCustomDataStructure;
     tsCLD_MultistateInputBasic sMultistateInputServerCluster;
     tsCLD_LevelControlClient sLevelControlClientCluster;
@@ -71,11 +85,20 @@ protected:
     tsCLD_IdentifyCustomDataStructure sIdentifyClusterData;
     tsCLD_Groups sGroupsServerCluster;
     tsCLD_GroupsCustomDataStructure sGroupsServerCustomDataStructure;
+    tsCLD_Groups sGroupsClientCluster;
+    tsCLD_GroupsCustomDataStructure sGroupsClientCustomDataStructure;
+    tsCLD_Scenes sScenesServerCluster;
+    tsCLD_ScenesCustomDataStructure sScenesServerCustomDataStructure;
 
     ButtonHandler buttonHandler;
     bool clientOnly;
     SwitchEndpoint * interlockBuddy;
-    ReportConfiguration reportConfigurations[ZCL_NUMBER_OF_REPORTS];
+    RuleTable automationRules;
+    uint8 automationRulesData[RuleTable::MAX_SIZE];
+    TimedOnOff timedOnOff;
+    bool appliedState;
+    SceneTable scenes;
+    PendingSceneCommand pendingScene;
 
 public:
     SwitchEndpoint();
@@ -84,6 +107,7 @@ public:
     virtual void init();
 
     bool getState() const;
+    bool getAppliedState() const;
     void switchOn();
     void switchOff();
     void toggle();
@@ -94,19 +118,31 @@ public:
 
     void setInterlockMode(teCLD_OOSC_InterlockMode mode);
     void setInterlockState(bool buddyState);
+    void applyStateChange(bool state);
+
+    void updateTimedOnOff();
+    uint32 getTimeTillTimedChange() const;
 
 protected:
-    void doStateChange(bool state, bool sourcedFromInterlockBuddy = false);
+    void doStateChange(bool state);
+    void addInterlockState(SwitchTransaction * transaction, bool buddyState);
     void reportState();
     void sendCommandToBoundDevices(teCLD_OnOff_Command cmd);
+    bool transmitCommandToBoundDevices(teCLD_OnOff_Command cmd, const BindingTarget * targets, uint8 numTargets);
+    teZCL_Status sendCommandToTarget(teCLD_OnOff_Command cmd, const BindingTarget & target);
     void sendLevelControlMoveCommand(bool up);
     void sendLevelControlStopCommand();
+    void executeAutomationRules(ButtonActionType action);
+    void executeAutomationRule(const AutomationRule & rule);
+    void updateTimedOnOffAttributes();
 
 protected:
     virtual void initEndpointStructure();
     virtual void registerServerCluster();
     virtual void registerClientCluster();
     virtual void registerGroupsCluster();
+    virtual void registerGroupsClientCluster();
+    virtual void registerScenesCluster();
     virtual void registerOnOffConfigServerCluster();
     virtual void registerMultistateInputServerCluster();
     virtual void registerLevelControlClientCluster();
@@ -116,16 +152,25 @@ protected:
     virtual void restoreButtonsConfiguration();
     virtual void saveButtonsConfiguration();
 
-    virtual void initReportingConfigurations();
-    virtual void saveReportingConfigurations();
-    virtual void restoreReportingConfigurations();
-    virtual uint8 findReportingConfiguration(uint16 clusterID, uint16 attributeID);
-    virtual void addReportConfiguration(uint16 clusterID, tsZCL_AttributeReportingConfigurationRecord * record);
+    virtual void restoreAutomationRules();
+    virtual void saveAutomationRules();
+    virtual void updateAutomationRulesAttribute();
+
+    virtual void restoreScenes();
+    virtual void saveScenes();
+    virtual void restoreScenesClusterTable();
+    bool isGroupMember(uint16 groupId) const;
+    bool isCurrentScene(uint16 groupId, uint8 sceneId) const;
+    void setPendingScene(uint8 commandId, uint16 groupId, uint8 sceneId, bool onOff);
+
+    virtual void migrateReportingConfigurations();
 
     virtual void handleCustomClusterEvent(tsZCL_CallBackEvent *psEvent);
     virtual void handleOnOffClusterCommand(tsZCL_CallBackEvent *psEvent);
     virtual void handleIdentifyClusterCommand(tsZCL_CallBackEvent *psEvent);
     virtual void handleGroupsClusterCommand(tsZCL_CallBackEvent *psEvent);
+    virtual void handleOOSCClusterCommand(tsZCL_CallBackEvent *psEvent);
+    virtual void handleScenesClusterCommand(tsZCL_CallBackEvent *psEvent);
 
     virtual void handleClusterUpdate(tsZCL_CallBackEvent *psEvent);
     virtual void handleOnOffClusterUpdate(tsZCL_CallBackEvent *psEvent);
@@ -133,10 +178,13 @@ protected:
     virtual void handleWriteAttributeCompleted(tsZCL_CallBackEvent *psEvent);
 
     virtual teZCL_CommandStatus handleCheckAttributeRange(tsZCL_CallBackEvent *psEvent);
-    virtual void handleReportingConfigureRequest(tsZCL_CallBackEvent *psEvent);
 
     virtual void handleDeviceJoin();
     virtual void handleDeviceLeave();
+    virtual void handleZclEventProcessed();
+    virtual bool handleLoopbackOnOffCommand(uint8 commandId);
+    virtual bool handleOnWithTimedOff(uint8 onOffControl, uint16 onTime, uint16 offWaitTime);
+    virtual bool replayBoundCommand(uint16 clusterId, uint8 commandId);
 };
 
 #endif // SWITCH_ENDPOINT_H
@@ -0,0 +1,68 @@
+extern "C"
+{
+    #include "dbg.h"
+}
+
+#include "SwitchTransaction.h"
+#include "SwitchEndpoint.h"
+#include "RelayTask.h"
+
+// Gap between the end of the 'off' pulse and the start of the 'on' pulse
+static const uint32 BREAK_BEFORE_MAKE_GAP = 50;
+
+SwitchTransaction::SwitchTransaction()
+{
+    numChanges = 0;
+}
+
+void SwitchTransaction::setState(SwitchEndpoint * endpoint, bool state)
+{
+    // Later change of the same endpoint overrides the earlier one
+    for(uint8 i = 0; i < numChanges; i++)
+    {
+        if(changes[i].endpoint == endpoint)
+        {
+            changes[i].state = state;
+            return;
+        }
+    }
+
+    if(numChanges >= MAX_CHANGES)
+    {
+        DBG_vPrintf(TRUE, "SwitchTransaction: Too many changes\n");
+        return;
+    }
+
+    changes[numChanges].endpoint = endpoint;
+    changes[numChanges].state = state;
+    numChanges++;
+}
+
+void SwitchTransaction::commit()
+{
+    // Only a relay actually going from On to Off needs the break-before-make gap. Next to a relay that is off
+    // already the On pulse starts right away.
+    bool breakFirst = false;
+    for(uint8 i = 0; i < numChanges; i++)
+        breakFirst |= changes[i].endpoint->getAppliedState() && !changes[i].state;
+
+    RelayTask * relayTask = RelayTask::getInstance();
+    uint32 onDelay = breakFirst ? relayTask->getPulseDuration() + BREAK_BEFORE_MAKE_GAP : 0;
+
+    for(uint8 i = 0; i < numChanges; i++)
+    {
+        SwitchEndpoint * endpoint = changes[i].endpoint;
+        bool state = changes[i].state;
+        bool relayChanges = endpoint->getAppliedState() != state;
+
+        endpoint->applyStateChange(state);
+
+        // The endpoint the change was requested for is pulsed anyway, which also brings a latching relay in sync
+        // with the attribute. The interlocked buddy is pulsed only if its state changes.
+        if(i == 0 || relayChanges)
+            relayTask->setState(endpoint->getEndpointId(), state, state ? onDelay : 0);
+    }
+
+    DBG_vPrintf(TRUE, "SwitchTransaction: %d change(s), break-before-make %d\n", numChanges, breakFirst);
+    numChanges = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef SWITCH_TRANSACTION_H
+#define SWITCH_TRANSACTION_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+class SwitchEndpoint;
+
+// A set of endpoint state changes that shall be applied together (e.g. both endpoints in the interlock mode).
+//
+// Target states of all the endpoints are collected first, and then committed at once. If a relay switches from On
+// to Off, it is pulsed first, and relays that switch on are pulsed only after that (break-before-make), so that
+// interlocked loads are never on at the same time. The first endpoint added is the one the change was requested for.
+class SwitchTransaction
+{
+    static const uint8 MAX_CHANGES = 2;
+
+    struct Change
+    {
+        SwitchEndpoint * endpoint;
+        bool state;
+    };
+
+    Change changes[MAX_CHANGES];
+    uint8 numChanges;
+
+public:
+    SwitchTransaction();
+
+    void setState(SwitchEndpoint * endpoint, bool state);
+    void commit();
+};
+
+#endif // SWITCH_TRANSACTION_H
@@ -0,0 +1,53 @@
+extern "C"
+{
+    #include "AppHardwareApi.h"
+    #include "dbg.h"
+}
+
+#include "SystemClock.h"
+
+// Wake timers are 41-bit wide
+static const uint64 WAKE_TIMER_START_VALUE = 0x1FFFFFFFFFFULL;
+
+// Calibration value that corresponds to a precise 32kHz clock
+static const uint32 NOMINAL_CALIBRATION = 10000;
+
+SystemClock::SystemClock()
+{
+    calibration = NOMINAL_CALIBRATION;
+}
+
+SystemClock * SystemClock::getInstance()
+{
+    static SystemClock instance;
+    return &instance;
+}
+
+void SystemClock::init()
+{
+    // The 32kHz RC oscillator is quite imprecise (up to 30% deviation), so calibrate it against the crystal.
+    // Note: calibration runs on the wake timer #0 as well, so it must be done before the timer is started
+    uint32 value = u32AHI_WakeTimerCalibrate();
+    if(value != 0)
+        calibration = value;
+
+    DBG_vPrintf(TRUE, "SystemClock: 32kHz oscillator calibration value %d\n", calibration);
+
+    // Start the wake timer without interrupt, so that it is just free running
+    vAHI_WakeTimerEnable(E_AHI_WAKE_TIMER_0, FALSE);
+    vAHI_WakeTimerStartLarge(E_AHI_WAKE_TIMER_0, WAKE_TIMER_START_VALUE);
+}
+
+uint32 SystemClock::getTimeMs()
+{
+    uint64 ticks = WAKE_TIMER_START_VALUE - u64AHI_WakeTimerReadLarge(E_AHI_WAKE_TIMER_0);
+    return (uint32)(ticks * calibration / (32 * NOMINAL_CALIBRATION));
+}
+
+uint32 SystemClock::getTimeUs()
+{
+    // Resolution is a single 32kHz tick (~31us). The value wraps around every ~71 minutes, so it is good for
+    // measuring short intervals only.
+    uint64 ticks = WAKE_TIMER_START_VALUE - u64AHI_WakeTimerReadLarge(E_AHI_WAKE_TIMER_0);
+    return (uint32)(ticks * calibration / (32 * NOMINAL_CALIBRATION / 1000));
+}
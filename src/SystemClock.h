@@ -0,0 +1,33 @@
+#ifndef SYSTEMCLOCK_H
+#define SYSTEMCLOCK_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// A free running millisecond clock.
+//
+// ZTimer tick timer is reloaded every millisecond and is stopped during sleep, so it cannot be used
+// to measure longer intervals. Instead the clock is based on the wake timer #0 (PWRM uses wake timer #1
+// for scheduled activities, see vISR_SystemController()) which is clocked from the 32kHz oscillator and
+// keeps counting while the device is sleeping with the oscillator on.
+//
+// The timer counts down from its maximum value, and has no interrupt enabled, so it never wakes the device.
+class SystemClock
+{
+    uint32 calibration;
+
+private:
+    SystemClock();
+
+public:
+    static SystemClock * getInstance();
+
+    void init();
+
+    uint32 getTimeMs();
+    uint32 getTimeUs();
+};
+
+#endif // SYSTEMCLOCK_H
@@ -0,0 +1,103 @@
+#include "TemperatureFilter.h"
+
+// On-chip sensor characteristics (JN516x datasheet): 720 mV at 25C, -1.66 mV/C.
+// The ADC is 10-bit with 1.2V reference (input range 1).
+static const int32 SENSOR_MV_AT_25C = 720;
+static const int32 SENSOR_SLOPE_UV_PER_C = -1660;
+static const int32 ADC_FULL_SCALE_MV = 1200;
+static const uint8 ADC_RESOLUTION_BITS = 10;
+
+TemperatureFilter::TemperatureFilter()
+{
+    smoothingShift = DEFAULT_SMOOTHING_SHIFT;
+    reset();
+}
+
+void TemperatureFilter::setSmoothing(uint8 shift)
+{
+    // Shift of 0 disables smoothing, and there is no point in going beyond 1/256
+    smoothingShift = shift > 8 ? 8 : shift;
+}
+
+void TemperatureFilter::reset()
+{
+    hasValue = false;
+    average = 0;
+    minTemperature = 0;
+    maxTemperature = 0;
+}
+
+void TemperatureFilter::addSample(uint16 rawValue)
+{
+    addTemperature(convertRawValue(rawValue));
+}
+
+void TemperatureFilter::addTemperature(int32 temperatureQ8)
+{
+    // The very first sample is taken as is, otherwise the average would crawl from zero
+    if(!hasValue)
+        average = temperatureQ8;
+    else
+        average += (temperatureQ8 - average) / (1 << smoothingShift);
+
+    int16 temperature = roundQ8(average);
+    if(!hasValue || temperature < minTemperature)
+        minTemperature = temperature;
+    if(!hasValue || temperature > maxTemperature)
+        maxTemperature = temperature;
+
+    hasValue = true;
+}
+
+bool TemperatureFilter::hasTemperature() const
+{
+    return hasValue;
+}
+
+int32 TemperatureFilter::getTemperatureQ8() const
+{
+    return average;
+}
+
+int16 TemperatureFilter::getTemperature() const
+{
+    return roundQ8(average);
+}
+
+int16 TemperatureFilter::getMinTemperature() const
+{
+    return minTemperature;
+}
+
+int16 TemperatureFilter::getMaxTemperature() const
+{
+    return maxTemperature;
+}
+
+uint8 TemperatureFilter::getAlarmState(int16 lowThreshold, int16 highThreshold, uint8 alarmMask) const
+{
+    if(!hasValue)
+        return 0;
+
+    uint8 state = 0;
+    int16 temperature = getTemperature();
+    if((alarmMask & TEMPERATURE_ALARM_TOO_LOW) && temperature < lowThreshold)
+        state |= TEMPERATURE_ALARM_TOO_LOW;
+    if((alarmMask & TEMPERATURE_ALARM_TOO_HIGH) && temperature > highThreshold)
+        state |= TEMPERATURE_ALARM_TOO_HIGH;
+
+    return state;
+}
+
+int32 TemperatureFilter::convertRawValue(uint16 rawValue)
+{
+    // T = 25 + (mV - 720) / -1.66, computed in Q8 to keep the precision without floats
+    int32 mVQ8 = ((int32)rawValue * ADC_FULL_SCALE_MV << 8) >> ADC_RESOLUTION_BITS;
+    return (25 << 8) + (mVQ8 - (SENSOR_MV_AT_25C << 8)) * 1000 / SENSOR_SLOPE_UV_PER_C;
+}
+
+int16 TemperatureFilter::roundQ8(int32 valueQ8)
+{
+    // Round half away from zero, so that the result is symmetrical for negative temperatures
+    return valueQ8 >= 0 ? (valueQ8 + 128) / 256 : -((-valueQ8 + 128) / 256);
+}
@@ -0,0 +1,53 @@
+#ifndef TEMPERATUREFILTER_H
+#define TEMPERATUREFILTER_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// Device Temperature Configuration alarm mask bits
+static const uint8 TEMPERATURE_ALARM_TOO_LOW = 0x01;
+static const uint8 TEMPERATURE_ALARM_TOO_HIGH = 0x02;
+
+// Converts raw on-chip temperature sensor readings into a smoothed temperature.
+//
+// All the math is integer. Temperatures are kept in 1/256 degree units (Q8), and the ZCL attribute value is the
+// rounded number of whole degrees. Readings are smoothed with an exponential moving average, so that a single
+// noisy conversion does not cause a report.
+//
+// The class does not depend on the hardware or the Zigbee stack.
+class TemperatureFilter
+{
+public:
+    static const uint8 DEFAULT_SMOOTHING_SHIFT = 2;     // New sample weight is 1/4
+
+private:
+    bool hasValue;
+    int32 average;              // Q8 degrees
+    int16 minTemperature;       // degrees
+    int16 maxTemperature;       // degrees
+    uint8 smoothingShift;
+
+public:
+    TemperatureFilter();
+
+    void setSmoothing(uint8 shift);
+    void reset();
+
+    void addSample(uint16 rawValue);
+    void addTemperature(int32 temperatureQ8);
+
+    bool hasTemperature() const;
+    int32 getTemperatureQ8() const;
+    int16 getTemperature() const;
+    int16 getMinTemperature() const;
+    int16 getMaxTemperature() const;
+
+    uint8 getAlarmState(int16 lowThreshold, int16 highThreshold, uint8 alarmMask) const;
+
+    static int32 convertRawValue(uint16 rawValue);
+    static int16 roundQ8(int32 valueQ8);
+};
+
+#endif // TEMPERATUREFILTER_H
@@ -0,0 +1,198 @@
+extern "C"
+{
+    #include "AppHardwareApi.h"
+    #include "dbg.h"
+}
+
+#include "TemperatureSampler.h"
+#include "ReportManager.h"
+#include "SystemClock.h"
+
+volatile bool TemperatureSampler::sampleReady = false;
+volatile uint16 TemperatureSampler::rawSample = 0;
+
+TemperatureSampler::TemperatureSampler()
+{
+    endpoint = 0;
+    cluster = NULL;
+    conversionInProgress = false;
+    conversionStartTime = 0;
+    alarmState = 0;
+    temperatureReported = false;
+    reportedTemperature = 0;
+
+    stats.samples = 0;
+    stats.cachedReads = 0;
+    stats.changes = 0;
+    stats.alarms = 0;
+
+    PeriodicTask::init(SAMPLE_PERIOD);
+}
+
+TemperatureSampler * TemperatureSampler::getInstance()
+{
+    static TemperatureSampler instance;
+    return &instance;
+}
+
+void TemperatureSampler::init(uint8 ep, tsCLD_DeviceTemperatureConfiguration * clusterData)
+{
+    endpoint = ep;
+    cluster = clusterData;
+
+    vAHI_APRegisterCallback(adcCallback);
+    startTimer(FIRST_SAMPLE_DELAY);
+}
+
+void TemperatureSampler::timerCallback()
+{
+    startConversion();
+}
+
+void TemperatureSampler::startConversion()
+{
+    // The previous conversion got lost somehow. Start over.
+    if(conversionInProgress)
+    {
+        DBG_vPrintf(TRUE, "TemperatureSampler: Warning: ADC conversion did not complete\n");
+        stopConversion();
+    }
+
+    // Power up the analogue peripherals. The regulator takes a few microseconds to settle.
+    vAHI_ApConfigure(E_AHI_AP_REGULATOR_ENABLE, E_AHI_AP_INT_ENABLE, E_AHI_AP_SAMPLE_2, E_AHI_AP_CLOCKDIV_500KHZ, E_AHI_AP_INTREF);
+    while(!bAHI_APRegulatorEnabled())
+        ;
+
+    // Single shot conversion of the on-chip temperature sensor, completed in adcCallback()
+    vAHI_AdcEnable(E_AHI_ADC_SINGLE_SHOT, E_AHI_AP_INPUT_RANGE_1, E_AHI_ADC_SRC_TEMP);
+    conversionInProgress = true;
+    conversionStartTime = SystemClock::getInstance()->getTimeMs();
+    vAHI_AdcStartSample();
+}
+
+void TemperatureSampler::stopConversion()
+{
+    // Power down the analogue peripherals till the next sample
+    vAHI_AdcDisable();
+    vAHI_ApConfigure(E_AHI_AP_REGULATOR_DISABLE, E_AHI_AP_INT_DISABLE, E_AHI_AP_SAMPLE_2, E_AHI_AP_CLOCKDIV_500KHZ, E_AHI_AP_INTREF);
+    conversionInProgress = false;
+}
+
+void TemperatureSampler::adcCallback(uint32 deviceId, uint32 itemBitmap)
+{
+    // Interrupt context: just grab the value, it is processed in the main loop
+    if(deviceId == E_AHI_DEVICE_ANALOGUE && (itemBitmap & E_AHI_AP_CAPT_INT_STATUS_MASK))
+    {
+        rawSample = u16AHI_AdcRead();
+        sampleReady = true;
+    }
+}
+
+void TemperatureSampler::handleSample()
+{
+    if(!sampleReady)
+        return;
+
+    sampleReady = false;
+    uint16 rawValue = rawSample;
+    stopConversion();
+
+    filter.addSample(rawValue);
+    stats.samples++;
+
+    if(!cluster)
+        return;
+
+    cluster->i16CurrentTemperature = filter.getTemperature();
+    cluster->i16MinTempExperienced = filter.getMinTemperature();
+    cluster->i16MaxTempExperienced = filter.getMaxTemperature();
+
+    updateAlarmState();
+}
+
+void TemperatureSampler::handleCachedRead()
+{
+    // The attribute value is already there, updated by the last sample
+    stats.cachedReads++;
+}
+
+void TemperatureSampler::handleConfigurationChange()
+{
+    // Thresholds or alarm mask were changed. Check them right away, rather than waiting for the next sample.
+    if(cluster && filter.hasTemperature())
+        updateAlarmState();
+}
+
+void TemperatureSampler::updateAlarmState()
+{
+    uint8 newAlarmState = filter.getAlarmState(cluster->i16LowTempThreshold,
+                                               cluster->i16HighTempThreshold,
+                                               cluster->u8DeviceTempAlarmMask);
+    bool alarmChanged = newAlarmState != alarmState;
+    if(alarmChanged)
+    {
+        DBG_vPrintf(TRUE, "TemperatureSampler: Temperature %d is %s (thresholds %d..%d)\n",
+                    filter.getTemperature(),
+                    newAlarmState & TEMPERATURE_ALARM_TOO_HIGH ? "too high" :
+                        newAlarmState & TEMPERATURE_ALARM_TOO_LOW ? "too low" : "back to normal",
+                    cluster->i16LowTempThreshold,
+                    cluster->i16HighTempThreshold);
+
+        if(newAlarmState & ~alarmState)
+            stats.alarms++;
+
+        alarmState = newAlarmState;
+    }
+
+    // Crossing a threshold is worth a report regardless of the reportable change
+    reportTemperature(alarmChanged);
+}
+
+void TemperatureSampler::reportTemperature(bool force)
+{
+    // Nothing to report if the rounded value did not change
+    int16 temperature = filter.getTemperature();
+    if(!force && temperatureReported && temperature == reportedTemperature)
+        return;
+
+    temperatureReported = true;
+    reportedTemperature = temperature;
+    teZCL_Status status = force ?
+        ReportManager::getInstance()->reportChange(endpoint,
+                                                   GENERAL_CLUSTER_ID_DEVICE_TEMPERATURE_CONFIGURATION,
+                                                   E_CLD_DEVTEMPCFG_ATTR_ID_CURRENT_TEMPERATURE) :
+        ReportManager::getInstance()->reportValueChange(endpoint,
+                                                        GENERAL_CLUSTER_ID_DEVICE_TEMPERATURE_CONFIGURATION,
+                                                        E_CLD_DEVTEMPCFG_ATTR_ID_CURRENT_TEMPERATURE,
+                                                        temperature);
+    if(status != E_ZCL_SUCCESS)
+        DBG_vPrintf(TRUE, "TemperatureSampler: Failed to report temperature. status: %02x\n", status);
+
+    stats.changes++;
+}
+
+SleepVetoReason TemperatureSampler::getSleepVeto(uint32 * earliestSleepTime)
+{
+    // The conversion takes just a few tens of microseconds, but it must not be interrupted by the sleep
+    if(!conversionInProgress)
+        return SLEEP_VETO_NONE;
+
+    *earliestSleepTime = conversionStartTime + CONVERSION_TIMEOUT;
+    return SLEEP_VETO_ADC_CONVERSION;
+}
+
+const TemperatureStatistics & TemperatureSampler::getStatistics() const
+{
+    return stats;
+}
+
+void TemperatureSampler::dumpStatistics() const
+{
+    DBG_vPrintf(TRUE, "\n+++++++ Temperature sampler statistics:\n");
+    DBG_vPrintf(TRUE, "    Temperature: %d (min %d, max %d), alarm state %02x\n",
+                filter.getTemperature(), filter.getMinTemperature(), filter.getMaxTemperature(), alarmState);
+    DBG_vPrintf(TRUE, "    Samples: %d\n", stats.samples);
+    DBG_vPrintf(TRUE, "    Reads served from cache: %d\n", stats.cachedReads);
+    DBG_vPrintf(TRUE, "    Changes reported: %d\n", stats.changes);
+    DBG_vPrintf(TRUE, "    Alarms: %d\n", stats.alarms);
+}
@@ -0,0 +1,76 @@
+#ifndef TEMPERATURESAMPLER_H
+#define TEMPERATURESAMPLER_H
+
+extern "C"
+{
+    #include "zcl.h"
+    #include "DeviceTemperatureConfiguration.h"
+}
+
+#include "PeriodicTask.h"
+#include "ISleepParticipant.h"
+#include "TemperatureFilter.h"
+
+struct TemperatureStatistics
+{
+    uint32 samples;             // ADC conversions completed
+    uint32 cachedReads;         // Read Attributes requests served without touching the ADC
+    uint32 changes;             // Temperature changes and alarms passed to the report manager
+    uint32 alarms;              // Times the temperature went beyond the configured thresholds
+};
+
+// Measures the chip temperature in the background and keeps the Device Temperature Configuration cluster up to date.
+//
+// Every SAMPLE_PERIOD the task starts a single ADC conversion. The conversion completes with an interrupt, and the
+// sample is processed in the main loop: smoothed with TemperatureFilter, stored in the cluster attributes, checked
+// against the low/high thresholds, and reported on change. Read Attributes requests are served from the cluster
+// attributes, so they cost nothing.
+class TemperatureSampler : public PeriodicTask, public ISleepParticipant
+{
+    static const uint32 SAMPLE_PERIOD = 10000;      // ms
+    static const uint32 FIRST_SAMPLE_DELAY = 1000;  // ms
+    static const uint32 CONVERSION_TIMEOUT = 10;    // ms
+
+    TemperatureFilter filter;
+    uint8 endpoint;
+    tsCLD_DeviceTemperatureConfiguration * cluster;
+
+    bool conversionInProgress;
+    uint32 conversionStartTime;
+    uint8 alarmState;
+    bool temperatureReported;
+    int16 reportedTemperature;
+
+    TemperatureStatistics stats;
+
+    // Updated from the ADC interrupt
+    static volatile bool sampleReady;
+    static volatile uint16 rawSample;
+
+private:
+    TemperatureSampler();
+
+public:
+    static TemperatureSampler * getInstance();
+
+    void init(uint8 endpoint, tsCLD_DeviceTemperatureConfiguration * cluster);
+    void handleSample();
+    void handleCachedRead();
+    void handleConfigurationChange();
+
+    virtual SleepVetoReason getSleepVeto(uint32 * earliestSleepTime);
+
+    const TemperatureStatistics & getStatistics() const;
+    void dumpStatistics() const;
+
+protected:
+    virtual void timerCallback();
+    void startConversion();
+    void stopConversion();
+    void updateAlarmState();
+    void reportTemperature(bool force);
+
+    static void adcCallback(uint32 deviceId, uint32 itemBitmap);
+};
+
+#endif // TEMPERATURESAMPLER_H
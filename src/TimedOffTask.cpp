@@ -0,0 +1,65 @@
+extern "C"
+{
+    #include "dbg.h"
+}
+
+#include "TimedOffTask.h"
+#include "SwitchEndpoint.h"
+
+TimedOffTask::TimedOffTask()
+{
+    numEndpoints = 0;
+
+    // The timer is restarted manually with the delay till the next countdown step
+    PeriodicTask::init(0);
+}
+
+TimedOffTask * TimedOffTask::getInstance()
+{
+    static TimedOffTask instance;
+    return &instance;
+}
+
+void TimedOffTask::registerEndpoint(SwitchEndpoint * endpoint)
+{
+    if(numEndpoints >= MAX_ENDPOINTS)
+    {
+        DBG_vPrintf(TRUE, "TimedOffTask: Too many endpoints\n");
+        return;
+    }
+
+    endpoints[numEndpoints++] = endpoint;
+}
+
+void TimedOffTask::schedule()
+{
+    uint32 delay = getTimeTillNextChange();
+
+    stopTimer();
+    if(delay == 0)
+        return;
+
+    startTimer(delay < UPDATE_PERIOD ? delay : UPDATE_PERIOD);
+}
+
+uint32 TimedOffTask::getTimeTillNextChange() const
+{
+    // Zero means there is no active countdown
+    uint32 delay = 0;
+    for(uint8 i = 0; i < numEndpoints; i++)
+    {
+        uint32 epDelay = endpoints[i]->getTimeTillTimedChange();
+        if(epDelay != 0 && (delay == 0 || epDelay < delay))
+            delay = epDelay;
+    }
+
+    return delay;
+}
+
+void TimedOffTask::timerCallback()
+{
+    for(uint8 i = 0; i < numEndpoints; i++)
+        endpoints[i]->updateTimedOnOff();
+
+    schedule();
+}
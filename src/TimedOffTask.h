@@ -0,0 +1,35 @@
+#ifndef TIMEDOFFTASK_H
+#define TIMEDOFFTASK_H
+
+#include "PeriodicTask.h"
+
+class SwitchEndpoint;
+
+// Drives OnTime/OffWaitTime countdowns of all switch endpoints.
+//
+// The timer runs only while some countdown is active, and ticks at a low rate (refreshing the attributes), or
+// right at the moment when the next state change is due. The task does not prevent the device from sleeping -
+// countdowns are calculated from the system clock, so they catch up after wake up.
+class TimedOffTask : public PeriodicTask
+{
+    static const uint8 MAX_ENDPOINTS = 4;
+    static const uint32 UPDATE_PERIOD = 1000;
+
+    SwitchEndpoint * endpoints[MAX_ENDPOINTS];
+    uint8 numEndpoints;
+
+private:
+    TimedOffTask();
+
+public:
+    static TimedOffTask * getInstance();
+
+    void registerEndpoint(SwitchEndpoint * endpoint);
+    void schedule();
+    uint32 getTimeTillNextChange() const;
+
+protected:
+    virtual void timerCallback();
+};
+
+#endif // TIMEDOFFTASK_H
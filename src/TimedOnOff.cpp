@@ -0,0 +1,140 @@
+#include "TimedOnOff.h"
+
+TimedOnOff::TimedOnOff()
+{
+    onTime = 0;
+    offWaitTime = 0;
+    lastUpdateTime = 0;
+    remainderMs = 0;
+}
+
+TimedOnOffAction TimedOnOff::handleOnWithTimedOff(bool state, bool acceptOnlyWhenOn, uint16 newOnTime, uint16 newOffWaitTime, uint32 now)
+{
+    bool expired;
+    advance(state, now, &expired);
+    if(expired)
+        state = false;
+
+    // The command is discarded if the device is off and shall be controlled only when on
+    if(acceptOnlyWhenOn && !state)
+        return expired ? TIMED_ONOFF_SWITCH_OFF : TIMED_ONOFF_NONE;
+
+    // Within the off wait period the command may only shorten the wait
+    if(offWaitTime > 0 && !state)
+    {
+        if(newOffWaitTime < offWaitTime)
+            offWaitTime = newOffWaitTime;
+        return expired ? TIMED_ONOFF_SWITCH_OFF : TIMED_ONOFF_NONE;
+    }
+
+    // Extend the on period, but never shorten it
+    if(newOnTime > onTime)
+        onTime = newOnTime;
+    offWaitTime = newOffWaitTime;
+
+    return state ? TIMED_ONOFF_NONE : TIMED_ONOFF_SWITCH_ON;
+}
+
+void TimedOnOff::handleStateChange(bool previousState, bool state, uint32 now)
+{
+    // The countdown so far ran for the state the device was in, which may be the same one (e.g. On while on)
+    bool expired;
+    advance(previousState, now, &expired);
+
+    // Regular On makes the device stay on until explicitly switched off, Off cancels the on period
+    if(state)
+    {
+        if(onTime == 0)
+            offWaitTime = 0;
+    }
+    else
+        onTime = 0;
+}
+
+TimedOnOffAction TimedOnOff::update(bool state, uint32 now)
+{
+    bool expired;
+    advance(state, now, &expired);
+    return expired ? TIMED_ONOFF_SWITCH_OFF : TIMED_ONOFF_NONE;
+}
+
+void TimedOnOff::setOnTime(uint16 value, uint32 now)
+{
+    onTime = value;
+    lastUpdateTime = now;
+    remainderMs = 0;
+}
+
+void TimedOnOff::setOffWaitTime(uint16 value, uint32 now)
+{
+    offWaitTime = value;
+    lastUpdateTime = now;
+    remainderMs = 0;
+}
+
+uint16 TimedOnOff::getOnTime() const
+{
+    return onTime;
+}
+
+uint16 TimedOnOff::getOffWaitTime() const
+{
+    return offWaitTime;
+}
+
+bool TimedOnOff::isCounting(bool state) const
+{
+    // The countdown runs only when both values are finite
+    if(onTime == NO_COUNTDOWN || offWaitTime == NO_COUNTDOWN)
+        return false;
+
+    return state ? onTime > 0 : offWaitTime > 0;
+}
+
+uint32 TimedOnOff::getTimeTillNextChange(bool state, uint32 now) const
+{
+    if(!isCounting(state))
+        return 0;
+
+    uint32 remaining = (state ? onTime : offWaitTime) * TENTH_OF_SECOND;
+    uint32 elapsed = now - lastUpdateTime + remainderMs;
+
+    // Zero is reserved for 'no countdown', the overdue change is reported as due in 1 ms
+    return remaining > elapsed ? remaining - elapsed : 1;
+}
+
+void TimedOnOff::advance(bool state, uint32 now, bool * expired)
+{
+    *expired = false;
+
+    uint32 elapsed = now - lastUpdateTime + remainderMs;
+    lastUpdateTime = now;
+
+    if(!isCounting(state))
+    {
+        remainderMs = 0;
+        return;
+    }
+
+    uint32 tenths = elapsed / TENTH_OF_SECOND;
+    remainderMs = elapsed % TENTH_OF_SECOND;
+
+    if(state)
+    {
+        if(tenths < onTime)
+        {
+            onTime -= tenths;
+            return;
+        }
+
+        // On period is over, the device switches off and the off wait period starts. The time elapsed past the
+        // on period (e.g. the update came late after sleep) counts towards the off wait.
+        tenths -= onTime;
+        onTime = 0;
+        *expired = true;
+    }
+
+    offWaitTime = tenths < offWaitTime ? offWaitTime - tenths : 0;
+    if(offWaitTime == 0)
+        remainderMs = 0;
+}
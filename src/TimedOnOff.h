@@ -0,0 +1,53 @@
+#ifndef TIMEDONOFF_H
+#define TIMEDONOFF_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// State change requested by the timed On/Off logic
+enum TimedOnOffAction
+{
+    TIMED_ONOFF_NONE,
+    TIMED_ONOFF_SWITCH_ON,
+    TIMED_ONOFF_SWITCH_OFF
+};
+
+// OnTime/OffWaitTime logic of the On/Off server cluster (On With Timed Off command, ZCL spec 3.8.2.3.6).
+//
+// Attribute values are in 1/10 s. The countdown is calculated from the elapsed time rather than from the number of
+// timer ticks, so it may be updated at any (low) rate, and keeps the right pace even if ticks are missed while
+// the device sleeps.
+//
+// Only the countdown lives here. SwitchEndpoint switches the relay when an action is returned.
+class TimedOnOff
+{
+    uint16 onTime;
+    uint16 offWaitTime;
+    uint32 lastUpdateTime;
+    uint32 remainderMs;
+
+public:
+    static const uint16 NO_COUNTDOWN = 0xFFFF;
+    static const uint32 TENTH_OF_SECOND = 100;
+
+    TimedOnOff();
+
+    TimedOnOffAction handleOnWithTimedOff(bool state, bool acceptOnlyWhenOn, uint16 newOnTime, uint16 newOffWaitTime, uint32 now);
+    void handleStateChange(bool previousState, bool state, uint32 now);
+    TimedOnOffAction update(bool state, uint32 now);
+
+    void setOnTime(uint16 value, uint32 now);
+    void setOffWaitTime(uint16 value, uint32 now);
+    uint16 getOnTime() const;
+    uint16 getOffWaitTime() const;
+
+    bool isCounting(bool state) const;
+    uint32 getTimeTillNextChange(bool state, uint32 now) const;
+
+private:
+    void advance(bool state, uint32 now, bool * expired);
+};
+
+#endif // TIMEDONOFF_H
@@ -0,0 +1,94 @@
+#include "ZCLTimebase.h"
+
+ZCLTimebase::ZCLTimebase()
+{
+    started = false;
+    next100ms = 0;
+    next1s = 0;
+    configure(DEFAULT_MAX_REPLAY_100MS, DEFAULT_MAX_REPLAY_1S);
+
+    stats.ticks100ms = 0;
+    stats.ticks1s = 0;
+    stats.replayed100ms = 0;
+    stats.replayed1s = 0;
+    stats.dropped100ms = 0;
+    stats.dropped1s = 0;
+    stats.updates = 0;
+    stats.maxLateness = 0;
+}
+
+void ZCLTimebase::configure(uint16 newMaxReplay100ms, uint16 newMaxReplay1s)
+{
+    // At least one tick shall be delivered per update
+    maxReplay100ms = newMaxReplay100ms ? newMaxReplay100ms : 1;
+    maxReplay1s = newMaxReplay1s ? newMaxReplay1s : 1;
+}
+
+void ZCLTimebase::start(uint32 now, uint32 initialDelay)
+{
+    started = true;
+    next100ms = now + initialDelay + PERIOD_100MS;
+    next1s = now + initialDelay + PERIOD_1S;
+}
+
+ZCLTimebaseTicks ZCLTimebase::update(uint32 now)
+{
+    ZCLTimebaseTicks ticks;
+    ticks.ticks100ms = 0;
+    ticks.ticks1s = 0;
+
+    if(!started)
+        return ticks;
+
+    stats.updates++;
+    ticks.ticks100ms = takeTicks(now, next100ms, PERIOD_100MS, maxReplay100ms, stats.replayed100ms, stats.dropped100ms);
+    ticks.ticks1s = takeTicks(now, next1s, PERIOD_1S, maxReplay1s, stats.replayed1s, stats.dropped1s);
+
+    stats.ticks100ms += ticks.ticks100ms;
+    stats.ticks1s += ticks.ticks1s;
+    return ticks;
+}
+
+uint32 ZCLTimebase::getTimeTillNextTick(uint32 now) const
+{
+    // Zero means the timebase is not running. The 1 s deadline always coincides with a 100 ms one.
+    if(!started)
+        return 0;
+
+    int32 delay = (int32)(next100ms - now);
+    return delay > 0 ? delay : 1;
+}
+
+const ZCLTimebaseStatistics & ZCLTimebase::getStatistics() const
+{
+    return stats;
+}
+
+uint16 ZCLTimebase::takeTicks(uint32 now, uint32 & deadline, uint32 period, uint16 maxReplay, uint32 & replayed, uint32 & dropped)
+{
+    int32 lateness = (int32)(now - deadline);
+    if(lateness < 0)
+        return 0;
+
+    // The deadline moves by whole periods, so late callbacks do not shift the following ticks
+    uint32 elapsed = lateness / period + 1;
+    deadline += elapsed * period;
+
+    // A tick delivered within its period is just a bit late, the rest were missed
+    if(elapsed == 1)
+    {
+        if((uint32)lateness > stats.maxLateness)
+            stats.maxLateness = lateness;
+
+        return 1;
+    }
+
+    if(elapsed > maxReplay)
+    {
+        dropped += elapsed - maxReplay;
+        elapsed = maxReplay;
+    }
+
+    replayed += elapsed - 1;
+    return elapsed;
+}
@@ -0,0 +1,67 @@
+#ifndef ZCLTIMEBASE_H
+#define ZCLTIMEBASE_H
+
+extern "C"
+{
+    #include "jendefs.h"
+}
+
+// Number of ZCL timer periods elapsed since the previous update
+struct ZCLTimebaseTicks
+{
+    uint16 ticks100ms;
+    uint16 ticks1s;
+};
+
+struct ZCLTimebaseStatistics
+{
+    uint32 ticks100ms;          // 100 ms ticks delivered to ZCL, including replayed ones
+    uint32 ticks1s;             // 1 s ticks delivered to ZCL, including replayed ones
+    uint32 replayed100ms;       // 100 ms ticks that were missed (e.g. during sleep) and delivered late
+    uint32 replayed1s;          // 1 s ticks that were missed and delivered late
+    uint32 dropped100ms;        // 100 ms ticks skipped because the gap was too long to replay
+    uint32 dropped1s;           // 1 s ticks skipped because the gap was too long to replay
+    uint32 updates;             // Number of updates (timer wake ups) that were needed
+    uint32 maxLateness;         // ms, the most late tick delivered on time (i.e. not counting sleep gaps)
+};
+
+// Keeps track of ZCL 100 ms and 1 s ticks based on a free running clock.
+//
+// Tick deadlines are derived from the clock rather than counted by a periodic timer, so that they do not drift if
+// the timer callback is late, and ticks missed while the device was sleeping are replayed on wake up. Very long
+// gaps are not replayed completely: the oldest ticks are dropped, but the tick phase is preserved.
+//
+// ZCLTimer owns the timer and delivers the ticks to ZCL. This class only counts them.
+class ZCLTimebase
+{
+public:
+    static const uint32 PERIOD_100MS = 100;
+    static const uint32 PERIOD_1S = 1000;
+    static const uint16 DEFAULT_MAX_REPLAY_100MS = 100;     // 10 s worth of 100 ms ticks
+    static const uint16 DEFAULT_MAX_REPLAY_1S = 600;        // 10 min worth of 1 s ticks
+
+private:
+    bool started;
+    uint32 next100ms;
+    uint32 next1s;
+    uint16 maxReplay100ms;
+    uint16 maxReplay1s;
+
+    ZCLTimebaseStatistics stats;
+
+public:
+    ZCLTimebase();
+
+    void configure(uint16 maxReplay100ms, uint16 maxReplay1s);
+    void start(uint32 now, uint32 initialDelay);
+
+    ZCLTimebaseTicks update(uint32 now);
+    uint32 getTimeTillNextTick(uint32 now) const;
+
+    const ZCLTimebaseStatistics & getStatistics() const;
+
+private:
+    uint16 takeTicks(uint32 now, uint32 & deadline, uint32 period, uint16 maxReplay, uint32 & replayed, uint32 & dropped);
+};
+
+#endif // ZCLTIMEBASE_H
@@ -1,4 +1,5 @@
 #include "ZCLTimer.h"
+#include "SystemClock.h"
 
 extern "C"
 {
@@ -8,9 +9,8 @@ extern "C"
 
 ZCLTimer::ZCLTimer()
 {
-    PeriodicTask::init(10);
-    tick1s = 0;
-    tick100ms = 0;
+    // The timer is restarted manually with the delay till the next tick
+    PeriodicTask::init(0);
 }
 
 ZCLTimer * ZCLTimer::getInstance()
@@ -21,29 +21,56 @@ ZCLTimer * ZCLTimer::getInstance()
 
 void ZCLTimer::start()
 {
-    startTimer(1000);   // Do not bother with timer events for the first second
+    // Do not bother with timer events for the first second
+    timebase.start(SystemClock::getInstance()->getTimeMs(), START_DELAY);
+    startTimer(START_DELAY + ZCLTimebase::PERIOD_100MS);
+}
+
+void ZCLTimer::handleWakeUp()
+{
+    // The timer was stopped during sleep. Ticks missed meanwhile may run app callbacks and send reports, so they
+    // are not replayed in the wake up callback, but from the main loop as soon as it resumes.
+    stopTimer();
+    startTimer(1);
+}
+
+const ZCLTimebaseStatistics & ZCLTimer::getStatistics() const
+{
+    return timebase.getStatistics();
+}
+
+void ZCLTimer::dumpStatistics() const
+{
+    const ZCLTimebaseStatistics & stats = timebase.getStatistics();
+    DBG_vPrintf(TRUE, "\n+++++++ ZCL timer statistics:\n");
+    DBG_vPrintf(TRUE, "    Timer wake ups: %d\n", stats.updates);
+    DBG_vPrintf(TRUE, "    100ms ticks: %d (replayed %d, dropped %d)\n", stats.ticks100ms, stats.replayed100ms, stats.dropped100ms);
+    DBG_vPrintf(TRUE, "    1s ticks: %d (replayed %d, dropped %d)\n", stats.ticks1s, stats.replayed1s, stats.dropped1s);
+    DBG_vPrintf(TRUE, "    Max tick lateness: %d ms\n", stats.maxLateness);
 }
 
 void ZCLTimer::timerCallback()
 {
-    tick1s++;
-    tick100ms++;
+    update();
+}
 
-    if(tick100ms >= 10)
-    {
-        eZCL_Update100mS();
+void ZCLTimer::update()
+{
+    ZCLTimebaseTicks ticks = timebase.update(SystemClock::getInstance()->getTimeMs());
 
-        tick100ms = 0;
-    }
+    for(uint16 i = 0; i < ticks.ticks100ms; i++)
+        eZCL_Update100mS();
 
-    if(tick1s >= 100)
+    for(uint16 i = 0; i < ticks.ticks1s; i++)
     {
         // Process ZCL timers
         tsZCL_CallBackEvent sCallBackEvent;
         sCallBackEvent.pZPSevent = NULL;
         sCallBackEvent.eEventType = E_ZCL_CBET_TIMER;
         vZCL_EventHandler(&sCallBackEvent);
-
-        tick1s = 0;
     }
+
+    // Sleep till the next tick. Ticks are processed in the callback context, so the time is read again.
+    stopTimer();
+    startTimer(timebase.getTimeTillNextTick(SystemClock::getInstance()->getTimeMs()));
 }
@@ -2,19 +2,32 @@
 #define ZCLTIMER_H
 
 #include "PeriodicTask.h"
+#include "ZCLTimebase.h"
 
+// Delivers 100 ms and 1 s ticks to ZCL.
+//
+// The timer wakes up right at the next tick deadline rather than every 10 ms. Deadlines are calculated from the
+// system clock, which keeps counting during sleep, so ticks missed while sleeping are replayed by the first timer
+// callback after wake up, and ZCL timeouts are not stretched by the sleep time. The timer does not prevent the
+// device from sleeping.
 class ZCLTimer: public PeriodicTask
 {
-    uint32 tick1s;
-    uint32 tick100ms;
+    static const uint32 START_DELAY = 1000;
+
+    ZCLTimebase timebase;
 
     ZCLTimer();
 public:
     static ZCLTimer * getInstance();
     void start();
+    void handleWakeUp();
+
+    const ZCLTimebaseStatistics & getStatistics() const;
+    void dumpStatistics() const;
 
 protected:
     virtual void timerCallback();
+    void update();
 };
 
 #endif // ZCLTIMER_H
@@ -19,6 +19,11 @@ extern "C"
 #include "Queue.h"
 #include "LEDTask.h"
 #include "EndpointManager.h"
+#include "SystemClock.h"
+#include "GroupFanout.h"
+#include "DeliveryTracker.h"
+#include "DiagnosticsCollector.h"
+#include "ReportManager.h"
 
 extern PUBLIC tszQueue zps_msgMlmeDcfmInd;
 extern PUBLIC tszQueue zps_msgMcpsDcfmInd;
@@ -30,6 +35,9 @@ Queue<MAC_tsMcpsVsDcfmInd, 24, &zps_msgMcpsDcfmInd> msgMcpsDcfmIndQueue;
 Queue<MAC_tsMcpsVsCfmData, 5, &zps_msgMcpsDcfm> msgMcpsDcfmQueue;
 Queue<zps_tsTimeEvent, 8, &zps_TimeEvents> timeEventQueue;
 
+// ZDP NWK_addr_rsp
+static const uint16 ZDP_NWK_ADDR_RSP_CLUSTER_ID = 0x8000;
+
 ZigbeeDevice::ZigbeeDevice()
 {
     // Initialize Zigbee stack queues
@@ -54,8 +62,12 @@ ZigbeeDevice::ZigbeeDevice()
     sInitArgs.hBdbEventsMsgQ = bdbEventQueue.getHandle();
     BDB_vInit(&sInitArgs);
 
+    // Spread rejoin attempts of different devices in time
+    uint64 ieeeAddr = ZPS_u64AplZdoGetIeeeAddr();
+    rejoinTask.setSeed((uint32)ieeeAddr ^ (uint32)(ieeeAddr >> 32));
+
     polling = false;
-    rejoinFailures = 0;
+    indicationTime = 0;
 }
 
 ZigbeeDevice * ZigbeeDevice::getInstance()
@@ -104,7 +116,7 @@ void ZigbeeDevice::leaveNetwork()
     DBG_vPrintf(TRUE, "== Leaving the network\n");
     sBDB.sAttrib.bbdbNodeIsOnANetwork = FALSE;
     connectionState = NOT_JOINED;
-    rejoinFailures = 0;
+    rejoinTask.reset();
 
     if (ZPS_E_SUCCESS !=  ZPS_eAplZdoLeaveNetwork(0, FALSE, FALSE))
     {
@@ -144,10 +156,21 @@ void ZigbeeDevice::handleNetworkJoinAndRejoin()
 
     // Get ready for network communication
     if(ZPS_eAplZdoGetDeviceType() == ZPS_ZDO_DEVICE_ENDDEVICE)
-        pollTask.startPoll(2000);
-    rejoinFailures = 0;
+        pollTask.startPoll();
+
+    if(rejoinTask.isActive())
+    {
+        DBG_vPrintf(TRUE, "== Rejoined the network on stage '%s'\n", RejoinStrategy::getStageName(rejoinTask.getStage()));
+        rejoinTask.handleAttemptSucceeded();
+        DBG_vPrintf(TRUE, "  Time to rejoin: %d ms\n", rejoinTask.getStatistics().lastTimeToRejoin);
+    }
 
     EndpointManager::getInstance()->handleDeviceJoin();
+
+    // Send everything that has been collected while the device was off the network
+    DeliveryTracker::getInstance()->handleDeviceJoin();
+
+    DiagnosticsCollector::getInstance()->handleDeviceJoin();
 }
 
 void ZigbeeDevice::handleLeaveNetwork()
@@ -157,6 +180,7 @@ void ZigbeeDevice::handleLeaveNetwork()
     connectionState = NOT_JOINED;
 
     pollTask.stopPoll();
+    rejoinTask.reset();
 
     // Clear ZigBee stack internals
     ZPS_eAplAibSetApsUseExtendedPanId (0);
@@ -172,62 +196,132 @@ void ZigbeeDevice::handleRejoinFailure()
     DBG_vPrintf(TRUE, "== Failed to (re)join the network\n");
     polling = false;
 
-    if(connectionState == JOINED && ++rejoinFailures < 5)
+    if(connectionState == JOINED)
     {
-        DBG_vPrintf(TRUE, "  Rejoin counter %d\n", rejoinFailures);
+        // Start the rejoin procedure, or move on to the next attempt
+        rejoinTask.handleConnectionLost();
 
-        // Schedule sleep for a minute
-        cyclesTillNextRejoin = 4; // 4 * 15s = 1 minute
+        if(rejoinTask.isActive())
+        {
+            DBG_vPrintf(TRUE, "  Rejoin stage '%s', next attempt in %d ms\n",
+                        RejoinStrategy::getStageName(rejoinTask.getStage()),
+                        rejoinTask.getTimeTillNextAttempt());
+            return;
+        }
     }
-    else
+
+    LEDTask::getInstance()->stopEffect();
+    handleLeaveNetwork();
+}
+
+void ZigbeeDevice::rejoinIfDue()
+{
+    if(!needsRejoin() || !rejoinTask.isAttemptDue())
+        return;
+
+    RejoinStage stage = rejoinTask.startAttempt();
+    DBG_vPrintf(TRUE, "== Rejoin attempt on stage '%s'\n", RejoinStrategy::getStageName(stage));
+
+    ZPS_teStatus status = ZPS_E_SUCCESS;
+    switch(stage)
     {
-        LEDTask::getInstance()->stopEffect();
-        handleLeaveNetwork();
+        case REJOIN_STAGE_TARGETED:
+            // Rejoin via the parent and on the channel stored in the network information base (restored from PDM)
+            status = ZPS_eAplZdoRejoinNetwork(FALSE);
+            break;
+
+        case REJOIN_STAGE_CHANNEL_SCAN:
+            // Look for our PAN on all the channels
+            status = ZPS_eAplZdoRejoinNetwork(TRUE);
+            break;
+
+        case REJOIN_STAGE_TRUST_CENTER:
+            // Full BDB failure recovery, that ends with a trust center rejoin
+            rejoinNetwork();
+            break;
+
+        default:
+            break;
     }
+
+    DBG_vPrintf(TRUE, "  Rejoin request status: %02x\n", status);
+    if(status != ZPS_E_SUCCESS)
+        handleRejoinFailure();
 }
 
 void ZigbeeDevice::handlePollResponse(ZPS_tsAfPollConfEvent* pEvent)
 {
+    PollResult result;
     switch (pEvent->u8Status)
     {
         case MAC_ENUM_SUCCESS:
+            result = POLL_RESULT_DATA;
+            break;
+
         case MAC_ENUM_NO_ACK:
-            pollParent();
+            result = POLL_RESULT_NO_ACK;
             break;
 
         case MAC_ENUM_NO_DATA:
-            polling = false;
+            result = POLL_RESULT_NO_DATA;
+            break;
+
         default:
+            result = POLL_RESULT_ERROR;
             break;
     }
+
+    // Poll again if the parent may have more data for us, otherwise wait for the next poll period
+    if(pollTask.handlePollResult(result))
+        pollParent();
+    else
+        polling = false;
 }
 
 void ZigbeeDevice::handleZdoDataIndication(ZPS_tsAfEvent * pEvent)
 {
     DBG_vPrintf(TRUE, "ZDO Data indication event: %d\n", pEvent->eType);
+
+    if(pEvent->uEvent.sApsDataIndEvent.u16ClusterId == ZDP_NWK_ADDR_RSP_CLUSTER_ID)
+        addressResolver.handleNwkAddrResponse();
 }
 
 void ZigbeeDevice::handleZdoBindUnbindEvent(ZPS_tsAfZdoBindEvent * pEvent, bool bind)
 {
+    GroupFanout::getInstance()->handleBindingsChanged();
+
     if(!bind)
         return;
 
-    // Address of interest
-    ZPS_tsAplZdpNwkAddrReq req = {pEvent->uDstAddr.u64Addr, 0, 0};
+    // Group bindings do not need address resolution
+    if(pEvent->u8DstAddrMode != ZPS_E_ADDR_MODE_IEEE)
+        return;
+
+    addressResolver.resolve(pEvent->uDstAddr.u64Addr);
+}
+
+void ZigbeeDevice::handleDataConfirm(ZPS_tsAfEvent * pEvent)
+{
+    // A failed unicast may mean the destination device has changed its network address. Refresh it lazily.
+    if(pEvent->eType == ZPS_EVENT_APS_DATA_CONFIRM)
+    {
+        ZPS_tsAfDataConfEvent * pConfirm = &pEvent->uEvent.sApsDataConfirmEvent;
+        if(pConfirm->u8Status != ZPS_E_SUCCESS && pConfirm->u8DstAddrMode == ZPS_E_ADDR_MODE_SHORT)
+            addressResolver.refresh(pConfirm->uDstAddr.u16Addr);
+
+        GroupFanout::getInstance()->handleTransmission();
+    }
+    else if(pEvent->eType == ZPS_EVENT_APS_DATA_ACK)
+    {
+        ZPS_tsAfDataAckEvent * pAck = &pEvent->uEvent.sApsDataAckEvent;
+        if(pAck->u8Status != ZPS_E_SUCCESS)
+            addressResolver.refresh(pAck->u16DstAddr);
+    }
 
-    // Target addr (Broadcast)
-    ZPS_tuAddress uDstAddr;
-    uDstAddr.u16Addr = 0xFFFF;   // Broadcast
+    // Reports that did not reach the coordinator are sent again
+    DeliveryTracker::getInstance()->handleDataConfirm(pEvent);
 
-    // Perform the request
-    uint8 u8SeqNumber;
-    PDUM_thAPduInstance hAPduInst = PDUM_hAPduAllocateAPduInstance(apduZDP);
-    ZPS_teStatus status = ZPS_eAplZdpNwkAddrRequest(hAPduInst,
-                                                    uDstAddr,     // Broadcast addr
-                                                    FALSE,
-                                                    &u8SeqNumber,
-                                                    &req);
-    DBG_vPrintf(TRUE, "ZigbeeDevice::handleZdoBindUnbindEvent(): looking for network addr for %016llx. Status=%02x\n", pEvent->uDstAddr.u64Addr, status);
+    DiagnosticsCollector::getInstance()->handleDataConfirm(pEvent);
 }
 
 void ZigbeeDevice::handleZclEvents(ZPS_tsAfEvent* psStackEvent)
@@ -236,6 +330,9 @@ void ZigbeeDevice::handleZclEvents(ZPS_tsAfEvent* psStackEvent)
     sCallBackEvent.pZPSevent = psStackEvent;
     sCallBackEvent.eEventType = E_ZCL_CBET_ZIGBEE_EVENT;
     vZCL_EventHandler(&sCallBackEvent);
+
+    // Cluster commands are complete now, including the responses the ZCL has sent
+    EndpointManager::getInstance()->handleZclEventProcessed();
 }
 
 void ZigbeeDevice::handleZdoEvents(ZPS_tsAfEvent* psStackEvent)
@@ -255,6 +352,12 @@ void ZigbeeDevice::handleZdoEvents(ZPS_tsAfEvent* psStackEvent)
         case ZPS_EVENT_NWK_LEAVE_INDICATION:
             if(psStackEvent->uEvent.sNwkLeaveIndicationEvent.u64ExtAddr == 0)
                 handleLeaveNetwork();
+            else
+                DiagnosticsCollector::getInstance()->handleNeighborRemoved();
+            break;
+
+        case ZPS_EVENT_NWK_NEW_NODE_HAS_JOINED:
+            DiagnosticsCollector::getInstance()->handleNeighborAdded();
             break;
 
         case ZPS_EVENT_NWK_LEAVE_CONFIRM:
@@ -273,6 +376,18 @@ void ZigbeeDevice::handleZdoEvents(ZPS_tsAfEvent* psStackEvent)
             handlePollResponse(&psStackEvent->uEvent.sNwkPollConfirmEvent);
             break;
 
+        // Results of the rejoin attempts made directly with ZPS (BDB reports its own rejoin results via BDB events)
+        case ZPS_EVENT_NWK_JOINED_AS_ENDDEVICE:
+        case ZPS_EVENT_NWK_JOINED_AS_ROUTER:
+            if(isDirectRejoinInProgress())
+                handleNetworkJoinAndRejoin();
+            break;
+
+        case ZPS_EVENT_NWK_FAILED_TO_JOIN:
+            if(isDirectRejoinInProgress())
+                handleRejoinFailure();
+            break;
+
         default:
             //DBG_vPrintf(TRUE, "Handle ZDO event: event type %d\n", psStackEvent->eType);
             break;
@@ -281,6 +396,10 @@ void ZigbeeDevice::handleZdoEvents(ZPS_tsAfEvent* psStackEvent)
 
 void ZigbeeDevice::handleAfEvent(BDB_tsZpsAfEvent *psZpsAfEvent)
 {
+    // Remember when the message has got to the application, so that handlers can measure their own latency
+    if(psZpsAfEvent->sStackEvent.eType == ZPS_EVENT_APS_DATA_INDICATION)
+        indicationTime = SystemClock::getInstance()->getTimeUs();
+
     // Dump the event for debug purposes
     vDumpAfEvent(&psZpsAfEvent->sStackEvent);
 
@@ -291,17 +410,29 @@ void ZigbeeDevice::handleAfEvent(BDB_tsZpsAfEvent *psZpsAfEvent)
     }
     else if(psZpsAfEvent->sStackEvent.eType == ZPS_EVENT_APS_DATA_INDICATION)
     {
-        handleZclEvents(&psZpsAfEvent->sStackEvent);
+        // Reporting configuration is kept by ReportManager rather than ZCL, and On With Timed Off is served by the
+        // endpoints themselves
+        if(!ReportManager::getInstance()->handleDataIndication(&psZpsAfEvent->sStackEvent) &&
+           !EndpointManager::getInstance()->handleDataIndication(&psZpsAfEvent->sStackEvent))
+            handleZclEvents(&psZpsAfEvent->sStackEvent);
+    }
+    else if (psZpsAfEvent->sStackEvent.eType == ZPS_EVENT_APS_DATA_CONFIRM ||
+             psZpsAfEvent->sStackEvent.eType == ZPS_EVENT_APS_DATA_ACK)
+    {
+        if(connectionState == JOINED)
+            handleDataConfirm(&psZpsAfEvent->sStackEvent);
     }
-    else if (psZpsAfEvent->sStackEvent.eType != ZPS_EVENT_APS_DATA_CONFIRM &&
-             psZpsAfEvent->sStackEvent.eType != ZPS_EVENT_APS_DATA_ACK)
+    else
     {
         DBG_vPrintf(TRUE, "AF event callback: endpoint %d, event %d\n", psZpsAfEvent->u8EndPoint, psZpsAfEvent->sStackEvent.eType);
     }
 
     // Ensure Freeing of APDUs
     if(psZpsAfEvent->sStackEvent.eType == ZPS_EVENT_APS_DATA_INDICATION)
+    {
+        DiagnosticsCollector::getInstance()->handleDataIndication(&psZpsAfEvent->sStackEvent);
         PDUM_eAPduFreeAPduInstance(psZpsAfEvent->sStackEvent.uEvent.sApsDataIndEvent.hAPduInst);
+    }
 }
 
 void ZigbeeDevice::handleBdbEvent(BDB_tsBdbEvent *psBdbEvent)
@@ -361,7 +492,68 @@ void ZigbeeDevice::pollParent()
 
     polling = true;
     DBG_vPrintf(TRUE, "ZigbeeDevice: Polling parent for zigbee messages\n");
-    ZPS_eAplZdoPoll();
+    pollTask.poll();
+
+    // Let endpoints do their periodic job while the device is awake (e.g. Poll Control check-in)
+    if(connectionState == JOINED)
+        EndpointManager::getInstance()->handleParentPoll();
+}
+
+void ZigbeeDevice::triggerFastPoll()
+{
+    // Only joined end devices poll their parents
+    if(ZPS_eAplZdoGetDeviceType() != ZPS_ZDO_DEVICE_ENDDEVICE || connectionState != JOINED)
+        return;
+
+    pollTask.triggerFastPoll();
+}
+
+void ZigbeeDevice::startFastPoll(uint32 duration)
+{
+    // Only joined end devices poll their parents
+    if(ZPS_eAplZdoGetDeviceType() != ZPS_ZDO_DEVICE_ENDDEVICE || connectionState != JOINED)
+        return;
+
+    pollTask.startFastPoll(duration);
+}
+
+void ZigbeeDevice::stopFastPoll()
+{
+    pollTask.stopFastPoll();
+}
+
+void ZigbeeDevice::setPollPeriods(uint32 fastPeriod, uint32 longPeriod)
+{
+    DBG_vPrintf(TRUE, "ZigbeeDevice: Setting poll periods fast=%dms long=%dms\n", fastPeriod, longPeriod);
+    pollTask.setPollPeriods(fastPeriod, longPeriod);
+}
+
+void ZigbeeDevice::dumpPollStatistics() const
+{
+    pollTask.dumpStatistics();
+}
+
+const PollStatistics & ZigbeeDevice::getPollStatistics() const
+{
+    return pollTask.getStatistics();
+}
+
+uint32 ZigbeeDevice::getSleepDuration() const
+{
+    // Devices that are not connected just sleep for a fixed period
+    if(connectionState != JOINED)
+        return 15000;
+
+    // Wake up for the next rejoin attempt
+    if(needsRejoin())
+    {
+        uint32 duration = rejoinTask.getTimeTillNextAttempt();
+        return duration > 10 ? duration : 10;
+    }
+
+    // Connected device wakes up for the next parent poll
+    uint32 duration = pollTask.getTimeTillNextPoll();
+    return duration > 10 ? duration : 10;
 }
 
 bool ZigbeeDevice::canSleep() const
@@ -376,11 +568,79 @@ bool ZigbeeDevice::canSleep() const
     return !polling;
 }
 
+SleepVetoReason ZigbeeDevice::getSleepVeto(uint32 * earliestSleepTime)
+{
+    if(ZPS_eAplZdoGetDeviceType() != ZPS_ZDO_DEVICE_ENDDEVICE)
+        return SLEEP_VETO_NOT_SLEEPY_DEVICE;
+
+    if(polling)
+        return SLEEP_VETO_NETWORK_POLL;
+
+    // Rejoin is a sequence of network exchanges, do not interrupt it
+    if(rejoinTask.isAttemptInProgress())
+        return SLEEP_VETO_NETWORK_ACTIVITY;
+
+    // Wait for the address lookups to complete (or time out)
+    if(addressResolver.hasLookups())
+        return SLEEP_VETO_NETWORK_ACTIVITY;
+
+    // Stay awake while fast polling, so that the fast poll timer is not delayed by the sleep
+    if(pollTask.isFastPolling())
+    {
+        *earliestSleepTime = pollTask.getFastPollUntil();
+        return SLEEP_VETO_NETWORK_ACTIVITY;
+    }
+
+    return SLEEP_VETO_NONE;
+}
+
 bool ZigbeeDevice::needsRejoin() const
 {
-    // Non-zero rejoin failure counter reflects that we have received spontaneous
+    // Active rejoin strategy reflects that we have received spontaneous
     // Rejoin failure message while the node was in JOINED state
-    return rejoinFailures > 0 && connectionState == JOINED;
+    return rejoinTask.isActive() && connectionState == JOINED;
+}
+
+bool ZigbeeDevice::isDirectRejoinInProgress() const
+{
+    if(!rejoinTask.isAttemptInProgress())
+        return false;
+
+    RejoinStage stage = rejoinTask.getStage();
+    return stage == REJOIN_STAGE_TARGETED || stage == REJOIN_STAGE_CHANNEL_SCAN;
+}
+
+void ZigbeeDevice::dumpRejoinStatistics() const
+{
+    rejoinTask.dumpStatistics();
+}
+
+const RejoinStatistics & ZigbeeDevice::getRejoinStatistics() const
+{
+    return rejoinTask.getStatistics();
+}
+
+void ZigbeeDevice::dumpAddressStatistics() const
+{
+    addressResolver.dumpStatistics();
+}
+
+const AddressLookupStatistics & ZigbeeDevice::getAddressStatistics() const
+{
+    return addressResolver.getStatistics();
+}
+
+uint32 ZigbeeDevice::getIndicationTime() const
+{
+    return indicationTime;
+}
+
+uint8 ZigbeeDevice::getEventBacklog()
+{
+    // Incoming frames, stack timer events, and BDB events still waiting to be processed by the main loop
+    uint32 backlog = msgMlmeDcfmIndQueue.count() + msgMcpsDcfmIndQueue.count() + msgMcpsDcfmQueue.count() +
+                     timeEventQueue.count() + bdbEventQueue.count();
+    return backlog > 0xff ? 0xff : (uint8)backlog;
 }
 
 void ZigbeeDevice::handleWakeUp()
@@ -391,14 +651,14 @@ void ZigbeeDevice::handleWakeUp()
     if(needsRejoin())
     {
         // Device that is basically connected, but currently needs a rejoin will have to
-        // sleep a few cycles between rejoin attempts
-        if(cyclesTillNextRejoin-- > 0)
+        // sleep between rejoin attempts
+        if(!rejoinTask.isAttemptDue())
         {
-            DBG_vPrintf(TRUE, "ZigbeeDevice: Rejoining in %d cycles\n", cyclesTillNextRejoin);
+            DBG_vPrintf(TRUE, "ZigbeeDevice: Rejoining in %d ms\n", rejoinTask.getTimeTillNextAttempt());
             return;
         }
 
-        rejoinNetwork();
+        rejoinIfDue();
     }
     else
         // Connected device will just poll its parent on wake up
@@ -15,9 +15,12 @@ extern "C"
 #include "PersistedValue.h"
 #include "PdmIds.h"
 #include "PollTask.h"
+#include "RejoinTask.h"
+#include "AddressResolver.h"
+#include "ISleepParticipant.h"
 #include "Queue.h"
 
-class ZigbeeDevice
+class ZigbeeDevice : public ISleepParticipant
 {
     typedef enum
     {
@@ -30,10 +33,11 @@ class ZigbeeDevice
     PersistedValue<JoinStateEnum, PDM_ID_NODE_STATE> connectionState;
     Queue<BDB_tsZpsAfEvent, 3> bdbEventQueue;
     PollTask pollTask;
+    RejoinTask rejoinTask;
+    AddressResolver addressResolver;
 
     bool polling;
-    int rejoinFailures;
-    int cyclesTillNextRejoin;
+    uint32 indicationTime;
 
     ZigbeeDevice();
 
@@ -47,17 +51,34 @@ public:
     bool isJoined();
 
     void pollParent();
+    void triggerFastPoll();
+    void startFastPoll(uint32 duration);
+    void stopFastPoll();
+    void setPollPeriods(uint32 fastPeriod, uint32 longPeriod);
+    void dumpPollStatistics() const;
+    const PollStatistics & getPollStatistics() const;
+    uint32 getSleepDuration() const;
     bool canSleep() const;
+    virtual SleepVetoReason getSleepVeto(uint32 * earliestSleepTime);
     bool needsRejoin() const;
+    void rejoinIfDue();
+    void dumpRejoinStatistics() const;
+    const RejoinStatistics & getRejoinStatistics() const;
+    void dumpAddressStatistics() const;
+    const AddressLookupStatistics & getAddressStatistics() const;
+    uint32 getIndicationTime() const;
+    uint8 getEventBacklog();
     void handleWakeUp();
 
 protected:
     void handleNetworkJoinAndRejoin();
     void handleLeaveNetwork();
     void handleRejoinFailure();
+    bool isDirectRejoinInProgress() const;
     void handlePollResponse(ZPS_tsAfPollConfEvent* pEvent);
     void handleZdoBindUnbindEvent(ZPS_tsAfZdoBindEvent * pEvent, bool bind);
     void handleZdoDataIndication(ZPS_tsAfEvent * pEvent);
+    void handleDataConfirm(ZPS_tsAfEvent * pEvent);
     void handleZdoEvents(ZPS_tsAfEvent* psStackEvent);
     void handleZclEvents(ZPS_tsAfEvent* psStackEvent);
     void handleAfEvent(BDB_tsZpsAfEvent *psZpsAfEvent);
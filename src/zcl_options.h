@@ -32,9 +32,13 @@
 
 #define CLD_GROUPS
 #define GROUPS_SERVER
+#define GROUPS_CLIENT
 
-//#define CLD_SCENES
-//#define SCENES_CLIENT
+#define CLD_SCENES
+#define SCENES_SERVER
+#define CLD_SCENES_MAX_NUMBER_OF_SCENES                     16
+#define CLD_SCENES_MAX_SCENE_NAME_LENGTH                    0
+#define CLD_SCENES_MAX_SCENE_STORAGE_BYTES                  4       // On/Off extension field set only
 
 #define CLD_IDENTIFY
 #define IDENTIFY_SERVER
@@ -43,6 +47,8 @@
 #define CLD_ONOFF
 #define ONOFF_CLIENT
 #define ONOFF_SERVER
+#define CLD_ONOFF_ATTR_ON_TIME
+#define CLD_ONOFF_ATTR_OFF_WAIT_TIME
 
 #define CLD_OOSC
 #define OOSC_SERVER
@@ -60,6 +66,23 @@
 
 #define CLD_DEVICE_TEMPERATURE_CONFIGURATION
 #define DEVICE_TEMPERATURE_CONFIGURATION_SERVER
+#define CLD_DEVTEMPCFG_ATTR_ID_MIN_TEMP_EXPERIENCED
+#define CLD_DEVTEMPCFG_ATTR_ID_MAX_TEMP_EXPERIENCED
+#define CLD_DEVTEMPCFG_ATTR_ID_DEVICE_TEMP_ALARM_MASK
+#define CLD_DEVTEMPCFG_ATTR_ID_LOW_TEMP_THRESHOLD
+#define CLD_DEVTEMPCFG_ATTR_ID_HIGH_TEMP_THRESHOLD
+
+#define CLD_DEVICE_STATS
+#define DEVICE_STATS_SERVER
+
+#define CLD_DIAGNOSTICS
+#define DIAGNOSTICS_SERVER
+
+#define CLD_LATENCY_PROBE
+#define LATENCY_PROBE_SERVER
+
+#define CLD_POLL_CONTROL
+#define POLL_CONTROL_SERVER
 
 #define CLD_OTA
 #define OTA_CLIENT
@@ -67,8 +90,12 @@
 #define OTA_CLD_ATTR_FILE_OFFSET
 #define OTA_CLD_ATTR_CURRENT_FILE_VERSION
 #define OTA_CLD_ATTR_CURRENT_ZIGBEE_STACK_VERSION
-#define OTA_MAX_BLOCK_SIZE                                  48
+#define OTA_CLD_ATTR_REQUEST_DELAY
+#define OTA_MAX_BLOCK_SIZE                                  64      // Largest multiple of 16 fitting an 82 byte APS payload
 #define OTA_TIME_INTERVAL_BETWEEN_RETRIES                   10
+#define OTA_PAGE_REQUEST_SUPPORT
+#define OTA_PAGE_REQ_PAGE_SIZE                              512     // Whole 64 byte blocks
+#define OTA_PAGE_REQ_RESPONSE_SPACING                       20      // ms, minimal spacing, raised at runtime for a slow server
 #define OTA_STRING_COMPARE
 #define OTA_UPGRADE_VOLTAGE_CHECK
 
@@ -0,0 +1,209 @@
+// Tests for the address lookup queue: de-duplication, rate limiting and unicast-before-broadcast order.
+
+#include <stdio.h>
+
+#include "AddressLookupQueue.h"
+#include "test_common.h"
+
+static const uint64 DEVICE_A = 0x00158d0001a2b3c4ULL;
+static const uint64 DEVICE_B = 0x00158d0001a2b3c5ULL;
+
+static void testEmptyByDefault()
+{
+    printf("testEmptyByDefault\n");
+    AddressLookupQueue queue;
+    uint64 ieee;
+    uint16 addr;
+
+    CHECK(!queue.hasLookups());
+    CHECK(queue.getNextAction(0, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_NONE);
+    CHECK(queue.getLookupAddress(0) == 0);
+}
+
+static void testUnicastThenBroadcast()
+{
+    printf("testUnicastThenBroadcast\n");
+    AddressLookupQueue queue;
+    uint64 ieee = 0;
+    uint16 addr = 0xFFFF;
+    uint32 now = 1000;
+
+    CHECK(queue.enqueue(DEVICE_A, 0x1234));
+    CHECK(queue.isPending(DEVICE_A));
+
+    CHECK(queue.getNextAction(now, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_UNICAST);
+    CHECK(ieee == DEVICE_A);
+    CHECK(addr == 0x1234);
+
+    // Waiting for the unicast response
+    CHECK(queue.getNextAction(now + AddressLookupQueue::DEFAULT_RESPONSE_TIMEOUT - 1, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_NONE);
+
+    // No response - broadcast
+    now += AddressLookupQueue::DEFAULT_RESPONSE_TIMEOUT;
+    CHECK(queue.getNextAction(now, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_BROADCAST);
+    CHECK(ieee == DEVICE_A);
+
+    // No response again - give up
+    now += AddressLookupQueue::DEFAULT_RESPONSE_TIMEOUT;
+    CHECK(queue.getNextAction(now, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_NONE);
+    CHECK(!queue.hasLookups());
+
+    const AddressLookupStatistics & stats = queue.getStatistics();
+    CHECK(stats.unicastLookups == 1);
+    CHECK(stats.broadcastLookups == 1);
+    CHECK(stats.failed == 1);
+    CHECK(stats.resolved == 0);
+    CHECK(stats.broadcastsAvoided == 0);
+}
+
+static void testResolvedByUnicast()
+{
+    printf("testResolvedByUnicast\n");
+    AddressLookupQueue queue;
+    uint64 ieee;
+    uint16 addr;
+
+    queue.enqueue(DEVICE_A, 0x0000);
+    CHECK(queue.getNextAction(0, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_UNICAST);
+    queue.handleResolved(DEVICE_A);
+
+    CHECK(!queue.hasLookups());
+    CHECK(queue.getNextAction(100000, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_NONE);
+
+    const AddressLookupStatistics & stats = queue.getStatistics();
+    CHECK(stats.resolved == 1);
+    CHECK(stats.broadcastLookups == 0);
+    CHECK(stats.broadcastsAvoided == 1);
+
+    // Responses for unknown addresses are ignored
+    queue.handleResolved(DEVICE_B);
+    CHECK(queue.getStatistics().resolved == 1);
+}
+
+static void testBroadcastOnly()
+{
+    printf("testBroadcastOnly\n");
+    AddressLookupQueue queue;
+    uint64 ieee;
+    uint16 addr;
+
+    // No device to ask directly, the first request is the broadcast
+    CHECK(queue.enqueue(DEVICE_A, AddressLookupQueue::NO_UNICAST_ADDR));
+    CHECK(queue.getNextAction(0, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_BROADCAST);
+    CHECK(ieee == DEVICE_A);
+    queue.handleResolved(DEVICE_A);
+
+    const AddressLookupStatistics & stats = queue.getStatistics();
+    CHECK(stats.unicastLookups == 0);
+    CHECK(stats.broadcastLookups == 1);
+    CHECK(stats.resolved == 1);
+    CHECK(!queue.hasLookups());
+}
+
+static void testDeduplication()
+{
+    printf("testDeduplication\n");
+    AddressLookupQueue queue;
+    uint64 ieee;
+    uint16 addr;
+
+    CHECK(queue.enqueue(DEVICE_A, 0x0000));
+    CHECK(queue.enqueue(DEVICE_A, 0x0000));
+    CHECK(queue.enqueue(DEVICE_A, 0x0000));
+
+    CHECK(queue.getNextAction(0, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_UNICAST);
+    CHECK(queue.getNextAction(5000, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_BROADCAST);
+    CHECK(queue.getNextAction(6000, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_NONE);
+
+    const AddressLookupStatistics & stats = queue.getStatistics();
+    CHECK(stats.requests == 3);
+    CHECK(stats.deduplicated == 2);
+    CHECK(stats.unicastLookups == 1);
+    CHECK(stats.broadcastLookups == 1);
+    CHECK(stats.broadcastsAvoided == 2);
+}
+
+static void testRateLimit()
+{
+    printf("testRateLimit\n");
+    AddressLookupQueue queue;
+    queue.configure(1000, 5000);
+    uint64 ieee;
+    uint16 addr;
+
+    queue.enqueue(DEVICE_A, 0x0000);
+    queue.enqueue(DEVICE_B, 0x0000);
+
+    CHECK(queue.getNextAction(0, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_UNICAST);
+    CHECK(ieee == DEVICE_A);
+    CHECK(queue.getNextAction(999, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_NONE);
+    CHECK(queue.getNextAction(1000, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_UNICAST);
+    CHECK(ieee == DEVICE_B);
+
+    // Both unicasts time out, broadcasts are also spread in time
+    CHECK(queue.getNextAction(6000, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_BROADCAST);
+    CHECK(ieee == DEVICE_A);
+    CHECK(queue.getNextAction(6500, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_NONE);
+    CHECK(queue.getNextAction(7000, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_BROADCAST);
+    CHECK(ieee == DEVICE_B);
+}
+
+static void testQueueFull()
+{
+    printf("testQueueFull\n");
+    AddressLookupQueue queue;
+
+    for(uint8 i = 0; i < AddressLookupQueue::MAX_LOOKUPS; i++)
+        CHECK(queue.enqueue(DEVICE_A + i, 0x0000));
+
+    CHECK(!queue.enqueue(DEVICE_B + AddressLookupQueue::MAX_LOOKUPS, 0x0000));
+    CHECK(queue.getStatistics().dropped == 1);
+
+    // Freed slot can be reused
+    queue.handleResolved(DEVICE_A);
+    CHECK(queue.enqueue(DEVICE_B + AddressLookupQueue::MAX_LOOKUPS, 0x0000));
+}
+
+static void testCacheHits()
+{
+    printf("testCacheHits\n");
+    AddressLookupQueue queue;
+
+    queue.handleCacheHit();
+    queue.handleCacheHit();
+
+    const AddressLookupStatistics & stats = queue.getStatistics();
+    CHECK(stats.requests == 2);
+    CHECK(stats.cacheHits == 2);
+    CHECK(stats.broadcastsAvoided == 2);
+    CHECK(!queue.hasLookups());
+}
+
+static void testTimerWraparound()
+{
+    printf("testTimerWraparound\n");
+    AddressLookupQueue queue;
+    uint64 ieee;
+    uint16 addr;
+    uint32 now = 0xfffff000;
+
+    queue.enqueue(DEVICE_A, 0x0000);
+    CHECK(queue.getNextAction(now, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_UNICAST);
+    CHECK(queue.getNextAction(now + 4000, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_NONE);       // wrapped, not timed out
+    CHECK(queue.getNextAction(now + 5000, &ieee, &addr) == ADDRESS_LOOKUP_ACTION_BROADCAST);
+}
+
+int main()
+{
+    testEmptyByDefault();
+    testUnicastThenBroadcast();
+    testResolvedByUnicast();
+    testBroadcastOnly();
+    testDeduplication();
+    testRateLimit();
+    testQueueFull();
+    testCacheHits();
+    testTimerWraparound();
+
+    return testResult();
+}
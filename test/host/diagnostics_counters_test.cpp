@@ -0,0 +1,167 @@
+// Tests for the Diagnostics cluster counters.
+
+#include <stdio.h>
+
+#include "DiagnosticsCounters.h"
+#include "test_common.h"
+
+static const uint8 APS_STATUS_NO_ACK = 0xA7;
+static const uint8 MAC_STATUS_CHANNEL_ACCESS_FAILURE = 0xE1;
+
+static void testInitialState()
+{
+    printf("testInitialState\n");
+    DiagnosticsCounters counters;
+
+    const DiagnosticsCountersData & data = counters.getCounters();
+    CHECK(data.macTxUnicast == 0);
+    CHECK(data.apsTxSuccess == 0);
+    CHECK(data.apsTxFailures == 0);
+    CHECK(counters.getAverageMacRetries() == 0);
+    CHECK(!counters.takeChanged());
+}
+
+static void testUnicastConfirms()
+{
+    printf("testUnicastConfirms\n");
+    DiagnosticsCounters counters;
+
+    counters.handleUnicastConfirm(0);
+    counters.handleUnicastConfirm(0);
+    counters.handleUnicastConfirm(DiagnosticsCounters::MAC_STATUS_NO_ACK);
+    counters.handleUnicastConfirm(MAC_STATUS_CHANNEL_ACCESS_FAILURE);
+    counters.handleUnicastConfirm(APS_STATUS_NO_ACK);
+
+    const DiagnosticsCountersData & data = counters.getCounters();
+    CHECK(data.macTxUnicast == 5);
+    CHECK(data.apsTxSuccess == 2);
+    CHECK(data.apsTxFailures == 3);
+    CHECK(data.macTxFailures == 2);         // APS failure is not a MAC failure
+    CHECK(data.macTxRetries == DiagnosticsCounters::MAC_MAX_FRAME_RETRIES);
+    CHECK(counters.takeChanged());
+    CHECK(!counters.takeChanged());
+}
+
+static void testApsAck()
+{
+    printf("testApsAck\n");
+    DiagnosticsCounters counters;
+
+    // Delivered to the next hop, but the end-to-end ack did not come
+    counters.handleUnicastConfirm(0);
+    counters.takeChanged();
+    counters.handleApsAck(APS_STATUS_NO_ACK);
+    CHECK(counters.getCounters().apsTxSuccess == 0);
+    CHECK(counters.getCounters().apsTxFailures == 1);
+    CHECK(counters.takeChanged());
+
+    // Successful ack changes nothing, the delivery has been counted already
+    counters.handleUnicastConfirm(0);
+    counters.takeChanged();
+    counters.handleApsAck(0);
+    CHECK(counters.getCounters().apsTxSuccess == 1);
+    CHECK(!counters.takeChanged());
+
+    // Confirm might have been lost, counters shall not wrap around
+    DiagnosticsCounters other;
+    other.handleApsAck(APS_STATUS_NO_ACK);
+    CHECK(other.getCounters().apsTxSuccess == 0);
+    CHECK(other.getCounters().apsTxFailures == 1);
+}
+
+static void testAverageMacRetries()
+{
+    printf("testAverageMacRetries\n");
+    DiagnosticsCounters counters;
+
+    // 1 no-ack (3 retries) of 4 messages: 0.75 rounds to 1
+    counters.handleUnicastConfirm(DiagnosticsCounters::MAC_STATUS_NO_ACK);
+    counters.handleUnicastConfirm(0);
+    counters.handleUnicastConfirm(0);
+    counters.handleUnicastConfirm(0);
+    CHECK(counters.getAverageMacRetries() == 1);
+
+    // 3 retries of 7 messages: 0.43 rounds to 0
+    counters.handleUnicastConfirm(0);
+    counters.handleUnicastConfirm(0);
+    counters.handleUnicastConfirm(0);
+    CHECK(counters.getAverageMacRetries() == 0);
+
+    // Every message fails
+    DiagnosticsCounters bad;
+    for(int i = 0; i < 10; i++)
+        bad.handleUnicastConfirm(DiagnosticsCounters::MAC_STATUS_NO_ACK);
+    CHECK(bad.getAverageMacRetries() == DiagnosticsCounters::MAC_MAX_FRAME_RETRIES);
+}
+
+static void testOtherCounters()
+{
+    printf("testOtherCounters\n");
+    DiagnosticsCounters counters;
+
+    counters.handleBufferAllocFailure();
+    counters.handleNeighborAdded();
+    counters.handleNeighborAdded();
+    counters.handleNeighborRemoved();
+    counters.handlePdmWrite();
+    counters.handlePdmWrite();
+    counters.handlePdmWrite();
+
+    const DiagnosticsCountersData & data = counters.getCounters();
+    CHECK(data.bufferAllocFailures == 1);
+    CHECK(data.neighborsAdded == 2);
+    CHECK(data.neighborsRemoved == 1);
+    CHECK(data.pdmWrites == 3);
+    CHECK(counters.takeChanged());
+}
+
+static void testLinkQuality()
+{
+    printf("testLinkQuality\n");
+    DiagnosticsCounters counters;
+
+    counters.handleMessageReceived(255);
+    CHECK(counters.getCounters().lastMessageLqi == 255);
+    CHECK(counters.getCounters().lastMessageRssi == DiagnosticsCounters::convertLqiToRssi(255));
+
+    // The conversion covers the radio sensitivity range, and is monotonic
+    CHECK(DiagnosticsCounters::convertLqiToRssi(0) == -98);
+    CHECK(DiagnosticsCounters::convertLqiToRssi(255) == -9);
+    bool monotonic = true;
+    for(int lqi = 1; lqi <= 255; lqi++)
+        if(DiagnosticsCounters::convertLqiToRssi(lqi) < DiagnosticsCounters::convertLqiToRssi(lqi - 1))
+            monotonic = false;
+    CHECK(monotonic);
+}
+
+static void testMacStatus()
+{
+    printf("testMacStatus\n");
+    CHECK(DiagnosticsCounters::isMacStatus(DiagnosticsCounters::MAC_STATUS_NO_ACK));
+    CHECK(DiagnosticsCounters::isMacStatus(MAC_STATUS_CHANNEL_ACCESS_FAILURE));
+    CHECK(!DiagnosticsCounters::isMacStatus(0));
+    CHECK(!DiagnosticsCounters::isMacStatus(APS_STATUS_NO_ACK));
+}
+
+static void testSaturation()
+{
+    printf("testSaturation\n");
+    CHECK(DiagnosticsCounters::saturate16(0) == 0);
+    CHECK(DiagnosticsCounters::saturate16(0xFFFF) == 0xFFFF);
+    CHECK(DiagnosticsCounters::saturate16(0x10000) == 0xFFFF);
+    CHECK(DiagnosticsCounters::saturate16(0xFFFFFFFF) == 0xFFFF);
+}
+
+int main()
+{
+    testInitialState();
+    testUnicastConfirms();
+    testApsAck();
+    testAverageMacRetries();
+    testOtherCounters();
+    testLinkQuality();
+    testMacStatus();
+    testSaturation();
+
+    return testResult();
+}
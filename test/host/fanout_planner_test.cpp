@@ -0,0 +1,158 @@
+// Tests for the fan-out planner: common group detection, membership expiry, query rate limiting and
+// groupcast accounting.
+
+#include <stdio.h>
+
+#include "FanoutPlanner.h"
+#include "test_common.h"
+
+static const FanoutTarget TARGET1 = {0x00158d0000000001ULL, 1};
+static const FanoutTarget TARGET2 = {0x00158d0000000002ULL, 1};
+static const FanoutTarget TARGET3 = {0x00158d0000000002ULL, 2};     // Another endpoint of the same device
+
+static void testFanoutThreshold()
+{
+    printf("testFanoutThreshold\n");
+
+    CHECK(!FanoutPlanner::isFanout(1));
+    CHECK(!FanoutPlanner::isFanout(FanoutPlanner::MIN_FANOUT - 1));
+    CHECK(FanoutPlanner::isFanout(FanoutPlanner::MIN_FANOUT));
+}
+
+static void testCommonGroup()
+{
+    printf("testCommonGroup\n");
+    FanoutPlanner planner;
+    FanoutTarget targets[] = {TARGET1, TARGET2, TARGET3};
+    uint16 group = 0;
+
+    uint16 groups1[] = {0x0010, 0x0020};
+    uint16 groups2[] = {0x0030, 0x0020};
+    uint16 groups3[] = {0x0020};
+    planner.setMembership(TARGET1, groups1, 2, 1000);
+    planner.setMembership(TARGET2, groups2, 2, 1000);
+
+    // Membership of one of the targets is not known yet
+    CHECK(!planner.findCommonGroup(targets, 3, 1000, &group));
+
+    planner.setMembership(TARGET3, groups3, 1, 1000);
+    CHECK(planner.findCommonGroup(targets, 3, 1000, &group));
+    CHECK(group == 0x0020);
+
+    // Target left the common group
+    planner.setMembership(TARGET3, groups1, 1, 2000);
+    CHECK(!planner.findCommonGroup(targets, 3, 2000, &group));
+
+    // Nothing is known after invalidation
+    planner.setMembership(TARGET3, groups3, 1, 3000);
+    planner.invalidate();
+    CHECK(!planner.findCommonGroup(targets, 3, 3000, &group));
+}
+
+static void testMembershipExpires()
+{
+    printf("testMembershipExpires\n");
+    FanoutPlanner planner;
+    FanoutTarget targets[] = {TARGET1, TARGET2, TARGET3};
+    uint16 group = 0;
+
+    for(uint8 i = 0; i < 3; i++)
+        planner.addMembership(targets[i], 0x0042, 0xfffff000);     // close to timer wraparound
+
+    CHECK(planner.findCommonGroup(targets, 3, 0xfffff000 + FanoutPlanner::MEMBERSHIP_TTL - 1, &group));
+    CHECK(group == 0x0042);
+    CHECK(!planner.findCommonGroup(targets, 3, 0xfffff000 + FanoutPlanner::MEMBERSHIP_TTL, &group));
+}
+
+static void testAddMembershipKeepsKnownGroups()
+{
+    printf("testAddMembershipKeepsKnownGroups\n");
+    FanoutPlanner planner;
+    FanoutTarget targets[] = {TARGET1, TARGET2};
+    uint16 group = 0;
+
+    uint16 groups[] = {0x0010};
+    planner.setMembership(TARGET1, groups, 1, 0);
+    planner.setMembership(TARGET2, groups, 1, 0);
+    planner.addMembership(TARGET1, 0x0020, 100);
+    planner.addMembership(TARGET1, 0x0020, 100);       // duplicates are ignored
+
+    CHECK(planner.findCommonGroup(targets, 2, 200, &group));
+    CHECK(group == 0x0010);
+}
+
+static void testQueryRateLimit()
+{
+    printf("testQueryRateLimit\n");
+    FanoutPlanner planner;
+    uint32 now = 5000;
+
+    CHECK(planner.needsQuery(TARGET1, now));
+    CHECK(!planner.needsQuery(TARGET1, now + 10));
+    CHECK(!planner.needsQuery(TARGET1, now + FanoutPlanner::QUERY_INTERVAL - 1));
+    CHECK(planner.needsQuery(TARGET1, now + FanoutPlanner::QUERY_INTERVAL));
+
+    // No queries while the membership is known
+    now += FanoutPlanner::QUERY_INTERVAL;
+    uint16 groups[] = {0x0001};
+    planner.setMembership(TARGET1, groups, 1, now);
+    CHECK(!planner.needsQuery(TARGET1, now + FanoutPlanner::QUERY_INTERVAL));
+    CHECK(planner.needsQuery(TARGET1, now + FanoutPlanner::MEMBERSHIP_TTL));
+}
+
+static void testCacheEviction()
+{
+    printf("testCacheEviction\n");
+    FanoutPlanner planner;
+    FanoutTarget targets[] = {TARGET1, TARGET2};
+    uint16 group = 0;
+    uint16 groups[] = {0x0007};
+
+    planner.setMembership(TARGET1, groups, 1, 100);
+    planner.setMembership(TARGET2, groups, 1, 200);
+    for(uint8 i = 0; i < FanoutPlanner::MAX_MEMBERSHIPS - 2; i++)
+    {
+        FanoutTarget other = {0x1000ULL + i, 1};
+        planner.setMembership(other, groups, 1, 300 + i);
+    }
+
+    CHECK(planner.findCommonGroup(targets, 2, 1000, &group));
+
+    // The oldest record (TARGET1) is replaced
+    FanoutTarget newcomer = {0x2000, 1};
+    planner.setMembership(newcomer, groups, 1, 1000);
+    CHECK(!planner.findCommonGroup(targets, 2, 1000, &group));
+    CHECK(planner.findCommonGroup(targets + 1, 1, 1000, &group));
+}
+
+static void testGroupcastStatistics()
+{
+    printf("testGroupcastStatistics\n");
+    FanoutPlanner planner;
+
+    planner.handleGroupcast(4);
+    planner.handleGroupcast(3);
+
+    const FanoutStatistics & stats = planner.getStatistics();
+    CHECK(stats.groupcasts == 2);
+    CHECK(stats.framesAvoided == 5);
+    CHECK(stats.unicastFanouts == 0);
+
+    // Commands that still go to each target separately avoid nothing
+    planner.handleUnicastFanout();
+    CHECK(stats.unicastFanouts == 1);
+    CHECK(stats.framesAvoided == 5);
+}
+
+int main()
+{
+    testFanoutThreshold();
+    testCommonGroup();
+    testMembershipExpires();
+    testAddMembershipKeepsKnownGroups();
+    testQueryRateLimit();
+    testCacheEviction();
+    testGroupcastStatistics();
+
+    return testResult();
+}
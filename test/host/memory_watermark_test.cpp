@@ -0,0 +1,128 @@
+// Tests for the stack and heap high-water mark detection.
+
+#include <stdio.h>
+
+#include "MemoryWatermark.h"
+#include "test_common.h"
+
+static const uint32 WORDS = 64;
+static uint32 region[WORDS + 2];        // guard words on both sides
+
+static uint32 * regionStart()
+{
+    return region + 1;
+}
+
+static uint32 * regionEnd()
+{
+    return region + 1 + WORDS;
+}
+
+static void resetRegion()
+{
+    for(uint32 i = 0; i < WORDS + 2; i++)
+        region[i] = 0x12345678;
+}
+
+static void testStackPaintedBelowBoundary()
+{
+    printf("testStackPaintedBelowBoundary\n");
+    resetRegion();
+
+    // The top 8 words are the frames active while painting
+    MemoryWatermark stack;
+    stack.init(regionStart(), regionEnd(), MemoryWatermark::GROWS_DOWN);
+    stack.paint(regionEnd() - 8);
+
+    CHECK(stack.getSize() == WORDS * 4);
+    CHECK(stack.getMaxUsed() == 8 * 4);
+    CHECK(regionStart()[0] == MemoryWatermark::PATTERN);
+    CHECK(regionEnd()[-9] == MemoryWatermark::PATTERN);
+    CHECK(regionEnd()[-8] == 0x12345678);
+
+    // Guard words are not touched
+    CHECK(region[0] == 0x12345678);
+    CHECK(region[WORDS + 1] == 0x12345678);
+
+    CHECK(stack.update() == 8 * 4);
+}
+
+static void testStackDeepestUseKept()
+{
+    printf("testStackDeepestUseKept\n");
+    resetRegion();
+
+    MemoryWatermark stack;
+    stack.init(regionStart(), regionEnd(), MemoryWatermark::GROWS_DOWN);
+    stack.paint(regionEnd() - 4);
+
+    // A deep call chain, with some words of its frames never written
+    regionEnd()[-20] = 0;
+    regionEnd()[-12] = 0;
+    CHECK(stack.update() == 20 * 4);
+
+    // Shallower use later does not lower the mark
+    regionEnd()[-6] = 0;
+    CHECK(stack.update() == 20 * 4);
+    CHECK(!stack.isExhausted());
+
+    // The last word used, the stack may have overflowed
+    regionStart()[0] = 0;
+    CHECK(stack.update() == WORDS * 4);
+    CHECK(stack.isExhausted());
+}
+
+static void testHeapGrowsUp()
+{
+    printf("testHeapGrowsUp\n");
+    resetRegion();
+
+    MemoryWatermark heap;
+    heap.init(regionStart(), regionEnd(), MemoryWatermark::GROWS_UP);
+    heap.paint(regionStart());
+    CHECK(heap.getMaxUsed() == 0);
+    CHECK(heap.update() == 0);
+    CHECK(regionStart()[0] == MemoryWatermark::PATTERN);
+    CHECK(regionEnd()[-1] == MemoryWatermark::PATTERN);
+
+    // Allocations from the start of the heap
+    regionStart()[0] = 1;
+    regionStart()[9] = 1;
+    CHECK(heap.update() == 10 * 4);
+
+    regionEnd()[-1] = 1;
+    CHECK(heap.update() == WORDS * 4);
+    CHECK(heap.isExhausted());
+}
+
+static void testBoundaryOutsideRegion()
+{
+    printf("testBoundaryOutsideRegion\n");
+    resetRegion();
+
+    // The stack pointer is above the region (painting from another stack), everything is painted
+    MemoryWatermark stack;
+    stack.init(regionStart(), regionEnd(), MemoryWatermark::GROWS_DOWN);
+    stack.paint(regionEnd() + 100);
+    CHECK(stack.getMaxUsed() == 0);
+    CHECK(regionEnd()[-1] == MemoryWatermark::PATTERN);
+    CHECK(region[WORDS + 1] == 0x12345678);
+
+    // Empty region
+    MemoryWatermark empty;
+    empty.init(regionStart(), regionStart(), MemoryWatermark::GROWS_UP);
+    empty.paint(regionStart());
+    CHECK(empty.getSize() == 0);
+    CHECK(empty.update() == 0);
+    CHECK(!empty.isExhausted());
+}
+
+int main()
+{
+    testStackPaintedBelowBoundary();
+    testStackDeepestUseKept();
+    testHeapGrowsUp();
+    testBoundaryOutsideRegion();
+
+    return testResult();
+}
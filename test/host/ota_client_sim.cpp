@@ -0,0 +1,818 @@
+// OTA client side of the end-to-end upgrade simulation (see scripts/OTAServerSim/ota_server_sim.py).
+//
+// The program plays the device: a stand-in for the SDK OTA client (file header parsing, block and page requests,
+// flash callbacks, context save requests) wired to the same platform independent classes the firmware uses in
+// OTAHandlers - OTATransferPolicy and OTAImageWriter. The flash and the PDM are simulated in RAM. With --reset-at
+// the power is lost once, right after the block reaching the given file offset gets to the flash, and the download
+// resumes from the persisted context. A --sleepy device flushes the context when it sleeps, as OTAHandlers does.
+//
+// It talks to the server simulator over stdin/stdout, one event per line, times are virtual ms:
+//   in:  <time> TICK                   - the time the client asked for with WAKE has come
+//        <time> RX <hex>               - an OTA cluster command from the server (command id, then ZCL payload)
+//   out: <time> TX <hex>               - an OTA cluster command to the server
+//        WAKE <time>                   - the client wants a TICK at the given time (-1 if nothing is scheduled)
+//        REPORT <key>=<value> ...      - the upgrade is over, followed by WAKE -1
+//
+// Usage: ota_client_sim [--block-requests] [--base <running firmware image>] [--manufacturer <code>] [--image-type <type>]
+//                       [--reset-at <file offset>] [--sleepy]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "OTATransferPolicy.h"
+#include "OTAImageWriter.h"
+
+// OTA cluster commands
+static const uint8 CMD_QUERY_NEXT_IMAGE_REQUEST = 0x01;
+static const uint8 CMD_QUERY_NEXT_IMAGE_RESPONSE = 0x02;
+static const uint8 CMD_IMAGE_BLOCK_REQUEST = 0x03;
+static const uint8 CMD_IMAGE_PAGE_REQUEST = 0x04;
+static const uint8 CMD_IMAGE_BLOCK_RESPONSE = 0x05;
+static const uint8 CMD_UPGRADE_END_REQUEST = 0x06;
+static const uint8 CMD_UPGRADE_END_RESPONSE = 0x07;
+
+static const uint8 STATUS_SUCCESS = 0x00;
+static const uint8 STATUS_ABORT = 0x95;
+static const uint8 STATUS_INVALID_IMAGE = 0x96;
+static const uint8 STATUS_WAIT_FOR_DATA = 0x97;
+
+// Upgrade status attribute values saved with the context
+static const uint8 UPGRADE_STATUS_NORMAL = 0;
+static const uint8 UPGRADE_STATUS_DOWNLOAD_IN_PROGRESS = 1;
+static const uint8 UPGRADE_STATUS_DOWNLOAD_COMPLETE = 2;
+
+// Device identity reported in the Query Next Image Request (MANUFACTURER_ID and FIRMWARE_FILE_TYPE of the build)
+static const uint16 DEFAULT_MANUFACTURER_CODE = 0x115f;
+static const uint16 DEFAULT_IMAGE_TYPE = 0x0101;
+static const uint32 FILE_VERSION = 0x00000001;
+
+// Flash layout of OTAHandlers
+static const uint32 FLASH_SECTOR_SIZE = 32 * 1024;
+static const uint8 FLASH_START_SECTOR = 8;
+static const uint8 FLASH_MAX_SECTORS = 8;
+static const uint32 FLASH_AREA_SIZE = FLASH_SECTOR_SIZE * FLASH_MAX_SECTORS;
+
+static const uint8 MAX_APS_PAYLOAD = 82;                // Unicast with NWK security, no fragmentation
+static const uint32 SECTOR_ERASE_TIME = 40;             // ms, JN5169 datasheet typical
+static const uint32 QUERY_RETRY_INTERVAL = 5000;        // ms
+static const uint32 RESUME_DELAY = 10000;               // ms, OTAHandlers::restoreOTAAttributes() retries in 10 s
+static const uint16 OTA_HEADER_LENGTH_OFFSET = 6;
+static const uint8 ELEMENT_HEADER_SIZE = 6;
+static const uint16 ELEMENT_TAG_UPGRADE_IMAGE = 0;
+static const uint32 NO_TIME = 0xffffffff;
+
+static void put16(std::vector<uint8> & frame, uint16 value)
+{
+    frame.push_back(value & 0xff);
+    frame.push_back(value >> 8);
+}
+
+static void put32(std::vector<uint8> & frame, uint32 value)
+{
+    put16(frame, value & 0xffff);
+    put16(frame, value >> 16);
+}
+
+static uint16 get16(const uint8 * data)
+{
+    return data[0] | (data[1] << 8);
+}
+
+static uint32 get32(const uint8 * data)
+{
+    return get16(data) | ((uint32)get16(data + 2) << 16);
+}
+
+// RAM copy of the OTA flash area and the running firmware
+class FlashSim : public IOTAFlash
+{
+    std::vector<uint8> flash;
+    std::vector<uint8> baseImage;
+    uint32 * clock;             // Erases block the CPU, the time moves on
+
+public:
+    uint32 badWrites;           // Writes to the flash which is not erased
+
+    FlashSim(uint32 * time)
+        : flash(FLASH_AREA_SIZE, 0)
+        , clock(time)
+    {
+        badWrites = 0;
+    }
+
+    void setBaseImage(const std::vector<uint8> & image)
+    {
+        baseImage = image;
+    }
+
+    uint32 crc(uint32 len) const
+    {
+        return ~OTAContextSaver::updateCrc(OTAContextSaver::CRC_INIT, &flash[0], len < FLASH_AREA_SIZE ? len : FLASH_AREA_SIZE);
+    }
+
+    virtual uint32 eraseFlashSector(uint8 sector)
+    {
+        memset(&flash[(sector - FLASH_START_SECTOR) * FLASH_SECTOR_SIZE], 0xff, FLASH_SECTOR_SIZE);
+        *clock += SECTOR_ERASE_TIME;
+        return SECTOR_ERASE_TIME * 1000;
+    }
+
+    virtual void writeFlash(uint32 offset, const uint8 * data, uint16 len)
+    {
+        // Flash bits can only be cleared by a write
+        for(uint16 i = 0; i < len && offset + i < FLASH_AREA_SIZE; i++)
+        {
+            if((flash[offset + i] & data[i]) != data[i])
+                badWrites++;
+            flash[offset + i] &= data[i];
+        }
+    }
+
+    virtual void readFlash(uint32 offset, uint8 * data, uint16 len)
+    {
+        for(uint16 i = 0; i < len; i++)
+            data[i] = offset + i < FLASH_AREA_SIZE ? flash[offset + i] : 0xff;
+    }
+
+    virtual void readBaseImage(uint32 offset, uint8 * data, uint16 len)
+    {
+        for(uint16 i = 0; i < len; i++)
+            data[i] = offset + i < baseImage.size() ? baseImage[offset + i] : 0xff;
+    }
+};
+
+// Counters of the OTAImageWriter lost with the power, the report covers the whole upgrade
+struct LostStatistics
+{
+    uint32 contexts;
+    uint32 pdmWrites;
+    uint32 onDemandErases;
+    uint32 backgroundErases;
+    uint32 stallTime;
+    uint32 stallTimeRemoved;
+};
+
+// The device: SDK OTA client stand-in and the OTAHandlers glue around the OTAImageWriter
+class OTAClientSim
+{
+    enum State
+    {
+        STATE_QUERY,
+        STATE_DOWNLOAD,
+        STATE_UPGRADE_END,
+        STATE_DONE
+    };
+
+    bool pageRequests;
+    uint16 manufacturerCode;
+    uint16 imageType;
+    uint32 resetAt;             // File offset to lose the power at, 0 for none
+    bool sleepy;
+
+    uint32 now;                 // Includes the time the CPU spends in flash erases
+    FlashSim flash;
+    OTATransferPolicy transferPolicy;
+    OTAImageWriter imageWriter;
+
+    State state;
+    uint32 lastEventTime;
+    uint32 nextRequestTime;
+    uint32 responseDeadline;
+    uint32 requestsSent;
+    uint32 downloadStartTime;
+
+    // SDK side of the download
+    uint32 fileSize;
+    uint32 fileOffset;
+    uint32 pageEnd;
+    std::vector<uint8> fileHeader;  // OTA header and the element header being parsed
+    uint32 elementStart;            // File offset of the upgrade image data, 0 till known
+    uint32 elementSize;
+    uint8 upgradeEndStatus;
+
+    // OTAHandlers side: the latest context in RAM, and what is in the PDM
+    uint32 contextOffset;
+    uint8 contextStatus;
+    uint32 persistedOffset;
+    uint8 persistedStatus;
+    uint8 persistedFormat;
+    OTAPartialSector persistedPartialSector;
+
+    uint32 resets;
+    uint32 resumeOffset;
+    LostStatistics lostStats;
+
+public:
+    OTAClientSim(bool pages, uint16 manufacturer, uint16 type, uint32 resetOffset, bool sleepyDevice)
+        : pageRequests(pages)
+        , manufacturerCode(manufacturer)
+        , imageType(type)
+        , resetAt(resetOffset)
+        , sleepy(sleepyDevice)
+        , now(0)
+        , flash(&now)
+        , imageWriter(&flash, FLASH_SECTOR_SIZE, FLASH_START_SECTOR, FLASH_MAX_SECTORS)
+    {
+        transferPolicy.configure(OTATransferPolicy::getMaxBlockSize(MAX_APS_PAYLOAD),
+                                 OTATransferPolicy::DEFAULT_PAGE_SIZE,
+                                 OTATransferPolicy::DEFAULT_MIN_REQUEST_DELAY,
+                                 OTATransferPolicy::DEFAULT_RESPONSE_TIMEOUT);
+        imageWriter.init(0, UPGRADE_STATUS_NORMAL, OTA_IMAGE_FORMAT_PLAIN);
+
+        state = STATE_QUERY;
+        lastEventTime = 0;
+        nextRequestTime = 0;
+        responseDeadline = NO_TIME;
+        requestsSent = 0;
+        downloadStartTime = 0;
+        fileSize = 0;
+        fileOffset = 0;
+        pageEnd = 0;
+        elementStart = 0;
+        elementSize = 0;
+        upgradeEndStatus = STATUS_SUCCESS;
+
+        contextOffset = 0;
+        contextStatus = UPGRADE_STATUS_NORMAL;
+        persistedOffset = 0;
+        persistedStatus = UPGRADE_STATUS_NORMAL;
+        persistedFormat = OTA_IMAGE_FORMAT_PLAIN;
+        persistedPartialSector.fileOffset = 0;
+        persistedPartialSector.crc = OTAContextSaver::CRC_INIT;
+        persistedPartialSector.elementStart = 0;
+
+        resets = 0;
+        resumeOffset = 0;
+        memset(&lostStats, 0, sizeof(lostStats));
+    }
+
+    void setBaseImage(const std::vector<uint8> & image)
+    {
+        flash.setBaseImage(image);
+    }
+
+    bool isDone() const
+    {
+        return state == STATE_DONE;
+    }
+
+    void handleTick(uint32 time)
+    {
+        startEvent(time);
+
+        if(responseDeadline != NO_TIME && now >= responseDeadline)
+            handleResponseTimeout();
+
+        if(nextRequestTime != NO_TIME && now >= nextRequestTime)
+            sendRequest();
+
+        finishEvent();
+    }
+
+    void handleFrame(uint32 time, const std::vector<uint8> & frame)
+    {
+        startEvent(time);
+
+        if(!frame.empty())
+        {
+            switch(frame[0])
+            {
+            case CMD_QUERY_NEXT_IMAGE_RESPONSE:
+                handleQueryImageResponse(&frame[1], frame.size() - 1);
+                break;
+            case CMD_IMAGE_BLOCK_RESPONSE:
+                handleBlockResponse(&frame[1], frame.size() - 1);
+                break;
+            case CMD_UPGRADE_END_RESPONSE:
+                handleUpgradeEndResponse();
+                break;
+            default:
+                break;
+            }
+        }
+
+        finishEvent();
+    }
+
+private:
+    void startEvent(uint32 time)
+    {
+        // The main loop was idle since the previous event, OTAHandlers::handleIdle() erases a sector per iteration
+        // (the erase moves the time on). Erases that do not fit before the event are not started.
+        now = lastEventTime;
+        while(time > now && time - now >= SECTOR_ERASE_TIME && imageWriter.handleIdle(true))
+            ;
+
+        // An event that came while the CPU was busy is handled afterwards
+        if(time > now)
+            now = time;
+    }
+
+    void finishEvent()
+    {
+        // OTAHandlers::handleSleep()
+        if(sleepy && imageWriter.getContextSaver().flush(OTA_CONTEXT_FLUSH_SLEEP, now))
+            persistContext(true);
+
+        lastEventTime = now;
+
+        uint32 wake = NO_TIME;
+        if(nextRequestTime != NO_TIME)
+            wake = nextRequestTime;
+        if(responseDeadline != NO_TIME && responseDeadline < wake)
+            wake = responseDeadline;
+
+        if(wake == NO_TIME)
+            printf("WAKE -1\n");
+        else
+            printf("WAKE %u\n", wake > now ? wake : now);
+        fflush(stdout);
+    }
+
+    void send(const std::vector<uint8> & frame)
+    {
+        printf("%u TX ", now);
+        for(size_t i = 0; i < frame.size(); i++)
+            printf("%02x", frame[i]);
+        printf("\n");
+    }
+
+    void sendRequest()
+    {
+        std::vector<uint8> frame;
+        nextRequestTime = NO_TIME;
+        requestsSent++;
+
+        switch(state)
+        {
+        case STATE_QUERY:
+            frame.push_back(CMD_QUERY_NEXT_IMAGE_REQUEST);
+            frame.push_back(0);     // Field control: no hardware version
+            put16(frame, manufacturerCode);
+            put16(frame, imageType);
+            put32(frame, FILE_VERSION);
+            responseDeadline = now + QUERY_RETRY_INTERVAL;
+            break;
+
+        case STATE_DOWNLOAD:
+        {
+            uint8 blockSize = transferPolicy.getBlockSize();
+            uint16 spacing = transferPolicy.getRequestDelay();
+            frame.push_back(pageRequests ? CMD_IMAGE_PAGE_REQUEST : CMD_IMAGE_BLOCK_REQUEST);
+            frame.push_back(0);     // Field control: no node address, no block period
+            put16(frame, manufacturerCode);
+            put16(frame, imageType);
+            put32(frame, FILE_VERSION);
+            put32(frame, fileOffset);
+            frame.push_back(blockSize);
+
+            if(pageRequests)
+            {
+                uint16 pageSize = transferPolicy.getPageSize();
+                put16(frame, pageSize);
+                put16(frame, spacing);
+
+                // The page is over with its last block, or when the last block is late for too long
+                pageEnd = fileOffset + pageSize < fileSize ? fileOffset + pageSize : fileSize;
+                uint32 blocks = (pageEnd - fileOffset + blockSize - 1) / blockSize;
+                responseDeadline = now + blocks * spacing + OTATransferPolicy::DEFAULT_RESPONSE_TIMEOUT;
+            }
+            else
+            {
+                pageEnd = fileOffset + blockSize < fileSize ? fileOffset + blockSize : fileSize;
+                responseDeadline = now + OTATransferPolicy::DEFAULT_RESPONSE_TIMEOUT;
+            }
+            break;
+        }
+
+        case STATE_UPGRADE_END:
+            frame.push_back(CMD_UPGRADE_END_REQUEST);
+            frame.push_back(upgradeEndStatus);
+            put16(frame, manufacturerCode);
+            put16(frame, imageType);
+            put32(frame, FILE_VERSION);
+            responseDeadline = now + OTATransferPolicy::DEFAULT_RESPONSE_TIMEOUT;
+            break;
+
+        default:
+            return;
+        }
+
+        send(frame);
+    }
+
+    void handleResponseTimeout()
+    {
+        responseDeadline = NO_TIME;
+        if(state == STATE_DOWNLOAD)
+            transferPolicy.handleTimeout(now);
+
+        // Ask again, from the current offset
+        nextRequestTime = now;
+    }
+
+    void handleQueryImageResponse(const uint8 * data, size_t len)
+    {
+        if(state != STATE_QUERY || len < 1)
+            return;
+
+        if(data[0] != STATUS_SUCCESS || len < 13)
+        {
+            finish("no_image");
+            return;
+        }
+
+        fileSize = get32(data + 9);
+        downloadStartTime = now;
+        startDownload();
+    }
+
+    void startDownload()
+    {
+        fileOffset = 0;
+        fileHeader.clear();
+        elementStart = 0;
+        elementSize = 0;
+        upgradeEndStatus = STATUS_SUCCESS;
+        state = STATE_DOWNLOAD;
+
+        // OTAHandlers::handleQueryImageResponse()
+        imageWriter.startUpgrade(fileSize);
+        transferPolicy.start(fileSize, 0, now);
+        saveContext(UPGRADE_STATUS_DOWNLOAD_IN_PROGRESS);
+
+        responseDeadline = NO_TIME;
+        nextRequestTime = now;
+    }
+
+    void handleBlockResponse(const uint8 * data, size_t len)
+    {
+        if(state != STATE_DOWNLOAD || len < 1)
+            return;
+
+        switch(data[0])
+        {
+        case STATUS_SUCCESS:
+        {
+            if(len < 14)
+                return;
+
+            uint32 offset = get32(data + 9);
+            uint8 size = data[13];
+            if(len < 14u + size)
+                return;
+
+            // SDK takes the data in order only
+            if(offset == fileOffset)
+            {
+                handleFileData(data + 14, size);
+                fileOffset += size;
+
+                if(resetAt && !resets && fileOffset >= resetAt)
+                {
+                    powerLoss();
+                    return;
+                }
+
+                saveContext(UPGRADE_STATUS_DOWNLOAD_IN_PROGRESS);
+            }
+
+            transferPolicy.handleBlock(offset, size, now);
+
+            if(fileOffset >= fileSize)
+            {
+                finishDownload();
+                return;
+            }
+
+            // Block requests go one by one. A page with a gap is requested again right after its last block.
+            if(!pageRequests || offset + size >= pageEnd)
+            {
+                responseDeadline = NO_TIME;
+                nextRequestTime = now + (pageRequests ? 0 : transferPolicy.getRequestDelay());
+            }
+            break;
+        }
+
+        case STATUS_WAIT_FOR_DATA:
+        {
+            if(len < 11)
+                return;
+
+            uint32 delay = (get32(data + 5) - get32(data + 1)) * 1000;
+            transferPolicy.handleMinBlockPeriod(get16(data + 9));
+            transferPolicy.handleWaitForData(delay);
+            responseDeadline = NO_TIME;
+            nextRequestTime = now + (delay > transferPolicy.getRequestDelay() ? delay : transferPolicy.getRequestDelay());
+            break;
+        }
+
+        case STATUS_ABORT:
+            saveContext(UPGRADE_STATUS_NORMAL);
+            if(imageWriter.getContextSaver().flush(OTA_CONTEXT_FLUSH_ABORT, now))
+                persistContext(true);
+            imageWriter.abort();
+            finish("aborted");
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    void handleUpgradeEndResponse()
+    {
+        if(state != STATE_UPGRADE_END)
+            return;
+
+        finish(upgradeEndStatus == STATUS_SUCCESS ? "ok" : "invalid_image");
+    }
+
+    // SDK: parses the OTA file header and the element headers, the upgrade image goes to the flash
+    void handleFileData(const uint8 * data, uint8 len)
+    {
+        for(uint8 i = 0; i < len; )
+        {
+            uint32 offset = fileOffset + i;
+            if(elementStart == 0)
+            {
+                fileHeader.push_back(data[i++]);
+                if(fileHeader.size() < OTA_HEADER_LENGTH_OFFSET + 2u)
+                    continue;
+
+                uint32 headerLength = get16(&fileHeader[OTA_HEADER_LENGTH_OFFSET]);
+                if(fileHeader.size() == headerLength + ELEMENT_HEADER_SIZE)
+                {
+                    uint16 tag = get16(&fileHeader[headerLength]);
+                    elementSize = get32(&fileHeader[headerLength + 2]);
+                    elementStart = headerLength + ELEMENT_HEADER_SIZE;
+                    if(tag != ELEMENT_TAG_UPGRADE_IMAGE)
+                        upgradeEndStatus = STATUS_INVALID_IMAGE;
+                }
+                continue;
+            }
+
+            // Other elements (signatures, certificates) are not written
+            if(offset >= elementStart + elementSize)
+                return;
+
+            uint32 chunk = len - i;
+            if(chunk > elementStart + elementSize - offset)
+                chunk = elementStart + elementSize - offset;
+
+            uint32 imageOffset = offset - elementStart;
+            uint32 sectorEnd = (imageOffset / FLASH_SECTOR_SIZE + 1) * FLASH_SECTOR_SIZE;
+            if(chunk > sectorEnd - imageOffset)
+                chunk = sectorEnd - imageOffset;
+
+            // SDK erases a sector as the image reaches it
+            if(imageOffset % FLASH_SECTOR_SIZE == 0)
+                imageWriter.handleFlashErase(FLASH_START_SECTOR + imageOffset / FLASH_SECTOR_SIZE);
+            handleWriteResult(imageWriter.handleFlashWrite(imageOffset, chunk, data + i));
+            i += chunk;
+        }
+    }
+
+    void finishDownload()
+    {
+        // SDK verifies the image length, the OTAImageWriter verifies the decoded image
+        const OTAImageDecoder & imageDecoder = imageWriter.getImageDecoder();
+        if(elementStart == 0 || fileOffset < elementStart + elementSize)
+            upgradeEndStatus = STATUS_INVALID_IMAGE;
+        if(isCompressed() && (!imageDecoder.isComplete() || flash.crc(imageDecoder.getImageSize()) != imageDecoder.getImageCrc()))
+            upgradeEndStatus = STATUS_INVALID_IMAGE;
+
+        saveContext(UPGRADE_STATUS_DOWNLOAD_COMPLETE);
+        state = STATE_UPGRADE_END;
+        responseDeadline = NO_TIME;
+        nextRequestTime = now;
+    }
+
+    void finish(const char * status)
+    {
+        imageWriter.stop();
+        state = STATE_DONE;
+        nextRequestTime = NO_TIME;
+        responseDeadline = NO_TIME;
+        report(status);
+    }
+
+    bool isCompressed() const
+    {
+        return imageWriter.getImageFormat() == OTA_IMAGE_FORMAT_COMPRESSED;
+    }
+
+    // OTAHandlers::saveOTAContext()
+    void saveContext(uint8 status)
+    {
+        contextOffset = fileOffset;
+        contextStatus = status;
+        if(imageWriter.getContextSaver().handleContext(fileOffset, status, now))
+            persistContext(false);
+    }
+
+    // OTAHandlers::persistOTAContext()
+    void persistContext(bool withPartialSector)
+    {
+        persistedOffset = contextOffset;
+        persistedStatus = contextStatus;
+        uint8 writes = 1;
+
+        if(imageWriter.updatePartialSector(contextOffset, withPartialSector, &persistedPartialSector))
+            writes++;
+
+        imageWriter.getContextSaver().handlePdmWrites(writes);
+    }
+
+    // OTAHandlers::handleWriteResult(), the format is persisted
+    void handleWriteResult(OTAImageWriteResult result)
+    {
+        if(result == OTA_IMAGE_WRITE_STARTED && persistedFormat != imageWriter.getImageFormat())
+        {
+            persistedFormat = imageWriter.getImageFormat();
+            imageWriter.getContextSaver().handlePdmWrites(1);
+        }
+    }
+
+    // The block got to the flash, but its context was not saved yet. RAM is lost, the flash and the PDM are not.
+    void powerLoss()
+    {
+        const OTAContextStatistics & contextStats = imageWriter.getContextSaver().getStatistics();
+        const OTAStorageStatistics & storageStats = imageWriter.getStorageManager().getStatistics();
+        lostStats.contexts += contextStats.upgradeContexts;
+        lostStats.pdmWrites += contextStats.upgradePdmWrites;
+        lostStats.onDemandErases += storageStats.onDemandErases;
+        lostStats.backgroundErases += storageStats.backgroundErases;
+        lostStats.stallTime += storageStats.upgradeStallTime;
+        lostStats.stallTimeRemoved += storageStats.upgradeStallTimeRemoved;
+        resets++;
+
+        imageWriter = OTAImageWriter(&flash, FLASH_SECTOR_SIZE, FLASH_START_SECTOR, FLASH_MAX_SECTORS);
+
+        // OTAHandlers::verifyResumeOffset()
+        resumeOffset = persistedOffset;
+        imageWriter.init(persistedOffset, persistedStatus, persistedFormat);
+        bool resumed = persistedStatus == UPGRADE_STATUS_DOWNLOAD_IN_PROGRESS
+                    && imageWriter.resume(&resumeOffset, persistedStatus, persistedPartialSector);
+
+        // SDK retries the download after a while. The file header is a part of its persisted context, a download that
+        // cannot be resumed starts over with a new query.
+        if(resumed)
+        {
+            fileOffset = resumeOffset;
+            contextOffset = resumeOffset;
+            transferPolicy.start(fileSize, resumeOffset, now);
+        }
+        else
+        {
+            resumeOffset = 0;
+            imageWriter.init(0, UPGRADE_STATUS_NORMAL, persistedFormat);
+            startDownload();
+        }
+
+        responseDeadline = NO_TIME;
+        nextRequestTime = now + RESUME_DELAY;
+    }
+
+    void report(const char * status)
+    {
+        const OTATransferStatistics & transferStats = transferPolicy.getStatistics();
+        const OTAContextStatistics & contextStats = imageWriter.getContextSaver().getStatistics();
+        const OTAImageDecoderStatistics & decoderStats = imageWriter.getImageDecoder().getStatistics();
+        const OTAStorageStatistics & storageStats = imageWriter.getStorageManager().getStatistics();
+
+        uint32 imageSize = isCompressed() ? imageWriter.getImageDecoder().getImageSize() : elementSize;
+        printf("REPORT status=%s download_time=%u requests=%u blocks=%u out_of_order=%u timeouts=%u "
+               "wait_for_data=%u block_size=%u max_request_delay=%u "
+               "contexts=%u pdm_writes=%u format=%s payload_size=%u image_size=%u image_crc=0x%08x bad_writes=%u "
+               "erases_on_demand=%u erases_background=%u stall_ms=%u stall_removed_ms=%u "
+               "resets=%u resume_offset=%u sector_restarts=%u\n",
+               status,
+               now - downloadStartTime,
+               requestsSent,
+               transferStats.blocksReceived,
+               transferStats.blocksOutOfOrder,
+               transferStats.timeouts,
+               transferStats.waitForData,
+               transferPolicy.getBlockSize(),
+               transferStats.maxRequestDelay,
+               lostStats.contexts + contextStats.upgradeContexts,
+               lostStats.pdmWrites + contextStats.upgradePdmWrites,
+               !isCompressed() ? "plain" : decoderStats.deltaImages ? "delta" : "compressed",
+               elementSize,
+               imageSize,
+               flash.crc(imageSize),
+               flash.badWrites,
+               lostStats.onDemandErases + storageStats.onDemandErases,
+               lostStats.backgroundErases + storageStats.backgroundErases,
+               (lostStats.stallTime + storageStats.upgradeStallTime) / 1000,
+               (lostStats.stallTimeRemoved + storageStats.upgradeStallTimeRemoved) / 1000,
+               resets,
+               resumeOffset,
+               contextStats.rewinds);
+    }
+};
+
+static bool parseHex(const char * hex, std::vector<uint8> & frame)
+{
+    size_t len = strlen(hex);
+    if(len % 2)
+        return false;
+
+    for(size_t i = 0; i < len; i += 2)
+    {
+        char byte[3] = {hex[i], hex[i + 1], 0};
+        char * end;
+        frame.push_back((uint8)strtoul(byte, &end, 16));
+        if(*end)
+            return false;
+    }
+    return true;
+}
+
+static bool readFile(const char * path, std::vector<uint8> & data)
+{
+    FILE * f = fopen(path, "rb");
+    if(!f)
+        return false;
+
+    uint8 buf[4096];
+    size_t len;
+    while((len = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + len);
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    bool pageRequests = true;
+    uint16 manufacturerCode = DEFAULT_MANUFACTURER_CODE;
+    uint16 imageType = DEFAULT_IMAGE_TYPE;
+    std::vector<uint8> baseImage;
+    uint32 resetAt = 0;
+    bool sleepy = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--block-requests") == 0)
+            pageRequests = false;
+        else if(strcmp(argv[i], "--base") == 0 && i + 1 < argc)
+        {
+            if(!readFile(argv[++i], baseImage))
+            {
+                fprintf(stderr, "Cannot read %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "--manufacturer") == 0 && i + 1 < argc)
+            manufacturerCode = strtoul(argv[++i], NULL, 0);
+        else if(strcmp(argv[i], "--image-type") == 0 && i + 1 < argc)
+            imageType = strtoul(argv[++i], NULL, 0);
+        else if(strcmp(argv[i], "--reset-at") == 0 && i + 1 < argc)
+            resetAt = strtoul(argv[++i], NULL, 0);
+        else if(strcmp(argv[i], "--sleepy") == 0)
+            sleepy = true;
+        else
+        {
+            fprintf(stderr, "Usage: %s [--block-requests] [--base <running firmware image>] "
+                            "[--manufacturer <code>] [--image-type <type>] [--reset-at <file offset>] [--sleepy]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    OTAClientSim client(pageRequests, manufacturerCode, imageType, resetAt, sleepy);
+    client.setBaseImage(baseImage);
+
+    char line[1024];
+    while(!client.isDone() && fgets(line, sizeof(line), stdin))
+    {
+        char event[16];
+        char hex[512];
+        unsigned int time;
+        int fields = sscanf(line, "%u %15s %511s", &time, event, hex);
+
+        if(fields == 2 && strcmp(event, "TICK") == 0)
+            client.handleTick(time);
+        else if(fields == 3 && strcmp(event, "RX") == 0)
+        {
+            std::vector<uint8> frame;
+            if(!parseHex(hex, frame))
+            {
+                fprintf(stderr, "Malformed frame: %s", line);
+                return 1;
+            }
+            client.handleFrame(time, frame);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown event: %s", line);
+            return 1;
+        }
+    }
+
+    return client.isDone() ? 0 : 1;
+}
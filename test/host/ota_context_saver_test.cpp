@@ -0,0 +1,368 @@
+// Tests for the OTA context persistence policy.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "OTAContextSaver.h"
+#include "test_common.h"
+
+static const uint32 SECTOR = 32 * 1024;
+static const uint8 STATUS_NORMAL = 0;
+static const uint8 STATUS_DOWNLOADING = 1;
+static const uint8 STATUS_DOWNLOAD_COMPLETE = 2;
+
+static void testCrc()
+{
+    printf("testCrc\n");
+
+    // Standard CRC-32 check value
+    const char * data = "123456789";
+    CHECK(~OTAContextSaver::updateCrc(OTAContextSaver::CRC_INIT, (const uint8 *)data, 9) == 0xcbf43926);
+
+    // Calculation may be split into chunks
+    uint32 crc = OTAContextSaver::updateCrc(OTAContextSaver::CRC_INIT, (const uint8 *)data, 4);
+    crc = OTAContextSaver::updateCrc(crc, (const uint8 *)data + 4, 5);
+    CHECK(~crc == 0xcbf43926);
+}
+
+static void testSectorMath()
+{
+    printf("testSectorMath\n");
+    OTAContextSaver saver;
+
+    CHECK(saver.getSectorStart(0) == 0);
+    CHECK(saver.getSectorStart(SECTOR - 1) == 0);
+    CHECK(saver.getSectorStart(SECTOR) == SECTOR);
+    CHECK(saver.getSectorStart(3 * SECTOR + 100) == 3 * SECTOR);
+    CHECK(saver.isSectorBoundary(0));
+    CHECK(saver.isSectorBoundary(2 * SECTOR));
+    CHECK(!saver.isSectorBoundary(2 * SECTOR + 48));
+}
+
+static void testElementStart()
+{
+    printf("testElementStart\n");
+    OTAContextSaver saver(256);
+
+    // The first block brings a 62 byte OTA header and 2 bytes of the image
+    saver.handleContext(0, STATUS_DOWNLOADING, 0);
+    saver.handleFlashWrite(0, 2);
+    CHECK(saver.handleContext(64, STATUS_DOWNLOADING, 0));     // learned, saved right away
+    CHECK(saver.getElementStart() == 62);
+
+    // Sectors are counted on the flash
+    CHECK(saver.getFlashOffset(30) == 0);
+    CHECK(saver.getFlashOffset(2 * 256 + 30) == 256 + 224);
+    CHECK(saver.getSectorStart(200) == 0);
+    CHECK(saver.getSectorStart(2 * 256 + 30) == 62 + 256);
+    CHECK(saver.isSectorBoundary(62 + 256));
+    CHECK(!saver.isSectorBoundary(256));
+    CHECK(!saver.isSectorBoundary(62));
+
+    // Saved once the flash sector is complete, not the file one
+    saver.handleFlashWrite(2, 190);
+    CHECK(!saver.handleContext(256, STATUS_DOWNLOADING, 0));
+    saver.handleFlashWrite(192, 64);
+    CHECK(saver.handleContext(62 + 256, STATUS_DOWNLOADING, 0));
+
+    // The next image may have a different header
+    saver.handleUpgradeStarted();
+    CHECK(saver.getElementStart() == 0);
+}
+
+// Flash of the resume test. Programming can only clear bits, like the real one.
+struct TestFlash
+{
+    static const uint32 SIZE = 4 * 256;
+    uint8 data[SIZE];
+    uint32 badWrites;
+
+    TestFlash() : badWrites(0) { memset(data, 0xff, sizeof(data)); }
+
+    void erase(uint32 sector) { memset(data + sector * 256, 0xff, 256); }
+
+    void program(uint32 offset, const uint8 * src, uint32 len)
+    {
+        for(uint32 i = 0; i < len; i++)
+        {
+            data[offset + i] &= src[i];
+            if(data[offset + i] != src[i])
+                badWrites++;
+        }
+    }
+
+    uint32 crc(uint32 start, uint32 end) const
+    {
+        return OTAContextSaver::updateCrc(OTAContextSaver::CRC_INIT, data + start, end - start);
+    }
+};
+
+struct PersistedContext
+{
+    uint32 offset;
+    uint32 elementStart;
+    uint32 crcOffset;
+    uint32 crc;
+};
+
+static const uint32 HEADER_SIZE = 62;
+static const uint32 RESUME_IMAGE_SIZE = 900;
+static const uint32 RESUME_BLOCK_SIZE = 40;
+
+static uint8 fileByte(uint32 fileOffset)
+{
+    return (uint8)(fileOffset * 7 + 3);
+}
+
+// Downloads the file from the given offset like the OTA cluster does: the image element goes to the flash, the
+// context is saved after each block. Sectors are erased when the writes reach them.
+static uint32 download(OTAContextSaver & saver, TestFlash & flash, PersistedContext & persisted,
+                       uint32 fileOffset, uint32 endOffset, bool flushMidSector, bool saveContext = true)
+{
+    uint32 fileSize = HEADER_SIZE + RESUME_IMAGE_SIZE;
+    while(fileOffset < endOffset && fileOffset < fileSize)
+    {
+        uint32 len = fileSize - fileOffset < RESUME_BLOCK_SIZE ? fileSize - fileOffset : RESUME_BLOCK_SIZE;
+        for(uint32 i = 0; i < len; i++)
+        {
+            if(fileOffset + i < HEADER_SIZE)
+                continue;
+
+            uint32 flashOffset = fileOffset + i - HEADER_SIZE;
+            if(flashOffset % 256 == 0)
+                flash.erase(flashOffset / 256);
+
+            uint8 b = fileByte(fileOffset + i);
+            flash.program(flashOffset, &b, 1);
+        }
+        if(fileOffset + len > HEADER_SIZE)
+        {
+            uint32 flashStart = fileOffset > HEADER_SIZE ? fileOffset - HEADER_SIZE : 0;
+            saver.handleFlashWrite(flashStart, fileOffset + len - HEADER_SIZE - flashStart);
+        }
+        fileOffset += len;
+        if(!saveContext)
+            continue;
+
+        bool save = saver.handleContext(fileOffset, STATUS_DOWNLOADING, 0);
+        bool withCrc = flushMidSector && !save && saver.flush(OTA_CONTEXT_FLUSH_ABORT, 0);
+        if(save || withCrc)
+        {
+            persisted.offset = fileOffset;
+            persisted.elementStart = saver.getElementStart();
+        }
+        if(withCrc && !saver.isSectorBoundary(fileOffset))
+        {
+            uint32 flashOffset = saver.getFlashOffset(fileOffset);
+            persisted.crcOffset = fileOffset;
+            persisted.crc = flash.crc(flashOffset - flashOffset % 256, flashOffset);
+        }
+    }
+
+    return fileOffset;
+}
+
+static void checkResume(uint32 flushAt, uint32 resetAt, bool expectRewind)
+{
+    OTAContextSaver saver(256);
+    TestFlash flash;
+    PersistedContext persisted = {0, 0, 0, OTAContextSaver::CRC_INIT};
+
+    // Context is persisted with the CRC at flushAt, blocks keep coming till the reset. The last block gets to the
+    // flash, but not to the context.
+    download(saver, flash, persisted, 0, flushAt - RESUME_BLOCK_SIZE, false);
+    download(saver, flash, persisted, flushAt - RESUME_BLOCK_SIZE, flushAt, true);
+    download(saver, flash, persisted, flushAt, resetAt, false);
+    download(saver, flash, persisted, resetAt, resetAt + RESUME_BLOCK_SIZE, false, false);
+    CHECK(persisted.elementStart == HEADER_SIZE);
+
+    // Reset, the resume check works on the flash data
+    OTAContextSaver resumed(256);
+    resumed.init(persisted.offset, STATUS_DOWNLOADING);
+    resumed.setElementStart(persisted.elementStart);
+    uint32 flashOffset = resumed.getFlashOffset(persisted.offset);
+    bool partialSectorValid = !resumed.isSectorBoundary(persisted.offset)
+                           && persisted.crcOffset == persisted.offset
+                           && persisted.crc == flash.crc(flashOffset - flashOffset % 256, flashOffset);
+    uint32 resumeOffset = resumed.getResumeOffset(persisted.offset, partialSectorValid);
+    CHECK((resumed.getStatistics().rewinds == 1) == expectRewind);
+    if(resumeOffset != persisted.offset || !partialSectorValid)
+        flash.erase(resumed.getFlashOffset(resumeOffset) / 256);
+
+    // The rest of the image gets to the flash intact
+    resumed.init(resumeOffset, STATUS_DOWNLOADING);
+    download(resumed, flash, persisted, resumeOffset, 0xffffffff, false);
+    CHECK(flash.badWrites == 0);
+    bool intact = true;
+    for(uint32 i = 0; i < RESUME_IMAGE_SIZE; i++)
+        intact = intact && flash.data[i] == fileByte(HEADER_SIZE + i);
+    CHECK(intact);
+}
+
+static void testResumeAfterLateBlocks()
+{
+    printf("testResumeAfterLateBlocks\n");
+
+    // Image data starts at the file offset 62, its second flash sector at 318 and the third one at 574.
+    // Persisted mid-sector with a valid CRC, the blocks after it are written again with the same data. The lost
+    // block has reached the third sector, which is erased when the download gets there.
+    checkResume(440, 560, false);
+
+    // The context has moved to the third sector without the CRC: the sector is started over
+    checkResume(440, 640, true);
+}
+
+static void testStatusChangeSaved()
+{
+    printf("testStatusChangeSaved\n");
+    OTAContextSaver saver;
+
+    CHECK(saver.handleContext(0, STATUS_DOWNLOADING, 0));         // download started
+    CHECK(!saver.handleContext(64, STATUS_DOWNLOADING, 0));
+    CHECK(saver.isPending());
+    CHECK(saver.handleContext(128, STATUS_DOWNLOAD_COMPLETE, 0)); // download finished
+    CHECK(!saver.isPending());
+}
+
+static void testSavedAtSectorBoundaries()
+{
+    printf("testSavedAtSectorBoundaries\n");
+    OTAContextSaver saver;
+    saver.handleContext(0, STATUS_DOWNLOADING, 0);
+
+    uint32 saves = 0;
+    for(uint32 offset = 64; offset <= 3 * SECTOR; offset += 64)
+    {
+        if(saver.handleContext(offset, STATUS_DOWNLOADING, 0))
+        {
+            saves++;
+            CHECK(saver.isSectorBoundary(offset));
+        }
+    }
+
+    CHECK(saves == 3);
+    CHECK(!saver.isPending());
+
+    // Block size that does not divide the sector: saved with the first offset in the next sector
+    OTAContextSaver saver48;
+    saver48.handleContext(0, STATUS_DOWNLOADING, 0);
+    uint32 savedOffset = 0;
+    for(uint32 offset = 48; offset < SECTOR + 100; offset += 48)
+    {
+        if(saver48.handleContext(offset, STATUS_DOWNLOADING, 0))
+            savedOffset = offset;
+    }
+    CHECK(savedOffset == (SECTOR / 48 + 1) * 48);
+}
+
+static void testFlush()
+{
+    printf("testFlush\n");
+    OTAContextSaver saver;
+    saver.handleContext(0, STATUS_DOWNLOADING, 0);
+
+    // Nothing to flush
+    CHECK(!saver.flush(OTA_CONTEXT_FLUSH_SLEEP, 100000));
+
+    // Sleep flushes are rate limited, RAM is retained anyway
+    saver.handleContext(640, STATUS_DOWNLOADING, 1000);
+    CHECK(!saver.flush(OTA_CONTEXT_FLUSH_SLEEP, 2000));
+    CHECK(saver.flush(OTA_CONTEXT_FLUSH_SLEEP, 61000));
+    CHECK(!saver.flush(OTA_CONTEXT_FLUSH_SLEEP, 200000));  // already saved
+
+    // Abort is flushed right away
+    saver.handleContext(704, STATUS_DOWNLOADING, 62000);
+    CHECK(saver.flush(OTA_CONTEXT_FLUSH_ABORT, 62000));
+
+    const OTAContextStatistics & stats = saver.getStatistics();
+    CHECK(stats.flushes[OTA_CONTEXT_FLUSH_SLEEP] == 1);
+    CHECK(stats.flushes[OTA_CONTEXT_FLUSH_ABORT] == 1);
+    CHECK(stats.coalesced == 2);
+
+    // Flushed offset is the new reference, the next sector boundary still triggers a save
+    CHECK(!saver.handleContext(768, STATUS_DOWNLOADING, 0));
+    CHECK(saver.handleContext(SECTOR, STATUS_DOWNLOADING, 0));
+}
+
+static void testRestoredContext()
+{
+    printf("testRestoredContext\n");
+    OTAContextSaver saver;
+
+    // Restored in the middle of the second sector, nothing to save till the next sector
+    saver.init(SECTOR + 640, STATUS_DOWNLOADING);
+    CHECK(!saver.isPending());
+    CHECK(!saver.handleContext(SECTOR + 704, STATUS_DOWNLOADING, 0));
+    CHECK(saver.handleContext(2 * SECTOR, STATUS_DOWNLOADING, 0));
+}
+
+static void testResumeOffset()
+{
+    printf("testResumeOffset\n");
+    OTAContextSaver saver;
+
+    // Sector boundary is always safe
+    CHECK(saver.getResumeOffset(2 * SECTOR, false) == 2 * SECTOR);
+
+    // Partial sector is trusted only if verified
+    CHECK(saver.getResumeOffset(2 * SECTOR + 640, true) == 2 * SECTOR + 640);
+    CHECK(saver.getResumeOffset(2 * SECTOR + 640, false) == 2 * SECTOR);
+
+    CHECK(saver.getStatistics().resumes == 3);
+    CHECK(saver.getStatistics().rewinds == 1);
+}
+
+static void testWritesPerUpgrade()
+{
+    printf("testWritesPerUpgrade\n");
+
+    // 180 KB image, 64 byte blocks, the OTA cluster asks to save the context after each block
+    const uint32 imageSize = 180 * 1024;
+    OTAContextSaver saver;
+    uint32 oldWrites = 0;
+    uint32 now = 0;
+
+    saver.handleUpgradeStarted();
+    for(uint32 offset = 0; offset <= imageSize; offset += 64)
+    {
+        uint8 status = offset < imageSize ? STATUS_DOWNLOADING : STATUS_DOWNLOAD_COMPLETE;
+        oldWrites++;
+        now += 250;
+        if(saver.handleContext(offset, status, now))
+            saver.handlePdmWrites(1);
+
+        // Sleepy device sleeps after every block
+        if(saver.flush(OTA_CONTEXT_FLUSH_SLEEP, now))
+            saver.handlePdmWrites(2);     // context and sector CRC
+    }
+    saver.handleContext(imageSize, STATUS_NORMAL, now);   // switched to the new image
+    saver.handlePdmWrites(1);
+    oldWrites++;
+
+    const OTAContextStatistics & stats = saver.getStatistics();
+    printf("  PDM writes per upgrade: %d (was %d)\n", stats.upgradePdmWrites, oldWrites);
+    CHECK(stats.upgrades == 1);
+    CHECK(stats.upgradeContexts == oldWrites);
+    CHECK(stats.upgradePdmWrites < 50);
+
+    // Counters of the next upgrade start from zero, the totals do not
+    saver.handleUpgradeStarted();
+    CHECK(saver.getStatistics().upgradePdmWrites == 0);
+    CHECK(saver.getStatistics().pdmWrites == stats.pdmWrites);
+}
+
+int main()
+{
+    testCrc();
+    testSectorMath();
+    testElementStart();
+    testStatusChangeSaved();
+    testSavedAtSectorBoundaries();
+    testFlush();
+    testRestoredContext();
+    testResumeOffset();
+    testResumeAfterLateBlocks();
+    testWritesPerUpgrade();
+
+    return testResult();
+}
@@ -0,0 +1,356 @@
+// Tests for the streaming decoder of compressed and delta OTA images.
+//
+// Encoded vectors are produced by scripts/OTACompress/ota_compress.py from the images generated below, so the test
+// also checks that the tool and the decoder agree on the format.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "OTAImageDecoder.h"
+#include "OTAContextSaver.h"
+#include "test_common.h"
+
+static const uint32 IMAGE_SIZE = 4096;
+
+// Collects the written image, and checks that writes go in order and in aligned chunks
+class TestStorage : public IOTAImageStorage
+{
+public:
+    uint8 image[2 * IMAGE_SIZE];
+    uint32 size;
+    uint32 writes;
+    bool misordered;
+    const uint8 * base;
+    uint32 baseSize;
+
+    TestStorage(const uint8 * baseImage = NULL, uint32 baseImageSize = 0)
+    {
+        memset(image, 0, sizeof(image));
+        size = 0;
+        writes = 0;
+        misordered = false;
+        base = baseImage;
+        baseSize = baseImageSize;
+    }
+
+    virtual void writeImage(uint32 offset, const uint8 * data, uint16 len)
+    {
+        if(offset != size || offset % OTAImageDecoder::WRITE_CHUNK_SIZE != 0 || offset + len > sizeof(image))
+        {
+            misordered = true;
+            return;
+        }
+
+        memcpy(image + offset, data, len);
+        size += len;
+        writes++;
+    }
+
+    virtual void readBaseImage(uint32 offset, uint8 * data, uint16 len)
+    {
+        memset(data, 0xff, len);
+        if(offset + len <= baseSize)
+            memcpy(data, base + offset, len);
+    }
+};
+
+static uint32 crc32(const uint8 * data, uint32 len)
+{
+    return ~OTAContextSaver::updateCrc(OTAContextSaver::CRC_INIT, data, len);
+}
+
+static void putLE(uint8 * p, uint32 value, uint8 bytes)
+{
+    for(uint8 i = 0; i < bytes; i++)
+        p[i] = value >> (8 * i);
+}
+
+static uint32 makeHeader(uint8 * p, uint8 flags, uint16 window, const uint8 * image, uint32 imageSize,
+                         const uint8 * base, uint32 baseSize)
+{
+    memcpy(p, "HZC1", 4);
+    p[4] = OTAImageDecoder::VERSION;
+    p[5] = flags;
+    putLE(p + 6, window, 2);
+    putLE(p + 8, imageSize, 4);
+    putLE(p + 12, crc32(image, imageSize), 4);
+    putLE(p + 16, baseSize, 4);
+    putLE(p + 20, base ? crc32(base, baseSize) : 0, 4);
+    return OTAImageDecoder::HEADER_SIZE;
+}
+
+// Firmware-like data: a limited set of instruction words with some random constants in between. The new version
+// has a function inserted, and a few constants changed.
+static uint32 lcg = 0;
+
+static uint32 nextRandom()
+{
+    lcg = lcg * 1103515245 + 12345;
+    return lcg >> 8;
+}
+
+static void generateBase(uint8 * image)
+{
+    lcg = 1;
+    for(uint32 i = 0; i < IMAGE_SIZE; i += 4)
+    {
+        uint32 r = nextRandom();
+        uint32 word = (r % 8 == 0) ? nextRandom() : 0x4c000000 | ((r % 32) << 12);
+        putLE(image + i, word, 4);
+    }
+}
+
+static uint32 generateNew(const uint8 * base, uint8 * image)
+{
+    // 96 bytes inserted at 1024, and a constant changed at 3000
+    uint32 size = 0;
+    memcpy(image, base, 1024);
+    size += 1024;
+    lcg = 2;
+    for(uint32 i = 0; i < 96; i += 4)
+    {
+        putLE(image + size, 0x4c000000 | ((nextRandom() % 32) << 12), 4);
+        size += 4;
+    }
+    memcpy(image + size, base + 1024, IMAGE_SIZE - 1024);
+    size += IMAGE_SIZE - 1024;
+    putLE(image + 3000 + 96, 0x12345678, 4);
+    return size;
+}
+
+// ota_compress.py -i new.bin -o compressed.hzc (LZ only)
+static const uint8 COMPRESSED_VECTOR[] = {
+#include "ota_image_decoder_compressed.inc"
+};
+
+// ota_compress.py -i new.bin -b base.bin -o delta.hzc
+static const uint8 DELTA_VECTOR[] = {
+#include "ota_image_decoder_delta.inc"
+};
+
+static void testCompressedImageDetection()
+{
+    printf("testCompressedImageDetection\n");
+
+    CHECK(OTAImageDecoder::isCompressedImage((const uint8 *)"HZC1\x01", 5));
+    CHECK(!OTAImageDecoder::isCompressedImage((const uint8 *)"HZC", 3));
+    CHECK(!OTAImageDecoder::isCompressedImage((const uint8 *)"\x12\x34\x56\x78", 4));
+}
+
+static void testLiteralAndCopy()
+{
+    printf("testLiteralAndCopy\n");
+
+    const uint8 expected[] = "abcabcabcX";
+    uint8 payload[64];
+    uint32 len = makeHeader(payload, 0, 960, expected, 10, NULL, 0);
+    const uint8 commands[] = {OTAImageDecoder::OP_LITERAL, 3, 'a', 'b', 'c',
+                              OTAImageDecoder::OP_COPY, 3, 6,              // overlapping copy
+                              OTAImageDecoder::OP_LITERAL, 1, 'X'};
+    memcpy(payload + len, commands, sizeof(commands));
+    len += sizeof(commands);
+
+    TestStorage storage;
+    OTAImageDecoder decoder;
+    decoder.start(&storage);
+    CHECK(decoder.isActive());
+    CHECK(decoder.handleData(payload, len));
+    CHECK(decoder.isComplete());
+    CHECK(!decoder.isDelta());
+    CHECK(storage.size == 10);
+    CHECK(memcmp(storage.image, expected, 10) == 0);
+    CHECK(decoder.getStatistics().literalBytes == 4);
+    CHECK(decoder.getStatistics().windowBytes == 6);
+}
+
+static void testBaseCopy()
+{
+    printf("testBaseCopy\n");
+
+    const uint8 base[] = "0123456789";
+    const uint8 expected[] = "4567--0123";
+    uint8 payload[64];
+    uint32 len = makeHeader(payload, OTAImageDecoder::FLAG_DELTA, 960, expected, 10, base, 10);
+    const uint8 commands[] = {OTAImageDecoder::OP_BASE, 8, 4,                  // +4
+                              OTAImageDecoder::OP_LITERAL, 2, '-', '-',
+                              OTAImageDecoder::OP_BASE, 15, 4};                // -8
+    memcpy(payload + len, commands, sizeof(commands));
+    len += sizeof(commands);
+
+    TestStorage storage(base, 10);
+    OTAImageDecoder decoder;
+    decoder.start(&storage);
+    CHECK(decoder.handleData(payload, len));
+    CHECK(decoder.isComplete());
+    CHECK(decoder.isDelta());
+    CHECK(memcmp(storage.image, expected, 10) == 0);
+    CHECK(decoder.getStatistics().baseBytes == 8);
+}
+
+static void decodeVector(const uint8 * vector, uint32 vectorSize, const uint8 * base, uint16 chunkSize,
+                         const uint8 * expected, uint32 expectedSize)
+{
+    TestStorage storage(base, IMAGE_SIZE);
+    OTAImageDecoder decoder;
+    decoder.start(&storage);
+
+    for(uint32 pos = 0; pos < vectorSize; pos += chunkSize)
+    {
+        uint16 len = vectorSize - pos < chunkSize ? vectorSize - pos : chunkSize;
+        if(!decoder.handleData(vector + pos, len))
+            break;
+    }
+
+    CHECK(decoder.getError() == OTA_DECODER_OK);
+    CHECK(decoder.isComplete());
+    CHECK(!storage.misordered);
+    CHECK(storage.size == expectedSize);
+    CHECK(memcmp(storage.image, expected, expectedSize) == 0);
+    CHECK(storage.writes == (expectedSize + OTAImageDecoder::WRITE_CHUNK_SIZE - 1) / OTAImageDecoder::WRITE_CHUNK_SIZE);
+}
+
+static void testEncodedVectors()
+{
+    printf("testEncodedVectors\n");
+
+    static uint8 base[IMAGE_SIZE];
+    static uint8 image[2 * IMAGE_SIZE];
+    generateBase(base);
+    uint32 imageSize = generateNew(base, image);
+
+    // OTA blocks, and the worst case of a single byte at a time
+    decodeVector(COMPRESSED_VECTOR, sizeof(COMPRESSED_VECTOR), NULL, 64, image, imageSize);
+    decodeVector(COMPRESSED_VECTOR, sizeof(COMPRESSED_VECTOR), NULL, 1, image, imageSize);
+    decodeVector(DELTA_VECTOR, sizeof(DELTA_VECTOR), base, 64, image, imageSize);
+    decodeVector(DELTA_VECTOR, sizeof(DELTA_VECTOR), base, 1, image, imageSize);
+
+    printf("  Image %d bytes, compressed %d bytes, delta %d bytes\n",
+           imageSize, (int)sizeof(COMPRESSED_VECTOR), (int)sizeof(DELTA_VECTOR));
+    CHECK(sizeof(COMPRESSED_VECTOR) < imageSize);
+    CHECK(sizeof(DELTA_VECTOR) < imageSize / 10);
+}
+
+static void testBaseMismatch()
+{
+    printf("testBaseMismatch\n");
+
+    static uint8 base[IMAGE_SIZE];
+    generateBase(base);
+    base[100] ^= 1;     // devices run some other firmware
+
+    TestStorage storage(base, IMAGE_SIZE);
+    OTAImageDecoder decoder;
+    decoder.start(&storage);
+    CHECK(!decoder.handleData(DELTA_VECTOR, 64));
+    CHECK(decoder.getError() == OTA_DECODER_BASE_MISMATCH);
+    CHECK(storage.size == 0);
+    CHECK(!decoder.isActive());
+}
+
+static void testCorruptedPayload()
+{
+    printf("testCorruptedPayload\n");
+
+    static uint8 payload[sizeof(COMPRESSED_VECTOR)];
+    memcpy(payload, COMPRESSED_VECTOR, sizeof(payload));
+
+    // Bad magic
+    {
+        TestStorage storage;
+        OTAImageDecoder decoder;
+        payload[0] = 'X';
+        decoder.start(&storage);
+        CHECK(!decoder.handleData(payload, sizeof(payload)));
+        CHECK(decoder.getError() == OTA_DECODER_BAD_HEADER);
+        payload[0] = 'H';
+    }
+
+    // Window larger than the decoder has
+    {
+        TestStorage storage;
+        OTAImageDecoder decoder;
+        putLE(payload + 6, OTAImageDecoder::MAX_WINDOW_SIZE + 1, 2);
+        decoder.start(&storage);
+        CHECK(!decoder.handleData(payload, sizeof(payload)));
+        CHECK(decoder.getError() == OTA_DECODER_BAD_WINDOW);
+        putLE(payload + 6, OTAImageDecoder::MAX_WINDOW_SIZE, 2);
+    }
+
+    // Image checksum does not match
+    {
+        TestStorage storage;
+        OTAImageDecoder decoder;
+        payload[12] ^= 1;
+        decoder.start(&storage);
+        CHECK(!decoder.handleData(payload, sizeof(payload)));
+        CHECK(decoder.getError() == OTA_DECODER_CRC_MISMATCH);
+        CHECK(decoder.getStatistics().failures == 1);
+        payload[12] ^= 1;
+    }
+}
+
+static void testBadCommands()
+{
+    printf("testBadCommands\n");
+
+    const uint8 expected[] = "abcdefgh";
+    uint8 payload[64];
+    uint32 len = makeHeader(payload, 0, 960, expected, 8, NULL, 0);
+
+    // Copy from before the image start
+    {
+        TestStorage storage;
+        OTAImageDecoder decoder;
+        const uint8 commands[] = {OTAImageDecoder::OP_LITERAL, 2, 'a', 'b', OTAImageDecoder::OP_COPY, 3, 2};
+        memcpy(payload + len, commands, sizeof(commands));
+        decoder.start(&storage);
+        CHECK(!decoder.handleData(payload, len + sizeof(commands)));
+        CHECK(decoder.getError() == OTA_DECODER_BAD_REFERENCE);
+    }
+
+    // More data than the image size
+    {
+        TestStorage storage;
+        OTAImageDecoder decoder;
+        const uint8 commands[] = {OTAImageDecoder::OP_LITERAL, 2, 'a', 'b', OTAImageDecoder::OP_COPY, 1, 7};
+        memcpy(payload + len, commands, sizeof(commands));
+        decoder.start(&storage);
+        CHECK(!decoder.handleData(payload, len + sizeof(commands)));
+        CHECK(decoder.getError() == OTA_DECODER_OVERFLOW);
+    }
+
+    // Base copy in a non-delta image
+    {
+        TestStorage storage;
+        OTAImageDecoder decoder;
+        const uint8 commands[] = {OTAImageDecoder::OP_BASE, 0, 4};
+        memcpy(payload + len, commands, sizeof(commands));
+        decoder.start(&storage);
+        CHECK(!decoder.handleData(payload, len + sizeof(commands)));
+        CHECK(decoder.getError() == OTA_DECODER_BAD_REFERENCE);
+    }
+
+    // Unknown opcode
+    {
+        TestStorage storage;
+        OTAImageDecoder decoder;
+        const uint8 commands[] = {7, 1, 1};
+        memcpy(payload + len, commands, sizeof(commands));
+        decoder.start(&storage);
+        CHECK(!decoder.handleData(payload, len + sizeof(commands)));
+        CHECK(decoder.getError() == OTA_DECODER_BAD_COMMAND);
+    }
+}
+
+int main()
+{
+    testCompressedImageDetection();
+    testLiteralAndCopy();
+    testBaseCopy();
+    testEncodedVectors();
+    testBaseMismatch();
+    testCorruptedPayload();
+    testBadCommands();
+
+    return testResult();
+}
@@ -0,0 +1,172 @@
+// Tests for the background pre-erase of the OTA flash area.
+
+#include <stdio.h>
+
+#include "OTAStorageManager.h"
+#include "test_common.h"
+
+static const uint32 SECTOR = 32 * 1024;
+static const uint8 START_SECTOR = 8;
+static const uint8 NUM_SECTORS = 8;
+static const uint32 ERASE_TIME = 40000;     // us
+
+static void testInactive()
+{
+    printf("testInactive\n");
+    OTAStorageManager storage(SECTOR, START_SECTOR, NUM_SECTORS);
+
+    CHECK(!storage.isActive());
+    CHECK(storage.getSectorToErase() == OTAStorageManager::NO_SECTOR);
+    CHECK(storage.needsErase(START_SECTOR));
+}
+
+static void testEraseAhead()
+{
+    printf("testEraseAhead\n");
+    OTAStorageManager storage(SECTOR, START_SECTOR, NUM_SECTORS, 2);
+    storage.start(0, 0);
+
+    // Nothing written yet, the first sector may be erased as well
+    CHECK(storage.getSectorToErase() == 8);
+    storage.handleBackgroundErase(8, ERASE_TIME);
+    CHECK(storage.getSectorToErase() == 9);
+    storage.handleBackgroundErase(9, ERASE_TIME);
+    CHECK(storage.getSectorToErase() == 10);
+    storage.handleBackgroundErase(10, ERASE_TIME);
+    CHECK(storage.getSectorToErase() == OTAStorageManager::NO_SECTOR);
+
+    // Download moves on, the window follows it
+    storage.handleWrite(0, 64);
+    CHECK(storage.getSectorToErase() == OTAStorageManager::NO_SECTOR);
+    storage.handleWrite(SECTOR, 64);
+    CHECK(storage.getSectorToErase() == 11);
+}
+
+static void testWrittenDataKept()
+{
+    printf("testWrittenDataKept\n");
+    OTAStorageManager storage(SECTOR, START_SECTOR, NUM_SECTORS, 2);
+
+    // Resumed in the middle of the third sector, which holds the downloaded data
+    storage.start(2 * SECTOR + 640, 0);
+    CHECK(storage.getSectorToErase() == 11);
+    storage.handleBackgroundErase(11, ERASE_TIME);
+    CHECK(storage.getSectorToErase() == 12);
+    storage.handleBackgroundErase(12, ERASE_TIME);
+    CHECK(storage.getSectorToErase() == OTAStorageManager::NO_SECTOR);
+
+    // Writing to a prepared sector makes it dirty again
+    storage.handleWrite(3 * SECTOR, 64);
+    CHECK(storage.needsErase(11));
+    CHECK(!storage.needsErase(12));
+}
+
+static void testImageSizeLimit()
+{
+    printf("testImageSizeLimit\n");
+    OTAStorageManager storage(SECTOR, START_SECTOR, NUM_SECTORS, 4);
+
+    // 1.5 sectors image does not need more than 2 sectors
+    storage.start(0, SECTOR + SECTOR / 2);
+    storage.handleBackgroundErase(storage.getSectorToErase(), ERASE_TIME);
+    storage.handleBackgroundErase(storage.getSectorToErase(), ERASE_TIME);
+    CHECK(storage.getSectorToErase() == OTAStorageManager::NO_SECTOR);
+
+    // Size not known yet, limited by the area
+    storage.start(6 * SECTOR, 0);
+    CHECK(storage.getSectorToErase() == 14);
+    storage.handleBackgroundErase(14, ERASE_TIME);
+    storage.handleBackgroundErase(15, ERASE_TIME);
+    CHECK(storage.getSectorToErase() == OTAStorageManager::NO_SECTOR);
+    storage.stop();
+    CHECK(storage.getSectorToErase() == OTAStorageManager::NO_SECTOR);
+}
+
+static void testSkippedErasesCountedOnce()
+{
+    printf("testSkippedErasesCountedOnce\n");
+    OTAStorageManager storage(SECTOR, START_SECTOR, NUM_SECTORS);
+    storage.start(0, 0);
+
+    storage.handleBackgroundErase(8, ERASE_TIME);
+    CHECK(!storage.needsErase(8));
+    CHECK(!storage.needsErase(8));
+
+    const OTAStorageStatistics & stats = storage.getStatistics();
+    CHECK(stats.erasesSkipped == 2);
+    CHECK(stats.stallTimeRemoved == ERASE_TIME);
+
+    // Erase on demand
+    CHECK(storage.needsErase(9));
+    storage.handleOnDemandErase(9, ERASE_TIME);
+    CHECK(stats.onDemandErases == 1);
+    CHECK(stats.upgradeStallTime == ERASE_TIME);
+}
+
+// A 180 KB download in 64 byte blocks. The OTA client requests an erase as it enters a sector. Returns the stall time.
+static uint32 simulateDownload(OTAStorageManager & storage, bool idle, bool busy)
+{
+    const uint32 imageSize = 180 * 1024;
+    storage.start(0, imageSize);
+
+    for(uint32 offset = 0; offset < imageSize; offset += 64)
+    {
+        uint8 sector = START_SECTOR + offset / SECTOR;
+        if(offset % SECTOR == 0 && storage.needsErase(sector))
+            storage.handleOnDemandErase(sector, ERASE_TIME);
+        storage.handleWrite(offset, 64);
+
+        // Main loop is idle between blocks, one erase per iteration
+        if(idle)
+        {
+            uint8 toErase = storage.getSectorToErase();
+            if(toErase != OTAStorageManager::NO_SECTOR)
+            {
+                if(busy)
+                    storage.handleDeferred();
+                else
+                    storage.handleBackgroundErase(toErase, ERASE_TIME);
+            }
+        }
+    }
+
+    storage.stop();
+    return storage.getStatistics().upgradeStallTime;
+}
+
+static void testStallTimeRemoved()
+{
+    printf("testStallTimeRemoved\n");
+
+    OTAStorageManager onDemand(SECTOR, START_SECTOR, NUM_SECTORS);
+    uint32 onDemandStall = simulateDownload(onDemand, false, false);
+    CHECK(onDemandStall == 6 * ERASE_TIME);
+
+    // The first sector is requested before any idle time
+    OTAStorageManager background(SECTOR, START_SECTOR, NUM_SECTORS);
+    uint32 backgroundStall = simulateDownload(background, true, false);
+    const OTAStorageStatistics & stats = background.getStatistics();
+    printf("  Stall time per upgrade: %d ms (was %d ms)\n", backgroundStall / 1000, onDemandStall / 1000);
+    CHECK(backgroundStall == ERASE_TIME);
+    CHECK(stats.upgradeStallTimeRemoved == 5 * ERASE_TIME);
+    CHECK(stats.backgroundErases == 5);
+    CHECK(stats.erasesSkipped == 5);
+
+    // Buttons or relays are busy all the time
+    OTAStorageManager busy(SECTOR, START_SECTOR, NUM_SECTORS);
+    CHECK(simulateDownload(busy, true, true) == onDemandStall);
+    CHECK(busy.getStatistics().backgroundErases == 0);
+    CHECK(busy.getStatistics().deferred > 0);
+}
+
+int main()
+{
+    testInactive();
+    testEraseAhead();
+    testWrittenDataKept();
+    testImageSizeLimit();
+    testSkippedErasesCountedOnce();
+    testStallTimeRemoved();
+
+    return testResult();
+}
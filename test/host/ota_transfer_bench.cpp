@@ -0,0 +1,293 @@
+// Benchmark of the OTA image download against a local OTA server stand-in.
+//
+// The server and the network are simulated: each frame travels over a couple of hops, the server takes some time
+// to process a request, and frames are lost with a base probability. The channel is shared with the rest of the
+// network, so frames sent faster than the OTA share of the channel are lost as well.
+//
+// The clients compared:
+// - baseline: 48 byte Image Block Requests strictly one at a time, 10 s retry if the response does not come
+//   (OTA_MAX_BLOCK_SIZE and OTA_TIME_INTERVAL_BETWEEN_RETRIES of the old configuration)
+// - pages: Image Page Requests with the largest block fitting an APS frame, the response spacing is driven by the
+//   OTATransferPolicy (the minimal one, or the server's MinimumBlockPeriod)
+//
+// The benchmark returns non-zero exit code if the image is not transferred completely, or if the page requests are
+// not faster than the baseline.
+
+#include <stdio.h>
+#include <deque>
+
+#include "OTATransferPolicy.h"
+
+static const uint32 IMAGE_SIZE = 180 * 1024;
+static const uint8 MAX_APS_PAYLOAD = 82;                // Unicast with NWK security, no fragmentation
+static const uint8 BASELINE_BLOCK_SIZE = 48;
+static const uint32 BASELINE_RETRY_INTERVAL = 10000;    // ms
+static const uint32 PAGE_TIMEOUT_MARGIN = 1000;         // ms, waiting for the last block of a page
+static const uint32 MAX_SIMULATION_TIME = 24 * 3600 * 1000;
+
+// Simple deterministic random number generator, so that all clients see the same conditions
+class Random
+{
+    uint32 state;
+
+public:
+    Random(uint32 seed) : state(seed) {}
+
+    uint32 next()
+    {
+        state = state * 1103515245 + 12345;
+        return (state >> 8) & 0xffffff;
+    }
+
+    bool chance(double probability)
+    {
+        return next() < probability * 0x1000000;
+    }
+};
+
+struct Scenario
+{
+    const char * name;
+    uint32 hopLatency;          // ms, one frame over one hop including CSMA and the MAC ack
+    uint8 hops;
+    uint32 serverLatency;       // ms, processing of a request by the server
+    uint16 serverMinBlockPeriod;    // ms, MinimumBlockPeriod enforced by the server
+    uint8 serverMaxBlockSize;   // Server does not send larger blocks
+    double baseLoss;            // Probability of losing a frame on the way
+    uint32 channelCapacity;     // OTA frames per second the channel can take along with the other traffic
+};
+
+// The network and the OTA server stand-in
+class OTAServerSim
+{
+    const Scenario & scenario;
+    Random random;
+    std::deque<uint32> recentFrames;
+    uint32 lastResponseTime;
+
+public:
+    uint32 framesSent;
+    uint32 framesLost;
+
+    OTAServerSim(const Scenario & s, uint32 seed)
+        : scenario(s)
+        , random(seed)
+    {
+        lastResponseTime = 0;
+        framesSent = 0;
+        framesLost = 0;
+    }
+
+    uint32 getOneWayLatency() const
+    {
+        return scenario.hopLatency * scenario.hops;
+    }
+
+    // Returns true if the frame sent at the given time is delivered
+    bool sendFrame(uint32 now)
+    {
+        while(!recentFrames.empty() && now - recentFrames.front() >= 1000)
+            recentFrames.pop_front();
+        recentFrames.push_back(now);
+        framesSent++;
+
+        // Frames above the channel capacity collide with the other traffic. Collisions also eat the retries of
+        // the frames that would have been delivered otherwise, so the loss grows faster than the excess rate.
+        double loss = scenario.baseLoss;
+        uint32 rate = recentFrames.size();
+        if(rate > scenario.channelCapacity)
+        {
+            double share = (double)scenario.channelCapacity / rate;
+            loss += 1.0 - share * share;
+        }
+
+        if(random.chance(loss))
+        {
+            framesLost++;
+            return false;
+        }
+        return true;
+    }
+
+    uint8 getBlockSize(uint8 requested) const
+    {
+        return requested < scenario.serverMaxBlockSize ? requested : scenario.serverMaxBlockSize;
+    }
+
+    // Time the server sends the response to the request received at the given time
+    uint32 scheduleResponse(uint32 requestReceived, uint32 spacing)
+    {
+        uint32 period = spacing > scenario.serverMinBlockPeriod ? spacing : scenario.serverMinBlockPeriod;
+        uint32 time = requestReceived + scenario.serverLatency;
+        if(lastResponseTime != 0 && time < lastResponseTime + period)
+            time = lastResponseTime + period;
+
+        lastResponseTime = time;
+        return time;
+    }
+};
+
+struct TransferResult
+{
+    uint32 time;                // ms
+    uint32 requests;
+    uint32 framesSent;
+    uint32 framesLost;
+    bool complete;
+};
+
+// Image Block Request one at a time, retry on timeout
+static TransferResult runBaseline(const Scenario & scenario, uint32 seed)
+{
+    OTAServerSim server(scenario, seed);
+    TransferResult result = {0, 0, 0, 0, false};
+    uint32 now = 0;
+    uint32 offset = 0;
+
+    while(offset < IMAGE_SIZE && now < MAX_SIMULATION_TIME)
+    {
+        result.requests++;
+        if(!server.sendFrame(now))
+        {
+            now += BASELINE_RETRY_INTERVAL;
+            continue;
+        }
+
+        uint32 responseTime = server.scheduleResponse(now + server.getOneWayLatency(), 0);
+        if(!server.sendFrame(responseTime))
+        {
+            now += BASELINE_RETRY_INTERVAL;
+            continue;
+        }
+
+        uint32 size = server.getBlockSize(BASELINE_BLOCK_SIZE);
+        offset += size < IMAGE_SIZE - offset ? size : IMAGE_SIZE - offset;
+        now = responseTime + server.getOneWayLatency();
+    }
+
+    result.time = now;
+    result.framesSent = server.framesSent;
+    result.framesLost = server.framesLost;
+    result.complete = offset >= IMAGE_SIZE;
+    return result;
+}
+
+// Image Page Requests, the policy decides the response spacing
+static TransferResult runPages(const Scenario & scenario, uint32 seed, OTATransferPolicy & policy)
+{
+    OTAServerSim server(scenario, seed);
+    TransferResult result = {0, 0, 0, 0, false};
+    uint32 now = 0;
+
+    policy.configure(OTATransferPolicy::getMaxBlockSize(MAX_APS_PAYLOAD),
+                     OTATransferPolicy::DEFAULT_PAGE_SIZE,
+                     OTATransferPolicy::DEFAULT_MIN_REQUEST_DELAY,
+                     OTATransferPolicy::DEFAULT_RESPONSE_TIMEOUT);
+    policy.start(IMAGE_SIZE, 0, now);
+    policy.handleMinBlockPeriod(scenario.serverMinBlockPeriod);
+
+    while(!policy.isComplete() && now < MAX_SIMULATION_TIME)
+    {
+        uint32 offset = policy.getNextOffset();
+        uint32 pageSize = policy.getPageSize();
+        if(pageSize > IMAGE_SIZE - offset)
+            pageSize = IMAGE_SIZE - offset;
+
+        uint32 spacing = policy.getRequestDelay();
+        uint8 blockSize = server.getBlockSize(policy.getBlockSize());
+        uint32 blocks = (pageSize + blockSize - 1) / blockSize;
+
+        // Page is over either with its last block, or when the last block is late for too long
+        result.requests++;
+        uint32 pageEnd = now + 2 * server.getOneWayLatency() + scenario.serverLatency + blocks * spacing + PAGE_TIMEOUT_MARGIN;
+        if(!server.sendFrame(now))
+        {
+            now = pageEnd;
+            policy.handleTimeout(now);
+            continue;
+        }
+
+        uint32 requestReceived = now + server.getOneWayLatency();
+        bool lastReceived = false;
+        uint32 lastArrival = now;
+        for(uint32 i = 0; i < blocks; i++)
+        {
+            uint32 blockOffset = offset + i * blockSize;
+            uint32 size = blockSize < offset + pageSize - blockOffset ? blockSize : offset + pageSize - blockOffset;
+            uint32 sent = server.scheduleResponse(requestReceived, spacing);
+            if(!server.sendFrame(sent))
+                continue;
+
+            lastArrival = sent + server.getOneWayLatency();
+            policy.handleBlock(blockOffset, size, lastArrival);
+            lastReceived = i == blocks - 1;
+        }
+
+        now = lastReceived ? lastArrival : pageEnd;
+    }
+
+    result.time = now;
+    result.framesSent = server.framesSent;
+    result.framesLost = server.framesLost;
+    result.complete = policy.isComplete();
+    return result;
+}
+
+static void printResult(const char * name, const TransferResult & result)
+{
+    printf("  %-15s time=%4d.%d min  requests=%-5d frames=%-6d lost=%-5d (%d%%)%s\n",
+           name,
+           result.time / 60000, result.time % 60000 / 6000,
+           result.requests,
+           result.framesSent,
+           result.framesLost,
+           result.framesSent ? result.framesLost * 100 / result.framesSent : 0,
+           result.complete ? "" : "  INCOMPLETE");
+}
+
+int main()
+{
+    const Scenario scenarios[] = {
+        // name                         hop lat hops srv lat  min period  max block  loss  capacity
+        {"zigbee2mqtt, quiet network",  8,      1,   30,      250,        64,        0.01, 40},
+        {"zigbee2mqtt, busy mesh",      12,     2,   30,      250,        64,        0.03, 15},
+        {"fast server, quiet network",  8,      1,   20,      0,          64,        0.01, 40},
+        {"fast server, busy mesh",      12,     2,   20,      0,          64,        0.03, 15},
+        {"server with 48 byte blocks",  12,     2,   30,      0,          48,        0.03, 15},
+        {"fast server, congested mesh", 12,     2,   20,      0,          64,        0.03, 3},
+    };
+
+    bool success = true;
+    printf("Image size: %d bytes, max block size: %d bytes\n", IMAGE_SIZE, OTATransferPolicy::getMaxBlockSize(MAX_APS_PAYLOAD));
+
+    for(size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        const Scenario & scenario = scenarios[i];
+        const uint32 seed = 0x00158d00 + i;
+
+        TransferResult baseline = runBaseline(scenario, seed);
+        OTATransferPolicy policy;
+        TransferResult pages = runPages(scenario, seed, policy);
+
+        const OTATransferStatistics & stats = policy.getStatistics();
+        printf("%s:\n", scenario.name);
+        printResult("baseline", baseline);
+        printResult("pages", pages);
+        printf("  pages: request delay=%d ms (max %d ms), out of order=%d, timeouts=%d\n",
+               policy.getRequestDelay(), stats.maxRequestDelay, stats.blocksOutOfOrder, stats.timeouts);
+
+        if(!baseline.complete || !pages.complete)
+        {
+            printf("  FAIL: image is not transferred\n");
+            success = false;
+        }
+
+        if(pages.time >= baseline.time)
+        {
+            printf("  FAIL: page requests are not faster than the baseline\n");
+            success = false;
+        }
+    }
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+// Tests for the OTA block size and request delay policy.
+
+#include <stdio.h>
+
+#include "OTATransferPolicy.h"
+#include "test_common.h"
+
+static const uint32 IMAGE_SIZE = 100000;
+
+// Receives a whole page in order, 100 ms between blocks
+static void receivePage(OTATransferPolicy & policy, uint32 & now)
+{
+    uint32 end = policy.getNextOffset() + policy.getPageSize();
+    while(policy.getNextOffset() < end && !policy.isComplete())
+    {
+        uint32 size = IMAGE_SIZE - policy.getNextOffset();
+        now += 100;
+        policy.handleBlock(policy.getNextOffset(), size < policy.getBlockSize() ? size : policy.getBlockSize(), now);
+    }
+}
+
+// Skips a block, so that the next one comes after a gap
+static void loseBlock(OTATransferPolicy & policy, uint32 & now)
+{
+    now += 100;
+    policy.handleBlock(policy.getNextOffset() + policy.getBlockSize(), policy.getBlockSize(), now);
+}
+
+static void testMaxBlockSize()
+{
+    printf("testMaxBlockSize\n");
+
+    CHECK(OTATransferPolicy::getMaxBlockSize(82) == 64);
+    CHECK(OTATransferPolicy::getMaxBlockSize(80) == 48);
+    CHECK(OTATransferPolicy::getMaxBlockSize(65) == 48);
+    CHECK(OTATransferPolicy::getMaxBlockSize(64) == 32);
+    CHECK(OTATransferPolicy::getMaxBlockSize(20) == 16);
+    CHECK(OTATransferPolicy::getMaxBlockSize(0) == 16);
+}
+
+static void testDefaults()
+{
+    printf("testDefaults\n");
+    OTATransferPolicy policy;
+
+    CHECK(policy.getBlockSize() == OTATransferPolicy::DEFAULT_BLOCK_SIZE);
+    CHECK(policy.getPageSize() == OTATransferPolicy::DEFAULT_PAGE_SIZE);
+    CHECK(policy.getRequestDelay() == OTATransferPolicy::DEFAULT_MIN_REQUEST_DELAY);
+    CHECK(!policy.isComplete());
+}
+
+static void testInOrderTransfer()
+{
+    printf("testInOrderTransfer\n");
+    OTATransferPolicy policy;
+    uint32 now = 0;
+
+    policy.start(IMAGE_SIZE, 0, now);
+    while(!policy.isComplete())
+        receivePage(policy, now);
+
+    const OTATransferStatistics & stats = policy.getStatistics();
+    CHECK(policy.getNextOffset() == IMAGE_SIZE);
+    CHECK(stats.transfers == 1);
+    CHECK(stats.bytesReceived == IMAGE_SIZE);
+    CHECK(stats.blocksReceived == (IMAGE_SIZE + 63) / 64);
+    CHECK(stats.blocksOutOfOrder == 0);
+    CHECK(policy.getRequestDelay() == OTATransferPolicy::DEFAULT_MIN_REQUEST_DELAY);
+}
+
+static void testResumeFromOffset()
+{
+    printf("testResumeFromOffset\n");
+    OTATransferPolicy policy;
+
+    policy.start(IMAGE_SIZE, 4096, 0);
+    CHECK(policy.getNextOffset() == 4096);
+    CHECK(!policy.handleBlock(0, 64, 100));
+    CHECK(policy.handleBlock(4096, 64, 200));
+    CHECK(policy.getNextOffset() == 4160);
+}
+
+static void testOutOfOrderBlocksDropped()
+{
+    printf("testOutOfOrderBlocksDropped\n");
+    OTATransferPolicy policy;
+    policy.start(IMAGE_SIZE, 0, 0);
+
+    CHECK(policy.handleBlock(0, 64, 100));
+    CHECK(!policy.handleBlock(128, 64, 200));   // block at 64 is lost
+    CHECK(!policy.handleBlock(192, 64, 300));
+    CHECK(policy.getNextOffset() == 64);        // requested again from the gap
+    CHECK(!policy.handleBlock(0, 64, 400));     // repeated
+    CHECK(policy.handleBlock(64, 64, 500));
+
+    CHECK(policy.getStatistics().blocksOutOfOrder == 3);
+    CHECK(policy.getStatistics().blocksReceived == 2);
+}
+
+static void testServerGrantsSmallerBlocks()
+{
+    printf("testServerGrantsSmallerBlocks\n");
+    OTATransferPolicy policy;
+    policy.start(IMAGE_SIZE, 0, 0);
+
+    // Smaller blocks are accepted, and the next request starts where they end
+    CHECK(policy.handleBlock(0, 48, 100));
+    CHECK(policy.handleBlock(48, 48, 200));
+    CHECK(policy.handleBlock(96, 32, 300));
+    CHECK(policy.getNextOffset() == 128);
+
+    // The SDK keeps asking for the configured size
+    CHECK(policy.getBlockSize() == 64);
+    CHECK(policy.getPageSize() == 512);
+}
+
+static void testMinBlockPeriod()
+{
+    printf("testMinBlockPeriod\n");
+    OTATransferPolicy policy;
+    policy.start(IMAGE_SIZE, 0, 0);
+
+    policy.handleMinBlockPeriod(250);
+    CHECK(policy.getRequestDelay() == 250);
+
+    // Pages do not go below the server period
+    uint32 now = 0;
+    receivePage(policy, now);
+    receivePage(policy, now);
+    CHECK(policy.getRequestDelay() == 250);
+
+    policy.handleMinBlockPeriod(0);
+    CHECK(policy.getRequestDelay() == 250);     // decreases gradually
+    receivePage(policy, now);
+    receivePage(policy, now);
+    CHECK(policy.getRequestDelay() < 250);
+    CHECK(policy.getRequestDelay() >= OTATransferPolicy::DEFAULT_MIN_REQUEST_DELAY);
+}
+
+static void testLossKeepsPace()
+{
+    printf("testLossKeepsPace\n");
+    OTATransferPolicy policy;
+    uint32 now = 0;
+    policy.start(IMAGE_SIZE, 0, now);
+
+    // Even losses in every page do not slow the transfer down, the gaps are just requested again
+    for(int i = 0; i < 10; i++)
+    {
+        receivePage(policy, now);
+        loseBlock(policy, now);
+    }
+
+    CHECK(policy.getStatistics().blocksOutOfOrder == 10);
+    CHECK(policy.getRequestDelay() == OTATransferPolicy::DEFAULT_MIN_REQUEST_DELAY);
+    CHECK(policy.getStatistics().maxRequestDelay == OTATransferPolicy::DEFAULT_MIN_REQUEST_DELAY);
+}
+
+static void testDelayLimit()
+{
+    printf("testDelayLimit\n");
+    OTATransferPolicy policy;
+    policy.start(IMAGE_SIZE, 0, 0);
+
+    policy.handleWaitForData(60000);
+    CHECK(policy.getRequestDelay() == OTATransferPolicy::MAX_REQUEST_DELAY);
+}
+
+static void testTimeout()
+{
+    printf("testTimeout\n");
+    OTATransferPolicy policy;
+    uint32 now = 0;
+    policy.start(IMAGE_SIZE, 0, now);
+
+    // A page takes 8 * 20 ms, so the response timeout is what counts
+    receivePage(policy, now);
+    now += OTATransferPolicy::DEFAULT_RESPONSE_TIMEOUT + 1000;
+    policy.handleBlock(policy.getNextOffset(), 64, now);
+    CHECK(policy.getStatistics().timeouts == 1);
+
+    // Explicit timeout is counted as well, the pace stays the same
+    receivePage(policy, now);
+    policy.handleTimeout(now + 5000);
+    CHECK(policy.getStatistics().timeouts == 2);
+    CHECK(policy.getRequestDelay() == OTATransferPolicy::DEFAULT_MIN_REQUEST_DELAY);
+}
+
+static void testWaitForData()
+{
+    printf("testWaitForData\n");
+    OTATransferPolicy policy;
+    uint32 now = 0;
+    policy.start(IMAGE_SIZE, 0, now);
+
+    policy.handleWaitForData(1000);
+    CHECK(policy.getRequestDelay() == 1000);
+    CHECK(policy.getStatistics().waitForData == 1);
+
+    // Smaller wait does not decrease the delay
+    policy.handleWaitForData(100);
+    CHECK(policy.getRequestDelay() == 1000);
+
+    receivePage(policy, now);
+    CHECK(policy.getRequestDelay() < 1000);
+}
+
+int main()
+{
+    testMaxBlockSize();
+    testDefaults();
+    testInOrderTransfer();
+    testResumeFromOffset();
+    testOutOfOrderBlocksDropped();
+    testServerGrantsSmallerBlocks();
+    testMinBlockPeriod();
+    testLossKeepsPace();
+    testDelayLimit();
+    testTimeout();
+    testWaitForData();
+
+    return testResult();
+}
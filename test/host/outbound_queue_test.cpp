@@ -0,0 +1,318 @@
+// Tests for the outbound queue: report delivery tracking with retries, and holding On/Off commands while the
+// network is not available.
+
+#include <stdio.h>
+
+#include "OutboundQueue.h"
+#include "test_common.h"
+
+static const uint16 ONOFF_CLUSTER = 0x0006;
+static const uint16 ONOFF_ATTR = 0x0000;
+static const uint8 CMD_OFF = 0;
+static const uint8 CMD_ON = 1;
+static const uint8 CMD_TOGGLE = 2;
+
+static void testReportDelivered()
+{
+    printf("testReportDelivered\n");
+    OutboundQueue queue;
+    ReportRecord records[4];
+
+    CHECK(queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, 10, 0));
+    CHECK(queue.isReportPending(2, ONOFF_CLUSTER, ONOFF_ATTR));
+
+    // Ack for another frame does not matter
+    queue.handleDelivery(11, true, 100);
+    CHECK(queue.isReportPending(2, ONOFF_CLUSTER, ONOFF_ATTR));
+
+    queue.handleDelivery(10, true, 100);
+    CHECK(!queue.isReportPending(2, ONOFF_CLUSTER, ONOFF_ATTR));
+    CHECK(queue.takeDueReports(100000, records, 4) == 0);
+
+    const OutboundStatistics & stats = queue.getStatistics();
+    CHECK(stats.queued == 1);
+    CHECK(stats.delivered == 1);
+    CHECK(stats.retried == 0);
+    CHECK(stats.dropped == 0);
+}
+
+static void testReportRetryWithBackoff()
+{
+    printf("testReportRetryWithBackoff\n");
+    OutboundQueue queue;
+    ReportRecord records[4];
+    uint32 now = 1000;
+    uint8 seq = 1;
+
+    queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, seq, now);
+
+    // Each failure schedules a retry with a growing delay
+    uint32 expectedDelays[] = {1000, 2000, 4000};
+    for(uint8 i = 0; i < 3; i++)
+    {
+        queue.handleDelivery(seq, false, now);
+        CHECK(queue.takeDueReports(now + expectedDelays[i] - 1, records, 4) == 0);
+
+        now += expectedDelays[i];
+        CHECK(queue.takeDueReports(now, records, 4) == 1);
+        CHECK(records[0].endpoint == 2 && records[0].clusterId == ONOFF_CLUSTER && records[0].attributeId == ONOFF_ATTR);
+
+        // Taken reports are not returned twice
+        CHECK(queue.takeDueReports(now, records, 4) == 0);
+
+        queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, ++seq, now);
+    }
+
+    // The last attempt fails too - give up
+    queue.handleDelivery(seq, false, now);
+    CHECK(!queue.isReportPending(2, ONOFF_CLUSTER, ONOFF_ATTR));
+
+    const OutboundStatistics & stats = queue.getStatistics();
+    CHECK(stats.queued == 1);
+    CHECK(stats.retried == 3);
+    CHECK(stats.dropped == 1);
+    CHECK(stats.delivered == 0);
+}
+
+static void testAckTimeout()
+{
+    printf("testAckTimeout\n");
+    OutboundQueue queue;
+    ReportRecord records[4];
+
+    // The confirm never comes (e.g. the device has lost the network)
+    queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, 5, 0);
+    CHECK(queue.takeDueReports(OutboundQueue::ACK_TIMEOUT - 1, records, 4) == 0);
+    CHECK(queue.takeDueReports(OutboundQueue::ACK_TIMEOUT, records, 4) == 0);
+    CHECK(queue.getStatistics().retried == 1);
+    CHECK(queue.takeDueReports(OutboundQueue::ACK_TIMEOUT + 1000, records, 4) == 1);
+
+    // Late ack of the timed out frame is ignored
+    queue.handleDelivery(5, true, OutboundQueue::ACK_TIMEOUT + 1000);
+    CHECK(queue.getStatistics().delivered == 0);
+    CHECK(queue.isReportPending(2, ONOFF_CLUSTER, ONOFF_ATTR));
+}
+
+static void testLatestValueOnly()
+{
+    printf("testLatestValueOnly\n");
+    OutboundQueue queue;
+
+    // A newer frame with the same attribute supersedes the one waiting for the ack
+    queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, 1, 0);
+    queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, 2, 10);
+    queue.handleDelivery(1, false, 20);
+    CHECK(queue.getStatistics().retried == 0);
+
+    queue.handleDelivery(2, true, 30);
+    CHECK(!queue.isReportPending(2, ONOFF_CLUSTER, ONOFF_ATTR));
+    CHECK(queue.getStatistics().queued == 1);
+    CHECK(queue.getStatistics().delivered == 1);
+}
+
+static void testRetryNeverSent()
+{
+    printf("testRetryNeverSent\n");
+    OutboundQueue queue;
+    ReportRecord records[4];
+
+    queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, 1, 0);
+    queue.handleDelivery(1, false, 0);
+    CHECK(queue.takeDueReports(1000, records, 4) == 1);
+
+    // The retry was handed back for sending, but the frame did not go out. It is not stuck forever.
+    CHECK(queue.takeDueReports(1000 + OutboundQueue::ACK_TIMEOUT - 1, records, 4) == 0);
+    CHECK(queue.takeDueReports(1000 + OutboundQueue::ACK_TIMEOUT, records, 4) == 0);
+    CHECK(queue.takeDueReports(1000 + OutboundQueue::ACK_TIMEOUT + 2000, records, 4) == 1);
+    CHECK(queue.getStatistics().retried == 2);
+}
+
+static void testNewValueRestartsAttempts()
+{
+    printf("testNewValueRestartsAttempts\n");
+    OutboundQueue queue;
+    ReportRecord records[4];
+
+    queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, 1, 0);
+    queue.handleDelivery(1, false, 0);
+    CHECK(queue.takeDueReports(1000, records, 4) == 1);
+    queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, 2, 1000);
+    queue.handleDelivery(2, false, 1000);
+
+    // New value while waiting for the retry gets the full set of attempts
+    queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, 3, 1500);
+    for(uint8 i = 0; i < OutboundQueue::MAX_ATTEMPTS - 1; i++)
+    {
+        queue.handleDelivery(3 + i, false, 2000);
+        CHECK(queue.takeDueReports(20000, records, 4) == 1);
+        queue.handleReportSent(2, ONOFF_CLUSTER, ONOFF_ATTR, 4 + i, 20000);
+    }
+    CHECK(queue.getStatistics().dropped == 0);
+    queue.handleDelivery(3 + OutboundQueue::MAX_ATTEMPTS - 1, false, 20000);
+    CHECK(queue.getStatistics().dropped == 1);
+}
+
+static void testMultipleRecordsInFrame()
+{
+    printf("testMultipleRecordsInFrame\n");
+    OutboundQueue queue;
+    ReportRecord records[4];
+
+    // All records of a frame share the APS sequence number
+    queue.handleReportSent(2, ONOFF_CLUSTER, 0x0000, 7, 0);
+    queue.handleReportSent(2, ONOFF_CLUSTER, 0x4001, 7, 0);
+    queue.handleReportSent(3, ONOFF_CLUSTER, 0x0000, 8, 0);
+
+    queue.handleDelivery(7, false, 0);
+    CHECK(queue.takeDueReports(1000, records, 4) == 2);
+    CHECK(queue.isReportPending(3, ONOFF_CLUSTER, 0x0000));
+}
+
+static void testReportTableFull()
+{
+    printf("testReportTableFull\n");
+    OutboundQueue queue;
+
+    for(uint8 i = 0; i < OutboundQueue::MAX_REPORTS; i++)
+        CHECK(queue.handleReportSent(2, ONOFF_CLUSTER, i, i, 0));
+
+    // Sent anyway, just not tracked
+    CHECK(!queue.handleReportSent(3, ONOFF_CLUSTER, 0, 100, 0));
+    CHECK(!queue.isReportPending(3, ONOFF_CLUSTER, 0));
+}
+
+static void testMergeOnOffCommands()
+{
+    printf("testMergeOnOffCommands\n");
+    uint8 merged;
+
+    CHECK(OutboundQueue::mergeOnOffCommands(CMD_ON, CMD_OFF, &merged) && merged == CMD_OFF);
+    CHECK(OutboundQueue::mergeOnOffCommands(CMD_OFF, CMD_ON, &merged) && merged == CMD_ON);
+    CHECK(OutboundQueue::mergeOnOffCommands(CMD_TOGGLE, CMD_ON, &merged) && merged == CMD_ON);
+    CHECK(OutboundQueue::mergeOnOffCommands(CMD_ON, CMD_TOGGLE, &merged) && merged == CMD_OFF);
+    CHECK(OutboundQueue::mergeOnOffCommands(CMD_OFF, CMD_TOGGLE, &merged) && merged == CMD_ON);
+    CHECK(!OutboundQueue::mergeOnOffCommands(CMD_TOGGLE, CMD_TOGGLE, &merged));
+}
+
+static void testHeldCommands()
+{
+    printf("testHeldCommands\n");
+    OutboundQueue queue;
+    OutboundCommand command;
+
+    // Pressing the button 3 times while offline results in a single toggle
+    CHECK(queue.queueCommand(2, ONOFF_CLUSTER, CMD_TOGGLE, 0));
+    CHECK(queue.queueCommand(2, ONOFF_CLUSTER, CMD_TOGGLE, 100));
+    CHECK(queue.getNumCommands() == 0);
+    CHECK(queue.queueCommand(2, ONOFF_CLUSTER, CMD_TOGGLE, 200));
+    CHECK(queue.queueCommand(3, ONOFF_CLUSTER, CMD_ON, 300));
+    CHECK(queue.getNumCommands() == 2);
+
+    CHECK(queue.takeDueCommand(1000, &command));
+    CHECK(command.endpoint == 2 && command.commandId == CMD_TOGGLE);
+    queue.handleCommandSent();
+    CHECK(queue.takeDueCommand(1000, &command));
+    CHECK(command.endpoint == 3 && command.commandId == CMD_ON);
+    queue.handleCommandSent();
+    CHECK(!queue.takeDueCommand(1000, &command));
+
+    CHECK(queue.getStatistics().queued == 4);
+    CHECK(queue.getStatistics().delivered == 2);
+}
+
+static void testHeldCommandsExpire()
+{
+    printf("testHeldCommandsExpire\n");
+    OutboundQueue queue;
+    OutboundCommand command;
+
+    queue.queueCommand(2, ONOFF_CLUSTER, CMD_ON, 0);
+    queue.queueCommand(3, ONOFF_CLUSTER, CMD_ON, 10000);
+
+    CHECK(queue.takeDueCommand(OutboundQueue::COMMAND_MAX_AGE + 1, &command));
+    CHECK(command.endpoint == 3);
+    CHECK(queue.getNumCommands() == 0);
+    CHECK(queue.getStatistics().dropped == 1);
+}
+
+static void testCommandRetry()
+{
+    printf("testCommandRetry\n");
+    OutboundQueue queue;
+    OutboundCommand command;
+
+    queue.queueCommand(2, ONOFF_CLUSTER, CMD_OFF, 0);
+    CHECK(queue.takeDueCommand(0, &command));
+
+    // Failed send is retried after the back-off delay
+    CHECK(queue.retryCommand(command, 0));
+    CHECK(!queue.takeDueCommand(999, &command));
+    CHECK(queue.takeDueCommand(1000, &command));
+    CHECK(command.commandId == CMD_OFF && command.attempts == 1);
+
+    // A newer command held meanwhile wins over the failed one
+    queue.queueCommand(2, ONOFF_CLUSTER, CMD_ON, 1500);
+    CHECK(queue.retryCommand(command, 1500));
+    CHECK(queue.takeDueCommand(1500, &command));
+    CHECK(command.commandId == CMD_ON && command.attempts == 0);
+
+    // Eventually the queue gives up
+    command.attempts = OutboundQueue::MAX_ATTEMPTS - 1;
+    CHECK(!queue.retryCommand(command, 2000));
+    CHECK(queue.getNumCommands() == 0);
+    CHECK(queue.getStatistics().retried == 2);
+    CHECK(queue.getStatistics().dropped == 1);
+}
+
+static void testExpedite()
+{
+    printf("testExpedite\n");
+    OutboundQueue queue;
+    ReportRecord records[4];
+    OutboundCommand command;
+
+    queue.handleReportSent(2, ONOFF_CLUSTER, 0x0000, 1, 0);
+    queue.handleReportSent(3, ONOFF_CLUSTER, 0x0000, 2, 0);
+    queue.handleDelivery(2, false, 0);
+    queue.queueCommand(2, ONOFF_CLUSTER, CMD_ON, 0);
+    OutboundCommand failed = {3, ONOFF_CLUSTER, CMD_OFF, 0, 0, 0};
+    queue.retryCommand(failed, 0);
+    CHECK(queue.takeDueReports(100, records, 4) == 0);
+
+    // After rejoin everything pending goes out right away
+    queue.expedite(100);
+    CHECK(queue.takeDueReports(100, records, 4) == 2);
+    CHECK(queue.takeDueCommand(100, &command));
+    CHECK(queue.takeDueCommand(100, &command));
+    CHECK(queue.getStatistics().retried == 3);
+}
+
+static void testRetryDelay()
+{
+    printf("testRetryDelay\n");
+    CHECK(OutboundQueue::getRetryDelay(1) == 1000);
+    CHECK(OutboundQueue::getRetryDelay(2) == 2000);
+    CHECK(OutboundQueue::getRetryDelay(3) == 4000);
+    CHECK(OutboundQueue::getRetryDelay(4) == 8000);
+    CHECK(OutboundQueue::getRetryDelay(20) == OutboundQueue::MAX_RETRY_DELAY);
+}
+
+int main()
+{
+    testReportDelivered();
+    testReportRetryWithBackoff();
+    testAckTimeout();
+    testLatestValueOnly();
+    testNewValueRestartsAttempts();
+    testRetryNeverSent();
+    testMultipleRecordsInFrame();
+    testReportTableFull();
+    testMergeOnOffCommands();
+    testHeldCommands();
+    testHeldCommandsExpire();
+    testCommandRetry();
+    testExpedite();
+    testRetryDelay();
+
+    return testResult();
+}
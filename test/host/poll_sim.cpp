@@ -0,0 +1,287 @@
+// Simulation of an end device polling its parent.
+//
+// Compares the original fixed policy (poll every 2s, re-poll immediately while there is data) with the adaptive
+// PollPolicy. Radio-on events (number of polls sent) are used as an energy proxy, and the time a message waits in the
+// parent's indirect queue is used as a command latency.
+//
+// The simulation returns non-zero exit code if the adaptive policy does not outperform the fixed one.
+
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include "PollPolicy.h"
+
+static const uint32 POLL_DURATION = 10;                 // Time to get a poll response, ms
+static const uint32 INDIRECT_TRANSACTION_TIMEOUT = 7680;  // Parent drops messages that are not picked up in time
+static const uint32 RESPONSE_DELAY = 30;                // Time for a coordinator to respond a request, ms
+
+// Simple deterministic random number generator, so that both policies see exactly the same traffic
+class Random
+{
+    uint32 state;
+
+public:
+    Random(uint32 seed) : state(seed) {}
+
+    uint32 next()
+    {
+        state = state * 1103515245 + 12345;
+        return (state >> 8) & 0xffffff;
+    }
+
+    uint32 interval(uint32 mean)
+    {
+        // Uniformly distributed interval with the given mean value
+        return (next() % (2 * mean)) + 1;
+    }
+};
+
+struct Scenario
+{
+    const char * name;
+    uint32 duration;            // ms
+    uint32 meanCommandInterval; // unsolicited commands from the coordinator, ms (0 - none)
+    uint32 meanButtonInterval;  // local activity, followed by a coordinator command, ms (0 - none)
+    uint32 otaBlocks;           // number of OTA blocks to transfer at the beginning of the scenario
+};
+
+struct Result
+{
+    uint32 polls;
+    uint32 delivered;
+    uint32 lost;
+    uint64 totalLatency;
+    uint32 maxLatency;
+    uint32 otaTime;
+};
+
+class PollingDevice
+{
+public:
+    virtual ~PollingDevice() {}
+    virtual void start(uint32 now) = 0;
+    virtual void handleActivity(uint32 now) = 0;
+    virtual void handlePollResult(PollResult result, uint32 now) = 0;
+    virtual uint32 getNextPollTime() const = 0;
+};
+
+// Original behavior: poll every 2 seconds, poll again immediately if data was received
+class FixedPollingDevice : public PollingDevice
+{
+    uint32 nextPollTime;
+
+public:
+    virtual void start(uint32 now) { nextPollTime = now + 2000; }
+    virtual void handleActivity(uint32) {}
+    virtual void handlePollResult(PollResult result, uint32 now)
+    {
+        nextPollTime = (result == POLL_RESULT_DATA) ? now : now + 2000;
+    }
+    virtual uint32 getNextPollTime() const { return nextPollTime; }
+};
+
+// Adaptive behavior, mirrors PollTask and ZigbeeDevice::handlePollResponse() logic
+class AdaptivePollingDevice : public PollingDevice
+{
+    PollPolicy policy;
+    uint32 nextPollTime;
+
+public:
+    virtual void start(uint32 now)
+    {
+        policy.reset(now);
+        policy.triggerFastPoll(now);
+        nextPollTime = now + policy.getNextPollDelay(now);
+    }
+
+    virtual void handleActivity(uint32 now)
+    {
+        bool wasFastPolling = policy.isFastPolling(now);
+        policy.triggerFastPoll(now);
+        if(!wasFastPolling)
+            nextPollTime = now + policy.getNextPollDelay(now);
+    }
+
+    virtual void handlePollResult(PollResult result, uint32 now)
+    {
+        policy.handlePollSent();
+        if(policy.handlePollResult(result, now))
+            nextPollTime = now;
+        else
+            nextPollTime = now + policy.getNextPollDelay(now);
+    }
+
+    virtual uint32 getNextPollTime() const { return nextPollTime; }
+};
+
+struct Message
+{
+    uint32 arrival;
+    bool otaBlock;
+};
+
+Result simulate(const Scenario & scenario, PollingDevice & device, uint32 seed)
+{
+    Random rnd(seed);
+    Result res = {0, 0, 0, 0, 0, 0};
+
+    std::deque<Message> parentQueue;
+    std::vector<uint32> pendingResponses;    // times when coordinator responses arrive to the parent
+
+    uint32 nextCommand = scenario.meanCommandInterval ? rnd.interval(scenario.meanCommandInterval) : 0xffffffff;
+    uint32 nextButton = scenario.meanButtonInterval ? rnd.interval(scenario.meanButtonInterval) : 0xffffffff;
+    uint32 otaBlocksLeft = scenario.otaBlocks;
+    uint32 otaRequestTime = 0xffffffff;
+
+    device.start(0);
+    if(otaBlocksLeft)
+    {
+        // Device requests the first block
+        device.handleActivity(0);
+        otaRequestTime = 0;
+    }
+
+    for(uint32 now = 0; now < scenario.duration; now++)
+    {
+        // Coordinator sends an unsolicited command
+        if(now == nextCommand)
+        {
+            Message msg = {now, false};
+            parentQueue.push_back(msg);
+            nextCommand = now + rnd.interval(scenario.meanCommandInterval);
+        }
+
+        // User presses a button, device reports it, and the coordinator responds with a command
+        if(now == nextButton)
+        {
+            device.handleActivity(now);
+            pendingResponses.push_back(now + RESPONSE_DELAY * 5);
+            nextButton = now + rnd.interval(scenario.meanButtonInterval);
+        }
+
+        // OTA server responds the block request
+        if(otaBlocksLeft && now == otaRequestTime + RESPONSE_DELAY)
+        {
+            Message msg = {now, true};
+            parentQueue.push_back(msg);
+        }
+
+        for(size_t i = 0; i < pendingResponses.size(); i++)
+        {
+            if(pendingResponses[i] == now)
+            {
+                Message msg = {now, false};
+                parentQueue.push_back(msg);
+            }
+        }
+
+        // Parent drops expired messages
+        while(!parentQueue.empty() && now - parentQueue.front().arrival > INDIRECT_TRANSACTION_TIMEOUT)
+        {
+            if(parentQueue.front().otaBlock)
+                otaRequestTime = now;   // OTA client will re-request the block after a timeout
+            parentQueue.pop_front();
+            res.lost++;
+        }
+
+        // Device polls the parent
+        if(now >= device.getNextPollTime())
+        {
+            res.polls++;
+            uint32 responseTime = now + POLL_DURATION;
+
+            if(parentQueue.empty())
+            {
+                device.handlePollResult(POLL_RESULT_NO_DATA, responseTime);
+                continue;
+            }
+
+            Message msg = parentQueue.front();
+            parentQueue.pop_front();
+
+            uint32 latency = responseTime - msg.arrival;
+            res.delivered++;
+            res.totalLatency += latency;
+            res.maxLatency = std::max(res.maxLatency, latency);
+
+            device.handlePollResult(POLL_RESULT_DATA, responseTime);
+
+            // OTA client requests the next block right away
+            if(msg.otaBlock && otaBlocksLeft)
+            {
+                if(--otaBlocksLeft > 0)
+                {
+                    device.handleActivity(responseTime);
+                    otaRequestTime = responseTime;
+                }
+                else
+                    res.otaTime = responseTime;
+            }
+        }
+    }
+
+    return res;
+}
+
+static void printResult(const char * policy, const Result & res)
+{
+    printf("  %-10s polls=%-7d delivered=%-5d lost=%-4d avgLatency=%-6d maxLatency=%-6d otaTime=%d\n",
+           policy,
+           res.polls,
+           res.delivered,
+           res.lost,
+           res.delivered ? (uint32)(res.totalLatency / res.delivered) : 0,
+           res.maxLatency,
+           res.otaTime);
+}
+
+int main()
+{
+    const uint32 HOUR = 3600 * 1000;
+    const Scenario scenarios[] = {
+        {"idle",                    2 * HOUR,   0,              0,          0},
+        {"rare commands",           2 * HOUR,   20 * 60 * 1000, 0,          0},
+        {"user activity",           2 * HOUR,   0,              5 * 60 * 1000, 0},
+        {"mixed",                   2 * HOUR,   30 * 60 * 1000, 10 * 60 * 1000, 0},
+        {"ota 100 blocks",          1 * HOUR,   0,              0,          100},
+    };
+
+    bool success = true;
+    for(size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        const Scenario & scenario = scenarios[i];
+
+        FixedPollingDevice fixed;
+        AdaptivePollingDevice adaptive;
+        Result fixedRes = simulate(scenario, fixed, 42 + i);
+        Result adaptiveRes = simulate(scenario, adaptive, 42 + i);
+
+        printf("Scenario '%s':\n", scenario.name);
+        printResult("fixed", fixedRes);
+        printResult("adaptive", adaptiveRes);
+
+        // Adaptive policy shall be cheaper when the device is mostly idle
+        if(scenario.otaBlocks == 0 && adaptiveRes.polls >= fixedRes.polls)
+        {
+            printf("  FAIL: adaptive policy sends more polls than the fixed one\n");
+            success = false;
+        }
+
+        // Responses to local activity and OTA blocks shall arrive faster
+        if(scenario.meanButtonInterval && adaptiveRes.totalLatency * fixedRes.delivered > fixedRes.totalLatency * adaptiveRes.delivered)
+        {
+            printf("  FAIL: adaptive policy has worse average latency than the fixed one\n");
+            success = false;
+        }
+
+        if(scenario.otaBlocks && (adaptiveRes.otaTime == 0 || adaptiveRes.otaTime >= fixedRes.otaTime))
+        {
+            printf("  FAIL: adaptive policy does not speed up OTA transfer\n");
+            success = false;
+        }
+    }
+
+    return success ? 0 : 1;
+}
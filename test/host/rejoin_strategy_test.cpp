@@ -0,0 +1,267 @@
+// State machine tests for the staged rejoin strategy.
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+#include "RejoinStrategy.h"
+#include "test_common.h"
+
+// Runs a failed attempt, returns the delay till the next one
+static uint32 failAttempt(RejoinStrategy & strategy, uint32 & now)
+{
+    now = strategy.getNextAttemptTime();
+    strategy.startAttempt();
+    now += 500;     // attempt duration
+    strategy.handleAttemptFailed(now);
+    return strategy.getNextAttemptTime() - now;
+}
+
+static void testIdleByDefault()
+{
+    printf("testIdleByDefault\n");
+    RejoinStrategy strategy;
+
+    CHECK(strategy.getStage() == REJOIN_STAGE_IDLE);
+    CHECK(!strategy.isActive());
+    CHECK(!strategy.isAttemptDue(0));
+    CHECK(!strategy.isAttemptDue(1000000));
+    CHECK(strategy.getTimeTillNextAttempt(0) == 0);
+}
+
+static void testStagesOrder()
+{
+    printf("testStagesOrder\n");
+    RejoinStrategy strategy;
+    uint32 now = 1000;
+
+    strategy.handleConnectionLost(now);
+    CHECK(strategy.getStage() == REJOIN_STAGE_TARGETED);
+    CHECK(strategy.isActive());
+    CHECK(!strategy.isAttemptDue(now));
+
+    for(uint8 i = 0; i < RejoinStrategy::DEFAULT_TARGETED_ATTEMPTS; i++)
+    {
+        CHECK(strategy.getStage() == REJOIN_STAGE_TARGETED);
+        failAttempt(strategy, now);
+    }
+
+    for(uint8 i = 0; i < RejoinStrategy::DEFAULT_CHANNEL_SCAN_ATTEMPTS; i++)
+    {
+        CHECK(strategy.getStage() == REJOIN_STAGE_CHANNEL_SCAN);
+        failAttempt(strategy, now);
+    }
+
+    for(uint8 i = 0; i < RejoinStrategy::DEFAULT_TRUST_CENTER_ATTEMPTS; i++)
+    {
+        CHECK(strategy.getStage() == REJOIN_STAGE_TRUST_CENTER);
+        failAttempt(strategy, now);
+    }
+
+    CHECK(strategy.getStage() == REJOIN_STAGE_GAVE_UP);
+    CHECK(!strategy.isActive());
+    CHECK(!strategy.isAttemptDue(now + 10000000));
+
+    const RejoinStatistics & stats = strategy.getStatistics();
+    CHECK(stats.giveUps == 1);
+    CHECK(stats.rejoins == 0);
+    CHECK(stats.attempts[REJOIN_STAGE_TARGETED] == RejoinStrategy::DEFAULT_TARGETED_ATTEMPTS);
+    CHECK(stats.attempts[REJOIN_STAGE_CHANNEL_SCAN] == RejoinStrategy::DEFAULT_CHANNEL_SCAN_ATTEMPTS);
+    CHECK(stats.attempts[REJOIN_STAGE_TRUST_CENTER] == RejoinStrategy::DEFAULT_TRUST_CENTER_ATTEMPTS);
+}
+
+static void testExponentialBackoffWithJitter()
+{
+    printf("testExponentialBackoffWithJitter\n");
+    RejoinStrategy strategy;
+    strategy.configureStage(REJOIN_STAGE_TARGETED, 5, 1000);
+    strategy.configureLimits(6000, 25);
+    uint32 now = 0;
+
+    strategy.handleConnectionLost(now);
+    uint32 firstDelay = strategy.getNextAttemptTime() - now;
+    CHECK(firstDelay >= 750 && firstDelay <= 1250);
+
+    // Delays within the stage: 2000, 4000, then capped at 6000 (each +/- 25%)
+    uint32 expected[] = {2000, 4000, 6000, 6000};
+    for(size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+    {
+        uint32 delay = failAttempt(strategy, now);
+        CHECK(delay >= expected[i] * 3 / 4 && delay <= expected[i] * 5 / 4);
+    }
+
+    // Next stage starts with its own initial delay
+    uint32 delay = failAttempt(strategy, now);
+    CHECK(strategy.getStage() == REJOIN_STAGE_CHANNEL_SCAN);
+    CHECK(delay <= 6000 * 5 / 4);
+}
+
+static void testNoJitter()
+{
+    printf("testNoJitter\n");
+    RejoinStrategy strategy;
+    strategy.configureLimits(RejoinStrategy::DEFAULT_MAX_DELAY, 0);
+    uint32 now = 100;
+
+    strategy.handleConnectionLost(now);
+    CHECK(strategy.getNextAttemptTime() == now + RejoinStrategy::DEFAULT_TARGETED_DELAY);
+    CHECK(failAttempt(strategy, now) == 2 * RejoinStrategy::DEFAULT_TARGETED_DELAY);
+    CHECK(failAttempt(strategy, now) == 4 * RejoinStrategy::DEFAULT_TARGETED_DELAY);
+    CHECK(failAttempt(strategy, now) == RejoinStrategy::DEFAULT_CHANNEL_SCAN_DELAY);
+}
+
+static void testAttemptDue()
+{
+    printf("testAttemptDue\n");
+    RejoinStrategy strategy;
+    uint32 now = 5000;
+
+    strategy.handleConnectionLost(now);
+    uint32 next = strategy.getNextAttemptTime();
+    CHECK(!strategy.isAttemptDue(next - 1));
+    CHECK(strategy.isAttemptDue(next));
+    CHECK(strategy.getTimeTillNextAttempt(next - 10) == 10);
+
+    // No new attempts while the current one is running
+    strategy.startAttempt();
+    CHECK(strategy.isAttemptInProgress());
+    CHECK(!strategy.isAttemptDue(next + 100000));
+    CHECK(strategy.getTimeTillNextAttempt(next) == 0);
+}
+
+static void testRepeatedConnectionLost()
+{
+    printf("testRepeatedConnectionLost\n");
+    RejoinStrategy strategy;
+    uint32 now = 0;
+
+    // Repeated notifications while waiting do not restart the procedure
+    strategy.handleConnectionLost(now);
+    uint32 next = strategy.getNextAttemptTime();
+    strategy.handleConnectionLost(now + 10);
+    CHECK(strategy.getNextAttemptTime() == next);
+    CHECK(strategy.getStage() == REJOIN_STAGE_TARGETED);
+
+    // Notification during the attempt is treated as the attempt failure
+    strategy.startAttempt();
+    strategy.handleConnectionLost(next + 100);
+    CHECK(!strategy.isAttemptInProgress());
+    CHECK((int32)(strategy.getNextAttemptTime() - (next + 100)) > 0);
+    CHECK(strategy.getStatistics().attempts[REJOIN_STAGE_TARGETED] == 1);
+}
+
+static void testSuccess()
+{
+    printf("testSuccess\n");
+    RejoinStrategy strategy;
+    uint32 now = 10000;
+
+    strategy.handleConnectionLost(now);
+    failAttempt(strategy, now);
+    failAttempt(strategy, now);
+    failAttempt(strategy, now);
+    CHECK(strategy.getStage() == REJOIN_STAGE_CHANNEL_SCAN);
+
+    now = strategy.getNextAttemptTime();
+    strategy.startAttempt();
+    strategy.handleAttemptSucceeded(now + 700);
+
+    CHECK(strategy.getStage() == REJOIN_STAGE_IDLE);
+    CHECK(!strategy.isActive());
+
+    const RejoinStatistics & stats = strategy.getStatistics();
+    CHECK(stats.rejoins == 1);
+    CHECK(stats.successes[REJOIN_STAGE_CHANNEL_SCAN] == 1);
+    CHECK(stats.successes[REJOIN_STAGE_TARGETED] == 0);
+    CHECK(stats.lastTimeToRejoin == now + 700 - 10000);
+    CHECK(stats.maxTimeToRejoin == stats.lastTimeToRejoin);
+
+    // Next connection loss starts from the cheapest stage again
+    strategy.handleConnectionLost(now + 1000);
+    CHECK(strategy.getStage() == REJOIN_STAGE_TARGETED);
+
+    now = strategy.getNextAttemptTime();
+    strategy.startAttempt();
+    strategy.handleAttemptSucceeded(now + 100);
+    CHECK(strategy.getStatistics().rejoins == 2);
+    CHECK(strategy.getStatistics().lastTimeToRejoin < strategy.getStatistics().maxTimeToRejoin);
+}
+
+static void testSkipEmptyStages()
+{
+    printf("testSkipEmptyStages\n");
+    RejoinStrategy strategy;
+    strategy.configureStage(REJOIN_STAGE_TARGETED, 0, 1000);
+    strategy.configureStage(REJOIN_STAGE_CHANNEL_SCAN, 1, 1000);
+    strategy.configureStage(REJOIN_STAGE_TRUST_CENTER, 0, 1000);
+    uint32 now = 0;
+
+    strategy.handleConnectionLost(now);
+    CHECK(strategy.getStage() == REJOIN_STAGE_CHANNEL_SCAN);
+
+    failAttempt(strategy, now);
+    CHECK(strategy.getStage() == REJOIN_STAGE_GAVE_UP);
+    CHECK(strategy.getStatistics().giveUps == 1);
+}
+
+static void testTimerWraparound()
+{
+    printf("testTimerWraparound\n");
+    RejoinStrategy strategy;
+    uint32 now = 0xffffff00;
+
+    strategy.handleConnectionLost(now);
+    uint32 next = strategy.getNextAttemptTime();
+    CHECK(next < now);     // wrapped
+    CHECK(!strategy.isAttemptDue(now + 10));
+    CHECK(strategy.isAttemptDue(next));
+
+    strategy.startAttempt();
+    strategy.handleAttemptSucceeded(next + 50);
+    CHECK(strategy.getStatistics().lastTimeToRejoin == next + 50 - 0xffffff00);
+}
+
+static void testDevicesDesynchronized()
+{
+    printf("testDevicesDesynchronized\n");
+
+    // A lot of devices lose the network at the same moment. Their attempts shall be spread in time.
+    const uint32 DEVICES = 50;
+    std::vector<uint32> attemptTimes;
+    for(uint32 dev = 0; dev < DEVICES; dev++)
+    {
+        RejoinStrategy strategy;
+        strategy.setSeed(0x00158d00 + dev * 7919);
+
+        uint32 now = 0;
+        strategy.handleConnectionLost(now);
+        failAttempt(strategy, now);
+        failAttempt(strategy, now);
+        failAttempt(strategy, now);
+        attemptTimes.push_back(strategy.getNextAttemptTime());   // first channel scan attempt
+    }
+
+    std::sort(attemptTimes.begin(), attemptTimes.end());
+    uint32 spread = attemptTimes.back() - attemptTimes.front();
+    size_t unique = std::unique(attemptTimes.begin(), attemptTimes.end()) - attemptTimes.begin();
+    printf("  spread=%d ms, unique attempt times %d of %d\n", spread, (int)unique, DEVICES);
+
+    CHECK(spread >= 4000);
+    CHECK(unique >= DEVICES * 9 / 10);
+}
+
+int main()
+{
+    testIdleByDefault();
+    testStagesOrder();
+    testExponentialBackoffWithJitter();
+    testNoJitter();
+    testAttemptDue();
+    testRepeatedConnectionLost();
+    testSuccess();
+    testSkipEmptyStages();
+    testTimerWraparound();
+    testDevicesDesynchronized();
+
+    return testResult();
+}
@@ -0,0 +1,177 @@
+// Tests for the attribute report batch: grouping per endpoint and cluster, merging and statistics.
+
+#include <stdio.h>
+
+#include "ReportBatch.h"
+#include "test_common.h"
+
+static const uint16 ONOFF_CLUSTER = 0x0006;
+static const uint16 MULTISTATE_CLUSTER = 0x0012;
+static const uint16 DIAGNOSTICS_CLUSTER = 0x0B05;
+
+// Sends all the frames, returns the number of frames
+static uint8 sendAll(ReportBatch & batch, uint8 maxRecords)
+{
+    ReportRecord frame[ReportBatch::MAX_RECORDS];
+    uint8 frames = 0;
+    uint8 numRecords;
+    while((numRecords = batch.takeNextFrame(frame, maxRecords)) != 0)
+    {
+        // All records in the frame belong to the same endpoint and cluster
+        for(uint8 i = 1; i < numRecords; i++)
+        {
+            CHECK(frame[i].endpoint == frame[0].endpoint);
+            CHECK(frame[i].clusterId == frame[0].clusterId);
+        }
+
+        batch.handleFrameSent(frame, numRecords);
+        frames++;
+    }
+
+    return frames;
+}
+
+static void testEmpty()
+{
+    printf("testEmpty\n");
+    ReportBatch batch;
+    ReportRecord frame[4];
+
+    CHECK(batch.isEmpty());
+    CHECK(batch.takeNextFrame(frame, 4) == 0);
+    CHECK(batch.getStatistics().framesSent == 0);
+}
+
+static void testGroupingPerEndpointAndCluster()
+{
+    printf("testGroupingPerEndpointAndCluster\n");
+    ReportBatch batch;
+
+    batch.add(2, ONOFF_CLUSTER, 0x0000);
+    batch.add(2, MULTISTATE_CLUSTER, 0x0055);
+    batch.add(3, ONOFF_CLUSTER, 0x0000);
+    batch.add(2, ONOFF_CLUSTER, 0x4003);
+    batch.add(2, MULTISTATE_CLUSTER, 0x006F);
+
+    CHECK(sendAll(batch, 8) == 3);
+    CHECK(batch.isEmpty());
+
+    const ReportStatistics & stats = batch.getStatistics();
+    CHECK(stats.requests == 5);
+    CHECK(stats.framesSent == 3);
+    CHECK(stats.framesSaved == 2);
+}
+
+static void testMergeSameAttribute()
+{
+    printf("testMergeSameAttribute\n");
+    ReportBatch batch;
+
+    // E.g. interlocked relay switched several times within one iteration
+    batch.add(2, ONOFF_CLUSTER, 0x0000);
+    batch.add(2, ONOFF_CLUSTER, 0x0000);
+    batch.add(2, ONOFF_CLUSTER, 0x0000);
+    CHECK(batch.contains(2, ONOFF_CLUSTER, 0x0000));
+    CHECK(!batch.contains(3, ONOFF_CLUSTER, 0x0000));
+
+    ReportRecord frame[4];
+    CHECK(batch.takeNextFrame(frame, 4) == 1);
+    CHECK(frame[0].requests == 3);
+    batch.handleFrameSent(frame, 1);
+
+    CHECK(batch.getStatistics().framesSent == 1);
+    CHECK(batch.getStatistics().framesSaved == 2);
+}
+
+static void testTakeSpecificFrame()
+{
+    printf("testTakeSpecificFrame\n");
+    ReportBatch batch;
+
+    batch.add(2, ONOFF_CLUSTER, 0x0000);
+    batch.add(2, MULTISTATE_CLUSTER, 0x0055);
+    batch.add(3, ONOFF_CLUSTER, 0x0000);
+
+    ReportRecord frame[4];
+    CHECK(batch.takeFrame(2, MULTISTATE_CLUSTER, frame, 4) == 1);
+    CHECK(frame[0].attributeId == 0x0055);
+    CHECK(!batch.contains(2, MULTISTATE_CLUSTER, 0x0055));
+
+    // Other records stay in the original order
+    CHECK(batch.takeNextFrame(frame, 4) == 1);
+    CHECK(frame[0].endpoint == 2 && frame[0].clusterId == ONOFF_CLUSTER);
+    CHECK(batch.takeNextFrame(frame, 4) == 1);
+    CHECK(frame[0].endpoint == 3);
+    CHECK(batch.isEmpty());
+}
+
+static void testFrameSizeLimit()
+{
+    printf("testFrameSizeLimit\n");
+    ReportBatch batch;
+
+    for(uint16 attr = 0; attr < 5; attr++)
+        batch.add(2, ONOFF_CLUSTER, attr);
+
+    CHECK(sendAll(batch, 2) == 3);
+    CHECK(batch.getStatistics().framesSaved == 2);
+}
+
+static void testFull()
+{
+    printf("testFull\n");
+    ReportBatch batch;
+
+    for(uint16 attr = 0; attr < ReportBatch::MAX_RECORDS; attr++)
+        CHECK(batch.add(2, ONOFF_CLUSTER, attr));
+
+    CHECK(batch.isFull());
+    CHECK(!batch.add(2, ONOFF_CLUSTER, ReportBatch::MAX_RECORDS));
+
+    // Already collected attributes can still be merged
+    CHECK(batch.add(2, ONOFF_CLUSTER, 0));
+    CHECK(batch.getStatistics().requests == ReportBatch::MAX_RECORDS + 1);
+}
+
+static void testDeviceTraffic()
+{
+    printf("testDeviceTraffic\n");
+    ReportBatch batch;
+
+    // Main loop iterations of a two gang relay, with the Diagnostics reports the z2m converter configures.
+    // A click on an interlocked relay: On/Off and the action of EP2, and On/Off of EP3. Different clusters and
+    // endpoints, so no frames are saved here. A Report Attributes frame carries a single cluster.
+    batch.add(2, ONOFF_CLUSTER, 0x0000);
+    batch.add(2, MULTISTATE_CLUSTER, 0x0055);
+    batch.add(3, ONOFF_CLUSTER, 0x0000);
+    CHECK(sendAll(batch, 8) == 3);
+
+    // A unicast that was not delivered changes MAC and APS failure counters and the average MAC retries together
+    batch.add(1, DIAGNOSTICS_CLUSTER, 0x0105);
+    batch.add(1, DIAGNOSTICS_CLUSTER, 0x010B);
+    batch.add(1, DIAGNOSTICS_CLUSTER, 0x011B);
+    CHECK(sendAll(batch, 8) == 1);
+
+    // A message received with a different LQI
+    batch.add(1, DIAGNOSTICS_CLUSTER, 0x011C);
+    CHECK(sendAll(batch, 8) == 1);
+
+    const ReportStatistics & stats = batch.getStatistics();
+    printf("  %d report(s) in %d frame(s), %d frame(s) saved\n", stats.requests, stats.framesSent, stats.framesSaved);
+    CHECK(stats.requests == 7);
+    CHECK(stats.framesSent == 5);
+    CHECK(stats.framesSaved == 2);
+}
+
+int main()
+{
+    testEmpty();
+    testGroupingPerEndpointAndCluster();
+    testMergeSameAttribute();
+    testTakeSpecificFrame();
+    testFrameSizeLimit();
+    testFull();
+    testDeviceTraffic();
+
+    return testResult();
+}
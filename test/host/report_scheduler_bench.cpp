@@ -0,0 +1,214 @@
+// Benchmark of the attribute report scheduler with a lot of configured reports.
+//
+// Compares the heap based ReportScheduler with the approach of the ZCL report manager, which is ticked once per
+// second and checks every configured report. Both see exactly the same configuration and attribute changes during
+// a simulated day, and must send exactly the same reports. The cost is measured in report entries examined, and in
+// the number of times the device has to wake up for reporting.
+//
+// The benchmark returns non-zero exit code if the schedulers disagree, or if the heap is not cheaper.
+
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+#include "ReportScheduler.h"
+
+static const uint16 NUM_REPORTS = 128;
+static const uint32 SIMULATION_TIME = 24 * 3600;        // s
+static const uint32 CHANGES_PER_HOUR = 600;
+
+// Simple deterministic random number generator, so that both schedulers see exactly the same changes
+class Random
+{
+    uint32 state;
+
+public:
+    Random(uint32 seed) : state(seed) {}
+
+    uint32 next()
+    {
+        state = state * 1103515245 + 12345;
+        return (state >> 8) & 0xffffff;
+    }
+};
+
+// The same ZCL reporting rules, checked for every report each second
+class LinearScanScheduler
+{
+    struct Entry
+    {
+        ReportConfig config;
+        bool changed;
+        int32 value;
+        int32 reportedValue;
+        uint32 lastReportTime;
+    };
+
+    std::vector<Entry> entries;
+
+public:
+    uint32 entriesExamined;
+
+    LinearScanScheduler() : entriesExamined(0) {}
+
+    void configure(const ReportConfig & config, uint32 now)
+    {
+        Entry entry = {config, true, 0, 0, now - config.minInterval * 1000};
+        entries.push_back(entry);
+    }
+
+    bool handleValueChange(uint16 idx, int32 value, uint32 now)
+    {
+        Entry & entry = entries[idx];
+        entry.value = value;
+        uint32 delta = value > entry.reportedValue ? value - entry.reportedValue : entry.reportedValue - value;
+        if(delta == 0 || delta < entry.config.reportableChange)
+            return false;
+
+        if(now - entry.lastReportTime >= entry.config.minInterval * 1000)
+        {
+            markReported(entry, now);
+            return true;
+        }
+
+        entry.changed = true;
+        return false;
+    }
+
+    uint32 tick(uint32 now)
+    {
+        uint32 reports = 0;
+        for(size_t i = 0; i < entries.size(); i++)
+        {
+            Entry & entry = entries[i];
+            entriesExamined++;
+
+            uint32 elapsed = now - entry.lastReportTime;
+            bool due = entry.changed ? elapsed >= entry.config.minInterval * 1000
+                                     : entry.config.maxInterval != 0 && elapsed >= entry.config.maxInterval * 1000;
+            if(due)
+            {
+                markReported(entry, now);
+                reports++;
+            }
+        }
+
+        return reports;
+    }
+
+private:
+    void markReported(Entry & entry, uint32 now)
+    {
+        entry.lastReportTime = now;
+        entry.reportedValue = entry.value;
+        entry.changed = false;
+    }
+};
+
+int main()
+{
+    // Diagnostic counters, temperature and other measurements on a few endpoints
+    Random random(0x00158d00);
+    std::vector<ReportConfig> configs;
+    for(uint16 i = 0; i < NUM_REPORTS; i++)
+    {
+        ReportConfig config;
+        config.endpoint = 1 + i % 4;
+        config.clusterId = 0x0B05 + (i % 3);
+        config.attributeId = i;
+        config.minInterval = 1 + random.next() % 30;
+        config.maxInterval = (i % 5 == 0) ? REPORT_INTERVAL_NO_PERIODIC : 60 + random.next() % 3540;
+        config.reportableChange = (i % 2) ? 0 : 1 + random.next() % 50;
+        configs.push_back(config);
+    }
+
+    ReportSchedulerStorage<NUM_REPORTS> heapScheduler;
+    LinearScanScheduler linearScheduler;
+    for(uint16 i = 0; i < NUM_REPORTS; i++)
+    {
+        const ReportConfig & c = configs[i];
+        heapScheduler.configure(c.endpoint, c.clusterId, c.attributeId, c.minInterval, c.maxInterval, c.reportableChange, 0);
+        linearScheduler.configure(c, 0);
+    }
+
+    std::vector<int32> values(NUM_REPORTS, 0);
+    uint32 heapReports = 0;
+    uint32 linearReports = 0;
+    uint32 heapWakeups = 0;
+    uint32 mismatches = 0;
+    ReportRecord records[NUM_REPORTS];
+    clock_t heapClocks = 0;
+    clock_t linearClocks = 0;
+
+    for(uint32 second = 0; second < SIMULATION_TIME; second++)
+    {
+        uint32 now = second * 1000;
+
+        // Random attribute changes, same for both schedulers
+        uint32 numChanges = 0;
+        while(random.next() % 3600 < CHANGES_PER_HOUR / (numChanges + 1))
+            numChanges++;
+
+        for(uint32 i = 0; i < numChanges; i++)
+        {
+            uint16 idx = random.next() % NUM_REPORTS;
+            values[idx] += (int32)(random.next() % 61) - 30;
+            const ReportConfig & c = configs[idx];
+
+            clock_t start = clock();
+            bool heapNow = heapScheduler.handleValueChange(c.endpoint, c.clusterId, c.attributeId, values[idx], now);
+            heapClocks += clock() - start;
+
+            start = clock();
+            bool linearNow = linearScheduler.handleValueChange(idx, values[idx], now);
+            linearClocks += clock() - start;
+
+            heapReports += heapNow;
+            linearReports += linearNow;
+            if(heapNow != linearNow)
+                mismatches++;
+        }
+
+        // The heap scheduler is woken up only when something is due
+        clock_t start = clock();
+        uint32 wait = heapScheduler.getTimeTillNextReport(now);
+        if(wait != 0 && wait <= 1)
+        {
+            uint8 n = heapScheduler.takeDueReports(now, records, NUM_REPORTS);
+            heapReports += n;
+            heapWakeups++;
+        }
+        heapClocks += clock() - start;
+
+        // The linear scheduler scans everything every second
+        start = clock();
+        linearReports += linearScheduler.tick(now);
+        linearClocks += clock() - start;
+    }
+
+    const ReportSchedulerStatistics & stats = heapScheduler.getStatistics();
+    uint32 heapExamined = stats.heapSteps + heapReports;
+
+    printf("Reports configured: %d, simulated time: %d h\n", NUM_REPORTS, SIMULATION_TIME / 3600);
+    printf("  %-12s reports=%-7d wakeups=%-7d entriesExamined=%-9d cpu=%.1f ms\n", "linear scan",
+           linearReports, SIMULATION_TIME, linearScheduler.entriesExamined, linearClocks * 1000.0 / CLOCKS_PER_SEC);
+    printf("  %-12s reports=%-7d wakeups=%-7d entriesExamined=%-9d cpu=%.1f ms\n", "heap",
+           heapReports, heapWakeups, heapExamined, heapClocks * 1000.0 / CLOCKS_PER_SEC);
+    printf("  change reports=%d periodic reports=%d deferred changes=%d ignored changes=%d\n",
+           stats.changeReports, stats.periodicReports, stats.deferredChanges, stats.ignoredChanges);
+
+    bool success = true;
+    if(mismatches != 0 || heapReports != linearReports)
+    {
+        printf("  FAIL: schedulers disagree (%d mismatches)\n", mismatches);
+        success = false;
+    }
+
+    if(heapExamined >= linearScheduler.entriesExamined || heapWakeups >= SIMULATION_TIME)
+    {
+        printf("  FAIL: heap scheduler is not cheaper than the linear scan\n");
+        success = false;
+    }
+
+    return success ? 0 : 1;
+}
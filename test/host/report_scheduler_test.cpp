@@ -0,0 +1,246 @@
+// Tests for the attribute report scheduler: min/max reporting intervals, reportable change, and the heap ordering.
+
+#include <stdio.h>
+
+#include "ReportScheduler.h"
+#include "test_common.h"
+
+static const uint16 ONOFF_CLUSTER = 0x0006;
+static const uint16 TEMPERATURE_CLUSTER = 0x0002;
+
+typedef ReportSchedulerStorage<32> TestScheduler;
+
+// Max intervals for testDeadlineOrder(), each is reported once within a minute
+static uint16 getTestMaxInterval(uint16 attr)
+{
+    return 30 + (attr * 13) % 30;
+}
+
+static void testPeriodicReports()
+{
+    printf("testPeriodicReports\n");
+    TestScheduler scheduler;
+    ReportRecord records[4];
+
+    CHECK(scheduler.configure(2, ONOFF_CLUSTER, 0x0000, 1, 10, 0, 0));
+    CHECK(scheduler.getNumReports() == 1);
+
+    // The current value is reported right after the configuration
+    CHECK(scheduler.getTimeTillNextReport(0) == 1);
+    CHECK(scheduler.takeDueReports(0, records, 4) == 1);
+    CHECK(records[0].endpoint == 2 && records[0].clusterId == ONOFF_CLUSTER && records[0].attributeId == 0x0000);
+
+    // Then every max interval
+    CHECK(scheduler.getTimeTillNextReport(0) == 10000);
+    CHECK(scheduler.takeDueReports(9999, records, 4) == 0);
+    CHECK(scheduler.takeDueReports(10000, records, 4) == 1);
+    CHECK(scheduler.getTimeTillNextReport(10000) == 10000);
+
+    // Late processing (e.g. after sleep) counts the interval from the actual report time
+    CHECK(scheduler.takeDueReports(20500, records, 4) == 1);
+    CHECK(scheduler.getTimeTillNextReport(20500) == 10000);
+    CHECK(scheduler.getStatistics().periodicReports == 2);
+}
+
+static void testMinInterval()
+{
+    printf("testMinInterval\n");
+    TestScheduler scheduler;
+    ReportRecord records[4];
+
+    scheduler.configure(2, ONOFF_CLUSTER, 0x0000, 5, 60, 0, 0);
+    scheduler.takeDueReports(0, records, 4);
+
+    // Change within the min interval waits
+    CHECK(!scheduler.handleChange(2, ONOFF_CLUSTER, 0x0000, 1000));
+    CHECK(!scheduler.handleChange(2, ONOFF_CLUSTER, 0x0000, 2000));
+    CHECK(scheduler.getTimeTillNextReport(2000) == 3000);
+    CHECK(scheduler.takeDueReports(4999, records, 4) == 0);
+    CHECK(scheduler.takeDueReports(5000, records, 4) == 1);
+    CHECK(scheduler.getStatistics().deferredChanges == 1);
+
+    // Change after the min interval goes right away, and restarts the max interval
+    CHECK(scheduler.handleChange(2, ONOFF_CLUSTER, 0x0000, 11000));
+    CHECK(scheduler.getTimeTillNextReport(11000) == 60000);
+    CHECK(scheduler.getStatistics().changeReports == 3);
+}
+
+static void testOnChangeOnly()
+{
+    printf("testOnChangeOnly\n");
+    TestScheduler scheduler;
+    ReportRecord records[4];
+
+    scheduler.configure(2, ONOFF_CLUSTER, 0x0000, 0, REPORT_INTERVAL_NO_PERIODIC, 0, 0);
+    CHECK(scheduler.takeDueReports(0, records, 4) == 1);
+
+    // Nothing to wait for
+    CHECK(scheduler.getTimeTillNextReport(0) == 0);
+    CHECK(scheduler.takeDueReports(100000000, records, 4) == 0);
+    CHECK(scheduler.handleChange(2, ONOFF_CLUSTER, 0x0000, 200000));
+    CHECK(scheduler.getTimeTillNextReport(200000) == 0);
+}
+
+static void testReportableChange()
+{
+    printf("testReportableChange\n");
+    TestScheduler scheduler;
+    ReportRecord records[4];
+
+    // Temperature in 0.01 C, report changes of 0.5 C and more
+    scheduler.configure(1, TEMPERATURE_CLUSTER, 0x0000, 10, 300, 50, 0);
+    // The first value goes with the report that follows the configuration
+    CHECK(scheduler.handleValueChange(1, TEMPERATURE_CLUSTER, 0x0000, 2100, 0));
+    CHECK(scheduler.takeDueReports(0, records, 4) == 0);
+    CHECK(scheduler.getReport(1, TEMPERATURE_CLUSTER, 0x0000)->reportedValue == 2100);
+
+    // Small fluctuations are ignored
+    CHECK(!scheduler.handleValueChange(1, TEMPERATURE_CLUSTER, 0x0000, 2130, 20000));
+    CHECK(!scheduler.handleValueChange(1, TEMPERATURE_CLUSTER, 0x0000, 2060, 30000));
+    CHECK(scheduler.getStatistics().ignoredChanges == 2);
+    CHECK(scheduler.getTimeTillNextReport(30000) == 270000);
+
+    // Significant change in any direction is reported
+    CHECK(scheduler.handleValueChange(1, TEMPERATURE_CLUSTER, 0x0000, 2040, 40000));
+    CHECK(scheduler.getReport(1, TEMPERATURE_CLUSTER, 0x0000)->reportedValue == 2040);
+    CHECK(!scheduler.handleValueChange(1, TEMPERATURE_CLUSTER, 0x0000, 2090, 45000));    // within min interval
+    CHECK(scheduler.takeDueReports(50000, records, 4) == 1);
+    CHECK(scheduler.getReport(1, TEMPERATURE_CLUSTER, 0x0000)->reportedValue == 2090);
+}
+
+static void testReconfigureAndTurnOff()
+{
+    printf("testReconfigureAndTurnOff\n");
+    TestScheduler scheduler;
+    ReportRecord records[4];
+
+    scheduler.configure(2, ONOFF_CLUSTER, 0x0000, 0, 3600, 0, 0);
+    scheduler.takeDueReports(0, records, 4);
+    CHECK(scheduler.getTimeTillNextReport(0) == 3600000);
+
+    // New max interval is applied to the running period
+    CHECK(scheduler.configure(2, ONOFF_CLUSTER, 0x0000, 0, 60, 0, 1000));
+    CHECK(scheduler.getNumReports() == 1);
+    CHECK(scheduler.getTimeTillNextReport(1000) == 59000);
+
+    // Max interval 0xFFFF turns the reporting off
+    CHECK(scheduler.configure(2, ONOFF_CLUSTER, 0x0000, 0, REPORT_INTERVAL_TURNED_OFF, 0, 2000));
+    CHECK(scheduler.getNumReports() == 0);
+    CHECK(!scheduler.isConfigured(2, ONOFF_CLUSTER, 0x0000));
+    CHECK(scheduler.getTimeTillNextReport(2000) == 0);
+
+    // Attributes without configuration are reported on each change
+    CHECK(scheduler.handleChange(2, ONOFF_CLUSTER, 0x0000, 3000));
+}
+
+static void testCapacity()
+{
+    printf("testCapacity\n");
+    ReportSchedulerStorage<4> scheduler;
+
+    for(uint16 i = 0; i < 4; i++)
+        CHECK(scheduler.configure(1, 0x0B05, i, 1, 60, 0, 0));
+
+    CHECK(!scheduler.configure(1, 0x0B05, 100, 1, 60, 0, 0));
+    CHECK(scheduler.configure(1, 0x0B05, 2, 1, 120, 0, 0));     // existing one can be reconfigured
+    CHECK(scheduler.getNumReports() == 4);
+}
+
+static void testConfigurationsRoundTrip()
+{
+    printf("testConfigurationsRoundTrip\n");
+    TestScheduler scheduler;
+    ReportConfig configs[32];
+
+    scheduler.configure(2, ONOFF_CLUSTER, 0x0000, 0, 300, 0, 0);
+    scheduler.configure(1, TEMPERATURE_CLUSTER, 0x0000, 10, 600, 5, 0);
+    for(uint16 i = 0; i < 20; i++)
+        scheduler.configure(1, 0x0B05, 0x0100 + i, 60, 3600, 1, 0);
+
+    // More than the ZCL table would hold survive the store/restore cycle
+    uint8 count = scheduler.getConfigurations(configs, 32);
+    CHECK(count == 22);
+    CHECK(scheduler.getConfigurations(configs, 4) == 4);
+    count = scheduler.getConfigurations(configs, 32);
+
+    TestScheduler restored;
+    for(uint8 i = 0; i < count; i++)
+        CHECK(restored.configure(configs[i].endpoint, configs[i].clusterId, configs[i].attributeId,
+                                 configs[i].minInterval, configs[i].maxInterval, configs[i].reportableChange, 5000));
+
+    CHECK(restored.getNumReports() == 22);
+    const ScheduledReport * report = restored.getReport(1, TEMPERATURE_CLUSTER, 0x0000);
+    CHECK(report && report->minInterval == 10 && report->maxInterval == 600 && report->reportableChange == 5);
+    report = restored.getReport(1, 0x0B05, 0x0113);
+    CHECK(report && report->minInterval == 60 && report->maxInterval == 3600);
+}
+
+static void testDeadlineOrder()
+{
+    printf("testDeadlineOrder\n");
+    TestScheduler scheduler;
+    ReportRecord records[32];
+
+    // Configure in a mixed up order, then remove some to shuffle the heap
+    for(uint16 i = 0; i < 30; i++)
+    {
+        uint16 attr = (i * 7) % 30;
+        scheduler.configure(1 + attr % 3, 0x0B05, attr, 0, getTestMaxInterval(attr), 0, 0);
+    }
+    CHECK(scheduler.takeDueReports(0, records, 32) == 30);
+
+    for(uint16 attr = 0; attr < 30; attr += 4)
+        scheduler.remove(1 + attr % 3, 0x0B05, attr);
+    CHECK(scheduler.getNumReports() == 22);
+
+    for(uint16 attr = 1; attr < 30; attr += 4)
+        CHECK(scheduler.isConfigured(1 + attr % 3, 0x0B05, attr));
+
+    // Reports come in the deadline order, one by one
+    uint32 lastDeadline = 0;
+    uint8 total = 0;
+    for(uint32 now = 0; now <= 60000; now += 1000)
+    {
+        uint8 n = scheduler.takeDueReports(now, records, 32);
+        for(uint8 i = 0; i < n; i++)
+        {
+            uint32 deadline = getTestMaxInterval(records[i].attributeId) * 1000;
+            CHECK(deadline <= now);
+            CHECK(deadline >= lastDeadline);
+            lastDeadline = deadline;
+        }
+        total += n;
+    }
+    CHECK(total == 22);
+}
+
+static void testTimerWraparound()
+{
+    printf("testTimerWraparound\n");
+    TestScheduler scheduler;
+    ReportRecord records[4];
+    uint32 now = 0xfffff000;
+
+    scheduler.configure(2, ONOFF_CLUSTER, 0x0000, 2, 10, 0, now);
+    CHECK(scheduler.takeDueReports(now, records, 4) == 1);
+    CHECK(scheduler.getTimeTillNextReport(now) == 10000);
+    CHECK(scheduler.takeDueReports(now + 9999, records, 4) == 0);
+    CHECK(scheduler.takeDueReports(now + 10000, records, 4) == 1);
+    CHECK(!scheduler.handleChange(2, ONOFF_CLUSTER, 0x0000, now + 11000));
+    CHECK(scheduler.getTimeTillNextReport(now + 11000) == 1000);
+}
+
+int main()
+{
+    testPeriodicReports();
+    testMinInterval();
+    testOnChangeOnly();
+    testReportableChange();
+    testReconfigureAndTurnOff();
+    testCapacity();
+    testConfigurationsRoundTrip();
+    testDeadlineOrder();
+    testTimerWraparound();
+
+    return testResult();
+}
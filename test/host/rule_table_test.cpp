@@ -0,0 +1,146 @@
+// Tests for the automation rule table: parsing, validation, serialization and trigger matching.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "RuleTable.h"
+#include "ButtonHandler.h"
+#include "test_common.h"
+
+static const uint8 CMD_OFF = 0;
+static const uint8 CMD_ON = 1;
+static const uint8 CMD_TOGGLE = 2;
+
+// "Double click left turns off both relays and sends Off to group 5"
+static const uint8 EXAMPLE_RULES[] = {
+    BUTTON_ACTION_DOUBLE, AUTOMATION_ACTION_LOCAL_ONOFF, CMD_OFF, 2, 0x00, 0x00,
+    BUTTON_ACTION_DOUBLE, AUTOMATION_ACTION_LOCAL_ONOFF, CMD_OFF, 3, 0x00, 0x00,
+    BUTTON_ACTION_DOUBLE, AUTOMATION_ACTION_GROUP_ONOFF, CMD_OFF, 0, 0x05, 0x00,
+    BUTTON_ACTION_SINGLE, AUTOMATION_ACTION_LED_EFFECT,  0,       0, 0x01, 0x00,
+};
+
+static void testEmpty()
+{
+    printf("testEmpty\n");
+    RuleTable table;
+    uint8 indexes[RuleTable::MAX_RULES];
+
+    CHECK(table.getNumRules() == 0);
+    CHECK(table.findRules(BUTTON_ACTION_SINGLE, indexes, RuleTable::MAX_RULES) == 0);
+
+    // Empty table is a valid configuration
+    CHECK(table.load(EXAMPLE_RULES, 0));
+    CHECK(table.getNumRules() == 0);
+}
+
+static void testLoadAndMatch()
+{
+    printf("testLoadAndMatch\n");
+    RuleTable table;
+    uint8 indexes[RuleTable::MAX_RULES];
+
+    CHECK(table.load(EXAMPLE_RULES, sizeof(EXAMPLE_RULES)));
+    CHECK(table.getNumRules() == 4);
+
+    // Matching rules are returned in the definition order
+    CHECK(table.findRules(BUTTON_ACTION_DOUBLE, indexes, RuleTable::MAX_RULES) == 3);
+    CHECK(indexes[0] == 0 && indexes[1] == 1 && indexes[2] == 2);
+    CHECK(table.getRule(indexes[1]).targetEndpoint == 3);
+    CHECK(table.getRule(indexes[2]).action == AUTOMATION_ACTION_GROUP_ONOFF);
+    CHECK(table.getRule(indexes[2]).param == 5);
+
+    CHECK(table.findRules(BUTTON_ACTION_SINGLE, indexes, RuleTable::MAX_RULES) == 1);
+    CHECK(indexes[0] == 3);
+    CHECK(table.findRules(BUTTON_ACTION_TRIPPLE, indexes, RuleTable::MAX_RULES) == 0);
+
+    // Output is limited by the caller's buffer
+    CHECK(table.findRules(BUTTON_ACTION_DOUBLE, indexes, 2) == 2);
+}
+
+static void testRoundTrip()
+{
+    printf("testRoundTrip\n");
+    RuleTable table;
+    uint8 data[RuleTable::MAX_SIZE];
+
+    CHECK(table.load(EXAMPLE_RULES, sizeof(EXAMPLE_RULES)));
+    uint8 len = table.store(data, sizeof(data));
+    CHECK(len == sizeof(EXAMPLE_RULES));
+    CHECK(memcmp(data, EXAMPLE_RULES, len) == 0);
+
+    // Param is little endian
+    const uint8 groupRule[] = {BUTTON_PRESSED, AUTOMATION_ACTION_GROUP_ONOFF, CMD_ON, 0, 0x34, 0x12};
+    CHECK(table.load(groupRule, sizeof(groupRule)));
+    CHECK(table.getRule(0).param == 0x1234);
+    CHECK(table.store(data, sizeof(data)) == sizeof(groupRule));
+    CHECK(memcmp(data, groupRule, sizeof(groupRule)) == 0);
+
+    // Not enough room for a whole rule
+    CHECK(table.store(data, RuleTable::RULE_SIZE - 1) == 0);
+}
+
+static void testInvalidRulesRejected()
+{
+    printf("testInvalidRulesRejected\n");
+    RuleTable table;
+    CHECK(table.load(EXAMPLE_RULES, sizeof(EXAMPLE_RULES)));
+
+    const uint8 badTrigger[] = {7, AUTOMATION_ACTION_BOUND_ONOFF, CMD_TOGGLE, 0, 0, 0};
+    const uint8 badAction[] = {BUTTON_ACTION_SINGLE, 9, CMD_TOGGLE, 0, 0, 0};
+    const uint8 badCommand[] = {BUTTON_ACTION_SINGLE, AUTOMATION_ACTION_LOCAL_ONOFF, 0x40, 2, 0, 0};
+    const uint8 badGroup[] = {BUTTON_ACTION_SINGLE, AUTOMATION_ACTION_GROUP_ONOFF, CMD_ON, 0, 0xff, 0xff};
+    const uint8 badEffect[] = {BUTTON_ACTION_SINGLE, AUTOMATION_ACTION_LED_EFFECT, 0, 0, 0x00, 0x01};
+    const uint8 partial[] = {BUTTON_ACTION_SINGLE, AUTOMATION_ACTION_BOUND_ONOFF, CMD_TOGGLE, 0, 0};
+
+    CHECK(!table.load(badTrigger, sizeof(badTrigger)));
+    CHECK(!table.load(badAction, sizeof(badAction)));
+    CHECK(!table.load(badCommand, sizeof(badCommand)));
+    CHECK(!table.load(badGroup, sizeof(badGroup)));
+    CHECK(!table.load(badEffect, sizeof(badEffect)));
+    CHECK(!table.load(partial, sizeof(partial)));
+
+    // A valid rule followed by an invalid one - the whole update is rejected
+    uint8 mixed[2 * RuleTable::RULE_SIZE];
+    memcpy(mixed, EXAMPLE_RULES, RuleTable::RULE_SIZE);
+    memcpy(mixed + RuleTable::RULE_SIZE, badAction, RuleTable::RULE_SIZE);
+    CHECK(!table.load(mixed, sizeof(mixed)));
+
+    // Previous rules are kept
+    CHECK(table.getNumRules() == 4);
+}
+
+static void testCapacity()
+{
+    printf("testCapacity\n");
+    RuleTable table;
+    uint8 data[RuleTable::MAX_SIZE + RuleTable::RULE_SIZE];
+
+    for(uint8 i = 0; i <= RuleTable::MAX_RULES; i++)
+    {
+        uint8 * ptr = data + i * RuleTable::RULE_SIZE;
+        ptr[0] = BUTTON_ACTION_SINGLE;
+        ptr[1] = AUTOMATION_ACTION_BOUND_ONOFF;
+        ptr[2] = CMD_TOGGLE;
+        ptr[3] = 0;
+        ptr[4] = i;
+        ptr[5] = 0;
+    }
+
+    CHECK(table.load(data, RuleTable::MAX_SIZE));
+    CHECK(table.getNumRules() == RuleTable::MAX_RULES);
+    CHECK(!table.load(data, RuleTable::MAX_SIZE + RuleTable::RULE_SIZE));
+
+    table.clear();
+    CHECK(table.getNumRules() == 0);
+}
+
+int main()
+{
+    testEmpty();
+    testLoadAndMatch();
+    testRoundTrip();
+    testInvalidRulesRejected();
+    testCapacity();
+
+    return testResult();
+}
@@ -0,0 +1,196 @@
+// Tests for the compact scene table: scene management, serialization, Add Scene extension field parsing,
+// and the number of frames needed to bring a house to a preset.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SceneTable.h"
+#include "test_common.h"
+
+static void testStoreAndFind()
+{
+    printf("testStoreAndFind\n");
+    SceneTable table;
+    bool onOff;
+
+    CHECK(table.getNumScenes() == 0);
+    CHECK(!table.findScene(1, 1, &onOff));
+
+    CHECK(table.storeScene(0x0001, 1, true));
+    CHECK(table.storeScene(0x0001, 2, false));
+    CHECK(table.storeScene(0x0002, 1, false));
+    CHECK(table.getNumScenes() == 3);
+
+    CHECK(table.findScene(0x0001, 1, &onOff) && onOff);
+    CHECK(table.findScene(0x0001, 2, &onOff) && !onOff);
+    CHECK(table.findScene(0x0002, 1, &onOff) && !onOff);
+    CHECK(!table.findScene(0x0002, 2, &onOff));
+
+    // Storing the same scene again overwrites the state
+    CHECK(table.storeScene(0x0001, 1, false));
+    CHECK(table.getNumScenes() == 3);
+    CHECK(table.findScene(0x0001, 1, &onOff) && !onOff);
+}
+
+static void testCapacity()
+{
+    printf("testCapacity\n");
+    SceneTable table;
+
+    for(uint8 i = 0; i < SceneTable::MAX_SCENES; i++)
+        CHECK(table.storeScene(0x0010, i, i % 2));
+
+    CHECK(!table.storeScene(0x0010, SceneTable::MAX_SCENES, true));
+    CHECK(table.getNumScenes() == SceneTable::MAX_SCENES);
+
+    // Existing scenes can still be updated when the table is full
+    CHECK(table.storeScene(0x0010, 0, true));
+}
+
+static void testRemove()
+{
+    printf("testRemove\n");
+    SceneTable table;
+    bool onOff;
+
+    table.storeScene(0x0001, 1, true);
+    table.storeScene(0x0002, 1, true);
+    table.storeScene(0x0001, 2, true);
+    table.storeScene(0x0001, 3, true);
+
+    CHECK(table.removeScene(0x0002, 1));
+    CHECK(!table.removeScene(0x0002, 1));
+    CHECK(table.getNumScenes() == 3);
+
+    table.storeScene(0x0002, 5, false);
+    CHECK(table.removeGroup(0x0001) == 3);
+    CHECK(table.getNumScenes() == 1);
+    CHECK(table.findScene(0x0002, 5, &onOff) && !onOff);
+    CHECK(table.removeGroup(0x0001) == 0);
+}
+
+static void testSerialization()
+{
+    printf("testSerialization\n");
+    SceneTable table;
+    table.storeScene(0x1234, 7, true);
+    table.storeScene(0x0005, 1, false);
+
+    uint8 data[SceneTable::MAX_SIZE];
+    uint8 len = table.store(data, sizeof(data));
+    CHECK(len == 2 * SceneTable::ENTRY_SIZE);
+
+    const uint8 expected[] = {0x34, 0x12, 7, 1, 0x05, 0x00, 1, 0};
+    CHECK(memcmp(data, expected, sizeof(expected)) == 0);
+
+    SceneTable restored;
+    bool onOff;
+    CHECK(restored.load(data, len));
+    CHECK(restored.getNumScenes() == 2);
+    CHECK(restored.findScene(0x1234, 7, &onOff) && onOff);
+    CHECK(restored.findScene(0x0005, 1, &onOff) && !onOff);
+
+    // Empty record is a valid empty table
+    CHECK(restored.load(data, 0));
+    CHECK(restored.getNumScenes() == 0);
+}
+
+static void testLoadRejectsMalformed()
+{
+    printf("testLoadRejectsMalformed\n");
+    SceneTable table;
+    table.storeScene(0x0001, 1, true);
+
+    const uint8 truncated[] = {0x01, 0x00, 2};
+    const uint8 badState[] = {0x01, 0x00, 2, 5};
+    const uint8 duplicate[] = {0x01, 0x00, 2, 1, 0x01, 0x00, 2, 0};
+
+    CHECK(!table.load(truncated, sizeof(truncated)));
+    CHECK(!table.load(badState, sizeof(badState)));
+    CHECK(!table.load(duplicate, sizeof(duplicate)));
+
+    // The current table survives a malformed record
+    bool onOff;
+    CHECK(table.getNumScenes() == 1);
+    CHECK(table.findScene(0x0001, 1, &onOff) && onOff);
+}
+
+static void testParseOnOffExtension()
+{
+    printf("testParseOnOffExtension\n");
+    bool onOff = false;
+
+    const uint8 onOffOnly[] = {0x06, 0x00, 1, 0x01};
+    CHECK(SceneTable::parseOnOffExtension(onOffOnly, sizeof(onOffOnly), &onOff) && onOff);
+
+    // Level Control field set goes first and is skipped
+    const uint8 levelAndOnOff[] = {0x08, 0x00, 1, 0x80, 0x06, 0x00, 1, 0x00};
+    onOff = true;
+    CHECK(SceneTable::parseOnOffExtension(levelAndOnOff, sizeof(levelAndOnOff), &onOff) && !onOff);
+
+    const uint8 levelOnly[] = {0x08, 0x00, 1, 0x80};
+    CHECK(!SceneTable::parseOnOffExtension(levelOnly, sizeof(levelOnly), &onOff));
+
+    const uint8 truncated[] = {0x08, 0x00, 5, 0x80, 0x06};
+    CHECK(!SceneTable::parseOnOffExtension(truncated, sizeof(truncated), &onOff));
+
+    CHECK(!SceneTable::parseOnOffExtension(NULL, 0, &onOff));
+}
+
+static void testHouseOffFrames()
+{
+    printf("testHouseOffFrames\n");
+
+    // 6 two-gang switches and 4 single relays, each relay endpoint is a member of the 'house' group.
+    // The 'night' preset keeps two hallway relays on and switches everything else off.
+    const uint16 HOUSE_GROUP = 0x0100;
+    const uint8 HOUSE_OFF = 1;
+    const uint8 NIGHT = 2;
+    const uint8 NUM_ENDPOINTS = 6 * 2 + 4;
+
+    SceneTable endpoints[NUM_ENDPOINTS];
+    bool state[NUM_ENDPOINTS];
+    for(uint8 i = 0; i < NUM_ENDPOINTS; i++)
+    {
+        endpoints[i].storeScene(HOUSE_GROUP, HOUSE_OFF, false);
+        endpoints[i].storeScene(HOUSE_GROUP, NIGHT, i < 2);
+        state[i] = true;
+    }
+
+    // Without scenes a mixed preset takes one unicast On/Off per endpoint (each also acknowledged on APS level)
+    uint32 unicastFrames = 2 * NUM_ENDPOINTS;
+
+    // With scenes a single groupcast Recall Scene reaches every member
+    uint32 sceneFrames = 1;
+    bool allApplied = true;
+    for(uint8 i = 0; i < NUM_ENDPOINTS; i++)
+    {
+        allApplied &= endpoints[i].findScene(HOUSE_GROUP, NIGHT, &state[i]);
+        allApplied &= (state[i] == (i < 2));
+    }
+
+    printf("  'night' preset for %d endpoints: %d frames with unicasts, %d frame with a scene recall\n",
+           NUM_ENDPOINTS, unicastFrames, sceneFrames);
+    CHECK(allApplied);
+
+    for(uint8 i = 0; i < NUM_ENDPOINTS; i++)
+        allApplied &= endpoints[i].findScene(HOUSE_GROUP, HOUSE_OFF, &state[i]) && !state[i];
+
+    printf("  'house off' for %d endpoints: %d frames with unicasts, %d frame with a scene recall\n",
+           NUM_ENDPOINTS, unicastFrames, sceneFrames);
+    CHECK(allApplied);
+    CHECK(sceneFrames < unicastFrames);
+}
+
+int main()
+{
+    testStoreAndFind();
+    testCapacity();
+    testRemove();
+    testSerialization();
+    testLoadRejectsMalformed();
+    testParseOnOffExtension();
+    testHouseOffFrames();
+
+    return testResult();
+}
@@ -0,0 +1,66 @@
+// A small program shaped like the firmware, for checking scripts/StackUsage/stack_usage.py on a host build.
+//
+// The deepest main loop chain goes through a function pointer callback and a virtual method, which the analysis can
+// only follow with the stack_usage_sample.calls map: main -> dispatchEvent -> (callback) handleZclEvent ->
+// (virtual) SampleEndpoint::handleEvent -> formatMessage. The interrupt handler has its own, shorter chain.
+
+#include <stdio.h>
+#include <string.h>
+
+class SampleEndpointBase
+{
+public:
+    virtual int handleEvent(int event) = 0;
+};
+
+static int formatMessage(const char * prefix, int value)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s %d", prefix, value);
+    return (int)strlen(buf);
+}
+
+class SampleEndpoint : public SampleEndpointBase
+{
+public:
+    virtual int handleEvent(int event)
+    {
+        volatile char scratch[64];
+        scratch[0] = (char)event;
+        return formatMessage("event", scratch[0]);
+    }
+};
+
+static SampleEndpointBase * registry[2];
+
+int handleZclEvent(int event)
+{
+    return registry[event & 1]->handleEvent(event);
+}
+
+typedef int (*EventCallback)(int event);
+
+int dispatchEvent(EventCallback callback, int event)
+{
+    volatile char frame[32];
+    frame[0] = (char)event;
+    return callback(frame[0]);
+}
+
+extern "C" int sampleIsr(int value)
+{
+    volatile char regs[16];
+    regs[0] = (char)value;
+    return regs[0];
+}
+
+int main(int argc, char **)
+{
+    SampleEndpoint endpoint;
+    registry[0] = &endpoint;
+    registry[1] = &endpoint;
+
+    int res = dispatchEvent(handleZclEvent, argc);
+    res += sampleIsr(argc);
+    return res == 0;
+}
@@ -0,0 +1,30 @@
+// Minimal replacement of the NXP SDK jendefs.h, so that platform independent parts of the firmware
+// can be compiled and tested on the host machine
+
+#ifndef JENDEFS_H_HOST_STUB
+#define JENDEFS_H_HOST_STUB
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t     uint8;
+typedef uint16_t    uint16;
+typedef uint32_t    uint32;
+typedef uint64_t    uint64;
+typedef int8_t      int8;
+typedef int16_t     int16;
+typedef int32_t     int32;
+typedef int64_t     int64;
+typedef uint8_t     bool_t;
+
+#ifndef TRUE
+#define TRUE        (1)
+#endif
+#ifndef FALSE
+#define FALSE       (0)
+#endif
+
+#define PUBLIC
+#define PRIVATE     static
+
+#endif // JENDEFS_H_HOST_STUB
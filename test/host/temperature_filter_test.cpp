@@ -0,0 +1,154 @@
+// Tests for the fixed-point temperature conversion, smoothing, and threshold checks.
+
+#include <stdio.h>
+#include <math.h>
+
+#include "TemperatureFilter.h"
+#include "test_common.h"
+
+// The conversion formula used before, with floats
+static double convertWithFloats(uint16 rawValue)
+{
+    double mV = (double)rawValue * 1.2 / 1024 * 1000;
+    return (mV - 720.) / (-1.66) + 25;
+}
+
+// Raw ADC value that corresponds to the given temperature
+static uint16 rawForTemperature(double temperature)
+{
+    double mV = 720. - 1.66 * (temperature - 25);
+    return (uint16)(mV * 1024 / 1200 + 0.5);
+}
+
+static void testConversionMatchesFloats()
+{
+    printf("testConversionMatchesFloats\n");
+
+    // The whole ADC range, the fixed-point result shall be within 1/256 degree of the float one
+    double maxError = 0;
+    for(uint32 raw = 0; raw < 1024; raw++)
+    {
+        double expected = convertWithFloats(raw);
+        double actual = TemperatureFilter::convertRawValue(raw) / 256.;
+        double error = fabs(actual - expected);
+        if(error > maxError)
+            maxError = error;
+    }
+
+    printf("  max conversion error %.4f degrees\n", maxError);
+    CHECK(maxError < 1. / 256);
+
+    // Reference points of the sensor
+    CHECK(TemperatureFilter::roundQ8(TemperatureFilter::convertRawValue(rawForTemperature(25))) == 25);
+    CHECK(TemperatureFilter::roundQ8(TemperatureFilter::convertRawValue(rawForTemperature(85))) == 85);
+    CHECK(TemperatureFilter::roundQ8(TemperatureFilter::convertRawValue(rawForTemperature(-20))) == -20);
+}
+
+static void testRounding()
+{
+    printf("testRounding\n");
+    CHECK(TemperatureFilter::roundQ8(0) == 0);
+    CHECK(TemperatureFilter::roundQ8(127) == 0);
+    CHECK(TemperatureFilter::roundQ8(128) == 1);
+    CHECK(TemperatureFilter::roundQ8(25 * 256 + 200) == 26);
+    CHECK(TemperatureFilter::roundQ8(-127) == 0);
+    CHECK(TemperatureFilter::roundQ8(-128) == -1);
+    CHECK(TemperatureFilter::roundQ8(-10 * 256 - 100) == -10);
+}
+
+static void testFirstSampleTakenAsIs()
+{
+    printf("testFirstSampleTakenAsIs\n");
+    TemperatureFilter filter;
+    CHECK(!filter.hasTemperature());
+
+    filter.addTemperature(31 * 256);
+    CHECK(filter.hasTemperature());
+    CHECK(filter.getTemperature() == 31);
+    CHECK(filter.getMinTemperature() == 31);
+    CHECK(filter.getMaxTemperature() == 31);
+}
+
+static void testSmoothing()
+{
+    printf("testSmoothing\n");
+    TemperatureFilter filter;
+    filter.addTemperature(20 * 256);
+
+    // A single spike moves the average by 1/4 of its size only
+    filter.addTemperature(32 * 256);
+    CHECK(filter.getTemperature() == 23);
+
+    // Step change converges in a few samples
+    int samples = 0;
+    while(filter.getTemperature() != 32 && samples < 100)
+    {
+        filter.addTemperature(32 * 256);
+        samples++;
+    }
+    printf("  step response settled in %d samples\n", samples + 1);
+    CHECK(samples < 20);
+    CHECK(filter.getMinTemperature() == 20);
+    CHECK(filter.getMaxTemperature() == 32);
+
+    // Noise of +/- 1 ADC LSB (~0.7 degree) does not change the rounded value
+    TemperatureFilter noisy;
+    uint16 raw = rawForTemperature(40.2);
+    int16 first = 0;
+    bool stable = true;
+    for(int i = 0; i < 100; i++)
+    {
+        noisy.addSample(raw + (i % 3) - 1);
+        if(i == 10)
+            first = noisy.getTemperature();
+        if(i > 10 && noisy.getTemperature() != first)
+            stable = false;
+    }
+    CHECK(stable);
+}
+
+static void testNoSmoothing()
+{
+    printf("testNoSmoothing\n");
+    TemperatureFilter filter;
+    filter.setSmoothing(0);
+    filter.addTemperature(20 * 256);
+    filter.addTemperature(-5 * 256);
+    CHECK(filter.getTemperature() == -5);
+    CHECK(filter.getMinTemperature() == -5);
+    CHECK(filter.getMaxTemperature() == 20);
+}
+
+static void testAlarmState()
+{
+    printf("testAlarmState\n");
+    TemperatureFilter filter;
+    CHECK(filter.getAlarmState(0, 50, TEMPERATURE_ALARM_TOO_LOW | TEMPERATURE_ALARM_TOO_HIGH) == 0);
+
+    filter.setSmoothing(0);
+    filter.addTemperature(60 * 256);
+
+    // Alarms are raised only if enabled in the mask
+    CHECK(filter.getAlarmState(0, 50, 0) == 0);
+    CHECK(filter.getAlarmState(0, 50, TEMPERATURE_ALARM_TOO_LOW) == 0);
+    CHECK(filter.getAlarmState(0, 50, TEMPERATURE_ALARM_TOO_HIGH) == TEMPERATURE_ALARM_TOO_HIGH);
+
+    // Threshold itself is not an alarm yet
+    CHECK(filter.getAlarmState(0, 60, TEMPERATURE_ALARM_TOO_HIGH) == 0);
+
+    filter.addTemperature(-3 * 256);
+    CHECK(filter.getAlarmState(0, 50, TEMPERATURE_ALARM_TOO_LOW | TEMPERATURE_ALARM_TOO_HIGH) == TEMPERATURE_ALARM_TOO_LOW);
+    CHECK(filter.getAlarmState(-3, 50, TEMPERATURE_ALARM_TOO_LOW) == 0);
+}
+
+int main()
+{
+    testConversionMatchesFloats();
+    testRounding();
+    testFirstSampleTakenAsIs();
+    testSmoothing();
+    testNoSmoothing();
+    testAlarmState();
+
+    return testResult();
+}
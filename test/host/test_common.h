@@ -0,0 +1,28 @@
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+// Minimal check harness shared by the host tests.
+//
+// A failed CHECK() prints the condition and lets the test go on, so that a single run shows all the failures.
+// testResult() prints the summary and gives the exit code of the test, which is non-zero if any of the checks failed.
+
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) \
+        { \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while(0)
+
+static inline int testResult()
+{
+    printf(failures ? "%d check(s) failed\n" : "All checks passed\n", failures);
+    return failures ? 1 : 0;
+}
+
+#endif // TEST_COMMON_H
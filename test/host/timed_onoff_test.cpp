@@ -0,0 +1,331 @@
+// Countdown semantics of the On With Timed Off command (OnTime/OffWaitTime attributes of the On/Off cluster).
+
+#include <stdio.h>
+
+#include "TimedOnOff.h"
+#include "test_common.h"
+
+// Mimics the firmware: applies the requested action to the switch state, and reports every state change
+// back as the On/Off state change path does
+static void apply(TimedOnOff & timer, bool & state, TimedOnOffAction action, uint32 now)
+{
+    bool previousState = state;
+    if(action == TIMED_ONOFF_SWITCH_ON)
+        state = true;
+    if(action == TIMED_ONOFF_SWITCH_OFF)
+        state = false;
+    if(action != TIMED_ONOFF_NONE)
+        timer.handleStateChange(previousState, state, now);
+}
+
+static void testIdleByDefault()
+{
+    printf("testIdleByDefault\n");
+    TimedOnOff timer;
+
+    CHECK(timer.getOnTime() == 0);
+    CHECK(timer.getOffWaitTime() == 0);
+    CHECK(!timer.isCounting(true));
+    CHECK(!timer.isCounting(false));
+    CHECK(timer.update(true, 100000) == TIMED_ONOFF_NONE);
+    CHECK(timer.getTimeTillNextChange(true, 100000) == 0);
+}
+
+static void testTimedOn()
+{
+    printf("testTimedOn\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 1000;
+
+    // On for 5 s, then 2 s off wait
+    apply(timer, state, timer.handleOnWithTimedOff(state, false, 50, 20, now), now);
+    CHECK(state);
+    CHECK(timer.getOnTime() == 50);
+    CHECK(timer.isCounting(state));
+    CHECK(timer.getTimeTillNextChange(state, now) == 5000);
+    CHECK(timer.getTimeTillNextChange(state, now + 1000) == 4000);
+
+    now += 2050;
+    CHECK(timer.update(state, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOnTime() == 30);
+    CHECK(timer.getTimeTillNextChange(state, now) == 2950);
+    CHECK(timer.getTimeTillNextChange(state, now + 10000) == 1);     // overdue, but still counting
+
+    now += 2949;
+    CHECK(timer.update(state, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOnTime() == 1);
+
+    now += 1;
+    apply(timer, state, timer.update(state, now), now);
+    CHECK(!state);
+    CHECK(timer.getOnTime() == 0);
+
+    // The off wait period follows the on period
+    CHECK(timer.getOffWaitTime() == 20);
+    CHECK(timer.isCounting(state));
+    CHECK(timer.getTimeTillNextChange(state, now) == 2000);
+
+    now += 2000;
+    CHECK(timer.update(state, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOffWaitTime() == 0);
+    CHECK(!timer.isCounting(state));
+}
+
+static void testLowRateUpdates()
+{
+    printf("testLowRateUpdates\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 0;
+
+    // Updating once per 1.3 s must not lose the fractions of a tenth
+    apply(timer, state, timer.handleOnWithTimedOff(state, false, 100, 0, now), now);
+    uint32 switchOffTime = 0;
+    for(int i = 0; i < 20 && state; i++)
+    {
+        now += 1300;
+        apply(timer, state, timer.update(state, now), now);
+        if(!state)
+            switchOffTime = now;
+    }
+
+    CHECK(!state);
+    CHECK(switchOffTime == 10400);     // first update after 10 s
+}
+
+static void testUpdateAfterSleep()
+{
+    printf("testUpdateAfterSleep\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 0;
+
+    // No updates while sleeping past the on period, the time beyond it counts towards the off wait
+    apply(timer, state, timer.handleOnWithTimedOff(state, false, 30, 20, now), now);
+    now += 4000;
+    apply(timer, state, timer.update(state, now), now);
+    CHECK(!state);
+    CHECK(timer.getOnTime() == 0);
+    CHECK(timer.getOffWaitTime() == 10);
+    CHECK(timer.getTimeTillNextChange(state, now) == 1000);
+
+    // Sleeping past both periods
+    TimedOnOff timer2;
+    state = false;
+    now = 0;
+    apply(timer2, state, timer2.handleOnWithTimedOff(state, false, 30, 20, now), now);
+    now += 60000;
+    apply(timer2, state, timer2.update(state, now), now);
+    CHECK(!state);
+    CHECK(timer2.getOnTime() == 0);
+    CHECK(timer2.getOffWaitTime() == 0);
+    CHECK(!timer2.isCounting(state));
+}
+
+static void testOnTimeIsNotShortened()
+{
+    printf("testOnTimeIsNotShortened\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 0;
+
+    apply(timer, state, timer.handleOnWithTimedOff(state, false, 600, 0, now), now);
+    now += 1000;
+    CHECK(timer.handleOnWithTimedOff(state, false, 50, 0, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOnTime() == 590);
+
+    // ... but can be extended
+    CHECK(timer.handleOnWithTimedOff(state, false, 1200, 0, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOnTime() == 1200);
+}
+
+static void testOffWaitGuard()
+{
+    printf("testOffWaitGuard\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 0;
+
+    // On for 10 s, with 5 s guard period after switching off
+    apply(timer, state, timer.handleOnWithTimedOff(state, false, 100, 50, now), now);
+
+    // Off command switches the device off before the timeout, the guard period starts
+    now += 3000;
+    state = false;
+    timer.handleStateChange(true, state, now);
+    CHECK(timer.getOnTime() == 0);
+    CHECK(timer.getOffWaitTime() == 50);
+    CHECK(timer.isCounting(state));
+
+    // The command is ignored during the guard period, but may shorten it
+    now += 1000;
+    CHECK(timer.handleOnWithTimedOff(state, false, 100, 60, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOffWaitTime() == 40);
+    CHECK(timer.handleOnWithTimedOff(state, false, 100, 10, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOffWaitTime() == 10);
+
+    // After the guard period the command works again
+    now += 1000;
+    CHECK(timer.update(state, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOffWaitTime() == 0);
+    CHECK(!timer.isCounting(state));
+    CHECK(timer.handleOnWithTimedOff(state, false, 100, 0, now) == TIMED_ONOFF_SWITCH_ON);
+}
+
+static void testAcceptOnlyWhenOn()
+{
+    printf("testAcceptOnlyWhenOn\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 0;
+
+    CHECK(timer.handleOnWithTimedOff(state, true, 100, 0, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOnTime() == 0);
+
+    // When the device is on, the command just schedules the switch off
+    state = true;
+    timer.handleStateChange(false, state, now);
+    CHECK(timer.handleOnWithTimedOff(state, true, 100, 0, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOnTime() == 100);
+    CHECK(timer.isCounting(state));
+}
+
+static void testAcceptOnlyWhenOnDuringOffWait()
+{
+    printf("testAcceptOnlyWhenOnDuringOffWait\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 0;
+
+    // On for 3 s with 5 s guard, the on period runs out
+    apply(timer, state, timer.handleOnWithTimedOff(state, false, 30, 50, now), now);
+    now += 3000;
+    apply(timer, state, timer.update(state, now), now);
+    CHECK(!state);
+    CHECK(timer.getOffWaitTime() == 50);
+
+    // A command accepted only when on is ignored during the off wait, and does not touch the guard
+    now += 1000;
+    CHECK(timer.handleOnWithTimedOff(state, true, 100, 0, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOnTime() == 0);
+    CHECK(timer.getOffWaitTime() == 40);
+
+    // So is the unconditional one, as long as the guard runs
+    CHECK(timer.handleOnWithTimedOff(state, false, 100, 60, now) == TIMED_ONOFF_NONE);
+    CHECK(!state);
+    CHECK(timer.getOffWaitTime() == 40);
+}
+
+static void testRegularOnCancelsGuard()
+{
+    printf("testRegularOnCancelsGuard\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 0;
+
+    apply(timer, state, timer.handleOnWithTimedOff(state, false, 100, 50, now), now);
+    state = false;
+    timer.handleStateChange(true, state, now + 100);
+    CHECK(timer.getOffWaitTime() == 50);
+
+    // Regular On (e.g. the button) clears the guard, and the device stays on with no timeout
+    state = true;
+    timer.handleStateChange(false, state, now + 200);
+    CHECK(timer.getOnTime() == 0);
+    CHECK(timer.getOffWaitTime() == 0);
+    CHECK(!timer.isCounting(state));
+    CHECK(timer.update(state, now + 100000) == TIMED_ONOFF_NONE);
+}
+
+static void testRegularOnKeepsRunningOnTime()
+{
+    printf("testRegularOnKeepsRunningOnTime\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 0;
+
+    // On for 10 s, then a regular On command comes 4 s later while the device is still on
+    apply(timer, state, timer.handleOnWithTimedOff(state, false, 100, 0, now), now);
+    now += 4000;
+    timer.handleStateChange(state, true, now);
+
+    // The time already spent on is not lost, the device still switches off 10 s after the timed on
+    CHECK(timer.getOnTime() == 60);
+    CHECK(timer.getTimeTillNextChange(state, now) == 6000);
+    now += 6000;
+    CHECK(timer.update(state, now) == TIMED_ONOFF_SWITCH_OFF);
+}
+
+static void testInfiniteValues()
+{
+    printf("testInfiniteValues\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 0;
+
+    // 0xFFFF in any of the values means no countdown
+    apply(timer, state, timer.handleOnWithTimedOff(state, false, TimedOnOff::NO_COUNTDOWN, 0, now), now);
+    CHECK(state);
+    CHECK(!timer.isCounting(state));
+    CHECK(timer.update(state, now + 10000000) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOnTime() == TimedOnOff::NO_COUNTDOWN);
+
+    TimedOnOff timer2;
+    state = false;
+    apply(timer2, state, timer2.handleOnWithTimedOff(state, false, 50, TimedOnOff::NO_COUNTDOWN, now), now);
+    CHECK(state);
+    CHECK(!timer2.isCounting(state));
+    CHECK(timer2.update(state, now + 10000) == TIMED_ONOFF_NONE);
+    CHECK(timer2.getOnTime() == 50);
+}
+
+static void testAttributeWrite()
+{
+    printf("testAttributeWrite\n");
+    TimedOnOff timer;
+    bool state = true;
+    uint32 now = 50000;
+
+    // Writing OnTime while on starts the countdown from the moment of the write
+    timer.setOnTime(20, now);
+    CHECK(timer.isCounting(state));
+    now += 1999;
+    CHECK(timer.update(state, now) == TIMED_ONOFF_NONE);
+    now += 1;
+    CHECK(timer.update(state, now) == TIMED_ONOFF_SWITCH_OFF);
+}
+
+static void testTimerWraparound()
+{
+    printf("testTimerWraparound\n");
+    TimedOnOff timer;
+    bool state = false;
+    uint32 now = 0xffffff00;
+
+    apply(timer, state, timer.handleOnWithTimedOff(state, false, 10, 0, now), now);
+    now += 999;     // wrapped
+    CHECK(timer.update(state, now) == TIMED_ONOFF_NONE);
+    CHECK(timer.getOnTime() == 1);
+    now += 1;
+    CHECK(timer.update(state, now) == TIMED_ONOFF_SWITCH_OFF);
+}
+
+int main()
+{
+    testIdleByDefault();
+    testTimedOn();
+    testLowRateUpdates();
+    testUpdateAfterSleep();
+    testOnTimeIsNotShortened();
+    testOffWaitGuard();
+    testAcceptOnlyWhenOn();
+    testAcceptOnlyWhenOnDuringOffWait();
+    testRegularOnCancelsGuard();
+    testRegularOnKeepsRunningOnTime();
+    testInfiniteValues();
+    testAttributeWrite();
+    testTimerWraparound();
+
+    return testResult();
+}
@@ -0,0 +1,207 @@
+// Tests for the ZCL 100 ms / 1 s timebase, including late timer callbacks and sleep gaps.
+
+#include <stdio.h>
+
+#include "ZCLTimebase.h"
+#include "test_common.h"
+
+// Simple LCG, so that the test is reproducible
+static uint32 randomState = 1;
+static uint32 random(uint32 range)
+{
+    randomState = randomState * 1103515245 + 12345;
+    return (randomState >> 8) % range;
+}
+
+// Runs the timebase as the firmware does: the timer is started with the time till the next tick, and fires
+// up to maxDelay ms late
+static void runTimer(ZCLTimebase & timebase, uint32 & now, uint32 end, uint32 maxDelay)
+{
+    while((int32)(end - now) > 0)
+    {
+        now += timebase.getTimeTillNextTick(now) + (maxDelay ? random(maxDelay + 1) : 0);
+        timebase.update(now);
+    }
+}
+
+static void testNotStarted()
+{
+    printf("testNotStarted\n");
+    ZCLTimebase timebase;
+
+    ZCLTimebaseTicks ticks = timebase.update(100000);
+    CHECK(ticks.ticks100ms == 0);
+    CHECK(ticks.ticks1s == 0);
+    CHECK(timebase.getTimeTillNextTick(0) == 0);
+    CHECK(timebase.getStatistics().updates == 0);
+}
+
+static void testInitialDelay()
+{
+    printf("testInitialDelay\n");
+    ZCLTimebase timebase;
+    timebase.start(500, 1000);
+
+    CHECK(timebase.getTimeTillNextTick(500) == 1100);
+    CHECK(timebase.update(1599).ticks100ms == 0);
+
+    ZCLTimebaseTicks ticks = timebase.update(1600);
+    CHECK(ticks.ticks100ms == 1);
+    CHECK(ticks.ticks1s == 0);
+    CHECK(timebase.getTimeTillNextTick(1600) == 100);
+
+    // 1 s tick comes along with the 10th 100 ms tick
+    uint32 now = 1600;
+    for(int i = 0; i < 9; i++)
+    {
+        now += timebase.getTimeTillNextTick(now);
+        ticks = timebase.update(now);
+        CHECK(ticks.ticks100ms == 1);
+        CHECK(ticks.ticks1s == (i == 8 ? 1 : 0));
+    }
+    CHECK(now == 2500);
+}
+
+static void testNoDriftWithLateCallbacks()
+{
+    printf("testNoDriftWithLateCallbacks\n");
+    ZCLTimebase timebase;
+    uint32 now = 0;
+    timebase.start(now, 0);
+
+    // An hour of timer callbacks that are up to 30 ms late each. A timer restarted from the callback would
+    // lose ~15% of the ticks this way.
+    runTimer(timebase, now, 3600 * 1000, 30);
+    uint32 expected100ms = now / 100;
+    uint32 expected1s = now / 1000;
+
+    const ZCLTimebaseStatistics & stats = timebase.getStatistics();
+    printf("  %d updates, %d/%d 100ms ticks, %d/%d 1s ticks, max lateness %d ms\n",
+           stats.updates, stats.ticks100ms, expected100ms, stats.ticks1s, expected1s, stats.maxLateness);
+
+    CHECK(stats.ticks100ms == expected100ms);
+    CHECK(stats.ticks1s == expected1s);
+    CHECK(stats.replayed100ms == 0);
+    CHECK(stats.dropped100ms == 0);
+    CHECK(stats.maxLateness <= 30);
+
+    // The timer wakes up only at 100 ms deadlines, rather than every 10 ms
+    CHECK(stats.updates == expected100ms);
+}
+
+static void testSleepGapReplayed()
+{
+    printf("testSleepGapReplayed\n");
+    ZCLTimebase timebase;
+    uint32 now = 0;
+    timebase.start(now, 0);
+    runTimer(timebase, now, 1000, 0);
+    CHECK(now == 1000);
+
+    // Device sleeps for 7.35 s, and the timer did not tick meanwhile
+    now += 7350;
+    ZCLTimebaseTicks ticks = timebase.update(now);
+    CHECK(ticks.ticks100ms == 73);
+    CHECK(ticks.ticks1s == 7);
+    CHECK(timebase.getStatistics().replayed100ms == 72);
+    CHECK(timebase.getStatistics().replayed1s == 6);
+
+    // The phase is preserved: the next tick is at the next 100 ms boundary
+    CHECK(timebase.getTimeTillNextTick(now) == 50);
+    CHECK(timebase.update(now + 49).ticks100ms == 0);
+    ticks = timebase.update(now + 50);
+    CHECK(ticks.ticks100ms == 1);
+    CHECK(ticks.ticks1s == 0);
+    CHECK(timebase.getStatistics().ticks1s == 8);
+    CHECK(timebase.getStatistics().ticks100ms == 84);
+}
+
+static void testEndDeviceSleepCycle()
+{
+    printf("testEndDeviceSleepCycle\n");
+    ZCLTimebase timebase;
+    uint32 now = 0;
+    timebase.start(now, 0);
+
+    // End device is awake for a while, then sleeps for a random time, for 24 hours. No tick is lost, however
+    // long the device sleeps, as long as the gaps fit into the replay limits.
+    const uint32 END = 24 * 3600 * 1000;
+    while((int32)(END - now) > 0)
+    {
+        runTimer(timebase, now, now + 200 + random(300), 5);
+        now += 1000 + random(60000);
+        timebase.update(now);
+    }
+
+    const ZCLTimebaseStatistics & stats = timebase.getStatistics();
+    printf("  %d updates, %d 100ms ticks (replayed %d), %d 1s ticks (replayed %d)\n",
+           stats.updates, stats.ticks100ms, stats.replayed100ms, stats.ticks1s, stats.replayed1s);
+
+    CHECK(stats.ticks1s == now / 1000);
+    CHECK(stats.dropped1s == 0);
+    CHECK(stats.replayed1s > 0);
+    CHECK(stats.ticks100ms + stats.dropped100ms == now / 100);
+}
+
+static void testLongGapLimited()
+{
+    printf("testLongGapLimited\n");
+    ZCLTimebase timebase;
+    timebase.configure(10, 5);
+    uint32 now = 0;
+    timebase.start(now, 0);
+
+    // 60.05 s gap: 600 x 100 ms and 60 x 1 s ticks are due, only the latest are delivered
+    now = 60050;
+    ZCLTimebaseTicks ticks = timebase.update(now);
+    CHECK(ticks.ticks100ms == 10);
+    CHECK(ticks.ticks1s == 5);
+    CHECK(timebase.getStatistics().dropped100ms == 590);
+    CHECK(timebase.getStatistics().dropped1s == 55);
+
+    // Dropping does not shift the phase
+    CHECK(timebase.getTimeTillNextTick(now) == 50);
+    now += 950;
+    ticks = timebase.update(now);
+    CHECK(ticks.ticks100ms == 10);
+    CHECK(ticks.ticks1s == 1);
+}
+
+static void testOverdueTick()
+{
+    printf("testOverdueTick\n");
+    ZCLTimebase timebase;
+    timebase.start(0, 0);
+
+    // Overdue tick is still a tick to wait for
+    CHECK(timebase.getTimeTillNextTick(100) == 1);
+    CHECK(timebase.getTimeTillNextTick(5000) == 1);
+}
+
+static void testTimerWraparound()
+{
+    printf("testTimerWraparound\n");
+    ZCLTimebase timebase;
+    uint32 now = 0xffffff00;
+    timebase.start(now, 0);
+
+    runTimer(timebase, now, 0xffffff00 + 2000, 7);
+    CHECK(now < 0xffffff00);       // wrapped
+    CHECK(timebase.getStatistics().ticks100ms == 20);
+    CHECK(timebase.getStatistics().ticks1s == 2);
+    CHECK(timebase.getStatistics().replayed100ms == 0);
+}
+
+int main()
+{
+    testNotStarted();
+    testInitialDelay();
+    testNoDriftWithLateCallbacks();
+    testSleepGapReplayed();
+    testEndDeviceSleepCycle();
+    testLongGapLimited();
+    testOverdueTick();
+    testTimerWraparound();
+
+    return testResult();
+}
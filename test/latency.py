@@ -0,0 +1,78 @@
+import time
+
+from zigbee import *
+
+class LatencyProbe:
+    """
+    Round trip time measurement helper
+
+    Sends echo requests to the Latency Probe cluster of the device via zigbee2mqtt, and collects responses. Each
+    response carries the time the request spent in the device, so that the network part of the round trip time can be
+    separated from the device processing time.
+    """
+
+    def __init__(self, zigbee, z2m_name):
+        self.zigbee = zigbee
+        self.z2m_name = z2m_name
+        self.sequence = int(time.time()) & 0xffff0000
+
+
+    def probe(self, payload_size=8, timeout=5):
+        # Send a single echo request, and wait for the response with the same sequence number.
+        # Returns None if the response did not come in time.
+        self.sequence = (self.sequence + 1) & 0xffffffff
+        self.zigbee.subscribe(self.z2m_name)
+        self.zigbee.publish(self.z2m_name + '/set', {"latency_probe": {"sequence": self.sequence, "payload_size": payload_size}})
+
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            try:
+                msg = self.zigbee.wait_msg(self.z2m_name, timeout=max(deadline - time.time(), 0.1))
+            except TimeoutError:
+                break
+
+            # Device state messages carry the latest probe result, wait for the one we have sent
+            result = msg.get('latency_probe')
+            if result and result['sequence'] == self.sequence:
+                return result
+
+        return None
+
+
+    def measure(self, count=50, payload_size=8, interval=0.2):
+        # Send a series of probes, and calculate RTT percentiles
+        results = []
+        lost = 0
+        for i in range(count):
+            result = self.probe(payload_size)
+            if result:
+                results.append(result)
+            else:
+                lost += 1
+            time.sleep(interval)
+
+        return {
+            "sent": count,
+            "lost": lost,
+            "corrupted": sum(1 for r in results if not r['payload_ok']),
+            "rtt_ms": percentiles([r['rtt_ms'] for r in results]),
+            "network_ms": percentiles([r['network_ms'] for r in results]),
+            "device_ms": percentiles([r['device_ms'] for r in results]),
+            "max_backlog": max((r['backlog'] for r in results), default=0),
+        }
+
+
+def percentiles(values, points=(50, 90, 99)):
+    # Nearest-rank percentiles, good enough for tens or hundreds of samples
+    if not values:
+        return {}
+
+    values = sorted(values)
+    result = {f"p{p}": values[min(len(values) - 1, (len(values) * p + 99) // 100 - 1)] for p in points}
+    result["max"] = values[-1]
+    return result
+
+
+def measure_mesh(zigbee, device_names, count=50, payload_size=8):
+    # Probe several devices one after another, so that routes of different length can be compared
+    return {name: LatencyProbe(zigbee, name).measure(count, payload_size) for name in device_names}
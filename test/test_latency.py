@@ -0,0 +1,22 @@
+import pytest
+
+from latency import *
+
+def test_latency_probe_echo(zigbee, device_name):
+    probe = LatencyProbe(zigbee, device_name)
+    result = probe.probe(payload_size=16)
+
+    assert result != None
+    assert result['payload_ok']
+    assert result['device_ms'] < result['rtt_ms']
+
+
+@pytest.mark.parametrize("payload_size", [0, 32])
+def test_latency_probe_rtt(zigbee, device_name, payload_size):
+    stats = LatencyProbe(zigbee, device_name).measure(count=20, payload_size=payload_size)
+    print(f"RTT with {payload_size} bytes payload: {stats}")
+
+    # A device in the test network shall answer all the probes, and answer them immediately
+    assert stats['lost'] == 0
+    assert stats['corrupted'] == 0
+    assert stats['device_ms']['max'] < stats['rtt_ms']['p50']
@@ -15,8 +15,12 @@ const ea = exposes.access;
 
 // A subset of data types defined in dataType.ts (zigbee-herdsman project)
 const DataType = {
+    uint8: 0x20,
     uint16: 0x21,
+    uint32: 0x23,
+    int8: 0x28,
     enum8: 0x30,
+    octetStr: 0x41,
 }
 
 const switchModeValues = ['toggle', 'momentary', 'multifunction'];
@@ -26,11 +30,83 @@ const longPressModeValues = ['none', 'levelCtrlUp', 'levelCtrlDown'];
 const operationModeValues = ['server', 'client'];
 const interlockModeValues = ['none', 'mutualExclusion', 'opposite'];
 
+// Automation rules, see RuleTable.h. Each rule is packed into 6 bytes: trigger, action, command, endpoint, param (LE)
+const ruleTriggerValues = {release: 0, single: 1, double: 2, triple: 3, hold: 255};
+const ruleActionValues = {local: 1, bound: 2, group: 3, led: 4};
+const ruleCommandValues = {off: 0, on: 1, toggle: 2};
+
+function encodeAutomationRules(rules) {
+    const data = [];
+    for (const rule of rules) {
+        assert(rule.trigger in ruleTriggerValues, `Unknown rule trigger '${rule.trigger}'`);
+        assert(rule.action in ruleActionValues, `Unknown rule action '${rule.action}'`);
+
+        const command = rule.action == 'led' ? 0 : ruleCommandValues[rule.command];
+        assert(command !== undefined, `Unknown rule command '${rule.command}'`);
+
+        let param = 0;
+        if (rule.action == 'group') param = rule.group;
+        if (rule.action == 'led') param = rule.effect || 0;
+
+        data.push(ruleTriggerValues[rule.trigger], ruleActionValues[rule.action], command, rule.endpoint || 0,
+                  param & 0xff, (param >> 8) & 0xff);
+    }
+    return data;
+}
+
+function decodeAutomationRules(data) {
+    const rules = [];
+    for (let i = 0; i + 6 <= data.length; i += 6) {
+        const rule = {trigger: getKey(ruleTriggerValues, data[i]), action: getKey(ruleActionValues, data[i + 1])};
+        const param = data[i + 4] | (data[i + 5] << 8);
+
+        if (rule.action != 'led') rule.command = getKey(ruleCommandValues, data[i + 2]);
+        if (data[i + 3] != 0) rule.endpoint = data[i + 3];
+        if (rule.action == 'group') rule.group = param;
+        if (rule.action == 'led') rule.effect = param;
+        rules.push(rule);
+    }
+    return rules;
+}
+
 
 const manufacturerOptions = {
     jennic : {manufacturerCode: 0x1037}
 }
 
+// zigbee-herdsman does not know the Latency Probe cluster (see LatencyProbe.h). Add it to the list of known clusters,
+// so that its commands can be sent and parsed.
+const herdsmanClusters = require('zigbee-herdsman/dist/zcl/definition/cluster').default;
+herdsmanClusters.manuSpecificLatencyProbe = {
+    ID: 0xFC01,
+    manufacturerCode: manufacturerOptions.jennic.manufacturerCode,
+    attributes: {
+        echoRequests: {ID: 0x0000, type: DataType.uint32},
+        maxProcessingTime: {ID: 0x0001, type: DataType.uint32},
+    },
+    commands: {
+        echoRequest: {
+            ID: 0x00,
+            parameters: [
+                {name: 'sequence', type: DataType.uint32},
+                {name: 'payload', type: DataType.octetStr},
+            ],
+        },
+    },
+    commandsResponse: {
+        echoResponse: {
+            ID: 0x00,
+            parameters: [
+                {name: 'sequence', type: DataType.uint32},
+                {name: 'receiveTime', type: DataType.uint32},
+                {name: 'processingTime', type: DataType.uint16},
+                {name: 'backlog', type: DataType.uint8},
+                {name: 'payload', type: DataType.octetStr},
+            ],
+        },
+    },
+};
+
 const getKey = (object, value) => {
     for (const key in object) {
         if (object[key] == value) return key;
@@ -100,6 +176,11 @@ const fromZigbee_OnOffSwitchCfg = {
             result[`interlock_mode_${ep_name}`] = interlockModeValues[msg.data['65286']];
         }
 
+        // Automation rules
+        if(msg.data.hasOwnProperty('65296')) {
+            result[`automation_rules_${ep_name}`] = JSON.stringify(decodeAutomationRules(msg.data['65296']));
+        }
+
         // meta.logger.debug(`+_+_+_ fromZigbeeConverter() result=[${JSON.stringify(result)}]`);
         return result;
     },
@@ -107,7 +188,8 @@ const fromZigbee_OnOffSwitchCfg = {
 
 
 const toZigbee_OnOffSwitchCfg = {
-    key: ['switch_mode', 'switch_actions', 'relay_mode', 'max_pause', 'min_long_press', 'long_press_mode', 'operation_mode', 'interlock_mode'],
+    key: ['switch_mode', 'switch_actions', 'relay_mode', 'max_pause', 'min_long_press', 'long_press_mode', 'operation_mode', 'interlock_mode',
+          'automation_rules'],
 
     convertGet: async (entity, key, meta) => {
         // meta.logger.debug(`+_+_+_ toZigbeeConverter::convertGet() key=${key}, entity=[${JSON.stringify(entity)}]`);
@@ -125,6 +207,7 @@ const toZigbee_OnOffSwitchCfg = {
                 long_press_mode: 65284,
                 operation_mode: 65285,
                 interlock_mode: 65286,
+                automation_rules: 65296,
             };
             // meta.logger.debug(`+_+_+_ #2 getting value for key=[${lookup[key]}]`);
             await entity.read('genOnOffSwitchCfg', [lookup[key]], manufacturerOptions.jennic);
@@ -195,13 +278,21 @@ const toZigbee_OnOffSwitchCfg = {
                 if(interlockEp)                     
                     /*await*/ meta.device.getEndpoint(interlockEp).read('genOnOffSwitchCfg', [65286], manufacturerOptions.jennic);
                 break;
+
+            case 'automation_rules':
+                // Rules are passed as a JSON array, e.g. [{"trigger": "double", "action": "group", "command": "off", "group": 5}]
+                const rules = typeof value === 'string' ? JSON.parse(value || '[]') : value;
+                payload = {65296: {'value': encodeAutomationRules(rules), 'type': DataType.octetStr}};
+                await entity.write('genOnOffSwitchCfg', payload, manufacturerOptions.jennic);
+                newValue = JSON.stringify(rules);
+                break;
     
             default:
                 meta.logger.debug(`convertSet(): Unrecognized key=${key} (value=${value})`);
                 break;
         }
 
-        result = {state: {[key]: value}}
+        result = {state: {[key]: key == 'automation_rules' ? newValue : value}}
         meta.logger.debug(`result = [${JSON.stringify(result)}]`);
         return result;
     },
@@ -237,6 +328,10 @@ function addSwitchSettings(sw) {
     // const min_long_press_description = `Defines the minimum duration for pressing the button to trigger a 'hold' action`;
     // sw.withFeature(e.numeric('min_long_press', ea.ALL));
 
+    sw.withFeature(e.text('automation_rules', ea.ALL)
+        .withDescription('JSON list of on-device rules, e.g. [{"trigger": "double", "action": "local", "command": "off", "endpoint": 3}]. ' +
+                         'Actions: local (relay), bound, group (with "group"), led (with "effect")'));
+
     return sw;
 }
 
@@ -264,6 +359,12 @@ function genSwitchEndpoint(epName, enableInterlock) {
         sw.withFeature(e.enum('interlock_mode', ea.ALL, interlockModeValues));
     }
 
+    // Scenes (the relay state only). Use the group topic to store or recall a scene on all the group members at once
+    sw.withFeature(e.numeric('scene_store', ea.SET).withValueMin(0).withValueMax(255)
+        .withDescription('Store the current state as a scene with this ID'));
+    sw.withFeature(e.numeric('scene_recall', ea.SET).withValueMin(0).withValueMax(255)
+        .withDescription('Recall the scene with this ID'));
+
     // Make sure whole created block acts as a group of parameters, rather than a single composite object
     sw.withProperty('').withEndpoint(epName);
 
@@ -284,8 +385,164 @@ function genBothButtonsEndpoint(epName) {
     return sw;
 }
 
+// Poll Control cluster operates with quarter-second intervals, while settings are exposed in seconds
+const pollControlAttributes = {
+    check_in_interval: 'checkinInterval',
+    long_poll_interval: 'longPollInterval',
+    short_poll_interval: 'shortPollInterval',
+    fast_poll_timeout: 'fastPollTimeout',
+};
+
+const fromZigbee_PollCtrl = {
+    cluster: 'genPollCtrl',
+    type: ['attributeReport', 'readResponse'],
+
+    convert: (model, msg, publish, options, meta) => {
+        const result = {};
+        for (const key in pollControlAttributes) {
+            if(msg.data.hasOwnProperty(pollControlAttributes[key])) {
+                result[key] = msg.data[pollControlAttributes[key]] / 4;
+            }
+        }
+        return result;
+    },
+}
+
+const toZigbee_PollCtrl = {
+    key: ['check_in_interval', 'long_poll_interval', 'short_poll_interval', 'fast_poll_timeout', 'fast_poll_stop'],
+
+    convertGet: async (entity, key, meta) => {
+        if(key in pollControlAttributes) {
+            await entity.read('genPollCtrl', [pollControlAttributes[key]]);
+        }
+    },
+
+    convertSet: async (entity, key, value, meta) => {
+        const quarterSeconds = Math.round(value * 4);
+
+        switch(key) {
+            // Check-in interval and fast poll timeout are writable attributes
+            case 'check_in_interval':
+            case 'fast_poll_timeout':
+                await entity.write('genPollCtrl', {[pollControlAttributes[key]]: quarterSeconds});
+                break;
+
+            // Poll intervals are read-only, and can be changed only with dedicated commands
+            case 'long_poll_interval':
+                await entity.command('genPollCtrl', 'setLongPollInterval', {newLongPollInterval: quarterSeconds});
+                break;
+
+            case 'short_poll_interval':
+                await entity.command('genPollCtrl', 'setShortPollInterval', {newShortPollInterval: quarterSeconds});
+                break;
+
+            case 'fast_poll_stop':
+                await entity.command('genPollCtrl', 'fastPollStop', {});
+                return {};
+
+            default:
+                meta.logger.debug(`convertSet(): Unrecognized key=${key} (value=${value})`);
+                break;
+        }
+
+        return {state: {[key]: value}};
+    },
+}
+
+function getPollControlSettings() {
+    // These settings take effect only on sleepy end devices
+    return [
+        e.numeric('check_in_interval', ea.ALL).withUnit('s').withValueMin(0).withValueMax(1802240)
+            .withDescription('Period of check-ins sent to the coordinator (0 - disabled)'),
+        e.numeric('long_poll_interval', ea.ALL).withUnit('s').withValueMin(1).withValueMax(1802240).withValueStep(0.25)
+            .withDescription('Parent poll period when the device is idle'),
+        e.numeric('short_poll_interval', ea.ALL).withUnit('s').withValueMin(0.25).withValueMax(16383).withValueStep(0.25)
+            .withDescription('Parent poll period when the device is in the fast poll mode'),
+        e.numeric('fast_poll_timeout', ea.ALL).withUnit('s').withValueMin(0.25).withValueMax(16383).withValueStep(0.25)
+            .withDescription('Default duration of the fast poll mode requested on check-in'),
+        e.enum('fast_poll_stop', ea.SET, ['stop']).withDescription('Stop the fast poll mode immediately'),
+    ];
+}
+
+// Diagnostics cluster attributes: herdsman attribute name (if any), ID, and type
+const diagnosticsAttributes = {
+    persistent_memory_writes: {name: 'persistentMemoryWrites', ID: 0x0001, type: DataType.uint16},
+    mac_tx_unicast: {name: 'macTxUcast', ID: 0x0103, type: DataType.uint32},
+    mac_tx_unicast_retries: {name: 'macTxUcastRetry', ID: 0x0104, type: DataType.uint16},
+    mac_tx_unicast_failures: {name: 'macTxUcastFail', ID: 0x0105, type: DataType.uint16},
+    aps_tx_unicast_success: {name: 'apsTxUcastSuccess', ID: 0x0109, type: DataType.uint16},
+    aps_tx_unicast_failures: {name: 'apsTxUcastFail', ID: 0x010B, type: DataType.uint16},
+    neighbors_added: {name: 'neighborAdded', ID: 0x010D, type: DataType.uint16},
+    neighbors_removed: {name: 'neighborRemoved', ID: 0x010E, type: DataType.uint16},
+    buffer_alloc_failures: {name: 'packetBufferAllocateFailures', ID: 0x0117, type: DataType.uint16},
+    average_mac_retries: {name: 'averageMacRetryPerApsMessageSent', ID: 0x011B, type: DataType.uint16},
+    last_message_lqi: {name: 'lastMessageLqi', ID: 0x011C, type: DataType.uint8},
+    last_message_rssi: {name: 'lastMessageRssi', ID: 0x011D, type: DataType.int8},
+    rejoins: {ID: 0xFF00, type: DataType.uint16, manufacturerSpecific: true},
+    report_retries: {ID: 0xFF01, type: DataType.uint16, manufacturerSpecific: true},
+};
+
+// Counters that are worth reporting on change. Others (especially the success counters, which grow with each
+// report sent) are read on demand.
+const diagnosticsReports = [
+    {key: 'mac_tx_unicast_failures', change: 1},
+    {key: 'aps_tx_unicast_failures', change: 1},
+    {key: 'buffer_alloc_failures', change: 1},
+    {key: 'average_mac_retries', change: 1},
+    {key: 'last_message_lqi', change: 20},
+];
+
+const fromZigbee_Diagnostics = {
+    cluster: 'haDiagnostic',
+    type: ['attributeReport', 'readResponse'],
+
+    convert: (model, msg, publish, options, meta) => {
+        const result = {};
+        for (const key in diagnosticsAttributes) {
+            const attr = diagnosticsAttributes[key];
+            if(attr.name && msg.data.hasOwnProperty(attr.name)) {
+                result[key] = msg.data[attr.name];
+            }
+            else if(msg.data.hasOwnProperty(attr.ID)) {
+                result[key] = msg.data[attr.ID];
+            }
+        }
+        return result;
+    },
+}
+
+const toZigbee_Diagnostics = {
+    key: Object.keys(diagnosticsAttributes),
+
+    convertGet: async (entity, key, meta) => {
+        const attr = diagnosticsAttributes[key];
+        const options = attr.manufacturerSpecific ? manufacturerOptions.jennic : {};
+        await entity.read('haDiagnostic', [attr.ID], options);
+    },
+}
+
+function getDiagnosticsSettings() {
+    return [
+        e.numeric('mac_tx_unicast', ea.STATE_GET).withDescription('Unicast frames sent by the MAC layer'),
+        e.numeric('mac_tx_unicast_retries', ea.STATE_GET)
+            .withDescription('MAC retries (lower bound: frames that were not acknowledged at all)'),
+        e.numeric('mac_tx_unicast_failures', ea.STATE_GET).withDescription('Unicast frames failed at the MAC layer'),
+        e.numeric('aps_tx_unicast_success', ea.STATE_GET).withDescription('Unicast messages delivered'),
+        e.numeric('aps_tx_unicast_failures', ea.STATE_GET).withDescription('Unicast messages not delivered'),
+        e.numeric('average_mac_retries', ea.STATE_GET).withDescription('Average MAC retries per APS message sent'),
+        e.numeric('buffer_alloc_failures', ea.STATE_GET).withDescription('Packet buffer allocation failures'),
+        e.numeric('neighbors_added', ea.STATE_GET).withDescription('Devices joined through this device'),
+        e.numeric('neighbors_removed', ea.STATE_GET).withDescription('Neighbor devices left the network'),
+        e.numeric('persistent_memory_writes', ea.STATE_GET).withDescription('Persistent memory (PDM) writes'),
+        e.numeric('rejoins', ea.STATE_GET).withDescription('Network connection recoveries'),
+        e.numeric('report_retries', ea.STATE_GET).withDescription('Reports sent again by the application'),
+        e.numeric('last_message_lqi', ea.STATE_GET).withDescription('LQI of the last message received'),
+        e.numeric('last_message_rssi', ea.STATE_GET).withUnit('dBm').withDescription('RSSI of the last message received'),
+    ];
+}
+
 function getGenericSettings() {
-    return [e.device_temperature()];
+    return [e.device_temperature(), ...getPollControlSettings(), ...getDiagnosticsSettings()];
 }
 
 function genSwitchActions(endpoints) {
@@ -340,10 +597,69 @@ const fromZigbee_LevelCtrl = {
     },
 }
 
+// Echo requests waiting for the response, by device address and sequence number
+const latencyProbeRequests = new Map();
+let latencyProbeSequence = 0;
+
+const fromZigbee_LatencyProbe = {
+    cluster: 'manuSpecificLatencyProbe',
+    type: ['commandEchoResponse'],
+
+    convert: (model, msg, publish, options, meta) => {
+        const receivedAt = process.hrtime.bigint();
+        const key = `${msg.device.ieeeAddr}/${msg.data.sequence}`;
+        const request = latencyProbeRequests.get(key);
+        if (!request) {
+            meta.logger.debug(`Latency probe: unexpected response ${key}`);
+            return {};
+        }
+        latencyProbeRequests.delete(key);
+
+        // Round trip time as seen by zigbee2mqtt, and the part of it that the request spent in the device
+        const rtt = Number(receivedAt - request.sentAt) / 1e6;
+        const deviceTime = msg.data.processingTime / 1000;
+        const payload = Array.from(msg.data.payload || []);
+        return {latency_probe: {
+            sequence: msg.data.sequence,
+            rtt_ms: Math.round(rtt * 100) / 100,
+            device_ms: deviceTime,
+            network_ms: Math.round((rtt - deviceTime) * 100) / 100,
+            backlog: msg.data.backlog,
+            receive_time: msg.data.receiveTime,
+            payload_ok: payload.length == request.payload.length && payload.every((b, i) => b == request.payload[i]),
+        }};
+    },
+}
+
+const toZigbee_LatencyProbe = {
+    key: ['latency_probe'],
+
+    convertSet: async (entity, key, value, meta) => {
+        // Value is either a payload size, or {sequence, payload_size}
+        const sequence = (value.sequence !== undefined ? value.sequence : latencyProbeSequence++) >>> 0;
+        const size = Math.min(typeof value == 'object' ? (value.payload_size || 0) : value, 32);
+        const payload = Array.from(crypto.randomBytes(size));
+
+        // Responses may get lost, do not let the pending list grow forever
+        if (latencyProbeRequests.size > 100) {
+            latencyProbeRequests.clear();
+        }
+
+        // The cluster lives on the basic endpoint
+        const ep = meta.device.getEndpoint(1);
+        latencyProbeRequests.set(`${meta.device.ieeeAddr}/${sequence}`, {sentAt: process.hrtime.bigint(), payload: payload});
+        await ep.command('manuSpecificLatencyProbe', 'echoRequest', {sequence: sequence, payload: payload},
+                         {...manufacturerOptions.jennic, disableDefaultResponse: true});
+        return {};
+    },
+}
+
 const common_definition = {
     vendor: 'DIY',
-    fromZigbee: [fz.on_off, fromZigbee_OnOffSwitchCfg, fromZigbee_MultistateInput, fromZigbee_OnOff, fromZigbee_LevelCtrl, fz.device_temperature],
-    toZigbee: [tz.on_off, toZigbee_OnOffSwitchCfg],
+    fromZigbee: [fz.on_off, fromZigbee_OnOffSwitchCfg, fromZigbee_MultistateInput, fromZigbee_OnOff, fromZigbee_LevelCtrl, fz.device_temperature, fromZigbee_PollCtrl, fromZigbee_Diagnostics,
+                 fromZigbee_LatencyProbe],
+    toZigbee: [tz.on_off, toZigbee_OnOffSwitchCfg, toZigbee_PollCtrl, toZigbee_Diagnostics, toZigbee_LatencyProbe,
+               tz.scene_store, tz.scene_recall, tz.scene_add, tz.scene_remove, tz.scene_remove_all],
     configure: async (device, coordinatorEndpoint, logger) => {
         for (const ep of device.endpoints) {
             if(ep.supportsInputCluster('genOnOff')) {
@@ -353,6 +669,20 @@ const common_definition = {
                 await ep.read('genOnOffSwitchCfg', ['switchActions']);
                 await ep.read('genOnOffSwitchCfg', [65280, 65281, 65282, 65283, 65284, 65285], manufacturerOptions.jennic);
             }
+            if(ep.supportsInputCluster('genPollCtrl')) {
+                // Check-ins are sent to bound clients only
+                await ep.bind('genPollCtrl', coordinatorEndpoint);
+                await ep.read('genPollCtrl', ['checkinInterval', 'longPollInterval', 'shortPollInterval', 'fastPollTimeout']);
+            }
+            if(ep.supportsInputCluster('haDiagnostic')) {
+                await ep.bind('haDiagnostic', coordinatorEndpoint);
+                await ep.configureReporting('haDiagnostic', diagnosticsReports.map(report => ({
+                    attribute: {ID: diagnosticsAttributes[report.key].ID, type: diagnosticsAttributes[report.key].type},
+                    minimumReportInterval: 60,
+                    maximumReportInterval: 3600,
+                    reportableChange: report.change,
+                })));
+            }
         }
     },
     meta: {multiEndpoint: true},